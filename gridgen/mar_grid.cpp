@@ -28,6 +28,7 @@
 #include <ibmisc/enum.hpp>
 
 #include <icebin/error.hpp>
+#include <icebin/nc_layout.hpp>
 #include <icebin/gridgen/gridutil.hpp>
 #include <icebin/gridgen/clippers.hpp>
 #include <icebin/gridgen/GridGen_XY.hpp>
@@ -140,7 +141,7 @@ int main(int argc, char **argv)
     spec.make_grid(grid);
 
     // ------------- Write it out to NetCDF
-    ibmisc::NcIO ncio(spec.name + ".nc", netCDF::NcFile::replace);
+    ibmisc::NcIO ncio(spec.name + ".nc", 'w', "nc4", NcLayout().configure_var());
     grid.ncio(ncio, "grid");
     ncio.close();
 }
@@ -28,6 +28,8 @@
 #include <ibmisc/indexing.hpp>
 
 #include <icebin/error.hpp>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/nc_layout.hpp>
 #include <icebin/gridgen/gridutil.hpp>
 #include <icebin/gridgen/GridGen_LonLat.hpp>
 #include <icebin/GridSpec.hpp>
@@ -116,11 +118,11 @@ int main(int argc, char **argv)
 
     // ------------ Make the grid from the spec
     std::string grid_name = "modele_ll_" + szone + sgrid;
-    auto spherical_clip(std::bind(&ice_sheet::clip, zone, _1, _2, _3, _4, _5));
-    Grid grid(make_grid(grid_name, spec, spherical_clip));
+    auto row_clip(std::bind(&ice_sheet::clip_row, zone, _1, _2, _3, _4, _5));
+    FlatGrid grid(make_flat_grid(grid_name, spec, row_clip));
 
     // ------------- Write it out to NetCDF
-    ibmisc::NcIO ncio(grid_name + ".nc", netCDF::NcFile::replace);
+    ibmisc::NcIO ncio(grid_name + ".nc", 'w', "nc4", NcLayout().configure_var());
     grid.ncio(ncio, "grid");
     ncio.close();
 }
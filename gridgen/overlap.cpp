@@ -17,14 +17,18 @@
  */
 
 #include <string>
+#include <fstream>
 #include <boost/filesystem.hpp>
 #include <tclap/CmdLine.h>
+#include <boost/mpi.hpp>
 
 #include <ibmisc/netcdf.hpp>
 #include <ibmisc/stdio.hpp>
 
 #include <icebin/Grid.hpp>
+#include <icebin/FlatGrid.hpp>
 #include <icebin/gridgen/GridGen_Exchange.hpp>
+#include <icebin/nc_layout.hpp>
 #include <icebin/gridgen/gridutil.hpp>
 
 static const double km = 1000.0;
@@ -37,6 +41,14 @@ struct ParseArgs {
     std::string fnameA;
     std::string fnameI;
     std::string fname_exgrid;    // OUT: Name of overlap file to write
+    int ntile;    // Overlap in parallel, in ntile x ntile tiles (0 = serial)
+    bool exact;    // Always use exact (CGAL) overlaps
+    bool stream;    // Write only overlap records, as they are computed
+    std::string fname_cacheI;    // Sidecar cache of gridI's projected polygons
+    std::string fname_update;    // Patch the exchange grid in this overlap file
+    std::string fname_changedA;  // Changed cell indices (text), for fname_update
+    std::string fname_changedI;
+    bool mpi;    // Distribute the overlap over MPI ranks
 
     ParseArgs(int argc, char **argv);
 };
@@ -67,6 +79,41 @@ ParseArgs::ParseArgs(int argc, char **argv)
             "Name of IceBin overlap file to write",
             false, "", "overlap grid file", cmd);
 
+        TCLAP::ValueArg<int> ntile_a("t", "tiles",
+            "Overlap in parallel, dividing gridA into NxN tiles (0 = serial)",
+            false, 0, "number of tiles per side", cmd);
+
+        TCLAP::SwitchArg exact_a("x", "exact",
+            "Compute all overlaps with exact arithmetic (no floating point fast path)",
+            cmd, false);
+
+        TCLAP::SwitchArg stream_a("s", "stream",
+            "Stream overlap records (iA, iI, area) to the output as they are computed, "
+            "without exchange grid polygons; uses much less memory",
+            cmd, false);
+
+        TCLAP::ValueArg<std::string> fname_cacheI_a("c", "cache",
+            "Cache gridI's projected polygons in this file; reused on later "
+            "runs with the same gridI and projection",
+            false, "", "projected polygon cache file", cmd);
+
+        TCLAP::ValueArg<std::string> fname_update_a("u", "update",
+            "Patch the exchange grid of an existing overlap file, recomputing "
+            "only overlaps of the cells listed by --changedA / --changedI",
+            false, "", "existing overlap file", cmd);
+
+        TCLAP::ValueArg<std::string> fname_changedA_a("", "changedA",
+            "Text file listing indices of gridA cells that changed (for --update)",
+            false, "", "index file", cmd);
+
+        TCLAP::ValueArg<std::string> fname_changedI_a("", "changedI",
+            "Text file listing indices of gridI cells that changed (for --update)",
+            false, "", "index file", cmd);
+
+        TCLAP::SwitchArg mpi_a("m", "mpi",
+            "Run under MPI: each rank overlaps one band of gridA; "
+            "rank 0 streams all records to the output (as with --stream)",
+            cmd, false);
 
         // Parse the argv array.
         cmd.parse( argc, argv );
@@ -74,12 +121,49 @@ ParseArgs::ParseArgs(int argc, char **argv)
         fnameA = fnameA_a.getValue();
         fnameI = fnameI_a.getValue();
         fname_exgrid = fname_exgrid_a.getValue();
+        ntile = ntile_a.getValue();
+        exact = exact_a.getValue();
+        stream = stream_a.getValue();
+        fname_cacheI = fname_cacheI_a.getValue();
+        fname_update = fname_update_a.getValue();
+        fname_changedA = fname_changedA_a.getValue();
+        fname_changedI = fname_changedI_a.getValue();
+        mpi = mpi_a.getValue();
     } catch (TCLAP::ArgException &e) { // catch any exceptions
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         exit(1);
     }
 }
 
+/** Reads whitespace-separated cell indices from a text file */
+static std::vector<long> read_indices(std::string const &fname)
+{
+    std::vector<long> ret;
+    if (fname == "") return ret;
+
+    std::ifstream fin(fname);
+    if (!fin) (*icebin_error)(-1, "Cannot open %s", fname.c_str());
+    long ix;
+    while (fin >> ix) ret.push_back(ix);
+    return ret;
+}
+
+/** Reads the exchange grid of an overlap file; written either as a
+Grid (by default) or in ExchangeGrid form (by --stream or --update) */
+static ExchangeGrid read_exgrid(std::string const &fname)
+{
+    ExchangeGrid exgrid;
+    NcIO ncio(fname, 'r');
+    if (!ncio.nc->getVar("exgrid.indices").isNull()) {
+        exgrid.ncio(ncio, "exgrid");
+    } else {
+        Grid grid;
+        grid.ncio(ncio, "exgrid");
+        exgrid = ExchangeGrid(grid);
+    }
+    ncio.close();
+    return exgrid;
+}
 
 int main(int argc, char **argv)
 {
@@ -87,20 +171,83 @@ int main(int argc, char **argv)
 
     printf("------------- Read gridA (GCM Grid): %s\n", args.fnameA.c_str());
     NcIO ncio1(args.fnameA, 'r');
-    Grid gridA;
+    FlatGrid gridA;
     gridA.ncio(ncio1, "grid");
     ncio1.close();
     printf("Done reading gridA\n");
 
     printf("------------- Read gridI (Ice Grid): %s\n", args.fnameI.c_str());
     NcIO ncio2(args.fnameI, 'r');
-    Grid gridI;
+    FlatGrid gridI;
     gridI.ncio(ncio2, "grid");
     ncio2.close();
     printf("Done reading gridI\n");
 
+    if (args.mpi) {
+        boost::mpi::environment env(argc, argv);
+        boost::mpi::communicator world;
+
+        std::string fname(args.fname_exgrid);
+        if (fname == "")
+            fname = strprintf("%s-%s.nc", gridA.name.c_str(), gridI.name.c_str());
+
+        std::unique_ptr<ibmisc::NcIO> ncio;
+        std::unique_ptr<ExchangeGridWriter> writer;
+        if (world.rank() == 0) {
+            printf("--------------- Overlapping on %d ranks (streaming to %s)\n",
+                world.size(), fname.c_str());
+            ncio.reset(new ibmisc::NcIO(fname, 'w', "nc4", NcLayout().configure_var()));
+            gridA.ncio(*ncio, "gridA");
+            gridI.ncio(*ncio, "gridI");
+            writer.reset(new ExchangeGridWriter(ncio->nc, "exgrid"));
+        }
+        write_exchange_grid_mpi(world, &gridA, &gridI, writer.get(),
+            (args.ntile > 0 ? args.ntile : 16), args.exact);
+        if (ncio) ncio->close();
+        return 0;
+    }
+
+    if (args.fname_update != "") {
+        printf("--------------- Updating overlaps from %s\n", args.fname_update.c_str());
+        ExchangeGrid exgrid0(read_exgrid(args.fname_update));
+        ExchangeGrid exgrid(update_exchange_grid(&gridA, &gridI, exgrid0,
+            read_indices(args.fname_changedA), read_indices(args.fname_changedI),
+            args.exact, args.fname_cacheI));
+
+        std::string fname(args.fname_exgrid);
+        if (fname == "")
+            fname = strprintf("%s-%s.nc", gridA.name.c_str(), gridI.name.c_str());
+        if (fname == args.fname_update) (*icebin_error)(-1,
+            "Output file must not be the same as the file being updated");
+
+        printf("--------------- Writing out %s\n", fname.c_str());
+        ibmisc::NcIO ncio(fname, 'w', "nc4", NcLayout().configure_var());
+        gridA.ncio(ncio, "gridA");
+        gridI.ncio(ncio, "gridI");
+        exgrid.ncio(ncio, "exgrid");
+        ncio.close();
+        return 0;
+    }
+
+    if (args.stream) {
+        std::string fname(args.fname_exgrid);
+        if (fname == "")
+            fname = strprintf("%s-%s.nc", gridA.name.c_str(), gridI.name.c_str());
+
+        printf("--------------- Overlapping (streaming to %s)\n", fname.c_str());
+        ibmisc::NcIO ncio(fname, 'w', "nc4", NcLayout().configure_var());
+        gridA.ncio(ncio, "gridA");
+        gridI.ncio(ncio, "gridI");
+        ExchangeGridWriter writer(ncio.nc, "exgrid");
+        // Records are written a tile at a time, so use reasonably small tiles
+        write_exchange_grid(&gridA, &gridI, writer,
+            (args.ntile > 0 ? args.ntile : 16), args.exact, args.fname_cacheI);
+        ncio.close();
+        return 0;
+    }
+
     printf("--------------- Overlapping\n");
-    Grid exgrid(make_exchange_grid(&gridA, &gridI));
+    Grid exgrid(make_exchange_grid(&gridA, &gridI, "", args.ntile, args.exact, args.fname_cacheI));
     sort_renumber_vertices(exgrid);
 
     printf("--------------- Writing out\n");
@@ -109,7 +256,7 @@ int main(int argc, char **argv)
         fname = strprintf("%s.nc", exgrid.name.c_str());    // Using operator+() or append() doesn't work here with GCC 4.9.3
 
     printf("overlap writing to %s", fname.c_str());
-    ibmisc::NcIO ncio(fname, 'w');
+    ibmisc::NcIO ncio(fname, 'w', "nc4", NcLayout().configure_var());
     gridA.ncio(ncio, "gridA");
     gridI.ncio(ncio, "gridI");
     exgrid.ncio(ncio, "exgrid");
@@ -31,6 +31,7 @@
 #include <ibmisc/stdio.hpp>
 
 #include <icebin/error.hpp>
+#include <icebin/nc_layout.hpp>
 #include <icebin/gridgen/gridutil.hpp>
 #include <icebin/gridgen/clippers.hpp>
 #include <icebin/gridgen/GridGen_XY.hpp>
@@ -115,7 +116,7 @@ int main(int argc, char **argv)
     // ------------- Write it out to NetCDF
     if (ofname == "") ofname = strprintf("%s.nc", name.c_str());    // Using operator+() or append() doesn't work here with GCC 4.9.3
 
-    ibmisc::NcIO ncio(ofname, netCDF::NcFile::replace);
+    ibmisc::NcIO ncio(ofname, 'w', "nc4", NcLayout().configure_var());
     grid.ncio(ncio, "grid");
     ncio.close();
 }
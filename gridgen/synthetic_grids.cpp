@@ -0,0 +1,151 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Generates a synthetic GCMRegridder (and elevmaskI for each ice
+// sheet), for benchmarks and scaling studies without external data.
+
+#include <string>
+#include <iostream>
+#include <tclap/CmdLine.h>
+
+#include <ibmisc/netcdf.hpp>
+#include <ibmisc/stdio.hpp>
+
+#include <icebin/nc_layout.hpp>
+#include <icebin/bincsr.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+
+using namespace ibmisc;
+using namespace icebin;
+using namespace netCDF;
+
+struct ParseArgs {
+    SyntheticSpec spec;
+    std::string ofname;    // OUT: GCMRegridder file to write
+    bool grids;    // Also write gridA, gridI and exgrid
+    bool bingrid;    // Also write agridA and each agridI as bingrid sidecars
+
+    ParseArgs(int argc, char **argv);
+};
+
+ParseArgs::ParseArgs(int argc, char **argv)
+{
+    try {
+        TCLAP::CmdLine cmd("Generates synthetic grids, exchange grids, "
+            "elevation classes and elevmasks; written as a GCMRegridder", ' ', "<no-version>");
+
+        TCLAP::ValueArg<int> nA_a("n", "nA",
+            "GCM grid cells per side of each ice sheet domain",
+            false, spec.nA, "number of cells", cmd);
+
+        TCLAP::ValueArg<int> refine_a("r", "refine",
+            "Ice grid cells per GCM grid cell, in each direction",
+            false, spec.refine, "refinement", cmd);
+
+        TCLAP::ValueArg<int> nsheet_a("s", "sheets",
+            "Number of ice sheets",
+            false, spec.nsheet, "number of sheets", cmd);
+
+        TCLAP::ValueArg<int> nhc_a("e", "nhc",
+            "Number of elevation classes",
+            false, spec.nhc, "number of classes", cmd);
+
+        TCLAP::SwitchArg lonlat_a("l", "lonlat",
+            "Use a lon/lat GCM grid, with ice sheets in polar stereographic "
+            "projections (otherwise, all grids are in one plane)",
+            cmd, false);
+
+        TCLAP::ValueArg<int> ntile_a("t", "tiles",
+            "Overlap in parallel, dividing gridA into NxN tiles (0 = serial)",
+            false, spec.ntile, "number of tiles per side", cmd);
+
+        TCLAP::ValueArg<std::string> ofname_a("o", "out",
+            "Name of GCMRegridder file to write",
+            false, "", "output file", cmd);
+
+        TCLAP::SwitchArg grids_a("g", "grids",
+            "Also write the full grids (as gridA, <sheet>.gridI and <sheet>.exgrid)",
+            cmd, false);
+
+        TCLAP::SwitchArg bingrid_a("b", "bingrid",
+            "Also write agridA and each agridI to memory-mappable bingrid files, for fast loading",
+            cmd, false);
+
+        cmd.parse( argc, argv );
+
+        spec.nA = nA_a.getValue();
+        spec.refine = refine_a.getValue();
+        spec.nsheet = nsheet_a.getValue();
+        spec.nhc = nhc_a.getValue();
+        spec.lonlat = lonlat_a.getValue();
+        spec.ntile = ntile_a.getValue();
+        ofname = ofname_a.getValue();
+        grids = grids_a.getValue();
+        bingrid = bingrid_a.getValue();
+    } catch (TCLAP::ArgException &e) { // catch any exceptions
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ParseArgs args(argc, argv);
+    SyntheticSpec const &spec(args.spec);
+
+    printf("--------------- Generating grids\n");
+    SyntheticGrids sgrids(make_synthetic_grids(spec));
+    long nX = 0;
+    for (auto const &sheet : sgrids.sheets) nX += sheet.exgrid->nrealized();
+    printf("nA=%ld nI=%ld nX=%ld\n", (long)sgrids.gridA->nrealized(),
+        (long)sgrids.sheets[0].gridI->nrealized() * spec.nsheet, nX);
+
+    auto gcm(sgrids.gcm_regridder());
+
+    std::string ofname(args.ofname);
+    if (ofname == "") ofname = strprintf("synthetic_%s%d_r%d_s%d.nc",
+        (spec.lonlat ? "ll" : "xy"), spec.nA, spec.refine, spec.nsheet);
+
+    printf("--------------- Writing out %s\n", ofname.c_str());
+    ibmisc::NcIO ncio(ofname, 'w', "nc4", NcLayout().configure_var());
+    gcm->ncio(ncio, "m");
+
+    auto elevmaskIs(sgrids.elevmaskIs());
+    for (size_t k=0; k < sgrids.sheets.size(); ++k) {
+        auto const &sheet(sgrids.sheets[k]);
+        auto dims(get_or_add_dims(ncio,
+            {"nI." + sheet.name}, {elevmaskIs[k].extent(0)}));
+        ncio_blitz(ncio, elevmaskIs[k], "elevmaskI." + sheet.name, "double", dims);
+
+        if (args.grids) {
+            sheet.gridI->ncio(ncio, sheet.name + ".gridI");
+            sheet.exgrid->ncio(ncio, sheet.name + ".exgrid");
+        }
+    }
+    if (args.grids) sgrids.gridA->ncio(ncio, "gridA");
+    ncio.close();
+
+    // Sidecars are named after the variables written by gcm->ncio()
+    if (args.bingrid) {
+        write_bingrid(bingrid_fname(ofname, "m.agridA"), *gcm->agridA);
+        for (auto const &ice : gcm->ice_regridders()) {
+            write_bingrid(bingrid_fname(ofname, "m." + ice->name() + ".agridI"),
+                ice->load()->agridI);
+        }
+    }
+}
@@ -1,11 +1,15 @@
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
+#include <memory>
 #include <prettyprint.hpp>
 #include <icebin/error.hpp>
 #include <ibmisc/string.hpp>
 #include <ibmisc/linear/linear.hpp>
 #include <ibmisc/linear/compressed.hpp>
 #include <icebin/modele/global_ec.hpp>
+#include <icebin/bincsr.hpp>
+#include <icebin/nc_layout.hpp>
 #include <tclap/CmdLine.h>
 
 using namespace std;
@@ -26,6 +30,7 @@ std::array<std::string,2> parse_spec(std::string const &spec)
 
 struct ParseArgs {
     bool scale;
+    bool bincsr;    // Also write each matrix as a bincsr sidecar file?
     // Names of matrices to generate
     std::vector<std::array<std::string,2>> matrix_specs = vector<array<string,2>> {
         {"I","E"}, {"E","I"},
@@ -54,6 +59,10 @@ ParseArgs::ParseArgs(int argc, char **argv)
             "Scale the matrix when joining?",
             false, false, "scale", cmd);
 
+        TCLAP::SwitchArg bincsr_a("b", "bincsr",
+            "Also write each matrix to a memory-mappable bincsr file, for fast loading",
+            cmd, false);
+
         TCLAP::UnlabeledMultiArg<std::string> ifnames_a("merge-files",
             "Files with sub-matrices to merge together",
             true, "filenames", cmd);
@@ -61,6 +70,7 @@ ParseArgs::ParseArgs(int argc, char **argv)
         cmd.parse(argc, argv);
 
         scale = scale_a.getValue();
+        bincsr = bincsr_a.getValue();
         if (matrix_names_a.getValue() != "") {
             matrix_specs.clear();
             std::vector<std::string> matrix_names = split<std::string>(matrix_names_a.getValue(), ",");
@@ -91,12 +101,131 @@ blitz::TinyVector<T, len> vector_to_tiny(std::vector<T> const &vec)
     return ret;
 }
 
+/** One element of a matrix being combined, in sparse indexing */
+struct CombineEntry {
+    int iB, iA;
+    double val;
+
+    bool operator<(CombineEntry const &other) const
+        { return (iB < other.iB) || (iB == other.iB && iA < other.iA); }
+};
+
+/** Number of matrix elements read from a chunk file, or buffered per
+sorted run while merging, at a time.  Bounds memory use. */
+static size_t const block_size = 1<<20;
+
+/** Name of the temporary file holding the sorted elements of one chunk */
+static std::string run_fname(std::string const &ofname, std::string const &BvA, size_t i)
+    { return strprintf("%s.%s.run-%02d", ofname.c_str(), BvA.c_str(), (int)i); }
+
+/** Reads a sorted run file, block_size elements at a time. */
+class RunReader {
+    FILE *fin;
+    std::vector<CombineEntry> buf;
+    size_t pos = 0;
+
+    void fill()
+    {
+        buf.resize(block_size);
+        buf.resize(fread(&buf[0], sizeof(CombineEntry), block_size, fin));
+        pos = 0;
+    }
+public:
+    RunReader(std::string const &fname)
+    {
+        fin = fopen(fname.c_str(), "rb");
+        if (!fin) (*icebin_error)(-1, "Cannot open %s", fname.c_str());
+        fill();
+    }
+    ~RunReader() { fclose(fin); }
+
+    bool done() const { return pos == buf.size(); }
+    CombineEntry const &front() const { return buf[pos]; }
+    void next() { if (++pos == buf.size()) fill(); }
+};
+
+/** Reads the chunk matrix BvA from ncio in blocks, converting to
+sparse indexing; then sorts it and writes it to a run file.  Weights
+are accumulated on the way through.
+@return Number of elements in the chunk */
+template<class AccumWT>
+static size_t write_sorted_run(
+    NcIO &ncio,
+    std::string const &BvA,
+    std::array<std::string,2> const &sgrids,
+    std::string const &ofname,    // Name of run file
+    AccumWT &wM, AccumWT &Mw,
+    blitz::Array<double,1> *sM_s,    // Sum of wM (sparse), if scaling
+    bool check_AvE,
+    int &iGlobal)    // Count for debugging
+{
+    auto dimB(nc_read_blitz<int,1>(ncio.nc, "dim"+sgrids[0]));
+    auto dimA(nc_read_blitz<int,1>(ncio.nc, "dim"+sgrids[1]));
+
+    // ------------ wM
+    auto wM_d(nc_read_blitz<double,1>(ncio.nc, BvA+".wM"));
+    for (int i=0; i<wM_d.extent(0); ++i) {
+        wM.add({dimB(i)}, wM_d(i));
+        if (sM_s) (*sM_s)(dimB(i)) += wM_d(i);
+    }
+
+    // ------------------ Mw
+    auto Mw_d(nc_read_blitz<double,1>(ncio.nc, BvA+".Mw"));
+    for (int i=0; i<Mw_d.extent(0); ++i) Mw.add({dimA(i)}, Mw_d(i));
+
+    // ------------ M, a block at a time
+    size_t const nnz = ncio.nc->getDim(BvA+".M.nnz").getSize();
+    NcVar indices_v(ncio.nc->getVar(BvA+".M.indices"));
+    NcVar values_v(ncio.nc->getVar(BvA+".M.values"));
+
+    std::vector<CombineEntry> run;
+    run.reserve(nnz);
+    std::vector<int> indices_d(2*block_size);
+    std::vector<double> values_d(block_size);
+    for (size_t i0=0; i0<nnz; i0 += block_size) {
+        size_t const n = std::min(block_size, nnz-i0);
+        indices_v.getVar({i0, 0}, {n, 2}, &indices_d[0]);
+        values_v.getVar({i0}, {n}, &values_d[0]);
+
+        for (size_t i=0; i<n; ++i) {
+            CombineEntry const ee {
+                dimB(indices_d[i*2+0]), dimA(indices_d[i*2+1]), values_d[i]};
+            run.push_back(ee);
+
+            /** Check that AvE is local */
+            if (check_AvE) {
+                int const iA2 = ee.iA % 12960;
+                if (ee.iB != iA2) (*icebin_error)(-1,
+                    "%d: AvE is not local!  iA=%d, iA2=%d, iE=%d\n",
+                    iGlobal, ee.iB, iA2, ee.iA);
+            }
+            ++iGlobal;
+        }
+    }
+
+    std::sort(run.begin(), run.end());
+
+    FILE *fout = fopen(ofname.c_str(), "wb");
+    if (!fout) (*icebin_error)(-1, "Cannot open %s", ofname.c_str());
+    if (run.size() > 0 && fwrite(&run[0], sizeof(CombineEntry), run.size(), fout) != run.size())
+        (*icebin_error)(-1, "Error writing %s", ofname.c_str());
+    fclose(fout);
+
+    return nnz;
+}
+
+/** Combines the sub-matrices BvA from all the chunks into a single
+matrix.  Streams: each chunk is read in blocks and written to disk as
+a run sorted by sparse (iB, iA); the runs are then k-way merged into
+the output, summing duplicate elements.  Peak memory is one chunk's
+matrix (plus the output), rather than all of them. */
 void combine_chunks(
     std::vector<std::string> const &ifnames,    // Names of input chunks
     std::string const &ofname,
     char ofmode,    // 'w' or 'a' for write mode of output file
     std::array<std::string,2> const &_sgrids,    // {"B", "A"} --> matrix BvA
-    bool scale)
+    bool scale,
+    bool bincsr)
 {
 
 
@@ -107,7 +236,7 @@ void combine_chunks(
     std::string BvA;
 
     // Get total sizes
-    int nnz = 0;        // = number non-zero]
+    size_t nnz = 0;        // = number non-zero]
     std::array<long,2> sparse_extents;
     std::array<std::vector<int>,2> shapes;
     std::vector<size_t> sizes;    // For printing
@@ -142,40 +271,13 @@ void combine_chunks(
     cout << "sparse_extents = " << sparse_extents << endl;
 
 
-    // -------- Get scale factors (sparse)
-
-    long shape0;
-    {NcIO ncio(ifnames[0], 'r');
-        auto _dimB(ncio.nc->getVar("dim"+sgrids[0]));
-        get_or_put_att(_dimB, 'r', "sparse_extent", "long", &shape0, 1);
-    }
-    blitz::Array<double,1> sM_s(shape0);
-    sM_s = 0;
-
-    // Start by accumulating weights, then invert to scale
-    for (std::string const &ifname : ifnames) {
-        printf("--- Reading %s\n", ifname.c_str());
-        NcIO ncio(ifname, 'r');
-
-        std::array<long,2> shape;
-        auto _dimB(ncio.nc->getVar("dim"+sgrids[0]));
-        get_or_put_att(_dimB, 'r', "sparse_extent", "long", &shape[0], 1);
-        auto _dimA(ncio.nc->getVar("dim"+sgrids[1]));
-        get_or_put_att(_dimA, 'r', "sparse_extent", "long", &shape[1], 1);
-
-        auto dimB(nc_read_blitz<int,1>(ncio.nc, "dim"+sgrids[0]));
-        auto wM_d(nc_read_blitz<double,1>(ncio.nc, BvA+".wM"));
-        for (int i=0; i<wM_d.extent(0); ++i) {
-            sM_s(dimB(i)) += wM_d(i);
-        }
+    // -------- Scale factors (sparse), accumulated while writing runs
+    blitz::Array<double,1> sM_s;
+    if (scale) {
+        sM_s.resize(sparse_extents[0]);
+        sM_s = 0;
     }
 
-    // Invert to get scale factors
-    for (int i=0; i<sM_s.extent(0); ++i) sM_s(i) = 1. / sM_s(i);
-
-    // -----------------------
-
-
     // Allocate
     linear::Weighted_Compressed ret;
 
@@ -183,82 +285,74 @@ void combine_chunks(
     auto M(ret.M.accum());
     auto Mw(ret.weights[1].accum());
 
+        // Transfer full matrix shape meta-data
+        M.set_shape(sparse_extents);
+        wM.set_shape({sparse_extents[0]});
+        Mw.set_shape({sparse_extents[1]});
 
-        // Aggregate them together
+        // ------------ Pass 1: Sort each chunk into a run file
         int iGlobal = 0;    // Count for debugging
-        int iM=0;
-        for (std::string const &ifname : ifnames) {
-            printf("--- Reading %s\n", ifname.c_str());
-            NcIO ncio(ifname, 'r');
-
-            auto dimB(nc_read_blitz<int,1>(ncio.nc, "dim"+sgrids[0]));
-            auto dimA(nc_read_blitz<int,1>(ncio.nc, "dim"+sgrids[1]));
-
-            // ------------ wM
-            auto wM_d(nc_read_blitz<double,1>(ncio.nc, BvA+".wM"));
-            for (int i=0; i<wM_d.extent(0); ++i)
-                wM.add({dimB(i)}, wM_d(i));
-
-
-            // ------------ M
-            std::array<long,2> shape;
-            auto _dimB(ncio.nc->getVar("dim"+sgrids[0]));
-            get_or_put_att(_dimB, 'r', "sparse_extent", "long", &shape[0], 1);
-            auto _dimA(ncio.nc->getVar("dim"+sgrids[1]));
-            get_or_put_att(_dimA, 'r', "sparse_extent", "long", &shape[1], 1);
-
-            // Transfer full matrix shape meta-data
-            M.set_shape(shape);
-            wM.set_shape({shape[0]});
-            Mw.set_shape({shape[1]});
-            
-//                std::array<long,2>{dimB.sparse_extent(), dimA.sparse_extent()});
-
-            auto indices_d(nc_read_blitz<int,2>(ncio.nc, BvA+".M.indices"));
-            auto values_d(nc_read_blitz<double,1>(ncio.nc, BvA+".M.values"));
-            for (int i=0; i<values_d.extent(0); ++i) {
-                int const iB_s = dimB(indices_d(i,0));
-                int const iA_s = dimA(indices_d(i,1));
-                if (scale) {
-                    M.add({iB_s, iA_s}, values_d(i) * sM_s(iB_s));
-                } else {
-                    M.add({iB_s, iA_s}, values_d(i));
-                }
-            }
-
-            /** Check that AvE is local */
-            if (BvA == "AvE") {
-                for (int i=0; i<values_d.extent(0); ++i) {
-                    int const iAd = indices_d(i,0);
-                    int const iA = dimB(iAd);
-                    int const iEd = indices_d(i,1);
-                    int const iE = dimA(iEd);
-
-                    int const iA2 = iE % 12960;
-
-                    if (iA != iA2) (*icebin_error)(-1,
-                        "%d: AvE is not local!  iA=%d, iA2=%d, iE=%d\n",
-                        iGlobal, iA, iA2, iE);
-                    ++ iGlobal;
-
-                }
+        size_t nread = 0;
+        for (size_t i=0; i<ifnames.size(); ++i) {
+            printf("--- Reading %s\n", ifnames[i].c_str());
+            NcIO ncio(ifnames[i], 'r');
+            nread += write_sorted_run(ncio, BvA, sgrids, run_fname(ofname, BvA, i),
+                wM, Mw, scale ? &sM_s : nullptr, BvA == "AvE", iGlobal);
+        }
+        if (nread != nnz) (*icebin_error)(-1, "Bad count: %ld vs %ld", (long)nread, (long)nnz);
+
+        // Invert to get scale factors
+        if (scale) for (int i=0; i<sM_s.extent(0); ++i) sM_s(i) = 1. / sM_s(i);
+
+        // ------------ Pass 2: k-way merge of the runs
+        printf("--- Merging %ld runs\n", (long)ifnames.size());
+        std::vector<std::unique_ptr<RunReader>> runs;
+        for (size_t i=0; i<ifnames.size(); ++i)
+            runs.push_back(std::unique_ptr<RunReader>(new RunReader(run_fname(ofname, BvA, i))));
+
+        // Min-heap of the runs, keyed on each run's next element
+        auto greater_front([&runs](size_t a, size_t b)
+            { return runs[b]->front() < runs[a]->front(); });
+        std::vector<size_t> heap;
+        for (size_t i=0; i<runs.size(); ++i) if (!runs[i]->done()) heap.push_back(i);
+        std::make_heap(heap.begin(), heap.end(), greater_front);
+
+        bool have_cur = false;
+        CombineEntry cur {0, 0, 0};
+        auto flush_cur([&]() {
+            if (!have_cur) return;
+            M.add({cur.iB, cur.iA}, scale ? cur.val * sM_s(cur.iB) : cur.val);
+        });
+        while (heap.size() > 0) {
+            std::pop_heap(heap.begin(), heap.end(), greater_front);
+            RunReader &run(*runs[heap.back()]);
+            CombineEntry const ee(run.front());
+            if (have_cur && ee.iB == cur.iB && ee.iA == cur.iA) {
+                cur.val += ee.val;    // Same element from more than one chunk
+            } else {
+                flush_cur();
+                cur = ee;
+                have_cur = true;
             }
 
-            // ------------------ Mw
-            auto Mw_d(nc_read_blitz<double,1>(ncio.nc, BvA+".Mw"));
-            for (int i=0; i<Mw_d.extent(0); ++i) Mw.add({dimA(i)}, Mw_d(i));
+            run.next();
+            if (run.done()) heap.pop_back();
+            else std::push_heap(heap.begin(), heap.end(), greater_front);
         }
+        flush_cur();
 
-        // Check
-        if (ret.M.nnz() != nnz) (*icebin_error)(-1, "Bad count: %d vs %d", iM, nnz);
+        runs.clear();
+        for (size_t i=0; i<ifnames.size(); ++i)
+            std::remove(run_fname(ofname, BvA, i).c_str());
     }    // Finish off accumulators
 
     // Write it out
     printf("---- Writing output to %s\n", ofname.c_str());
-    {NcIO ncio(ofname, ofmode);
+    {NcIO ncio(ofname, ofmode, "nc4", NcLayout().configure_var());
         meta.ncio(ncio);
         ret.ncio(ncio, BvA);
     }
+    if (bincsr) write_bincsr(bincsr_fname(ofname, BvA), ret);
 }
 
 int main(int argc, char **argv)
@@ -272,7 +366,7 @@ int main(int argc, char **argv)
 
     char ofmode = 'w';
     for (auto const &sgrids : args.matrix_specs) {
-        combine_chunks(args.ifnames, ofname, ofmode, sgrids, args.scale);
+        combine_chunks(args.ifnames, ofname, ofmode, sgrids, args.scale, args.bincsr);
         ofmode = 'a';
     }
 
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <everytrace.h>
 #include <tclap/CmdLine.h>
 #include <ibmisc/memory.hpp>
@@ -14,21 +17,62 @@ using namespace netCDF;
 const int16_t GREENLAND_VAL = 2;    // Used to mark Greenland in ZNGDC1-SeparateGreenland/FCONT1
 const int16_t MIN_LANDICE_THK = 50;    // Anything under this we call seasonal snow cover
 
-void store_h(NcIO &ncout, blitz::Array<int16_t,2> val1m, std::string const &vname)
+/** Regrids a band of a 1-minute field (JM1m, IM1m) into the matching
+rows of the half-degree field valh (JMH, IMH).  Each band of
+valh is written by only one call. */
+static void regrid_h(
+    Hntr const &hntrh,
+    blitz::Array<int16_t,2> const &val1m,
+    blitz::Array<double,2> &valh,
+    std::mutex &valh_mutex)
 {
-    auto &valh(ncout.tmp.make<blitz::Array<double,2>>(JMH, IMH));
-    auto valh_1(reshape1(valh));
-
-    Hntr hntrh(17.17, ghxh, g1mx1m);
-
-    auto val1m_1(reshape1(val1m));
-    auto WTA(const_array(val1m_1.shape(), 1.0, blitz::FortranArray<1>()));
-    hntrh.regrid<double, int16_t, double>(WTA, val1m_1, valh_1, true);
-    auto dimsh(get_or_add_dims(ncout, {"jmh", "imh"}, {JMH, IMH}));
-    ncio_blitz(ncout, valh, vname, "double", dimsh);
+    int const JB0 = val1m.lbound(0) / (JM1m/JMH) + 1;    // 1-based rows of valh
+    int const JB1 = (val1m.ubound(0)+1) / (JM1m/JMH) + 1;
+
+    // Unit weights in Real*4 (as in HNTR4)
+    int const lbound = val1m.lbound(0)*IM1m + 1;
+    auto val1m_1(reshape1(val1m, lbound));
+    blitz::Array<float,1> WTA(blitz::Range(lbound, lbound + val1m_1.extent(0) - 1));
+    WTA = 1.0f;
+
+    // Regrid into a private array; shared blitz arrays are not thread-safe
+    blitz::Array<double,2> bandh(JMH, IMH);
+    hntrh.regrid_rows<float, int16_t, double>(WTA,
+        {val1m_1}, {reshape1(bandh, 1)}, JB0, JB1, true);
+
+    std::lock_guard<std::mutex> lock(valh_mutex);
+    blitz::Range const rows(JB0-1, JB1-2);
+    valh(rows, blitz::Range::all()) = bandh(rows, blitz::Range::all());
 }
 
+/** Rows [j0, j1) of the 1-minute (JM1m, IM1m) fields */
+struct Band1m {
+    blitz::Array<int16_t,2> fgice1m;
+    blitz::Array<int16_t,2> focean1m;
+    blitz::Array<int16_t,2> zicetop1m;
+    blitz::Array<int16_t,2> zsolid1m;
+
+    Band1m(int j0, int j1) :
+        fgice1m(blitz::Range(j0,j1-1), blitz::Range(0,IM1m-1)),
+        focean1m(blitz::Range(j0,j1-1), blitz::Range(0,IM1m-1)),
+        zicetop1m(blitz::Range(j0,j1-1), blitz::Range(0,IM1m-1)),
+        zsolid1m(blitz::Range(j0,j1-1), blitz::Range(0,IM1m-1))
+    {}
+};
 
+/** Reads or writes the rows of a 1-minute variable held in val */
+static void ncio_rows(
+    std::mutex &nc_mutex,
+    NcVar const &ncvar, char rw,
+    blitz::Array<int16_t,2> &val)
+{
+    std::vector<size_t> const startp {(size_t)val.lbound(0), 0};
+    std::vector<size_t> const countp {(size_t)val.extent(0), (size_t)val.extent(1)};
+
+    std::lock_guard<std::mutex> lock(nc_mutex);
+    if (rw == 'r') ncvar.getVar(startp, countp, val.data());
+    else ncvar.putVar(startp, countp, val.data());
+}
 
 // ============================================================
 // ------ Files:
@@ -41,16 +85,15 @@ void store_h(NcIO &ncout, blitz::Array<int16_t,2> val1m, std::string const &vnam
 //     used to remove GrIS from other datasets, at higher resolution
 
 /** Produces a global map of ice extent and elevation on the etopo1 grid.
+Works one 1-degree latitude band (60 rows of the 1-minute grid) at a
+time, njob bands at once; every step only looks inside a band.
 @param include_greenland Include Greenland ice in the ice map? */
 void etopo1_ice(
     FileLocator const &files,
     bool include_greenland,
-    std::string const &ofname_root)
+    std::string const &ofname_root,
+    int njob)
 {
-    // This is what we construct
-    blitz::Array<int16_t,2> fgice1m(JM1m, IM1m);
-    fgice1m = 0;
-
     // Read in ZNGDC1 (1-degree resolution)
     blitz::Array<double,2> fgice1(JM1,IM1);
     {NcIO ncio(files.locate("ZNGDC1.nc"), 'r');
@@ -58,192 +101,199 @@ void etopo1_ice(
         ncio_blitz(ncio, fgice1, "FGICE1", "double", {});
     }
 
-    NcIO nch(ofname_root + "h.nc", 'w');
-
     // ------- Process ETOPO1
-    // Attributes from ETOPO1 input file, by variable
-    std::map<std::string,
-        std::vector<std::pair<std::string, NcAttValue>>
-    > etopo1_atts;
-
-    std::array<char,80> titlei;
-    blitz::Array<int16_t,2> zicetop1m(JM1m, IM1m);
-    blitz::Array<int16_t,2> focean1m(JM1m, IM1m);
-    {std::string fname(files.locate("ZETOPO1.NCEI-SeparateGreenland.nc"));
-        printf("Opening ETOPO1 at %s\n", fname.c_str());
-        NcIO fin(files.locate("ZETOPO1.NCEI-SeparateGreenland.nc"));
+    std::string fname(files.locate("ZETOPO1.NCEI-SeparateGreenland.nc"));
+    printf("Opening ETOPO1 at %s\n", fname.c_str());
+    NcIO fin(fname);
+    NcVar focean_in(fin.nc->getVar("FOCEAN"));
+    NcVar zicetop_in(fin.nc->getVar("ZICTOP"));
+    NcVar zsolid_in(fin.nc->getVar("ZSOLID"));
+
+    // Define the 1-minute output variables, to be written band by band
+    NcIO ncout(ofname_root + "1m.nc", 'w');
+    ncout.nc->putAtt("source", include_greenland ? "etopo1_ice.cpp" : "etopo1_ice.cpp, Greenland removed");
+    auto dims(get_or_add_dims(ncout, {"jm1m", "im1m"}, {JM1m, IM1m}));
+    std::string const etopo1_source(include_greenland ? "ETOPO1" : "ETOPO1, Greenland removed");
+
+    NcVar zicetop_out(ncout.nc->addVar("ZICETOP1m", "short", dims));
+    get_or_put_all_atts(zicetop_out, 'w', get_all_atts(zicetop_in));
+    zicetop_out.putAtt("units", "m");
+    zicetop_out.putAtt("source", etopo1_source);
+
+    NcVar zsolid_out(ncout.nc->addVar("ZSOLG1m", "short", dims));
+    get_or_put_all_atts(zsolid_out, 'w', get_all_atts(zsolid_in));
+    zsolid_out.putAtt("units", "m");
+    zsolid_out.putAtt("source", etopo1_source);
+
+    NcVar focean_out(ncout.nc->addVar("FOCEAN1m", "short", dims));
+    get_or_put_all_atts(focean_out, 'w', get_all_atts(focean_in));
+    focean_out.putAtt("units", "1");
+    focean_out.putAtt("source", etopo1_source);
+
+    NcVar fgice_out(ncout.nc->addVar("FGICE1m", "short", dims));
+    fgice_out.putAtt("description", "Fractional ice cover (0 or 1)");
+    fgice_out.putAtt("units", "1");
+    fgice_out.putAtt("source", include_greenland ? "etopo1_ice.cpp output" : "etopo1_ice.cpp output, Greenland removed");
+
+    // Half-degree versions; small enough to keep whole
+    auto const hntrh(cached_hntr(17.17, ghxh, g1mx1m));
+    std::array<std::string,4> const vnamesh {"ZICETOPh", "ZSOLGh", "FOCEANh", "FGICEh"};
+    std::array<blitz::Array<double,2>,4> valsh;
+    for (auto &valh : valsh) valh.reference(blitz::Array<double,2>(JMH, IMH));
+
+    auto const g1mx1m_dxyp(make_dxyp(g1mx1m));
+    auto const g1x1_dxyp(make_dxyp(g1x1));
+
+    std::mutex nc_mutex;    // NetCDF is not thread-safe
+    std::mutex valh_mutex;
+    auto process_band = [&](int j1) {
+        int const j0m = j1*60;
+        int const j1m_end = (j1+1)*60;
+        Band1m band(j0m, j1m_end);
+        auto &fgice1m(band.fgice1m);
+        auto &focean1m(band.focean1m);
+        auto &zicetop1m(band.zicetop1m);
+        auto &zsolid1m(band.zsolid1m);
+
+        // This is what we construct
+        fgice1m = 0;
+
+        ncio_rows(nc_mutex, focean_in, 'r', focean1m);
+        ncio_rows(nc_mutex, zicetop_in, 'r', zicetop1m);
+        ncio_rows(nc_mutex, zsolid_in, 'r', zsolid1m);
 
         // Continental cells north of 78N are entirely glacial ice.
-        // (Except for Greenland, if that is to be done on a separate ice sheet)
-        {
-            etopo1_atts.insert(std::make_pair("FOCEAN", get_all_atts(
-                ncio_blitz(fin, focean1m, "FOCEAN", "short", {}))));
-
-            // Continental cells north of 78N are entirely glacial ice.
-            // (but ignore Greenland)
-            for (int j1m=JM1m*14/15; j1m < JM1m; ++j1m) {
-            for (int i1m=0; i1m < IM1m; ++i1m) {
-                if (focean1m(j1m,i1m) == 0) {
-                    // Convert indexing from 1minute --> 1degree grid
-                    int const i1 = i1m / 60;
-                    int const j1 = j1m / 60;
-
-                    fgice1m(j1m, i1m) = 1;
-                }
-            }}
-        }
+        // (but ignore Greenland)
+        for (int j1m=std::max(j0m, JM1m*14/15); j1m < j1m_end; ++j1m) {
+        for (int i1m=0; i1m < IM1m; ++i1m) {
+            if (focean1m(j1m,i1m) == 0) fgice1m(j1m, i1m) = 1;
+        }}
 
         // Antarctica is supplied by ETOPO1
-        {
-            blitz::Array<int16_t,2> zsolid1m(JM1m, IM1m);
-
-            // Read zicetop1m, zsolid1m
-            etopo1_atts.insert(std::make_pair("ZICTOP", get_all_atts(
-                ncio_blitz(fin, zicetop1m, "ZICTOP", "short", {}))));
-            etopo1_atts.insert(std::make_pair("ZSOLID", get_all_atts(
-                ncio_blitz(fin, zsolid1m, "ZSOLID", "short", {}))));
-
 // Use an ice-free Antarctica
 #if 1
-            // Use ETOPO1 for Southern Hemisphere Ice
-            for (int j1m=0; j1m < JM1m/2; ++j1m) {
-            for (int i1m=0; i1m < IM1m; ++i1m) {
-//if (j1m == 0) printf("south pole: %d %d %d\n", focean1m(j1m,i1m), zicetop1m(j1m,i1m), zsolid1m(j1m,i1m));
-                if ( (focean1m(j1m,i1m) == 0)
-                    && (zicetop1m(j1m,i1m) - zsolid1m(j1m,i1m) >= MIN_LANDICE_THK))
-                {
-                    fgice1m(j1m, i1m) = 1;
-                }
-            }}
+        // Use ETOPO1 for Southern Hemisphere Ice
+        for (int j1m=j0m; j1m < std::min(j1m_end, JM1m/2); ++j1m) {
+        for (int i1m=0; i1m < IM1m; ++i1m) {
+            if ( (focean1m(j1m,i1m) == 0)
+                && (zicetop1m(j1m,i1m) - zsolid1m(j1m,i1m) >= MIN_LANDICE_THK))
+            {
+                fgice1m(j1m, i1m) = 1;
+            }
+        }}
 #endif
 
-            // Deal with Greenland
+        // Deal with Greenland
+        for (int j1m=std::max(j0m, JM1m/2); j1m < j1m_end; ++j1m) {
+        for (int i1m=0; i1m < IM1m; ++i1m) {
+            if (focean1m(j1m,i1m) != GREENLAND_VAL) continue;
             if (include_greenland) {
                 // Use EOTOPO1 for Greenland too
-                for (int j1m=JM1m/2; j1m < JM1m; ++j1m) {
-                for (int i1m=0; i1m < IM1m; ++i1m) {
-                    if ( (focean1m(j1m,i1m) == GREENLAND_VAL)
-                        && (zicetop1m(j1m,i1m) - zsolid1m(j1m,i1m) >= MIN_LANDICE_THK))
-                    {
-                        fgice1m(j1m, i1m) = 1;
-                    }
-                }}
+                if (zicetop1m(j1m,i1m) - zsolid1m(j1m,i1m) >= MIN_LANDICE_THK)
+                    fgice1m(j1m, i1m) = 1;
             } else {
                 // Remove Greenland from zicetop1m, zsolid1m
-                for (int j1m=JM1m/2; j1m < JM1m; ++j1m) {
-                for (int i1m=0; i1m < IM1m; ++i1m) {
-                    if (focean1m(j1m,i1m) == GREENLAND_VAL) {
-                        zicetop1m(j1m,i1m) = -300;
-                        zsolid1m(j1m,i1m) = -300;
-                    }
-                }}
-            }
-
-            // Store zicetop1m, zsolid1m
-            {NcIO ncout(ofname_root + "1m.nc", 'w');
-                ncout.nc->putAtt("source", include_greenland ? "etopo1_ice.cpp" : "etopo1_ice.cpp, Greenland removed");
-                auto dims(get_or_add_dims(ncout, {"jm1m", "im1m"}, {JM1m, IM1m}));
-
-                NcVar ncvar;
-                ncvar = ncio_blitz(ncout, zicetop1m, "ZICETOP1m", "short", dims);
-                get_or_put_all_atts(ncvar, 'w', etopo1_atts.at("ZICTOP"));
-                ncvar.putAtt("units", "m");
-                ncvar.putAtt("source", include_greenland ? "ETOPO1" : "ETOPO1, Greenland removed");
-
-                ncvar = ncio_blitz(ncout, zsolid1m, "ZSOLG1m", "short", dims);
-                get_or_put_all_atts(ncvar, 'w', etopo1_atts.at("ZSOLID"));
-                ncvar.putAtt("units", "m");
-                ncvar.putAtt("source", include_greenland ? "ETOPO1" : "ETOPO1, Greenland removed");
-            }
-            store_h(nch, zicetop1m, "ZICETOPh");
-            store_h(nch, zsolid1m, "ZSOLGh");
-        }
-    }
-
-
-    // Add northern-hemisphere non-Greenland ice specified in ZNGDC1
-    // This must be downscaled to ETOPO1 grid
-    auto g1mx1m_dxyp(make_dxyp(g1mx1m));
-    auto g1x1_dxyp(make_dxyp(g1x1));
-    std::vector<std::tuple<int16_t,int,int>> cells;
-    for (int j1=JM1/2; j1 < JM1; ++j1) {
-    for (int i1=0; i1 < IM1; ++i1) {
-        double const snow1 = fgice1(j1, i1);
-        if (snow1 == 0) continue;
-
-        // Assemble cells in this gridcell, sorted by
-        // descending elevation (increasing negative elevation)
-        cells.clear();
-        for (int j1m=j1*60; j1m < (j1+1)*60; ++j1m) {
-        for (int i1m=i1*60; i1m < (i1+1)*60; ++i1m) {
-            if (focean1m(j1m,i1m) == 0 || (include_greenland && focean1m(j1m,i1m)) == GREENLAND_VAL) {
-                double const elev = zicetop1m(j1m,i1m);
-                cells.push_back(std::make_tuple(-elev, j1m, i1m));
+                zicetop1m(j1m,i1m) = -300;
+                zsolid1m(j1m,i1m) = -300;
             }
         }}
-        std::sort(cells.begin(), cells.end());
-        if (cells.size() == 0) continue;
 
-        // Snow-covered area for this cell in g1x1
-        double remain1m = snow1 * g1x1_dxyp(j1);
-printf("j1 i1=%d %d (area = %g %g)\n", j1, i1, snow1, remain1m);
-        for (auto ii=cells.begin(); ii != cells.end(); ++ii) {
-            int16_t const elev1m = -std::get<0>(*ii);
-            int const j1m(std::get<1>(*ii));
-            int const i1m(std::get<2>(*ii));
-//printf("--> %d %d\n", j1m, i1m);
-            double const area1m = g1mx1m_dxyp(j1m);
-            if (area1m <= remain1m) {
-                remain1m -= area1m;
-                fgice1m(j1m, i1m) = 1;
-            } else {
-                // No landice on the sea
+        // Store zicetop1m, zsolid1m
+        ncio_rows(nc_mutex, zicetop_out, 'w', zicetop1m);
+        ncio_rows(nc_mutex, zsolid_out, 'w', zsolid1m);
+        regrid_h(*hntrh, zicetop1m, valsh[0], valh_mutex);
+        regrid_h(*hntrh, zsolid1m, valsh[1], valh_mutex);
+
+        // Add northern-hemisphere non-Greenland ice specified in ZNGDC1
+        // This must be downscaled to ETOPO1 grid
+        std::vector<std::tuple<int16_t,int,int>> cells;
+        for (int i1=0; j1 >= JM1/2 && i1 < IM1; ++i1) {
+            double const snow1 = fgice1(j1, i1);
+            if (snow1 == 0) continue;
+
+            // Assemble cells in this gridcell, sorted by
+            // descending elevation (increasing negative elevation)
+            cells.clear();
+            for (int j1m=j1*60; j1m < (j1+1)*60; ++j1m) {
+            for (int i1m=i1*60; i1m < (i1+1)*60; ++i1m) {
+                if (focean1m(j1m,i1m) == 0 || (include_greenland && focean1m(j1m,i1m)) == GREENLAND_VAL) {
+                    double const elev = zicetop1m(j1m,i1m);
+                    cells.push_back(std::make_tuple(-elev, j1m, i1m));
+                }
+            }}
+            std::sort(cells.begin(), cells.end());
+            if (cells.size() == 0) continue;
 
-                // We're done; round the last grid cell on g1mx1m
-                if (remain1m >= area1m * .5)
+            // Snow-covered area for this cell in g1x1
+            double remain1m = snow1 * g1x1_dxyp(j1);
+printf("j1 i1=%d %d (area = %g %g)\n", j1, i1, snow1, remain1m);
+            for (auto ii=cells.begin(); ii != cells.end(); ++ii) {
+                int const j1m(std::get<1>(*ii));
+                int const i1m(std::get<2>(*ii));
+                double const area1m = g1mx1m_dxyp(j1m);
+                if (area1m <= remain1m) {
+                    remain1m -= area1m;
                     fgice1m(j1m, i1m) = 1;
-                break;
+                } else {
+                    // No landice on the sea
+
+                    // We're done; round the last grid cell on g1mx1m
+                    if (remain1m >= area1m * .5)
+                        fgice1m(j1m, i1m) = 1;
+                    break;
+                }
             }
         }
 
-    }}
+        // Remove Greenland from focean1m
+        for (int j1m=std::max(j0m, JM1m/2); j1m < j1m_end; ++j1m) {
+        for (int i1m=0; i1m < IM1m; ++i1m) {
+            if (focean1m(j1m,i1m) == GREENLAND_VAL) {
+                if (include_greenland) {
+                    focean1m(j1m,i1m) = 0;
+                } else {
+                    focean1m(j1m,i1m) = 1;
+                }
 
-    // Remove Greenland from focean1m
-    for (int j1m=JM1m/2; j1m < JM1m; ++j1m) {
-    for (int i1m=0; i1m < IM1m; ++i1m) {
-        if (focean1m(j1m,i1m) == GREENLAND_VAL) {
-            if (include_greenland) {
-                focean1m(j1m,i1m) = 0;
-            } else {
-                focean1m(j1m,i1m) = 1;
+                // Check: can't have focean1m and fgice1m at the same time
+                if (focean1m(j1m,i1m) == 1) fgice1m(j1m,i1m) = 0;
             }
-
-            // Check: can't have focean1m and fgice1m at the same time
-            if (focean1m(i1m,j1m) == 1) fgice1m(i1m,j1m) = 0;
         }}
-    }
-
 
+        // Store focean1m, fgice1m
+        ncio_rows(nc_mutex, focean_out, 'w', focean1m);
+        ncio_rows(nc_mutex, fgice_out, 'w', fgice1m);
+        regrid_h(*hntrh, focean1m, valsh[2], valh_mutex);
+        regrid_h(*hntrh, fgice1m, valsh[3], valh_mutex);
+    };
+
+    // Run the bands, njob at a time
+    if (njob <= 0) njob = std::max(1u, std::thread::hardware_concurrency());
+    njob = std::min(njob, JM1);
+    std::atomic<int> next_band(0);
+    std::vector<std::exception_ptr> errors(njob);
+    auto worker = [&](int ijob) {
+        try {
+            for (int j1; (j1 = next_band++) < JM1; ) process_band(j1);
+        } catch(...) {
+            errors[ijob] = std::current_exception();
+            next_band = JM1;    // Don't start more bands
+        }
+    };
 
-    // Store zicetop1m, zsolid1m
-    {NcIO ncout(ofname_root + "1m.nc", 'a');
-        auto dims(get_or_add_dims(ncout, {"jm1m", "im1m"}, {JM1m, IM1m}));
-
-        NcVar ncvar;
-        ncvar = ncio_blitz(ncout, focean1m, "FOCEAN1m", "short", dims);
-        get_or_put_all_atts(ncvar, 'w', etopo1_atts.at("FOCEAN"));
-        ncvar.putAtt("units", "1");
-        ncvar.putAtt("source", include_greenland ? "ETOPO1" : "ETOPO1, Greenland removed");
+    std::vector<std::thread> threads;
+    for (int ijob=1; ijob<njob; ++ijob) threads.push_back(std::thread(worker, ijob));
+    worker(0);
+    for (auto &thread : threads) thread.join();
 
-        ncvar = ncio_blitz(ncout, fgice1m, "FGICE1m", "short", dims);
-        ncvar.putAtt("description", "Fractional ice cover (0 or 1)");
-        ncvar.putAtt("units", "1");
-        ncvar.putAtt("source", include_greenland ? "etopo1_ice.cpp output" : "etopo1_ice.cpp output, Greenland removed");
+    for (auto &error : errors) if (error) std::rethrow_exception(error);
+    ncout.close();
 
+    {NcIO nch(ofname_root + "h.nc", 'w');
+        auto dimsh(get_or_add_dims(nch, {"jmh", "imh"}, {JMH, IMH}));
+        for (size_t i=0; i<vnamesh.size(); ++i)
+            ncio_blitz(nch, valsh[i], vnamesh[i], "double", dimsh);
     }
-    store_h(nch, focean1m, "FOCEANh");
-    store_h(nch, fgice1m, "FGICEh");
-
 }
 
 // ============================================================
@@ -251,6 +301,7 @@ printf("j1 i1=%d %d (area = %g %g)\n", j1, i1, snow1, remain1m);
 struct ParseArgs {
     std::string ofname_root;
     bool greenland;
+    int njob;
 
     ParseArgs(int argc, char **argv);
 };
@@ -273,6 +324,10 @@ ParseArgs::ParseArgs(int argc, char **argv)
         TCLAP::UnlabeledValueArg<std::string> ofname_root_a(
             "ofname-root", "Root name of output file (without resolution marker or .nc)", true, "etopo1_ice", "output filename", cmd);
         TCLAP::SwitchArg greenland_a("g", "greenland", "Include Greenland?", cmd, false);
+        TCLAP::ValueArg<int> njob_a("j", "jobs",
+            "Number of 1-degree latitude bands to process at once"
+            " (0 = number of cores).  Each uses about 20Mb.",
+            false, 0, "number of jobs", cmd);
 
         // Parse the argv array.
         cmd.parse( argc, argv );
@@ -280,6 +335,7 @@ ParseArgs::ParseArgs(int argc, char **argv)
         // Get the value parsed by each arg.
         ofname_root = ofname_root_a.getValue();
         greenland = greenland_a.getValue();
+        njob = njob_a.getValue();
 
     } catch (TCLAP::ArgException &e) { // catch any exceptions
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
@@ -294,5 +350,5 @@ int main(int argc, char** argv)
     ParseArgs args(argc, argv);
 
     // Read the input files
-    etopo1_ice(EnvSearchPath("MODELE_FILE_PATH"), args.greenland, args.ofname_root);
+    etopo1_ice(EnvSearchPath("MODELE_FILE_PATH"), args.greenland, args.ofname_root, args.njob);
 }
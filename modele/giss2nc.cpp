@@ -1,7 +1,14 @@
 // Convert GISS-format binary Fortran files to NetCDF
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include <boost/regex.hpp>
 #include <boost/algorithm/string.hpp>
@@ -141,20 +148,207 @@ void giss2nc(
     }
 }
 // ----------------------------------------------------------------------
+// Indexed mode: scan the record headers first, define all variables,
+// then decode and write the records in parallel.
+
+/** One record of a GISS file, located by scan_giss() */
+struct GissRecord {
+    long offset;    // Position of the array data (after titlei) in the file
+    Info info;
+    fortran::Shape<2> const *shape;
+
+    GissRecord(long _offset, Info const &_info, fortran::Shape<2> const *_shape)
+        : offset(_offset), info(_info), shape(_shape) {}
+};
+
+/** Reverses the bytes of each word in buf, if the file is not in
+host order. */
+static void swap_words(char *buf, size_t nword, size_t wordsize, Endian endian)
+{
+    uint16_t const one = 1;
+    bool const host_little = (*(char const *)&one == 1);
+    if (host_little == (endian == Endian::LITTLE)) return;
+    for (size_t i=0; i<nword; ++i)
+        std::reverse(buf + i*wordsize, buf + (i+1)*wordsize);
+}
+
+/** Builds an index of (titlei, array) records in a Fortran
+unformatted sequential file, seeking past the array data.  Assumes the
+usual 4-byte record markers. */
+template<class IType>
+std::vector<GissRecord> scan_giss(
+    std::string const &ifname,
+    Endian endian,
+    std::vector<std::string> const &names)
+{
+    std::vector<GissRecord> ret;
+    std::ifstream fin(ifname, std::ios::binary);
+    if (!fin) (*icebin_error)(-1, "Cannot open %s", ifname.c_str());
+
+    std::array<char, 80> titlei;
+    for (size_t i=0;; ++i) {
+        if (names.size() > 0 && i >= names.size()) break;
+
+        long const start = fin.tellg();
+        uint32_t len0, len1;
+        if (!fin.read((char *)&len0, sizeof(len0))) break;    // EOF
+        swap_words((char *)&len0, 1, sizeof(len0), endian);
+        if (len0 < titlei.size() || (len0 - titlei.size()) % sizeof(IType) != 0)
+            (*icebin_error)(-1, "%s: bad record of length %u at offset %ld",
+                ifname.c_str(), len0, start);
+        fin.read(&titlei[0], titlei.size());
+
+        // Find the shape, as fortran::allocate() would
+        long const nelem = (len0 - titlei.size()) / sizeof(IType);
+        fortran::Shape<2> const *data_shape = nullptr;
+        for (auto const &shape : stdshapes) {
+            if ((long)shape.shape[0] * shape.shape[1] == nelem) {
+                data_shape = &shape;
+                break;
+            }
+        }
+        if (!data_shape) (*icebin_error)(-1,
+            "%s: record %ld has %ld elements, which matches no known grid",
+            ifname.c_str(), (long)i, nelem);
+
+        long const offset = start + sizeof(len0) + titlei.size();
+        fin.seekg(offset + nelem * sizeof(IType));
+        fin.read((char *)&len1, sizeof(len1));
+        swap_words((char *)&len1, 1, sizeof(len1), endian);
+        if (!fin || len1 != len0) (*icebin_error)(-1,
+            "%s: record at offset %ld is truncated or has mismatched markers",
+            ifname.c_str(), start);
+
+        std::string const &use_name = (i < names.size() ? names[i] : "");
+        std::string titlei_cxx(fortran::trim(titlei));
+        Info info(parse_titlei(titlei_cxx, use_name));
+        if (info.name == "") {
+            fprintf(stderr,
+                "Cannot parse titlei='%s'; try using names parameter\n", titlei_cxx.c_str());
+            info.name = string_printf("var%02d", i);
+        }
+        ret.push_back(GissRecord(offset, info, data_shape));
+    }
+    return ret;
+}
+
+template<class IType, class OType>
+void giss2nc_indexed(
+    std::string const &ifname,
+    std::string const &ofname,
+    Endian endian,
+    std::vector<std::string> const &names,
+    int njob,
+    int deflate)
+{
+    std::vector<GissRecord> const records(scan_giss<IType>(ifname, endian, names));
+    printf("Indexed %ld records in %s\n", (long)records.size(), ifname.c_str());
+
+    NcIO ncio(ofname, 'w');
+
+    // Define all variables up front; one NcVar per record (or null if skipped)
+    std::vector<netCDF::NcVar> ncvars;
+    std::set<std::string> seen;
+    for (auto const &rec : records) {
+        ncvars.push_back(netCDF::NcVar());
+        if (rec.info.name == "_") continue;
+        if (!seen.insert(rec.info.name).second) (*icebin_error)(-1,
+            "Variable %s appears twice in %s; try using names parameter",
+            rec.info.name.c_str(), ifname.c_str());
+
+        // Fortran order in the file: NetCDF dims are (j,i)
+        auto const &shape(*rec.shape);
+        auto dims(get_or_add_dims(ncio,
+            {shape.sshape[1], shape.sshape[0]},
+            {(long)shape.shape[1], (long)shape.shape[0]}));
+        netCDF::NcVar ncvar(ncio.nc->addVar(rec.info.name, get_nc_type<OType>(), dims));
+
+        // Chunks of whole rows, about 1Mb each
+        size_t const im = shape.shape[0];
+        size_t const jm = shape.shape[1];
+        std::vector<size_t> chunks {
+            std::max((size_t)1, std::min(jm, (1<<20) / (im*sizeof(OType)))), im};
+        ncvar.setChunking(netCDF::NcVar::nc_CHUNKED, chunks);
+        if (deflate > 0) ncvar.setCompression(true, true, deflate);
+
+        get_or_put_att(ncvar, ncio.rw, "description", rec.info.description);
+        get_or_put_att(ncvar, ncio.rw, "units", rec.info.units);
+        get_or_put_att(ncvar, ncio.rw, "source", rec.info.source);
+        ncvars.back() = ncvar;
+    }
+
+    // Decode in parallel; NetCDF calls are serialized
+    njob = std::max(1, std::min(njob, (int)records.size()));
+    std::atomic<size_t> next_rec(0);
+    std::vector<std::exception_ptr> errors(njob);
+    std::mutex nc_mutex;
+
+    auto worker = [&](int ijob) {
+        try {
+            std::ifstream fin(ifname, std::ios::binary);
+            std::vector<IType> ibuf;
+            std::vector<OType> obuf;
+            for (size_t irec; (irec = next_rec++) < records.size(); ) {
+                GissRecord const &rec(records[irec]);
+                if (rec.info.name == "_") continue;
+
+                size_t const n = (size_t)rec.shape->shape[0] * rec.shape->shape[1];
+                ibuf.resize(n);
+                fin.seekg(rec.offset);
+                if (!fin.read((char *)&ibuf[0], n*sizeof(IType))) (*icebin_error)(-1,
+                    "Error reading %s from %s", rec.info.name.c_str(), ifname.c_str());
+                swap_words((char *)&ibuf[0], n, sizeof(IType), endian);
+                obuf.assign(ibuf.begin(), ibuf.end());
+
+                std::lock_guard<std::mutex> lock(nc_mutex);
+                ncvars[irec].putVar(&obuf[0]);
+                printf("Wrote variable named %s: description=\"%s\"\n",
+                    rec.info.name.c_str(), rec.info.description.c_str());
+            }
+        } catch(...) {
+            errors[ijob] = std::current_exception();
+            next_rec = records.size();    // Don't start more records
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int ijob=1; ijob<njob; ++ijob) threads.push_back(std::thread(worker, ijob));
+    worker(0);
+    for (auto &thread : threads) thread.join();
+
+    for (auto &error : errors) if (error) std::rethrow_exception(error);
+}
+
+/** Selects the sequential or indexed converter */
+template<class IType, class OType>
+void giss2nc_select(
+    std::string const &ifname,
+    std::string const &ofname,
+    Endian endian,
+    std::vector<std::string> const &names,
+    int njob,
+    int deflate)
+{
+    if (njob == 0) giss2nc<IType,OType>(ifname, ofname, endian, names);
+    else giss2nc_indexed<IType,OType>(ifname, ofname, endian, names, njob, deflate);
+}
+// ----------------------------------------------------------------------
 // Build multiple instantiations of giss2nc(), let user choose at runtime.
 typedef std::map<std::string,
     std::function<void(
         std::string const &ifname,
         std::string const &ofname,
         Endian endian,
-        std::vector<std::string> const &names)>>
+        std::vector<std::string> const &names,
+        int njob,
+        int deflate)>>
 Giss2NcMap;
 
 Giss2NcMap make_giss2nc_map()
 {
     Giss2NcMap ret;
-    ret.insert(std::make_pair("float-double", &giss2nc<float,double>));
-    ret.insert(std::make_pair("int16", &giss2nc<int16_t,int16_t>));
+    ret.insert(std::make_pair("float-double", &giss2nc_select<float,double>));
+    ret.insert(std::make_pair("int16", &giss2nc_select<int16_t,int16_t>));
     return ret;
 }
 Giss2NcMap giss2nc_map(make_giss2nc_map());
@@ -167,6 +361,7 @@ int main(int argc, char **argv)
     Endian endian;
     std::vector<std::string> names;
     std::string stype;
+    int njob, deflate;
 
     try {
 	    po::options_description desc("Allowed options");
@@ -178,6 +373,10 @@ int main(int argc, char **argv)
             ("type", po::value<string>()->default_value("float-double"),
                 "Data type of (a) Fortran input, (b) NetCDF output [float-double | int16]")
             ("names", po::value<string>()->default_value(""), "(OPTIONAL) comma-separated variable names")
+            ("jobs,j", po::value<int>()->default_value(0),
+                "Index the file first, then convert records with this many threads (-1 = one per core); 0 = read sequentially")
+            ("deflate", po::value<int>()->default_value(4),
+                "NetCDF deflate level used with --jobs (0 = no compression)")
 	    ;
 
 	    po::positional_options_description positional;
@@ -204,6 +403,9 @@ int main(int argc, char **argv)
         ofname = vm["output-file"].as<std::string>();
         endian = vm["endian"].as<Endian>();
         stype = vm["type"].as<std::string>();
+        njob = vm["jobs"].as<int>();
+        if (njob < 0) njob = std::max(1u, std::thread::hardware_concurrency());
+        deflate = vm["deflate"].as<int>();
 
         std::string snames = vm["names"].as<std::string>();
         if (snames != "")
@@ -217,6 +419,6 @@ int main(int argc, char **argv)
     printf("ARGS: %s %s\n", ifname.c_str(), ofname.c_str());
 
     auto _giss2nc(giss2nc_map.at(stype));
-    _giss2nc(ifname, ofname, endian, names);
+    _giss2nc(ifname, ofname, endian, names, njob, deflate);
 }
 
@@ -25,6 +25,12 @@ Regular earth has
 
 #include <string>
 #include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -52,6 +58,8 @@ Regular earth has
 #include <icebin/gridgen/GridGen_LonLat.hpp>
 #include <icebin/modele/global_ec.hpp>
 #include <icebin/ElevMask.hpp>
+#include <icebin/nc_layout.hpp>
+#include <icebin/netcdf_mutex.hpp>
 
 using namespace std;
 using namespace ibmisc;
@@ -95,11 +103,6 @@ static int div_to_nearest(int n, int d) {
 // ----------------------------------------------------------------
 
 
-// This parameter controls memory use.  Larger = more memory, smaller = more segments
-// static int const chunk_size = 4000000;    // Not a hard limit
-static int const chunk_size = 4000000*3;    // Not a hard limit
-
-
 // ==========================================================
 struct ParseArgs {
     HntrSpec hspecO;    // Name of Hntr Spec for Ocean grid
@@ -128,6 +131,15 @@ struct ParseArgs {
     int chunk_no=-1;
     std::array<std::array<int,2>,2> chunk_range;    // {{x0,y0},{x1,y1}}
 
+    // This parameter controls memory use.  Larger = more memory, smaller = more segments
+    long chunk_size;    // Ice grid cells per chunk; not a hard limit
+
+    // Number of chunks to run at once, in this process (0 = write a makefile instead)
+    int njob;
+
+    // Deflate level for the output matrices (0 = no compression)
+    int deflate;
+
     // Generate matrices for "mismatched" or standard regridding?
     GCMGridOption gcm_grid_option = GCMGridOption::mismatched;
 
@@ -229,6 +241,20 @@ ParseArgs::ParseArgs(int argc, char **argv)
             "Runs on ice over a segmenet of fgiceO (not for end-user use)",
             false, "", "O cell range", cmd);
 
+        TCLAP::ValueArg<long> chunk_size_a("", "chunk-size",
+            "Approximate number of ice grid cells per chunk; memory use grows with it",
+            false, 4000000*3, "ice cells", cmd);
+
+        TCLAP::ValueArg<int> njob_a("j", "jobs",
+            "Run the chunks in this process, this many at a time, then combine them."
+            "  Memory use is about jobs times that of one chunk."
+            "  0 = write a makefile to run them instead",
+            false, 0, "number of jobs", cmd);
+
+        TCLAP::ValueArg<int> deflate_a("", "deflate",
+            "Deflate level (0-9) for the output NetCDF files; 0 = no compression",
+            false, 4, "level", cmd);
+
 
         // Not needed for spherical grids
         // TCLAP::SwitchArg correctA_a("c", "correct",
@@ -262,6 +288,14 @@ ParseArgs::ParseArgs(int argc, char **argv)
 
         matrix_names = split<std::string>(matrix_names_a.getValue(), ",");
 
+        chunk_size = chunk_size_a.getValue();
+        njob = njob_a.getValue();
+        if (njob < 0) (*icebin_error)(-1,
+            "--jobs must be non-negative: %d", njob);
+        deflate = deflate_a.getValue();
+        if (deflate < 0 || deflate > 9) (*icebin_error)(-1,
+            "--deflate must be between 0 and 9: %d", deflate);
+
         std::string srunchunk(runchunk_a.getValue());
         if (srunchunk == "") {
             run_chunk = false;
@@ -323,15 +357,6 @@ if (sz % 100000 == 0) printf("exgrid size=%d\n", sz);
     }
 };
 
-void nocompress_configure_var(netCDF::NcVar ncvar)
-{
-    ncvar.setCompression(true, true, 4);
-
-    // For some reason, this causes an HDF5 error
-    // ncvar.setChecksum(netCDF::NcVar::nc_FLETCHER32);
-}
-
-
 /** Helper for Hntr::overlap() */
 class ElevMaskClip {
     blitz::Array<double,1> const elevmaskI;
@@ -354,10 +379,10 @@ linear::Weighted_Eigen make_I2vX(
 {
 
     // I2vI: Convert to plottable global ice grid
-    Hntr hntr_IvI2(17.17, args.hspecI, args.hspecI2);
+    auto const hntr_IvI2(cached_hntr(17.17, args.hspecI, args.hspecI2));
     EigenSparseMatrixT I2vI(MakeDenseEigenT(
         std::bind(&Hntr::overlap<MakeDenseEigenT::AccumT,ElevMaskClip>,
-            &hntr_IvI2, std::placeholders::_1, args.eq_rad, ElevMaskClip(elevmaskI)),
+            hntr_IvI2.get(), std::placeholders::_1, args.eq_rad, ElevMaskClip(elevmaskI)),
         {SparsifyTransform::TO_DENSE_IGNORE_MISSING, SparsifyTransform::ADD_DENSE},
         {&dimI, &dimI2}, 'T').to_eigen());
 
@@ -388,7 +413,7 @@ std::unique_ptr<GCMRegridder_Standard> new_gcmA_standard(
     ExchangeGrid aexgrid;    // Put our answer in here
 
     auto const &hspecI(args.hspecI);
-    modele::Hntr hntr(17.17, hspecA, hspecI);
+    auto const hntr(modele::cached_hntr(17.17, hspecA, hspecI));
 
 
     // -------------------------------------------------------------
@@ -397,7 +422,7 @@ std::unique_ptr<GCMRegridder_Standard> new_gcmA_standard(
     // Compute overlaps for cells with ice
     SparseSet<long,int> _dimA;    // Only include A grid cells with ice
     SparseSet<long,int> _dimI;    // Only include I grid cells with ice
-    hntr.overlap(ExchAccum(aexgrid, reshape1(elevmaskI), _dimA, _dimI), args.eq_rad);
+    hntr->overlap(ExchAccum(aexgrid, reshape1(elevmaskI), _dimA, _dimI), args.eq_rad);
 
     // -------------------------------------------------------------
     printf("---- Creating gcmA for %s\n", grid_name.c_str());
@@ -492,6 +517,7 @@ std::unique_ptr<GCMRegridder> new_gcmA_mismatched(
         blitz::Array<double,2> foceanfO(hspecO.jm, hspecO.im);    // called FOCEANF in make_topoo
 
         printf("---- Reading FOCEAN: %s\n", fname.c_str());
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
         NcIO ncio(fname, 'r');
         ncio_blitz(ncio, foceanO, "FOCEAN", "double", {});
         ncio_blitz(ncio, foceanfO, "FOCEANF", "double", {});
@@ -522,28 +548,32 @@ void global_ec_section(GCMRegridder &gcmA, ParseArgs &args,
     SparseSet<long,int> dimA, dimI, dimE;
     SparseSet<long,int> dimI2;
 
-    auto nocompress(
-            std::bind(nocompress_configure_var, std::placeholders::_1));
+    auto const configure_var(NcLayout(args.deflate).configure_var());
 
 
     std::string ofname(strprintf("%s-%02d", args.ofname.c_str(), args.chunk_no));
 
     dimI2.set_sparse_extent(hspecI2.size());
 
+    // ice_regridder() may load the sheet, under icebin::netcdf_mutex:
+    // so call it before taking that mutex below
+    IceRegridder const *ice(gcmA.ice_regridder(0));
+
     HntrSpec hspecA(cast_GridSpec_LonLat(
         *gcmA.agridA->spec).hntr);
     HntrSpec hspecI(cast_GridSpec_LonLat(
-        *gcmA.ice_regridders()[0]->agridI.spec).hntr);
+        *ice->agridI.spec).hntr);
 
 
-    {NcIO ncio(ofname, 'w', "nc4", nocompress);
+    {std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'w', "nc4", configure_var);
         global_ec::Metadata meta;
         meta.eq_rad = args.eq_rad;
         meta.gcm_grid_option = args.gcm_grid_option;
         meta.hspecA = hspecA;
         meta.hspecI = hspecI;
         meta.hspecI2 = hspecI2;
-        meta.indexingI = gcmA.ice_regridders()[0]->agridI.indexing;
+        meta.indexingI = ice->agridI.indexing;
         {HntrGrid hgridI2(hspecI2);
             meta.indexingI2 = hgridI2.indexing;
         }
@@ -563,76 +593,86 @@ void global_ec_section(GCMRegridder &gcmA, ParseArgs &args,
 
     std::string const &Achar (args.gcm_grid_option == GCMGridOption::ocean ? "O" : "A");
 
+    // Matrices are computed outside of icebin::netcdf_mutex, and written under it
     if (matrix_names_set.find("AvI") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating AvI\n");
         auto mat(rm->matrix_d("AvI", {&dimA, &dimI}, params));
         check_negative(*mat, "AvI");
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
         mat->ncio(ncio, Achar+"vI", {"dim"+Achar, "dimI"});
         ncio.flush();
     }
 
     if (matrix_names_set.find("EvI") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating EvI\n");
         auto mat(rm->matrix_d("EvI", {&dimE, &dimI}, params));
         check_negative(*mat, "EvI");
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
         mat->ncio(ncio, "EvI", {"dimE", "dimI"});
         ncio.flush();
     }
 
     if (matrix_names_set.find("IvE") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating IvE\n");
         auto mat(rm->matrix_d("IvE", {&dimI, &dimE}, params));
         check_negative(*mat, "IvE");
-        mat->ncio(ncio, "IvE", {"dimI", "dimE"});
-        ncio.flush();
 
         // Save smaller / more wieldly display version of the matrix
         auto mat2(make_I2vX(*mat, args, reshape1(elevmaskI), dimI2, dimI, dimE, params));
+
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
+        mat->ncio(ncio, "IvE", {"dimI", "dimE"});
+        ncio.flush();
         mat.release();
         mat2.ncio(ncio, "I2vE", {"dimI2", "dimE"});
         ncio.flush();
     }
 
     if (matrix_names_set.find("IvA") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating IvA\n");
         std::unique_ptr<ibmisc::linear::Weighted_Eigen> mat(
             rm->matrix_d("IvA", {&dimI, &dimA}, params));
         check_negative(*mat, "IvA");
-        mat->ncio(ncio, "Iv"+Achar, {"dimI", "dim"+Achar});
-        ncio.flush();
 
         // Save smaller / more wieldly display version of the matrix
         auto mat2(make_I2vX(*mat, args, reshape1(elevmaskI), dimI2, dimI, dimA, params));
+
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
+        mat->ncio(ncio, "Iv"+Achar, {"dimI", "dim"+Achar});
+        ncio.flush();
         mat.release();
         mat2.ncio(ncio, "I2v"+Achar, {"dimI2", "dim"+Achar});
         ncio.flush();
     }
 
     if (matrix_names_set.find("AvE") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating AvE\n");
         auto mat(rm->matrix_d("AvE", {&dimA, &dimE}, params));
         check_negative(*mat, "AvE");
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
         mat->ncio(ncio, Achar+"vE", {"dim"+Achar, "dimE"});
         ncio.flush();
     }
 
     if (matrix_names_set.find("EvA") != matrix_names_set.end()) {
-        NcIO ncio(ofname, 'a', "nc4", nocompress);
         printf("---- Generating EvA\n");
         auto mat(rm->matrix_d("EvA", {&dimE, &dimA}, params));
         check_negative(*mat, "EvA");
+        std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
         mat->ncio(ncio, "Ev"+Achar, {"dimE", "dim"+Achar});
         ncio.flush();
     }
 
     // Store the dimensions
     printf("---- Storing Dimensions\n");
-    {NcIO ncio(ofname, 'a', "nc4", nocompress);
+    {std::lock_guard<std::mutex> lock(icebin::netcdf_mutex);
+        NcIO ncio(ofname, 'a', "nc4", configure_var);
         NcVar ncv;
 
         ncv = dimA.ncio(ncio, "dim"+Achar);
@@ -685,6 +725,22 @@ void global_ec_section(FileLocator const &files, ParseArgs &args, blitz::Array<d
 
 
 
+/** Command line that combines the chunk files into the final output */
+std::string combine_command(
+    std::string const &ofname,
+    ParseArgs const &args,
+    std::vector<std::array<int,5>> const &chunks)
+{
+    std::string cmd("combine_global_ec --matrix-names ");
+    cmd += boost::algorithm::join(args.matrix_names, ",");
+
+    for (std::array<int,5> const &chunk : chunks)  {
+        std::string chunkno(strprintf("%02d", chunk[0]));
+        cmd += " " + ofname + "-" + chunkno;
+    }
+    return cmd;
+}
+
 void write_chunk_makefile(
     std::string const &ofname,
     std::vector<string> const &arg_strings,
@@ -704,14 +760,7 @@ void write_chunk_makefile(
     }
     fout << endl;
 
-    fout << "\tcombine_global_ec --matrix-names ";
-    fout << boost::algorithm::join(args.matrix_names, ",");
-
-    for (std::array<int,5> const &chunk : chunks)  {
-        std::string chunkno(strprintf("%02d", chunk[0]));
-        fout << " " << ofname << "-" << chunkno;
-    }
-    fout << endl << endl;
+    fout << "\t" << combine_command(ofname, args, chunks) << endl << endl;
 
 
     for (std::array<int,5> const &chunk : chunks) {
@@ -730,6 +779,100 @@ void write_chunk_makefile(
     printf("Done writing chunk-generating makefile.  Run with the command:\n    make -f %s.mk\n", ofname.c_str());
 }
 
+/** Sets elevmaskI to the ice under O grid cells in
+[chunk_range[0], chunk_range[1]) (row-major order), NaN elsewhere. */
+void chunk_elevmaskI(
+    blitz::Array<double,2> &elevmaskI,    // OUT
+    ParseArgs const &args,
+    std::array<std::array<int,2>,2> const &chunk_range,
+    blitz::Array<double,2> const &fgiceO,
+    blitz::Array<int16_t,2> const &fgiceI,
+    blitz::Array<int16_t,2> const &elevI)
+{
+    auto const &hspecI(args.hspecI);
+    auto const &hspecO(args.hspecO);
+    int const mult_i = hspecI.im / hspecO.im;
+    int const mult_j = hspecI.jm / hspecO.jm;
+
+    elevmaskI = NaN;
+
+    // Upper bound
+    int const jO1 = chunk_range[1][0];
+    int const iO1 = chunk_range[1][1];
+    int const ijO1 = jO1 * hspecO.im + iO1;
+
+    // Set up elevmaskI for the specified range of O grid cells
+    int iO = chunk_range[0][1];    // Where we start scanning in fgiceO
+    int jO = chunk_range[0][0];
+    int ijO = jO * hspecO.im + iO;
+//printf("elevmaskI: iO=%d, jO=%d, ijO=%d\n", iO, jO, ijO);
+printf("Range: [%d %d] - [%d %d]\n", jO, iO, jO1, iO1);
+    printf("BEGIN O(%d, %d)\n", jO, iO);
+    for (; ; ++jO) {
+        for (; iO < hspecO.im; ++iO, ++ijO) {
+            if (ijO >= ijO1) goto endscan;    // Double break
+
+            if (fgiceO(jO, iO) != 0) {
+//printf("fgiceO(%d,%d)\n", jO, iO);
+                // Add these I grid cells to elevmaskI
+                for (int jI=jO*mult_j; jI<(jO+1)*mult_j; ++jI) {
+                for (int iI=iO*mult_i; iI<(iO+1)*mult_i; ++iI) {
+//printf("elevmaskI(%d,%d) = %d %d\n", jI, iI, fgiceI(jI,iI), elevI(jI,iI));
+                    if (fgiceI(jI,iI)) {
+                        elevmaskI(jI,iI) = elevI(jI,iI);
+                    }
+                }}
+            }
+        }
+        iO = 0;
+    }
+endscan: ;
+    printf("END O(%d, %d)\n", jO, iO);
+}
+
+/** Runs all chunks in this process, args.njob at a time, on inputs
+that have been read just once.  Replaces running the makefile from
+write_chunk_makefile(), which re-reads the inputs for every chunk and
+must run them one at a time. */
+void run_chunks(
+    FileLocator const &files,
+    ParseArgs const &args,
+    std::vector<std::array<int,5>> const &chunks,
+    blitz::Array<double,2> const &fgiceO,
+    blitz::Array<int16_t,2> const &fgiceI,
+    blitz::Array<int16_t,2> const &elevI)
+{
+    int const njob = std::min(args.njob, (int)chunks.size());
+    std::atomic<size_t> next_chunk(0);
+    std::vector<std::exception_ptr> errors(njob);
+
+    auto worker = [&](int ijob) {
+        try {
+            for (size_t ic; (ic = next_chunk++) < chunks.size(); ) {
+                std::array<int,5> const &chunk(chunks[ic]);
+                ParseArgs cargs(args);
+                cargs.run_chunk = true;
+                cargs.chunk_no = chunk[0];
+                cargs.chunk_range = {{{chunk[1], chunk[2]}, {chunk[3], chunk[4]}}};
+
+                printf("============= Job %d running chunk %d\n", ijob, chunk[0]);
+                blitz::Array<double,2> elevmaskI(args.hspecI.jm, args.hspecI.im);
+                chunk_elevmaskI(elevmaskI, cargs, cargs.chunk_range, fgiceO, fgiceI, elevI);
+                global_ec_section(files, cargs, elevmaskI);
+            }
+        } catch(...) {
+            errors[ijob] = std::current_exception();
+            next_chunk = chunks.size();    // Don't start more chunks
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int ijob=1; ijob<njob; ++ijob) threads.push_back(std::thread(worker, ijob));
+    worker(0);
+    for (auto &thread : threads) thread.join();
+
+    for (auto &error : errors) if (error) std::rethrow_exception(error);
+}
 
 
 int main(int argc, char **argv)
@@ -776,8 +919,8 @@ int main(int argc, char **argv)
 
         // Generate fgiceO
         auto wtI(const_array(fgiceI.shape(), 1.0));
-        Hntr hntrOvI(17.17, args.hspecO, args.hspecI);
-        hntrOvI.regrid(wtI, fgiceI, fgiceO);
+        auto const hntrOvI(cached_hntr(17.17, args.hspecO, args.hspecI));
+        hntrOvI->regrid(wtI, fgiceI, fgiceO);
 
 #if 0
         // Generate elevA
@@ -820,40 +963,7 @@ int main(int argc, char **argv)
 
         // Choose the ice to process on this chunk
         blitz::Array<double,2> elevmaskI(hspecI.jm, hspecI.im);
-        elevmaskI = NaN;
-
-        // Upper bound
-        int const jO1 = args.chunk_range[1][0];
-        int const iO1 = args.chunk_range[1][1];
-        int const ijO1 = jO1 * hspecO.im + iO1;
-
-        // Set up elevmaskI for the specified range of O grid cells
-        int iO = args.chunk_range[0][1];    // Where we start scanning in fgiceO
-        int jO = args.chunk_range[0][0];
-        int ijO = jO * hspecO.im + iO;
-//printf("elevmaskI: iO=%d, jO=%d, ijO=%d\n", iO, jO, ijO);
-printf("Range: [%d %d] - [%d %d]\n", jO, iO, jO1, iO1);
-        printf("BEGIN O(%d, %d)\n", jO, iO);
-        for (; ; ++jO) {
-            for (; iO < hspecO.im; ++iO, ++ijO) {
-                if (ijO >= ijO1) goto endscan;    // Double break
-
-                if (fgiceO(jO, iO) != 0) {
-//printf("fgiceO(%d,%d)\n", jO, iO);
-                    // Add these I grid cells to elevmaskI
-                    for (int jI=jO*mult_j; jI<(jO+1)*mult_j; ++jI) {
-                    for (int iI=iO*mult_i; iI<(iO+1)*mult_i; ++iI) {
-//printf("elevmaskI(%d,%d) = %d %d\n", jI, iI, fgiceI(jI,iI), elevI(jI,iI));
-                        if (fgiceI(jI,iI)) {
-                            elevmaskI(jI,iI) = elevI(jI,iI);
-                        }
-                    }}
-                }
-            }
-            iO = 0;
-        }
-    endscan: ;
-        printf("END O(%d, %d)\n", jO, iO);
+        chunk_elevmaskI(elevmaskI, args, args.chunk_range, fgiceO, fgiceI, elevI);
         fgiceI.free();
         elevI.free();
 
@@ -882,7 +992,7 @@ printf("Range: [%d %d] - [%d %d]\n", jO, iO, jO1, iO1);
                         for (int iI=iO*mult_i; iI<(iO+1)*mult_i; ++iI) {
                             if (fgiceI(jI,iI)) ++nice;
                         }}
-                        if (nice >= chunk_size) goto endscan2;    // double break
+                        if (nice >= args.chunk_size) goto endscan2;    // double break
                     }
                 }
                 iO = 0;
@@ -893,8 +1003,20 @@ printf("Range: [%d %d] - [%d %d]\n", jO, iO, jO1, iO1);
         }
 
 
-        // Create a makefile
-        write_chunk_makefile(args.ofname, arg_strings, args, chunks);
+        if (args.njob > 0) {
+            // Run the chunks here, then combine them
+            run_chunks(files, args, chunks, fgiceO, fgiceI, elevI);
+            fgiceI.free();
+            elevI.free();
+
+            std::string const cmd(combine_command(args.ofname, args, chunks));
+            printf("---- Combining chunks: %s\n", cmd.c_str());
+            if (std::system(cmd.c_str()) != 0) (*icebin_error)(-1,
+                "Command failed: %s", cmd.c_str());
+        } else {
+            // Create a makefile
+            write_chunk_makefile(args.ofname, arg_strings, args, chunks);
+        }
     }
 
     return 0;
@@ -0,0 +1,310 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** Replays the GCM outputs logged by a ModelE run (gcm-out-*.nc)
+through GCMCoupler_ModelE::couple(), without ModelE, and reports the
+time taken by each coupling step.  Run from the ModelE run directory
+(or a copy of its config/ and the files named there), so coupler
+performance can be worked on against production-shaped data.
+
+The run must have been logged (icebin_logging), which also records
+the GCM's contract in gcm-contract.nc.  The first file is coupled as
+the cold start (run_ice=false), the rest as ordinary steps.  The ice
+models are those in the IceBin config (eg PISM; run under mpirun as
+for ModelE), or else a stub (--stub) that only returns elevation
+masks. */
+
+#include <mpi.h>        // Intel MPI wants to be first
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <tclap/CmdLine.h>
+#include <boost/filesystem.hpp>
+#include <ibmisc/netcdf.hpp>
+#include <ibmisc/datetime.hpp>
+#include <everytrace.h>
+#include <icebin/modele/GCMCoupler_ModelE.hpp>
+#include <icebin/contracts/contracts.hpp>
+#include <icebin/profile.hpp>
+
+using namespace icebin;
+using namespace icebin::modele;
+using namespace ibmisc;
+
+static double const nan = std::numeric_limits<double>::quiet_NaN();
+
+/** Command line arguments */
+struct ParseArgs {
+    /** gcm-out-*.nc files to replay, in time order */
+    std::vector<std::string> gcm_out_fnames;
+
+    std::string config_fname;       // IceBin config (as for gcmce_new())
+    std::string contract_fname;     // Written by GCMCoupler::model_start()
+    std::string constants_fname;    // Written by ModelE
+
+    /** If set, use IceCoupler_Stub with elevation masks from this file */
+    std::string stub_fname;
+
+    int im, jm;         // ModelE grid
+    int year;           // Start of the run's calendar (yeari)
+    double dtsrc;
+    int nstep;          // Steps to replay; <0 for all
+    bool logging;       // Write IceBin logs again (into the current directory)
+    std::string ofname; // Per-step timings (JSON lines)
+
+    ParseArgs(int argc, char **argv);
+};
+
+ParseArgs::ParseArgs(int argc, char **argv)
+{
+    try {
+        TCLAP::CmdLine cmd("Replays logged GCM outputs through the IceBin coupler", ' ', "<no-version>");
+
+        TCLAP::UnlabeledMultiArg<std::string> gcm_out_a("gcm-out",
+            "GCM output logs (gcm-out-*.nc), in time order",
+            true, "file", cmd);
+        TCLAP::ValueArg<std::string> config_a("c", "config",
+            "IceBin config file", false, "config/icebin.nc", "file", cmd);
+        TCLAP::ValueArg<std::string> contract_a("k", "contract",
+            "GCM contract, written alongside the logs", false, "gcm-contract.nc", "file", cmd);
+        TCLAP::ValueArg<std::string> constants_a("C", "constants",
+            "Constants file written by ModelE", false, "log/constants.nc", "file", cmd);
+        TCLAP::ValueArg<std::string> stub_a("s", "stub",
+            "Use a stub ice model, returning <sheet>.elevmask_ice and <sheet>.elevmask_land"
+            " (or elevmaskI.<sheet> for both) from this file; either (nI) or (time, nI),"
+            " one record per step",
+            false, "", "file", cmd);
+        TCLAP::ValueArg<int> im_a("i", "im",
+            "Longitudes in the ModelE grid", false, 144, "n", cmd);
+        TCLAP::ValueArg<int> jm_a("j", "jm",
+            "Latitudes in the ModelE grid", false, 90, "n", cmd);
+        TCLAP::ValueArg<int> year_a("y", "year",
+            "First year of the run (yeari); times in the logs count from it",
+            false, 1950, "year", cmd);
+        TCLAP::ValueArg<double> dtsrc_a("d", "dtsrc",
+            "ModelE physics timestep [s]", false, 1800., "seconds", cmd);
+        TCLAP::ValueArg<int> nstep_a("n", "nstep",
+            "Number of steps to replay (default: all)", false, -1, "n", cmd);
+        TCLAP::SwitchArg logging_a("L", "logging",
+            "Write the IceBin logs as the run did, into the current directory"
+            " (which should not hold the logs being replayed)", cmd, false);
+        TCLAP::ValueArg<std::string> ofname_a("o", "out",
+            "Write per-step timings here (JSON lines), as well as to stdout",
+            false, "", "file", cmd);
+
+        cmd.parse(argc, argv);
+
+        gcm_out_fnames = gcm_out_a.getValue();
+        config_fname = config_a.getValue();
+        contract_fname = contract_a.getValue();
+        constants_fname = constants_a.getValue();
+        stub_fname = stub_a.getValue();
+        im = im_a.getValue();
+        jm = jm_a.getValue();
+        year = year_a.getValue();
+        dtsrc = dtsrc_a.getValue();
+        nstep = nstep_a.getValue();
+        logging = logging_a.getValue();
+        ofname = ofname_a.getValue();
+    } catch (TCLAP::ArgException &e) { // catch any exceptions
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        exit(1);
+    }
+}
+
+// =============================================================================
+/** Stand-in ice model: takes no input, and returns only elevation
+masks, read (on root) from a file; everything it passes on to the
+GCM is zero.  Enough to exercise the coupler's regridding, E1vE0c and
+topography, without an ice model. */
+class IceCoupler_Stub : public IceCoupler
+{
+    std::string elevmask_fname;
+    size_t irec = 0;    // Record to return next
+
+public:
+    IceCoupler_Stub(IceCoupler::Params const &_params, std::string const &_elevmask_fname) :
+        IceCoupler(IceCoupler::Type::DISMAL, _params), elevmask_fname(_elevmask_fname) {}
+
+    void icemodel_rsf(std::string const &fname, char rw) {}
+
+    void _model_start(
+        bool cold_start,
+        ibmisc::Datetime const &time_base,
+        double time_start_s)
+    {
+        VarSet &ice_output(contract[OUTPUT]);
+        unsigned const flags = contracts::INITIAL | contracts::ALLOW_NAN | contracts::ROOT;
+        standard_names[OUTPUT]["elevmask_ice"] =
+            ice_output.add("elevmask_ice", nan, "", "", flags,
+                "Elevation of ice sheet; nan for grid cells off ice sheet.");
+        standard_names[OUTPUT]["elevmask_land"] =
+            ice_output.add("elevmask_land", nan, "", "", flags,
+                "Elevation of bare land+ice; nan for grid cells off land or ice (eg ocean).");
+
+        // All-zero transformations
+        var_trans_inE.set_dims(
+            contract[INPUT].keys(),
+            gcm_coupler->gcm_outputsE.keys(),
+            gcm_coupler->scalars.keys());
+        var_trans_outAE[GridAE::A].set_dims(
+            gcm_coupler->gcm_inputs[(int)IndexAE::A].keys(),
+            ice_output.keys(),
+            gcm_coupler->scalars.keys());
+        var_trans_outAE[GridAE::E].set_dims(
+            gcm_coupler->gcm_inputs[(int)IndexAE::E].keys(),
+            ice_output.keys(),
+            gcm_coupler->scalars.keys());
+    }
+
+    void run_timestep(double time_s,
+        blitz::Array<double,2> const &ice_ivalsI,
+        blitz::Array<double,2> &ice_ovalsI,
+        bool run_ice)
+    {
+        if (!gcm_coupler->am_i_root()) return;
+
+        NcIO ncio(elevmask_fname, 'r');
+        netCDF::NcVar vice(ncio.nc->getVar(name() + ".elevmask_ice"));
+        netCDF::NcVar vland(ncio.nc->getVar(name() + ".elevmask_land"));
+        if (vice.isNull() || vland.isNull())
+            vice = vland = ncio.nc->getVar("elevmaskI." + name());
+        if (vice.isNull()) (*icebin_error)(-1,
+            "Missing %s.elevmask_ice/elevmask_land or elevmaskI.%s in %s",
+            name().c_str(), name().c_str(), elevmask_fname.c_str());
+
+        for (auto const &v : {std::make_pair("elevmask_ice", vice), std::make_pair("elevmask_land", vland)}) {
+            blitz::Array<double,1> emI(ice_ovalsI(
+                standard_names[OUTPUT].at(v.first), blitz::Range::all()));
+            netCDF::NcVar const &ncvar(v.second);
+            if (ncvar.getDimCount() == 1) ncvar.getVar(emI.data());
+            else {
+                size_t const nrec = ncvar.getDim(0).getSize();
+                ncvar.getVar({std::min(irec, nrec-1), 0}, {1, (size_t)emI.extent(0)}, emI.data());
+            }
+        }
+        ++irec;
+    }
+};
+
+// =============================================================================
+int main(int argc, char **argv)
+{
+    everytrace_init();
+    ParseArgs args(argc, argv);
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int const root = 0;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // ----------- As gcmce_new(), with the whole domain on root
+    static ModelEParams rdparams;
+    rdparams.istart = 2;    // Cold start: no restart files
+    std::unique_ptr<GCMCoupler_ModelE> gcmce(
+        new GCMCoupler_ModelE(GCMParams(comm, root)));
+    GCMParams &gcm_params(gcmce->gcm_params);
+    gcmce->rdparams = &rdparams;
+    gcmce->domainA_global = ibmisc::Domain({0,0}, {args.im, args.jm});
+    gcmce->domainA = (rank == root ?
+        ibmisc::Domain({0,0}, {args.im, args.jm}) :
+        ibmisc::Domain({0,args.jm}, {args.im, args.jm}));    // Empty
+    gcm_params.icebin_config_fname = boost::filesystem::absolute(args.config_fname).string();
+    gcm_params.icebin_logging = args.logging;
+
+    if (args.stub_fname != "") {
+        std::string const stub_fname(args.stub_fname);
+        gcmce->make_ice_coupler = [stub_fname](
+            std::string const &sheet_name, IceCoupler::Params const &params)
+        {
+            return std::unique_ptr<IceCoupler>(new IceCoupler_Stub(params, stub_fname));
+        };
+    }
+
+    gcmce->ncread(gcm_params.icebin_config_fname, "m");
+    gcmce->dtsrc = args.dtsrc;
+
+    {std::vector<int> endj;
+        int endme = gcmce->domainA[1].end;
+        boost::mpi::gather<int>(gcm_params.world, &endme, 1, endj, root);
+        if (gcmce->am_i_root()) gcmce->domains.reset(
+            new DomainDecomposer_ModelE(endj, gcmce->domainA_global));
+    }
+
+    // ----------- What ModelE registered (gcmce_add_gcm_xxx(), gcmce_set_constant())
+    {NcIO ncio(args.contract_fname, 'r');
+        gcmce->ncio_contracts(ncio);
+        ncio.close();
+    }
+    {NcIO ncio(args.constants_fname, 'r');
+        gcmce->gcm_constants.read_nc(ncio.nc, "");
+    }
+
+    // ----------- Replay
+    ibmisc::Datetime const time_base(args.year, 1, 1);
+    gcmce->time_unit = TimeUnit(&cal365, time_base, TimeUnit::SECOND);    // For read_gcm_output()
+
+    size_t const nstep = (args.nstep < 0 ? args.gcm_out_fnames.size() :
+        std::min((size_t)args.nstep, args.gcm_out_fnames.size()));
+    std::unique_ptr<std::ofstream> fout;
+    if (rank == root && args.ofname != "") fout.reset(new std::ofstream(args.ofname));
+
+    double total_s = 0;
+    for (size_t step=0; step < nstep; ++step) {
+        std::string const &fname(args.gcm_out_fnames[step]);
+        VectorMultivec gcm_ovalsE(gcmce->gcm_outputsE.size());
+        std::array<double,2> timespan;
+        auto const t0(std::chrono::steady_clock::now());
+        if (rank == root) gcmce->read_gcm_output(fname, gcm_ovalsE, timespan);
+        MPI_Bcast(&timespan[0], 2, MPI_DOUBLE, root, comm);
+        double const time_s = timespan[1];
+
+        // Cold start: as gcmce_model_start()
+        if (step == 0) gcmce->model_start(true, time_base, time_s);
+
+        auto const t1(std::chrono::steady_clock::now());
+        GCMInput out(gcmce->couple(time_s, gcm_ovalsE, step > 0));
+        auto const t2(std::chrono::steady_clock::now());
+
+        if (rank != root) continue;
+        double const read_s = std::chrono::duration<double>(t1 - t0).count();
+        double const couple_s = std::chrono::duration<double>(t2 - t1).count();
+        total_s += couple_s;
+
+        char buf[1024];
+        snprintf(buf, sizeof(buf), "{\"step\": %ld, \"file\": \"%s\", \"time_s\": %.17g, "
+            "\"run_ice\": %s, \"nE\": %ld, \"read_s\": %g, \"couple_s\": %g, "
+            "\"nE1vE0c\": %ld, \"rss_mb\": %.1f}",
+            (long)step, fname.c_str(), time_s, (step > 0 ? "true" : "false"),
+            (long)gcm_ovalsE.size(), read_s, couple_s,
+            (long)out.E1vE0c.tuples.size(), profile::current_rss() / (1024.*1024.));
+        printf("replay %s\n", buf);
+        fflush(stdout);
+        if (fout) *fout << buf << std::endl;
+    }
+
+    if (rank == root) printf("replay: %ld steps, %g s coupling, peak RSS %.1f MiB\n",
+        (long)nstep, total_s, profile::peak_rss() / (1024.*1024.));
+
+    gcmce.reset();
+    MPI_Finalize();
+    return 0;
+}
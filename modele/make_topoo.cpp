@@ -10,6 +10,7 @@ using namespace icebin::modele;
 struct ParseArgs {
     std::string ofname;
     std::string et1mfile;
+    int band_rows;
 
     ParseArgs(int argc, char **argv);
 };
@@ -35,12 +36,18 @@ ParseArgs::ParseArgs(int argc, char **argv)
         TCLAP::UnlabeledValueArg<std::string> ofname_a(
             "ofname", "OUT: Name of output file", true, "", "output filename", cmd);
 
+        TCLAP::ValueArg<int> band_rows_a("", "band-rows",
+            "Process this many rows of the output grid at a time, to bound "
+            "memory use by the 1-minute inputs (0 = whole globe at once)",
+            false, 0, "rows", cmd);
+
         // Parse the argv array.
         cmd.parse( argc, argv );
 
         // Get the value parsed by each arg.
         et1mfile = et1mfile_a.getValue();
         ofname = ofname_a.getValue();
+        band_rows = band_rows_a.getValue();
     } catch (TCLAP::ArgException &e) { // catch any exceptions
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         exit(1);
@@ -62,7 +69,7 @@ int main(int argc, char** argv)
         "ZSOLG1m", args.et1mfile, "ZSOLG1m",
         "FOCEAN1m", args.et1mfile, "FOCEAN1m",
         "FLAKES", "Z10MX10M.nc", "FLAKES"
-    });
+    }, args.band_rows);
 
 
     // Print sanity check errors to STDERR
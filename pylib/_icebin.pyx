@@ -27,6 +27,8 @@ np.import_array()
 import scipy.sparse
 from cython.operator cimport dereference as deref, preincrement as inc
 from libcpp cimport bool
+from libcpp.string cimport string
+from libcpp.vector cimport vector
 import functools
 import operator
 import warnings
@@ -47,6 +49,15 @@ cdef split_shape(ashape, alen):
         functools.reduce(operator.mul, ashape[icut:], 1))
 
 
+cdef _arrays_to_scipy(arrays):
+    """Wraps the output of RegridMatrices_matrix_arrays() (without copying)"""
+    fmt, data, indices, indptr, shape, wM, Mw, dimB, dimA = arrays
+    if fmt == 'csr':
+        M = scipy.sparse.csr_matrix((data, indices, indptr), shape=shape, copy=False)
+    else:
+        M = scipy.sparse.csc_matrix((data, indices, indptr), shape=shape, copy=False)
+    return M, wM, Mw, (dimB, dimA)
+
 cdef class RegridMatrices:
     cdef cicebin.RegridMatrices *cself
 
@@ -68,12 +79,40 @@ cdef class RegridMatrices:
         returns: WeightedSparse
         """
         cdef cibmisc.linear_Weighted *lw
-        lw = cicebin.RegridMatrices_matrix(self.cself, spec_name.encode())
+        cdef string cspec_name = spec_name.encode()
+        with nogil:
+            lw = cicebin.RegridMatrices_matrix(self.cself, cspec_name)
         cdef ibmisc.linear_Weighted ret
         ret = ibmisc.linear_Weighted()
         ret.cself = lw
         return ret
 
+    def matrix_scipy(self, str spec_name):
+        """Compute a regrid matrix, without copying it into Python.
+        The result's arrays are read-only views of the C++ matrix,
+        which lives as long as any of them do.
+        spec_name:
+            As for matrix()
+        returns: (M, wM, Mw, (dimB, dimA))
+            M: scipy.sparse.csr_matrix (or csc_matrix), in dense indexing
+            wM, Mw: Weight vectors, in dense indexing
+            dimB, dimA: Sparse index of each dense row / column"""
+        return _arrays_to_scipy(
+            cicebin.RegridMatrices_matrix_arrays(self.cself, spec_name.encode()))
+
+    def stats(self):
+        """Size and cost of each matrix produced so far, in the order
+        produced (including the smoothing matrices of IvA / IvE).
+        returns: [dict]
+            name: Spec name (eg 'IvE'), or eg 'IvE:smoothI'
+            shape: (nrow, ncol)
+            nnz, nbytes: Number of elements, and storage [bytes]
+            row_hist: row_hist[0] = number of empty rows;
+                row_hist[k] = rows with 2**(k-1) <= nnz < 2**k
+            build_s: Wall time to build [s]
+            cache_hit: Was it copied from a matrix cache?"""
+        return cicebin.RegridMatrices_stats(self.cself)
+
 cdef class GCMRegridder:
     cdef cibmisc.shared_ptr[cicebin.GCMRegridder] cself
     cdef cibmisc.unique_ptr[cicebin.Grid] fgridA
@@ -164,6 +203,8 @@ cdef class GCMRegridder:
     def regrid_matrices(self, str sheet_name, elevmaskI,
         bool scale=True, bool correctA=True,
         sigma=(0,0,0), conserve=True):
+        """The GIL is released while the matrices are set up.  Calls
+        for different sheets (or GCMRegridders) may run concurrently."""
 
         elevmaskI = elevmaskI.reshape(-1)
         cdef cicebin.RegridMatrices *crm = \
@@ -174,6 +215,65 @@ cdef class GCMRegridder:
         rm.cself = crm
         return rm
 
+    def regrid_matrices_ensemble(self, str sheet_name, elevmaskIs, specs,
+        bool scale=True, bool correctA=True,
+        sigma=(0,0,0), conserve=True):
+        """Regrid matrices for many variants of elevmaskI at once.
+        Variants are computed in parallel (without the GIL), sharing
+        the work that does not depend on elevmaskI.
+        elevmaskIs: np.array[nvariant, nI]
+            One elevmaskI per row
+        specs: [str, ...]
+            Matrices to make for each variant (eg 'AvI', 'IvE')
+        returns: [{spec: (M, wM, Mw, (dimB, dimA)), ...}, ...]
+            One dict per variant; matrices as from
+            RegridMatrices.matrix_scipy()"""
+
+        elevmaskIs = np.ascontiguousarray(elevmaskIs, dtype='d')
+        elevmaskIs = elevmaskIs.reshape((elevmaskIs.shape[0], -1))
+        cdef vector[string] cspecs = [spec.encode() for spec in specs]
+        arrayss = cicebin.regrid_matrices_ensemble(self.cself.get(), sheet_name.encode(),
+            <PyObject *>elevmaskIs, cspecs,
+            scale, correctA, sigma[0], sigma[1], sigma[2], conserve)
+        return [{spec : _arrays_to_scipy(arrays) for spec, arrays in zip(specs, row)}
+            for row in arrayss]
+
+    def smoothing_matrix(self, str sheet_name, elevmaskI, wI, sigma, double tol=0):
+        """Gaussian smoothing matrix on an ice sheet's grid, as used by
+        the coupler to smooth IvA / IvE.  Computed in C++, without the
+        GIL, and returned without copying.
+        elevmaskI: np.array[nI]
+            Elevation of each ice cell; NaN where masked out
+        wI: np.array[nI]
+            Weight of each ice cell (eg wM of IvE, in sparse indexing).
+            Cells with no weight are not smoothed.
+        sigma: (sigma_x, sigma_y, sigma_z)
+            Scale of the Gaussian; sigma_z=np.inf for horizontal only.
+        tol:
+            Relative tolerance for dropping small entries from each row
+        returns: scipy.sparse.csc_matrix (or csr_matrix) [nI x nI]
+            Smoothed = M * unsmoothed"""
+
+        elevmaskI = np.ascontiguousarray(elevmaskI, dtype='d').reshape(-1)
+        wI = np.ascontiguousarray(wI, dtype='d').reshape(-1)
+        fmt, data, indices, indptr, shape = cicebin.smoothing_matrix_arrays(
+            self.cself.get(), sheet_name.encode(),
+            <PyObject *>elevmaskI, <PyObject *>wI,
+            sigma[0], sigma[1], sigma[2], tol)
+        if fmt == 'csr':
+            return scipy.sparse.csr_matrix((data, indices, indptr), shape=shape, copy=False)
+        else:
+            return scipy.sparse.csc_matrix((data, indices, indptr), shape=shape, copy=False)
+
+def read_grid_polygons(fname, vname, project=True):
+    """Reads a grid's cell outlines as flat arrays (for plotting).
+    project:
+        Convert x,y grids to lon/lat, using the grid's projection
+    returns: (x, y, offsets, index)
+        Vertices of the i'th cell (by index) are x[offsets[i]:offsets[i+1]]
+        and y[offsets[i]:offsets[i+1]]; index[i] is its index."""
+    return cicebin.read_grid_polygons(fname.encode(), vname.encode(), project)
+
 def read_elevmask(xfname):
     """Returns: (emI_land, emI_ice)"""
     return cicebin.read_elevmask(xfname.encode())
@@ -224,5 +324,6 @@ cdef class Hntr:
         self.cself = new cicebin.Hntr(17.17, Bgrid.cself[0], Agrid.cself[0], DATMIS)
 
     def regrid(self, WTA, A, bool mean_polar):
-        cicebin.Hntr_regrid(self.cself, WTA, A, mean_polar)
+        """Releases the GIL while regridding."""
+        return cicebin.Hntr_regrid(self.cself, WTA, A, mean_polar)
 
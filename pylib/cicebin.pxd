@@ -106,15 +106,32 @@ cdef extern from "icebin_cython.hpp" namespace "icebin::cython":
         string &exgrid_fname, string &exgrid_vname,
         string &sinterp_style) except +
 
+    # (Does not touch Python objects; called without the GIL)
     cdef cibmisc.linear_Weighted *RegridMatrices_matrix(
+        RegridMatrices *self, string spec_name) nogil except +
+
+    cdef object RegridMatrices_matrix_arrays(
         RegridMatrices *self, string spec_name) except +
 
+    cdef object RegridMatrices_stats(RegridMatrices *self) except +
+
     cdef Hntr_regrid(Hntr *hntr, object WTA_py, object A_py, bool mean_polar) except +
 
     cdef RegridMatrices *new_regrid_matrices(GCMRegridder *gcm, string &sheet_name, PyObject *elevmaskI_py,
         bool scale, bool correctA,
         double sigma_x, double sigma_y, double sigma_z, bool conserve) except +
 
+    cdef object regrid_matrices_ensemble(GCMRegridder *gcm, string &sheet_name,
+        PyObject *elevmaskIs_py, vector[string] &specs,
+        bool scale, bool correctA,
+        double sigma_x, double sigma_y, double sigma_z, bool conserve) except +
+
+    cdef object smoothing_matrix_arrays(GCMRegridder *gcm, string &sheet_name,
+        PyObject *elevmaskI_py, PyObject *wI_py,
+        double sigma_x, double sigma_y, double sigma_z, double tol) except +
+
+    cdef object read_grid_polygons(string &fname, string &vname, bool project) except +
+
     cdef object read_elevmask(string &xfname) except +
 
 cdef extern from "icebin/GridSpec.hpp" namespace "icebin":
@@ -24,6 +24,7 @@ import numpy as np
 import pyproj
 import functools
 import operator
+import icebin
 
 # -------------------------------------------------------
 class Indexing(object):
@@ -293,6 +294,44 @@ class Grid_LonLat(Grid):
             self.lon_boundaries, self.lat_boundaries,
             boundaries=True, transpose=(indexing.indices[0] == 0))
 
+# -------------------------------------------------------
+def polygon_outlines(x, y, offsets):
+    """Converts flat cell outlines (see icebin.read_grid_polygons())
+    into one line for Matplotlib: each cell is closed, and separated
+    from the next by a NaN (to lift the pen).
+    returns: (xdata, ydata)"""
+    ncell = len(offsets) - 1
+    nvertex = offsets[1:] - offsets[:-1]
+
+    # Each cell takes its vertices, plus its first vertex again, plus a NaN
+    out_offsets = offsets[:-1] + 2*np.arange(ncell)
+    n = len(x) + 2*ncell
+    xdata = np.full(n, np.nan)
+    ydata = np.full(n, np.nan)
+
+    ivertex = np.arange(len(x))
+    icell = np.repeat(np.arange(ncell), nvertex)
+    dest = ivertex + 2*icell
+    xdata[dest] = x
+    ydata[dest] = y
+
+    closing = out_offsets + nvertex
+    xdata[closing] = x[offsets[:-1]]
+    ydata[closing] = y[offsets[:-1]]
+    return xdata, ydata
+
+def plot_grid_file(basemap, fname, vname, **kwargs):
+    """Plots the outlines of a grid's cells, straight from a file.  The
+    cells are read, and projected to lon/lat, in C++; much faster than
+    read_nc() followed by Grid.plot() for large grids.
+    **kwargs: Any options passed through to Matplotlib plotting"""
+    if not use_basemap:
+        raise ImportError('matplotlib.basemap must be imported for this to work')
+
+    x, y, offsets, index = icebin.read_grid_polygons(fname, vname, project=True)
+    londata, latdata = polygon_outlines(x, y, offsets)
+    giss.basemap.plot(basemap, londata, latdata, **kwargs)
+
 # -------------------------------------------------------
 def read_nc(nc, vname, set_area=False):
     """Read the Grid from a netCDF file.
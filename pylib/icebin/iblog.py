@@ -0,0 +1,73 @@
+# IceBin: A Coupling Library for Ice Models and GCMs
+# Copyright (c) 2013-2016 by Elizabeth Fischer
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+# 
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+"""Reads IceBin coupler log files (gcm-in-*.nc, gcm-out-*.nc) written
+with <gcm>.info:sparse_logging = 1.  Each field there is stored as
+(time, nnz) values, next to an index variable holding the (1-D) grid
+index of each value.  Dense fields are reconstructed on demand.
+
+    python -m icebin.iblog gcm-in-19500101.nc dense.nc    # Densifies a whole file
+"""
+
+import sys
+import netCDF4
+import numpy as np
+
+def _open(nc):
+    return netCDF4.Dataset(nc) if isinstance(nc, str) else nc
+
+def sparse_vars(nc):
+    """Names of the sparse-logged fields in a file."""
+    nc = _open(nc)
+    return [vname for vname, var in nc.variables.items()
+        if 'sparse_index' in var.ncattrs()]
+
+def read_dense(nc, vname, fill=np.nan):
+    """Reconstructs one field of a sparse log file.
+    nc: Filename or open netCDF4.Dataset
+    Returns: Array of shape (time, <grid dims>), unset cells = fill"""
+    nc = _open(nc)
+    var = nc.variables[vname]
+    index_v = nc.variables[var.sparse_index]
+    nnz = int(index_v.nnz)
+    dims = index_v.dense_dims.split()
+    shape = [len(nc.dimensions[d]) for d in dims]
+
+    index = index_v[:,:nnz]
+    vals = var[:,:nnz]
+    dense = np.full((index.shape[0], int(np.prod(shape))), fill)
+    for it in range(index.shape[0]):
+        dense[it, index[it,:]] = vals[it,:]
+    return dense.reshape([index.shape[0]] + shape), dims
+
+def densify(ifname, ofname, fill=np.nan):
+    """Writes a dense copy of the sparse fields of a log file"""
+    with netCDF4.Dataset(ifname) as ncin, netCDF4.Dataset(ofname, 'w') as ncout:
+        for vname in sparse_vars(ncin):
+            dense, dims = read_dense(ncin, vname, fill=fill)
+            for dname, n in zip(['time'] + dims, dense.shape):
+                if dname not in ncout.dimensions:
+                    ncout.createDimension(dname, n)
+            var = ncin.variables[vname]
+            ovar = ncout.createVariable(vname, 'd', ['time'] + dims)
+            for att in ('units', 'description'):
+                if att in var.ncattrs():
+                    ovar.setncattr(att, var.getncattr(att))
+            ovar[:] = dense
+
+if __name__ == '__main__':
+    densify(sys.argv[1], sys.argv[2])
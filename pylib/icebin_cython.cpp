@@ -20,11 +20,14 @@
 #include <algorithm>
 #include <ibmisc/netcdf.hpp>
 #include <ibmisc/cython.hpp>
+#include <ibmisc/Proj2.hpp>
+#include <numpy/arrayobject.h>
 #include <spsparse/SparseSet.hpp>
 #include <icebin/IceRegridder.hpp>
 #include <icebin/GCMCoupler.hpp>
 #include <icebin/Grid.hpp>
 #include <icebin/ElevMask.hpp>
+#include <icebin/smoother.hpp>
 #ifdef BUILD_MODELE
 #include <icebin/modele/GCMCoupler_ModelE.hpp>
 #endif
@@ -39,6 +42,18 @@ using namespace icebin::modele;
 namespace icebin {
 namespace cython {
 
+/** Releases the Python GIL for its lifetime, so long C++ computations
+let other Python threads run.  No Python API may be used meanwhile.
+The GIL is re-acquired even if an exception is thrown. */
+class ReleaseGIL {
+    PyThreadState *state;
+public:
+    ReleaseGIL() : state(PyEval_SaveThread()) {}
+    ~ReleaseGIL() { PyEval_RestoreThread(state); }
+    ReleaseGIL(ReleaseGIL const &) = delete;
+    ReleaseGIL &operator=(ReleaseGIL const &) = delete;
+};
+
 static double const nan = std::numeric_limits<double>::quiet_NaN();
 
 void read_fgrid(
@@ -150,6 +165,7 @@ void GCMRegridder_add_sheet(GCMRegridder *cself,
         name, *cself->agridA, &fgridA,
         AbbrGrid(*fgridI), ExchangeGrid(*fexgrid),
         interp_style);
+    sheet->init_mesh(*fgridI, *fexgrid);
 
     dynamic_cast<GCMRegridder_Standard *>(cself)
         ->add_sheet(std::move(sheet));
@@ -197,6 +213,125 @@ extern linear::Weighted *RegridMatrices_matrix(RegridMatrices *cself, std::strin
     return cself->matrix(spec_name).release();
 }
 
+// ------------------------------------------------------------
+static char const *WEIGHTED_CAPSULE = "icebin.Weighted_Eigen";
+
+/** Frees the matrix that arrays from RegridMatrices_matrix_arrays() point into */
+static void delete_weighted_capsule(PyObject *capsule)
+{
+    delete (linear::Weighted_Eigen *)PyCapsule_GetPointer(capsule, WEIGHTED_CAPSULE);
+}
+
+static char const *EIGEN_CAPSULE = "icebin.EigenSparseMatrixT";
+
+static void delete_eigen_capsule(PyObject *capsule)
+{
+    delete (EigenSparseMatrixT *)PyCapsule_GetPointer(capsule, EIGEN_CAPSULE);
+}
+
+/** Read-only 1-D Numpy view of C++ memory, which owner keeps alive */
+static PyObject *np_view(void const *data, npy_intp n, int typenum, PyObject *owner)
+{
+    PyObject *arr = PyArray_SimpleNewFromData(1, &n, typenum, const_cast<void *>(data));
+    if (!arr) (*icebin_error)(-1, "Cannot create Numpy view");
+    PyArray_CLEARFLAGS((PyArrayObject *)arr, NPY_ARRAY_WRITEABLE);
+    Py_INCREF(owner);
+    PyArray_SetBaseObject((PyArrayObject *)arr, owner);   // Steals the reference
+    return arr;
+}
+
+static PyObject *np_view(blitz::Array<double,1> const &arr, PyObject *owner)
+{
+    if (arr.stride(0) != 1) (*icebin_error)(-1,
+        "Weight vector must be contiguous");
+    return np_view(arr.data(), arr.extent(0), NPY_DOUBLE, owner);
+}
+
+static PyObject *dim_to_np(SparseSetT const *dim)
+{
+    if (!dim) { Py_INCREF(Py_None); return Py_None; }
+    blitz::Array<long,1> d2s(dim->dense_extent());
+    for (int id=0; id<dim->dense_extent(); ++id) d2s(id) = dim->to_sparse(id);
+    return copy_blitz_to_np<long,1>(d2s);
+}
+
+/** Sets items 0-4 of ret to (format, data, indices, indptr, shape):
+read-only views of M, which is compressed in place. */
+static void set_eigen_arrays(PyObject *ret, EigenSparseMatrixT &M, PyObject *owner)
+{
+    M.makeCompressed();    // In place; no-op if already compressed
+    typedef EigenSparseMatrixT::StorageIndex IndexT;
+    int const index_type = (sizeof(IndexT) == 8 ? NPY_INT64 : NPY_INT32);
+
+    PyTuple_SetItem(ret, 0, PyUnicode_FromString(EigenSparseMatrixT::IsRowMajor ? "csr" : "csc"));
+    PyTuple_SetItem(ret, 1, np_view(M.valuePtr(), M.nonZeros(), NPY_DOUBLE, owner));
+    PyTuple_SetItem(ret, 2, np_view(M.innerIndexPtr(), M.nonZeros(), index_type, owner));
+    PyTuple_SetItem(ret, 3, np_view(M.outerIndexPtr(), M.outerSize()+1, index_type, owner));
+    PyTuple_SetItem(ret, 4, Py_BuildValue("(ll)", (long)M.rows(), (long)M.cols()));
+}
+
+/** Hands a matrix over to Numpy; see RegridMatrices_matrix_arrays() */
+static PyObject *weighted_to_arrays(
+    std::unique_ptr<linear::Weighted> &&W, std::string const &spec_name)
+{
+    auto *WE(dynamic_cast<linear::Weighted_Eigen *>(&*W));
+    if (!WE) (*icebin_error)(-1,
+        "RegridMatrices.matrix_arrays(%s) needs an Eigen-based matrix", spec_name.c_str());
+    W.release();
+
+    // From here on, the capsule owns the matrix; the arrays below point into it
+    PyObject *capsule = PyCapsule_New(WE, WEIGHTED_CAPSULE, &delete_weighted_capsule);
+    if (!capsule) {
+        delete WE;
+        (*icebin_error)(-1, "Cannot create capsule");
+    }
+
+    PyObject *ret = PyTuple_New(9);
+    set_eigen_arrays(ret, *WE->M, capsule);
+    PyTuple_SetItem(ret, 5, np_view(WE->wM, capsule));
+    PyTuple_SetItem(ret, 6, np_view(WE->Mw, capsule));
+    PyTuple_SetItem(ret, 7, dim_to_np(WE->dims[0]));
+    PyTuple_SetItem(ret, 8, dim_to_np(WE->dims[1]));
+
+    Py_DECREF(capsule);    // Now held only by the arrays
+    return ret;
+}
+
+PyObject *RegridMatrices_matrix_arrays(RegridMatrices *cself, std::string const &spec_name)
+{
+    std::unique_ptr<linear::Weighted> W;
+    {ReleaseGIL nogil;
+        W = cself->matrix(spec_name);
+    }
+    return weighted_to_arrays(std::move(W), spec_name);
+}
+
+
+PyObject *RegridMatrices_stats(RegridMatrices *cself)
+{
+    auto *rm(dynamic_cast<RegridMatrices_Dynamic *>(cself));
+    if (!rm || !rm->stats) (*icebin_error)(-1,
+        "RegridMatrices.stats() is not available for this set of matrices");
+
+    std::vector<MatrixStats> const stats(rm->stats->stats());
+    PyObject *ret = PyList_New(stats.size());
+    for (size_t i=0; i<stats.size(); ++i) {
+        MatrixStats const &st(stats[i]);
+        PyObject *row_hist = PyList_New(st.row_hist.size());
+        for (size_t k=0; k<st.row_hist.size(); ++k)
+            PyList_SetItem(row_hist, k, PyLong_FromLong(st.row_hist[k]));
+
+        PyList_SetItem(ret, i, Py_BuildValue("{s:s,s:(ll),s:l,s:l,s:N,s:d,s:O}",
+            "name", st.name.c_str(),
+            "shape", st.nrow, st.ncol,
+            "nnz", st.nnz,
+            "nbytes", st.nbytes,
+            "row_hist", row_hist,    // (N: steals the reference)
+            "build_s", st.build_s,
+            "cache_hit", st.cache_hit ? Py_True : Py_False));
+    }
+    return ret;
+}
 
 // ------------------------------------------------------------
 PyObject *Hntr_regrid(Hntr const *hntr, PyObject *WTA_py, PyObject *A_py, bool mean_polar)
@@ -207,7 +342,9 @@ PyObject *Hntr_regrid(Hntr const *hntr, PyObject *WTA_py, PyObject *A_py, bool m
     PyObject *B_py(ibmisc::cython::new_pyarray<double,1>(make_array(hntr->Bgrid.spec.size())));
     auto B(np_to_blitz<double,1>(B_py, "WTA", {-1}, blitz::fortranArray));
 
-    hntr->regrid(WTA, A, B, mean_polar);
+    {ReleaseGIL nogil;
+        hntr->regrid(WTA, A, B, mean_polar);
+    }
 
     return B_py;
 }
@@ -227,12 +364,157 @@ RegridMatrices *new_regrid_matrices(
 
 
     auto sheet_index = gcm->ice_regridders().index.at(sheet_name);
-    IceRegridder *ice_regridder = &*gcm->ice_regridders()[sheet_index];
+    IceRegridder *ice_regridder = gcm->ice_regridder(sheet_index);
     auto elevmaskI(np_to_blitz<double,1>(elevmaskI_py, "elevmaskI", {ice_regridder->nI()}));
 
-    return gcm->regrid_matrices(
+    ReleaseGIL nogil;
+    std::unique_ptr<RegridMatrices_Dynamic> rm(gcm->regrid_matrices(
         sheet_index, elevmaskI,
-        RegridParams(scale, correctA, {sigma_x, sigma_y, sigma_z})).release();
+        RegridParams(scale, correctA, {sigma_x, sigma_y, sigma_z})));
+    rm->stats = &rm->tmp.make<MatrixStatsLog>();    // For RegridMatrices_stats()
+    return rm.release();
+}
+
+PyObject *regrid_matrices_ensemble(
+    GCMRegridder const *gcm,
+    std::string const &sheet_name,
+    PyObject *elevmaskIs_py,
+    std::vector<std::string> const &specs,
+    // --------- Params
+    bool scale,
+    bool correctA,
+    double sigma_x,
+    double sigma_y,
+    double sigma_z,
+    bool conserve)
+{
+    auto sheet_index = gcm->ice_regridders().index.at(sheet_name);
+    IceRegridder *ice_regridder = gcm->ice_regridder(sheet_index);
+    auto elevmaskIs_b(np_to_blitz<double,2>(elevmaskIs_py, "elevmaskIs",
+        {-1, (int)ice_regridder->nI()}));
+
+    // Views are made here, with the GIL held (blitz refcounts)
+    std::vector<blitz::Array<double,1>> elevmaskIs;
+    for (int i=0; i<elevmaskIs_b.extent(0); ++i)
+        elevmaskIs.push_back(elevmaskIs_b(i, blitz::Range::all()));
+
+    GCMRegridder::EnsembleMatrices mats;
+    {ReleaseGIL nogil;
+        mats = gcm->regrid_matrices_ensemble(sheet_index, elevmaskIs, specs,
+            RegridParams(scale, correctA, {sigma_x, sigma_y, sigma_z}));
+    }
+
+    PyObject *ret = PyList_New(mats.size());
+    for (size_t i=0; i<mats.size(); ++i) {
+        PyObject *row = PyTuple_New(specs.size());
+        for (size_t j=0; j<specs.size(); ++j)
+            PyTuple_SetItem(row, j, weighted_to_arrays(std::move(mats[i][j]), specs[j]));
+        PyList_SetItem(ret, i, row);
+    }
+    return ret;
+}
+
+PyObject *smoothing_matrix_arrays(
+    GCMRegridder const *gcm,
+    std::string const &sheet_name,
+    PyObject *elevmaskI_py,
+    PyObject *wI_py,
+    double sigma_x,
+    double sigma_y,
+    double sigma_z,
+    double tol)
+{
+    auto sheet_index = gcm->ice_regridders().index.at(sheet_name);
+    IceRegridder *ice_regridder = gcm->ice_regridder(sheet_index);
+    int const nI = ice_regridder->nI();
+    auto elevmaskI(np_to_blitz<double,1>(elevmaskI_py, "elevmaskI", {nI}));
+    auto wI(np_to_blitz<double,1>(wI_py, "wI", {nI}));
+
+    std::unique_ptr<EigenSparseMatrixT> M(new EigenSparseMatrixT(nI, nI));
+    {ReleaseGIL nogil;
+        // Smooth over the cells that are not masked out and have weight
+        SparseSetT dimI;
+        dimI.set_sparse_extent(nI);
+        for (int iI=0; iI<nI; ++iI) {
+            if (!std::isnan(elevmaskI(iI)) && wI(iI) > 0) dimI.add_dense(iI);
+        }
+        blitz::Array<double,1> wI_d(dimI.dense_extent());
+        for (int id=0; id<dimI.dense_extent(); ++id) wI_d(id) = wI(dimI.to_sparse(id));
+
+        TupleListT<2> smooth_d({dimI.dense_extent(), dimI.dense_extent()});
+        smoothing_matrix(smooth_d, ice_regridder->agridI,
+            dimI, elevmaskI, wI_d, {sigma_x, sigma_y, sigma_z}, tol);
+
+        // Back to sparse indexing
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(smooth_d.tuples.size());
+        for (auto ii=smooth_d.begin(); ii != smooth_d.end(); ++ii) {
+            triplets.push_back(Eigen::Triplet<double>(
+                dimI.to_sparse(ii->row()), dimI.to_sparse(ii->col()), ii->value()));
+        }
+        M->setFromTriplets(triplets.begin(), triplets.end());
+    }
+
+    // From here on, the capsule owns the matrix
+    PyObject *capsule = PyCapsule_New(&*M, EIGEN_CAPSULE, &delete_eigen_capsule);
+    if (!capsule) (*icebin_error)(-1, "Cannot create capsule");
+    EigenSparseMatrixT &Mref(*M.release());
+
+    PyObject *ret = PyTuple_New(5);
+    set_eigen_arrays(ret, Mref, capsule);
+    Py_DECREF(capsule);    // Now held only by the arrays
+    return ret;
+}
+
+PyObject *read_grid_polygons(
+    std::string const &fname,
+    std::string const &vname,
+    bool project)
+{
+    std::unique_ptr<Grid> grid;
+    read_fgrid(grid, fname, vname);
+
+    std::unique_ptr<Proj2> proj;
+    if (project && grid->coordinates == GridCoordinates::XY && grid->sproj != "")
+        proj.reset(new Proj2(grid->sproj, Proj2::Direction::XY2LL));
+
+    std::vector<Cell const *> const cells(grid->cells.sorted());
+    long nvertex = 0;
+    for (Cell const *cell : cells) nvertex += cell->size();
+
+    PyObject *x_py(new_pyarray<double,1>(make_array(nvertex)));
+    PyObject *y_py(new_pyarray<double,1>(make_array(nvertex)));
+    PyObject *offsets_py(new_pyarray<long,1>(make_array((long)cells.size()+1)));
+    PyObject *index_py(new_pyarray<long,1>(make_array((long)cells.size())));
+    auto xx(np_to_blitz<double,1>(x_py, "x", {-1}));
+    auto yy(np_to_blitz<double,1>(y_py, "y", {-1}));
+    auto offsets(np_to_blitz<long,1>(offsets_py, "offsets", {-1}));
+    auto index(np_to_blitz<long,1>(index_py, "index", {-1}));
+
+    {ReleaseGIL nogil;
+        long iv = 0;
+        for (size_t ic=0; ic<cells.size(); ++ic) {
+            Cell const *cell(cells[ic]);
+            offsets(ic) = iv;
+            index(ic) = cell->index;
+            for (auto vertex = cell->begin(); vertex != cell->end(); ++vertex, ++iv) {
+                if (proj) {
+                    proj->transform(vertex->x, vertex->y, xx(iv), yy(iv));
+                } else {
+                    xx(iv) = vertex->x;
+                    yy(iv) = vertex->y;
+                }
+            }
+        }
+        offsets(cells.size()) = iv;
+    }
+
+    PyObject *ret = PyTuple_New(4);
+    PyTuple_SetItem(ret, 0, x_py);
+    PyTuple_SetItem(ret, 1, y_py);
+    PyTuple_SetItem(ret, 2, offsets_py);
+    PyTuple_SetItem(ret, 3, index_py);
+    return ret;
 }
 
 std::string to_string(PyObject *str, std::string const &vname)
@@ -70,6 +70,20 @@ extern void GCMRegridder_add_sheet(GCMRegridder *cself,
 extern ibmisc::linear::Weighted *RegridMatrices_matrix(RegridMatrices *cself,
     std::string const &spec_name);
 
+/** Zero-copy alternative to RegridMatrices_matrix(): the compressed
+Eigen arrays and weight vectors are handed to Numpy as read-only
+views, kept alive by a capsule that owns the matrix.
+@return (format, data, indices, indptr, shape, wM, Mw, dimB, dimA)
+    format is 'csr' or 'csc'; the matrix and weights are in dense
+    indexing, and dimB / dimA (or None) map dense to sparse indices. */
+extern PyObject *RegridMatrices_matrix_arrays(RegridMatrices *cself,
+    std::string const &spec_name);
+
+
+/** Statistics of the matrices produced so far by cself (see MatrixStats)
+@return [{name, shape, nnz, nbytes, row_hist, build_s, cache_hit}, ...] */
+extern PyObject *RegridMatrices_stats(RegridMatrices *cself);
+
 
 PyObject *Hntr_regrid(modele::Hntr const *hntr, PyObject *WTA_py, PyObject *A_py, bool mean_polar);
 
@@ -86,6 +100,50 @@ RegridMatrices *new_regrid_matrices(
     double sigma_z,
     bool conserve);
 
+/** Python access to GCMRegridder::regrid_matrices_ensemble()
+@param elevmaskIs_py Numpy array [nvariant x nI]: one elevmaskI per row
+@return [variant][spec]: each matrix as from RegridMatrices_matrix_arrays() */
+PyObject *regrid_matrices_ensemble(
+    GCMRegridder const *gcm,
+    std::string const &sheet_name,
+    PyObject *elevmaskIs_py,
+    std::vector<std::string> const &specs,
+    // --------- Params
+    bool scale,
+    bool correctA,
+    double sigma_x,
+    double sigma_y,
+    double sigma_z,
+    bool conserve);
+
+/** Python access to smoothing_matrix(), for one ice sheet.  Smooths
+over the ice cells that are not masked out in elevmaskI and have
+weight in wI; the same matrix the coupler uses to smooth IvA / IvE.
+@param wI_py Weights of the ice cells (sparse indexing), eg IvE.wM
+@return (format, data, indices, indptr, shape): the [nI x nI]
+    smoothing matrix in sparse indexing; read-only Numpy views, as in
+    RegridMatrices_matrix_arrays() */
+PyObject *smoothing_matrix_arrays(
+    GCMRegridder const *gcm,
+    std::string const &sheet_name,
+    PyObject *elevmaskI_py,
+    PyObject *wI_py,
+    double sigma_x,
+    double sigma_y,
+    double sigma_z,
+    double tol);
+
+/** Reads a grid, and exports its cell outlines as flat arrays, for
+fast (vectorized) plotting.  Cells are in order of index.
+@param project If set (and the grid has x,y coordinates with a
+    projection), converts vertices to lon/lat through the grid's sproj.
+@return (x, y, offsets, index): vertices of cell i (which has index
+    index[i]) are x[offsets[i]:offsets[i+1]], y[...] */
+PyObject *read_grid_polygons(
+    std::string const &fname,
+    std::string const &vname,
+    bool project);
+
 PyObject *read_elevmask(
     std::string const &xfname);
 
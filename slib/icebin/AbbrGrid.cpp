@@ -1,9 +1,16 @@
+#include <algorithm>
+#include <numeric>
+#include <boost/filesystem.hpp>
 #include <icebin/AbbrGrid.hpp>
 #include <icebin/Grid.hpp>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/bincsr.hpp>
+#include <icebin/netcdf_mutex.hpp>
 #include <ibmisc/netcdf.hpp>
 
 using namespace ibmisc;
 using namespace spsparse;
+using namespace netCDF;
 
 namespace icebin {
 
@@ -22,6 +29,7 @@ ExchangeGrid::ExchangeGrid(Grid const &g)
 
 void ExchangeGrid::ncio(ibmisc::NcIO &ncio, std::string const &vname)
 {
+    if (ncio.rw == 'r') _indexed = false;
     ncio_vector(ncio, indices, true, vname + ".indices", "int",
         get_or_add_dims(ncio, indices, {vname + ".nindices"}));
     ncio_vector(ncio, overlaps, true, vname + ".overlaps", "double",
@@ -29,27 +37,161 @@ void ExchangeGrid::ncio(ibmisc::NcIO &ncio, std::string const &vname)
 }
 
 
-/** Filters overlaps based on the destination (BvA = B = index[0]) grid. */
-void ExchangeGrid::filter_cellsB(std::function<bool(long)> const &keep_B_fn)
+void ExchangeGrid::ncio_read(ibmisc::NcIO &ncio, std::string const &vname,
+    std::function<bool(long)> const &keep_B_fn,
+    size_t block_size)
 {
-    std::vector<int> _indices;    // Length*2: (ixB, ixA)
-    std::vector<double> _overlaps;
+    NcVar indices_v(ncio.nc->getVar(vname + ".indices"));
+    NcVar overlaps_v(ncio.nc->getVar(vname + ".overlaps"));
+    size_t const n = overlaps_v.getDim(0).getSize();
+    if (indices_v.getDim(0).getSize() != 2*n) (*icebin_error)(-1,
+        "ExchangeGrid::ncio_read(%s): %ld indices for %ld overlaps",
+        vname.c_str(), (long)indices_v.getDim(0).getSize(), (long)n);
+
+    _indexed = false;
+    indices.clear();
+    overlaps.clear();
+
+    std::vector<int> bindices;
+    std::vector<double> boverlaps;
+    block_size = std::max(block_size, (size_t)1);
+    for (size_t id0=0; id0 < n; id0 += block_size) {
+        size_t const nb = std::min(block_size, n - id0);
+        bindices.resize(nb*2);
+        boverlaps.resize(nb);
+        indices_v.getVar({id0*2}, {nb*2}, bindices.data());
+        overlaps_v.getVar({id0}, {nb}, boverlaps.data());
+
+        for (size_t k=0; k<nb; ++k) {
+            if (!keep_B_fn(bindices[k*2])) continue;
+            indices.push_back(bindices[k*2]);
+            indices.push_back(bindices[k*2+1]);
+            overlaps.push_back(boverlaps[k]);
+        }
+    }
+    indices.shrink_to_fit();
+    overlaps.shrink_to_fit();
+}
 
-    for (size_t id=0; id<overlaps.size(); ++id) {
-        long const iA = _indices[id*2];
-        if (keep_B_fn(iA)) {
-            _indices.push_back(indices[id*2]);
-            _indices.push_back(indices[id*2+1]);
-            _overlaps.push_back(overlaps[id]);
+/** Filters overlaps based on the destination (BvA = B = index[0]) grid.
+Compacts in place (stable); the storage is shrunk afterwards. */
+void ExchangeGrid::filter_cellsB(std::function<bool(long)> const &keep_B_fn)
+{
+    size_t const n = overlaps.size();
+    size_t nkeep = 0;
+    for (size_t id=0; id<n; ++id) {
+        if (!keep_B_fn(indices[id*2])) continue;
+        if (nkeep != id) {
+            indices[nkeep*2] = indices[id*2];
+            indices[nkeep*2+1] = indices[id*2+1];
+            overlaps[nkeep] = overlaps[id];
         }
+        ++nkeep;
     }
+    if (nkeep == n) return;
 
+    indices.resize(nkeep*2);
+    overlaps.resize(nkeep);
+    indices.shrink_to_fit();
+    overlaps.shrink_to_fit();
+
+    // Filtering preserves the order
+    if (_indexed) build_index();
+}
+
+void ExchangeGrid::sort_index()
+{
+    size_t const n = overlaps.size();
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::stable_sort(perm.begin(), perm.end(), [this](int a, int b) {
+        return std::make_pair(indices[a*2], indices[a*2+1])
+            < std::make_pair(indices[b*2], indices[b*2+1]); });
+
+    std::vector<int> _indices(n*2);
+    std::vector<double> _overlaps(n);
+    for (size_t id=0; id<n; ++id) {
+        _indices[id*2] = indices[perm[id]*2];
+        _indices[id*2+1] = indices[perm[id]*2+1];
+        _overlaps[id] = overlaps[perm[id]];
+    }
     indices = std::move(_indices);
     overlaps = std::move(_overlaps);
+
+    build_index();
+}
+
+/** Requires exchange cells to be sorted by (iA, iI) */
+void ExchangeGrid::build_index()
+{
+    int const n = overlaps.size();
+
+    // By gridA cell: contiguous
+    byA_index.clear();
+    byA_start.clear();
+    for (int id=0; id<n; ++id) {
+        int const iA = indices[id*2];
+        if (byA_index.size() == 0 || byA_index.back() != iA) {
+            byA_index.push_back(iA);
+            byA_start.push_back(id);
+        }
+    }
+    byA_start.push_back(n);
+
+    // By gridI cell: a (stable) sort of exchange cells by iI
+    byI_id.resize(n);
+    std::iota(byI_id.begin(), byI_id.end(), 0);
+    std::stable_sort(byI_id.begin(), byI_id.end(),
+        [this](int a, int b) { return indices[a*2+1] < indices[b*2+1]; });
+
+    byI_index.clear();
+    byI_start.clear();
+    for (int k=0; k<n; ++k) {
+        int const iI = indices[byI_id[k]*2+1];
+        if (byI_index.size() == 0 || byI_index.back() != iI) {
+            byI_index.push_back(iI);
+            byI_start.push_back(k);
+        }
+    }
+    byI_start.push_back(n);
+
+    _indexed = true;
+}
+
+/** Looks up ix in a CSR index built by build_index() */
+static std::array<int,2> index_range(
+    std::vector<int> const &index, std::vector<int> const &start, long ix)
+{
+    auto ii(std::lower_bound(index.begin(), index.end(), ix));
+    if (ii == index.end() || *ii != ix) return {{0, 0}};
+    size_t const k = ii - index.begin();
+    return {{start[k], start[k+1]}};
+}
+
+std::array<int,2> ExchangeGrid::rangeA(long iA) const
+{
+    if (!_indexed) (*icebin_error)(-1, "ExchangeGrid::rangeA(): call sort_index() first");
+    return index_range(byA_index, byA_start, iA);
+}
+
+std::array<int,2> ExchangeGrid::rangeI(long iI) const
+{
+    if (!_indexed) (*icebin_error)(-1, "ExchangeGrid::rangeI(): call sort_index() first");
+    return index_range(byI_index, byI_start, iI);
 }
 
 // ====================================================
 
+AbbrGridArrays &AbbrGridArrays::load()
+{
+    std::call_once(loaded, [this]() { if (loader) loader(*this); });
+    return *this;
+}
+
+/** Copies a Grid's spec, which AbbrGrid shares rather than owns */
+static std::shared_ptr<GridSpec> share_spec(GridSpec const *spec)
+    { return std::shared_ptr<GridSpec>(spec ? spec->clone() : nullptr); }
+
 AbbrGrid::AbbrGrid(
     std::unique_ptr<GridSpec> &&_spec,
     GridCoordinates _coordinates,
@@ -65,8 +207,12 @@ AbbrGrid::AbbrGrid(
 coordinates(_coordinates), parameterization(_parameterization),
 indexing(_indexing), name(_name), sproj(_sproj),
 dim(std::move(_dim)),
-ijk(_ijk), native_area(_native_area), centroid_xy(_centroid_xy)
-{}
+_arrays(new AbbrGridArrays)
+{
+    _arrays->ijk.reference(_ijk);
+    _arrays->native_area.reference(_native_area);
+    _arrays->centroid_xy.reference(_centroid_xy);
+}
 
 
 void AbbrGrid::clear()
@@ -75,52 +221,106 @@ void AbbrGrid::clear()
     name = "";
     sproj = "";
     dim.clear();
-    ijk.free();
-    native_area.free();
-    centroid_xy.free();
+    _arrays.reset(new AbbrGridArrays);
 }
 
 
 /** Convert from Grid */
-AbbrGrid::AbbrGrid(Grid const &g) :
-    spec(g.spec),
-    coordinates(g.coordinates),
-    parameterization(g.parameterization),
-    indexing(g.indexing),
-    name(g.name),
-    sproj(g.sproj),
-    dim(g.ndata())    // sparse_extent
+static Cell const &deref_cell(Cell const *cell) { return *cell; }
+static FlatCell const &deref_cell(FlatCell const &cell) { return cell; }
+
+/** Copies the info AbbrGrid needs out of a Grid or FlatGrid.
+@param cells Cells of the grid, in order of index */
+template<class GridT, class CellRangeT>
+static void abbr_cells(AbbrGrid &ag, GridT const &g, CellRangeT const &cells)
 {
     // Allocate
     auto nd = g.nrealized();    // dense extent
-    ijk.reference(blitz::Array<int,2>(nd,3));
-    native_area.reference(blitz::Array<double,1>(nd));
+    AbbrGridArrays &arr(*ag._arrays);
+    arr.ijk.reference(blitz::Array<int,2>(nd,3));
+    arr.native_area.reference(blitz::Array<double,1>(nd));
     if (g.coordinates == GridCoordinates::XY) {
-        centroid_xy.reference(blitz::Array<double,2>(nd,2));
+        arr.centroid_xy.reference(blitz::Array<double,2>(nd,2));
     }
 
 
     // Copy info into AbbrGrid
-    ibmisc::Proj_LL2XY proj(g.sproj);
-    std::vector<Cell const *> cells(g.cells.sorted());
     for (auto ii=cells.begin(); ii != cells.end(); ++ii) {
-        Cell const *cell(*ii);
-        int id = dim.add_dense(cell->index);    // Dense index
+        auto const &cell(deref_cell(*ii));
+        int id = ag.dim.add_dense(cell.index);    // Dense index
         if (id >= nd) (*icebin_error)(-1,
             "Index out of range: %d vs %d", id, nd);
 
-        ijk(id,0) = cell->i;
-        ijk(id,1) = cell->j;
-        ijk(id,2) = cell->k;
-        native_area(id) = cell->native_area;
+        arr.ijk(id,0) = cell.i;
+        arr.ijk(id,1) = cell.j;
+        arr.ijk(id,2) = cell.k;
+        arr.native_area(id) = cell.native_area;
         if (g.coordinates == GridCoordinates::XY) {
-            auto ctr(cell->centroid());
-            centroid_xy(id,0) = ctr.x;
-            centroid_xy(id,1) = ctr.y;
+            auto ctr(cell.centroid());
+            arr.centroid_xy(id,0) = ctr.x;
+            arr.centroid_xy(id,1) = ctr.y;
         }
     }
 }
 
+/** Copies the vertices of an L1 Grid into an AbbrGrid: they are the
+basis functions.  The native_area of each is the integral of its
+(linear) basis function: one third of the area of each triangle it is
+a vertex of. */
+static void abbr_vertices(AbbrGrid &ag, Grid const &g)
+{
+    auto nd = g.vertices.nrealized();    // dense extent
+    AbbrGridArrays &arr(*ag._arrays);
+    arr.ijk.reference(blitz::Array<int,2>(nd,3));
+    arr.native_area.reference(blitz::Array<double,1>(nd));
+    arr.centroid_xy.reference(blitz::Array<double,2>(nd,2));
+    arr.ijk = -1;
+    arr.native_area = 0;
+
+    std::vector<Vertex const *> vertices(g.vertices.sorted());
+    for (Vertex const *vertex : vertices) {
+        int const id = ag.dim.add_dense(vertex->index);
+        arr.centroid_xy(id,0) = vertex->x;
+        arr.centroid_xy(id,1) = vertex->y;
+    }
+
+    for (auto cell=g.cells.begin(); cell != g.cells.end(); ++cell) {
+        double const area = cell->native_area / cell->size();
+        for (auto vertex=cell->begin(); vertex != cell->end(); ++vertex)
+            arr.native_area(ag.dim.to_dense(vertex->index)) += area;
+    }
+}
+
+AbbrGrid::AbbrGrid(Grid const &g) :
+    spec(share_spec(g.spec.get())),
+    coordinates(g.coordinates),
+    parameterization(g.parameterization),
+    indexing(g.indexing),
+    name(g.name),
+    sproj(g.sproj),
+    dim(g.ndata()),    // sparse_extent
+    _arrays(new AbbrGridArrays)
+{
+    if (g.parameterization == GridParameterization::L1)
+        abbr_vertices(*this, g);
+    else
+        abbr_cells(*this, g, g.cells.sorted());
+}
+
+AbbrGrid::AbbrGrid(FlatGrid const &g) :
+    spec(share_spec(g.spec.get())),
+    coordinates(g.coordinates),
+    parameterization(g.parameterization),
+    indexing(g.indexing),
+    name(g.name),
+    sproj(g.sproj),
+    dim(g.ndata()),    // sparse_extent
+    _arrays(new AbbrGridArrays)
+{
+    // FlatGrid cells are already sorted
+    abbr_cells(*this, g, g.cells);
+}
+
 void AbbrGrid::filter_cells(std::function<bool(long)> const &keep_fn)
 {
 
@@ -137,16 +337,22 @@ void AbbrGrid::filter_cells(std::function<bool(long)> const &keep_fn)
         }
     }
 
-    // Keep old arrays for now
-    blitz::Array<int,2> ijk0(ijk);
-    blitz::Array<double,1> native_area0(native_area);
-    blitz::Array<double,2> centroid_xy0(centroid_xy);
+    // Keep old arrays for now (other copies of this AbbrGrid still use them)
+    AbbrGridArrays const &arr0(arrays());
+    blitz::Array<int,2> const &ijk0(arr0.ijk);
+    blitz::Array<double,1> const &native_area0(arr0.native_area);
+    blitz::Array<double,2> const &centroid_xy0(arr0.centroid_xy);
+    bool const has_centroid = (centroid_xy0.extent(0) > 0);
 
     // Allocate new arrays
     auto const N = dim1.dense_extent();
+    std::shared_ptr<AbbrGridArrays> arr1(new AbbrGridArrays);
+    blitz::Array<int,2> &ijk(arr1->ijk);
+    blitz::Array<double,1> &native_area(arr1->native_area);
+    blitz::Array<double,2> &centroid_xy(arr1->centroid_xy);
     ijk.reference(blitz::Array<int,2>(N,3));
     native_area.reference(blitz::Array<double,1>(N));
-    centroid_xy.reference(blitz::Array<double,2>(N,2));
+    if (has_centroid) centroid_xy.reference(blitz::Array<double,2>(N,2));
 
     // Copy over
     for (int id1=0; id1<dim1.dense_extent(); ++id1) {
@@ -155,18 +361,41 @@ void AbbrGrid::filter_cells(std::function<bool(long)> const &keep_fn)
         ijk(id1,1) = ijk0(id0,1);
         ijk(id1,2) = ijk0(id0,2);
         native_area(id1) = native_area0(id0);
-        centroid_xy(id1,0) = centroid_xy0(id0,0);
-        centroid_xy(id1,1) = centroid_xy0(id0,1);
+        if (has_centroid) {
+            centroid_xy(id1,0) = centroid_xy0(id0,0);
+            centroid_xy(id1,1) = centroid_xy0(id0,1);
+        }
     }
 
-    // Put new dim into place
+    // Put new dim and arrays into place
     dim = std::move(dim1);
+    _arrays = std::move(arr1);
 }
 
 
+/** Reads the per-cell arrays of AbbrGrid vname from a NetCDF file;
+the loader for AbbrGrid::ncio() */
+static void nc_load_arrays(AbbrGridArrays &arr,
+    std::string const &fname, std::string const &vname)
+{
+    std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+    NcIO ncio(fname, 'r');
+    arr.ijk.reference(nc_read_blitz<int,2>(ncio.nc, vname + ".ijk"));
+    arr.native_area.reference(nc_read_blitz<double,1>(ncio.nc, vname + ".native_area"));
+    if (!ncio.nc->getVar(vname + ".centroid_xy").isNull()) {
+        arr.centroid_xy.reference(nc_read_blitz<double,2>(ncio.nc, vname + ".centroid_xy"));
+    }
+}
+
 void AbbrGrid::ncio(ibmisc::NcIO &ncio, std::string const &vname)
 {
-    ncio_grid_spec(ncio, spec, vname);
+    if (ncio.rw == 'w') {
+        spec->ncio(ncio, vname);
+    } else {
+        std::unique_ptr<GridSpec> spec1;
+        ncio_grid_spec(ncio, spec1, vname);
+        spec = std::move(spec1);
+    }
 
     auto info_v = get_or_add_var(ncio, vname + ".info", "int", {});
     get_or_put_att_enum(info_v, ncio.rw, "coordinates", coordinates);
@@ -179,66 +408,48 @@ void AbbrGrid::ncio(ibmisc::NcIO &ncio, std::string const &vname)
     // Store dim; retrieve dimension from it
     dim.ncio(ncio, vname + ".dim");
 
+    if (ncio.rw == 'r') {
+        // Set up the arrays to be loaded when first used
+        _arrays.reset(new AbbrGridArrays);
+        std::string const bgrid_fname(bingrid_fname(ncio.fname, vname));
+        std::shared_ptr<MappedGrid> mapped;
+        if (boost::filesystem::exists(bgrid_fname)) {
+            mapped.reset(new MappedGrid(bgrid_fname));
+            if (!mapped->matches(dim)) {
+                // Stale sidecar (eg, the NetCDF file was re-written without it)
+                fprintf(stderr, "WARNING: %s does not match %s in %s; reading from NetCDF\n",
+                    bgrid_fname.c_str(), vname.c_str(), ncio.fname.c_str());
+                mapped.reset();
+            }
+        }
+        if (mapped) {
+            printf("Mapping %s from %s\n", vname.c_str(), bgrid_fname.c_str());
+
+            // Pages of the mapping are read when first touched
+            _arrays->ijk.reference(mapped->ijk());
+            _arrays->native_area.reference(mapped->native_area());
+            _arrays->centroid_xy.reference(mapped->centroid_xy());
+            _arrays->mapped = std::move(mapped);
+        } else {
+            _arrays->loader = std::bind(&nc_load_arrays,
+                std::placeholders::_1, ncio.fname, vname);
+        }
+        return;
+    }
+
+    AbbrGridArrays &arr(arrays());
     auto dense_extent_d(get_or_add_dim(ncio,
-        vname+".dim.dense_extent", ijk.extent(0)));    // extent ignored on read
+        vname+".dim.dense_extent", arr.ijk.extent(0)));
     auto three_d(get_or_add_dim(ncio, "three", 3));
     auto two_d(get_or_add_dim(ncio, "two", 2));
 
-    ncio_blitz_alloc(ncio, ijk, vname + ".ijk", "int",
+    ncio_blitz_alloc(ncio, arr.ijk, vname + ".ijk", "int",
         {dense_extent_d, three_d});
-    ncio_blitz_alloc(ncio, native_area, vname + ".native_area", "double",
+    ncio_blitz_alloc(ncio, arr.native_area, vname + ".native_area", "double",
         {dense_extent_d});
-    ncio_blitz_alloc(ncio, centroid_xy, vname + ".centroid_xy", "double",
+    ncio_blitz_alloc(ncio, arr.centroid_xy, vname + ".centroid_xy", "double",
         {dense_extent_d, two_d});
 
 }
 
-// ==============================================================================
-// We only need to define these because blitz::Array does not follow STL conventions
-// and is not movable.
-void AbbrGrid::operator=(AbbrGrid &&other)
-{
-    // Standard stuff
-    spec = std::move(other.spec);
-    coordinates = other.coordinates;
-    parameterization = other.parameterization;
-    indexing = std::move(other.indexing);
-    name = std::move(other.name);
-    sproj = std::move(other.sproj);
-    dim = std::move(other.dim);
-
-    // Non-standard stuff, why we have to write our own operator=(&&)
-    // We don't really move here, just copy the shared pointer.
-    ijk.reference(other.ijk);
-    native_area.reference(other.native_area);
-    centroid_xy.reference(other.centroid_xy);
-}
-
-AbbrGrid::AbbrGrid(AbbrGrid &&other)
-    { *this = std::move(other); }
-
-void AbbrGrid::operator=(AbbrGrid const &other)
-{
-    // Standard stuff
-    spec = other.spec;
-    coordinates = other.coordinates;
-    parameterization = other.parameterization;
-    indexing = other.indexing;
-    name = other.name;
-    sproj = other.sproj;
-    dim = other.dim;
-
-    // Non-standard stuff, why we have to write our own operator=(&&)
-    // We don't really move here, just copy the shared pointer.
-    ijk.reference(other.ijk);
-    native_area.reference(other.native_area);
-    centroid_xy.reference(other.centroid_xy);
-}
-
-AbbrGrid::AbbrGrid(AbbrGrid const &other)
-    { *this = other; }
-
-
-
-
 }    // namespace
@@ -19,6 +19,8 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <functional>
 
@@ -36,12 +38,24 @@
 namespace icebin {
 
 class Grid;
+class FlatGrid;
+class MappedGrid;
 
 class ExchangeGrid {
     // Sparse indexing needed by IceRegridder::init()
     std::vector<int> indices;    // Length*2: (ixB, ixA)
     std::vector<double> overlaps;
 
+    // OPTIONAL indices by gridA and gridI cell (see sort_index())
+    bool _indexed = false;
+    std::vector<int> byA_index;    // Realized gridA cells, sorted
+    std::vector<int> byA_start;    // Exchange cells of byA_index[k]: [byA_start[k], byA_start[k+1])
+    std::vector<int> byI_index;    // Realized gridI cells, sorted
+    std::vector<int> byI_start;    // Exchange cells of byI_index[k]: byI_id[byI_start[k] .. byI_start[k+1])
+    std::vector<int> byI_id;
+
+    void build_index();
+
 public:
     ExchangeGrid() {}
 
@@ -56,6 +70,7 @@ public:
 
     void add(std::array<int,2> const &index, double _area)
     {
+        _indexed = false;
         indices.push_back(index[0]);
         indices.push_back(index[1]);
         overlaps.push_back(_area);
@@ -79,6 +94,36 @@ public:
 
     void ncio(ibmisc::NcIO &ncio, std::string const &vname);
 
+    /** Reads only the exchange cells whose destination (index[0])
+    cell passes keep_B_fn, in order; the same as ncio() followed by
+    filter_cellsB(), but block_size cells at a time, so the full
+    exchange grid is never in memory.  Reads immediately. */
+    void ncio_read(ibmisc::NcIO &ncio, std::string const &vname,
+        std::function<bool(long)> const &keep_B_fn,
+        size_t block_size = 1<<20);
+
+    /** Sorts (and so renumbers) exchange cells by (iA, iI); then
+    builds CSR indices of the exchange cells overlapping each gridA
+    and each gridI cell.  Exchange cells of one gridA cell are then
+    contiguous. */
+    void sort_index();
+
+    /** Has sort_index() been called (since the last add())? */
+    bool indexed() const { return _indexed; }
+
+    /** Requires indexed().
+    @return Range [begin, end) of (dense) exchange cells overlapping
+        gridA cell iA; empty if none. */
+    std::array<int,2> rangeA(long iA) const;
+
+    /** Requires indexed().
+    @return Range [begin, end) of k, for which byI(k) are the exchange
+        cells overlapping gridI cell iI (in order of iA). */
+    std::array<int,2> rangeI(long iI) const;
+
+    int byI(int k) const
+        { return byI_id[k]; }
+
     /** NOTE: This will result in ExchangeGrid cells being renumbered,
     resulting in different numbering schemes for different processors.
     That is not a problem because matrices based on this grid are only
@@ -90,8 +135,32 @@ public:
 
 
 
+/** Per-cell arrays of an AbbrGrid.  These are shared (not copied)
+between copies of an AbbrGrid; and are only read once they have been
+set up.  If the AbbrGrid was read with AbbrGrid::ncio(), they are
+loaded on first access. */
+struct AbbrGridArrays {
+    blitz::Array<int,2> ijk;    // ijk(index, ijk)  (OPTIONAL; and second dimension varies in size)
+    blitz::Array<double,1> native_area;    // dense indexing
+    // blitz::Array<double,1> proj_area;
+
+    // Only set if coordinates == GridCoordinates::XY
+    blitz::Array<double,2> centroid_xy;    // centroid(index, xy)
+
+    /** If set, fills in the arrays on first access */
+    std::function<void(AbbrGridArrays &)> loader;
+    std::once_flag loaded;
+
+    /** Holds the mapping, if the arrays point into a bingrid file */
+    std::shared_ptr<MappedGrid> mapped;
+
+    /** @return *this, having run the loader if needed. */
+    AbbrGridArrays &load();
+};
+
 struct AbbrGrid {
-    ibmisc::clonable_unique_ptr<GridSpec> spec;
+    /** Read-only; shared between copies */
+    std::shared_ptr<GridSpec> spec;
     GridCoordinates coordinates;
     GridParameterization parameterization;
     ibmisc::Indexing indexing;
@@ -101,17 +170,37 @@ struct AbbrGrid {
 
     // Items here will correspond to cells (for L0) or vertices (for L1)
     spsparse::SparseSet<long,int> dim;    // cell->index = sparse
-    blitz::Array<int,2> ijk;    // ijk(index, ijk)  (OPTIONAL; and second dimension varies in size)
-    blitz::Array<double,1> native_area;    // dense indexing
-    // blitz::Array<double,1> proj_area;
 
-    // Only set if coordinates == GridCoordinates::XY
-    blitz::Array<double,2> centroid_xy;    // centroid(index, xy)
+    /** ijk, native_area and centroid_xy; use the accessors below. */
+    std::shared_ptr<AbbrGridArrays> _arrays;
+
+    AbbrGridArrays &arrays() const
+        { return _arrays->load(); }
+
+    blitz::Array<int,2> const &ijk() const
+        { return arrays().ijk; }
+    int ijk(int id, int index) const
+        { return arrays().ijk(id, index); }
 
+    blitz::Array<double,1> const &native_area() const
+        { return arrays().native_area; }
+    double native_area(int id) const
+        { return arrays().native_area(id); }
+
+    blitz::Array<double,2> const &centroid_xy() const
+        { return arrays().centroid_xy; }
+    double centroid_xy(int id, int xy) const
+        { return arrays().centroid_xy(id, xy); }
+
+    /** When reading, only the metadata and dim are read right away;
+    the per-cell arrays are read on first access: from the bingrid
+    sidecar (see bingrid_fname()) by mmap() if there is one, otherwise
+    from this NetCDF file. */
     virtual void ncio(ibmisc::NcIO &ncio, std::string const &vname);
 
-    AbbrGrid() {}
+    AbbrGrid() : _arrays(new AbbrGridArrays) {}
     explicit AbbrGrid(Grid const &g);
+    explicit AbbrGrid(FlatGrid const &g);
 
 
     AbbrGrid(
@@ -130,20 +219,6 @@ struct AbbrGrid {
     void clear();
 
     void filter_cells(std::function<bool(long)> const &keep_fn);
-
-
-    // ===============================================================
-    // We only need to define these because blitz::Array does not follow STL conventions
-    // and is not movable.
-    void operator=(AbbrGrid &&other);
-
-    AbbrGrid(AbbrGrid &&other);
-
-    void operator=(AbbrGrid const &other);
-
-    AbbrGrid(AbbrGrid const &other);
-
-    // ===============================================================
 };
 
 
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <icebin/CoarseIceRegridder.hpp>
+#include <icebin/GridSpec.hpp>
+#include <icebin/error.hpp>
+#include <icebin/profile.hpp>
+
+using namespace ibmisc;
+
+namespace icebin {
+
+/** Every k-th boundary of b, plus the last one */
+static std::vector<double> coarsen_boundaries(std::vector<double> const &b, int k)
+{
+    std::vector<double> ret;
+    int const n = b.size() - 1;
+    for (int i=0; i<n; i += k) ret.push_back(b[i]);
+    ret.push_back(b[n]);
+    return ret;
+}
+
+CoarseIceRegridder::CoarseIceRegridder(IceRegridder const *_fine, int _k)
+    : fine(_fine), k(_k)
+{
+    ICEBIN_PROFILE_SCOPE("CoarseIceRegridder");
+
+    AbbrGrid const &agridI(fine->agridI);
+    GridSpec_XY const *spec = (agridI.spec && agridI.spec->type == GridType::XY) ?
+        dynamic_cast<GridSpec_XY const *>(&*agridI.spec) : nullptr;
+    if (!spec || agridI.coordinates != GridCoordinates::XY
+        || agridI.parameterization != GridParameterization::L0)
+    {
+        (*icebin_error)(-1,
+            "CoarseIceRegridder(%s): Only L0 ice grids on GridSpec_XY can be coarsened",
+            fine->name().c_str());
+    }
+    if (k < 1) (*icebin_error)(-1,
+        "CoarseIceRegridder(%s): k=%d must be positive", fine->name().c_str(), k);
+
+    nx = spec->nx();
+    ny = spec->ny();
+    nxc = (nx + k - 1) / k;
+    nyc = (ny + k - 1) / k;
+    indexing = Indexing({"x", "y"}, {0,0}, {nxc, nyc}, spec->indices);
+
+    // ------------ Coarse grid cells: those containing a realized fine cell
+    int const nId = agridI.dim.dense_extent();
+    std::vector<long> iIcs(nId);    // Coarse cell of each (dense) fine cell
+    for (int id=0; id<nId; ++id) iIcs[id] = to_coarse(agridI.dim.to_sparse(id));
+    std::vector<long> realized(iIcs);
+    std::sort(realized.begin(), realized.end());
+    realized.erase(std::unique(realized.begin(), realized.end()), realized.end());
+
+    spsparse::SparseSet<long,int> dim(nIc());
+    for (long iIc : realized) dim.add_dense(iIc);
+
+    // Area-weighted sums over fine cells
+    int const nIcd = dim.dense_extent();
+    bool const has_centroid = (agridI.centroid_xy().extent(0) > 0);
+    blitz::Array<int,2> ijk(nIcd, 3);
+    blitz::Array<double,1> native_area(nIcd);
+    blitz::Array<double,2> centroid_xy;
+    if (has_centroid) centroid_xy.reference(blitz::Array<double,2>(nIcd, 2));
+    native_area = 0;
+    if (has_centroid) centroid_xy = 0;
+    for (int idc=0; idc<nIcd; ++idc) {
+        auto const ij(indexing.index_to_tuple<int,2>(dim.to_sparse(idc)));
+        ijk(idc,0) = ij[0];
+        ijk(idc,1) = ij[1];
+        ijk(idc,2) = -1;
+    }
+    for (int id=0; id<nId; ++id) {
+        int const idc = dim.to_dense(iIcs[id]);
+        double const area = agridI.native_area(id);
+        native_area(idc) += area;
+        if (has_centroid) {
+            centroid_xy(idc,0) += area * agridI.centroid_xy(id,0);
+            centroid_xy(idc,1) += area * agridI.centroid_xy(id,1);
+        }
+    }
+    if (has_centroid) {
+        for (int idc=0; idc<nIcd; ++idc) {
+            if (native_area(idc) == 0) continue;
+            centroid_xy(idc,0) /= native_area(idc);
+            centroid_xy(idc,1) /= native_area(idc);
+        }
+    }
+
+    std::unique_ptr<GridSpec> specc(new GridSpec_XY(
+        spec->sproj, std::vector<int>(spec->indices),
+        coarsen_boundaries(spec->xb, k), coarsen_boundaries(spec->yb, k)));
+
+    // ------------ Coarse exchange grid: sum overlaps by (iA, iIc)
+    ExchangeGrid const &aexgrid(fine->aexgrid);
+    int const nXf = aexgrid.dense_extent();
+    std::vector<std::pair<long,double>> overlaps;    // (iA*nIc + iIc, area)
+    overlaps.reserve(nXf);
+    for (int id=0; id<nXf; ++id) {
+        long const iA = aexgrid.ijk(id,0);
+        long const iIc = to_coarse(aexgrid.ijk(id,1));
+        overlaps.push_back(std::make_pair(iA*nIc() + iIc, aexgrid.native_area(id)));
+    }
+    std::sort(overlaps.begin(), overlaps.end(),
+        [](std::pair<long,double> const &a, std::pair<long,double> const &b)
+        { return a.first < b.first; });
+
+    ExchangeGrid aexgridc;
+    for (size_t i=0; i<overlaps.size(); ) {
+        long const key = overlaps[i].first;
+        double area = 0;
+        for (; i<overlaps.size() && overlaps[i].first == key; ++i) area += overlaps[i].second;
+        aexgridc.add({(int)(key / nIc()), (int)(key % nIc())}, area);
+    }
+    if (aexgrid.indexed()) aexgridc.sort_index();
+
+    // ------------ Put it together
+    regridder = new_ice_regridder(GridParameterization::L0);
+    regridder->gcm = fine->gcm;
+    regridder->_name = fine->name();
+    regridder->interp_style = fine->interp_style;
+    regridder->gridA_proj_area.reference(fine->gridA_proj_area);
+    regridder->agridI = AbbrGrid(std::move(specc),
+        GridCoordinates::XY, GridParameterization::L0,
+        indexing, agridI.name, agridI.sproj, std::move(dim),
+        ijk, native_area, centroid_xy);
+    regridder->aexgrid = std::move(aexgridc);
+}
+
+long CoarseIceRegridder::to_coarse(long iI) const
+{
+    auto const ij(fine->agridI.indexing.index_to_tuple<int,2>(iI));
+    return indexing.tuple_to_index<long,2>({ij[0] / k, ij[1] / k});
+}
+
+blitz::Array<double,1> CoarseIceRegridder::elevmask(
+    blitz::Array<double,1> const &elevmaskI,
+    double min_frac) const
+{
+    AbbrGrid const &agridI(fine->agridI);
+    if (elevmaskI.extent(0) != agridI.dim.sparse_extent()) (*icebin_error)(-1,
+        "CoarseIceRegridder::elevmask(): elevmaskI has %d elements, expected %ld",
+        elevmaskI.extent(0), (long)agridI.dim.sparse_extent());
+
+    std::vector<double> area(nIc(), 0.);        // Realized area
+    std::vector<double> ice_area(nIc(), 0.);    // Area of ice cells
+    std::vector<double> elev_area(nIc(), 0.);   // Sum of area*elevation of ice cells
+    for (int id=0; id<agridI.dim.dense_extent(); ++id) {
+        long const iI = agridI.dim.to_sparse(id);
+        long const iIc = to_coarse(iI);
+        double const a = agridI.native_area(id);
+        area[iIc] += a;
+        double const elev = elevmaskI(iI);
+        if (std::isnan(elev)) continue;
+        ice_area[iIc] += a;
+        elev_area[iIc] += a * elev;
+    }
+
+    blitz::Array<double,1> ret(nIc());
+    for (long iIc=0; iIc<nIc(); ++iIc) {
+        ret(iIc) = (area[iIc] > 0 && ice_area[iIc] > 0 && ice_area[iIc] >= min_frac * area[iIc]) ?
+            elev_area[iIc] / ice_area[iIc] : std::numeric_limits<double>::quiet_NaN();
+    }
+    return ret;
+}
+
+blitz::Array<double,2> CoarseIceRegridder::prolong(blitz::Array<double,2> const &valsIc) const
+{
+    if (valsIc.extent(1) != nIc()) (*icebin_error)(-1,
+        "CoarseIceRegridder::prolong(): valsIc has %d cells, expected %ld",
+        valsIc.extent(1), nIc());
+
+    long const nI = fine->agridI.dim.sparse_extent();
+    blitz::Array<double,2> ret(valsIc.extent(0), nI);
+    ret = std::numeric_limits<double>::quiet_NaN();
+    AbbrGrid const &agridI(fine->agridI);
+    for (int id=0; id<agridI.dim.dense_extent(); ++id) {
+        long const iI = agridI.dim.to_sparse(id);
+        long const iIc = to_coarse(iI);
+        for (int ivar=0; ivar<valsIc.extent(0); ++ivar) ret(ivar, iI) = valsIc(ivar, iIc);
+    }
+    return ret;
+}
+
+}    // namespace icebin
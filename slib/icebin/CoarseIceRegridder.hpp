@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <blitz/array.h>
+#include <ibmisc/indexing.hpp>
+#include <icebin/IceRegridder.hpp>
+
+namespace icebin {
+
+/** A copy of an L0 IceRegridder on a GridSpec_XY ice grid, with the
+ice grid coarsened by aggregating k x k blocks of cells (the last
+block in each direction may be smaller).  The exchange grid is
+coarsened to match: overlaps of the fine cells of a block with each
+GCM grid cell are summed into one exchange cell.  So the coarsened
+sheet overlaps the GCM grid exactly as the full-resolution one does.
+
+Used for approximate but much cheaper regridding (eg spin-up, or
+interactive tuning):
+<pre>CoarseIceRegridder coarse(gcm->ice_regridder("greenland"), 4);
+auto rm(gcm->regrid_matrices(&*coarse.regridder, coarse.elevmask(elevmaskI)));</pre>
+Ice grid fields can be moved back to full resolution with prolong(). */
+class CoarseIceRegridder {
+    IceRegridder const *fine;
+    int nx, ny;    // Size of the fine grid
+    int nxc, nyc;  // Size of the coarse grid
+    ibmisc::Indexing indexing;    // Of the coarse grid
+
+public:
+    int const k;
+
+    /** The coarsened ice sheet.  Same name, gcm and interp_style as
+    the full-resolution one (but not added to the GCMRegridder). */
+    std::unique_ptr<IceRegridder> regridder;
+
+    /** @param fine The full-resolution ice sheet; must have been loaded
+        (eg obtained from GCMRegridder::ice_regridder()), and must
+        outlive this.
+    @param k Number of fine cells per coarse cell in each direction */
+    CoarseIceRegridder(IceRegridder const *fine, int k);
+
+    /** Number of cells in the coarse grid (sparse indexing) */
+    long nIc() const { return (long)nxc * nyc; }
+
+    /** @return Coarse cell containing fine cell iI (sparse indexing) */
+    long to_coarse(long iI) const;
+
+    /** Coarsens an elevmaskI for the fine grid.  A coarse cell is ice
+    if at least min_frac of the (realized) area of its fine cells is
+    ice; its elevation is then the area-weighted mean elevation of
+    those ice cells.  Other coarse cells are NaN.
+    @param elevmaskI Elevation of each fine cell (NaN if not ice) [nI]
+    @return Elevation of each coarse cell [nIc] */
+    blitz::Array<double,1> elevmask(
+        blitz::Array<double,1> const &elevmaskI,
+        double min_frac = 0.5) const;
+
+    /** Moves fields on the coarse grid to the fine grid: each fine cell
+    gets the value of the coarse cell containing it.
+    @param valsIc Fields on the coarse grid, (nvar, nIc)
+    @return Fields on the fine grid, (nvar, nI) */
+    blitz::Array<double,2> prolong(blitz::Array<double,2> const &valsIc) const;
+};
+
+}    // namespace icebin
@@ -2,6 +2,7 @@
 
 #include <icebin/error.hpp>
 #include <icebin/ElevMask.hpp>
+#include <icebin/netcdf_mutex.hpp>
 
 using namespace ibmisc;
 
@@ -19,6 +20,100 @@ struct IceMask {
 
 static double const NaN = std::numeric_limits<double>::quiet_NaN();
 
+/** Computes elevmaskI from PISM fields, in one pass.
+@param n Number of grid cells
+@param emI_land OUTPUT: Elevation-mask for continental area (ice and bare land)
+@param emI_ice OUTPUT: Elevation-mask for just ice-covered areas */
+static void elevmask_pism(size_t n,
+    double const *topg, double const *thk, int8_t const *mask,
+    double *emI_land, double *emI_ice)
+{
+    // Branch-free, so the compiler can vectorize it
+    for (size_t iI=0; iI<n; ++iI) {
+        bool const ice = (mask[iI] == IceMask::GROUNDED_ICE || mask[iI] == IceMask::FLOATING_ICE);
+        bool const bedrock = (mask[iI] == IceMask::ICE_FREE_BEDROCK);
+        double const elev = topg[iI] + (ice ? thk[iI] : 0.);
+        emI_ice[iI] = (ice ? elev : NaN);
+        emI_land[iI] = (ice || bedrock ? elev : NaN);
+    }
+}
+
+ElevMaskReader_PISM::ElevMaskReader_PISM(std::string const &fname)
+{
+    std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+    ncio.reset(new NcIO(fname, 'r'));
+    topg_v = ncio->nc->getVar("topg");
+    thk_v = ncio->nc->getVar("thk");
+    mask_v = ncio->nc->getVar("mask");
+
+    // All three fields are read with the same start/count
+    for (auto const &vv : {std::make_pair("topg", &topg_v),
+        std::make_pair("thk", &thk_v), std::make_pair("mask", &mask_v)})
+    {
+        if (vv.second->isNull()) (*icebin_error)(-1,
+            "ElevMaskReader_PISM(%s): missing variable %s", fname.c_str(), vv.first);
+        if (vv.second->getDimCount() != 3) (*icebin_error)(-1,
+            "ElevMaskReader_PISM(%s): %s must have dimensions (time, y, x)",
+            fname.c_str(), vv.first);
+    }
+    _ntime = topg_v.getDim(0).getSize();
+    _ny = topg_v.getDim(1).getSize();
+    _nx = topg_v.getDim(2).getSize();
+    for (auto const &vv : {std::make_pair("thk", &thk_v), std::make_pair("mask", &mask_v)}) {
+        size_t const ntime = vv.second->getDim(0).getSize();
+        size_t const ny = vv.second->getDim(1).getSize();
+        size_t const nx = vv.second->getDim(2).getSize();
+        if (ntime != _ntime || ny != _ny || nx != _nx) (*icebin_error)(-1,
+            "ElevMaskReader_PISM(%s): %s is (%ld, %ld, %ld) but topg is (%ld, %ld, %ld)",
+            fname.c_str(), vv.first, (long)ntime, (long)ny, (long)nx,
+            (long)_ntime, (long)_ny, (long)_nx);
+    }
+}
+
+ElevMaskReader_PISM::~ElevMaskReader_PISM()
+{
+    std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+    ncio.reset();
+}
+
+void ElevMaskReader_PISM::read(size_t itime,
+    size_t j0, size_t nj, size_t i0, size_t ni,
+    double *emI_land, double *emI_ice)
+{
+    if (itime >= _ntime || j0+nj > _ny || i0+ni > _nx) (*icebin_error)(-1,
+        "ElevMaskReader_PISM::read(): record %ld, window [%ld,%ld)x[%ld,%ld) "
+        "out of range (%ld, %ld, %ld)",
+        (long)itime, (long)j0, (long)(j0+nj), (long)i0, (long)(i0+ni),
+        (long)_ntime, (long)_ny, (long)_nx);
+
+    size_t const n = nj * ni;
+    if (n == 0) return;
+    topg.resize(n);
+    thk.resize(n);
+    mask.resize(n);
+
+    std::vector<size_t> const start {itime, j0, i0};
+    std::vector<size_t> const count {1, nj, ni};
+    {std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+    topg_v.getVar(start, count, topg.data());
+    thk_v.getVar(start, count, thk.data());
+    mask_v.getVar(start, count, (signed char *)mask.data());
+    }
+
+    elevmask_pism(n, topg.data(), thk.data(), mask.data(), emI_land, emI_ice);
+}
+
+void ElevMaskReader_PISM::read(size_t itime,
+    blitz::Array<double,1> &emI_land,
+    blitz::Array<double,1> &emI_ice)
+{
+    for (blitz::Array<double,1> *emI : {&emI_land, &emI_ice}) {
+        if (emI->extent(0) != (int)nI() || !emI->isStorageContiguous())
+            emI->reference(blitz::Array<double,1>(nI()));
+    }
+    read(itime, 0, _ny, 0, _nx, emI_land.data(), emI_ice.data());
+}
+
 /** Reads and allocate elevmaskI arrays from a PISM state file.
 @param emI Elevation-mask for continental area (ice and bare land)
 @param emI_ice Elevation-mask for just ice-covered areas */
@@ -28,47 +123,10 @@ void read_elevmask_pism(
     blitz::Array<double,1> &emI_land,
     blitz::Array<double,1> &emI_ice)
 {
-    NcIO ncio(fname, 'r');
-
-    netCDF::NcVar nc_topg = ncio.nc->getVar("topg");
-    std::vector<NamedDim> ndims(named_dims(nc_topg));
-
-    // Allocate arrays 
-    blitz::Array<double,2> topg(ndims[1].extent, ndims[2].extent);
-    blitz::Array<double,2> thk(ndims[1].extent, ndims[2].extent);
-    blitz::Array<int8_t,2> mask(ndims[1].extent, ndims[2].extent);
-
-    // Read into allocated arrays
-    ncio_blitz_partial(ncio, topg, "topg", "double", {}, {itime,0,0}, {1,2});
-    ncio_blitz_partial(ncio, thk, "thk", "double", {}, {itime,0,0}, {1,2});
-    ncio_blitz_partial(ncio, mask, "mask", "double", {}, {itime,0,0}, {1,2});
-
-    // Move to 1D
-    auto topg1(reshape1(topg));
-    auto thk1(reshape1(thk));
-    auto mask1(reshape1(mask));
-    auto nI(topg1.extent(0));
-
-    /* Generate emI_land and emI_ice */
-    emI_land.reference(blitz::Array<double,1>(nI));
-    emI_ice.reference(blitz::Array<double,1>(nI));
-
-    for (int iI=0; iI<nI; ++iI) {
-        switch(mask1(iI)) {
-            case IceMask::GROUNDED_ICE :
-            case IceMask::FLOATING_ICE :
-                emI_land(iI) = emI_ice(iI) = topg1(iI) + thk1(iI);
-            break;
-            case IceMask::ICE_FREE_OCEAN :
-            case IceMask::UNKNOWN :
-                emI_land(iI) = emI_ice(iI) = NaN;
-            break;
-            case IceMask::ICE_FREE_BEDROCK :
-                emI_land(iI) = topg1(iI);
-                emI_ice(iI) = NaN;
-            break;
-        }
-    }
+    // Always allocates new arrays, as before
+    emI_land.reference(blitz::Array<double,1>());
+    emI_ice.reference(blitz::Array<double,1>());
+    ElevMaskReader_PISM(fname).read(itime, emI_land, emI_ice);
 }
 
 void read_elevmask(
@@ -1,7 +1,9 @@
 #ifndef ICEBIN_ELEVMASK_HPP
 #define ICEBIN_ELEVMASK_HPP
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include <blitz/array.h>
 #include <ibmisc/netcdf.hpp>
 
@@ -17,6 +19,46 @@ void read_elevmask_pism(
     blitz::Array<double,1> &emI_land,
     blitz::Array<double,1> &emI_ice);
 
+/** Reads elevmaskI from a PISM state file, one time record (or one
+window of the ice grid) at a time.  The file is kept open between
+reads, and the raw fields are read into buffers reused from one read
+to the next; for tools that go through many records of the same file. */
+class ElevMaskReader_PISM {
+    std::unique_ptr<ibmisc::NcIO> ncio;
+    netCDF::NcVar topg_v, thk_v, mask_v;
+    size_t _ntime, _ny, _nx;    // Dimensions of topg (time, y, x)
+
+    // Raw fields of the last read
+    std::vector<double> topg, thk;
+    std::vector<int8_t> mask;
+
+public:
+    /** Opens fname; topg, thk and mask must all be (time, y, x), of
+    the same size.  Takes netcdf_mutex around all NetCDF calls. */
+    explicit ElevMaskReader_PISM(std::string const &fname);
+    ~ElevMaskReader_PISM();
+
+    size_t ntime() const { return _ntime; }
+    /** Number of ice grid cells in one record */
+    size_t nI() const { return _ny * _nx; }
+
+    /** Reads a window of record itime: rows [j0, j0+nj) and columns
+    [i0, i0+ni) of the (y, x) grid.
+    @param emI_land OUTPUT: Elevation-mask for continental area (ice
+        and bare land) [nj*ni], row-major
+    @param emI_ice OUTPUT: Elevation-mask for just ice-covered areas [nj*ni] */
+    void read(size_t itime,
+        size_t j0, size_t nj, size_t i0, size_t ni,
+        double *emI_land, double *emI_ice);
+
+    /** Reads all of record itime.
+    @param emI_land OUTPUT: Allocated here if not already [nI]
+    @param emI_ice OUTPUT: Allocated here if not already [nI] */
+    void read(size_t itime,
+        blitz::Array<double,1> &emI_land,
+        blitz::Array<double,1> &emI_ice);
+};
+
 /** Reads elevmask from any kind of file */
 void read_elevmask(
 std::string const &xfname,
@@ -0,0 +1,431 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/error.hpp>
+
+using namespace ibmisc;
+using namespace netCDF;
+
+namespace icebin {
+
+/** Position of ix in a sorted index array, or -1 */
+static long find_sorted(std::vector<long> const &index, long ix)
+{
+    // Dense indexing (the usual case) needs no search
+    if (ix >= 0 && ix < (long)index.size() && index[ix] == ix) return ix;
+
+    auto ii(std::lower_bound(index.begin(), index.end(), ix));
+    if (ii == index.end() || *ii != ix) return -1;
+    return ii - index.begin();
+}
+
+/** Permutation that sorts index; or empty if it is already sorted.
+Also checks that indices are unique. */
+static std::vector<long> sort_permutation(
+    std::vector<long> const &index, char const *what)
+{
+    std::vector<long> perm;
+    if (!std::is_sorted(index.begin(), index.end())) {
+        perm.resize(index.size());
+        std::iota(perm.begin(), perm.end(), 0);
+        std::sort(perm.begin(), perm.end(),
+            [&index](long a, long b) { return index[a] < index[b]; });
+    }
+
+    for (size_t i=1; i<index.size(); ++i) {
+        long const a = index[perm.size() ? perm[i-1] : i-1];
+        long const b = index[perm.size() ? perm[i] : i];
+        if (a == b) (*icebin_error)(-1,
+            "Error adding repeat %s index=%ld.  "
+            "Cells and Vertices must have unique indices.", what, b);
+    }
+    return perm;
+}
+
+template<class T>
+static void apply_permutation(std::vector<T> &v, std::vector<long> const &perm)
+{
+    if (perm.size() == 0) return;
+    std::vector<T> v0(std::move(v));
+    v.resize(v0.size());
+    for (size_t i=0; i<perm.size(); ++i) v[i] = v0[perm[i]];
+}
+
+// ========================================================
+long FlatVertices::find(long ix) const
+    { return find_sorted(index, ix); }
+
+FlatVertex FlatVertices::at(long ix) const
+{
+    long const pos = find(ix);
+    if (pos < 0) (*icebin_error)(-1,
+        "Vertex index=%ld is not realized", ix);
+    return vertex(pos);
+}
+
+void FlatVertices::clear()
+{
+    index.clear();
+    x.clear();
+    y.clear();
+}
+
+// --------------------------------------------------------
+long FlatCells::find(long ix) const
+    { return find_sorted(index, ix); }
+
+FlatCell FlatCells::at(long ix) const
+{
+    long const pos = find(ix);
+    if (pos < 0) (*icebin_error)(-1,
+        "Cell index=%ld is not realized", ix);
+    return cell(pos);
+}
+
+void FlatCells::clear()
+{
+    index.clear();
+    native_area.clear();
+    i.clear();
+    j.clear();
+    k.clear();
+    vstart.clear();
+    vref.clear();
+    x.clear();
+    y.clear();
+}
+
+// --------------------------------------------------------
+double FlatCell::proj_area(
+    Proj_LL2XY const *proj) const // OPTIONAL
+{
+    long const v0 = cells->vstart[pos];
+    long const v1 = cells->vstart[pos+1];
+    std::vector<double> const &vx(cells->x);
+    std::vector<double> const &vy(cells->y);
+
+    double ret = 0;
+    double x0, y0;
+
+    // Last vertex of the polygon
+    if (proj) {
+        proj->transform(vx[v1-1], vy[v1-1], x0, y0);
+    } else {
+        x0 = vx[v1-1];
+        y0 = vy[v1-1];
+    }
+
+    for (long v=v0; v<v1; ++v) {
+        double x1, y1;
+        if (proj) {
+            proj->transform(vx[v], vy[v], x1, y1);
+        } else {
+            x1 = vx[v];
+            y1 = vy[v];
+        }
+
+        ret += (x0 * y1) - (x1 * y0);
+        x0 = x1;
+        y0 = y1;
+    }
+    ret *= .5;
+    return ret;
+}
+
+Point FlatCell::centroid() const
+{
+    long const v0 = cells->vstart[pos];
+    long const v1 = cells->vstart[pos+1];
+    std::vector<double> const &vx(cells->x);
+    std::vector<double> const &vy(cells->y);
+
+    double A2 = 0;        // Will be 2A
+    double Cx = 0;
+    double Cy = 0;
+    long vp = v1-1;
+    for (long v=v0; v<v1; vp=v, ++v) {
+        double dA = vx[vp]*vy[v] - vx[v]*vy[vp];
+        A2 += dA;
+        Cx += (vx[vp] + vx[v]) * dA;
+        Cy += (vy[vp] + vy[v]) * dA;
+    }
+
+    double w = 1./(3.*A2);    // 1/6A
+    return Point(w*Cx, w*Cy);
+}
+
+// ========================================================
+FlatGrid::FlatGrid(Grid const &grid) :
+    spec(grid.spec ? grid.spec->clone() : std::unique_ptr<GridSpec>()),
+    coordinates(grid.coordinates),
+    parameterization(grid.parameterization),
+    indexing(grid.indexing),
+    name(grid.name),
+    sproj(grid.sproj)
+{
+    vertices._nfull = grid.vertices.nfull();
+    cells._nfull = grid.cells.nfull();
+
+    std::vector<Vertex const *> svertices(grid.vertices.sorted());
+    vertices.index.reserve(svertices.size());
+    vertices.x.reserve(svertices.size());
+    vertices.y.reserve(svertices.size());
+    for (Vertex const *vertex : svertices) {
+        vertices.index.push_back(vertex->index);
+        vertices.x.push_back(vertex->x);
+        vertices.y.push_back(vertex->y);
+    }
+
+    std::vector<Cell const *> scells(grid.cells.sorted());
+    size_t const n = scells.size();
+    cells.index.reserve(n);
+    cells.native_area.reserve(n);
+    cells.i.reserve(n);
+    cells.j.reserve(n);
+    cells.k.reserve(n);
+    cells.vstart.reserve(n+1);
+    cells.vstart.push_back(0);
+    for (Cell const *cell : scells) {
+        cells.index.push_back(cell->index);
+        cells.native_area.push_back(cell->native_area);
+        cells.i.push_back(cell->i);
+        cells.j.push_back(cell->j);
+        cells.k.push_back(cell->k);
+        for (auto vertex = cell->begin(); vertex != cell->end(); ++vertex) {
+            cells.vref.push_back(vertex->index);
+            cells.x.push_back(vertex->x);
+            cells.y.push_back(vertex->y);
+        }
+        cells.vstart.push_back(cells.vref.size());
+    }
+}
+
+size_t FlatGrid::ndata() const
+{
+    if (parameterization == GridParameterization::L1)
+        return vertices.nfull();
+    else
+        return cells.nfull();
+}
+
+size_t FlatGrid::nrealized() const
+{
+    if (parameterization == GridParameterization::L1)
+        return vertices.nrealized();
+    else
+        return cells.nrealized();
+}
+
+void FlatGrid::clear()
+{
+    vertices.clear();
+    cells.clear();
+}
+
+Grid FlatGrid::to_grid() const
+{
+    GridMap<Vertex> gvertices(vertices._nfull);
+    for (size_t pos=0; pos < vertices.nrealized(); ++pos)
+        gvertices.add(Vertex(vertices.x[pos], vertices.y[pos], vertices.index[pos]));
+
+    GridMap<Cell> gcells(cells._nfull);
+    for (size_t pos=0; pos < cells.nrealized(); ++pos) {
+        Cell cell;
+        cell.index = cells.index[pos];
+        cell.native_area = cells.native_area[pos];
+        cell.i = cells.i[pos];
+        cell.j = cells.j[pos];
+        cell.k = cells.k[pos];
+        cell.reserve(cells.vstart[pos+1] - cells.vstart[pos]);
+        for (long v = cells.vstart[pos]; v < cells.vstart[pos+1]; ++v)
+            cell.add_vertex(gvertices.at(cells.vref[v]));
+        gcells.add(std::move(cell));
+    }
+
+    return Grid(name,
+        spec ? spec->clone() : std::unique_ptr<GridSpec>(),
+        coordinates, sproj, parameterization,
+        Indexing(indexing),
+        std::move(gvertices), std::move(gcells));
+}
+
+// ------------------------------------------------------------
+void FlatGrid::nc_write(netCDF::NcGroup *nc, std::string const &vname) const
+{
+    // ---------- Write out the vertices
+    {
+        size_t const nv = vertices.nrealized();
+        std::vector<int> vindex(vertices.index.begin(), vertices.index.end());
+        std::vector<double> vxy(nv*2);
+        for (size_t i=0; i<nv; ++i) {
+            vxy[i*2+0] = vertices.x[i];
+            vxy[i*2+1] = vertices.y[i];
+        }
+
+        nc->getVar(vname + ".vertices.index").putVar({0}, {nv}, vindex.data());
+        nc->getVar(vname + ".vertices.xy").putVar({0,0}, {nv,2}, vxy.data());
+    }
+
+    // -------- Write out the cells (and vertex references)
+    {
+        size_t const nc_ = cells.nrealized();
+        std::vector<int> cindex(cells.index.begin(), cells.index.end());
+        std::vector<int> ijk(nc_*3);
+        for (size_t i=0; i<nc_; ++i) {
+            ijk[i*3+0] = cells.i[i];
+            ijk[i*3+1] = cells.j[i];
+            ijk[i*3+2] = cells.k[i];
+        }
+        std::vector<int> vrefs(cells.vref.begin(), cells.vref.end());
+        std::vector<int> vrefs_start(cells.vstart.begin(), cells.vstart.end());
+
+        nc->getVar(vname + ".cells.index").putVar({0}, {nc_}, cindex.data());
+        nc->getVar(vname + ".cells.ijk").putVar({0,0}, {nc_,3}, ijk.data());
+        nc->getVar(vname + ".cells.native_area").putVar({0}, {nc_}, cells.native_area.data());
+        nc->getVar(vname + ".cells.vertex_refs").putVar({0}, {vrefs.size()}, vrefs.data());
+        nc->getVar(vname + ".cells.vertex_refs_start").putVar({0}, {vrefs_start.size()}, vrefs_start.data());
+    }
+}
+
+/** Reads the same variables as Grid::nc_read(), directly into
+contiguous arrays. */
+void FlatGrid::nc_read(
+netCDF::NcGroup *nc,
+std::string const &vname)
+{
+    clear();
+
+    // ---------- Read the Vertices
+    {
+        auto vertices_index(nc_read_blitz
+            <long, 1>(nc, vname + ".vertices.index"));
+        auto vertices_xy(nc_read_blitz
+            <double, 2>(nc, vname + ".vertices.xy"));
+
+        int const nv = vertices_index.extent(0);
+        vertices.index.resize(nv);
+        vertices.x.resize(nv);
+        vertices.y.resize(nv);
+        for (int i=0; i < nv; ++i) {
+            vertices.index[i] = vertices_index(i);
+            vertices.x[i] = vertices_xy(i,0);
+            vertices.y[i] = vertices_xy(i,1);
+        }
+
+        // Files written by Grid::nc_write() are already sorted
+        auto perm(sort_permutation(vertices.index, "vertex"));
+        apply_permutation(vertices.index, perm);
+        apply_permutation(vertices.x, perm);
+        apply_permutation(vertices.y, perm);
+    }
+
+    // ---------- Read the Cells
+    {
+        auto cells_index(nc_read_blitz
+            <long, 1>(nc, vname + ".cells.index"));
+        int const ncell = cells_index.extent(0);
+
+        // Some grids (eg, ISSM) don't have this.  It is optional
+        NcVar cells_ijk_var(nc->getVar(vname + ".cells.ijk"));
+        blitz::Array<long,2> cells_ijk;
+        if (!cells_ijk_var.isNull()) {
+            cells_ijk.reference(nc_read_blitz
+                <long, 2>(nc, vname + ".cells.ijk"));
+        }
+
+        NcVar native_area_var(nc->getVar(vname + ".cells.native_area"));
+        blitz::Array<double,1> native_area;
+        if (!native_area_var.isNull()) {
+            native_area.reference(nc_read_blitz
+                <double, 1>(nc, vname + ".cells.native_area"));
+        }
+
+        auto vrefs(nc_read_blitz
+            <long, 1>(nc, vname + ".cells.vertex_refs"));
+        auto vrefs_start(nc_read_blitz
+            <long, 1>(nc, vname + ".cells.vertex_refs_start"));
+
+        // Cells are visited in sorted order
+        std::vector<long> index(cells_index.begin(), cells_index.end());
+        auto perm(sort_permutation(index, "cell"));
+
+        cells.index.reserve(ncell);
+        cells.native_area.reserve(ncell);
+        cells.i.reserve(ncell);
+        cells.j.reserve(ncell);
+        cells.k.reserve(ncell);
+        cells.vstart.reserve(ncell+1);
+        cells.vref.reserve(vrefs.extent(0));
+        cells.x.reserve(vrefs.extent(0));
+        cells.y.reserve(vrefs.extent(0));
+
+        cells.vstart.push_back(0);
+        for (int ii=0; ii < ncell; ++ii) {
+            int const i = (perm.size() ? perm[ii] : ii);
+
+            cells.index.push_back(cells_index(i));
+            if (!cells_ijk_var.isNull()) {
+                cells.i.push_back(cells_ijk(i,0));
+                cells.j.push_back(cells_ijk(i,1));
+                cells.k.push_back(cells_ijk(i,2));
+            } else {
+                cells.i.push_back(0);
+                cells.j.push_back(0);
+                cells.k.push_back(0);
+            }
+            cells.native_area.push_back(
+                native_area_var.isNull() ? 0 : native_area(i));
+
+            // Add the vertices
+            for (int j = vrefs_start(i); j < vrefs_start(i+1); ++j) {
+                long const vpos = vertices.find(vrefs(j));
+                if (vpos < 0) (*icebin_error)(-1,
+                    "Cell %ld references missing vertex %ld",
+                    (long)cells_index(i), (long)vrefs(j));
+                cells.vref.push_back(vertices.index[vpos]);
+                cells.x.push_back(vertices.x[vpos]);
+                cells.y.push_back(vertices.y[vpos]);
+            }
+            cells.vstart.push_back(cells.vref.size());
+        }
+    }
+}
+
+void FlatGrid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
+{
+    auto info_v(ncio_grid_info(ncio, vname, spec, name,
+        coordinates, parameterization, indexing, sproj,
+        cells._nfull, vertices._nfull));
+
+    // ------- Only read the rest of this on MPI root
+    if (!rw_full) return;
+
+    if (ncio.rw == 'w') {
+        define_grid_vars(ncio, vname, info_v,
+            vertices.nrealized(), cells.nfull(), cells.nrealized(), cells.vref.size());
+
+        ncio += std::bind(&FlatGrid::nc_write, this, ncio.nc, vname);
+    } else {
+        nc_read(ncio.nc, vname);
+    }
+}
+
+}   // namespace icebin
@@ -0,0 +1,253 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <iterator>
+
+#include <ibmisc/netcdf.hpp>
+#include <ibmisc/Proj2.hpp>
+#include <ibmisc/indexing.hpp>
+
+#include <icebin/Grid.hpp>
+
+namespace icebin {
+
+/** Iterator over positions 0..n-1 of a flat (structure-of-arrays)
+container.  Dereferencing assembles a (lightweight) value from the
+container's arrays: it returns a reference to a copy held in the
+iterator, valid until the iterator is moved. */
+template<class ContainerT, class ValueT, ValueT (ContainerT::*GetT)(long) const>
+class FlatIter {
+    ContainerT const *c;
+    long pos;
+    mutable ValueT val;
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef ValueT value_type;
+    typedef long difference_type;
+    typedef ValueT const *pointer;
+    typedef ValueT const &reference;
+
+    FlatIter(ContainerT const *_c, long _pos) : c(_c), pos(_pos) {}
+
+    ValueT const &operator*() const
+        { val = (c->*GetT)(pos); return val; }
+    ValueT const *operator->() const
+        { return &**this; }
+
+    FlatIter &operator++() { ++pos; return *this; }
+    FlatIter &operator--() { --pos; return *this; }
+    FlatIter operator+(long n) const { return FlatIter(c, pos+n); }
+    FlatIter operator-(long n) const { return FlatIter(c, pos-n); }
+    long operator-(FlatIter const &other) const { return pos - other.pos; }
+
+    bool operator==(FlatIter const &other) const { return pos == other.pos; }
+    bool operator!=(FlatIter const &other) const { return pos != other.pos; }
+};
+
+/** A vertex of a FlatGrid */
+struct FlatVertex {
+    double x, y;
+    long index;
+};
+
+class FlatCell;
+class FlatGrid;
+
+// ----------------------------------------------------
+/** Vertices of a FlatGrid, sorted by index. */
+class FlatVertices {
+    friend class FlatGrid;
+public:
+    std::vector<long> index;
+    std::vector<double> x, y;
+protected:
+    long _nfull = -1;
+
+public:
+    FlatVertex vertex(long pos) const
+        { return FlatVertex{x[pos], y[pos], index[pos]}; }
+
+    typedef FlatIter<FlatVertices, FlatVertex, &FlatVertices::vertex> const_iterator;
+    typedef const_iterator iterator;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, index.size()); }
+
+    size_t nrealized() const { return index.size(); }
+    size_t nfull() const
+        { return _nfull >= 0 ? _nfull : (index.size() == 0 ? 0 : index.back()+1); }
+
+    /** Sets nfull(); by default, the largest index + 1 */
+    void set_nfull(long nfull) { _nfull = nfull; }
+
+    /** @return Position of a vertex in the arrays, or -1 if not realized. */
+    long find(long ix) const;
+
+    FlatVertex at(long ix) const;
+
+    void clear();
+};
+
+// ----------------------------------------------------
+/** Cells of a FlatGrid, sorted by index.  Polygons are stored in CSR
+form: the vertices of the cell at position pos are at positions
+[vstart[pos], vstart[pos+1]) of vref, x and y.  Vertex coordinates
+are copied into each cell that references them, so iterating over a
+cell's vertices can stream through memory. */
+class FlatCells {
+    friend class FlatGrid;
+public:
+    std::vector<long> index;
+    std::vector<double> native_area;
+    std::vector<int> i, j, k;
+
+    std::vector<long> vstart;    // Length nrealized()+1
+    std::vector<long> vref;      // Index of each vertex (see FlatVertices)
+    std::vector<double> x, y;    // Coordinates of each vertex
+protected:
+    long _nfull = -1;
+
+public:
+    FlatCell cell(long pos) const;
+
+    FlatVertex vertex(long vpos) const
+        { return FlatVertex{x[vpos], y[vpos], vref[vpos]}; }
+
+    typedef FlatIter<FlatCells, FlatCell, &FlatCells::cell> const_iterator;
+    typedef const_iterator iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    size_t nrealized() const { return index.size(); }
+    size_t nfull() const
+        { return _nfull >= 0 ? _nfull : (index.size() == 0 ? 0 : index.back()+1); }
+
+    /** Sets nfull(); by default, the largest index + 1 */
+    void set_nfull(long nfull) { _nfull = nfull; }
+
+    /** @return Position of a cell in the arrays, or -1 if not realized. */
+    long find(long ix) const;
+
+    /** Unlike GridMap::at(), returns a handle by value. */
+    FlatCell at(long ix) const;
+
+    void clear();
+};
+
+// ----------------------------------------------------
+/** Handle to one cell of a FlatGrid, with the read-only parts of the
+Cell interface. */
+class FlatCell {
+    FlatCells const *cells;
+    long pos;    // Position in cells' arrays
+public:
+    long index;
+    double native_area;
+    int i, j, k;
+
+    typedef FlatIter<FlatCells, FlatVertex, &FlatCells::vertex> const_iterator;
+    typedef const_iterator iterator;
+
+    FlatCell() : cells(nullptr), pos(-1), index(-1), native_area(0), i(-1), j(-1), k(-1) {}
+
+    FlatCell(FlatCells const *_cells, long _pos) :
+        cells(_cells), pos(_pos),
+        index(_cells->index[_pos]), native_area(_cells->native_area[_pos]),
+        i(_cells->i[_pos]), j(_cells->j[_pos]), k(_cells->k[_pos]) {}
+
+    bool operator<(FlatCell const &rhs) const
+        { return index < rhs.index; }
+
+    size_t size() const
+        { return cells->vstart[pos+1] - cells->vstart[pos]; }
+
+    const_iterator begin(int ix = 0) const
+        { return const_iterator(cells, cells->vstart[pos] + ix); }
+    const_iterator end(int ix = 0) const
+        { return const_iterator(cells, cells->vstart[pos+1] + ix); }
+    const_iterator cbegin(int ix = 0) const { return begin(ix); }
+    const_iterator cend(int ix = 0) const { return end(ix); }
+
+    /** Same as Cell::proj_area() */
+    double proj_area(ibmisc::Proj_LL2XY const *proj) const;   // OPTIONAL
+
+    /** Same as Cell::centroid() */
+    Point centroid() const;
+};
+
+inline FlatCell FlatCells::cell(long pos) const
+    { return FlatCell(this, pos); }
+inline FlatCells::const_iterator FlatCells::begin() const
+    { return const_iterator(this, 0); }
+inline FlatCells::const_iterator FlatCells::end() const
+    { return const_iterator(this, index.size()); }
+
+// ----------------------------------------------------
+/** Compact, read-only alternative to Grid.  Cells and vertices are
+kept in a few contiguous arrays, rather than one heap allocation per
+cell and vertex: reading a multi-million-cell grid costs a handful
+of allocations, and iteration is sequential in memory (and in cell
+index).  Offers the same members and iterator interface as Grid, so
+code templated on the grid type (make_exchange_grid(), AbbrGrid) can
+run on either.  Uses the same NetCDF format as Grid. */
+class FlatGrid {
+public:
+    FlatVertices vertices;
+    FlatCells cells;
+
+    std::unique_ptr<GridSpec> spec;    // Details used to generate the grid
+    GridCoordinates coordinates;
+    GridParameterization parameterization;
+    ibmisc::Indexing indexing;
+    std::string name;
+    std::string sproj;
+
+    FlatGrid() {}
+
+    /** Flattens a Grid */
+    explicit FlatGrid(Grid const &grid);
+
+    /** Same as Grid::ndata() */
+    size_t ndata() const;
+
+    /** Same as Grid::nrealized() */
+    size_t nrealized() const;
+
+    void clear();
+
+    Point centroid(FlatCell const &cell) const
+        { return cell.centroid(); }
+
+    /** Converts back to a Grid, eg for writing with code that
+    builds on GridMap */
+    Grid to_grid() const;
+
+protected:
+    void nc_read(netCDF::NcGroup *nc, std::string const &vname);
+    void nc_write(netCDF::NcGroup *nc, std::string const &vname) const;
+public:
+    /** Same as Grid::ncio() */
+    void ncio(ibmisc::NcIO &ncio, std::string const &vname, bool rw_full=true);
+};
+
+}   // namespace icebin
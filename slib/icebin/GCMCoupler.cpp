@@ -18,6 +18,11 @@
 
 #include <mpi.h>        // Intel MPI wants to be first
 #include <functional>
+#include <exception>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <memory>
 #include <boost/format.hpp>
 #include <boost/algorithm/string.hpp>
 #include <ibmisc/netcdf.hpp>
@@ -29,6 +34,9 @@
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/contracts/contracts.hpp>
 #include <icebin/e1ve0.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/memsize.hpp>
+#include <icebin/parallel.hpp>
 #include <spsparse/netcdf.hpp>
 
 #ifdef USE_PISM
@@ -100,6 +108,19 @@ std::string GCMCoupler::sdate(double time_s) const
         ("%04d%02d%02d") % dt[0] % dt[1] % dt[2]).str();
 }
 
+void GCMCoupler::report_profile(double time_s) const
+{
+    std::string const label("couple " + sdate(time_s));
+    if (am_i_root() || profile::verbose)
+        profile::report(stdout, gcm_params.gcm_rank, label);
+    if (gcm_params.icebin_logging && output_dir != "") {
+        profile::report_json(
+            (boost::format("%s/profile-%d.json") % output_dir % gcm_params.gcm_rank).str(),
+            gcm_params.gcm_rank, label);
+    }
+    profile::reset();
+}
+
 
 /** Static-cast a unique_ptr while moving it to another unique_ptr */
 template<typename D, typename B>
@@ -115,10 +136,60 @@ void GCMCoupler::_ncread(
     std::string const &vname)        // comes from this->gcm_params
 {
     auto config_info(get_or_add_var(ncio_config, vname + ".info", "int", {}));
-    std::string grid_fname;
+    int num_threads = 0;
+    bool pin_threads = false;
+    bool first_touch = false;
     get_or_put_att(config_info, ncio_config.rw, "grid", grid_fname);
     get_or_put_att(config_info, ncio_config.rw, "output_dir", output_dir);
     get_or_put_att(config_info, ncio_config.rw, "use_smb", &use_smb, 1);
+    {auto atts(config_info.getAtts());
+    if (atts.find("matrix_precision") != atts.end())
+        get_or_put_att_enum(config_info, ncio_config.rw, "matrix_precision", matrix_precision);
+    if (atts.find("nan_check") != atts.end())
+        get_or_put_att_enum(config_info, ncio_config.rw, "nan_check", nan_check);
+    if (atts.find("distributed_regrid") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "distributed_regrid", &distributed_regrid, 1);
+    if (atts.find("distributed_ice") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "distributed_ice", &distributed_ice, 1);
+    if (atts.find("concurrent_sheets") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "concurrent_sheets", &concurrent_sheets, 1);
+    if (atts.find("combined_regrid") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "combined_regrid", &combined_regrid, 1);
+    if (atts.find("factor_E1vE0c") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "factor_E1vE0c", &factor_E1vE0c, 1);
+    if (atts.find("verbose") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "verbose", &profile::verbose, 1);
+    if (atts.find("compensated_sums") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "compensated_sums", &compensated_sums, 1);
+    if (atts.find("num_threads") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "num_threads", &num_threads, 1);
+    if (atts.find("pin_threads") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "pin_threads", &pin_threads, 1);
+    if (atts.find("first_touch") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "first_touch", &first_touch, 1);
+    if (atts.find("matrix_stats") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "matrix_stats", &matrix_stats, 1);
+    if (atts.find("sparse_logging") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "sparse_logging", &sparse_logging, 1);
+    if (atts.find("async_logging") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "async_logging", &async_logging, 1);
+    }
+    if (distributed_regrid && distributed_ice) (*icebin_error)(-1,
+        "distributed_regrid cannot be combined with distributed_ice");
+    if (combined_regrid && (distributed_regrid || distributed_ice)) (*icebin_error)(-1,
+        "combined_regrid cannot be combined with distributed_regrid or distributed_ice");
+
+    // One set of IceBin threads per rank, sharing the node with the
+    // other ranks of gcm_comm on it
+    {MPI_Comm node_comm;
+    int node_rank, node_size;
+    MPI_Comm_split_type(gcm_params.gcm_comm, MPI_COMM_TYPE_SHARED,
+        gcm_params.gcm_rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_free(&node_comm);
+    init_threads(node_rank, node_size, num_threads, pin_threads, first_touch);
+    }
 
     printf("BEGIN GCMCoupler::ncread(%s)\n", grid_fname.c_str()); fflush(stdout);
 
@@ -128,7 +199,7 @@ void GCMCoupler::_ncread(
     // Also load the ice sheets
     {
         std::unique_ptr<GCMRegridder_Standard> gcmr(new GCMRegridder_Standard());
-        NcIO ncio_grid(grid_fname, NcFile::read);
+        NcIO ncio_grid(stage_input(grid_fname), NcFile::read);
         gcmr->ncio(ncio_grid, vname);
         static_move(gcm_regridder, gcmr);    // Move gcm_regridder <- gcm
     }
@@ -154,7 +225,7 @@ void GCMCoupler::_ncread(
             ncio_config, vname, ice_regridder->name(), this));
 
         // Add to basesX and areaX (X = combined exchange grid for all ice sheets)
-        auto const &aexgrid(ice_regridder->aexgrid);    // Exchange grid
+        auto const &aexgrid(ice_regridder->load()->aexgrid);    // Exchange grid
         basesX.push_back(basesX.back() + aexgrid.sparse_extent());
         for (int iXd=0; iXd<aexgrid.dense_extent(); ++iXd) {
             areaX.push_back(aexgrid.native_area(iXd));
@@ -177,6 +248,17 @@ void GCMCoupler::model_start(
     time_unit = TimeUnit(&cal365, time_base, TimeUnit::SECOND);
     timespan = std::array<double,2>{-1,time_start_s};
 
+    // Finishes any writes from a previous start, before the writers are replaced
+    log_writer.reset();
+    if (async_logging > 0) log_writer.reset(new AsyncWriter(async_logging));
+
+    // Needed to replay the gcm-out logs
+    if (gcm_params.icebin_logging && am_i_root()) {
+        NcIO ncio("gcm-contract.nc", 'w');
+        ncio_contracts(ncio);
+        ncio.close();
+    }
+
     for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
         auto &ice_coupler(ice_couplers[sheetix]);
 
@@ -190,6 +272,18 @@ void GCMCoupler::model_start(
 
     printf("END GCMCoupler::model_start()\n");
 }
+
+GCMCoupler::~GCMCoupler()
+{
+    // Queued writes refer to the ice couplers; finish them first
+    log_writer.reset();
+}
+
+void GCMCoupler::log_write(std::function<void()> &&write)
+{
+    if (log_writer) log_writer->push(std::move(write));
+    else write();
+}
 // ------------------------------------------------------------
 
 static void ncwrite_dense_VectorMultivec(
@@ -202,7 +296,8 @@ static void ncwrite_dense_VectorMultivec(
 {
     // NOTE: This code is in E (elevation grid); but it works just as
     // well for A (atmosphere grid)
-printf("BEGIN ncwrite_dense_VectorMultivec(nnz=%ld)\n", vecs->index.size());
+    ICEBIN_PROFILE_SCOPE("ncwrite_dense_VectorMultivec");
+    ICEBIN_PROFILE_NNZ(vecs->index.size());
 
     // im,jm,ihc  0-based
     long nE = indexing->extent();
@@ -234,7 +329,6 @@ printf("BEGIN ncwrite_dense_VectorMultivec(nnz=%ld)\n", vecs->index.size());
         ncvar.putVar(startp, countp, denseE.data());
     }
 
-printf("END ncwrite_dense_VectorMultivec()\n");
 }
 
 /** Densifies the sparse vectors, and then writes them out to netCDF */
@@ -264,6 +358,108 @@ printf("BEGIN ncio_dense1('%s')\n", ncio.fname.c_str());
 printf("END ncio_dense()\n");
 }
 // --------------------------------------------------------------
+/** A VectorMultivec consolidated to one element per (sorted) index,
+with the values ncio_dense() would have written there. */
+struct SparseLog {
+    std::vector<long> index;
+    std::vector<double> vals;    // vals[ivar*nnz + i]
+};
+
+static void ncwrite_sparse_VectorMultivec(
+    NcGroup * const nc,
+    std::shared_ptr<SparseLog> const &log,
+    VarSet const *contract,
+    std::string const &vname_base,
+    std::string const &vname_index)
+{
+    ICEBIN_PROFILE_SCOPE("ncwrite_sparse_VectorMultivec");
+    size_t const nnz = log->index.size();
+    if (nnz == 0) return;
+
+    nc->getVar(vname_index + "index").putVar({0,0}, {1,nnz}, log->index.data());
+    for (size_t ivar=0; ivar < contract->size(); ++ivar) {
+        NcVar ncvar(nc->getVar(vname_base + (*contract)[ivar].name));
+        ncvar.putVar({0,0}, {1,nnz}, &log->vals[ivar*nnz]);
+    }
+}
+
+/** Like ncio_dense(), but only writes the grid cells present in vecs.
+Dense fields may be reconstructed with pylib/icebin/iblog.py
+@param vname_index Prefix for the index variable and its dimension;
+    distinct for each vecs written to the same file. */
+static void ncio_sparse(
+    NcIO &ncio,
+    VectorMultivec const &vecs,
+    VarSet const &contract,
+    ibmisc::Indexing const &indexing,
+    UTSystem const &ut_system,
+    std::string const &vname_base,
+    std::string const &vname_index)
+{
+    if (ncio.rw != 'w') (*icebin_error)(-1,
+        "ncio_sparse(VectorMultivec) only writes, no read.");
+
+    // Consolidate, scaling as in VectorMultivec::to_dense()
+    std::vector<size_t> order(vecs.size());
+    for (size_t i=0; i<order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&vecs](size_t a, size_t b) { return vecs.index[a] < vecs.index[b]; });
+
+    int const nvar = vecs.nvar;
+    std::vector<double> factor(nvar);
+    for (int ivar=0; ivar<nvar; ++ivar)
+        factor[ivar] = contract[ivar].nc_factor(ut_system);
+
+    std::vector<double> vals;    // [nnz, nvar] while consolidating
+    auto log(std::make_shared<SparseLog>());
+    for (size_t j=0; j<order.size(); ) {
+        long const iE = vecs.index[order[j]];
+        double weight = 0;
+        size_t const base = vals.size();
+        vals.resize(base + nvar, 0.);
+        for (; j<order.size() && vecs.index[order[j]] == iE; ++j) {
+            weight += vecs.weights[order[j]];
+            for (int ivar=0; ivar<nvar; ++ivar)
+                vals[base+ivar] += vecs.val(ivar, order[j]);
+        }
+        for (int ivar=0; ivar<nvar; ++ivar)
+            vals[base+ivar] *= factor[ivar] / weight;
+        log->index.push_back(iE);
+    }
+    long nnz = log->index.size();
+    log->vals.resize(vals.size());
+    for (long i=0; i<nnz; ++i)
+    for (int ivar=0; ivar<nvar; ++ivar)
+        log->vals[ivar*nnz + i] = vals[i*nvar + ivar];
+
+    // Dense dimensions, in NetCDF (stride-descending) order
+    std::vector<std::string> dense_names;
+    std::vector<long> dense_extents;
+    for (int dimi : indexing.indices()) {
+        dense_names.push_back(indexing[dimi].name);
+        dense_extents.push_back(indexing[dimi].extent);
+    }
+    get_or_add_dims(ncio, dense_names, dense_extents);
+
+    // (NetCDF dimensions cannot be zero-length)
+    auto dims(get_or_add_dims(ncio, {"time", vname_index + "nnz"},
+        {1, std::max(nnz, 1L)}));
+    NcVar index_v(get_or_add_var(ncio, vname_index + "index", "int64", dims));
+    index_v.putAtt("dense_dims", boost::algorithm::join(dense_names, " "));
+    get_or_put_att(index_v, ncio.rw, "nnz", "int64", &nnz, 1);
+    nc_deflate(ncio.nc, index_v);
+
+    contract.ncdefine(ncio, dims, vname_base);
+    for (size_t ivar=0; ivar < contract.size(); ++ivar) {
+        NcVar ncvar(ncio.nc->getVar(vname_base + contract[ivar].name));
+        ncvar.putAtt("sparse_index", vname_index + "index");
+        nc_deflate(ncio.nc, ncvar);
+    }
+
+    ncio.add("ncio_sparse::" + vname_index, std::bind(ncwrite_sparse_VectorMultivec,
+        ncio.nc, log, &contract, vname_base, vname_index));
+}
+// --------------------------------------------------------------
 #if 0	// Not needed
 static void ncwrite_dense_TupleList1(
     NcGroup * const nc,
@@ -349,13 +545,19 @@ void GCMCoupler::ncio_gcm_input(NcIO &ncio,
         }
 
         // The indexing is used from gcm_regridder.  This will result in nhc_ice
-        ncio_dense(ncio, out.gcm_ivalss_s[iAE], gcm_inputs[iAE],
+        if (sparse_logging) ncio_sparse(ncio, out.gcm_ivalss_s[iAE], gcm_inputs[iAE],
+            *indexing, ut_system, vname_base, vname_base + IndexAE_labels[iAE] + ".");
+        else ncio_dense(ncio, out.gcm_ivalss_s[iAE], gcm_inputs[iAE],
             *indexing, ut_system, vname_base);
 
     }
 
 //    ncio_spsparse(ncio, out.E1vE0_unscaled, false, vname_base+"E1vE0_unscaled");
     out.E1vE0c.ncio(ncio, vname_base+"E1vE0c");
+    if (factor_E1vE0c) {
+        out.E1vXc.ncio(ncio, vname_base+"E1vXc");
+        out.XvE0c.ncio(ncio, vname_base+"XvE0c");
+    }
 }
 
 
@@ -367,22 +569,46 @@ void GCMCoupler::ncio_rsf(ibmisc::NcIO &ncio)
         XuE0s.clear();
         XuE0s.reserve(ice_couplers.size());
         for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
-            XuE0s.push_back(std::unique_ptr<ibmisc::linear::Weighted_Eigen>());
+            // Only sheets that had been coupled when the file was written
+            std::string const vname("GCMCoupler."+ice_couplers[sheetix]->name()+".XuE0");
+            XuE0s.push_back(std::unique_ptr<CompactWeighted>(
+                CompactSparseMatrix::has_compact(ncio.nc, vname + ".M") ?
+                new CompactWeighted() : nullptr));
         }
     }
 
-//    for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
+    // Numbering of the columns of XuE0s; dimEc is set from it at the
+    // next couple(), once read.  Files written before it was kept have
+    // XuE0s in sparse E; they are compacted then.
+    if (ncio.rw == 'r') {
+        dimEc = CompactE();
+        _ncio_dimEc.clear();
+        XuE0s_sparse = ncio.nc->getVar("GCMCoupler.dimEc").isNull();
+    } else {
+        _ncio_dimEc = dimEc.sparse_indices();
+    }
+    if (ncio.rw == 'w' || !XuE0s_sparse) {
+        ncio_vector(ncio, _ncio_dimEc, true, "GCMCoupler.dimEc", "int64",
+            get_or_add_dims(ncio, {"GCMCoupler.dimEc.n"}, {(long)_ncio_dimEc.size()}));
+    }
+
     for (size_t sheetix=0; sheetix < XuE0s.size(); ++sheetix) {
 
         if (XuE0s[sheetix].get() == nullptr) continue;
         auto &ice_coupler(ice_couplers[sheetix]);
 
-        XuE0s[sheetix]->ncio(ncio, "GCMCoupler."+ice_coupler->name()+".XuE0",
-            {"dimXs", "dimEs"});
+        XuE0s[sheetix]->ncio_compact(ncio, "GCMCoupler."+ice_coupler->name()+".XuE0");
         ice_coupler->ncio_icebin_rsf(ncio);
     }
 }
 
+void GCMCoupler::load_rsf() const
+{
+    for (auto &XuE0 : XuE0s) if (XuE0) XuE0->M.load();
+    for (auto &ice_coupler : ice_couplers)
+        if (ice_coupler->IvE0) ice_coupler->IvE0->load();
+}
+
 /** Top-level ncio() to log input to coupler. (GCM->coupler) */
 void GCMCoupler::ncio_gcm_output(NcIO &ncio,
     VectorMultivec const &gcm_ovalsE,
@@ -392,12 +618,106 @@ void GCMCoupler::ncio_gcm_output(NcIO &ncio,
 {
 printf("BEGIN GCMCoupler::ncio_gcm_output('%s' '%s')\n", ncio.fname.c_str(), vname_base.c_str());
     ncio_timespan(ncio, timespan, time_unit, vname_base + "timespan");
-    ncio_dense(ncio, gcm_ovalsE, gcm_outputsE,
+    if (sparse_logging) ncio_sparse(ncio, gcm_ovalsE, gcm_outputsE,
+        gcm_regridder->indexingE, ut_system, vname_base, vname_base + "E.");
+    else ncio_dense(ncio, gcm_ovalsE, gcm_outputsE,
         gcm_regridder->indexingE, ut_system, vname_base);
 printf("END GCMCoupler::ncio_gcm_output(%s)\n", vname_base.c_str());
 }
+
+void GCMCoupler::read_gcm_output(std::string const &fname,
+    VectorMultivec &gcm_ovalsE,
+    std::array<double,2> &timespan,
+    std::string const &vname_base)
+{
+    ICEBIN_PROFILE_SCOPE("GCMCoupler::read_gcm_output");
+    NcIO ncio(fname, 'r');
+    ncio_timespan(ncio, timespan, time_unit, vname_base + "timespan");
+
+    int const nvar = gcm_outputsE.size();
+    std::vector<double> factor(nvar);
+    std::vector<netCDF::NcVar> ncvars;
+    for (int ivar=0; ivar<nvar; ++ivar) {
+        factor[ivar] = gcm_outputsE[ivar].nc_factor(ut_system);
+        ncvars.push_back(ncio.nc->getVar(vname_base + gcm_outputsE[ivar].name));
+        if (ncvars.back().isNull()) (*icebin_error)(-1,
+            "Variable %s%s not found in %s", vname_base.c_str(),
+            gcm_outputsE[ivar].name.c_str(), fname.c_str());
+    }
+
+    gcm_ovalsE = VectorMultivec(nvar);
+    std::vector<double> val(nvar);
+    NcVar index_v(ncio.nc->getVar(vname_base + "E.index"));
+    if (!index_v.isNull()) {
+        // sparse_logging: (time, nnz) arrays; see ncio_sparse()
+        long nnz;
+        get_or_put_att(index_v, 'r', "nnz", "int64", &nnz, 1);
+        std::vector<long> index(nnz);
+        std::vector<double> vals(nnz * nvar);    // vals[ivar*nnz + i]
+        if (nnz > 0) {
+            index_v.getVar({0,0}, {1,(size_t)nnz}, index.data());
+            for (int ivar=0; ivar<nvar; ++ivar)
+                ncvars[ivar].getVar({0,0}, {1,(size_t)nnz}, &vals[ivar*nnz]);
+        }
+        for (long i=0; i<nnz; ++i) {
+            for (int ivar=0; ivar<nvar; ++ivar)
+                val[ivar] = vals[ivar*nnz + i] / factor[ivar];
+            gcm_ovalsE.add(index[i], val, 1.0);
+        }
+    } else {
+        // Dense: (time, <indexingE dims>); see ncwrite_dense_VectorMultivec()
+        auto const &indexing(gcm_regridder->indexingE);
+        long const nE = indexing.extent();
+        std::vector<size_t> startp {0};
+        std::vector<size_t> countp {1};
+        for (int dimi : indexing.indices()) {
+            startp.push_back(0);
+            countp.push_back(indexing[dimi].extent);
+        }
+        std::vector<double> denseE(nE * nvar);    // denseE[ivar*nE + iE]
+        for (int ivar=0; ivar<nvar; ++ivar)
+            ncvars[ivar].getVar(startp, countp, &denseE[ivar*nE]);
+
+        for (long iE=0; iE<nE; ++iE) {
+            bool present = false;
+            for (int ivar=0; ivar<nvar; ++ivar) {
+                val[ivar] = denseE[ivar*nE + iE] / factor[ivar];
+                present = present || !std::isnan(val[ivar]);
+            }
+            if (present) gcm_ovalsE.add(iE, val, 1.0);
+        }
+    }
+    ncio.close();
+}
+
+void GCMCoupler::ncio_contracts(ibmisc::NcIO &ncio)
+{
+    gcm_outputsE.ncio(ncio, "gcm_outputsE");
+    for (size_t iAE=0; iAE < gcm_inputs.size(); ++iAE)
+        gcm_inputs[iAE].ncio(ncio, "gcm_inputs." + IndexAE_labels[iAE]);
+}
 // ------------------------------------------------------------
 // ------------------------------------------------------------
+/** Remaps a weight vector; entries mapped to -1 must be zero */
+static blitz::Array<double,1> remap_weights(
+    blitz::Array<double,1> const &w, std::vector<int> const &map, int n)
+{
+    blitz::Array<double,1> ret(n);
+    ret = 0;
+    for (int i=0; i<w.extent(0); ++i) if (map[i] >= 0) ret(map[i]) += w(i);
+    return ret;
+}
+
+/** Converts a weight vector from dense to sparse indexing */
+static blitz::Array<double,1> sparsify_weights(
+    blitz::Array<double,1> const &w, SparseSetT const *dim)
+{
+    blitz::Array<double,1> ret(dim->sparse_extent());
+    ret = 0;
+    for (int i=0; i<w.extent(0); ++i) ret(dim->to_sparse(i)) += w(i);
+    return ret;
+}
+
 // TODO: Add to ibmisc linear/eigen.hpp
 /** Converts a linear::Weighted_Eigen to sparse indexing
 @param dims set to E.dims to sparsify all dimensions; or set one to nullptr if no sparsify needed there. */
@@ -407,40 +727,26 @@ std::unique_ptr<linear::Weighted_Eigen> sparsify(
 //    std::array<SparseSetT *,2> const &dims,    // Determines what to sparsify; E.dims or nullptr in each slot
     std::array<int,2> extent = std::array<int,2>{-1,-1})            // Extent of resulting matrix (can be taken from E.dims if available)
 {
+    ICEBIN_PROFILE_SCOPE("sparsify");
     for (int i=0; i<2; ++i) if (extent[i] < 0) extent[i] = E.dims[i]->sparse_extent();
     std::unique_ptr<linear::Weighted_Eigen> S(
         new linear::Weighted_Eigen(E.dims, E.conservative));
 
     // Sparsify the matrix
-    {
-        TupleListT<2> SM_t;    // Matrix in sparse indexing, tuples
-        spcopy(
-            accum::sparsify(transforms, accum::in_index_type<int>(), E.dims,
-            accum::ref(SM_t)),
-            *E.M);
-
-        S->M.reset(new EigenSparseMatrixT(
-            extent[0], extent[1]));
-        S->M->setFromTriplets(SM_t.begin(), SM_t.end());
-    }
+    S->M.reset(new EigenSparseMatrixT(
+        sparsify_M(*E.M, transforms, E.dims, extent)));
 
     // Sparsify the weights
     if (transforms[0] == SparsifyTransform::ID) {
         S->wM.reference(E.wM);
     } else {
-        spcopy(
-            accum::to_sparse(std::array<SparseSetT*,1>{E.dims[0]},
-            accum::blitz_new(S->wM)),
-            E.wM);
+        S->wM.reference(sparsify_weights(E.wM, E.dims[0]));
     }
 
     if (transforms[1] == SparsifyTransform::ID) {
         S->Mw.reference(E.Mw);
     } else {
-        spcopy(
-            accum::to_sparse(std::array<SparseSetT*,1>{E.dims[1]},
-            accum::blitz_new(S->Mw)),
-            E.Mw);
+        S->Mw.reference(sparsify_weights(E.Mw, E.dims[1]));
     }
 
     // Clear dims, which may not be saved...
@@ -449,7 +755,216 @@ std::unique_ptr<linear::Weighted_Eigen> sparsify(
 
     return S;
 }
+
+/** Remaps the E (column) indices of an XuE matrix
+@param colmap New index of each column; or -1 if it is not used */
+static std::unique_ptr<linear::Weighted_Eigen> remap_XuE(
+    linear::Weighted_Eigen const &XuE,
+    std::vector<int> const &colmap, int nEc)
+{
+    std::vector<int> rowmap(XuE.M->rows());
+    for (size_t i=0; i<rowmap.size(); ++i) rowmap[i] = i;
+
+    std::unique_ptr<linear::Weighted_Eigen> S(
+        new linear::Weighted_Eigen({nullptr, nullptr}, XuE.conservative));
+    S->M.reset(new EigenSparseMatrixT(
+        remap_M(*XuE.M, rowmap, colmap, {(int)XuE.M->rows(), nEc})));
+    S->wM.reference(XuE.wM);
+    S->Mw.reference(remap_weights(XuE.Mw, colmap, nEc));
+    return S;
+}
+
+/** Converts an XuE matrix from dense (dimE) to compact (dimEc) E
+indexing, numbering its elevation points in dimEc first */
+static std::unique_ptr<linear::Weighted_Eigen> compact_XuE(
+    linear::Weighted_Eigen const &XuE, SparseSetT const &dimE, CompactE &dimEc)
+{
+    std::vector<int> colmap(XuE.M->cols());
+    for (size_t j=0; j<colmap.size(); ++j) colmap[j] = dimEc.add(dimE.to_sparse(j));
+    return remap_XuE(XuE, colmap, dimEc.size());
+}
+
+/** Converts an XuE matrix from sparse to compact E indexing (for
+XuE0s from an older restart file) */
+static std::unique_ptr<linear::Weighted_Eigen> compact_sparse_XuE(
+    linear::Weighted_Eigen const &XuE, CompactE &dimEc)
+{
+    EigenSparseMatrixT const &M(*XuE.M);
+    std::vector<int> colmap(M.cols(), -1);
+    for (int j=0; j<M.outerSize(); ++j) {
+        if (EigenSparseMatrixT::InnerIterator(M,j) || XuE.Mw(j) != 0)
+            colmap[j] = dimEc.add(j);
+    }
+    return remap_XuE(XuE, colmap, dimEc.size());
+}
+
+/** Adds (empty) columns to an XuE matrix, for elevation points
+numbered in dimEc since it was computed */
+static void widen_XuE(linear::Weighted_Eigen &XuE, int nEc)
+{
+    int const n0 = XuE.M->cols();
+    if (n0 == nEc) return;
+    XuE.M->conservativeResize(XuE.M->rows(), nEc);
+    blitz::Array<double,1> Mw(nEc);
+    Mw = 0;
+    for (int j=0; j<n0; ++j) Mw(j) = XuE.Mw(j);
+    XuE.Mw.reference(Mw);
+}
+
+/** Translates the E dimensions of a matrix from compact to sparse
+E indexing, sorted by (row, col).
+@param dimsE Which dimensions are E */
+static void sparsify_E(
+    spsparse::TupleList<int,double,2> &M,
+    std::array<bool,2> const &dimsE,
+    CompactE const &dimEc)
+{
+    std::vector<std::pair<std::array<int,2>, double>> elements;
+    elements.reserve(M.tuples.size());
+    for (auto ii(M.begin()); ii != M.end(); ++ii) {
+        std::array<int,2> ix {ii->index(0), ii->index(1)};
+        for (int k=0; k<2; ++k) if (dimsE[k]) ix[k] = dimEc.to_sparse(ix[k]);
+        elements.push_back(std::make_pair(ix, ii->value()));
+    }
+    std::sort(elements.begin(), elements.end(),
+        [](std::pair<std::array<int,2>, double> const &a,
+            std::pair<std::array<int,2>, double> const &b)
+        { return a.first < b.first; });
+
+    auto shape(M.shape());    // (-1,-1) if E1vE0 = I
+    M = spsparse::TupleList<int,double,2>();
+    if (shape[0] != -1) {
+        for (int k=0; k<2; ++k) if (dimsE[k]) shape[k] = dimEc.sparse_extent();
+        M.set_shape({(int)shape[0], (int)shape[1]});
+    }
+    M.tuples.reserve(elements.size());
+    for (auto const &e : elements) M.add({e.first[0], e.first[1]}, e.second);
+}
 // -------------------------------------------------
+void GCMCoupler::couple_concurrent(
+VectorMultivec const &gcm_ovalsE,
+bool run_ice,
+GCMInput &out,
+std::vector<IceCoupler::CoupleOut> &iouts)
+{
+    ICEBIN_PROFILE_SCOPE("GCMCoupler::couple_concurrent");
+    if (distributed_regrid || distributed_ice) (*icebin_error)(-1,
+        "concurrent_sheets cannot be combined with distributed_regrid or distributed_ice");
+
+    // The ice models share the MPI ranks: run them one at a time
+    for (auto &ice_coupler : ice_couplers)
+        ice_coupler->couple_ice(timespan, gcm_ovalsE, run_ice);
+
+    // Each sheet accumulates into its own output, merged below
+    std::vector<std::vector<VectorMultivec>> sheet_ivalss(ice_couplers.size());
+    for (auto &ivalss : sheet_ivalss) {
+        for (auto &vv : out.gcm_ivalss_s) ivalss.push_back(VectorMultivec(vv.nvar));
+    }
+
+    std::vector<std::exception_ptr> errs(ice_couplers.size());
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(max_threads())
+#endif
+    for (int sheetix=0; sheetix < (int)ice_couplers.size(); ++sheetix) {
+        try {
+            iouts[sheetix] = ice_couplers[sheetix]->couple_regrid(
+                timespan, sheet_ivalss[sheetix]);
+        } catch(...) {
+            errs[sheetix] = std::current_exception();
+        }
+    }
+    for (auto &err : errs) if (err) std::rethrow_exception(err);
+
+    // Merge in sheet order, same as the serial loop
+    for (auto &ivalss : sheet_ivalss) {
+        for (size_t iAE=0; iAE < ivalss.size(); ++iAE) {
+            VectorMultivec const &vv(ivalss[iAE]);
+            for (size_t i=0; i<vv.size(); ++i)
+                out.gcm_ivalss_s[iAE].add(vv.index[i], &vv.vals[i*vv.nvar], vv.weights[i]);
+        }
+    }
+}
+
+typedef Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> RowMajorMap;
+
+/** Logs one of the E1vE0c matrices, for GCMCoupler::matrix_stats */
+static void print_matrix_stats(std::string const &name,
+    TupleListT<2> const &M, double build_s)
+{
+    MatrixStats stats;
+    stats.name = name;
+    stats.set_shape(M);
+    stats.nbytes = nbytes(M);
+    stats.build_s = build_s;
+    printf("GCMCoupler::couple(): %s\n", stats.str().c_str());
+}
+
+void GCMCoupler::couple_combined(
+std::vector<IceCoupler::CoupleOut> &iouts,
+GCMInput &out)
+{
+    ICEBIN_PROFILE_SCOPE("GCMCoupler::couple_combined");
+
+    for (size_t iAE=0; iAE < out.gcm_ivalss_s.size(); ++iAE) {
+        VectorMultivec &vv(out.gcm_ivalss_s[iAE]);
+
+        // Rows of the combined matrix: cells used by any sheet
+        SparseSetT dimX;
+        dimX.set_sparse_extent(
+            iAE == (int)IndexAE::E ? gcm_regridder->nE() : gcm_regridder->nA());
+        long nI_all = 0;
+        size_t nnz = 0;
+        for (auto &iout : iouts) {
+            if (iAE >= iout.blocks.size() || !iout.blocks[iAE].M) continue;
+            IceCoupler::RegridBlock const &block(iout.blocks[iAE]);
+            if (block.Y.cols() != vv.nvar) (*icebin_error)(-1,
+                "GCMCoupler::couple_combined(): %ld variables for gcm_ivalss_s[%d], expected %d",
+                (long)block.Y.cols(), (int)iAE, vv.nvar);
+            for (long iX_s : block.rows_s) dimX.add_dense(iX_s);
+            nI_all += block.M->cols();
+            nnz += block.M->nonZeros();
+        }
+        long const nX = dimX.dense_extent();
+        if (nX == 0) continue;
+
+        // Block matrix [M_1 M_2 ...], and ice outputs [Y_1; Y_2; ...]
+        std::vector<double> wX(nX, 0.);
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(nnz);
+        EigenDenseMatrixT Y_all(nI_all, vv.nvar);
+        long base = 0;
+        for (auto &iout : iouts) {
+            if (iAE >= iout.blocks.size() || !iout.blocks[iAE].M) continue;
+            IceCoupler::RegridBlock &block(iout.blocks[iAE]);
+            EigenSparseMatrixT const &M(*block.M);
+
+            std::vector<int> rows(block.rows_s.size());    // This block's rows in dimX
+            for (size_t jj=0; jj<rows.size(); ++jj) {
+                rows[jj] = dimX.to_dense(block.rows_s[jj]);
+                wX[rows[jj]] += block.wM[jj];
+            }
+            for (int k=0; k<M.outerSize(); ++k) {
+                for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) {
+                    triplets.push_back(Eigen::Triplet<double>(
+                        rows[ii.row()], base + k, ii.value()));
+                }
+            }
+            Y_all.middleRows(base, M.cols()) = block.Y;
+            base += M.cols();
+            block = IceCoupler::RegridBlock();    // Done with it
+        }
+        EigenSparseMatrixT M_all(nX, nI_all);
+        M_all.setFromTriplets(triplets.begin(), triplets.end());
+        triplets = std::vector<Eigen::Triplet<double>>();
+
+        // One product for all sheets, straight into the VectorMultivec
+        std::vector<long> rows_s(nX);
+        for (long jX=0; jX < nX; ++jX) rows_s[jX] = dimX.to_sparse(jX);
+        RowMajorMap gcm_ivalsX(vv.append_zero(nX, rows_s.data(), wX.data()), nX, vv.nvar);
+        gcm_ivalsX = M_all * Y_all;
+    }
+}
+
 GCMInput GCMCoupler::couple(
 double time_s,        // Simulation time [s]
 VectorMultivec const &gcm_ovalsE,
@@ -457,10 +972,16 @@ bool run_ice)    // if false, only initialize
 {
     timespan = std::array<double,2>{timespan[1], time_s};
 
-printf("BEGIN GCMCoupler::couple(time_s=%g, run_ice=%d)\n", time_s, run_ice);
+    ICEBIN_PROFILE_SCOPE("GCMCoupler::couple");
+
+    // ---------- Initialize output: A,E,Atopo,Etopo
+    std::vector<int> nvars;
+    for (auto &gcmi : gcm_inputs) nvars.push_back(gcmi.size());
+    GCMInput out(nvars);
+
     // ------------------------ Most MPI Nodes
+    // (out is empty, except for this rank's A,E rows if distributed_regrid)
     if (!gcm_params.am_i_root()) {
-        GCMInput out({0,0,0,0});
         for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
             auto &ice_coupler(ice_couplers[sheetix]);
             ice_coupler->couple(timespan, gcm_ovalsE, out.gcm_ivalss_s, run_ice);
@@ -469,49 +990,119 @@ printf("BEGIN GCMCoupler::couple(time_s=%g, run_ice=%d)\n", time_s, run_ice);
     }
 
     // ----------------------- Root MPI Node
+    ICEBIN_PROFILE_HELD("VectorMultivec", nbytes(gcm_ovalsE));
+    ICEBIN_PROFILE_HELD("AbbrGrid", nbytes(*gcm_regridder->agridA));
+    for (auto &XuE0 : XuE0s)
+        if (XuE0) ICEBIN_PROFILE_HELD("CompactSparseMatrix", nbytes(*XuE0));
 
     // -------- Figure out our calendar day to format filenames
     if (gcm_params.icebin_logging) {
         std::string fname = "gcm-out-" + this->sdate(time_s) + ".nc";
-        NcIO ncio(fname, 'w');
-        ncio_gcm_output(ncio, gcm_ovalsE, timespan,
-            time_unit, "");
-        ncio();
+        auto gcm_ovalsE_log(std::make_shared<VectorMultivec>(gcm_ovalsE));
+        auto timespan_log(timespan);
+        log_write([this, fname, gcm_ovalsE_log, timespan_log]() mutable {
+            NcIO ncio(fname, 'w');
+            ncio_gcm_output(ncio, *gcm_ovalsE_log, timespan_log,
+                time_unit, "");
+            ncio();
+        });
     }
 
-    // ---------- Initialize output: A,E,Atopo,Etopo
-    std::vector<int> nvars;
-    for (auto &gcmi : gcm_inputs) nvars.push_back(gcmi.size());
-    GCMInput out(nvars);
-
     // ---------- Run per-ice-sheet couplers
     {
-        std::vector<SparseSetT const *> dimE1s;
-        std::vector<std::unique_ptr<linear::Weighted_Eigen>> XuE1s;
+        std::vector<IceCoupler::CoupleOut> iouts(ice_couplers.size());
+        if (concurrent_sheets && ice_couplers.size() > 1) {
+            couple_concurrent(gcm_ovalsE, run_ice, out, iouts);
+        } else {
+            for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
+                iouts[sheetix] = ice_couplers[sheetix]->couple(
+                    timespan, gcm_ovalsE, out.gcm_ivalss_s, run_ice);
+            }
+        }
+        if (combined_regrid) couple_combined(iouts, out);
+
+        // Sheets that reused last step's regrid (IceCoupler::reuse_regrid)
+        // have XuE1 = XuE0: nothing to sparsify, and no E1vE0 to compute
+        bool all_reused = true;
         for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
-            auto &ice_coupler(ice_couplers[sheetix]);    // IceCoupler
-            IceRegridder const *ice_regridder = ice_coupler->ice_regridder;
-
-printf("AA1\n");
-            IceCoupler::CoupleOut iout(ice_coupler->couple(
-                timespan, gcm_ovalsE, out.gcm_ivalss_s, run_ice));
-printf("AA2\n");
-            dimE1s.push_back(iout.dimE);
-            XuE1s.push_back(sparsify(*iout.XuE,
-                std::array<SparsifyTransform,2>{
-                    SparsifyTransform::ID,
-                    SparsifyTransform::TO_SPARSE},
-                std::array<int,2>{ice_regridder->nX(), -1}));
+            if (!iouts[sheetix].reused) all_reused = false;
+            else if (sheetix >= XuE0s.size() || !XuE0s[sheetix]) (*icebin_error)(-1,
+                "GCMCoupler::couple(): %s reused its regrid, but has no XuE0",
+                ice_couplers[sheetix]->name().c_str());
+        }
+
+        // XuE0s from an older restart file are still in sparse E
+        if (dimEc.sparse_extent() == 0) dimEc.reset(gcm_regridder->nE(), _ncio_dimEc);
+        if (XuE0s_sparse) {
+            for (auto &XuE0 : XuE0s) if (XuE0) XuE0.reset(new CompactWeighted(
+                std::move(*compact_sparse_XuE(*XuE0->to_weighted(), dimEc)),
+                matrix_precision));
+            XuE0s_sparse = false;
+        }
 
+        // Number E points used by any sheet in dimEc, and compute
+        // XuE1s (and E1vE0) over them, rather than all of nE.
+        std::vector<std::unique_ptr<linear::Weighted_Eigen>> XuE1s;
+        for (size_t sheetix=0; sheetix < ice_couplers.size(); ++sheetix) {
+            IceCoupler::CoupleOut &iout(iouts[sheetix]);
+
+            if (iout.reused) {
+                XuE1s.push_back(all_reused || !run_ice ?
+                    std::unique_ptr<linear::Weighted_Eigen>() : XuE0s[sheetix]->to_weighted());
+                continue;
+            }
+            XuE1s.push_back(compact_XuE(*iout.XuE, *iout.dimE, dimEc));
+        }
+        int const nEc = dimEc.size();
+
+        // --------- Compute E1vE0 (= I if no sheet's regrid changed)
+        if (run_ice && !all_reused) {
+            auto const t0(std::chrono::steady_clock::now());
+            // Widen XuE0s back to double for the computation
+            std::vector<std::unique_ptr<linear::Weighted_Eigen>> XuE0s_d;
+            for (auto &XuE0 : XuE0s) XuE0s_d.push_back(
+                XuE0 ? XuE0->to_weighted() : std::unique_ptr<linear::Weighted_Eigen>());
+
+            // Points numbered this step are new columns of older matrices
+            for (auto &XuE : XuE0s_d) if (XuE) widen_XuE(*XuE, nEc);
+            for (auto &XuE : XuE1s) if (XuE) widen_XuE(*XuE, nEc);
+
+            if (factor_E1vE0c) {
+                e1ve0::compute_E1vE0c_factors(
+                    XuE1s, XuE0s_d, nEc,
+                    out.E1vXc, out.XvE0c);
+                sparsify_E(out.E1vXc, {true, false}, dimEc);
+                sparsify_E(out.XvE0c, {false, true}, dimEc);
+            } else {
+                out.E1vE0c = e1ve0::compute_E1vE0c(
+                    XuE1s, XuE0s_d, nEc, areaX);
+                sparsify_E(out.E1vE0c, {true, true}, dimEc);
+            }
+
+            if (matrix_stats) {
+                double const build_s = seconds_since(t0);
+                if (factor_E1vE0c) {
+                    print_matrix_stats("E1vXc", out.E1vXc, build_s);
+                    print_matrix_stats("XvE0c", out.XvE0c, build_s);
+                } else {
+                    print_matrix_stats("E1vE0c", out.E1vE0c, build_s);
+                }
+            }
         }
 
-        // --------- Compute E1vE0
-        if (run_ice) {
-            out.E1vE0c = e1ve0::compute_E1vE0c(
-                XuE1s, XuE0s,
-                gcm_regridder->nE(), areaX);
+        for (auto &vecs : out.gcm_ivalss_s) ICEBIN_PROFILE_HELD("VectorMultivec", nbytes(vecs));
+        for (auto &XuE1 : XuE1s) if (XuE1) ICEBIN_PROFILE_HELD("Weighted_Eigen", nbytes(*XuE1));
+        ICEBIN_PROFILE_HELD("TupleList", nbytes(out.E1vE0c)
+            + nbytes(out.E1vXc) + nbytes(out.XvE0c));
+
+        // Save state between timesteps (reused sheets keep their XuE0)
+        std::vector<std::unique_ptr<CompactWeighted>> XuE1s_c;
+        for (size_t sheetix=0; sheetix < XuE1s.size(); ++sheetix) {
+            if (iouts[sheetix].reused) XuE1s_c.push_back(std::move(XuE0s[sheetix]));
+            else XuE1s_c.push_back(std::unique_ptr<CompactWeighted>(
+                new CompactWeighted(std::move(*XuE1s[sheetix]), matrix_precision)));
         }
-        XuE0s = std::move(XuE1s);    // save state between timesteps
+        XuE0s = std::move(XuE1s_c);
     }
 
     return out;
@@ -32,6 +32,9 @@
 #include <icebin/VarSet.hpp>
 #include <icebin/multivec.hpp>
 #include <icebin/e1ve0.hpp>
+#include <icebin/compact_e.hpp>
+#include <icebin/async_writer.hpp>
+#include <icebin/file_stage.hpp>
 
 namespace icebin {
 
@@ -49,6 +52,14 @@ static std::array<std::string, (unsigned)IndexAE::COUNT> const IndexAE_labels {"
 static std::vector<char> indexae_grid {'A','E','A','E'};
 #endif
 
+/** How thoroughly IceCoupler::couple() looks for NaNs in the regrid
+matrices and ice model output */
+BOOST_ENUM_VALUES( NanCheckLevel, int,
+    (OFF)       (0)
+    (SAMPLED)   (1)     // A strided sample (and all of the variable transform)
+    (FULL)      (2)     // Everything used, checked during the regrid itself
+);
+
 template<int RANK>
     using TupleListLT = spsparse::TupleList<long,double,RANK>;
 
@@ -66,6 +77,11 @@ struct GCMInput {
     // NOTE: Actual regrid matrix = I + E1vE0c
     spsparse::TupleList<int,double,2> E1vE0c;
 
+    /** If GCMCoupler::factor_E1vE0c, E1vE0c is left empty by
+    GCMCoupler::couple() and sent in factored form instead:
+    E1vE0c = E1vXc * XvE0c (see e1ve0::compute_E1vE0c_factors()) */
+    spsparse::TupleList<int,double,2> E1vXc, XvE0c;
+
     /** @param nvar Array specifying number of variables for each segment (A,E,ATOPO,ETOPO). */
     GCMInput(std::vector<int> const &nvar);
     /** @return Number of variables for each segment. */
@@ -74,6 +90,8 @@ struct GCMInput {
     void clear() {
         gcm_ivalss_s.clear();
         E1vE0c.clear();
+        E1vXc.clear();
+        XvE0c.clear();
     }
 
     template<class ArchiveT>
@@ -81,6 +99,8 @@ struct GCMInput {
     {
         ar & gcm_ivalss_s;
         ar & E1vE0c;
+        ar & E1vXc;
+        ar & XvE0c;
     }
 };
 // =============================================================================
@@ -126,6 +146,10 @@ struct GCMParams {
 
     int const icebin_base_hc = 0;    // First GCM elevation class that is an IceBin class (0-based indexing)
 
+    /** If set, the IceBin config and grid files are read once (by
+    the root) and opened from node-local copies on all ranks. */
+    std::shared_ptr<FileStager> stager;
+
     GCMParams(MPI_Comm _gcm_comm, int _gcm_root);
 };
 // =============================================================================
@@ -149,6 +173,10 @@ public:
     /** Parameters read from IceBin config file */
     std::string output_dir;
 
+    /** Grid file the GCMRegridder was read from (as named in the
+    config file, even if a staged copy was opened) */
+    std::string grid_fname;
+
     /** Set to false and IceBin will pass a zero SMB and appropriately
     zero B.C. to the ice sheet.  This is for testing. */
     bool use_smb;
@@ -208,13 +236,116 @@ public:
     Scalars could be (eg) a timestep dt that is not known until runtime. */
     VarSet scalars;
 
-    /** XuE matrices from last timestep, used to compute E1vE0 */
-    std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> XuE0s;
+    /** How to store regrid matrices kept between timesteps (XuE0s,
+    IceCoupler::IvE0).  Set with the optional config attribute
+    <gcm>.info:matrix_precision = "DOUBLE" | "SINGLE". */
+    MatrixPrecision matrix_precision = MatrixPrecision::DOUBLE;
+
+    /** Set with the optional config attribute
+    <gcm>.info:nan_check = "OFF" | "SAMPLED" | "FULL" */
+    NanCheckLevel nan_check = NanCheckLevel::FULL;
+
+    /** If set, each MPI rank applies its own rows of AvI and EvI
+    (see domain_of()) to the ice model output: root sends the ice
+    output and each rank's matrix rows, instead of computing (and
+    later scattering) all of gcm_ivalss_s[A,E] itself.  Set with the
+    optional config attribute <gcm>.info:distributed_regrid = 0|1. */
+    bool distributed_regrid = false;
+
+    /** If set, ice models that support it (see IceCoupler::local_iI)
+    keep their output distributed in their own decomposition: each
+    rank applies the columns of AvI and EvI for the ice grid cells it
+    owns, and only the GCM-grid-sized partial sums are reduced onto
+    root.  Root still gets the contracts::ROOT output fields (eg the
+    elevation masks, for the regridding matrices), and all of them if
+    icebin_logging.  Cannot be combined with distributed_regrid.
+    Set with the optional config attribute <gcm>.info:distributed_ice = 0|1. */
+    bool distributed_ice = false;
+
+    /** If set, the regridding half of IceCoupler::couple() (matrix
+    generation and application) runs for all ice sheets concurrently,
+    one OpenMP thread per sheet; the ice models themselves still run
+    one after another.  Cannot be combined with distributed_regrid
+    or distributed_ice.
+    Set with the optional config attribute <gcm>.info:concurrent_sheets = 0|1. */
+    bool concurrent_sheets = false;
+
+    /** If set, the GCM inputs of all ice sheets are computed with one
+    block matrix [AvI_1 AvI_2 ...] (and likewise for E), applied in a
+    single product to the sheets' ice outputs, stacked.  A and E cells
+    shared by several sheets are summed inside the product, so
+    gcm_ivalss_s gets one element per cell, rather than one per sheet.
+    Cannot be combined with distributed_regrid or distributed_ice.
+    Set with the optional config attribute <gcm>.info:combined_regrid = 0|1. */
+    bool combined_regrid = false;
+
+    /** If set, couple() returns E1vE0c as two factors over the
+    exchange grid cells that changed (GCMInput::E1vXc, XvE0c) rather
+    than multiplied out; GCMs multiply them out after they are split
+    among MPI ranks.  Set with the optional config attribute
+    <gcm>.info:factor_E1vE0c = 0|1. */
+    bool factor_E1vE0c = false;
+
+    /** If set, gcm-in and gcm-out log files store only the grid
+    cells that are present (index + values, deflated if NetCDF-4),
+    rather than dense NaN-filled fields; see pylib/icebin/iblog.py.
+    Set with the optional config attribute <gcm>.info:sparse_logging = 0|1. */
+    bool sparse_logging = false;
+
+    /** If set, each coupling step prints one line per matrix built
+    (AvI, EvI, IvE, XvE, smoothing, E1vE0c...): its dimensions, nnz,
+    storage, row-length histogram, build time and cache hit or miss;
+    see MatrixStats.  Set with the optional config attribute
+    <gcm>.info:matrix_stats = 0|1. */
+    bool matrix_stats = false;
+
+    /** If >0, log files (gcm-in, gcm-out, icemodel-in/out) are
+    written on a background thread, with at most this many writes
+    waiting (beyond that, coupling waits for the writer).  Set with
+    the optional config attribute <gcm>.info:async_logging = <n>.
+    netcdf_mutex only serializes IceBin's own NetCDF calls; so the
+    queue is drained before each ice model run_timestep() and before
+    restart I/O, where the ice model may use NetCDF.  Writes may
+    still be in flight when couple() returns to the GCM: async_logging
+    is unsafe if the GCM (or an ice model, outside of those calls)
+    uses NetCDF between coupling steps, unless libnetcdf is
+    thread-safe. */
+    int async_logging = 0;
+    std::unique_ptr<AsyncWriter> log_writer;    // Set in model_start()
+
+    /** Runs a log write: on log_writer if async_logging, otherwise
+    right away. */
+    void log_write(std::function<void()> &&write);
+
+    /** MPI rank (in gcm_comm) that owns a cell of the A or E grid
+    (sparse indexing); used on root for distributed_regrid. */
+    virtual int domain_of(long iAE_s) const
+        { return gcm_params.gcm_root; }
+
+    /** If set before ncread(), makes the ice couplers in place of the
+    types named in the config file (eg a stub ice model, to replay
+    coupling without running one; see modele/icebin_replay.cpp). */
+    std::function<std::unique_ptr<IceCoupler>(
+        std::string const &sheet_name, IceCoupler::Params const &)> make_ice_coupler;
+
+    /** XuE matrices from last timestep, used to compute E1vE0.  Their
+    columns are in dimEc (compact) indexing. */
+    std::vector<std::unique_ptr<CompactWeighted>> XuE0s;
+
+    /** The elevation points used so far by any ice sheet.  XuE1s,
+    XuE0s and E1vE0 are computed over these, rather than the full
+    GCMRegridder::nE(); GCMInput is translated back to sparse E
+    before couple() returns.  Kept in the restart file. */
+    CompactE dimEc;
+    /** XuE0s were read from a restart file without dimEc, and are
+    still in sparse E indexing: compacted at the next couple() */
+    bool XuE0s_sparse = false;
+    std::vector<long> _ncio_dimEc;    // What ncio_rsf() writes, until it is written
 
     // Fields we read from the config file...
 
     GCMCoupler(Type _type, GCMParams &&_params);
-    virtual ~GCMCoupler() {}
+    virtual ~GCMCoupler();
 
     /** Create parmaeters for instantion of IceCoupler */
     virtual IceCoupler::Params make_ice_coupler_params(std::string const &sheet_name) const
@@ -226,6 +357,12 @@ public:
     /** Produces a date string in format YYMMDD */
     std::string sdate(double time_s) const;
 
+    /** Prints profiler statistics (profile.hpp) for this coupling
+    step, and resets them: on root only, unless profile::verbose.
+    Every rank also appends them to <output_dir>/profile-<rank>.json
+    if icebin_logging. */
+    void report_profile(double time_s) const;
+
     bool am_i_root() const { return gcm_params.am_i_root(); }
 
     /** Run the coupling procedure for all ice sheets.
@@ -236,6 +373,22 @@ public:
         bool run_ice);    // if false, only initialize
 
 protected:
+    /** Part of couple(), for concurrent_sheets: runs the ice models
+    in turn, then IceCoupler::couple_regrid() for all sheets at once.
+    @param iouts One per ice sheet (output) */
+    void couple_concurrent(
+        VectorMultivec const &gcm_ovalsE,
+        bool run_ice,
+        GCMInput &out,
+        std::vector<IceCoupler::CoupleOut> &iouts);
+
+    /** Part of couple(), for combined_regrid: applies all sheets'
+    IceCoupler::CoupleOut::blocks at once, into out.gcm_ivalss_s.
+    Frees the blocks. */
+    void couple_combined(
+        std::vector<IceCoupler::CoupleOut> &iouts,
+        GCMInput &out);
+
     virtual void _ncread(
         ibmisc::NcIO &ncio_config,
         std::string const &vname);
@@ -245,10 +398,15 @@ public:
         std::string const &config_fname,
         std::string const &vname)
     {
-        ibmisc::NcIO ncio(config_fname, netCDF::NcFile::read);
+        ibmisc::NcIO ncio(stage_input(config_fname), netCDF::NcFile::read);
         _ncread(ncio, vname);
     }
 
+    /** Collective if gcm_params.stager is set.
+    @return Name of the file to open in place of fname */
+    std::string const &stage_input(std::string const &fname)
+        { return gcm_params.stager ? gcm_params.stager->stage(fname) : fname; }
+
     /** Locates an ice model input file, according to resolution rules
         of the GCM. */
     virtual std::string locate_input_file(
@@ -264,6 +422,11 @@ public:
     /** Read/write state for GCM restart (rsf) file */
     virtual void ncio_rsf(ibmisc::NcIO &ncio);
 
+    /** Loads the matrices ncio_rsf() read lazily, so the restart
+    file they came from may be overwritten.  Call before opening a
+    restart file for writing. */
+    void load_rsf() const;
+
     /** Top-level ncio() to log output from coupler. (coupler->GCM) */
     void ncio_gcm_input(ibmisc::NcIO &ncio,
         GCMInput &out,        // All MPI ranks included here
@@ -278,6 +441,22 @@ public:
         ibmisc::TimeUnit const &time_unit,
         std::string const &vname_base);
 
+    /** Reads back a log written by ncio_gcm_output() (dense or
+    sparse_logging), for replaying a run.  Dense logs do not record
+    weights: each grid cell that is not NaN in every variable is read
+    with weight 1, which densifies the same.
+    @param gcm_ovalsE (OUT) Has gcm_outputsE.size() variables
+    @param timespan (OUT) As it was when the log was written */
+    void read_gcm_output(std::string const &fname,
+        VectorMultivec &gcm_ovalsE,
+        std::array<double,2> &timespan,
+        std::string const &vname_base = "");
+
+    /** Reads/writes the metadata of gcm_outputsE and gcm_inputs (the
+    variables registered by the GCM).  Written to gcm-contract.nc
+    by model_start() if icebin_logging, so logs can be replayed. */
+    void ncio_contracts(ibmisc::NcIO &ncio);
+
 };
 
 }
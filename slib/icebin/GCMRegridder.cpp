@@ -17,9 +17,11 @@
  */
 
 #include <cstdio>
+#include <algorithm>
 #include <spsparse/netcdf.hpp>
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/Grid.hpp>
+#include <icebin/netcdf_mutex.hpp>
 
 using namespace std;
 using namespace netCDF;
@@ -83,6 +85,7 @@ void GCMRegridder_Standard::init(
         "indexingHC has rank %d, it must have rank=2", indexingHC.rank());
 
     indexingE = derive_indexingE(agridA->indexing, indexingHC);
+    set_fast_indexing();
 }
 // -------------------------------------------------------------
 
@@ -101,6 +104,17 @@ void GCMRegridder_Standard::clear()
     ice_regridders().clear();
 }
 // -------------------------------------------------------------
+/** Reads an ice sheet whose reading was deferred by
+GCMRegridder_Standard::ncio(); called by IceRegridder::load(). */
+static void nc_load_sheet(IceRegridder &regridder,
+    std::string const &fname, std::string const &vname)
+{
+    std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+    NcIO ncio(fname, 'r');
+    regridder.ncio(ncio, vname);
+    ncio.close();
+}
+
 void GCMRegridder_Standard::ncio(NcIO &ncio, std::string const &vname)
 {
     auto info_v = get_or_add_var(ncio, vname + ".info", "int", {});
@@ -135,17 +149,23 @@ void GCMRegridder_Standard::ncio(NcIO &ncio, std::string const &vname)
 
     // Read/write the regridder for each ice sheet
     if (ncio.rw == 'r') {   // Instantiate
+        // Only the type of each sheet is read here; the rest is read
+        // when the sheet is first used (see ice_regridder()).
         for (auto sheet_name = sheet_names.begin(); sheet_name != sheet_names.end(); ++sheet_name) {
             std::string vn(vname + "." + *sheet_name);
-            add_sheet(*sheet_name, new_ice_regridder(ncio, vn));
+            std::unique_ptr<IceRegridder> regridder(new_ice_regridder(ncio, vn));
+            regridder->_loader = std::bind(&nc_load_sheet, _1, ncio.fname, vn);
+            add_sheet(*sheet_name, std::move(regridder));
+        }
+    } else {
+        for (auto ice_regridder=ice_regridders().begin(); ice_regridder != ice_regridders().end(); ++ice_regridder) {
+            (*ice_regridder)->load()->ncio(ncio, vname + "." + (*ice_regridder)->name());
         }
-    }
-    for (auto ice_regridder=ice_regridders().begin(); ice_regridder != ice_regridders().end(); ++ice_regridder) {
-        (*ice_regridder)->ncio(ncio, vname + "." + (*ice_regridder)->name());
     }
 
 
     indexingE = derive_indexingE(agridA->indexing, indexingHC);
+    set_fast_indexing();
 
 }
 // -------------------------------------------------------------
@@ -153,20 +173,52 @@ void GCMRegridder_Standard::ncio(NcIO &ncio, std::string const &vname)
 
 void GCMRegridder_Standard::filter_cellsA(std::function<bool(long)> const &keepA)
 {
+    // Evaluate keepA once per gridA cell
+    std::vector<bool> keepA_v(agridA->dim.sparse_extent(), false);
+    for (int id=0; id<agridA->dim.dense_extent(); ++id) {
+        long const iA = agridA->dim.to_sparse(id);
+        keepA_v[iA] = keepA(iA);
+    }
+    filter_cellsA(keepA_v);
+}
 
+void GCMRegridder_Standard::filter_cellsA(std::vector<bool> const &keepA)
+{
     // Now remove cells from the exgrids and gridIs that
     // do not interact with the cells we've kept in grid1.
+    // Sheets not read yet read only the exchange cells they keep.
     for (auto ice_regridder=ice_regridders().begin(); ice_regridder != ice_regridders().end(); ++ice_regridder) {
-        (*ice_regridder)->filter_cellsA(keepA);
+        (*ice_regridder)->_load_keepA = &keepA;
+        (*ice_regridder)->load()->filter_cellsA(keepA);
+        (*ice_regridder)->_load_keepA = nullptr;
     }
 
-    agridA->filter_cells(keepA);
+    agridA->filter_cells([&keepA](long iA)
+        { return iA < (long)keepA.size() && keepA[iA]; });
 }
 
 void GCMRegridder_Standard::filter_cellsA(ibmisc::Domain const &domainA)
 {
-    filter_cellsA(std::bind(&ibmisc::in_domain,
-        &domainA, &agridA->indexing, _1));
+    ibmisc::Indexing const &indexingA(agridA->indexing);
+    if (indexingA.rank() != 2 || domainA.low.size() != 2) {
+        filter_cellsA(std::bind(&ibmisc::in_domain,
+            &domainA, &indexingA, _1));
+        return;
+    }
+
+    // Evaluate the domain as index ranges, instead of once per cell
+    // (domainA and tuples are zero-based, in alphabetical order)
+    std::vector<bool> keepA(indexingA.extent(), false);
+    long const i0 = std::max(0L, (long)domainA.low[0]);
+    long const i1 = std::min((long)indexingA[0].extent, (long)domainA.high[0]);
+    long const j0 = std::max(0L, (long)domainA.low[1]);
+    long const j1 = std::min((long)indexingA[1].extent, (long)domainA.high[1]);
+    for (long j=j0; j<j1; ++j) {
+    for (long i=i0; i<i1; ++i) {
+        keepA[indexingA.tuple_to_index(std::array<long,2>{i,j})] = true;
+    }}
+
+    filter_cellsA(keepA);
 }
 
 // ---------------------------------------------------------------------
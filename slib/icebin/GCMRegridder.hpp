@@ -29,6 +29,7 @@
 #include <ibmisc/linear/tuple.hpp>
 
 #include <icebin/IceRegridder.hpp>
+#include <icebin/fast_indexing.hpp>
 #include <icebin/RegridMatrices.hpp>
 #include <icebin/RegridMatrices_Dynamic.hpp>
 
@@ -239,6 +240,21 @@ public:
     // (im,jm,...,ihp) zero-based indices
     ibmisc::Indexing indexingE;
 
+    /** indexingHC and indexingE, with precomputed strides, for inner
+    loops.  fast_indexingE is only valid() if indexingE has rank 3 (as
+    for lon/lat GCM grids).  Set by set_fast_indexing(). */
+    FastIndexing<2> fast_indexingHC;
+    FastIndexing<3> fast_indexingE;
+
+    /** Sets fast_indexingHC and fast_indexingE; call whenever
+    indexingHC or indexingE change. */
+    void set_fast_indexing()
+    {
+        fast_indexingHC = FastIndexing<2>(indexingHC);
+        fast_indexingE = (indexingE.rank() == 3 ?
+            FastIndexing<3>(indexingE) : FastIndexing<3>());
+    }
+
     /** Selection function so aid when A/E stuff uses the same code,
         indexed by GridAE::A or ::E. */
     ibmisc::Indexing const &indexing(int iAE) const
@@ -262,6 +278,15 @@ public:
     ibmisc::IndexedVector<std::string, std::unique_ptr<IceRegridder>> const &ice_regridders() const
         { return *_ice_regridders; }
 
+    /** @return The IceRegridder for an ice sheet, fully read in.  Sheets
+    read by GCMRegridder_Standard::ncio() are only read from disk on
+    first use; so use this, rather than ice_regridders() directly, to
+    get at a sheet's grids. */
+    IceRegridder *ice_regridder(std::string const &sheet_name) const
+        { return ice_regridders().at(sheet_name)->load(); }
+    IceRegridder *ice_regridder(int sheet_index) const
+        { return ice_regridders()[sheet_index]->load(); }
+
     virtual ~GCMRegridder();
 
     /** @return Number of elevation points for grid cells in general */
@@ -273,7 +298,7 @@ public:
     virtual unsigned long nE() const { return GCMRegridder::nA() * nhc(-1); }
     unsigned long nAE(char gridAE) const
         { return gridAE == 'A' ? nA() : nE(); }
-    size_t nI(int sheet_index) const { return ice_regridders()[sheet_index]->nI(); }
+    size_t nI(int sheet_index) const { return ice_regridder(sheet_index)->nI(); }
 
     template<class AccumT>
     void wA(AccumT &&accum, std::string const &ice_sheet_name, bool native);
@@ -292,6 +317,23 @@ public:
         blitz::Array<double,1> const &elevmaskI,
         RegridParams const &params = RegridParams()) const = 0;
 
+    /** One set of regrid matrices per elevmaskI variant */
+    typedef std::vector<std::vector<std::unique_ptr<ibmisc::linear::Weighted>>> EnsembleMatrices;
+
+    /** Produces the same matrices for many variants of elevmaskI of
+    one ice sheet (eg for a sensitivity study).  Equivalent to calling
+    regrid_matrices(sheet_index, elevmaskIs[i], params)->matrix(specs[j])
+    for each i and j; but variants are done in parallel (with OpenMP),
+    sharing whatever does not depend on elevmaskI.
+    @param specs Matrices to produce for each variant (eg "AvI", "IvE")
+    @return ret[i][j] is matrix specs[j] for elevmaskIs[i]; each
+        matrix owns its dims (see RegridMatrices_Dynamic::matrix()). */
+    virtual EnsembleMatrices regrid_matrices_ensemble(
+        int sheet_index,
+        std::vector<blitz::Array<double,1>> const &elevmaskIs,
+        std::vector<std::string> const &specs,
+        RegridParams const &params = RegridParams()) const;
+
     /**
     @param rw_full If true, read the entire data structure.  If false (i.e. we
                    are using MPI and this is not the root), then avoid reading
@@ -304,9 +346,9 @@ public:
 template<class AccumT>
 void GCMRegridder::wA(AccumT &&accum, std::string const &ice_sheet_name, bool native)
 {
-    IceRegridder *ice = &*ice_regridders().at(ice_sheet_name);
+    IceRegridder *ice = ice_regridder(ice_sheet_name);
 
-    auto &areas(native ? agridA->native_area : ice->gridA_proj_area);
+    auto &areas(native ? agridA->native_area() : ice->gridA_proj_area);
     for (int id=0; id<agridA->dim.dense_extent(); ++id) {
         auto index = agridA->dim.to_sparse(id);
         accum.add({index}, areas(id));
@@ -378,11 +420,32 @@ public:
         blitz::Array<double,1> const &elevmaskI,
         RegridParams const &params) const;
 
+    /** Same, for an IceRegridder that is not one of our ice sheets, but
+    refers to our GCM grid (regridder->gcm == this); eg a coarsened
+    copy of one of them (see CoarseIceRegridder). */
+    std::unique_ptr<RegridMatrices_Dynamic> regrid_matrices(
+        IceRegridder const *regridder,
+        blitz::Array<double,1> const &elevmaskI,
+        RegridParams const &params = RegridParams()) const;
+
+    /** Variants whose elevmaskI masks out the same cells share their
+    Ur matrices for A (which depend only on that mask). */
+    EnsembleMatrices regrid_matrices_ensemble(
+        int sheet_index,
+        std::vector<blitz::Array<double,1>> const &elevmaskIs,
+        std::vector<std::string> const &specs,
+        RegridParams const &params = RegridParams()) const;
+
     /** Removes unnecessary cells from the A grid
     @param keepA(iA):
         Function returns true for cells we wish to keep. */
     void filter_cellsA(std::function<bool(long)> const &keepA);
 
+    /** Same, with the cells to keep as a bit-vector over (sparse)
+    gridA indices.  Ice sheets not yet read (see IceRegridder::load())
+    read only the exchange cells of those gridA cells. */
+    void filter_cellsA(std::vector<bool> const &keepA);
+
     /** Higher-level filter, filter out cells not in our MPI domain.
     @param domainA Description of our MPI domain.
     Indices are in C order with 0-based indexing. */
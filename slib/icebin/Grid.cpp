@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <array>
 #include <set>
 #include <algorithm>
 #include <icebin/Grid.hpp>
@@ -23,6 +24,10 @@
 //#include <boost/bind.hpp>
 //#include <giss/constant.hpp>
 #include <icebin/error.hpp>
+#include <icebin/parallel.hpp>
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
 
 #ifdef BUILD_MODELE
 using namespace icebin::modele;
@@ -138,30 +143,70 @@ void Grid::clear()
 }
 
 // ------------------------------------------------------------
-struct CmpVertexXY {
-    bool operator()(Vertex const *a, Vertex const *b)
+/** Flat copy of a vertex, so sorting does not chase pointers */
+struct VertexXY {
+    double x, y;
+    Vertex *vertex;
+
+    bool operator<(VertexXY const &b) const
     {
-        double diff = a->x - b->x;
+        double diff = x - b.x;
         if (diff < 0) return true;
         if (diff > 0) return false;
-        return (a->y - b->y) < 0;
+        diff = y - b.y;
+        if (diff < 0) return true;
+        if (diff > 0) return false;
+        // Coincident vertices: keep the order total, so the parallel
+        // sort below gives the same result for any number of threads
+        return vertex->index < b.vertex->index;
     }
 };
 
+/** Below this many vertices, sort_renumber_vertices() does not use threads */
+static size_t const PARALLEL_SORT_MIN = 100000;
+
 void sort_renumber_vertices(Grid &grid)
 {
-    // Construct array of Vertex pointers
-    std::vector<Vertex *> vertices;
+    // Construct flat array of vertices
+    std::vector<VertexXY> vertices;
+    vertices.reserve(grid.vertices.nrealized());
     for (auto vertex = grid.vertices.begin(); vertex != grid.vertices.end(); ++vertex)
-        vertices.push_back(&*vertex);
+        vertices.push_back(VertexXY{vertex->x, vertex->y, &*vertex});
+    long const n = vertices.size();
 
     // Sort it by x and y!
-    std::sort(vertices.begin(), vertices.end(), CmpVertexXY());
+#ifdef USE_OPENMP
+    int const nthread = max_threads();
+    if (nthread > 1 && (size_t)n >= PARALLEL_SORT_MIN) {
+        // Sort one block per thread; then merge pairs of blocks
+        std::vector<long> bounds(nthread+1);
+        for (int i=0; i<=nthread; ++i) bounds[i] = (n * i) / nthread;
+
+        #pragma omp parallel for num_threads(nthread)
+        for (int i=0; i<nthread; ++i)
+            std::sort(vertices.begin() + bounds[i], vertices.begin() + bounds[i+1]);
+
+        for (int width=1; width < nthread; width *= 2) {
+            int const nmerge = (nthread + 2*width - 1) / (2*width);
+            #pragma omp parallel for num_threads(nthread)
+            for (int k=0; k<nmerge; ++k) {
+                int const i0 = k*2*width;
+                int const i1 = std::min(i0 + width, nthread);
+                int const i2 = std::min(i0 + 2*width, nthread);
+                std::inplace_merge(vertices.begin() + bounds[i0],
+                    vertices.begin() + bounds[i1], vertices.begin() + bounds[i2]);
+            }
+        }
+    } else
+#endif
+    std::sort(vertices.begin(), vertices.end());
 
     // Renumber vertices
-    long i=0;
-    for (auto vertex = vertices.begin(); vertex != vertices.end(); ++vertex)
-        (*vertex)->index = i++;
+#ifdef USE_OPENMP
+    #pragma omp parallel for if((size_t)n >= PARALLEL_SORT_MIN) num_threads(max_threads())
+#endif
+    for (long i=0; i<n; ++i)
+        vertices[i].vertex->index = i;
 }
 
 // ------------------------------------------------------------
@@ -274,14 +319,149 @@ printf("BEGIN Grid::nc_write()\n");
 printf("END Grid::nc_write()\n");
 }
 
+/** Groups sorted positions into runs [begin, end) to read as
+hyperslabs.  Runs separated by fewer than gap positions are merged,
+to save on the number of NetCDF calls. */
+static std::vector<std::array<size_t,2>> position_runs(
+    std::vector<size_t> const &pos, size_t gap)
+{
+    std::vector<std::array<size_t,2>> runs;
+    for (size_t p : pos) {
+        if (runs.size() > 0 && p < runs.back()[1] + gap) runs.back()[1] = p+1;
+        else runs.push_back(std::array<size_t,2>{p, p+1});
+    }
+    return runs;
+}
+
+static size_t const RUN_GAP = 1024;
+
+/** Body of Grid::nc_read() when only some cells are kept.  Only the
+per-cell index and extents are read in full; the rest is read in
+hyperslabs covering just the cells we keep. */
+static void nc_read_kept(
+Grid &grid,
+netCDF::NcGroup *nc,
+std::string const &vname,
+std::function<bool (long)> const &keep_fn)
+{
+    auto cells_index(nc_read_blitz
+        <long, 1>(nc, vname + ".cells.index"));
+    auto vrefs_start(nc_read_blitz
+        <long, 1>(nc, vname + ".cells.vertex_refs_start"));
+
+    std::vector<size_t> keep_cells;    // Positions in the cells.* arrays
+    for (int i=0; i < cells_index.extent(0); ++i)
+        if (keep_fn(cells_index(i))) keep_cells.push_back(i);
+    auto const cell_runs(position_runs(keep_cells, RUN_GAP));
+
+    NcVar cells_ijk_var(nc->getVar(vname + ".cells.ijk"));
+    NcVar native_area_var(nc->getVar(vname + ".cells.native_area"));
+    NcVar vrefs_var(nc->getVar(vname + ".cells.vertex_refs"));
+
+    // ---------- Read the vertex references of the cells we keep
+    std::vector<std::vector<long>> run_vrefs(cell_runs.size());
+    std::vector<long> needed_vertices;
+    {size_t ik = 0;
+    for (size_t ir=0; ir < cell_runs.size(); ++ir) {
+        auto const &run(cell_runs[ir]);
+        size_t const j0 = vrefs_start(run[0]);
+        size_t const j1 = vrefs_start(run[1]);
+        run_vrefs[ir].resize(j1 - j0);
+        if (j1 > j0) vrefs_var.getVar({j0}, {j1-j0}, &run_vrefs[ir][0]);
+
+        for (; ik < keep_cells.size() && keep_cells[ik] < run[1]; ++ik) {
+            size_t const i = keep_cells[ik];
+            for (long j = vrefs_start(i); j < vrefs_start(i+1); ++j)
+                needed_vertices.push_back(run_vrefs[ir][j - j0]);
+        }
+    }}
+    std::sort(needed_vertices.begin(), needed_vertices.end());
+    needed_vertices.erase(
+        std::unique(needed_vertices.begin(), needed_vertices.end()),
+        needed_vertices.end());
+
+    // ---------- Read the Vertices we need
+    {auto vertices_index(nc_read_blitz
+        <long, 1>(nc, vname + ".vertices.index"));
+    NcVar vertices_xy_var(nc->getVar(vname + ".vertices.xy"));
+
+        std::vector<size_t> keep_vertices;
+        for (int i=0; i < vertices_index.extent(0); ++i) {
+            if (std::binary_search(needed_vertices.begin(), needed_vertices.end(),
+                vertices_index(i))) keep_vertices.push_back(i);
+        }
+
+        size_t ik = 0;
+        std::vector<double> xy;
+        for (auto const &run : position_runs(keep_vertices, RUN_GAP)) {
+            xy.resize((run[1] - run[0]) * 2);
+            vertices_xy_var.getVar({run[0], 0}, {run[1] - run[0], 2}, &xy[0]);
+            for (; ik < keep_vertices.size() && keep_vertices[ik] < run[1]; ++ik) {
+                size_t const i = keep_vertices[ik];
+                size_t const k = i - run[0];
+                grid.vertices.add(Vertex(xy[k*2], xy[k*2+1], vertices_index(i)));
+            }
+        }
+    }
+
+    // ---------- Read the Cells we keep
+    {size_t ik = 0;
+    std::vector<long> ijk;
+    std::vector<double> native_area;
+    for (size_t ir=0; ir < cell_runs.size(); ++ir) {
+        auto const &run(cell_runs[ir]);
+        size_t const n = run[1] - run[0];
+        if (!cells_ijk_var.isNull()) {
+            // Some grids (eg, ISSM) don't have this.  It is optional
+            ijk.resize(n*3);
+            cells_ijk_var.getVar({run[0], 0}, {n, 3}, &ijk[0]);
+        }
+        if (!native_area_var.isNull()) {
+            native_area.resize(n);
+            native_area_var.getVar({run[0]}, {n}, &native_area[0]);
+        }
+        long const j0 = vrefs_start(run[0]);
+
+        for (; ik < keep_cells.size() && keep_cells[ik] < run[1]; ++ik) {
+            size_t const i = keep_cells[ik];
+            size_t const k = i - run[0];
+
+            Cell cell;
+            cell.index = cells_index(i);
+            if (!cells_ijk_var.isNull()) {
+                cell.i = ijk[k*3+0];
+                cell.j = ijk[k*3+1];
+                cell.k = ijk[k*3+2];
+            } else {
+                cell.i = cell.j = cell.k = 0;
+            }
+            cell.native_area = (native_area_var.isNull() ? 0 : native_area[k]);
+
+            // Add the vertices
+            cell.reserve(vrefs_start(i+1) - vrefs_start(i));
+            for (long j = vrefs_start(i); j < vrefs_start(i+1); ++j)
+                cell.add_vertex(grid.vertices.at(run_vrefs[ir][j - j0]));
+
+            // Add the cell to the grid
+            grid.cells.add(std::move(cell));
+        }
+    }}
+}
+
 /** @param fname Name of file to load from (eg, an overlap matrix file)
 @param vname Eg: "gridA" or "gridI" */
 void Grid::nc_read(
 netCDF::NcGroup *nc,
-std::string const &vname)
+std::string const &vname,
+std::function<bool (long)> const &keep_fn)
 {
     clear();
 
+    if (keep_fn) {
+        nc_read_kept(*this, nc, vname, keep_fn);
+        return;
+    }
+
     // ---------- Read the Vertices
     {auto vertices_index(nc_read_blitz
         <long, 1>(nc, vname + ".vertices.index"));
@@ -355,7 +535,14 @@ std::string const &vname)
     }
 }
 
-void Grid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
+NcVar ncio_grid_info(NcIO &ncio, std::string const &vname,
+    std::unique_ptr<GridSpec> &spec,
+    std::string &name,
+    GridCoordinates &coordinates,
+    GridParameterization &parameterization,
+    ibmisc::Indexing &indexing,
+    std::string &sproj,
+    long &cells_nfull, long &vertices_nfull)
 {
     // ------ Do the spec first, then the boring long stuff later
     ncio_grid_spec(ncio, spec, vname);
@@ -401,21 +588,91 @@ void Grid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
             "for format of these strings.");
     }
 
-    get_or_put_att(info_v, ncio.rw, "cells.nfull", "int64", &cells._nfull, 1);
+    get_or_put_att(info_v, ncio.rw, "cells.nfull", "int64", &cells_nfull, 1);
     if (ncio.rw == 'w') info_v.putAtt("cells.nfull.comment",
         "The total theoretical number of grid cells (polygons) in this "
         "grid.  Depending on grid.info:parameterization, either cells or "
         "vertices will correspond to the dimensionality of the grid's "
         "vector space.");
 
-    get_or_put_att(info_v, ncio.rw, "vertices.nfull", "int64", &vertices._nfull, 1);
+    get_or_put_att(info_v, ncio.rw, "vertices.nfull", "int64", &vertices_nfull, 1);
     if (ncio.rw == 'w') info_v.putAtt("vertices.nfull.comment",
         "The total theoretical of vertices (of polygons) on this grid.");
 
+    return info_v;
+}
+
+void define_grid_vars(NcIO &ncio, std::string const &vname, NcVar &info_v,
+    long vertices_nrealized, long cells_nfull, long cells_nrealized, long nvref)
+{
+    NcDim vertices_nrealized_d = get_or_add_dim(ncio, vname + ".vertices.nrealized", vertices_nrealized);
+    info_v.putAtt((vname + ".vertices.nrealized.comment"),
+        "The number of 'realized' cells in this grid.  Only the "
+        "outlines of realized cells are computed and stored.  not "
+        "all cells need to be realized.  For example, a grid file "
+        "representing a GCM grid, in preparation for use with ice "
+        "models, would only need to realize GCM grid cells that are "
+        "close to the relevant ice sheets.  In this case, all grid "
+        "cells are realized.");
+
+    NcDim cells_nfull_d = get_or_add_dim(ncio,
+        vname + ".cells.nfull", cells_nfull);
+    NcDim cells_nrealized_d = get_or_add_dim(ncio,
+        vname + ".cells.nrealized", cells_nrealized);
+    NcDim cells_nrealized_plus_1_d = get_or_add_dim(ncio,
+        vname + ".cells.nrealized_plus1", cells_nrealized + 1);
+
+    NcDim nvrefs_d = get_or_add_dim(ncio, vname + ".cells.nvertex_refs", nvref);
+    NcDim two_d = get_or_add_dim(ncio, "two", 2);
+    NcDim three_d = get_or_add_dim(ncio, "three", 3);
+
+    // --------- Variables
+    get_or_add_var(ncio, vname + ".vertices.index", "int", {vertices_nrealized_d})
+        .putAtt("comment",
+            "For grids that index on cells (eg, L0): a dense, zero-based "
+            "1D index used to identify each realized cell.  This will be "
+            "used for vectors representing fields on the grid.");
+
+    get_or_add_var(ncio, vname + ".vertices.xy", "double", {vertices_nrealized_d, two_d});
+
+    get_or_add_var(ncio, vname + ".cells.index", "int", {cells_nrealized_d})
+        .putAtt("comment",
+            "For grids that index on vertices (eg, L1): a dense, zero-based "
+            "1D index used to identify each realized vertex.  This will be "
+            "used for vectors representing fields on the grid.");
+
+    get_or_add_var(ncio, vname + ".cells.ijk", "int", {cells_nrealized_d, three_d})
+        .putAtt("comment",
+            "OPTIONAL: Up to 3 dimensions can be used to assign a 'real-world' "
+            "index to each grid cell.  If grid.info:type = EXCHANGE, then i and "
+            "j correspond to grid.vertices.index of the two overlapping source cells.");
+
+    get_or_add_var(ncio, vname + ".cells.native_area", "double", {cells_nrealized_d})
+        .putAtt("comment",
+            "Area of each cell in its native (non-projected) coordinate system.  "
+            "We can compute the projected area on the fly.");
+
+
+    // nc.add_var((vname + ".cells.area").c_str(), "double", ncells_dim);
+
+    get_or_add_var(ncio, vname + ".cells.vertex_refs", "int", {nvrefs_d})
+        .putAtt("comment",
+            "A list of cell indices.  Used to form grid cell polygons.");
+
+    get_or_add_var(ncio, vname + ".cells.vertex_refs_start", "int", {cells_nrealized_plus_1_d})
+        .putAtt("comment",
+            "Index into vertex_refs of the start of each polygon.");
+}
+
+void Grid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
+{
+    auto info_v(ncio_grid_info(ncio, vname, spec, name,
+        coordinates, parameterization, indexing, sproj,
+        cells._nfull, vertices._nfull));
+
     // ------- Only read the rest of this on MPI root
     if (!rw_full) return;
 
-    // ------- Dimensions
     if (ncio.rw == 'w') {
         // ----------------- WRITE
 
@@ -423,64 +680,8 @@ void Grid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
         int nvref = 0;
         for (auto cell = cells.begin(); cell != cells.end(); ++cell) nvref += cell->size();
 
-
-        NcDim vertices_nrealized_d = get_or_add_dim(ncio, vname + ".vertices.nrealized", vertices.nrealized());
-        info_v.putAtt((vname + ".vertices.nrealized.comment"),
-            "The number of 'realized' cells in this grid.  Only the "
-            "outlines of realized cells are computed and stored.  not "
-            "all cells need to be realized.  For example, a grid file "
-            "representing a GCM grid, in preparation for use with ice "
-            "models, would only need to realize GCM grid cells that are "
-            "close to the relevant ice sheets.  In this case, all grid "
-            "cells are realized.");
-
-        NcDim cells_nfull_d = get_or_add_dim(ncio,
-            vname + ".cells.nfull", cells.nfull());
-        NcDim cells_nrealized_d = get_or_add_dim(ncio,
-            vname + ".cells.nrealized", cells.nrealized());
-        NcDim cells_nrealized_plus_1_d = get_or_add_dim(ncio,
-            vname + ".cells.nrealized_plus1", cells.nrealized() + 1);
-
-        NcDim nvrefs_d = get_or_add_dim(ncio, vname + ".cells.nvertex_refs", nvref);
-        NcDim two_d = get_or_add_dim(ncio, "two", 2);
-        NcDim three_d = get_or_add_dim(ncio, "three", 3);
-
-        // --------- Variables
-        get_or_add_var(ncio, vname + ".vertices.index", "int", {vertices_nrealized_d})
-            .putAtt("comment",
-                "For grids that index on cells (eg, L0): a dense, zero-based "
-                "1D index used to identify each realized cell.  This will be "
-                "used for vectors representing fields on the grid.");
-
-        get_or_add_var(ncio, vname + ".vertices.xy", "double", {vertices_nrealized_d, two_d});
-
-        get_or_add_var(ncio, vname + ".cells.index", "int", {cells_nrealized_d})
-            .putAtt("comment",
-                "For grids that index on vertices (eg, L1): a dense, zero-based "
-                "1D index used to identify each realized vertex.  This will be "
-                "used for vectors representing fields on the grid.");
-
-        get_or_add_var(ncio, vname + ".cells.ijk", "int", {cells_nrealized_d, three_d})
-            .putAtt("comment",
-                "OPTIONAL: Up to 3 dimensions can be used to assign a 'real-world' "
-                "index to each grid cell.  If grid.info:type = EXCHANGE, then i and "
-                "j correspond to grid.vertices.index of the two overlapping source cells.");
-
-        get_or_add_var(ncio, vname + ".cells.native_area", "double", {cells_nrealized_d})
-            .putAtt("comment",
-                "Area of each cell in its native (non-projected) coordinate system.  "
-                "We can compute the projected area on the fly.");
-
-
-        // nc.add_var((vname + ".cells.area").c_str(), "double", ncells_dim);
-
-        get_or_add_var(ncio, vname + ".cells.vertex_refs", "int", {nvrefs_d})
-            .putAtt("comment",
-                "A list of cell indices.  Used to form grid cell polygons.");
-
-        get_or_add_var(ncio, vname + ".cells.vertex_refs_start", "int", {cells_nrealized_plus_1_d})
-            .putAtt("comment",
-                "Index into vertex_refs of the start of each polygon.");
+        define_grid_vars(ncio, vname, info_v,
+            vertices.nrealized(), cells.nfull(), cells.nrealized(), nvref);
 
         ncio += std::bind(&Grid::nc_write, this, ncio.nc, vname);
     } else {
@@ -490,6 +691,27 @@ void Grid::ncio(NcIO &ncio, std::string const &vname, bool rw_full)
 
 }
 
+void Grid::nc_read_filtered(NcIO &ncio, std::string const &vname,
+    std::function<bool (long)> const &keep_fn)
+{
+    if (ncio.rw != 'r') (*icebin_error)(-1,
+        "Grid::nc_read_filtered() can only read");
+
+    // nfull is read here, so it does not change when cells are left out
+    ncio_grid_info(ncio, vname, spec, name,
+        coordinates, parameterization, indexing, sproj,
+        cells._nfull, vertices._nfull);
+    nc_read(ncio.nc, vname, keep_fn);
+}
+
+void Grid::nc_read_filtered(NcIO &ncio, std::string const &vname,
+    ibmisc::Domain const &domain)
+{
+    // indexing is not known until the grid info has been read
+    nc_read_filtered(ncio, vname, [this, &domain](long index)
+        { return ibmisc::in_domain(&domain, &indexing, index); });
+}
+
 // ============================================================
 
 /** Creates a new grid with just the cells we want to keep in it.
@@ -176,6 +176,9 @@ public:
 
     void clear() { _cells.clear(); }
 
+    /** Pre-allocates hash buckets for n items */
+    void reserve(size_t n) { _cells.reserve(n); }
+
     CellT *at(long index) { return &*_cells.at(index); }
     CellT const *at(long index) const { return &*_cells.at(index); }
     size_t nrealized() const { return _cells.size(); }
@@ -300,19 +303,52 @@ public:
         { return cell.centroid(); }
 
 protected:
-    void nc_read(netCDF::NcGroup *nc, std::string const &vname);
+    /** @param keep_fn If set, read only the cells for which it returns
+        true, and the vertices they use. */
+    void nc_read(netCDF::NcGroup *nc, std::string const &vname,
+        std::function<bool (long)> const &keep_fn = std::function<bool (long)>());
     void nc_write(netCDF::NcGroup *nc, std::string const &vname) const;
 public:
     virtual void ncio(ibmisc::NcIO &ncio, std::string const &vname, bool rw_full=true);
 
+    /** Reads a grid, keeping only the cells for which keep_fn returns
+    true (and the vertices they use).  Same result as ncio() followed
+    by filter_cells(), but cells and vertices that are not kept are
+    never read in. */
+    void nc_read_filtered(ibmisc::NcIO &ncio, std::string const &vname,
+        std::function<bool (long)> const &keep_fn);
+
+    /** Reads just the cells in our MPI domain (see nc_read_filtered()) */
+    void nc_read_filtered(ibmisc::NcIO &ncio, std::string const &vname,
+        ibmisc::Domain const &domain);
+
 
     /** Remove cells and vertices not relevant to us --- for example, not in our MPI domain.
-    This will be done AFTER we read it in.  It's an optimization. */
+    This will be done AFTER we read it in.  It's an optimization.
+    @see nc_read_filtered(), which avoids reading them in the first place. */
     void filter_cells(std::function<bool (long)> const &keep_fn);
 };
 
 void sort_renumber_vertices(Grid &grid);
 
+/** Reads/writes the description of a grid (everything except its
+cells and vertices), in the format used by Grid::ncio().  Shared with
+FlatGrid.
+@return The <vname>.info variable */
+netCDF::NcVar ncio_grid_info(ibmisc::NcIO &ncio, std::string const &vname,
+    std::unique_ptr<GridSpec> &spec,
+    std::string &name,
+    GridCoordinates &coordinates,
+    GridParameterization &parameterization,
+    ibmisc::Indexing &indexing,
+    std::string &sproj,
+    long &cells_nfull, long &vertices_nfull);
+
+/** Defines the variables written by Grid::nc_write() */
+void define_grid_vars(ibmisc::NcIO &ncio, std::string const &vname,
+    netCDF::NcVar &info_v,
+    long vertices_nrealized, long cells_nfull, long cells_nrealized, long nvref);
+
 
 }   // namespace
 
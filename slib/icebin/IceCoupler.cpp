@@ -18,6 +18,9 @@
 
 #include <mpi.h>        // Intel MPI wants to be first
 #include <type_traits>
+#include <functional>
+#include <algorithm>
+#include <cstring>
 #include <boost/filesystem.hpp>
 
 #include <spsparse/blitz.hpp>
@@ -28,6 +31,10 @@
 #include <ibmisc/string.hpp>    // string_printf()
 #include <icebin/GCMCoupler.hpp>
 #include <icebin/GCMRegridder.hpp>
+#include <icebin/IceRegridder_L0.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/memsize.hpp>
+#include <icebin/parallel.hpp>
 #include <icebin/contracts/contracts.hpp>
 #include <spsparse/eigen.hpp>
 #include <spsparse/blitz.hpp>
@@ -57,7 +64,9 @@ std::unique_ptr<IceCoupler> new_ice_coupler(
 
     IceCoupler::Params params(_gcm_coupler->make_ice_coupler_params(sheet_name));
     std::unique_ptr<IceCoupler> self;
-    switch(type.index()) {
+    if (_gcm_coupler->make_ice_coupler) {
+        self = _gcm_coupler->make_ice_coupler(sheet_name, params);
+    } else switch(type.index()) {
 #if 0
         case IceCoupler::Type::DISMAL :
             self.reset(new IceCoupler_DISMAL);
@@ -77,11 +86,11 @@ std::unique_ptr<IceCoupler> new_ice_coupler(
     // Do basic initialization...
     self->_name = sheet_name;
     self->gcm_coupler = _gcm_coupler;
-    self->ice_regridder = &*_gcm_coupler->gcm_regridder->ice_regridders().at(sheet_name);
+    self->ice_regridder = _gcm_coupler->gcm_regridder->ice_regridder(sheet_name);
     self->emI_ice.reference(blitz::Array<double,1>(self->ice_regridder->nI()));
-    self->emI_ice = nan;
+    first_touch_fill(self->emI_ice.data(), self->emI_ice.size(), nan);
     self->emI_land.reference(blitz::Array<double,1>(self->ice_regridder->nI()));
-    self->emI_land = nan;
+    first_touch_fill(self->emI_land.data(), self->emI_land.size(), nan);
 
 //    if (rw_full) ncio_blitz(ncio, elevmaskI, true, vname + ".elevmaskI", "double",
 //        get_dims(ncio ,{vname + ".gridI.cells.nfull"}));
@@ -109,6 +118,41 @@ void IceCoupler::ncread(ibmisc::NcIO &ncio_config, std::string const &vname_shee
     // General args passed to the ice sheet, regardless of which ice model is being used
     NcVar info_var(ncio_config.nc->getVar(vname_sheet + ".info"));
     get_or_put_att<NcVar,double>(info_var, 'r', "sigma", "double", &sigma[0], 3);
+
+    // Optional attributes
+    auto info_atts(info_var.getAtts());
+    if (info_atts.find("cache_matrices") != info_atts.end())
+        get_or_put_att(info_var, 'r', "cache_matrices", &cache_matrices, 1);
+    if (info_atts.find("smooth_separable") != info_atts.end())
+        get_or_put_att(info_var, 'r', "smooth_separable", &smooth_separable, 1);
+    if (info_atts.find("smooth_tol") != info_atts.end())
+        get_or_put_att(info_var, 'r', "smooth_tol", &smooth_tol, 1);
+    if (info_atts.find("incremental_GvEp") != info_atts.end()) {
+        // Set on our (non-const) IceRegridder
+        auto *regridder(dynamic_cast<IceRegridder_L0 *>(
+            gcm_coupler->gcm_regridder->ice_regridder(name())));
+        if (regridder) get_or_put_att(info_var, 'r', "incremental_GvEp",
+            &regridder->incremental_GvEp, 1);
+    }
+    if (info_atts.find("use_gpu") != info_atts.end())
+        get_or_put_att(info_var, 'r', "use_gpu", &use_gpu, 1);
+#ifndef USE_CUDA
+    if (use_gpu) (*icebin_error)(-1,
+        "IceCoupler(%s): use_gpu requires IceBin built with USE_CUDA", name().c_str());
+#endif
+    if (info_atts.find("matrix_snapshot") != info_atts.end())
+        get_or_put_att(info_var, 'r', "matrix_snapshot", matrix_snapshot);
+    if (info_atts.find("reuse_regrid") != info_atts.end())
+        get_or_put_att(info_var, 'r', "reuse_regrid", &reuse_regrid, 1);
+
+    // (Only the root regrids)
+    if (cache_matrices && matrix_snapshot != "" && gcm_coupler->am_i_root()) {
+        snapshot_files_hash = hash_file(gcm_coupler->grid_fname,
+            std::hash<std::string>()(name()));
+        if (matrix_cache.load(matrix_snapshot, snapshot_files_hash))
+            printf("IceCoupler(%s): loaded %ld matrices from %s\n",
+                name().c_str(), (long)matrix_cache.size(), matrix_snapshot.c_str());
+    }
 }
 
 /** Read/write for IceBin restart file */
@@ -121,12 +165,23 @@ void IceCoupler::ncio_icebin_rsf(ibmisc::NcIO &ncio)
     if (ncio.rw == 'r') dimE0.reset(new SparseSetT);
     if (dimE0.get() != nullptr) dimE0->ncio(ncio, "IceCoupler."+name()+".dimE0");
 
-    if (ncio.rw == 'r') IvE0.reset(new EigenSparseMatrixT);
-    if (IvE0.get() != nullptr) ncio_eigen(ncio, *IvE0, "IceCoupler."+name()+".IvE0");
+    if (ncio.rw == 'r') IvE0.reset(new CompactSparseMatrix);
+    if (IvE0.get() != nullptr) {
+        std::string const vname("IceCoupler."+name()+".IvE0");
+        // Restart files from before ncio_compact() was used
+        if (ncio.rw == 'r' && !CompactSparseMatrix::has_compact(ncio.nc, vname))
+            IvE0->ncio(ncio, vname);
+        else IvE0->ncio_compact(ncio, vname);
+    }
 }
 
 IceCoupler::~IceCoupler() {}
 
+bool IceCoupler::full_ovalsI() const
+{
+    return !gcm_coupler->distributed_ice || gcm_coupler->gcm_params.icebin_logging;
+}
+
 // ==============================================================
 void IceCoupler::model_start(
     bool cold_start,
@@ -149,6 +204,7 @@ void IceCoupler::model_start(
 
     // Allocate
     ice_ovalsI.reference(blitz::Array<double,2>(contract[OUTPUT].size(), nI()));
+    first_touch_fill(ice_ovalsI.data(), ice_ovalsI.size(), 0.);
 }
 
 /** Print summary info of the contracts to STDOUT. */
@@ -200,14 +256,27 @@ printf("wB_b-%d = %f\n", wB_b(i));
 }
 #endif
 // -----------------------------------------------------------
+/** Resizes a Workspace array, unless it is already the right shape */
+static void reshape(blitz::Array<double,2> &arr, int n0, int n1)
+{
+    if (arr.extent(0) != n0 || arr.extent(1) != n1) arr.resize(n0, n1);
+}
+
+#ifdef USE_CUDA
+/** Uploads a CompactSparseMatrix (via visit()), at its stored precision */
+struct SetGPUMatrix {
+    GPUMatrix &gpu;
+    template<class SparseMatrixT>
+    void operator()(SparseMatrixT const &M) { gpu.set(M); }
+};
+#endif
+
 blitz::Array<double,2> IceCoupler::construct_ice_ivalsI(
 blitz::Array<double,2> const &gcm_ovalsE0,
 std::vector<std::pair<std::string, double>> const &scalars,
-double dt,
-ibmisc::TmpAlloc &tmp)
+double dt)
 {
-printf("BEGIN construct_ice_ivalsI(dt=%g)\n", dt);
-    auto nE0(gcm_ovalsE0.extent(0));
+    ICEBIN_PROFILE_SCOPE("IceCoupler::construct_ice_ivalsI");
 
     // ------------- Form ice_ivalsI
     // Assuming column-major matrices...
@@ -220,22 +289,31 @@ printf("BEGIN construct_ice_ivalsI(dt=%g)\n", dt);
     // |k| = # variables in ice_input
     // |l| = # variables in gcm_output
 
-    auto &ice_ivalsI_e(tmp.make<EigenDenseMatrixT>());    // Memory for ice_ivalsI
+    auto &ice_ivalsI_e(workspace.ice_ivalsI_e);    // Memory for ice_ivalsI
 
     // Get the sparse matrix to convert GCM output variables to ice model inputs
     // This will be transposed: M(input, output).  b is a row-vector here.
-    auto icei_v_gcmo_T(var_trans_inE.apply_scalars(scalars, 'T'));    // Mxb
+    auto const &icei_v_gcmo_T(var_trans_inE_T(var_trans_inE, scalars));    // Mxb
 //  print_var_trans(icei_v_gcmo_T, var_trans_inE, 'T');
 
     // Switch from row-major (Blitz++) to col-major (Eigen) indexing
-    Eigen::Map<EigenDenseMatrixT> const gcm_ovalsE0_e(
-        const_cast<double *>(gcm_ovalsE0.data()),
+    Eigen::Map<EigenDenseMatrixT const> const gcm_ovalsE0_e(
+        gcm_ovalsE0.data(),
         gcm_ovalsE0.extent(1), gcm_ovalsE0.extent(0));
 
     // Ice inputs calculated as the result of a matrix multiplication
     // ice_ivalsI_e is |i| x |k|
-    ice_ivalsI_e = (*IvE0) * (
-        gcm_ovalsE0_e * icei_v_gcmo_T.M + icei_v_gcmo_T.b.replicate(nE0,1) );
+#ifdef USE_CUDA
+    if (use_gpu) {
+        // IvE0 only changes once per couple(): re-uploaded then
+        if (!gpu_IvE0) {
+            gpu_IvE0.reset(new GPUMatrix);
+            IvE0->visit(SetGPUMatrix{*gpu_IvE0});
+        }
+        gpu_IvE0->apply_multi(gcm_ovalsE0_e, icei_v_gcmo_T, ice_ivalsI_e);
+    } else
+#endif
+    IvE0->apply_multi(gcm_ovalsE0_e, icei_v_gcmo_T, ice_ivalsI_e);
 
     // Alias the Eigen matrix to blitz array
     blitz::Array<double,2> ice_ivalsI(
@@ -247,7 +325,6 @@ printf("AA6\n");
     // Continue construction in a contract-specific manner
     reconstruct_ice_ivalsI(ice_ivalsI, dt);
 
-printf("END construct_ice_ivalsI()\n");
     return ice_ivalsI;
 }
 // -----------------------------------------------------------
@@ -265,23 +342,39 @@ std::vector<VectorMultivec> &gcm_ivalss_s,                // (accumulate over ma
 // ------- Flags
 bool run_ice)
 {
-    double const time_s = timespan[1];
+    ICEBIN_PROFILE_SCOPE("IceCoupler::couple");
+    couple_ice(timespan, gcm_ovalsE_s, run_ice);
+    return couple_regrid(timespan, gcm_ivalss_s);
+}
 
-    IceCoupler::CoupleOut ret;
+void IceCoupler::flush_log_writer()
+{
+    AsyncWriter *log_writer(gcm_coupler->log_writer.get());
+    if (log_writer) log_writer->flush();
+}
+
+void IceCoupler::couple_ice(
+std::array<double,2> timespan, // {last_time_s, time_s}
+VectorMultivec const &gcm_ovalsE_s,
+bool run_ice)
+{
+    ICEBIN_PROFILE_SCOPE("IceCoupler::couple_ice");
+    double const time_s = timespan[1];
 
     if (!gcm_coupler->am_i_root()) {
         printf("[noroot] BEGIN IceCoupler::couple(%s) run_ice=%d\n", name().c_str(), run_ice);
 
         // Allocate dummy variables, even though they will only be set on root
-        blitz::Array<double,2> ice_ivalsI(contract[INPUT].size(), nI());
+        reshape(workspace.ice_ivalsI, contract[INPUT].size(), nI());
+        blitz::Array<double,2> &ice_ivalsI(workspace.ice_ivalsI);
         ice_ivalsI = 0;
         ice_ovalsI = 0;
+        flush_log_writer();
         run_timestep(time_s, ice_ivalsI, ice_ovalsI, run_ice);
         printf("[noroot] END IceCoupler::couple(%s)\n", name().c_str());
-        return ret;
+        return;
     }
 
-    printf("BEGIN IceCoupler::couple(%s)\n", name().c_str());
 
     // ========== Get Ice Inputs
     // E_s = Elevation grid (sparse indices)
@@ -303,7 +396,8 @@ bool run_ice)
     // Densify gcm_ovalsE_s --> gcm_ovalsE
     // This should ONLY involve iE already mentioned in IvE0;
     // if not, ibmisc_error() will be called inside to_dense()
-    blitz::Array<double,2> gcm_ovalsE(gcm_coupler->gcm_outputsE.size(), dimE0->dense_extent());
+    reshape(workspace.gcm_ovalsE, gcm_coupler->gcm_outputsE.size(), dimE0->dense_extent());
+    blitz::Array<double,2> &gcm_ovalsE(workspace.gcm_ovalsE);
     gcm_ovalsE = 0;
     for (size_t i=0; i<gcm_ovalsE_s.size(); ++i) {
         long iE_s(gcm_ovalsE_s.index[i]);
@@ -323,10 +417,10 @@ bool run_ice)
         std::make_pair("by_dt", 1.0 / dt)});
 
     {
-        TmpAlloc tmp;    // Allocate variables for the duration of this function
+        if (!run_ice) reshape(workspace.ice_ivalsI, contract[INPUT].size(), nI());
         blitz::Array<double,2> ice_ivalsI(run_ice ?
-            construct_ice_ivalsI(gcm_ovalsE, scalars, dt, tmp) :
-            blitz::Array<double,2>(contract[INPUT].size(), nI()));
+            construct_ice_ivalsI(gcm_ovalsE, scalars, dt) :
+            workspace.ice_ivalsI);
 
         // ========= Step the ice model forward
         if (writer[INPUT].get()) {
@@ -334,13 +428,152 @@ bool run_ice)
             writer[INPUT]->write(time_s, ice_ivalsI);
         }
         ice_ovalsI = 0;
-        run_timestep(time_s, ice_ivalsI, ice_ovalsI, run_ice);
-        if (writer[OUTPUT].get()) {
+        flush_log_writer();
+        {ICEBIN_PROFILE_SCOPE("IceCoupler::run_timestep");
+            run_timestep(time_s, ice_ivalsI, ice_ovalsI, run_ice);
+        }
+        if (writer[OUTPUT].get() && full_ovalsI()) {
             // writing icemodel-out
             writer[OUTPUT]->write(time_s, ice_ovalsI);
         }
     }
 
+}
+
+typedef Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> RowMajorMap;
+
+/** Adds n rows of regridded output to vm; apply_multi() may write
+them through the returned Map, which has the same layout as vm.vals */
+static RowMajorMap append_regridded(VectorMultivec &vm, long nvar,
+    long const *rows_s, double const *wMs, long n)
+{
+    if (nvar != vm.nvar) (*icebin_error)(-1,
+        "Regridded %ld variables into a VectorMultivec of %d", nvar, vm.nvar);
+    return RowMajorMap(vm.append_zero(n, rows_s, wMs), n, nvar);
+}
+
+/** Checks about nsample evenly spaced columns of M and rows of A_e
+(all of them if nsample == 0) for NaNs; see NanCheck */
+static void check_nans(NanCheck &nan_check,
+    EigenSparseMatrixT const &M,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    long nsample)
+{
+    long const strideM = (nsample == 0 ? 1 : std::max(1L, M.outerSize() / nsample));
+    for (long k=0; k<M.outerSize() && !nan_check.where; k += strideM) {
+        for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) {
+            if (std::isnan(ii.value())) nan_check.found("matrix", ii.row(), k);
+        }
+    }
+
+    long const strideA = (nsample == 0 ? 1 : std::max(1L, (long)A_e.rows() / nsample));
+    for (long i=0; i<A_e.rows() && !nan_check.where; i += strideA)
+        nan_check.check_row(A_e, i);
+}
+
+/** Fails on the first NaN found by a NanCheck */
+static void report_nans(NanCheck const &nan_check, std::string const &sAE)
+{
+    if (!nan_check.where) return;
+    if (std::string(nan_check.where) == "matrix") (*icebin_error)(-1,
+        "NaN found: %svI[%ld, %ld]", sAE.c_str(), nan_check.row, nan_check.col);
+    (*icebin_error)(-1,
+        "NaN found: ice_ovalsI_e[%ld, %ld]", nan_check.row, nan_check.col);
+}
+
+/** The part of apply_multi() before the product: each row of A_e
+used by BvA, transformed by trans (other rows of Y are zero).  Then
+BvA * Y is what apply_multi() would produce.
+@param nan_check If set, look for NaNs in BvA and A along the way */
+template<class TransT>
+static void transform_used_rows(
+    EigenSparseMatrixT const &BvA,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    TransT const &trans,
+    EigenDenseMatrixT &Y,
+    NanCheck *nan_check)
+{
+    if (A_e.rows() != BvA.cols()) (*icebin_error)(-1,
+        "transform_used_rows(): Matrix has %ld columns, but fields have %ld rows",
+        (long)BvA.cols(), (long)A_e.rows());
+
+    Y.resize(A_e.rows(), trans.M.cols());
+    Y.setZero();
+    for (int k=0; k<BvA.outerSize(); ++k) {
+        EigenSparseMatrixT::InnerIterator ii(BvA, k);
+        if (!ii) continue;    // Row of A not used
+        if (nan_check) {
+            nan_check->check_row(A_e, k);
+            for (; ii; ++ii) if (std::isnan(ii.value()))
+                nan_check->found("matrix", ii.row(), k);
+        }
+        Y.row(k) = A_e.row(k) * trans.M;
+        Y.row(k) += trans.b;
+    }
+}
+
+/** Wraps contiguous doubles as a 1-D Blitz array, for hash_array() */
+static blitz::Array<double,1> flat_array(double const *data, size_t n)
+{
+    return blitz::Array<double,1>(const_cast<double *>(data),
+        blitz::shape(n), blitz::neverDeleteData);
+}
+
+/** Fingerprint of everything couple_regrid() depends on, apart from
+the (fixed) grids and configuration; see IceCoupler::reuse_regrid.
+@param rm_inputs_hash RegridMatrices_Dynamic::inputs_hash
+@return Never 0 */
+static size_t regrid_inputs_hash(
+    size_t rm_inputs_hash,
+    blitz::Array<double,2> const &ice_ovalsI,
+    std::vector<double> const &hcdefs,
+    std::vector<std::pair<std::string, double>> const &scalars)
+{
+    if (!ice_ovalsI.isStorageContiguous()) (*icebin_error)(-1,
+        "regrid_inputs_hash(): ice_ovalsI must be contiguous");
+
+    size_t seed = rm_inputs_hash;
+    seed = hash_array(flat_array(ice_ovalsI.data(), ice_ovalsI.size()), seed);
+    seed = hash_array(flat_array(hcdefs.data(), hcdefs.size()), seed);
+    for (auto const &scalar : scalars)
+        seed = hash_array(flat_array(&scalar.second, 1), seed);
+    return (seed == 0 ? 1 : seed);
+}
+
+/** Bitwise comparison of contiguous doubles (NaN-safe, unlike ==) */
+static bool same_doubles(double const *a, size_t na, double const *b, size_t nb)
+{
+    return na == nb && (na == 0 || memcmp(a, b, na * sizeof(double)) == 0);
+}
+
+static std::vector<double> scalar_values(
+    std::vector<std::pair<std::string, double>> const &scalars)
+{
+    std::vector<double> ret;
+    for (auto const &scalar : scalars) ret.push_back(scalar.second);
+    return ret;
+}
+
+IceCoupler::CoupleOut IceCoupler::couple_regrid(
+std::array<double,2> timespan, // {last_time_s, time_s}
+std::vector<VectorMultivec> &gcm_ivalss_s)
+{
+    ICEBIN_PROFILE_SCOPE("IceCoupler::couple_regrid");
+    double const time_s = timespan[1];
+    double const dt = timespan[1] - timespan[0];
+    std::vector<std::pair<std::string, double>> scalars({
+        std::make_pair("by_dt", 1.0 / dt)});
+
+    IceCoupler::CoupleOut ret;
+
+    if (!gcm_coupler->am_i_root()) {
+        if (gcm_coupler->distributed_regrid)
+            couple_distributed({}, scalars, gcm_ivalss_s);
+        else if (gcm_coupler->distributed_ice)
+            couple_local({}, scalars, gcm_ivalss_s);
+        return ret;
+    }
+
     // ========== Update regridding matrices
     int emI_ice_ix = standard_names[OUTPUT].at("elevmask_ice");
     blitz::Array<double,1> out_emI_ice(ice_ovalsI(emI_ice_ix, blitz::Range::all()));
@@ -359,11 +592,50 @@ bool run_ice)
     GCMRegridder *gcmr(&*gcm_coupler->gcm_regridder);
     int sheet_index = gcmr->ice_regridders().index.at(name());
     std::unique_ptr<RegridMatrices_Dynamic> rm(gcmr->regrid_matrices(sheet_index, emI_ice));
+    if (cache_matrices) {
+        rm->cache = &matrix_cache;
+        rm->smoothing_cache = &smoothing_cache;
+        rm->product_cache = &product_cache;
+    }
+    matrix_stats.clear();
+    if (gcm_coupler->matrix_stats) rm->stats = &matrix_stats;
+
+    // ------ Nothing changed since last time: same matrices, same GCM inputs
+    bool const can_reuse = reuse_regrid && !gcm_coupler->combined_regrid
+        && !gcm_coupler->distributed_regrid && !gcm_coupler->distributed_ice;
+    if (can_reuse) {
+        ret.fingerprint = regrid_inputs_hash(
+            rm->inputs_hash, ice_ovalsI, gcmr->hcdefs(), scalars);
+    }
+    if (can_reuse && ret.fingerprint == regrid_fingerprint && IvE0 && dimE0
+        && prev_gcm_ivalss_s.size() == gcm_ivalss_s.size()
+        && rm->inputs_hash == prev_rm_inputs_hash
+        && ice_ovalsI.extent(0) == prev_ice_ovalsI.extent(0)
+        && same_doubles(ice_ovalsI.data(), ice_ovalsI.size(),
+            prev_ice_ovalsI.data(), prev_ice_ovalsI.size())
+        && same_doubles(gcmr->hcdefs().data(), gcmr->hcdefs().size(),
+            prev_hcdefs.data(), prev_hcdefs.size())
+        && scalar_values(scalars) == prev_scalars)
+    {
+        for (size_t iAE=0; iAE < gcm_ivalss_s.size(); ++iAE) {
+            VectorMultivec const &prev(prev_gcm_ivalss_s[iAE]);
+            gcm_ivalss_s[iAE].append(prev.size(),
+                prev.index.data(), prev.vals.data(), prev.weights.data());
+        }
+        ret.dimE = &*dimE0;
+        ret.reused = true;
+        if (profile::verbose) printf(
+            "IceCoupler::couple(%s): inputs unchanged, reusing previous regrid\n",
+            name().c_str());
+        return ret;
+    }
 
     // ------ Update E1vE0 translation between old and new elevation classes
     //        (global for all ice sheets)
     // A SparseSet that is identity for the entire range of I
-    SparseSetT dimI(id_sparse_set<SparseSetT>(nI()));
+    if (workspace.dimI.dense_extent() != nI())
+        workspace.dimI = id_sparse_set<SparseSetT>(nI());
+    SparseSetT &dimI(workspace.dimI);
 
     // _nc means "No Correct" for changes in area due to projections
     // See commit d038e5cb for deeper explanation
@@ -381,6 +653,10 @@ bool run_ice)
         AE1vIs[(int)IndexAE::A] = &*A1vI_unscaled;
         AE1vIs[(int)IndexAE::E] = &*E1vI_unscaled_nc;
 
+    std::vector<size_t> nivals0;    // Size of gcm_ivalss_s before this sheet
+    for (auto const &vv : gcm_ivalss_s) nivals0.push_back(vv.size());
+    if (gcm_coupler->combined_regrid) ret.blocks.resize(gcm_ivalss_s.size());
+
     for (int iAE=(int)IndexAE::A; iAE <= (int)IndexAE::E; ++iAE) {
 
         // Assuming column-major matrices...
@@ -396,81 +672,142 @@ bool run_ice)
 
         // Get the sparse matrix to convert ice model output variables to GCM inputs
         // This will be transposed: M(input, output).  b is a row-vector here.
-        auto gcmi_v_iceo_T(var_trans_outAE[iAE].apply_scalars(scalars, 'T'));
+        auto const &gcmi_v_iceo_T(var_trans_outAE_T[iAE](var_trans_outAE[iAE], scalars));
 //        print_var_trans(gcmi_v_iceo_T, var_trans_outAE[iAE], 'T');
 
         // Switch from row-major (Blitz++) to col-major (Eigen) indexing
-        Eigen::Map<EigenDenseMatrixT> ice_ovalsI_e(
+        Eigen::Map<EigenDenseMatrixT const> ice_ovalsI_e(
             ice_ovalsI.data(), ice_ovalsI.extent(1), ice_ovalsI.extent(0));
 
         // ----------- Sanity check: There should not be any NaNs...
-        bool hasnan = false;
-        for (auto ii(begin(*AE1vIs[iAE]->M)); ii != end(*AE1vIs[iAE]->M); ++ii) {
-            if (std::isnan(ii->value())) {
-            	    printf("nan found: AvI[%d, %d] = %g\n", ii->row(), ii->col(), ii->value());
-                hasnan = true;
-            }
-        }
-        for (int j=0; j<ice_ovalsI_e.cols(); ++j) {
-            if (contract[OUTPUT][j].flags & contracts::ALLOW_NAN) continue;
-            for (int i=0; i<ice_ovalsI_e.rows(); ++i) {
-                auto val(ice_ovalsI_e(i,j));
-                if (std::isnan(val)) {
-                    printf("nan found: ice_ovalsI_e[%d, %d] = %g\n", i, j, val);
-                    hasnan = true;
-                }
+        NanCheckLevel const nan_level(gcm_coupler->nan_check);
+        NanCheck nan_check;
+        if (nan_level != NanCheckLevel::OFF) {
+            // The variable transform is small: always check all of it
+            for (auto ii(begin(gcmi_v_iceo_T.M)); ii != end(gcmi_v_iceo_T.M); ++ii) {
+                if (std::isnan(ii->value())) (*icebin_error)(-1,
+                    "NaN found: gcmi_v_iceo_T.M[%d, %d]", ii->row(), ii->col());
             }
+            for (int j=0; j<gcmi_v_iceo_T.b.cols(); ++j) {
+            for (int i=0; i<gcmi_v_iceo_T.b.rows(); ++i) {
+                if (std::isnan(gcmi_v_iceo_T.b(i,j))) (*icebin_error)(-1,
+                    "NaN found: gcmi_v_iceo_T.b[%d, %d]", i, j);
+            }}
+
+            for (size_t j=0; j<contract[OUTPUT].size(); ++j)
+                nan_check.allow_nan.push_back(
+                    (contract[OUTPUT][j].flags & contracts::ALLOW_NAN) != 0);
+
+            // FULL is done by apply_multi(), below (except when distributed);
+            // with distributed_ice, each rank checks its own part in couple_local()
+            if (gcm_coupler->distributed_ice) {}
+            else if (nan_level == NanCheckLevel::SAMPLED)
+                check_nans(nan_check, *AE1vIs[iAE]->M, ice_ovalsI_e, 1024);
+            else if (gcm_coupler->distributed_regrid)
+                check_nans(nan_check, *AE1vIs[iAE]->M, ice_ovalsI_e, 0);
+            report_nans(nan_check, IndexAE_labels[iAE]);
         }
-        for (auto ii(begin(gcmi_v_iceo_T.M)); ii != end(gcmi_v_iceo_T.M); ++ii) {
-            if (std::isnan(ii->value())) {
-                printf("nan found: gcmi_v_iceo_T.M[%d, %d] = %g\n", ii->row(), ii->col(), ii->value());
-                hasnan = true;
-            }
-        }
-
-        for (int j=0; j<gcmi_v_iceo_T.b.cols(); ++j) {
-        for (int i=0; i<gcmi_v_iceo_T.b.rows(); ++i) {
-            auto val(gcmi_v_iceo_T.b(i,j));
-            if (std::isnan(val)) {
-                printf("nan found: gcmi_v_iceo_T.b[%d, %d] = %g\n", i, j, val);
-                hasnan = true;
-            }
-        }}
-
-        if (hasnan) (*icebin_error)(-1, "At least one NaN detected!");
         // -------------------------- END Sanity Check
 
-        // Regrid while recombining variables
-        // (Do not need to use Weighted_Eigen::apply(), since this is not IvE)
-        EigenDenseMatrixT gcm_ivalsX((*AE1vIs[iAE]->M) * (
-            ice_ovalsI_e * gcmi_v_iceo_T.M + gcmi_v_iceo_T.b.replicate(nI(),1) ));
-        // Sparsify while appending to the global VectorMultivec
-        // (Transposes order in memory)
-        std::vector<double> vals(gcm_ivalss_s[iAE].nvar);
-        for (int jj=0; jj < gcm_ivalsX.rows(); ++jj) {
-            auto jj_s(AE1vIs[iAE]->dims[0]->to_sparse(jj));
-            int nn = 0;
-            for (; nn < gcm_ivalsX.cols(); ++nn) {
-                vals[nn] = gcm_ivalsX(jj,nn);
-            }
-            gcm_ivalss_s[iAE].add(jj_s, vals, AE1vIs[iAE]->wM(jj));
-
+        // Each rank does its own rows (or columns), below
+        if (gcm_coupler->distributed_regrid || gcm_coupler->distributed_ice) continue;
+
+        // All sheets are regridded together, in GCMCoupler::couple_combined()
+        // (the matrix is moved into the block once it is written, below)
+        if (gcm_coupler->combined_regrid) {
+            IceCoupler::RegridBlock &block(ret.blocks[iAE]);
+            transform_used_rows(*AE1vIs[iAE]->M, ice_ovalsI_e, gcmi_v_iceo_T, block.Y,
+                nan_level == NanCheckLevel::FULL ? &nan_check : nullptr);
+            report_nans(nan_check, IndexAE_labels[iAE]);
+
+            auto &dimX1(*AE1vIs[iAE]->dims[0]);
+            long const nX1 = AE1vIs[iAE]->M->rows();
+            block.rows_s.resize(nX1);
+            for (long jj=0; jj < nX1; ++jj) block.rows_s[jj] = dimX1.to_sparse(jj);
+            block.wM.resize(nX1);
+            for (long jj=0; jj < nX1; ++jj) block.wM[jj] = AE1vIs[iAE]->wM(jj);
+            continue;
         }
+
+        // Regrid while recombining variables, straight into the global VectorMultivec
+        // (Do not need to use Weighted_Eigen::apply(), since this is not IvE)
+        auto &dimX1(*AE1vIs[iAE]->dims[0]);
+        long const nX1 = AE1vIs[iAE]->M->rows();
+        workspace.rows_s.resize(nX1);
+        for (long jj=0; jj < nX1; ++jj) workspace.rows_s[jj] = dimX1.to_sparse(jj);
+        workspace.wMs.resize(nX1);
+        for (long jj=0; jj < nX1; ++jj) workspace.wMs[jj] = AE1vIs[iAE]->wM(jj);
+
+        RowMajorMap gcm_ivalsX(append_regridded(gcm_ivalss_s[iAE], gcmi_v_iceo_T.M.cols(),
+            workspace.rows_s.data(), workspace.wMs.data(), nX1));
+#ifdef USE_CUDA
+        // The FULL NaN check is fused into the CPU apply_multi()
+        if (use_gpu && nan_level != NanCheckLevel::FULL) {
+            if (!gpu_AE1vI[iAE]) gpu_AE1vI[iAE].reset(new GPUMatrix);
+            gpu_AE1vI[iAE]->set(*AE1vIs[iAE]->M);
+            gpu_AE1vI[iAE]->apply_multi(ice_ovalsI_e, gcmi_v_iceo_T, gcm_ivalsX);
+        } else
+#endif
+        apply_multi(*AE1vIs[iAE]->M, ice_ovalsI_e, gcmi_v_iceo_T, gcm_ivalsX,
+            nan_level == NanCheckLevel::FULL ? &nan_check : nullptr);
+        report_nans(nan_check, IndexAE_labels[iAE]);
     }        // iAE
+    if (gcm_coupler->distributed_regrid)
+        couple_distributed(AE1vIs, scalars, gcm_ivalss_s);
+    else if (gcm_coupler->distributed_ice)
+        couple_local(AE1vIs, scalars, gcm_ivalss_s);
+
+    // Remember this sheet's GCM inputs, for reuse_regrid
+    prev_gcm_ivalss_s.clear();
+    regrid_fingerprint = 0;
+    prev_ice_ovalsI.free();
+    prev_hcdefs.clear();
+    prev_scalars.clear();
+    if (can_reuse) {
+        for (size_t iAE=0; iAE < gcm_ivalss_s.size(); ++iAE) {
+            VectorMultivec const &vv(gcm_ivalss_s[iAE]);
+            size_t const i0 = nivals0[iAE];
+            VectorMultivec prev(vv.nvar);
+            prev.append(vv.size() - i0, vv.index.data() + i0,
+                vv.vals.data() + i0 * vv.nvar, vv.weights.data() + i0);
+            prev_gcm_ivalss_s.push_back(std::move(prev));
+        }
+        regrid_fingerprint = ret.fingerprint;
+        prev_rm_inputs_hash = rm->inputs_hash;
+        prev_ice_ovalsI.reference(ice_ovalsI.copy());
+        prev_hcdefs = gcmr->hcdefs();
+        prev_scalars = scalar_values(scalars);
+    }
+
     // Compute IvE (for use interpreting stuffE at beginning of next timestep)
+    RegridParams paramsIvE(true, true, sigma);    // scale=t, correctA=t
+    paramsIvE.separable = smooth_separable;
+    paramsIvE.smooth_tol = smooth_tol;
     std::unique_ptr<EigenSparseMatrixT> IvE1(
-        std::move(rm->matrix_d("IvE", {&dimI, &*dimE1},
-        RegridParams(true, true, sigma))->M)); // scale=t, correctA=t
+        std::move(rm->matrix_d("IvE", {&dimI, &*dimE1}, paramsIvE)->M));
 
     // Compute XuE
-    SparseSetT dimX(id_sparse_set<SparseSetT>(ice_regridder->nX()));
+    if (workspace.dimX.dense_extent() != ice_regridder->nX())
+        workspace.dimX = id_sparse_set<SparseSetT>(ice_regridder->nX());
+    SparseSetT &dimX(workspace.dimX);
     ret.XuE = rm->matrix_d("XvE", {&dimX, &*dimE1},
         RegridParams(false, true, std::array<double,3>{0,0,0}));
     ret.dimE = &*dimE1;   // reference, not moving it
 
+    // What this sheet holds at the peak of matrix building
+    ICEBIN_PROFILE_HELD("Weighted_Eigen", nbytes(*E1vI_unscaled_nc)
+        + nbytes(*A1vI_unscaled) + nbytes(*IvE1) + nbytes(*ret.XuE));
+    if (IvE0) ICEBIN_PROFILE_HELD("CompactSparseMatrix", IvE0->nbytes());
+    ICEBIN_PROFILE_HELD("AbbrGrid", nbytes(ice_regridder->agridI));
+
 
     // Record our matrices for posterity
-    {auto fname(
+    // (NetCDF is not thread-safe; see GCMCoupler::concurrent_sheets)
+#ifdef USE_OPENMP
+#pragma omp critical (icebin_netcdf)
+#endif
+    {std::lock_guard<std::mutex> nc_lock(netcdf_mutex);    // vs. GCMCoupler::log_writer
+    auto fname(
         boost::filesystem::path(output_dir) / 
         ("regrids-" + ice_regridder->name() + "-" + gcm_coupler->sdate(time_s) + ".nc"));
     NcIO ncio(fname.string(), NcFile::replace);
@@ -487,15 +824,317 @@ bool run_ice)
         ret.XuE->ncio(ncio, "XuE", {"dimX", "dimE"});
     }
 
+    // Written; now GCMCoupler::couple_combined() may have them
+    for (size_t iAE=0; iAE < ret.blocks.size(); ++iAE)
+        ret.blocks[iAE].M = std::move(AE1vIs[iAE]->M);
+
     // ---------- Save stuff for next time around
     // Store stuff from this timestep for next time around
     this->dimE0 = std::move(dimE1);
-    this->IvE0 = std::move(IvE1);
+    this->IvE0.reset(new CompactSparseMatrix(
+        std::move(*IvE1), gcm_coupler->matrix_precision));
+#ifdef USE_CUDA
+    if (gpu_IvE0) IvE0->visit(SetGPUMatrix{*gpu_IvE0});
+#endif
 
-    printf("END IceCoupler::couple(%s)\n", name().c_str());
+    if (gcm_coupler->matrix_stats)
+        matrix_stats.print(stdout, "IceCoupler::couple(" + name() + ")");
+    if (cache_matrices && profile::verbose) printf("IceCoupler::couple(%s): matrix cache hits=%ld misses=%ld\n",
+        name().c_str(), matrix_cache.nhit, matrix_cache.nmiss);
+    if (cache_matrices && matrix_snapshot != "" && matrix_cache.nmiss > snapshot_nmiss) {
+        // Encode now; the file is written behind with async_logging
+        auto buf(std::make_shared<std::vector<char>>(
+            matrix_cache.snapshot(snapshot_files_hash)));
+        std::string const fname(matrix_snapshot);
+        AsyncWriter *log_writer(gcm_coupler->log_writer.get());
+        if (log_writer) log_writer->push([fname, buf]() {
+            RegridMatrixCache::write_snapshot(fname, *buf);
+        });
+        else RegridMatrixCache::write_snapshot(fname, *buf);
+        snapshot_nmiss = matrix_cache.nmiss;
+    }
+    if (cache_matrices && profile::verbose) printf("IceCoupler::couple(%s): smoothing rows reused=%ld rebuilt=%ld\n",
+        name().c_str(), smoothing_cache.nrow_reused, smoothing_cache.nrow_rebuilt);
+    if (cache_matrices && profile::verbose) printf("IceCoupler::couple(%s): matrix products reused=%ld rebuilt=%ld\n",
+        name().c_str(), product_cache.nreused, product_cache.nrebuilt);
+#ifdef USE_CUDA
+    if (use_gpu && profile::verbose) for (int iAE=0; iAE<GridAE::count; ++iAE) {
+        if (gpu_AE1vI[iAE]) printf("IceCoupler::couple(%s): GPU %svI uploads=%ld applies=%ld\n",
+            name().c_str(), IndexAE_labels[iAE].c_str(), gpu_AE1vI[iAE]->nupload, gpu_AE1vI[iAE]->napply);
+    }
+#endif
     return ret;
 }
 
+// -----------------------------------------------------------
+/** Prefix sums, for MPI_Scatterv() displacements */
+static std::vector<int> mpi_displs(std::vector<int> const &counts)
+{
+    std::vector<int> displs(counts.size());
+    for (size_t i=1; i<counts.size(); ++i)
+        displs[i] = displs[i-1] + counts[i-1];
+    return displs;
+}
+
+void IceCoupler::couple_distributed(
+    std::vector<linear::Weighted_Eigen *> const &AE1vIs,
+    std::vector<std::pair<std::string, double>> const &scalars,
+    std::vector<VectorMultivec> &gcm_ivalss_s)
+{
+    ICEBIN_PROFILE_SCOPE("IceCoupler::couple_distributed");
+    MPI_Comm const comm(gcm_coupler->gcm_params.gcm_comm);
+    int const root = gcm_coupler->gcm_params.gcm_root;
+    bool const am_root = gcm_coupler->am_i_root();
+    int nrank;
+    MPI_Comm_size(comm, &nrank);
+
+    // Ice model output is only on root; it is the only ice-grid-sized transfer
+    MPI_Bcast(ice_ovalsI.data(), ice_ovalsI.size(), MPI_DOUBLE, root, comm);
+
+    // Switch from row-major (Blitz++) to col-major (Eigen) indexing
+    Eigen::Map<EigenDenseMatrixT const> ice_ovalsI_e(
+        ice_ovalsI.data(), ice_ovalsI.extent(1), ice_ovalsI.extent(0));
+
+    for (int iAE=(int)IndexAE::A; iAE <= (int)IndexAE::E; ++iAE) {
+
+        // ------- Root: counting-sort matrix rows (and their elements) by owning rank
+        std::vector<int> counts(2*nrank, 0);    // (nrow, nnz) for each rank
+        std::vector<int> nrows(nrank), nnzs(nrank), rdispls, edispls;
+        std::vector<long> rows_s;      // Sparse index of each row
+        std::vector<double> wMs;       // Weight of each row
+        std::vector<int> eis, ejs;     // Rank-local row, column of each element
+        std::vector<double> evals;
+        if (am_root) {
+            linear::Weighted_Eigen const &X1vI(*AE1vIs[iAE]);
+            EigenSparseMatrixT const &M(*X1vI.M);
+
+            std::vector<int> rank_of_row(M.rows());
+            std::vector<int> local_row(M.rows());
+            for (int jj=0; jj<M.rows(); ++jj) {
+                int const rank = gcm_coupler->domain_of(X1vI.dims[0]->to_sparse(jj));
+                if (rank < 0 || rank >= nrank) (*icebin_error)(-1,
+                    "domain_of(%ld) = %d out of range [0,%d)",
+                    X1vI.dims[0]->to_sparse(jj), rank, nrank);
+                rank_of_row[jj] = rank;
+                local_row[jj] = nrows[rank]++;
+            }
+            for (auto ii(begin(M)); ii != end(M); ++ii)
+                ++nnzs[rank_of_row[ii->row()]];
+
+            rdispls = mpi_displs(nrows);
+            edispls = mpi_displs(nnzs);
+            rows_s.resize(M.rows());
+            wMs.resize(M.rows());
+            eis.resize(M.nonZeros());
+            ejs.resize(M.nonZeros());
+            evals.resize(M.nonZeros());
+
+            std::vector<int> rpos(rdispls), epos(edispls);
+            for (int jj=0; jj<M.rows(); ++jj) {
+                int const k = rpos[rank_of_row[jj]]++;
+                rows_s[k] = X1vI.dims[0]->to_sparse(jj);
+                wMs[k] = X1vI.wM(jj);
+            }
+            for (auto ii(begin(M)); ii != end(M); ++ii) {
+                int const k = epos[rank_of_row[ii->row()]]++;
+                eis[k] = local_row[ii->row()];
+                ejs[k] = ii->col();
+                evals[k] = ii->value();
+            }
+
+            for (int r=0; r<nrank; ++r) {
+                counts[2*r] = nrows[r];
+                counts[2*r+1] = nnzs[r];
+            }
+        }
+
+        // ------- Send each rank its rows
+        int my_counts[2];
+        MPI_Scatter(counts.data(), 2, MPI_INT, my_counts, 2, MPI_INT, root, comm);
+        int const my_nrow = my_counts[0];
+        int const my_nnz = my_counts[1];
+
+        std::vector<long> my_rows_s(my_nrow);
+        std::vector<double> my_wMs(my_nrow);
+        std::vector<int> my_eis(my_nnz), my_ejs(my_nnz);
+        std::vector<double> my_evals(my_nnz);
+        MPI_Scatterv(rows_s.data(), nrows.data(), rdispls.data(), MPI_LONG,
+            my_rows_s.data(), my_nrow, MPI_LONG, root, comm);
+        MPI_Scatterv(wMs.data(), nrows.data(), rdispls.data(), MPI_DOUBLE,
+            my_wMs.data(), my_nrow, MPI_DOUBLE, root, comm);
+        MPI_Scatterv(eis.data(), nnzs.data(), edispls.data(), MPI_INT,
+            my_eis.data(), my_nnz, MPI_INT, root, comm);
+        MPI_Scatterv(ejs.data(), nnzs.data(), edispls.data(), MPI_INT,
+            my_ejs.data(), my_nnz, MPI_INT, root, comm);
+        MPI_Scatterv(evals.data(), nnzs.data(), edispls.data(), MPI_DOUBLE,
+            my_evals.data(), my_nnz, MPI_DOUBLE, root, comm);
+
+        // ------- Apply this rank's rows (same as in couple())
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(my_nnz);
+        for (int k=0; k<my_nnz; ++k)
+            triplets.push_back(Eigen::Triplet<double>(my_eis[k], my_ejs[k], my_evals[k]));
+        EigenSparseMatrixT my_X1vI(my_nrow, ice_ovalsI_e.rows());
+        my_X1vI.setFromTriplets(triplets.begin(), triplets.end());
+
+        auto const &gcmi_v_iceo_T(var_trans_outAE_T[iAE](var_trans_outAE[iAE], scalars));
+        RowMajorMap gcm_ivalsX(append_regridded(gcm_ivalss_s[iAE], gcmi_v_iceo_T.M.cols(),
+            my_rows_s.data(), my_wMs.data(), my_nrow));
+        apply_multi(my_X1vI, ice_ovalsI_e, gcmi_v_iceo_T, gcm_ivalsX);
+    }    // iAE
+}
+
+void IceCoupler::couple_local(
+    std::vector<linear::Weighted_Eigen *> const &AE1vIs,
+    std::vector<std::pair<std::string, double>> const &scalars,
+    std::vector<VectorMultivec> &gcm_ivalss_s)
+{
+    ICEBIN_PROFILE_SCOPE("IceCoupler::couple_local");
+    MPI_Comm const comm(gcm_coupler->gcm_params.gcm_comm);
+    int const root = gcm_coupler->gcm_params.gcm_root;
+    bool const am_root = gcm_coupler->am_i_root();
+    int nrank;
+    MPI_Comm_size(comm, &nrank);
+
+    // ------- First call: root learns which rank owns each ice grid cell
+    if (!have_rank_of_I) {
+        int my_nI = local_iI.size();
+        std::vector<int> nIs(nrank);
+        MPI_Gather(&my_nI, 1, MPI_INT, nIs.data(), 1, MPI_INT, root, comm);
+
+        std::vector<int> displs;
+        std::vector<long> iIs;
+        if (am_root) {
+            displs = mpi_displs(nIs);
+            long const nI_total = displs[nrank-1] + nIs[nrank-1];
+            if (nI_total != nI()) (*icebin_error)(-1,
+                "distributed_ice: ranks own %ld ice grid cells of %s, should be %ld"
+                " (does the ice model support distributed_ice?)",
+                nI_total, name().c_str(), nI());
+            iIs.resize(nI_total);
+        }
+        MPI_Gatherv(local_iI.data(), my_nI, MPI_LONG,
+            iIs.data(), nIs.data(), displs.data(), MPI_LONG, root, comm);
+
+        if (am_root) {
+            rank_of_I.assign(nI(), -1);
+            local_of_I.assign(nI(), -1);
+            for (int r=0; r<nrank; ++r) {
+            for (int k=0; k<nIs[r]; ++k) {
+                long const iI = iIs[displs[r] + k];
+                if (iI < 0 || iI >= nI() || rank_of_I[iI] >= 0) (*icebin_error)(-1,
+                    "distributed_ice: ice grid cell %ld is out of range or owned twice", iI);
+                rank_of_I[iI] = r;
+                local_of_I[iI] = k;
+            }}
+        }
+        have_rank_of_I = true;
+    }
+
+    // Switch from row-major (Blitz++) to col-major (Eigen) indexing
+    if (local_ovalsI.extent(1) != (long)local_iI.size()) (*icebin_error)(-1,
+        "local_ovalsI has %d columns, but this rank owns %ld ice grid cells",
+        local_ovalsI.extent(1), (long)local_iI.size());
+    Eigen::Map<EigenDenseMatrixT const> local_ovalsI_e(
+        local_ovalsI.data(), local_ovalsI.extent(1), local_ovalsI.extent(0));
+
+    NanCheckLevel const nan_level(gcm_coupler->nan_check);
+    NanCheck nan_check;
+    if (nan_level != NanCheckLevel::OFF) {
+        for (size_t j=0; j<contract[OUTPUT].size(); ++j)
+            nan_check.allow_nan.push_back(
+                (contract[OUTPUT][j].flags & contracts::ALLOW_NAN) != 0);
+    }
+
+    for (int iAE=(int)IndexAE::A; iAE <= (int)IndexAE::E; ++iAE) {
+
+        // ------- Root: counting-sort matrix elements by rank owning their column
+        long nrow = 0;
+        std::vector<int> nnzs(nrank), edispls;
+        std::vector<int> eis, ejs;     // Row, rank-local column of each element
+        std::vector<double> evals;
+        if (am_root) {
+            linear::Weighted_Eigen const &X1vI(*AE1vIs[iAE]);
+            EigenSparseMatrixT const &M(*X1vI.M);
+            nrow = M.rows();
+
+            for (int k=0; k<M.outerSize(); ++k)
+                nnzs[rank_of_I[k]] += M.innerVector(k).nonZeros();
+
+            edispls = mpi_displs(nnzs);
+            eis.resize(M.nonZeros());
+            ejs.resize(M.nonZeros());
+            evals.resize(M.nonZeros());
+
+            std::vector<int> epos(edispls);
+            for (int k=0; k<M.outerSize(); ++k) {
+                int &pos(epos[rank_of_I[k]]);
+                for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) {
+                    eis[pos] = ii.row();
+                    ejs[pos] = local_of_I[k];
+                    evals[pos] = ii.value();
+                    ++pos;
+                }
+            }
+        }
+
+        // ------- Send each rank the matrix columns for its ice grid cells
+        MPI_Bcast(&nrow, 1, MPI_LONG, root, comm);
+        int my_nnz;
+        MPI_Scatter(nnzs.data(), 1, MPI_INT, &my_nnz, 1, MPI_INT, root, comm);
+
+        std::vector<int> my_eis(my_nnz), my_ejs(my_nnz);
+        std::vector<double> my_evals(my_nnz);
+        MPI_Scatterv(eis.data(), nnzs.data(), edispls.data(), MPI_INT,
+            my_eis.data(), my_nnz, MPI_INT, root, comm);
+        MPI_Scatterv(ejs.data(), nnzs.data(), edispls.data(), MPI_INT,
+            my_ejs.data(), my_nnz, MPI_INT, root, comm);
+        MPI_Scatterv(evals.data(), nnzs.data(), edispls.data(), MPI_DOUBLE,
+            my_evals.data(), my_nnz, MPI_DOUBLE, root, comm);
+
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(my_nnz);
+        for (int k=0; k<my_nnz; ++k)
+            triplets.push_back(Eigen::Triplet<double>(my_eis[k], my_ejs[k], my_evals[k]));
+        EigenSparseMatrixT my_X1vI(nrow, local_ovalsI_e.rows());
+        my_X1vI.setFromTriplets(triplets.begin(), triplets.end());
+
+        // ------- Apply this rank's columns; sum (GCM-grid-sized) results on root
+        // apply_multi() adds trans.b once per matrix element, so partial
+        // sums over the columns add up to the full product.
+        auto const &gcmi_v_iceo_T(var_trans_outAE_T[iAE](var_trans_outAE[iAE], scalars));
+        long const nvar = gcmi_v_iceo_T.M.cols();
+        if (am_root) {
+            linear::Weighted_Eigen const &X1vI(*AE1vIs[iAE]);
+            workspace.rows_s.resize(nrow);
+            for (long jj=0; jj < nrow; ++jj) workspace.rows_s[jj] = X1vI.dims[0]->to_sparse(jj);
+            workspace.wMs.resize(nrow);
+            for (long jj=0; jj < nrow; ++jj) workspace.wMs[jj] = X1vI.wM(jj);
+
+            RowMajorMap gcm_ivalsX(append_regridded(gcm_ivalss_s[iAE], nvar,
+                workspace.rows_s.data(), workspace.wMs.data(), nrow));
+            apply_multi(my_X1vI, local_ovalsI_e, gcmi_v_iceo_T, gcm_ivalsX,
+                nan_level != NanCheckLevel::OFF ? &nan_check : nullptr);
+            MPI_Reduce(MPI_IN_PLACE, gcm_ivalsX.data(), nrow*nvar,
+                MPI_DOUBLE, MPI_SUM, root, comm);
+        } else {
+            Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> gcm_ivalsX;
+            apply_multi(my_X1vI, local_ovalsI_e, gcmi_v_iceo_T, gcm_ivalsX,
+                nan_level != NanCheckLevel::OFF ? &nan_check : nullptr);
+            MPI_Reduce(gcm_ivalsX.data(), nullptr, nrow*nvar,
+                MPI_DOUBLE, MPI_SUM, root, comm);
+        }
+
+        // Report NaNs by global ice grid cell
+        if (nan_check.where) {
+            if (std::string(nan_check.where) == "matrix")
+                nan_check.col = local_iI[nan_check.col];
+            else nan_check.row = local_iI[nan_check.row];
+        }
+        report_nans(nan_check, IndexAE_labels[iAE]);
+    }    // iAE
+}
+
 // =======================================================
 /** Specialized init signature for IceWriter */
 IceWriter::IceWriter(
@@ -616,6 +1255,22 @@ T &no_const(const T &val)
 TODO: More params need to be added.  Time, return values, etc. */
 void IceWriter::write(double time_s,
     blitz::Array<double,2> const &valsI)    // valsI[nvars, nI]
+{
+    AsyncWriter *log_writer(ice_coupler->gcm_coupler->log_writer.get());
+    if (!log_writer) {
+        _write(time_s, valsI);
+        return;
+    }
+
+    // The caller reuses valsI; only the shared_ptr crosses threads
+    auto valsI_copy(std::make_shared<blitz::Array<double,2>>(valsI.copy()));
+    log_writer->push([this, time_s, valsI_copy]() {
+        _write(time_s, *valsI_copy);
+    });
+}
+
+void IceWriter::_write(double time_s,
+    blitz::Array<double,2> const &valsI)
 {
     GCMCoupler const *gcm_coupler(ice_coupler->gcm_coupler);
     GCMParams const &gcm_params(gcm_coupler->gcm_params);
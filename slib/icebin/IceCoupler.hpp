@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdlib>
+#include <memory>
+#include <utility>
 
 #include <ibmisc/datetime.hpp>
 #include <ibmisc/VarTransformer.hpp>
@@ -11,6 +13,12 @@
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/VarSet.hpp>
 #include <icebin/multivec.hpp>
+#include <icebin/compact_matrix.hpp>
+#include <icebin/smoother.hpp>
+#include <icebin/product_cache.hpp>
+#ifdef USE_CUDA
+#include <icebin/gpu_spmv.hpp>
+#endif
 
 namespace ibmisc {
     class NcIO;
@@ -22,6 +30,38 @@ class GCMCoupler;
 class GCMInput;    // formerly GCMCouplerOutput
 class IceWriter;
 
+/** Memo of one VarTransformer's apply_scalars(scalars, 'T'), which
+IceCoupler needs for every coupling step.  The VarTransformers are
+fixed once the contract is set up, and the scalars (by_dt) seldom
+change; so the transform is rebuilt only when they do. */
+class VarTransMemo {
+public:
+    typedef decltype(std::declval<ibmisc::VarTransformer &>().apply_scalars(
+        std::declval<std::vector<std::pair<std::string, double>> const &>(), 'T'))
+        TransT;
+private:
+    std::vector<std::pair<std::string, double>> scalars;
+    std::unique_ptr<TransT> trans;
+public:
+    long nbuild = 0;    // Number of times apply_scalars() was called
+
+    /** @return vt.apply_scalars(_scalars, 'T'), from last time if the
+        scalars are the same. */
+    TransT const &operator()(ibmisc::VarTransformer &vt,
+        std::vector<std::pair<std::string, double>> const &_scalars)
+    {
+        if (!trans || _scalars != scalars) {
+            trans.reset(new TransT(vt.apply_scalars(_scalars, 'T')));
+            scalars = _scalars;
+            ++nbuild;
+        }
+        return *trans;
+    }
+
+    /** Forget the memoized transform (eg if vt changed) */
+    void clear() { trans.reset(); }
+};
+
 class IceCoupler {
     friend class IceWriter;
 
@@ -47,6 +87,60 @@ public:
 
     /** Smoothing to use when regridding.  See RegridMatrices::Params. */
     std::array<double,3> sigma;
+
+    /** Use the separable form of the smoothing (see
+    RegridParams::separable)?  Set with the optional config attribute
+    <sheet>.info:smooth_separable. */
+    bool smooth_separable = false;
+
+    /** Relative tolerance for the smoothing matrix (see
+    RegridParams::smooth_tol).  Set with the optional config attribute
+    <sheet>.info:smooth_tol. */
+    double smooth_tol = 0;
+
+    /** Memoize regrid matrices across coupling steps?  Set with the
+    optional config attribute <sheet>.info:cache_matrices. */
+    bool cache_matrices = false;
+    RegridMatrixCache matrix_cache;
+
+    /** If set (optional config attribute <sheet>.info:matrix_snapshot),
+    matrix_cache is loaded from this file at startup, and written back
+    to it whenever it gains entries; so a warm start does not rebuild
+    the initial matrices.  With async_logging, the file is written
+    behind on GCMCoupler::log_writer.  Ignored unless cache_matrices. */
+    std::string matrix_snapshot;
+    size_t snapshot_files_hash = 0;    // Fingerprint of the grid file
+    long snapshot_nmiss = 0;           // matrix_cache.nmiss when last saved
+    SmoothingCache smoothing_cache;    // Also enabled by cache_matrices
+    ProductCache product_cache;        // Also enabled by cache_matrices
+    MatrixStatsLog matrix_stats;       // This step's; if GCMCoupler::matrix_stats
+
+    /** Apply IvE0 and AE1vIs on the GPU?  Set with the optional config
+    attribute <sheet>.info:use_gpu; requires USE_CUDA. */
+    bool use_gpu = false;
+#ifdef USE_CUDA
+    // Device copies of IvE0 and AE1vIs, kept between coupling steps
+    std::unique_ptr<GPUMatrix> gpu_IvE0;
+    std::array<std::unique_ptr<GPUMatrix>, GridAE::count> gpu_AE1vI;
+#endif
+
+    /** Reuse the previous coupling step's regridding (GCM inputs, XuE
+    and IvE0) when nothing it depends on has changed: ice_ovalsI
+    (including the elevation masks), hcdefs and the variable conversion
+    scalars, which are kept and compared bitwise; and
+    RegridMatrices_Dynamic::inputs_hash, compared by value.  A hash of
+    all of these rejects most changed steps before the full compare.
+    Set with the optional config attribute <sheet>.info:reuse_regrid.
+    Not used with distributed_regrid, distributed_ice or
+    GCMCoupler::combined_regrid. */
+    bool reuse_regrid = false;
+    size_t regrid_fingerprint = 0;    // Inputs of the last full couple_regrid(); 0 if none
+    // Copies of the inputs of the last full couple_regrid(), for reuse_regrid
+    size_t prev_rm_inputs_hash = 0;
+    blitz::Array<double,2> prev_ice_ovalsI;
+    std::vector<double> prev_hcdefs;
+    std::vector<double> prev_scalars;
+    std::vector<VectorMultivec> prev_gcm_ivalss_s;    // This sheet's part of gcm_ivalss_s, then
 public:
     GCMCoupler const *gcm_coupler;      // parent back-pointer
     IceRegridder const *ice_regridder;   // Set from gcm_coupler.
@@ -57,7 +151,8 @@ public:
 
     // Densified regridding matrix, and dimension, from previous call
     // Used to interpret GCM output
-    std::unique_ptr<EigenSparseMatrixT> IvE0;   // SCALED
+    // (stored as per GCMCoupler::matrix_precision)
+    std::unique_ptr<CompactSparseMatrix> IvE0;   // SCALED
     std::unique_ptr<SparseSetT> dimE0;
 
     // Output of ice model from the last time we coupled.
@@ -66,6 +161,19 @@ public:
     // TODO: Only keep variables we need here, instead of all of ice_ovalsI
     blitz::Array<double,2> ice_ovalsI;
 
+    // For GCMCoupler::distributed_ice: the ice grid cells (dense I
+    // index) owned by this MPI rank, and this rank's part of the ice
+    // model output, local_ovalsI(nvar, local_iI.size()).  Set by ice
+    // models with a distributed state (eg PISM); local_iI must not
+    // change once coupling has started.
+    std::vector<long> local_iI;
+    blitz::Array<double,2> local_ovalsI;
+
+    // Rank and local_iI position of each ice grid cell (root only);
+    // gathered on the first call to couple_local()
+    bool have_rank_of_I = false;
+    std::vector<int> rank_of_I, local_of_I;
+
     // [INPUT|OUTPUT] variables
     // List of fields this dynamic ice model takes for input / output.
     std::array<VarSet, IO::count> contract;
@@ -82,6 +190,10 @@ public:
     ibmisc::VarTransformer var_trans_inE;
     std::array<ibmisc::VarTransformer, GridAE::count> var_trans_outAE;
 
+    // apply_scalars(scalars, 'T') of var_trans_inE and var_trans_outAE
+    VarTransMemo var_trans_inE_T;
+    std::array<VarTransMemo, GridAE::count> var_trans_outAE_T;
+
     // Writers called to record the input and output seen by this IceCoupler
     std::array<std::unique_ptr<IceWriter>, 2> writer;
 
@@ -92,6 +204,11 @@ public:
     AbbrGrid const &agridI() { return ice_regridder->agridI; }
     long nI() const { return ice_regridder->agridI.dim.sparse_extent(); }
 
+    /** True if ice_ovalsI holds every output field on root.  With
+    GCMCoupler::distributed_ice (and no IceBin logging), only fields
+    flagged contracts::ROOT are gathered there. */
+    bool full_ovalsI() const;
+
     // ======================================================
 
     virtual ~IceCoupler();
@@ -155,18 +272,51 @@ protected:
     blitz::Array<double,2> construct_ice_ivalsI(
         blitz::Array<double,2> const &gcm_ovalsE0,
         std::vector<std::pair<std::string, double>> const &scalars,
-        double dt,
-        ibmisc::TmpAlloc &tmp);
+        double dt);
+
+    /** Per-step temporaries of couple(), kept from one coupling step
+    to the next.  They are resized (not reallocated) if the sizes
+    stay the same, so steady-state coupling does few heap allocations. */
+    struct Workspace {
+        SparseSetT dimI;    // Identity on I; set on first use
+        SparseSetT dimX;    // Identity on X; set on first use
+        blitz::Array<double,2> gcm_ovalsE;    // Densified GCM output
+        blitz::Array<double,2> ice_ivalsI;    // Ice input, when not computed
+        EigenDenseMatrixT ice_ivalsI_e;       // construct_ice_ivalsI() result
+        std::vector<long> rows_s;             // Sparse index of each row of AE1vI
+        std::vector<double> wMs;              // Weight of each row of AE1vI
+    } workspace;
 
 public:
     /** A "virtual function" used to customize construct_ice_ivalsI().
     This defaults to NOP, and is set by the coupling contract. */
     std::function<void(blitz::Array<double,2> &, double)> reconstruct_ice_ivalsI;
 
+    /** One sheet's block of GCMCoupler's combined regrid (see
+    GCMCoupler::combined_regrid): this sheet's contribution to
+    gcm_ivalss_s[iAE] is M * Y, with weights wM. */
+    struct RegridBlock {
+        std::unique_ptr<EigenSparseMatrixT> M;    // [nX1 x nI] Unscaled AvI or EvI
+        std::vector<long> rows_s;    // Sparse (A or E) index of each row of M
+        std::vector<double> wM;      // Weight of each row of M
+        EigenDenseMatrixT Y;         // [nI x nvar] Ice outputs, converted to GCM inputs
+    };
+
     struct CoupleOut {
         /** X=exchange grid; E=elevation grid; XuE used to compute E1vE0 */
         std::unique_ptr<ibmisc::linear::Weighted_Eigen> XuE;    // UNSCALED
         SparseSetT *dimE;   // Used to interpret XuE
+
+        /** If GCMCoupler::combined_regrid, this sheet's GCM inputs
+        (by IndexAE), for GCMCoupler to apply; nothing is added to
+        gcm_ivalss_s. */
+        std::vector<RegridBlock> blocks;
+
+        /** Set if the previous step's regrid was reused (see
+        reuse_regrid).  XuE is then null: it is the same as last time. */
+        bool reused = false;
+        /** Fingerprint of the inputs to this regrid; 0 if not reuse_regrid */
+        size_t fingerprint = 0;
     };
 
     /** (4) Run the ice model for one coupling timestep.
@@ -183,6 +333,49 @@ public:
         // ------- Flags
         bool run_ice);
 
+    /** (4a) First half of couple(): construct the ice model inputs
+    and run the ice model.  Leaves ice_ovalsI, emI_ice and emI_land set. */
+    void couple_ice(
+        std::array<double,2> timespan,
+        VectorMultivec const &gcm_ovalsE_s,
+        bool run_ice);
+
+    /** (4b) Second half of couple(): regrid matrices for the new ice
+    state, and GCM inputs from ice_ovalsI.  Uses no MPI unless
+    GCMCoupler::distributed_regrid or distributed_ice, so it may run concurrently for
+    different ice sheets (see GCMCoupler::concurrent_sheets). */
+    CoupleOut couple_regrid(
+        std::array<double,2> timespan,
+        std::vector<VectorMultivec> &gcm_ivalss_s);
+
+protected:
+    /** (4.2) GCMCoupler::distributed_regrid part of couple(), run on
+    all ranks: root sends each rank the ice output and its own rows
+    of the A and E grid matrices; each rank then appends its part of
+    gcm_ivalsX to gcm_ivalss_s.
+    @param AE1vIs Unscaled AvI and EvI, indexed by IndexAE (root only) */
+    void couple_distributed(
+        std::vector<ibmisc::linear::Weighted_Eigen *> const &AE1vIs,
+        std::vector<std::pair<std::string, double>> const &scalars,
+        std::vector<VectorMultivec> &gcm_ivalss_s);
+
+    /** (4.2) GCMCoupler::distributed_ice part of couple(), run on all
+    ranks: root sends each rank the columns of the A and E grid
+    matrices for the ice grid cells it owns (local_iI); each rank
+    applies them to local_ovalsI, and the (GCM-grid-sized) partial
+    sums are reduced onto root's gcm_ivalss_s.
+    @param AE1vIs Unscaled AvI and EvI, indexed by IndexAE (root only) */
+    void couple_local(
+        std::vector<ibmisc::linear::Weighted_Eigen *> const &AE1vIs,
+        std::vector<std::pair<std::string, double>> const &scalars,
+        std::vector<VectorMultivec> &gcm_ivalss_s);
+
+    /** Waits for GCMCoupler::log_writer, if any, to finish; called
+    before the ice model runs, since it may do NetCDF I/O of its own
+    (which netcdf_mutex does not cover). */
+    void flush_log_writer();
+public:
+
     /** (4.1) @param index Index of each grid value.
     @param time_s Time since start of simulation, in seconds
     @param do_run True if we are to actually run (otherwise just return ice_ovalsI from current state) */
@@ -225,10 +418,14 @@ public:
         VarSet const *_contract,
         std::string const &_fname);
 
+    /** Writes on GCMCoupler::log_writer, if there is one (valsI is
+    copied first). */
     void write(double time_s,
         blitz::Array<double,2> const &valsI);    // valsI[nI, nvars]
 
 private:
+    void _write(double time_s,
+        blitz::Array<double,2> const &valsI);
     void init_file();
 
 };
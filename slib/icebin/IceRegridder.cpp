@@ -1,9 +1,13 @@
 #include <cstdio>
+#include <algorithm>
 #include <iostream>
 #include <functional>
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/IceRegridder_L0.hpp>
+#include <icebin/IceRegridder_L1.hpp>
 #include <icebin/Grid.hpp>
+#include <icebin/parallel.hpp>
+#include <icebin/profile.hpp>
 #include <spsparse/netcdf.hpp>
 
 using namespace std;
@@ -40,7 +44,8 @@ IceRegridder::~IceRegridder() {}
 NOTE: wAvAp == sApvA */
 void IceRegridder::sApvA(MakeDenseEigenT::AccumT &&w) const
 {
-printf("BEGIN sApvA(%d)\n", gcm->agridA->dim.dense_extent());
+    ICEBIN_PROFILE_SCOPE("IceRegridder::sApvA");
+    ICEBIN_PROFILE_NNZ(gcm->agridA->dim.dense_extent());
     for (int id=0; id < gcm->agridA->dim.dense_extent(); ++id) {
         auto index = gcm->agridA->dim.to_sparse(id);
         w.add({index, index}, gcm->agridA->native_area(id) / gridA_proj_area(id));
@@ -51,17 +56,17 @@ printf("BEGIN sApvA(%d)\n", gcm->agridA->dim.dense_extent());
 NOTE: wAvAp == sApvA */
 void IceRegridder::sEpvE(MakeDenseEigenT::AccumT &&w) const
 {
-    for (int id=0; id < gcm->agridA->dim.dense_extent(); ++id) {
+    ICEBIN_PROFILE_SCOPE("IceRegridder::sEpvE");
+    long const nnz = parallel_accum(gcm->agridA->dim.dense_extent(), w, [&](int id, UrSink &sink) {
         auto index = gcm->agridA->dim.to_sparse(id);
 
         long nhc = gcm->nhc(index);
-        long tuple[2] = {index, 0};
-        long &ihp(tuple[1]);
-        for (ihp=0; ihp<nhc; ++ihp) {
-            long indexE = gcm->indexingHC.tuple_to_index(tuple);
-            w.add({indexE, indexE}, gcm->agridA->native_area(id) / gridA_proj_area(id));
+        for (long ihp=0; ihp<nhc; ++ihp) {
+            long indexE = gcm->fast_indexingHC.tuple_to_index({index, ihp});
+            sink.add({indexE, indexE}, gcm->agridA->native_area(id) / gridA_proj_area(id));
         }
-    }
+    });
+    ICEBIN_PROFILE_NNZ(nnz);
 }
 // -------------------------------------------------------------
 #if 0
@@ -74,11 +79,6 @@ void IceRegridder::clear()
 // -------------------------------------------------------------
 void IceRegridder::ncio(NcIO &ncio, std::string const &vname)
 {
-    if (ncio.rw == 'r') {
-        agridI.ncio(ncio, vname + ".agridI");
-        aexgrid.ncio(ncio, vname + ".aexgrid");
-    }
-
     auto info_v = get_or_add_var(ncio, vname + ".info", "int", {});
     get_or_put_att(info_v, ncio.rw, "name", _name);
     get_or_put_att_enum(info_v, ncio.rw, "interp_style", interp_style);
@@ -86,8 +86,22 @@ void IceRegridder::ncio(NcIO &ncio, std::string const &vname)
     ncio_blitz_alloc(ncio, gridA_proj_area, vname + ".gridA_proj_area", "double",
         get_or_add_dims(ncio, gridA_proj_area, {"agridA.ndata"}));
     agridI.ncio(ncio, vname + ".agridI");
-    aexgrid.ncio(ncio, vname + ".aexgrid");
+    if (ncio.rw == 'r' && _load_keepA) {
+        std::vector<bool> const &keepA(*_load_keepA);
+        aexgrid.ncio_read(ncio, vname + ".aexgrid",
+            [&keepA](long iA) { return iA < (long)keepA.size() && keepA[iA]; });
+    } else {
+        aexgrid.ncio(ncio, vname + ".aexgrid");
+    }
 
+    // OPTIONAL: Sort the exchange grid by (iA, iI) and index it
+    if (ncio.rw == 'r') {
+        auto atts(info_v.getAtts());
+        bool sort_exgrid = false;
+        if (atts.find("sort_exgrid") != atts.end())
+            get_or_put_att(info_v, 'r', "sort_exgrid", &sort_exgrid, 1);
+        if (sort_exgrid) aexgrid.sort_index();
+    }
 }
 
 void IceRegridder::init(
@@ -105,7 +119,8 @@ void IceRegridder::init(
 
     if (agridI.sproj == "") {
         // No projection; projected and unproject area are the same
-        gridA_proj_area.reference(agridA.native_area);
+        // (Copy: native_area may be shared, or mapped from a bingrid file)
+        gridA_proj_area.reference(agridA.native_area().copy());
     } else {
         // Use a projection
         gridA_proj_area.reference(blitz::Array<double,1>(agridA.dim.dense_extent()));
@@ -124,6 +139,9 @@ std::unique_ptr<IceRegridder> new_ice_regridder(IceRegridder::Type type)
         case IceRegridder::Type::L0 :
             return std::unique_ptr<IceRegridder>(new IceRegridder_L0);
         break;
+        case IceRegridder::Type::L1 :
+            return std::unique_ptr<IceRegridder>(new IceRegridder_L1);
+        break;
         default :
             (*icebin_error)(-1,
                 "Unknown IceRegridder::Type %s", type.str());
@@ -141,33 +159,85 @@ std::unique_ptr<IceRegridder> new_ice_regridder(NcIO &ncio, std::string const &v
 }
 
 // ---------------------------------------------------------------------
-/** Made for binding... */
-static bool in_good(std::unordered_set<long> const *set, long index_c)
-{
-    return (set->find(index_c) != set->end());
-}
+/** A set of (sparse) indices, used to filter cells.  Stored as a
+bit-vector if the index space is not much bigger than the set (the
+usual case); otherwise as a sorted vector. */
+class IndexFilter {
+    bool const dense;
+    std::vector<bool> bits;
+    std::vector<long> sorted;
+public:
+    /** @param extent Size of the index space; <0 if not known
+    @param n Approximate number of indices to be inserted */
+    IndexFilter(long extent, long n)
+        : dense(extent >= 0 && extent <= 64*std::max(n,1L))    // 1 bit vs. 64 bits per index
+    {
+        if (dense) bits.resize(extent, false);
+        else sorted.reserve(n);
+    }
+
+    void insert(long ix)
+    {
+        if (!dense) sorted.push_back(ix);
+        else {
+            if (ix >= (long)bits.size()) bits.resize(ix+1, false);
+            bits[ix] = true;
+        }
+    }
+
+    /** Call after the last insert() */
+    void finish()
+    {
+        if (dense) return;
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    }
+
+    bool operator()(long ix) const
+    {
+        return dense ? (ix < (long)bits.size() && bits[ix])
+            : std::binary_search(sorted.begin(), sorted.end(), ix);
+    }
+};
 
 void IceRegridder::filter_cellsA(std::function<bool (long)> const &useA)
 {
+    // Evaluate useA once per gridA cell, not once per exchange cell
+    long nA = 0;
+    for (int id=0; id<aexgrid.dense_extent(); ++id)
+        nA = std::max(nA, (long)aexgrid.ijk(id,0)+1);
 
-  // Figure out which cells to keep
+    std::vector<bool> keepA(nA, false);
+    std::vector<bool> known(nA, false);
+    for (int id=0; id<aexgrid.dense_extent(); ++id) {
+        long const iA = aexgrid.ijk(id,0);
+        if (!known[iA]) {
+            known[iA] = true;
+            keepA[iA] = useA(iA);
+        }
+    }
 
-    // List of cells in gridI / exgrid that overlap a cell we want to keep
-    std::unordered_set<long> good_index_gridI;
-    std::unordered_set<long> good_index_exgrid;
+    filter_cellsA(keepA);
+}
 
+void IceRegridder::filter_cellsA(std::vector<bool> const &keepA)
+{
+    auto const useA = [&keepA](long iA)
+        { return iA < (long)keepA.size() && keepA[iA]; };
+
+  // Figure out which cells to keep
 
-    std::unordered_set<int> good_j;
+    // List of cells in gridI that overlap a cell we want to keep
+    IndexFilter good_index_gridI(agridI.dim.sparse_extent(), agridI.dim.dense_extent());
     for (int id=0; id<aexgrid.dense_extent(); ++id) {
-        auto const is = aexgrid.to_sparse(id);
-        if (useA(is)) {
+        if (useA(aexgrid.ijk(id,0))) {
             good_index_gridI.insert(aexgrid.ijk(id,1));    // j
-            good_index_exgrid.insert(is);
         }
     }
+    good_index_gridI.finish();
 
     // Remove unneeded cells from gridI
-    agridI.filter_cells(std::bind(&in_good, &good_index_gridI, _1));
+    agridI.filter_cells(std::cref(good_index_gridI));
 
     /** NOTE: This will result in ExchangeGrid cells being renumbered,
     resulting in different numbering schemes for different processors.
@@ -19,18 +19,22 @@
 #ifndef ICEBIN_ICEREGRIDDER_H
 #define ICEBIN_ICEREGRIDDER_H
 
+#include <mutex>
+#include <functional>
 #include <unordered_set>
 #include <ibmisc/netcdf.hpp>
 
 #include <icebin/AbbrGrid.hpp>
 #include <icebin/eigen_types.hpp>
 #include <icebin/RegridMatrices.hpp>
+#include <icebin/parallel.hpp>
 
 namespace icebin {
 
 class GCMRegridder_Standard;
 class IceCoupler;
 class IceWriter;    // Adjoint to IceCoupler
+class CoarseIceRegridder;
 
 /** Controls how we interpolate from elevation class space to the ice grid */
 BOOST_ENUM_VALUES( InterpStyle, int,
@@ -52,6 +56,7 @@ class IceRegridder {
     friend class IceCoupler;
     friend class GCMRegridder_Standard;
     friend class IceWriter;
+    friend class CoarseIceRegridder;
 public:
     typedef GridParameterization Type;
 
@@ -65,6 +70,15 @@ protected:
     Type type;          /// GridParameterization
     std::string _name;  /// "greenland", "antarctica", etc.
 
+    /** Set by GCMRegridder_Standard::ncio() to read the rest of this
+    IceRegridder when it is first used (see load()). */
+    std::function<void(IceRegridder &)> _loader;
+    std::once_flag _loaded;
+
+    /** If set when _loader runs, only the exchange cells of these
+    gridA cells are read (see GCMRegridder_Standard::filter_cellsA()) */
+    std::vector<bool> const *_load_keepA = nullptr;
+
 public:
     AbbrGrid agridI;            /// Ice grid outlines
     ExchangeGrid aexgrid;       /// Exchange grid overlaps (between GCM and Ice)
@@ -76,9 +90,23 @@ public:
     /** Remove unnecessary GCM grid cells. */
     void filter_cellsA(std::function<bool(long)> const &keepA);
 
+    /** Same, with the GCM grid cells to keep as a bit-vector over
+    (sparse) gridA indices; indices past its end are not kept. */
+    virtual void filter_cellsA(std::vector<bool> const &keepA);
+
 public:
     std::string const &name() const { return _name; }
 
+    /** Finishes reading this IceRegridder, if GCMRegridder_Standard::ncio()
+    deferred that; safe to call from several threads at once.
+    Normally called via GCMRegridder::ice_regridder().
+    @return this */
+    IceRegridder *load()
+    {
+        std::call_once(_loaded, [this]() { if (_loader) _loader(*this); });
+        return this;
+    }
+
     IceRegridder();
     virtual ~IceRegridder();
 
@@ -90,6 +118,12 @@ public:
         ExchangeGrid const &&_aexgrid,
         InterpStyle _interp_style);
 
+    /** Called after init() with the full grids that agridI and
+    aexgrid were made from, for parameterizations that need more of
+    their geometry than AbbrGrid and ExchangeGrid keep (see
+    IceRegridder_L1).  L0 needs nothing more. */
+    virtual void init_mesh(Grid const &fgridI, Grid const &fexgrid) {}
+
     // ------------------------------------------------
     /** Number of dimensions of ice grid */
     virtual size_t nI() const = 0;
@@ -132,6 +166,22 @@ public:
         char gridG,
         blitz::Array<double,1> const *elevmaskI) const = 0;
 
+    /** Produces the unscaled matrix [Projected Elevation] <-- [Projected Atmosphere],
+    equal to EpvG * diag(1/sum(GvAp)) * GvAp (G = exchange grid).  Each
+    exchange grid cell lies in one A cell, and contributes to at most
+    two E cells (see GvEp()); so this is formed in one pass over the
+    exchange grid, without the G matrices. */
+    virtual void EpvAp(MakeDenseEigenT::AccumT &&ret,
+        blitz::Array<double,1> const *elevmaskI) const = 0;
+
+    /** Streams the (unscaled) elements of GvAp (AE='A') or GvEp
+    (AE='E') to a visitor, without ever storing the matrix.  Used for
+    matrix-free application of regrid matrices.
+    @param gridG 'I' or 'X' */
+    virtual void visit_GvAE(UrVisitor const &visitor,
+        char AE, char gridG,
+        blitz::Array<double,1> const *elevmaskI) const = 0;
+
     /** Define, read or write this data structure inside a NetCDF file.
     @param vname: Variable name (or prefix) to define/read/write it under. */
     virtual void ncio(ibmisc::NcIO &ncio, std::string const &vname);
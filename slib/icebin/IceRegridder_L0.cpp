@@ -17,8 +17,12 @@
  */
 
 #include <cstdio>
+#include <cstring>
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/IceRegridder_L0.hpp>
+#include <icebin/hclookup.hpp>
+#include <icebin/parallel.hpp>
+#include <icebin/profile.hpp>
 
 using namespace ibmisc;
 
@@ -40,8 +44,9 @@ size_t IceRegridder_L0::nG(char gridG) const
 /** Does elevation-class-style interpolation on height points.  Assumes
 elevation class boundaries midway between height points.
 @return Index of point in xpoints[] array that is closes to xx. */
-static int nearest_1d(
+extern int nearest_1d(
     std::vector<double> const &xpoints,
+    HCLookup const &hcl,    // Lookup on xpoints
     double xx)
 {
     int n = xpoints.size();
@@ -49,7 +54,7 @@ static int nearest_1d(
     // This is the point ABOVE our value.
     // (i0 = i1 - 1, xpoints[i0] < xx <= xpoints[i1])
     // See: http://www.cplusplus.com/reference/algorithm/lower_bound/
-    int i1 = lower_bound(xpoints.begin(), xpoints.end(), xx) - xpoints.begin();
+    int i1 = hcl.lower_bound(xx);
 
     // Convert to point NEAREST ot ours
     if (i1 <= 0) return 0;
@@ -70,6 +75,7 @@ static int nearest_1d(
 // --------------------------------------------------------
 extern void linterp_1d_b(
     std::vector<double> const &xpoints,
+    HCLookup const &hcl,    // Lookup on xpoints
     double xx,
     long *indices, double *weights)  // Size-2 arrays
 {
@@ -78,7 +84,7 @@ extern void linterp_1d_b(
     // This is the point ABOVE our value.
     // (i0 = i1 - 1, xpoints[i0] < xx <= xpoints[i1])
     // See: http://www.cplusplus.com/reference/algorithm/lower_bound/
-    int i1 = lower_bound(xpoints.begin(), xpoints.end(), xx) - xpoints.begin();
+    int i1 = hcl.lower_bound(xx);
 
     if (i1 <= 0) i1 = 1;
     if (i1 >= n) (*icebin_error)(-1,
@@ -95,6 +101,79 @@ extern void linterp_1d_b(
 
 
 
+template<int STYLE>
+inline void IceRegridder_L0::GvEp_cell(int id, double elevmaskI_iI,
+    HCLookup const &hcl, long *iEs, double *vals) const
+{
+    iEs[0] = -1;
+    iEs[1] = -1;
+
+    // This cell masked out: no entries
+    if (std::isnan(elevmaskI_iI)) return;
+
+    long const iA = aexgrid.ijk(id,0);        // GCM Atmosphere grid
+    double const elevation = std::max(elevmaskI_iI, 0.0);
+    double const area = aexgrid.native_area(id);
+
+    // Interpolate in height points
+    if (STYLE == InterpStyle::Z_INTERP) {
+        long ihps[2];
+        double whps[2];
+        linterp_1d_b(gcm->hcdefs(), hcl, elevation, ihps, whps);
+
+        for (int k=0; k<2; ++k) {
+            iEs[k] = (whps[k] != 0 ?
+                gcm->fast_indexingHC.tuple_to_index({iA, ihps[k]}) : -1);
+            vals[k] = area * whps[k];
+        }
+    } else {    // ELEV_CLASS_INTERP
+        int ihps0 = nearest_1d(gcm->hcdefs(), hcl, elevation);
+        iEs[0] = gcm->fast_indexingHC.tuple_to_index({iA, ihps0});
+        vals[0] = area;
+    }
+}
+
+template<int STYLE, bool GRID_I>
+long IceRegridder_L0::GvEp_loop(
+    MakeDenseEigenT::AccumT &ret,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl,
+    bool use_cache, long &nchanged) const
+{
+    auto &cache(_GvEp_cache);
+    return parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        long const iI = aexgrid.ijk(id,1);        // Ice Grid
+        long const iG = (GRID_I ? iI : aexgrid.to_sparse(id));   // G=Interpolation Grid
+
+        long _iEs[2];
+        double _vals[2];
+        long *iEs = _iEs;
+        double *vals = _vals;
+        if (incremental_GvEp) {
+            iEs = &cache.iEs[id*2];
+            vals = &cache.vals[id*2];
+
+            // Re-use entries if the elevation of this ice cell is unchanged
+            // (Bitwise compare, so NaN == NaN)
+            double const em0 = use_cache ? cache.elevmaskI(iI) : 0.;
+            double const em1 = elevmaskI(iI);
+            if (!use_cache || memcmp(&em0, &em1, sizeof(double)) != 0) {
+                GvEp_cell<STYLE>(id, em1, hcl, iEs, vals);
+#ifdef USE_OPENMP
+                #pragma omp atomic
+#endif
+                ++nchanged;
+            }
+        } else {
+            GvEp_cell<STYLE>(id, elevmaskI(iI), hcl, iEs, vals);
+        }
+
+        for (int k=0; k<2; ++k) {
+            if (iEs[k] >= 0) sink.add({iG, iEs[k]}, vals[k]);
+        }
+    });
+}
+
 /** Builds an interpolation matrix to go from height points to ice/exchange grid.
 @param ret Put the regrid matrix here. */
 void IceRegridder_L0::GvEp(
@@ -102,56 +181,59 @@ void IceRegridder_L0::GvEp(
     char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'G' (exchange)
     blitz::Array<double,1> const *_elevmaskI) const
 {
-printf("BEGIN IceRegridder_L0::GvEp()\n");
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L0::GvEp");
     blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
 
     if (gcm->hcdefs().size() == 0) (*icebin_error)(-1,
         "IceRegridder_L0::GvEp(): hcdefs is zero-length!");
 
+    // hcdefs may be changed between calls (see GCMRegridder_ModelE);
+    // so analyze them here, once per call.
+    HCLookup const hcl(gcm->hcdefs());
+
+    int const nid = aexgrid.dense_extent();
+    auto &cache(_GvEp_cache);
+    std::unique_lock<std::mutex> cache_lock(_GvEp_mutex, std::defer_lock);
+    if (incremental_GvEp) cache_lock.lock();
+
+    // Previous entries are usable only if they came from the same grid
+    bool const use_cache = incremental_GvEp
+        && (cache.elevmaskI.extent(0) == elevmaskI.extent(0))
+        && (cache.iEs.size() == (size_t)nid*2);
+    if (incremental_GvEp && !use_cache) {
+        cache.iEs.resize(nid*2);
+        cache.vals.resize(nid*2);
+    }
+
     // ---------------------------------------
-    // Handle Z_INTERP or ELEV_CLASS_INTERP
+    // Interpolate in the vertical, with Z_INTERP or ELEV_CLASS_INTERP.
+    // Choose the specialized loop here, not per cell.
+    long nchanged = 0;
+    long nnz = 0;
+    bool const grid_I = (gridG == 'I');
+    switch(interp_style.index()) {
+        case InterpStyle::Z_INTERP :
+            nnz = (grid_I ?
+                GvEp_loop<InterpStyle::Z_INTERP, true>(ret, elevmaskI, hcl, use_cache, nchanged) :
+                GvEp_loop<InterpStyle::Z_INTERP, false>(ret, elevmaskI, hcl, use_cache, nchanged));
+        break;
+        case InterpStyle::ELEV_CLASS_INTERP :
+            nnz = (grid_I ?
+                GvEp_loop<InterpStyle::ELEV_CLASS_INTERP, true>(ret, elevmaskI, hcl, use_cache, nchanged) :
+                GvEp_loop<InterpStyle::ELEV_CLASS_INTERP, false>(ret, elevmaskI, hcl, use_cache, nchanged));
+        break;
+        default :
+            (*icebin_error)(-1, "Illegal interp_style %d", (int)interp_style.index());
+    }
+    ICEBIN_PROFILE_NNZ(nnz);
 
-    // Interpolate in the vertical
-    for (int id=0; id<aexgrid.dense_extent(); ++id) {
-        long const iA = aexgrid.ijk(id,0);        // GCM Atmosphere grid
-        long const iI = aexgrid.ijk(id,1);        // Ice Grid
-        long const iX = aexgrid.to_sparse(id);    // X=Exchange Grid
-        long const iG = (gridG == 'I' ? iI : iX);   // G=Interpolation Grid
-
-        if (!std::isnan(elevmaskI(iI))) {
-            // This cell not masked: look up elevation point as usual
-            double const elevation = std::max(elevmaskI(iI), 0.0);
-
-            // Interpolate in height points
-            switch(interp_style.index()) {
-                case InterpStyle::Z_INTERP :
-                {
-                    long ihps[2];
-                    double whps[2];
-                    linterp_1d_b(gcm->hcdefs(), elevation, ihps, whps);
-
-                    if (whps[0] != 0) {
-                        auto const iE0 = gcm->indexingHC.tuple_to_index<long,2>({iA, ihps[0]});
-                        ret.add({iG, iE0},
-                            aexgrid.native_area(id) * whps[0]);
-                    }
-
-                    if (whps[1] != 0) {
-                        auto const iE1 = gcm->indexingHC.tuple_to_index<long,2>({iA, ihps[1]});
-                        ret.add({iG, iE1},
-                            aexgrid.native_area(id) * whps[1]);
-                    }
-
-                } break;
-                case InterpStyle::ELEV_CLASS_INTERP : {
-                    int ihps0 = nearest_1d(gcm->hcdefs(), elevation);
-                    ret.add({iG, gcm->indexingHC.tuple_to_index<long,2>({iA, ihps0})},
-                        aexgrid.native_area(id));
-                } break;
-            }
-        }
+    if (incremental_GvEp) {
+        // Remember elevmaskI for next time
+        cache.elevmaskI.reference(blitz::Array<double,1>(elevmaskI.copy()));
+        if (profile::verbose) printf(
+            "IceRegridder_L0::GvEp(): recomputed %ld of %d exchange cells\n",
+            nchanged, nid);
     }
-printf("END IceRegridder_L0::GvEp()\n");
 }
 // --------------------------------------------------------
 void IceRegridder_L0::GvI(
@@ -159,6 +241,7 @@ void IceRegridder_L0::GvI(
     char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'X' (exchange)
     blitz::Array<double,1> const *_elevmaskI) const
 {
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L0::GvI");
     blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
     if (gridG == 'I') {
         // Ice <- Ice = Indentity Matrix (scaled)
@@ -175,7 +258,7 @@ void IceRegridder_L0::GvI(
         }
     } else {
         // Exchange <- Ice
-        for (int id=0; id<aexgrid.dense_extent(); ++id) {
+        long const nnz = parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
             // cell->i = index in atmosphere grid
             long const iI = aexgrid.ijk(id,1);        // index in ice grid
             long const iX = aexgrid.to_sparse(id);    // index in exchange grid
@@ -184,33 +267,120 @@ void IceRegridder_L0::GvI(
             // Depending on elevmaskI, this could be either just ice
             // or ice and dry land
             if (!std::isnan(elevmaskI(iI)))
-                ret.add({iX,iI}, aexgrid.native_area(id));
-        }
+                sink.add({iX,iI}, aexgrid.native_area(id));
+        });
+        ICEBIN_PROFILE_NNZ(nnz);
     }
 }
 // --------------------------------------------------------
+void IceRegridder_L0::GvAp_cell(int id, UrSink &sink, char gridG,
+    blitz::Array<double,1> const &elevmaskI) const
+{
+    long const iG = (gridG == 'I' ?
+        aexgrid.ijk(id,1) : aexgrid.to_sparse(id));
+    long const iA = aexgrid.ijk(id,0);
+    long const iI = aexgrid.ijk(id,1);
+
+    // Only include I cells that are NOT masked out
+    // Depending on elevmaskI, this could be either just ice
+    // or ice and dry land
+    if (!std::isnan(elevmaskI(iI)))
+        if (aexgrid.native_area(id) > 0) {
+            sink.add({iG, iA}, aexgrid.native_area(id));
+        }
+}
+
 void IceRegridder_L0::GvAp(
     MakeDenseEigenT::AccumT &&ret,
     char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'X' (exchange)
     blitz::Array<double,1> const *_elevmaskI) const
 {
-printf("BEGIN IceRegridder_L0::GvAp()\n");
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L0::GvAp");
     blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
-    for (int id=0; id<aexgrid.dense_extent(); ++id) {
-        long const iG = (gridG == 'I' ?
-            aexgrid.ijk(id,1) : aexgrid.to_sparse(id));
+    long const nnz = parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        GvAp_cell(id, sink, gridG, elevmaskI);
+    });
+    ICEBIN_PROFILE_NNZ(nnz);
+}
+// --------------------------------------------------------
+template<int STYLE>
+long IceRegridder_L0::EpvAp_loop(
+    MakeDenseEigenT::AccumT &ret,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl) const
+{
+    return parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        // Only exchange cells that are in GvAp (see GvAp_cell()), whose
+        // row of diag(1/sum(GvAp)) * GvAp is then 1 in column iA.
+        // GvEp_cell() skips cells masked out by elevmaskI.
+        if (!(aexgrid.native_area(id) > 0)) return;
         long const iA = aexgrid.ijk(id,0);
         long const iI = aexgrid.ijk(id,1);
 
-        // Only include I cells that are NOT masked out
-        // Depending on elevmaskI, this could be either just ice
-        // or ice and dry land
-        if (!std::isnan(elevmaskI(iI)))
-            if (aexgrid.native_area(id) > 0) {
-                ret.add({iG, iA}, aexgrid.native_area(id));
-            }
+        long iEs[2];
+        double vals[2];
+        GvEp_cell<STYLE>(id, elevmaskI(iI), hcl, iEs, vals);
+        for (int k=0; k<2; ++k) {
+            if (iEs[k] >= 0 && vals[k] != 0) sink.add({iEs[k], iA}, vals[k]);
+        }
+    });
+}
+
+void IceRegridder_L0::EpvAp(
+    MakeDenseEigenT::AccumT &&ret,
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L0::EpvAp");
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+
+    if (gcm->hcdefs().size() == 0) (*icebin_error)(-1,
+        "IceRegridder_L0::EpvAp(): hcdefs is zero-length!");
+    HCLookup const hcl(gcm->hcdefs());
+
+    long nnz = 0;
+    switch(interp_style.index()) {
+        case InterpStyle::Z_INTERP :
+            nnz = EpvAp_loop<InterpStyle::Z_INTERP>(ret, elevmaskI, hcl);
+        break;
+        case InterpStyle::ELEV_CLASS_INTERP :
+            nnz = EpvAp_loop<InterpStyle::ELEV_CLASS_INTERP>(ret, elevmaskI, hcl);
+        break;
+        default :
+            (*icebin_error)(-1, "Illegal interp_style %d", (int)interp_style.index());
+    }
+    ICEBIN_PROFILE_NNZ(nnz);
+}
+// --------------------------------------------------------
+void IceRegridder_L0::visit_GvAE(UrVisitor const &visitor,
+    char AE, char gridG,
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+    UrSink sink(&visitor);
+    HCLookup const hcl(gcm->hcdefs());
+
+    for (int id=0; id<aexgrid.dense_extent(); ++id) {
+        switch(AE) {
+            case 'A' :
+                GvAp_cell(id, sink, gridG, elevmaskI);
+            break;
+            case 'E' : {
+                long const iI = aexgrid.ijk(id,1);
+                long const iG = (gridG == 'I' ? iI : aexgrid.to_sparse(id));
+                long iEs[2];
+                double vals[2];
+                if (interp_style.index() == InterpStyle::Z_INTERP)
+                    GvEp_cell<InterpStyle::Z_INTERP>(id, elevmaskI(iI), hcl, iEs, vals);
+                else
+                    GvEp_cell<InterpStyle::ELEV_CLASS_INTERP>(id, elevmaskI(iI), hcl, iEs, vals);
+                for (int k=0; k<2; ++k) {
+                    if (iEs[k] >= 0) sink.add({iG, iEs[k]}, vals[k]);
+                }
+            } break;
+            default :
+                (*icebin_error)(-1, "Illegal AE='%c'", AE);
+        }
     }
-printf("END IceRegridder_L0::GvAp()\n");
 }
 // --------------------------------------------------------
 void IceRegridder_L0::ncio(NcIO &ncio, std::string const &vname)
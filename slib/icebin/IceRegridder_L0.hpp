@@ -18,10 +18,13 @@
 
 #pragma once
 
+#include <mutex>
 #include <icebin/GCMRegridder.hpp>
 
 namespace icebin {
 
+class HCLookup;
+
 class IceRegridder_L0 : public IceRegridder
 {       // For ice model with level-value grid cells
 public:
@@ -37,6 +40,53 @@ public:
     @param gridG Either 'I' or 'X' */
     size_t nG(char gridG) const;
 
+    /** If set, GvEp() remembers the entries it produced for each
+    exchange grid cell, and on the next call recomputes only cells
+    whose value of elevmaskI has changed.  Costs two (index, value)
+    pairs per exchange grid cell. */
+    bool incremental_GvEp = false;
+
+protected:
+    /** GvEp() entries from the previous call, by exchange grid cell
+    (dense indexing).  Used if incremental_GvEp. */
+    struct GvEpCache {
+        blitz::Array<double,1> elevmaskI;    // elevmaskI of the previous call
+        std::vector<long> iEs;       // [nX*2] Column of each entry; -1 if none
+        std::vector<double> vals;    // [nX*2] Value of each entry
+    };
+    mutable GvEpCache _GvEp_cache;
+    mutable std::mutex _GvEp_mutex;    // Held while _GvEp_cache is in use
+
+    /** Computes the (up to two) GvEp entries for exchange grid cell id.
+    @tparam STYLE interp_style
+    @param hcl Lookup on gcm->hcdefs()
+    @param iEs OUT: Elevation grid index of each entry; -1 if none.
+    @param vals OUT: Value of each entry. */
+    template<int STYLE>
+    void GvEp_cell(int id, double elevmaskI_iI,
+        HCLookup const &hcl, long *iEs, double *vals) const;
+
+    /** Body of GvEp(), specialized on interp_style and gridG.
+    @tparam GRID_I True if gridG == 'I'
+    @param nchanged OUT: Incremented for each cell recomputed
+    @return Number of elements added to ret */
+    template<int STYLE, bool GRID_I>
+    long GvEp_loop(MakeDenseEigenT::AccumT &ret,
+        blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl,
+        bool use_cache, long &nchanged) const;
+
+    /** Body of EpvAp(), specialized on interp_style.
+    @return Number of elements added to ret */
+    template<int STYLE>
+    long EpvAp_loop(MakeDenseEigenT::AccumT &ret,
+        blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl) const;
+
+    /** Computes the GvAp entry for exchange grid cell id */
+    void GvAp_cell(int id, UrSink &sink, char gridG,
+        blitz::Array<double,1> const &elevmaskI) const;
+
 public:
     // Implementations of virtual functions
     void GvEp(MakeDenseEigenT::AccumT &&ret,
@@ -48,6 +98,11 @@ public:
     void GvAp(MakeDenseEigenT::AccumT &&ret,
         char gridG,    // Identity of G: 'I' (ice) or 'X' (exchange)
         blitz::Array<double,1> const *elevmaskI) const;
+    void EpvAp(MakeDenseEigenT::AccumT &&ret,
+        blitz::Array<double,1> const *elevmaskI) const;
+    void visit_GvAE(UrVisitor const &visitor,
+        char AE, char gridG,
+        blitz::Array<double,1> const *elevmaskI) const;
     void ncio(ibmisc::NcIO &ncio, std::string const &vname);
 };
 
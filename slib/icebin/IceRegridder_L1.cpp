@@ -0,0 +1,425 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <icebin/Grid.hpp>
+#include <icebin/GCMRegridder.hpp>
+#include <icebin/IceRegridder_L1.hpp>
+#include <icebin/hclookup.hpp>
+#include <icebin/parallel.hpp>
+#include <icebin/profile.hpp>
+
+using namespace ibmisc;
+
+namespace icebin {
+
+// Defined in IceRegridder_L0.cpp
+extern int nearest_1d(
+    std::vector<double> const &xpoints,
+    HCLookup const &hcl,
+    double xx);
+extern void linterp_1d_b(
+    std::vector<double> const &xpoints,
+    HCLookup const &hcl,
+    double xx,
+    long *indices, double *weights);
+
+size_t IceRegridder_L1::nG(char gridG) const
+{
+    switch(gridG) {
+        case 'I' : return nI();
+        case 'X' : return nX();
+        default : (*icebin_error)(-1, "Illegal gridG='%c'", gridG);
+     }
+}
+// --------------------------------------------------------
+/** @return Position of (iA, iElement) in sorted Quadrature::keys; -1 if none */
+static long find_key(std::vector<int> const &keys, int iA, int iElement)
+{
+    std::pair<int,int> const key(iA, iElement);
+    long lo = 0;
+    long hi = keys.size() / 2;
+    while (lo < hi) {
+        long const mid = (lo + hi) / 2;
+        if (std::make_pair(keys[mid*2], keys[mid*2+1]) < key) lo = mid+1;
+        else hi = mid;
+    }
+    if (lo < (long)keys.size()/2 && keys[lo*2] == iA && keys[lo*2+1] == iElement)
+        return lo;
+    return -1;
+}
+
+void IceRegridder_L1::set_quadrature(Quadrature const &quad)
+{
+    int const nid = aexgrid.dense_extent();
+    xvertices.resize(nid*3);
+    xweights.resize(nid*3);
+    for (int id=0; id<nid; ++id) {
+        long const k = find_key(quad.keys, aexgrid.ijk(id,0), aexgrid.ijk(id,1));
+        if (k < 0) (*icebin_error)(-1,
+            "IceRegridder_L1(%s): No quadrature for exchange grid cell (%d, %d)",
+            name().c_str(), aexgrid.ijk(id,0), aexgrid.ijk(id,1));
+        for (int v=0; v<3; ++v) {
+            xvertices[id*3+v] = quad.vertices[k*3+v];
+            xweights[id*3+v] = quad.weights[k*3+v];
+        }
+    }
+}
+
+IceRegridder_L1::Quadrature IceRegridder_L1::quadrature() const
+{
+    int const nid = aexgrid.dense_extent();
+    std::vector<int> perm(nid);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::sort(perm.begin(), perm.end(), [this](int a, int b) {
+        return std::make_pair(aexgrid.ijk(a,0), aexgrid.ijk(a,1))
+            < std::make_pair(aexgrid.ijk(b,0), aexgrid.ijk(b,1)); });
+
+    Quadrature quad;
+    quad.keys.reserve(nid*2);
+    quad.vertices.reserve(nid*3);
+    quad.weights.reserve(nid*3);
+    for (int id : perm) {
+        quad.keys.push_back(aexgrid.ijk(id,0));
+        quad.keys.push_back(aexgrid.ijk(id,1));
+        for (int v=0; v<3; ++v) {
+            quad.vertices.push_back(xvertices[id*3+v]);
+            quad.weights.push_back(xweights[id*3+v]);
+        }
+    }
+    return quad;
+}
+// --------------------------------------------------------
+void IceRegridder_L1::init_mesh(Grid const &fgridI, Grid const &fexgrid)
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L1::init_mesh");
+    if (fgridI.parameterization != GridParameterization::L1) (*icebin_error)(-1,
+        "IceRegridder_L1(%s): Ice grid must be L1", name().c_str());
+
+    // Exchange cells in order of (iA, iElement)
+    std::vector<Cell const *> cellsX;
+    cellsX.reserve(fexgrid.cells.nrealized());
+    for (auto cellX=fexgrid.cells.begin(); cellX != fexgrid.cells.end(); ++cellX)
+        cellsX.push_back(&*cellX);
+    std::sort(cellsX.begin(), cellsX.end(), [](Cell const *a, Cell const *b)
+        { return std::make_pair(a->i, a->j) < std::make_pair(b->i, b->j); });
+
+    Quadrature quad;
+    quad.keys.reserve(cellsX.size()*2);
+    quad.vertices.reserve(cellsX.size()*3);
+    quad.weights.reserve(cellsX.size()*3);
+    for (Cell const *cellX : cellsX) {
+        size_t const n = quad.keys.size() / 2;
+        if (n > 0 && quad.keys[n*2-2] == cellX->i && quad.keys[n*2-1] == cellX->j)
+            (*icebin_error)(-1,
+                "IceRegridder_L1(%s): More than one exchange grid cell for (%d, %d)",
+                name().c_str(), cellX->i, cellX->j);
+
+        Cell const *element = fgridI.cells.at(cellX->j);
+        if (element->size() != 3) (*icebin_error)(-1,
+            "IceRegridder_L1(%s): Element %ld has %d vertices; must be a triangle",
+            name().c_str(), element->index, (int)element->size());
+        Vertex const *p[3];
+        for (int v=0; v<3; ++v) p[v] = &*element->begin(v);
+
+        // Basis functions at the centroid are its barycentric coordinates
+        Point const ctr(cellX->centroid());
+        double const det = (p[1]->x - p[0]->x) * (p[2]->y - p[0]->y)
+            - (p[2]->x - p[0]->x) * (p[1]->y - p[0]->y);
+
+        quad.keys.push_back(cellX->i);
+        quad.keys.push_back(cellX->j);
+        for (int v=0; v<3; ++v) {
+            Vertex const &a(*p[(v+1)%3]);
+            Vertex const &b(*p[(v+2)%3]);
+            double const phi = ((a.x - ctr.x) * (b.y - ctr.y)
+                - (b.x - ctr.x) * (a.y - ctr.y)) / det;
+            quad.vertices.push_back(p[v]->index);
+            quad.weights.push_back(cellX->native_area * std::max(phi, 0.));
+        }
+    }
+
+    set_quadrature(quad);
+}
+// --------------------------------------------------------
+void IceRegridder_L1::filter_cellsA(std::vector<bool> const &keepA)
+{
+    auto const useA = [&keepA](long iA)
+        { return iA < (long)keepA.size() && keepA[iA]; };
+
+    // Keep the quadrature of the exchange grid cells kept, in the same
+    // (stable) order as ExchangeGrid::filter_cellsB(); and the vertices
+    // they use.
+    std::vector<bool> keepI(nI(), false);
+    size_t nkeep = 0;
+    for (int id=0; id<aexgrid.dense_extent(); ++id) {
+        if (!useA(aexgrid.ijk(id,0))) continue;
+        for (int v=0; v<3; ++v) {
+            xvertices[nkeep*3+v] = xvertices[id*3+v];
+            xweights[nkeep*3+v] = xweights[id*3+v];
+            keepI[xvertices[id*3+v]] = true;
+        }
+        ++nkeep;
+    }
+    xvertices.resize(nkeep*3);
+    xweights.resize(nkeep*3);
+    xvertices.shrink_to_fit();
+    xweights.shrink_to_fit();
+
+    agridI.filter_cells([&keepI](long iI)
+        { return iI < (long)keepI.size() && keepI[iI]; });
+    aexgrid.filter_cellsB(useA);
+}
+// --------------------------------------------------------
+template<int STYLE, class AddT>
+inline void IceRegridder_L1::GvEp_cell(int id,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl, AddT const &add) const
+{
+    long const iA = aexgrid.ijk(id,0);        // GCM Atmosphere grid
+    for (int v=0; v<3; ++v) {
+        long const iI = xvertices[id*3+v];
+        double const w = xweights[id*3+v];
+
+        // This vertex masked out: no entries
+        double const em = elevmaskI(iI);
+        if (std::isnan(em) || !(w > 0)) continue;
+        double const elevation = std::max(em, 0.0);
+
+        // Interpolate in height points
+        if (STYLE == InterpStyle::Z_INTERP) {
+            long ihps[2];
+            double whps[2];
+            linterp_1d_b(gcm->hcdefs(), hcl, elevation, ihps, whps);
+            for (int k=0; k<2; ++k) {
+                if (whps[k] != 0) add(iI,
+                    gcm->fast_indexingHC.tuple_to_index({iA, ihps[k]}), w * whps[k]);
+            }
+        } else {    // ELEV_CLASS_INTERP
+            long const ihps0 = nearest_1d(gcm->hcdefs(), hcl, elevation);
+            add(iI, gcm->fast_indexingHC.tuple_to_index({iA, ihps0}), w);
+        }
+    }
+}
+
+template<int STYLE, bool GRID_I>
+long IceRegridder_L1::GvEp_loop(
+    MakeDenseEigenT::AccumT &ret,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl) const
+{
+    return parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        long const iX = aexgrid.to_sparse(id);
+        GvEp_cell<STYLE>(id, elevmaskI, hcl, [&](long iI, long iE, double val)
+            { sink.add({GRID_I ? iI : iX, iE}, val); });
+    });
+}
+
+void IceRegridder_L1::GvEp_cell(int id, UrSink &sink, char gridG,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl) const
+{
+    long const iX = aexgrid.to_sparse(id);
+    auto const add = [&](long iI, long iE, double val)
+        { sink.add({gridG == 'I' ? iI : iX, iE}, val); };
+    if (interp_style.index() == InterpStyle::Z_INTERP)
+        GvEp_cell<InterpStyle::Z_INTERP>(id, elevmaskI, hcl, add);
+    else
+        GvEp_cell<InterpStyle::ELEV_CLASS_INTERP>(id, elevmaskI, hcl, add);
+}
+
+/** Builds an interpolation matrix to go from height points to ice/exchange grid.
+@param ret Put the regrid matrix here. */
+void IceRegridder_L1::GvEp(
+    MakeDenseEigenT::AccumT &&ret,
+    char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'G' (exchange)
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L1::GvEp");
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+
+    if (gcm->hcdefs().size() == 0) (*icebin_error)(-1,
+        "IceRegridder_L1::GvEp(): hcdefs is zero-length!");
+    HCLookup const hcl(gcm->hcdefs());
+
+    long nnz = 0;
+    bool const grid_I = (gridG == 'I');
+    switch(interp_style.index()) {
+        case InterpStyle::Z_INTERP :
+            nnz = (grid_I ?
+                GvEp_loop<InterpStyle::Z_INTERP, true>(ret, elevmaskI, hcl) :
+                GvEp_loop<InterpStyle::Z_INTERP, false>(ret, elevmaskI, hcl));
+        break;
+        case InterpStyle::ELEV_CLASS_INTERP :
+            nnz = (grid_I ?
+                GvEp_loop<InterpStyle::ELEV_CLASS_INTERP, true>(ret, elevmaskI, hcl) :
+                GvEp_loop<InterpStyle::ELEV_CLASS_INTERP, false>(ret, elevmaskI, hcl));
+        break;
+        default :
+            (*icebin_error)(-1, "Illegal interp_style %d", (int)interp_style.index());
+    }
+    ICEBIN_PROFILE_NNZ(nnz);
+}
+// --------------------------------------------------------
+void IceRegridder_L1::GvI(
+    MakeDenseEigenT::AccumT &&ret,
+    char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'X' (exchange)
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L1::GvI");
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+    if (gridG == 'I') {
+        // Ice <- Ice = Identity Matrix, weighted by the integral of
+        // each vertex's basis function (see AbbrGrid(Grid))
+        for (int iId=0; iId<agridI.dim.dense_extent(); ++iId) {
+            long iIs = agridI.dim.to_sparse(iId);
+            if (!std::isnan(elevmaskI(iIs)))
+                ret.add({iIs, iIs}, agridI.native_area(iId));
+        }
+    } else {
+        // Exchange <- Ice
+        long const nnz = parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+            long const iX = aexgrid.to_sparse(id);    // index in exchange grid
+            for (int v=0; v<3; ++v) {
+                long const iI = xvertices[id*3+v];
+                double const w = xweights[id*3+v];
+                if (!std::isnan(elevmaskI(iI)) && w > 0)
+                    sink.add({iX,iI}, w);
+            }
+        });
+        ICEBIN_PROFILE_NNZ(nnz);
+    }
+}
+// --------------------------------------------------------
+void IceRegridder_L1::GvAp_cell(int id, UrSink &sink, char gridG,
+    blitz::Array<double,1> const &elevmaskI) const
+{
+    long const iA = aexgrid.ijk(id,0);
+
+    // Only the parts of the exchange cell in basis functions of
+    // vertices NOT masked out
+    double area = 0;
+    for (int v=0; v<3; ++v) {
+        long const iI = xvertices[id*3+v];
+        double const w = xweights[id*3+v];
+        if (std::isnan(elevmaskI(iI)) || !(w > 0)) continue;
+        if (gridG == 'I') sink.add({iI, iA}, w);
+        else area += w;
+    }
+    if (gridG != 'I' && area > 0)
+        sink.add({aexgrid.to_sparse(id), iA}, area);
+}
+
+void IceRegridder_L1::GvAp(
+    MakeDenseEigenT::AccumT &&ret,
+    char gridG,    // Interpolation grid to use for G: 'I' (ice) or 'X' (exchange)
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L1::GvAp");
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+    long const nnz = parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        GvAp_cell(id, sink, gridG, elevmaskI);
+    });
+    ICEBIN_PROFILE_NNZ(nnz);
+}
+// --------------------------------------------------------
+template<int STYLE>
+long IceRegridder_L1::EpvAp_loop(
+    MakeDenseEigenT::AccumT &ret,
+    blitz::Array<double,1> const &elevmaskI,
+    HCLookup const &hcl) const
+{
+    return parallel_accum(aexgrid.dense_extent(), ret, [&](int id, UrSink &sink) {
+        // Row id of diag(1/sum(GvAp)) * GvAp is 1 in column iA, if
+        // not empty; and it is empty when GvEp_cell() adds nothing.
+        long const iA = aexgrid.ijk(id,0);
+        GvEp_cell<STYLE>(id, elevmaskI, hcl, [&](long iI, long iE, double val)
+            { sink.add({iE, iA}, val); });
+    });
+}
+
+void IceRegridder_L1::EpvAp(
+    MakeDenseEigenT::AccumT &&ret,
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    ICEBIN_PROFILE_SCOPE("IceRegridder_L1::EpvAp");
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+
+    if (gcm->hcdefs().size() == 0) (*icebin_error)(-1,
+        "IceRegridder_L1::EpvAp(): hcdefs is zero-length!");
+    HCLookup const hcl(gcm->hcdefs());
+
+    long nnz = 0;
+    switch(interp_style.index()) {
+        case InterpStyle::Z_INTERP :
+            nnz = EpvAp_loop<InterpStyle::Z_INTERP>(ret, elevmaskI, hcl);
+        break;
+        case InterpStyle::ELEV_CLASS_INTERP :
+            nnz = EpvAp_loop<InterpStyle::ELEV_CLASS_INTERP>(ret, elevmaskI, hcl);
+        break;
+        default :
+            (*icebin_error)(-1, "Illegal interp_style %d", (int)interp_style.index());
+    }
+    ICEBIN_PROFILE_NNZ(nnz);
+}
+// --------------------------------------------------------
+void IceRegridder_L1::visit_GvAE(UrVisitor const &visitor,
+    char AE, char gridG,
+    blitz::Array<double,1> const *_elevmaskI) const
+{
+    blitz::Array<double,1> const &elevmaskI(*_elevmaskI);
+    UrSink sink(&visitor);
+
+    switch(AE) {
+        case 'A' :
+            for (int id=0; id<aexgrid.dense_extent(); ++id)
+                GvAp_cell(id, sink, gridG, elevmaskI);
+        break;
+        case 'E' : {
+            HCLookup const hcl(gcm->hcdefs());
+            for (int id=0; id<aexgrid.dense_extent(); ++id)
+                GvEp_cell(id, sink, gridG, elevmaskI, hcl);
+        } break;
+        default :
+            (*icebin_error)(-1, "Illegal AE='%c'", AE);
+    }
+}
+// --------------------------------------------------------
+void IceRegridder_L1::ncio(NcIO &ncio, std::string const &vname)
+{
+    IceRegridder::ncio(ncio, vname);
+
+    // Written when ncio() is flushed; so kept until then
+    if (ncio.rw == 'w') _ncio_quad = quadrature();
+    std::string const vn(vname + ".quadrature");
+    ncio_vector(ncio, _ncio_quad.keys, true, vn + ".keys", "int",
+        get_or_add_dims(ncio, _ncio_quad.keys, {vn + ".nkeys"}));
+    ncio_vector(ncio, _ncio_quad.vertices, true, vn + ".vertices", "int",
+        get_or_add_dims(ncio, _ncio_quad.vertices, {vn + ".nvertices"}));
+    ncio_vector(ncio, _ncio_quad.weights, true, vn + ".weights", "double",
+        get_or_add_dims(ncio, _ncio_quad.weights, {vn + ".nvertices"}));
+
+    if (ncio.rw == 'r') {
+        set_quadrature(_ncio_quad);
+        _ncio_quad = Quadrature();
+    }
+}
+
+}   // namespace icebin
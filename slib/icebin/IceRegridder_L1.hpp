@@ -0,0 +1,140 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <icebin/GCMRegridder.hpp>
+
+namespace icebin {
+
+class HCLookup;
+
+/** For ice models on a triangular finite element mesh (eg ISSM), with
+values at the vertices and linear in between.  The ice grid I is the
+mesh vertices (one linear basis function each; see AbbrGrid(Grid)).
+Each exchange grid cell is the overlap of a GCM cell (ijk(id,0)) with
+an element (ijk(id,1)).
+
+Each exchange grid cell lies within one element, on which the basis
+functions are linear; so their integrals over it are exact with one
+quadrature point, at its centroid.  Those integrals are computed once
+(init_mesh()), and stored with the regridder, so building matrices is
+a single pass over exchange grid cells, like IceRegridder_L0.  See
+pylib/icebin/element_l1.py. */
+class IceRegridder_L1 : public IceRegridder
+{
+public:
+    /** Number of vertices in the ice mesh */
+    size_t nI() const
+        { return agridI.dim.sparse_extent(); }
+
+    /** Number of grid cells in the interpolation grid */
+    size_t nX() const
+        { return aexgrid.sparse_extent(); }
+
+    /** Number of grid cells in the Ice (I) or Exchange (X) grids.
+    @param gridG Either 'I' or 'X' */
+    size_t nG(char gridG) const;
+
+    /** Integrals of the basis functions of the three vertices of an
+    element over each exchange grid cell; as stored in NetCDF. */
+    struct Quadrature {
+        std::vector<int> keys;       // [n*2] (iA, iElement) of each exchange cell, sorted
+        std::vector<int> vertices;   // [n*3] Vertices (I) of the element
+        std::vector<double> weights; // [n*3] Integral of each vertex's basis function
+    };
+
+protected:
+    // Quadrature, by (dense) exchange grid cell; kept aligned with aexgrid
+    std::vector<int> xvertices;      // [nX*3]
+    std::vector<double> xweights;    // [nX*3]
+
+    Quadrature _ncio_quad;    // What ncio() writes, until it is written
+
+    /** Sets xvertices and xweights from quad, for the exchange
+    grid cells in aexgrid */
+    void set_quadrature(Quadrature const &quad);
+
+    /** @return xvertices and xweights, keyed and sorted */
+    Quadrature quadrature() const;
+
+    /** Computes the GvEp entries for exchange grid cell id: for each
+    vertex, its weight split among (up to) two height points.
+    @tparam STYLE interp_style
+    @param add Called as add(iI, iE, val) for each entry */
+    template<int STYLE, class AddT>
+    void GvEp_cell(int id, blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl, AddT const &add) const;
+
+    /** Body of GvEp(), specialized on interp_style and gridG.
+    @tparam GRID_I True if gridG == 'I'
+    @return Number of elements added to ret */
+    template<int STYLE, bool GRID_I>
+    long GvEp_loop(MakeDenseEigenT::AccumT &ret,
+        blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl) const;
+
+    /** Body of EpvAp(), specialized on interp_style.
+    @return Number of elements added to ret */
+    template<int STYLE>
+    long EpvAp_loop(MakeDenseEigenT::AccumT &ret,
+        blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl) const;
+
+    /** Computes the GvAp entries for exchange grid cell id */
+    void GvAp_cell(int id, UrSink &sink, char gridG,
+        blitz::Array<double,1> const &elevmaskI) const;
+
+    /** Computes the GvEp entries for exchange grid cell id,
+    dispatching on interp_style */
+    void GvEp_cell(int id, UrSink &sink, char gridG,
+        blitz::Array<double,1> const &elevmaskI,
+        HCLookup const &hcl) const;
+
+public:
+    using IceRegridder::filter_cellsA;
+
+    /** Computes the quadrature from the full mesh and exchange grid.
+    @param fgridI The L1 ice mesh; elements must be triangles.
+    @param fexgrid Exchange grid; i = GCM cell, j = element. */
+    void init_mesh(Grid const &fgridI, Grid const &fexgrid);
+
+    /** Also removes mesh vertices, and quadrature, no longer used */
+    void filter_cellsA(std::vector<bool> const &keepA);
+
+    // Implementations of virtual functions
+    void GvEp(MakeDenseEigenT::AccumT &&ret,
+        char gridG,    // Identity of G: 'I' (ice) or 'X' (exchange)
+        blitz::Array<double,1> const *elevmaskI) const;
+    void GvI(MakeDenseEigenT::AccumT &&ret,
+        char gridG,    // Identity of G: 'I' (ice) or 'X' (exchange)
+        blitz::Array<double,1> const *elevmaskI) const;
+    void GvAp(MakeDenseEigenT::AccumT &&ret,
+        char gridG,    // Identity of G: 'I' (ice) or 'X' (exchange)
+        blitz::Array<double,1> const *elevmaskI) const;
+    void EpvAp(MakeDenseEigenT::AccumT &&ret,
+        blitz::Array<double,1> const *elevmaskI) const;
+    void visit_GvAE(UrVisitor const &visitor,
+        char AE, char gridG,
+        blitz::Array<double,1> const *elevmaskI) const;
+    void ncio(ibmisc::NcIO &ncio, std::string const &vname);
+};
+
+
+}   // namespace icebin
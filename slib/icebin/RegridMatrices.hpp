@@ -27,6 +27,17 @@ struct RegridParams {
     scale length of the smoothing.  Used for IvA and IvE. */
     std::array<double,3> sigma;
 
+    /** If sigma[2] is infinite and the ice grid is a structured XY
+    grid, smooth with the (faster) separable form of the Gaussian.
+    See separable_smoothing_matrices(). */
+    bool separable = false;
+
+    /** Relative tolerance for the smoothing matrix: in each row,
+    entries below smooth_tol times the largest are dropped and the row
+    renormalized (so it still sums to 1).  0 keeps all entries within
+    nsigma*sigma.  Not used by the separable form. */
+    double smooth_tol = 0;
+
     /** Tells if these parameters are asking us to smooth */
     bool smooth() const { return sigma[0] != 0; }
 
@@ -1,13 +1,24 @@
 #ifndef ICEBIN_REGRID_MATRICES_CPP
 #define ICEBIN_REGRID_MATRICES_CPP
 
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
 #include <functional>
+#include <mutex>
+#include <exception>
+#include <sys/stat.h>
+#include <boost/functional/hash.hpp>
 
 #include <icebin/RegridMatrices_Dynamic.hpp>
 #include <icebin/IceRegridder.hpp>
 #include <icebin/GCMRegridder.hpp>
 #include <icebin/smoother.hpp>
+#include <icebin/product_cache.hpp>
 #include <icebin/IceRegridder_L0.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/memsize.hpp>
+#include <icebin/parallel.hpp>
 
 using namespace std::placeholders;
 using namespace spsparse;
@@ -23,6 +34,38 @@ static blitz::Array<double,1> invert1(blitz::Array<double,1> const &A)
     return B;
 }
 
+/** Computes sum(M,0,'+') and sum(M,1,'+') together, in one pass over M
+(with compensated summation if icebin::compensated_sums)
+@param wM Row sums [M.rows()] (OUT)
+@param Mw Column sums [M.cols()] (OUT) */
+static void sum_rows_cols(EigenSparseMatrixT const &M,
+    blitz::Array<double,1> &wM, blitz::Array<double,1> &Mw)
+{
+    wM.reference(blitz::Array<double,1>(M.rows()));
+    Mw.reference(blitz::Array<double,1>(M.cols()));
+    if (compensated_sums) {
+        std::vector<CompensatedSum> wMc(M.rows()), Mwc(M.cols());
+        for (int k=0; k<M.outerSize(); ++k) {
+            for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) {
+                wMc[ii.row()].add(ii.value());
+                Mwc[ii.col()].add(ii.value());
+            }
+        }
+        for (int i=0; i<M.rows(); ++i) wM(i) = wMc[i].value();
+        for (int j=0; j<M.cols(); ++j) Mw(j) = Mwc[j].value();
+        return;
+    }
+
+    wM = 0;
+    Mw = 0;
+    for (int k=0; k<M.outerSize(); ++k) {
+        for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) {
+            wM(ii.row()) += ii.value();
+            Mw(ii.col()) += ii.value();
+        }
+    }
+}
+
 
 // =======================================================================
 // Regrid Matrix Generation
@@ -35,17 +78,127 @@ struct UrAE {
     const long nfull;
 
     typedef std::function<void(MakeDenseEigenT::AccumT &&)> ur_matrix_fn;
-    const ur_matrix_fn GvAp;
+    const ur_matrix_fn GvAp;    // G = exchange grid
+    /** Same as GvAp, but with rows on the ice grid.  Because each
+    exchange grid cell overlaps exactly one ice grid cell, this is
+    the product IvG * GvAp, formed in one pass over the exchange grid. */
+    const ur_matrix_fn IvAp;
     const ur_matrix_fn sApvA;
 
-    UrAE(std::string const &_dim_name, long _nfull, ur_matrix_fn _GvAp, ur_matrix_fn _sApvA)
+    UrAE(std::string const &_dim_name, long _nfull, ur_matrix_fn _GvAp, ur_matrix_fn _IvAp, ur_matrix_fn _sApvA)
         : dim_name(_dim_name),
         name("Ur"+dim_name),
-        nfull(_nfull), GvAp(_GvAp), sApvA(_sApvA) {}
+        nfull(_nfull), GvAp(_GvAp), IvAp(_IvAp), sApvA(_sApvA) {}
 };
 
 
 
+/** An Ur matrix (IvAp, or GvAp if Igrid=='X') converted to dense
+indexing, along with the dims it was converted with.  Shared by all
+matrices of one RegridMatrices_Dynamic built on the same Ur matrix
+(eg AvI and IvA; EvI and IvE), so the Ur matrix is generated, and its
+indices remapped, once per sheet and elevmaskI. */
+struct UrDense {
+    SparseSetT dimI, dimA;
+    std::array<bool,2> prefilled;    // Were {dimI,dimA} non-empty when this was built?
+    EigenSparseMatrixT IvAp;    // [dimI x dimA]
+    // Sums of IvAp, computed along with it; so the matrices built
+    // on it do not each need their own pass(es) over IvAp.
+    blitz::Array<double,1> wIvAp;    // sum(IvAp,0,'+') [dimI]
+    blitz::Array<double,1> IvApw;    // sum(IvAp,1,'+') [dimA]
+};
+
+/** (UrAE::name, Igrid) --> UrDense.  Each UrDense is built once, by
+the first matrix that needs it; concurrent matrices wait for it. */
+struct UrDenseCache {
+    struct Slot {
+        std::once_flag built;
+        UrDense ur;
+    };
+    std::mutex mutex;    // Protects slots (but not their contents)
+    std::map<std::pair<std::string,char>, std::unique_ptr<Slot>> slots;
+
+    Slot &slot(std::pair<std::string,char> const &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<Slot> &ret(slots[key]);
+        if (!ret) ret.reset(new Slot);
+        return *ret;
+    }
+};
+
+/** Can a caller's dim use a cached UrDense dim?  Yes if it is empty
+(and will be filled in), or already holds the same elements in the
+same order. */
+static bool compatible_dim(SparseSetT const &dim, SparseSetT const &dim0, bool prefilled0)
+{
+    if (dim.dense_extent() == 0) return !prefilled0;
+    if (dim.dense_extent() != dim0.dense_extent()) return false;
+    for (int i=0; i<dim0.dense_extent(); ++i)
+        if (dim.to_sparse(i) != dim0.to_sparse(i)) return false;
+    return true;
+}
+
+/** Converts an Ur matrix to dense indexing, appending to dimI and
+dimA; and sums it.  Sets ur.IvAp, ur.wIvAp and ur.IvApw. */
+static void make_ur_dense(
+    UrAE const &AE, char Igrid,
+    SparseSetT *dimI, SparseSetT *dimA,
+    UrDense &ur)
+{
+    ur.IvAp = MakeDenseEigenT(
+        Igrid=='I' ? AE.IvAp : AE.GvAp,
+        {SparsifyTransform::ADD_DENSE},
+        std::array<SparseSetT *,2>{dimI, dimA},
+        '.').to_eigen();
+    sum_rows_cols(ur.IvAp, ur.wIvAp, ur.IvApw);
+}
+
+/** Returns the Ur matrix IvAp [dimI x dimA] (or GvAp if Igrid=='X') in
+dense indexing, with its sums, appending to dimI and dimA as needed.
+Re-uses the copy in ur_cache, if the dims allow it; the first caller
+for each Ur matrix builds the cached copy, with its own dims.  The
+returned sums may be shared: copy before modifying.
+@param dimI, dimA Must not be null: they define the dense indexing. */
+static UrDense const &ur_dense(
+    UrDenseCache *ur_cache,
+    UrAE const &AE, char Igrid,
+    SparseSetT *dimI, SparseSetT *dimA,
+    UrDense &tmp)    // Storage, if not cached
+{
+    if (!dimI || !dimA) (*icebin_error)(-1,
+        "ur_dense(%s): dimI and dimA must be given", AE.name.c_str());
+
+    if (!ur_cache) {
+        make_ur_dense(AE, Igrid, dimI, dimA, tmp);
+        return tmp;
+    }
+
+    UrDenseCache::Slot &slot(ur_cache->slot(std::make_pair(AE.name, Igrid)));
+    UrDense &ur(slot.ur);
+    bool built_here = false;
+    std::call_once(slot.built, [&]() {
+        ur.prefilled = {dimI->dense_extent() != 0, dimA->dense_extent() != 0};
+        make_ur_dense(AE, Igrid, dimI, dimA, ur);
+        ur.dimI = *dimI;
+        ur.dimA = *dimA;
+        built_here = true;
+    });
+    if (built_here) return ur;
+
+    // Built by someone else; read-only from here on
+    if (compatible_dim(*dimI, ur.dimI, ur.prefilled[0])
+        && compatible_dim(*dimA, ur.dimA, ur.prefilled[1]))
+    {
+        if (dimI->dense_extent() == 0) *dimI = ur.dimI;
+        if (dimA->dense_extent() == 0) *dimA = ur.dimA;
+        return ur;
+    }
+
+    make_ur_dense(AE, Igrid, dimI, dimA, tmp);
+    return tmp;
+}
+
 // ------------------------------------------------------------
 static std::unique_ptr<linear::Weighted_Eigen> compute_AEvI(
     IceRegridder const *regridder,
@@ -53,69 +206,46 @@ static std::unique_ptr<linear::Weighted_Eigen> compute_AEvI(
     RegridParams const &params,
     blitz::Array<double,1> const *elevmaskI,
     char Igrid,        // Identity of I in "AEvI": 'I' or 'X'
-    UrAE const &AE)
+    UrAE const &AE,
+    UrDenseCache *ur_cache)
 {
     // if Igrid=='X', then references to I in this
     // function are actually X (exchdnage grid).
-    // (and dimG, etc. is an unused variable)
 
-printf("BEGIN compute_AEvI scale=%d correctA=%d\n", params.scale, params.correctA);
+    ICEBIN_PROFILE_SCOPE("compute_AEvI");
     std::unique_ptr<linear::Weighted_Eigen> ret(new linear::Weighted_Eigen(dims, true));
     SparseSetT * const dimA(ret->dims[0]);
     SparseSetT * const dimI(ret->dims[1]);
-    SparseSetT _dimG;
-    SparseSetT * const dimG(&_dimG);
 
     if (dimA) dimA->set_sparse_extent(AE.nfull);
     if (dimI) dimI->set_sparse_extent(
         Igrid=='I' ? regridder->nI() : regridder->nX());
-    dimG->set_sparse_extent(regridder->nX());
 
     // ----- Get the Ur matrices (which determines our dense dimensions)
-    std::unique_ptr<EigenSparseMatrixT> ApvG(new EigenSparseMatrixT(
-    MakeDenseEigenT(
-        // Only includes ice model grid cells with ice in them.
-        AE.GvAp,
-        {SparsifyTransform::ADD_DENSE},
-        std::array<SparseSetT *,2>{Igrid=='I' ? dimG : dimI, dimA},
-        'T').to_eigen()));
-
-    // ----- Convert to Eigen and multiply
-    std::unique_ptr<EigenSparseMatrixT> ApvI;
-    if (Igrid == 'I') {
-        EigenSparseMatrixT GvI(MakeDenseEigenT(
-            // Only includes ice model grid cells with ice in them.
-            std::bind(&IceRegridder::GvI, regridder, _1, 'X', elevmaskI),
-            {SparsifyTransform::ADD_DENSE},
-            {dimG, dimI}, '.').to_eigen());
-        auto sGvI(sum(GvI, 0, '-'));
-
-        ApvI.reset(new EigenSparseMatrixT(
-            *ApvG * map_eigen_diagonal(sGvI) * GvI));
-        ApvG.release();
-    } else {
-        ApvI = std::move(ApvG);
-    }
+    // If Igrid=='I', this is ApvG * diag(1/sum(GvI)) * GvI, fused
+    // into a single pass over the exchange grid (see UrAE::IvAp).
+    // Only includes ice model grid cells with ice in them.
+    UrDense ur_tmp;
+    UrDense const &ur(ur_dense(ur_cache, AE, Igrid, dimI, dimA, ur_tmp));
+    std::unique_ptr<EigenSparseMatrixT> ApvI(new EigenSparseMatrixT(ur.IvAp.transpose()));
 
-    ret->Mw.reference(sum(*ApvI, 1, '+'));    // Area of I cells
+    ret->Mw.reference(ur.wIvAp.copy());    // Area of I cells
+    blitz::Array<double,1> const &wApvI(ur.IvApw);    // sum(*ApvI, 0, '+')
 
     // ----- Apply final scaling, and convert back to sparse dimension
     if (params.correctA) {
         // ----- Compute the final weight matrix
-        auto wAvAp(MakeDenseEigenT(                   // diagonal
+        auto wAvAp(sum(MakeDenseEigenT(                   // diagonal
             AE.sApvA,
             {SparsifyTransform::TO_DENSE_IGNORE_MISSING},
-            {dimA, dimA}, '.').to_eigen());
-
-        auto wApvI(sum(*ApvI, 0, '+'));        // diagonal
-
-        EigenSparseMatrixT wAvI(wAvAp * map_eigen_diagonal(wApvI));    // diagonal...
+            {dimA, dimA}, '.').to_eigen(), 0, '+'));
 
         // +correctA: Weight matrix in A space
-        ret->wM.reference(sum(wAvI, 0, '+'));    // Area of A cells
+        // (wAvAp is diagonal, so sum(wAvAp * diag(wApvI), 0) is elementwise)
+        ret->wM.reference(blitz::Array<double,1>(wAvAp * wApvI));    // Area of A cells
 
         // Compute the main matrix
-        blitz::Array<double,1> sAvAp(sum(wAvAp, 0, '-'));
+        blitz::Array<double,1> sAvAp(invert1(wAvAp));
         if (params.scale) {
             // Get two diagonal Eigen scale matrices
             blitz::Array<double,1> sApvI(invert1(wApvI));
@@ -132,12 +262,11 @@ printf("BEGIN compute_AEvI scale=%d correctA=%d\n", params.scale, params.correct
 
         // ----- Compute the final weight matrix
         // ~correctA: Weight matrix in Ap space
-        auto wApvI_b(sum(*ApvI, 0, '+'));
-        ret->wM.reference(wApvI_b);
+        ret->wM.reference(wApvI.copy());
 
         if (params.scale) {
             // Get two diagonal Eigen scale matrices
-            auto sApvI(sum(*ApvI, 0, '-'));
+            blitz::Array<double,1> sApvI(invert1(wApvI));
 
             ret->M.reset(new EigenSparseMatrixT(
                 map_eigen_diagonal(sApvI) * *ApvI));    // ApvI_scaled
@@ -146,7 +275,6 @@ printf("BEGIN compute_AEvI scale=%d correctA=%d\n", params.scale, params.correct
         }
     }
 
-printf("END compute_AEvI\n");
     return ret;
 }
 // ---------------------------------------------------------
@@ -157,48 +285,34 @@ std::unique_ptr<linear::Weighted_Eigen> compute_IvAE(
     RegridParams const &params,
     blitz::Array<double,1> const *elevmaskI,
     char Igrid,        // Identity of I in "AEvI": 'I' or 'X'
-    UrAE const &AE)
+    UrAE const &AE,
+    UrDenseCache *ur_cache,
+    RegridMatrices_Dynamic const *rm)    // For rm->smoothing_cache
 {
     // if Igrid=='X', then references to I in this
     // function are actually X (exchdnage grid).
-    // (and dimG, etc. is an unused variable)
 
-//printf("BEGIN compute_IvAE\n");
+    ICEBIN_PROFILE_SCOPE("compute_IvAE");
     std::unique_ptr<linear::Weighted_Eigen> ret(new linear::Weighted_Eigen(dims, !params.smooth()));
     SparseSetT * const dimA(ret->dims[1]);    SparseSetT * const dimI(ret->dims[0]);
-    SparseSetT _dimG;
-    SparseSetT * const dimG(&_dimG);
 
     if (dimA) dimA->set_sparse_extent(AE.nfull);
     if (dimI) dimI->set_sparse_extent(
         Igrid=='I' ? regridder->nI() : regridder->nX());
-    dimG->set_sparse_extent(regridder->nX());
 
     // ----- Get the Ur matrices (which determines our dense dimensions)
-    std::unique_ptr<EigenSparseMatrixT> GvAp(new EigenSparseMatrixT(
-    MakeDenseEigenT(
-        AE.GvAp,
-        {SparsifyTransform::ADD_DENSE},
-        std::array<SparseSetT *,2>{Igrid=='I' ? dimG : dimI, dimA},
-        '.').to_eigen()));
-
-    std::unique_ptr<EigenSparseMatrixT> IvAp;
-    if (Igrid == 'I') {
-        EigenSparseMatrixT IvG(MakeDenseEigenT(
-            std::bind(&IceRegridder::GvI, regridder, _1, 'X', elevmaskI),
-            {SparsifyTransform::ADD_DENSE},
-            {dimG, dimI}, 'T').to_eigen());
-
-        auto sGvAp(sum(*GvAp, 0, '-'));
-        IvAp.reset(new EigenSparseMatrixT(
-            IvG * map_eigen_diagonal(sGvAp) * *GvAp));
-    } else {
-        IvAp = std::move(GvAp);
-    }
-
+    // If Igrid=='I', this is IvG * diag(1/sum(GvAp)) * GvAp, fused
+    // into a single pass over the exchange grid (see UrAE::IvAp).
+    UrDense ur_tmp;
+    UrDense const &ur(ur_dense(ur_cache, AE, Igrid, dimI, dimA, ur_tmp));
+    std::unique_ptr<EigenSparseMatrixT> IvAp(new EigenSparseMatrixT(ur.IvAp));
 
     // Get weight vector from IvAp_e
-    ret->wM.reference(sum(*IvAp, 0, '+'));
+    ret->wM.reference(ur.wIvAp.copy());
+    blitz::Array<double,1> const &IvApw(ur.IvApw);    // Area of A cells
+
+    // Names products in rm->product_cache
+    std::string const pkey(std::string(1, Igrid) + "v" + AE.dim_name + ":");
 
     // ----- Apply final scaling, and convert back to sparse dimension
     if (params.correctA) {
@@ -209,23 +323,24 @@ std::unique_ptr<linear::Weighted_Eigen> compute_IvAE(
             {dimA, dimA}, '.').to_eigen());
 
         // Compute area of A grid cells
-        auto IvApw(sum(*IvAp, 1, '+'));    // Area of A cells
-        auto &wAvAp(sApvA);    // Symmetry: wAvAp == sApvA
-        EigenSparseMatrixT Aw(wAvAp * map_eigen_diagonal(IvApw));
-        ret->Mw.reference(sum(Aw,0,'+'));
+        // Symmetry: wAvAp == sApvA, which is diagonal; so
+        // sum(wAvAp * diag(IvApw), 0) is elementwise
+        auto wAvAp(sum(sApvA, 0, '+'));
+        ret->Mw.reference(blitz::Array<double,1>(wAvAp * IvApw));
 
         if (params.scale) {
-            auto sIvAp(sum(*IvAp, 0, '-'));
-            ret->M.reset(new EigenSparseMatrixT(
-                map_eigen_diagonal(sIvAp) * *IvAp * sApvA));
+            blitz::Array<double,1> sIvAp(invert1(ret->wM));
+            ret->M.reset(new EigenSparseMatrixT(cached_product(
+                rm->product_cache, pkey + "sIvAp*IvAp*sApvA",
+                map_eigen_diagonal(sIvAp) * *IvAp, sApvA)));
         } else {
-            ret->M.reset(new EigenSparseMatrixT(
-                *IvAp * sApvA));
+            ret->M.reset(new EigenSparseMatrixT(cached_product(
+                rm->product_cache, pkey + "IvAp*sApvA", *IvAp, sApvA)));
         }
     } else {
-        ret->Mw.reference(sum(*IvAp, 1, '+'));    // Area of A cells
+        ret->Mw.reference(IvApw.copy());    // Area of A cells
         if (params.scale) {
-            auto sIvAp(sum(*IvAp, 0, '-'));
+            blitz::Array<double,1> sIvAp(invert1(ret->wM));
             ret->M.reset(new EigenSparseMatrixT(
                 map_eigen_diagonal(sIvAp) * *IvAp));
         } else {
@@ -234,92 +349,110 @@ std::unique_ptr<linear::Weighted_Eigen> compute_IvAE(
     }
 
     // Smooth the result on I, if needed
-    if (params.smooth()) {
+    auto const t0(std::chrono::steady_clock::now());
+    EigenSparseMatrixT smoothY, smoothX;
+    if (params.smooth() && params.separable && separable_smoothing_matrices(
+        smoothY, smoothX, regridder->agridI,
+        *dimI, *elevmaskI, ret->wM, params.sigma))
+    {
+        if (rm->stats) {
+            double const build_s = seconds_since(t0);
+            rm->stats->add(pkey + "smoothY", smoothY, nbytes(smoothY), build_s, false);
+            rm->stats->add(pkey + "smoothX", smoothX, nbytes(smoothX), build_s, false);
+        }
+        // Smooth as two 1-D passes (smoother.hpp)
+        EigenSparseMatrixT XM(cached_product(
+            rm->product_cache, pkey + "smoothX*M", smoothX, *ret->M));
+        ret->M.reset(new EigenSparseMatrixT(cached_product(
+            rm->product_cache, pkey + "smoothY*XM", smoothY, XM)));
+    } else if (params.smooth()) {
 
         // Obtain the smoothing matrix (smoother.hpp)
         TupleListT<2> smoothI_t({dimI->dense_extent(), dimI->dense_extent()});
         smoothing_matrix(smoothI_t, regridder->agridI,
-            *dimI, *elevmaskI, ret->wM, params.sigma);
+            *dimI, *elevmaskI, ret->wM, params.sigma, params.smooth_tol,
+            rm->smoothing_cache, std::string(1, Igrid) + "v" + AE.dim_name);
         EigenSparseMatrixT smoothI(smoothI_t.shape(0), smoothI_t.shape(1));
         smoothI.setFromTriplets(smoothI_t.begin(), smoothI_t.end());
+        if (rm->stats) rm->stats->add(pkey + "smoothI", smoothI, nbytes(smoothI),
+            seconds_since(t0), false);
 
         // Smooth the underlying unsmoothed regridding transformation
-        ret->M.reset(new EigenSparseMatrixT(smoothI * *ret->M));
+        ret->M.reset(new EigenSparseMatrixT(cached_product(
+            rm->product_cache, pkey + "smoothI*M", smoothI, *ret->M)));
     }
-//printf("END compute_IvAE\n");
 
     return ret;
 }
 
+/** Computes EvA (or AvE, with E and A swapped)
+@param EpvAp_fn Produces the Ur matrix EpvAp (IceRegridder::EpvAp),
+    whose rows are always on the elevation grid.
+@param trans '.' for EvA; 'T' for AvE */
 static std::unique_ptr<linear::Weighted_Eigen> compute_EvA(IceRegridder const *regridder,
     std::array<SparseSetT *,2> dims,
-    RegridParams const &params, UrAE const &E, UrAE const &A)
+    RegridParams const &params, UrAE const &E, UrAE const &A,
+    UrAE::ur_matrix_fn const &EpvAp_fn, char trans,
+    RegridMatrices_Dynamic const *rm)    // For rm->product_cache
 {
+    ICEBIN_PROFILE_SCOPE("compute_EvA");
     std::unique_ptr<linear::Weighted_Eigen> ret(new linear::Weighted_Eigen(dims, true));
     SparseSetT * const dimE(ret->dims[0]);
     SparseSetT * const dimA(ret->dims[1]);
-    SparseSetT _dimG;
-    SparseSetT * const dimG(&_dimG);
 
     if (dimA) dimA->set_sparse_extent(A.nfull);
     if (dimE) dimE->set_sparse_extent(E.nfull);
-    dimG->set_sparse_extent(regridder->nG('X'));
-
-    // ----- Get the Ur matrices (which determines our dense dimensions)
 
-    MakeDenseEigenT GvAp_m(
-        A.GvAp,
+    // ----- Get the Ur matrix (which determines our dense dimensions)
+    // EpvAp = EpvG * diag(sGvAp) * GvAp, formed in one pass over the
+    // exchange grid.  Each dim is added to in the same order as the
+    // G matrices would, so the dense indexing is unchanged.
+    std::unique_ptr<EigenSparseMatrixT> EpvAp(new EigenSparseMatrixT(MakeDenseEigenT(
+        EpvAp_fn,
         {SparsifyTransform::ADD_DENSE},
-        {dimG, dimA}, '.', false);   // include_zero=false
-    MakeDenseEigenT EpvG_m(
-        E.GvAp,
-        {SparsifyTransform::ADD_DENSE},
-        {dimG, dimE}, 'T', false);    // include_zero=false
-
-    // ----- Convert to Eigen and multiply
-    auto GvAp(GvAp_m.to_eigen());
-    auto EpvG(EpvG_m.to_eigen());
-
-    auto sGvAp(sum(GvAp, 0, '-'));
+        (trans == 'T' ?
+            std::array<SparseSetT *,2>{dimA, dimE} :
+            std::array<SparseSetT *,2>{dimE, dimA}),
+        trans, false).to_eigen()));    // include_zero=false
+    std::string const pkey(E.dim_name + "v" + A.dim_name + ":");
 
-    // Unweighted matrix
-    std::unique_ptr<EigenSparseMatrixT> EpvAp(
-        new EigenSparseMatrixT(EpvG * map_eigen_diagonal(sGvAp) * GvAp));
+    // Both sums of EpvAp, in one pass
+    blitz::Array<double,1> wEpvAp, EpvApw;
+    sum_rows_cols(*EpvAp, wEpvAp, EpvApw);
 
     // ----- Apply final scaling, and convert back to sparse dimension
-    auto wEpvAp(sum(*EpvAp,0,'+'));
     if (params.correctA) {
         auto sApvA(MakeDenseEigenT(
             A.sApvA,
             {SparsifyTransform::TO_DENSE_IGNORE_MISSING},
             {dimA, dimA}, '.').to_eigen());
 
-        auto wEvEp(MakeDenseEigenT(
+        auto wEvEp(sum(MakeDenseEigenT(    // diagonal
             E.sApvA,
             {SparsifyTransform::TO_DENSE_IGNORE_MISSING},
-            {dimE, dimE}, '.').to_eigen());
+            {dimE, dimE}, '.').to_eigen(), 0, '+'));
 
         // +correctA: Weight matrix in E space
-        EigenSparseMatrixT wEvAp(wEvEp * map_eigen_diagonal(wEpvAp));
-        ret->wM.reference(sum(wEvAp,0,'+'));
+        // (wEvEp is diagonal, so sum(wEvEp * diag(wEpvAp), 0) is elementwise)
+        ret->wM.reference(blitz::Array<double,1>(wEvEp * wEpvAp));
 
         // Compute area of A cells
-        auto EpvApw(sum(*EpvAp,1,'+'));
-        auto &wAvAp(sApvA);    // Symmetry: wAvAp == sApvA
-        EigenSparseMatrixT Aw(wAvAp * map_eigen_diagonal(EpvApw));
-        ret->Mw.reference(sum(Aw,0,'+'));
+        auto wAvAp(sum(sApvA, 0, '+'));    // Symmetry: wAvAp == sApvA
+        ret->Mw.reference(blitz::Array<double,1>(wAvAp * EpvApw));
 
         if (params.scale) {
-            auto sEvAp(sum(wEvAp,0,'-'));
-            ret->M.reset(new EigenSparseMatrixT(
-                map_eigen_diagonal(sEvAp) * *EpvAp * sApvA));    // EvA
+            blitz::Array<double,1> sEvAp(invert1(ret->wM));
+            ret->M.reset(new EigenSparseMatrixT(cached_product(
+                rm->product_cache, pkey + "sEvAp*EpvAp*sApvA",
+                map_eigen_diagonal(sEvAp) * *EpvAp, sApvA)));    // EvA
         } else {
-            ret->M.reset(new EigenSparseMatrixT(*EpvAp * sApvA));
+            ret->M.reset(new EigenSparseMatrixT(cached_product(
+                rm->product_cache, pkey + "EpvAp*sApvA", *EpvAp, sApvA)));
         }
     } else {    // ~correctA
         // ~correctA: Weight matrix in Ep space
         ret->wM.reference(wEpvAp);
-        ret->Mw.reference(sum(*EpvAp,1,'+'));
+        ret->Mw.reference(EpvApw);
         if (params.scale) {
             blitz::Array<double,1> sEpvAp(invert1(wEpvAp));
             ret->M.reset(new EigenSparseMatrixT(map_eigen_diagonal(sEpvAp) * *EpvAp));
@@ -331,18 +464,28 @@ static std::unique_ptr<linear::Weighted_Eigen> compute_EvA(IceRegridder const *r
     return ret;
 }
 
-std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_Standard::regrid_matrices(
+/** Body of GCMRegridder_Standard::regrid_matrices()
+@param urA_cache If non-null, dense Ur matrices for A come from (and
+    go into) here, rather than a cache private to the result.  They
+    depend on elevmaskI only through which cells it masks out, so all
+    users of one urA_cache must mask out the same cells.  Must outlive
+    the result.
+@param sheet_index Index of regridder in gcm; or -1 if it is not one
+    of gcm's ice sheets. */
+static std::unique_ptr<RegridMatrices_Dynamic> make_regrid_matrices(
+    GCMRegridder_Standard const *gcm,
+    IceRegridder const *regridder,
     int sheet_index,
     blitz::Array<double,1> const &_elevmaskI,
-    RegridParams const &params) const
+    RegridParams const &params,
+    UrDenseCache *urA_cache)
 {
-    IceRegridder const *regridder = &*ice_regridders()[sheet_index];
 
 #if 0
     printf("===== RegridMatrices Grid geometries:\n");
-    printf("    nA = %d\n", this->nA());
-    printf("    nhc = %d\n", this->nhc());
-    printf("    nE = %d\n", this->nE());
+    printf("    nA = %d\n", gcm->nA());
+    printf("    nhc = %d\n", gcm->nhc());
+    printf("    nE = %d\n", gcm->nE());
     printf("    nI = %d\n", regridder->nI());
     printf("    nG = %d\n", regridder->nG());
 #endif
@@ -350,44 +493,57 @@ std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_Standard::regrid_matrices(
     std::unique_ptr<RegridMatrices_Dynamic> rm(
         new RegridMatrices_Dynamic(regridder, params));
     auto &elevmaskI(rm->tmp.take(blitz::Array<double,1>(_elevmaskI)));
+    rm->inputs_hash = hash_array(elevmaskI, sheet_index);
+    rm->inputs.reserve(elevmaskI.size() + 1);
+    rm->inputs.push_back(sheet_index);
+    rm->inputs.insert(rm->inputs.end(), elevmaskI.begin(), elevmaskI.end());
+    rm->elevmaskI = &elevmaskI;
 
-    UrAE urA("A", this->nA(),
+    UrAE urA("A", gcm->nA(),
         std::bind(&IceRegridder::GvAp, regridder, _1, 'X', &elevmaskI),
+        std::bind(&IceRegridder::GvAp, regridder, _1, 'I', &elevmaskI),
         std::bind(&IceRegridder::sApvA, regridder, _1));
 
-    UrAE urE("E", this->nE(),
+    UrAE urE("E", gcm->nE(),
         std::bind(&IceRegridder::GvEp, regridder, _1, 'X', &elevmaskI),
+        std::bind(&IceRegridder::GvEp, regridder, _1, 'I', &elevmaskI),
         std::bind(&IceRegridder::sEpvE, regridder, _1));
 
+    // Dense Ur matrices, shared among the regrids below
+    UrDenseCache *urE_cache(&rm->tmp.make<UrDenseCache>());
+    if (!urA_cache) urA_cache = urE_cache;
+
     // ------- AvI, IvA
     rm->add_regrid("AvI",
-        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'I', urA));
+        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'I', urA, urA_cache));
     rm->add_regrid("IvA",
-        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'I', urA));
+        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'I', urA, urA_cache, &*rm));
 
     // ------- AvG, GvA
     rm->add_regrid("AvX",
-        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'X', urA));
+        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'X', urA, urA_cache));
     rm->add_regrid("XvA",
-        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'X', urA));
+        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'X', urA, urA_cache, &*rm));
 
     // ------- EvI, IvE
     rm->add_regrid("EvI",
-        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'I', urE));
+        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'I', urE, urE_cache));
     rm->add_regrid("IvE",
-        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'I', urE));
+        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'I', urE, urE_cache, &*rm));
 
     // ------- EvG, GvE
     rm->add_regrid("EvX",
-        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'X', urE));
+        std::bind(&compute_AEvI, regridder, _1, _2, &elevmaskI, 'X', urE, urE_cache));
     rm->add_regrid("XvE",
-        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'X', urE));
+        std::bind(&compute_IvAE, regridder, _1, _2, &elevmaskI, 'X', urE, urE_cache, &*rm));
 
-    // ------- EvA, AvE regrids.insert(make_pair("EvA", std::bind(&compute_EvA, regridder, _1, _2, urE, urA) ));
+    // ------- EvA, AvE
+    UrAE::ur_matrix_fn const EpvAp(
+        std::bind(&IceRegridder::EpvAp, regridder, _1, &elevmaskI));
     rm->add_regrid("EvA",
-        std::bind(&compute_EvA, regridder, _1, _2, urE, urA));
+        std::bind(&compute_EvA, regridder, _1, _2, urE, urA, EpvAp, '.', &*rm));
     rm->add_regrid("AvE",
-        std::bind(&compute_EvA, regridder, _1, _2, urA, urE));
+        std::bind(&compute_EvA, regridder, _1, _2, urA, urE, EpvAp, 'T', &*rm));
 
 #if 0
     // ----- Show what we have!
@@ -400,7 +556,456 @@ std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_Standard::regrid_matrices(
 
     return rm;
 }
+
+std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_Standard::regrid_matrices(
+    int sheet_index,
+    blitz::Array<double,1> const &elevmaskI,
+    RegridParams const &params) const
+{
+    return make_regrid_matrices(this, ice_regridder(sheet_index),
+        sheet_index, elevmaskI, params, nullptr);
+}
+
+std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_Standard::regrid_matrices(
+    IceRegridder const *regridder,
+    blitz::Array<double,1> const &elevmaskI,
+    RegridParams const &params) const
+{
+    if (regridder->gcm != this) (*icebin_error)(-1,
+        "regrid_matrices(): IceRegridder %s does not belong to this GCMRegridder",
+        regridder->name().c_str());
+    return make_regrid_matrices(this, regridder, -1, elevmaskI, params, nullptr);
+}
+// -----------------------------------------------------------------------
+/** Produces specs from each of rms, in parallel over (variant, spec) */
+static GCMRegridder::EnsembleMatrices ensemble_matrices(
+    std::vector<std::unique_ptr<RegridMatrices_Dynamic>> const &rms,
+    std::vector<std::string> const &specs)
+{
+    ICEBIN_PROFILE_SCOPE("regrid_matrices_ensemble");
+    int const nspec = specs.size();
+    int const n = rms.size() * nspec;
+
+    GCMRegridder::EnsembleMatrices ret(rms.size());
+    for (auto &mats : ret) mats.resize(nspec);
+
+    std::vector<std::exception_ptr> errs(n);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(max_threads())
+#endif
+    for (int k=0; k<n; ++k) {
+        int const i = k / nspec;
+        int const j = k % nspec;
+        try {
+            ret[i][j] = rms[i]->matrix(specs[j]);
+        } catch(...) {
+            errs[k] = std::current_exception();
+        }
+    }
+    for (auto &err : errs) if (err) std::rethrow_exception(err);
+    return ret;
+}
+
+// The RegridMatrices_Dynamic are made (and destroyed) serially: they
+// hold (shallow) copies of elevmaskIs, and blitz reference counts are
+// not thread-safe.
+GCMRegridder::EnsembleMatrices GCMRegridder::regrid_matrices_ensemble(
+    int sheet_index,
+    std::vector<blitz::Array<double,1>> const &elevmaskIs,
+    std::vector<std::string> const &specs,
+    RegridParams const &params) const
+{
+    std::vector<std::unique_ptr<RegridMatrices_Dynamic>> rms;
+    for (auto const &elevmaskI : elevmaskIs)
+        rms.push_back(regrid_matrices(sheet_index, elevmaskI, params));
+    return ensemble_matrices(rms, specs);
+}
+
+/** Do two elevmasks mask out (NaN) the same cells? */
+static bool same_mask(blitz::Array<double,1> const &a, blitz::Array<double,1> const &b)
+{
+    if (a.extent(0) != b.extent(0)) return false;
+    for (int i=0; i<a.extent(0); ++i) {
+        if (std::isnan(a(a.lbound(0)+i)) != std::isnan(b(b.lbound(0)+i))) return false;
+    }
+    return true;
+}
+
+GCMRegridder::EnsembleMatrices GCMRegridder_Standard::regrid_matrices_ensemble(
+    int sheet_index,
+    std::vector<blitz::Array<double,1>> const &elevmaskIs,
+    std::vector<std::string> const &specs,
+    RegridParams const &params) const
+{
+    // One urA_cache per distinct mask
+    std::vector<int> reps;    // First variant with each mask
+    std::vector<std::unique_ptr<UrDenseCache>> urA_caches;
+    std::vector<std::unique_ptr<RegridMatrices_Dynamic>> rms;
+    for (auto const &elevmaskI : elevmaskIs) {
+        size_t m = 0;
+        while (m < reps.size() && !same_mask(elevmaskI, elevmaskIs[reps[m]])) ++m;
+        if (m == reps.size()) {
+            reps.push_back(rms.size());
+            urA_caches.push_back(std::unique_ptr<UrDenseCache>(new UrDenseCache));
+        }
+        rms.push_back(make_regrid_matrices(this, ice_regridder(sheet_index),
+            sheet_index, elevmaskI, params, &*urA_caches[m]));
+    }
+    if (profile::verbose) printf("regrid_matrices_ensemble(): %ld variants, %ld distinct masks\n",
+        (long)elevmaskIs.size(), (long)reps.size());
+
+    GCMRegridder::EnsembleMatrices ret(ensemble_matrices(rms, specs));
+    rms.clear();    // Before urA_caches
+    return ret;
+}
+// -----------------------------------------------------------------------
 // -----------------------------------------------------------------------
+size_t hash_array(blitz::Array<double,1> const &arr, size_t seed)
+{
+    boost::hash_combine(seed, arr.extent(0));
+    for (int i=arr.lbound(0); i<=arr.ubound(0); ++i) {
+        // Hash the bits, so NaN (masked out) cells hash consistently
+        double const val = arr(i);
+        uint64_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        boost::hash_combine(seed, bits);
+    }
+    return seed;
+}
+
+/** Hash of the (possibly already partially filled) dims passed to matrix_d() */
+static size_t hash_dim(SparseSetT const *dim)
+{
+    size_t seed = 0;
+    if (!dim) return seed;
+    boost::hash_combine(seed, dim->sparse_extent());
+    boost::hash_combine(seed, dim->dense_extent());
+    for (int id=0; id<dim->dense_extent(); ++id)
+        boost::hash_combine(seed, dim->to_sparse(id));
+    return seed;
+}
+
+/** Deep copy of a Weighted_Eigen, using a different set of dims. */
+static std::unique_ptr<linear::Weighted_Eigen> copy_weighted(
+    linear::Weighted_Eigen const &BvA,
+    std::array<SparseSetT *,2> dims)
+{
+    std::unique_ptr<linear::Weighted_Eigen> ret(
+        new linear::Weighted_Eigen(dims, BvA.conservative));
+    ret->M.reset(new EigenSparseMatrixT(*BvA.M));
+    ret->wM.reference(blitz::Array<double,1>(BvA.wM.copy()));
+    ret->Mw.reference(blitz::Array<double,1>(BvA.Mw.copy()));
+    ret->scaled = BvA.scaled;
+    return ret;
+}
+
+void RegridMatrixCache::set_inputs(
+    size_t _inputs_hash, std::vector<double> const &_inputs)
+{
+    // Bitwise, so NaNs (masked-out cells) compare equal
+    if (_inputs_hash == inputs_hash && _inputs.size() == inputs.size()
+        && (inputs.empty() || memcmp(_inputs.data(), inputs.data(),
+            inputs.size() * sizeof(double)) == 0))
+    {
+        return;
+    }
+
+    // Inputs changed; everything we have is stale.
+    entries.clear();
+    inputs_hash = _inputs_hash;
+    inputs = _inputs;
+}
+
+std::unique_ptr<linear::Weighted_Eigen> RegridMatrixCache::find(
+    size_t _inputs_hash, std::vector<double> const &_inputs,
+    KeyT const &key, std::array<SparseSetT *,2> dims)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    set_inputs(_inputs_hash, _inputs);
+
+    auto ii(entries.find(key));
+    if (ii == entries.end()) {
+        ++nmiss;
+        return std::unique_ptr<linear::Weighted_Eigen>();
+    }
+    ++nhit;
+
+    // Hand back the dims as they would have been after building the matrix
+    Entry const &entry(ii->second);
+    for (int i=0; i<2; ++i) {
+        if (dims[i]) *dims[i] = entry.dims[i];
+    }
+    return copy_weighted(*entry.BvA, dims);
+}
+
+void RegridMatrixCache::insert(size_t _inputs_hash, std::vector<double> const &_inputs,
+    KeyT const &key, linear::Weighted_Eigen const &BvA)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    set_inputs(_inputs_hash, _inputs);
+
+    Entry &entry(entries[key]);
+    for (int i=0; i<2; ++i) {
+        if (BvA.dims[i]) entry.dims[i] = *BvA.dims[i];
+    }
+    entry.BvA = copy_weighted(BvA, {
+        BvA.dims[0] ? &entry.dims[0] : nullptr,
+        BvA.dims[1] ? &entry.dims[1] : nullptr});
+}
+
+size_t hash_file(std::string const &fname, size_t seed)
+{
+    struct stat sb;
+    if (stat(fname.c_str(), &sb) != 0) (*icebin_error)(-1,
+        "Cannot stat %s: %s", fname.c_str(), strerror(errno));
+    boost::hash_combine(seed, fname);
+    boost::hash_combine(seed, (long)sb.st_size);
+    boost::hash_combine(seed, (long)sb.st_mtime);
+    return seed;
+}
+
+// ---------- RegridMatrixCache snapshots
+// Layout (native byte order):
+//     SnapshotHeader
+//     double inputs[ninput]
+//     for each entry:
+//         key:   spec_name (uint64 length + chars), uint8 scale,
+//                correctA, separable; double sigma[3], smooth_tol;
+//                uint64 dims hash[2]
+//         dims:  for each of 2: uint8 present; int64 sparse_extent,
+//                nd, to_sparse[nd]
+//         BvA:   uint8 conservative, scaled; int64 nrow, ncol, nnz;
+//                int32 row[nnz], col[nnz]; double val[nnz];
+//                int64 n, double wM[n]; int64 n, double Mw[n]
+
+char const SNAPSHOT_MAGIC[8] = {'I','C','E','B','S','N','P','\0'};
+uint32_t const SNAPSHOT_VERSION = 2;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t files_hash;
+    uint64_t inputs_hash;
+    uint64_t ninput;
+    uint64_t nentry;
+};
+
+namespace {
+struct SnapshotWriter {
+    std::vector<char> &buf;
+
+    SnapshotWriter(std::vector<char> &_buf) : buf(_buf) {}
+
+    void write(void const *data, size_t n)
+    {
+        char const *cdata = (char const *)data;
+        buf.insert(buf.end(), cdata, cdata + n);
+    }
+
+    template<class T>
+    void put(T const &val) { write(&val, sizeof(T)); }
+
+    template<class T>
+    void put_vector(std::vector<T> const &vec) { write(vec.data(), vec.size()*sizeof(T)); }
+};
+
+struct SnapshotReader {
+    FILE *fin;
+    bool ok = true;
+
+    SnapshotReader(std::string const &fname) { fin = fopen(fname.c_str(), "rb"); }
+    ~SnapshotReader() { if (fin) fclose(fin); }
+
+    void read(void *buf, size_t n)
+        { if (ok && n > 0) ok = (fread(buf, 1, n, fin) == n); }
+
+    template<class T>
+    T get() { T val = T(); read(&val, sizeof(T)); return val; }
+
+    /** Reads an int64 count, then that many T */
+    template<class T>
+    std::vector<T> get_vector(int64_t n)
+    {
+        std::vector<T> ret;
+        if (!ok || n < 0) { ok = false; return ret; }
+        ret.resize(n);
+        read(ret.data(), n*sizeof(T));
+        return ret;
+    }
+};
+}
+
+std::vector<char> RegridMatrixCache::snapshot(size_t files_hash) const
+{
+    ICEBIN_PROFILE_SCOPE("RegridMatrixCache::snapshot");
+    std::vector<char> buf;
+    std::lock_guard<std::mutex> lock(mutex);
+    {SnapshotWriter out(buf);
+        SnapshotHeader header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byte_order = 0x01020304;
+        header.files_hash = files_hash;
+        header.inputs_hash = inputs_hash;
+        header.ninput = inputs.size();
+        header.nentry = entries.size();
+        out.put(header);
+        out.put_vector(inputs);
+
+        for (auto const &ii : entries) {
+            KeyT const &key(ii.first);
+            Entry const &entry(ii.second);
+            linear::Weighted_Eigen const &BvA(*entry.BvA);
+
+            std::string const &spec_name(std::get<0>(key));
+            out.put<uint64_t>(spec_name.size());
+            out.write(spec_name.data(), spec_name.size());
+            out.put<uint8_t>(std::get<1>(key));
+            out.put<uint8_t>(std::get<2>(key));
+            out.put<uint8_t>(std::get<3>(key));
+            out.put(std::get<4>(key));
+            out.put(std::get<5>(key));
+            out.put(std::get<6>(key));
+
+            for (int i=0; i<2; ++i) {
+                out.put<uint8_t>(BvA.dims[i] != nullptr);
+                if (!BvA.dims[i]) continue;
+                SparseSetT const &dim(entry.dims[i]);
+                out.put<int64_t>(dim.sparse_extent());
+                out.put<int64_t>(dim.dense_extent());
+                std::vector<int64_t> to_sparse(dim.dense_extent());
+                for (int id=0; id<dim.dense_extent(); ++id) to_sparse[id] = dim.to_sparse(id);
+                out.put_vector(to_sparse);
+            }
+
+            out.put<uint8_t>(BvA.conservative);
+            out.put<uint8_t>(BvA.scaled);
+            EigenSparseMatrixT const &M(*BvA.M);
+            std::vector<int32_t> rows, cols;
+            std::vector<double> vals;
+            rows.reserve(M.nonZeros());
+            cols.reserve(M.nonZeros());
+            vals.reserve(M.nonZeros());
+            for (int k=0; k<M.outerSize(); ++k) {
+            for (EigenSparseMatrixT::InnerIterator it(M, k); it; ++it) {
+                rows.push_back(it.row());
+                cols.push_back(it.col());
+                vals.push_back(it.value());
+            }}
+            out.put<int64_t>(M.rows());
+            out.put<int64_t>(M.cols());
+            out.put<int64_t>(vals.size());
+            out.put_vector(rows);
+            out.put_vector(cols);
+            out.put_vector(vals);
+
+            for (auto const *w : {&BvA.wM, &BvA.Mw}) {
+                out.put<int64_t>(w->extent(0));
+                out.write(w->data(), w->extent(0)*sizeof(double));
+            }
+        }
+    }
+
+    return buf;
+}
+
+void RegridMatrixCache::write_snapshot(std::string const &fname,
+    std::vector<char> const &buf)
+{
+    ICEBIN_PROFILE_SCOPE("RegridMatrixCache::write_snapshot");
+    std::string const tmp_fname(fname + ".tmp");
+    FILE *fout = fopen(tmp_fname.c_str(), "wb");
+    if (!fout) (*icebin_error)(-1,
+        "Cannot open %s for writing: %s", tmp_fname.c_str(), strerror(errno));
+    bool const ok = (fwrite(buf.data(), 1, buf.size(), fout) == buf.size());
+    if (fclose(fout) != 0 || !ok) (*icebin_error)(-1,
+        "Error writing %s: %s", tmp_fname.c_str(), strerror(errno));
+
+    // Readers never see a partly written snapshot
+    if (std::rename(tmp_fname.c_str(), fname.c_str()) != 0) (*icebin_error)(-1,
+        "Cannot rename %s to %s: %s", tmp_fname.c_str(), fname.c_str(), strerror(errno));
+}
+
+bool RegridMatrixCache::load(std::string const &fname, size_t files_hash)
+{
+    ICEBIN_PROFILE_SCOPE("RegridMatrixCache::load");
+    SnapshotReader in(fname);
+    if (!in.fin) return false;
+
+    SnapshotHeader const header(in.get<SnapshotHeader>());
+    if (!in.ok || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION || header.byte_order != 0x01020304)
+    {
+        fprintf(stderr, "Ignoring %s: not a version %d matrix snapshot\n",
+            fname.c_str(), SNAPSHOT_VERSION);
+        return false;
+    }
+    if (header.files_hash != files_hash) {
+        printf("Ignoring stale matrix snapshot %s (input files changed)\n", fname.c_str());
+        return false;
+    }
+
+    std::vector<double> _inputs(in.get_vector<double>((int64_t)header.ninput));
+    std::map<KeyT, Entry> _entries;
+    for (uint64_t n=0; n<header.nentry && in.ok; ++n) {
+        std::vector<char> spec_name(in.get_vector<char>(in.get<uint64_t>()));
+        bool const scale = in.get<uint8_t>();
+        bool const correctA = in.get<uint8_t>();
+        bool const separable = in.get<uint8_t>();
+        auto const sigma(in.get<std::array<double,3>>());
+        double const smooth_tol = in.get<double>();
+        auto const dims_hash(in.get<std::array<size_t,2>>());
+        KeyT const key(std::string(spec_name.begin(), spec_name.end()),
+            scale, correctA, separable, sigma, smooth_tol, dims_hash);
+
+        Entry &entry(_entries[key]);
+        std::array<SparseSetT *,2> dims {nullptr, nullptr};
+        for (int i=0; i<2; ++i) {
+            if (!in.get<uint8_t>()) continue;
+            SparseSetT &dim(entry.dims[i]);
+            dim.set_sparse_extent(in.get<int64_t>());
+            for (int64_t iS : in.get_vector<int64_t>(in.get<int64_t>())) dim.add_dense(iS);
+            dims[i] = &dim;
+        }
+
+        bool const conservative = in.get<uint8_t>();
+        bool const scaled = in.get<uint8_t>();
+        int64_t const nrow = in.get<int64_t>();
+        int64_t const ncol = in.get<int64_t>();
+        int64_t const nnz = in.get<int64_t>();
+        auto const rows(in.get_vector<int32_t>(nnz));
+        auto const cols(in.get_vector<int32_t>(nnz));
+        auto const vals(in.get_vector<double>(nnz));
+        auto const wM(in.get_vector<double>(in.get<int64_t>()));
+        auto const Mw(in.get_vector<double>(in.get<int64_t>()));
+        if (!in.ok) break;
+
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(nnz);
+        for (int64_t k=0; k<nnz; ++k) triplets.push_back(
+            Eigen::Triplet<double>(rows[k], cols[k], vals[k]));
+
+        entry.BvA.reset(new linear::Weighted_Eigen(dims, conservative));
+        entry.BvA->M.reset(new EigenSparseMatrixT(nrow, ncol));
+        entry.BvA->M->setFromTriplets(triplets.begin(), triplets.end());
+        entry.BvA->wM.reference(blitz::Array<double,1>(wM.size()));
+        std::copy(wM.begin(), wM.end(), entry.BvA->wM.data());
+        entry.BvA->Mw.reference(blitz::Array<double,1>(Mw.size()));
+        std::copy(Mw.begin(), Mw.end(), entry.BvA->Mw.data());
+        entry.BvA->scaled = scaled;
+    }
+    if (!in.ok) {
+        fprintf(stderr, "Ignoring %s: truncated matrix snapshot\n", fname.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries = std::move(_entries);
+    inputs_hash = header.inputs_hash;
+    inputs = std::move(_inputs);
+    return true;
+}
 // ----------------------------------------------------------------
 void RegridMatrices_Dynamic::add_regrid(std::string const &spec,
     RegridMatrices_Dynamic::MatrixFunction const &regrid)
@@ -416,9 +1021,35 @@ std::unique_ptr<linear::Weighted_Eigen> RegridMatrices_Dynamic::matrix_d(
 {
     // typedef std::function<std::unique_ptr<ibmisc::linear::Weighted_Eigen>(
     //    std::array<SparseSetT *,2> dims, RegridParams const &params)> MatrixFunction;
+    ICEBIN_PROFILE_SCOPE("RegridMatrices_Dynamic::matrix_d");
+    auto const t0(std::chrono::steady_clock::now());
     MatrixFunction const &matrix_fn(regrids.at(spec_name));
+    if (!cache) {
+        std::unique_ptr<linear::Weighted_Eigen> BvA(matrix_fn(dims, params));
+        BvA->scaled = params.scale;
+        ICEBIN_PROFILE_NNZ(BvA->M->nonZeros());
+        ICEBIN_PROFILE_BYTES(nbytes(*BvA));
+        if (stats) stats->add(spec_name, *BvA->M, nbytes(*BvA), seconds_since(t0), false);
+        return BvA;
+    }
+
+    // ---------- Memoized version
+    RegridMatrixCache::KeyT const key(spec_name,
+        params.scale, params.correctA, params.separable, params.sigma, params.smooth_tol,
+        std::array<size_t,2>{hash_dim(dims[0]), hash_dim(dims[1])});
+
+    std::unique_ptr<linear::Weighted_Eigen> cached(cache->find(inputs_hash, inputs, key, dims));
+    if (cached) {
+        if (stats) stats->add(spec_name, *cached->M, nbytes(*cached), seconds_since(t0), true);
+        return cached;
+    }
+
     std::unique_ptr<linear::Weighted_Eigen> BvA(matrix_fn(dims, params));
     BvA->scaled = params.scale;
+    ICEBIN_PROFILE_NNZ(BvA->M->nonZeros());
+    ICEBIN_PROFILE_BYTES(nbytes(*BvA));
+    cache->insert(inputs_hash, inputs, key, *BvA);
+    if (stats) stats->add(spec_name, *BvA->M, nbytes(*BvA), seconds_since(t0), false);
     return BvA;
 }
 // ----------------------------------------------------------------
@@ -436,8 +1067,111 @@ std::unique_ptr<ibmisc::linear::Weighted> RegridMatrices_Dynamic::matrix(
     return std::unique_ptr<ibmisc::linear::Weighted>(M.release());
 }
 // -----------------------------------------------------------------------
+blitz::Array<double,1> RegridMatrices_Dynamic::apply(
+    std::string const &spec_name,
+    blitz::Array<double,1> const &x,
+    RegridParams const &params,
+    double fill) const
+{
+    if (!elevmaskI) (*icebin_error)(-1,
+        "RegridMatrices_Dynamic::apply() is not available for this set of matrices");
+    if (params.smooth()) (*icebin_error)(-1,
+        "RegridMatrices_Dynamic::apply(%s) does not support smoothing", spec_name.c_str());
+
+    // Parse spec_name: BvA
+    bool AEvI;
+    char AE;
+    if (spec_name == "AvI" || spec_name == "EvI") {
+        AEvI = true;
+        AE = spec_name[0];
+    } else if (spec_name == "IvA" || spec_name == "IvE") {
+        AEvI = false;
+        AE = spec_name[2];
+    } else {
+        (*icebin_error)(-1,
+            "RegridMatrices_Dynamic::apply() does not support %s", spec_name.c_str());
+    }
 
+    GCMRegridder_Standard const *gcm = ice_regridder->gcm;
+    long const nAE = (AE == 'A' ? gcm->nA() : gcm->nE());
+    long const nI = ice_regridder->nI();
+    long const nin = (AEvI ? nI : nAE);
+    long const nout = (AEvI ? nAE : nI);
+    if (x.extent(0) != nin) (*icebin_error)(-1,
+        "RegridMatrices_Dynamic::apply(%s): x has extent %d, should be %ld",
+        spec_name.c_str(), x.extent(0), nin);
+
+    // Diagonal of sApvA (== wAvAp), by sparse index in A or E
+    auto sApvA = [&](long iAE) -> double {
+        long const iA = (AE == 'A' ? iAE
+            : gcm->fast_indexingHC.index_to_tuple(iAE)[0]);
+        int const id = gcm->agridA->dim.to_dense(iA);
+        return gcm->agridA->native_area(id) / ice_regridder->gridA_proj_area(id);
+    };
+
+    // y = M * x; wy = row sums of M
+    blitz::Array<double,1> y(nout);
+    blitz::Array<double,1> wy(nout);
+    y = 0;
+    wy = 0;
+    int const x0 = x.lbound(0);
+
+    // One pass over IvAp (IvEp).  See compute_AEvI() and compute_IvAE()
+    ice_regridder->visit_GvAE(
+        [&](long iI, long iAE, double val) {
+            if (AEvI) {
+                // ApvI = transpose(IvAp)
+                y(iAE) += val * x(x0 + iI);
+                wy(iAE) += val;
+            } else {
+                // IvA = IvAp * sApvA (if correctA)
+                double const xval = x(x0 + iAE) * (params.correctA ? sApvA(iAE) : 1.);
+                y(iI) += val * xval;
+                wy(iI) += val;
+            }
+        }, AE, 'I', elevmaskI);
+
+    // Apply final scaling; fill cells that got no contribution
+    for (long i=0; i<nout; ++i) {
+        if (wy(i) == 0) {
+            y(i) = fill;
+        } else if (params.scale) {
+            double w = wy(i);
+            if (AEvI && params.correctA) w *= sApvA(i);    // wM in A space
+            y(i) /= w;
+        }
+    }
 
+    return y;
+}
+// -----------------------------------------------------------------------
+void apply_multi(
+    linear::Weighted_Eigen const &BvA,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    EigenDenseMatrixT &B_e,
+    bool scale,
+    double fill)
+{
+    if (A_e.rows() != BvA.M->cols()) (*icebin_error)(-1,
+        "apply_multi(): Matrix has %ld columns, but fields have %ld rows",
+        (long)BvA.M->cols(), (long)A_e.rows());
+
+    // One pass through the matrix for all fields
+    B_e = *BvA.M * A_e;
+
+    bool const divide = scale && !BvA.scaled;
+    for (int n=0; n<B_e.cols(); ++n) {
+    for (int j=0; j<B_e.rows(); ++j) {
+        double const wB = BvA.wM(j);
+        if (wB == 0) {
+            // Cell slipped into the output because it was in the
+            // SparseSet, but did not actually get any contribution.
+            B_e(j,n) = fill;
+        } else if (divide) {
+            B_e(j,n) /= wB;
+        }
+    }}
+}
 
 // -----------------------------------------------------------------
 }    // namespace
@@ -2,21 +2,148 @@
 #define ICEBIN_REGRID_MATRICES_DYNAMIC_HPP
 
 #include <unordered_set>
+#include <tuple>
+#include <cmath>
+#include <vector>
+#include <mutex>
 #include <ibmisc/netcdf.hpp>
 #include <ibmisc/memory.hpp>
 #include <ibmisc/linear/eigen.hpp>
 #include <icebin/RegridMatrices.hpp>
 #include <icebin/eigen_types.hpp>
 #include <icebin/ElevMask.hpp>
+#include <icebin/error.hpp>
+#include <icebin/matrix_stats.hpp>
 
 namespace icebin {
 
 class IceRegridder;
 
+/** Content hash of an array that a set of regrid matrices depends on
+(eg elevmaskI, foceanAOp).  Used to key RegridMatrixCache. */
+extern size_t hash_array(blitz::Array<double,1> const &arr, size_t seed = 0);
+
+/** Cheap fingerprint of an input file: its name, size and
+modification time (not its contents).  Used to key snapshots. */
+extern size_t hash_file(std::string const &fname, size_t seed = 0);
+
+// -----------------------------------------------------------
+/** Opt-in memo of matrices produced by RegridMatrices_Dynamic::matrix_d().
+
+A coupler typically asks for the same few matrices (AvI, EvI, IvE,
+...) with the same RegridParams on every coupling step, and often
+with an elevmaskI that has not changed since the last step.  Attach
+one of these (which must outlive the RegridMatrices_Dynamic) to
+RegridMatrices_Dynamic::cache, and matrix_d() will return a copy of
+the previously built matrix rather than regenerating it.
+
+Entries are keyed on (spec name, scale, correctA, separable, sigma,
+smooth_tol, input dims), plus RegridMatrices_Dynamic::inputs: the
+arrays the matrices were generated from.  Those are kept, and
+compared bitwise on a match of their hash (inputs_hash).  Only one
+generation of inputs is held at a time: a lookup with new inputs
+flushes the whole cache.
+
+All methods are thread-safe, so one cache may be shared by matrix_d()
+calls running concurrently. */
+class RegridMatrixCache {
+public:
+    typedef std::tuple<
+        std::string,                // spec_name
+        bool, bool, bool,           // scale, correctA, separable
+        std::array<double,3>,       // sigma
+        double,                     // smooth_tol
+        std::array<size_t,2>        // Hash of dims on input
+    > KeyT;
+
+    struct Entry {
+        /** Dimensions, as they were after the matrix was built */
+        std::array<SparseSetT,2> dims;
+        /** The matrix; its dims point into Entry::dims */
+        std::unique_ptr<ibmisc::linear::Weighted_Eigen> BvA;
+    };
+
+protected:
+    /** inputs_hash and inputs of the RegridMatrices_Dynamic that
+    produced the current entries */
+    size_t inputs_hash = 0;
+    std::vector<double> inputs;
+
+    /** Flushes the entries unless they were built from _inputs.
+    Call with mutex held. */
+    void set_inputs(size_t _inputs_hash, std::vector<double> const &_inputs);
+
+    std::map<KeyT, Entry> entries;
+
+    mutable std::mutex mutex;    // Protects everything above, and the statistics
+
+public:
+    // Statistics
+    long nhit = 0;
+    long nmiss = 0;
+
+    /** Removes all entries */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    /** Looks up an entry.  If the inputs changed, flushes the cache.
+    The entry is copied out while the cache is locked, so a concurrent
+    insert() cannot replace it mid-copy.
+    @param dims OUTPUT: Set to the dims of the entry, as they were
+        after its matrix was built.  The returned matrix refers to them.
+    @return A copy of the cached matrix, or nullptr if not found. */
+    std::unique_ptr<ibmisc::linear::Weighted_Eigen> find(
+        size_t inputs_hash, std::vector<double> const &inputs,
+        KeyT const &key, std::array<SparseSetT *,2> dims);
+
+    /** Stores a copy of a newly-built matrix. */
+    void insert(size_t inputs_hash, std::vector<double> const &inputs,
+        KeyT const &key, ibmisc::linear::Weighted_Eigen const &BvA);
+
+    /** Writes all entries to a binary snapshot, so a later run can
+    start with them instead of rebuilding them.
+    @param files_hash Fingerprint of the input files (grids, etc) the
+        matrices were built from (@see hash_file()) */
+    void save(std::string const &fname, size_t files_hash) const
+        { write_snapshot(fname, snapshot(files_hash)); }
+
+    /** First half of save(): encodes all entries, in memory.  The
+    cache is only locked for this part. */
+    std::vector<char> snapshot(size_t files_hash) const;
+
+    /** Second half of save(): writes an encoded snapshot to fname.
+    Touches nothing in the cache, so it may run on another thread
+    (eg on GCMCoupler::log_writer). */
+    static void write_snapshot(std::string const &fname, std::vector<char> const &buf);
+
+    /** Replaces the entries with those from a snapshot written by
+    save().  Entries are still only used if their inputs match.
+    @return false (and leaves the cache as it was) if there is no
+        snapshot, or it is from another version or other input files. */
+    bool load(std::string const &fname, size_t files_hash);
+};
+
+class SmoothingCache;
+class ProductCache;
 
 // -----------------------------------------------------------
 /** Holds the set of "Ur" (original) matrices produced by an
-    IceRegridder for a SINGLE ice sheet. */
+    IceRegridder for a SINGLE ice sheet.
+
+Thread safety: once constructed, matrix_d(), matrix() and apply() may
+be called concurrently on one RegridMatrices_Dynamic, as long as each
+call gets its own dims.  The Ur matrices are read-only; the dense Ur
+matrices, cache, smoothing_cache and product_cache shared between calls do their own
+locking. */
 class RegridMatrices_Dynamic : public RegridMatrices {
 public:
     /** The ice_regridder from which this set of matrices was created. */
@@ -29,6 +156,37 @@ public:
 
     std::map<std::string, MatrixFunction> regrids;
 
+    /** Content hash of the inputs (elevmaskI, etc) the regrids were
+    bound to.  Set by whoever constructs this. */
+    size_t inputs_hash = 0;
+
+    /** The inputs themselves, concatenated (elevmaskI, etc; and the
+    sheet index).  Set with inputs_hash.  RegridMatrixCache compares
+    these, since a matching hash is not proof of equal inputs. */
+    std::vector<double> inputs;
+
+    /** elevmaskI the regrids were bound to; used by apply().  Null
+    if this RegridMatrices_Dynamic does not support apply(). */
+    blitz::Array<double,1> const *elevmaskI = nullptr;
+
+    /** If non-null, matrix_d() memoizes its results here.
+    (Not owned; must outlive this RegridMatrices_Dynamic). */
+    RegridMatrixCache *cache = nullptr;
+
+    /** If non-null, smoothing matrices (for IvA, IvE) are updated
+    incrementally from the ones kept here.  (Not owned). */
+    SmoothingCache *smoothing_cache = nullptr;
+
+    /** If non-null, sparse x sparse products (for IvA, IvE, EvA, AvE
+    and smoothing) re-use their symbolic structure from the ones kept
+    here.  (Not owned). */
+    ProductCache *product_cache = nullptr;
+
+    /** If non-null, matrix_d() records the size, build time and cache
+    hit/miss of each matrix here; and IvA/IvE, of their smoothing
+    matrices.  (Not owned). */
+    MatrixStatsLog *stats = nullptr;
+
     RegridMatrices_Dynamic(
         IceRegridder const *_ice_regridder,
         RegridParams const &params)
@@ -53,6 +211,20 @@ public:
         std::array<SparseSetT *,2> dims,
         RegridParams const &params) const;    // Ignores this->params()
 
+    /** Matrix-free regridding: computes y = BvA * x by streaming the Ur
+    matrices over the exchange grid, without ever forming BvA.  Use
+    for one-shot regrids, where building the matrix is not worth it.
+    @param spec_name One of "AvI", "EvI", "IvA", "IvE"
+    @param x Vector to regrid (sparse indexing)
+    @param params Smoothing is not supported.
+    @param fill Value for output cells that receive no contribution
+    @return y (sparse indexing) */
+    blitz::Array<double,1> apply(
+        std::string const &spec_name,
+        blitz::Array<double,1> const &x,
+        RegridParams const &params,
+        double fill = std::numeric_limits<double>::quiet_NaN()) const;
+
     // ----------- Implements RegridMatrices
     /** Produces its own dims, rather than re-using ones supplied by the user */
     std::unique_ptr<ibmisc::linear::Weighted> matrix(
@@ -60,6 +232,110 @@ public:
 
 };
 
+// -----------------------------------------------------------
+/** Regrids many fields through the same matrix at once.  This is a
+single sparse x dense product, so the matrix is streamed from memory
+once for all fields, rather than once per field.  Masking and scaling
+are done in the same pass over the result.
+@param BvA The regrid matrix (dense indexing).
+@param A_e The fields to regrid [nA x nvar] (Eigen column-major;
+    equivalently, a row-major blitz::Array<double,2>(nvar, nA)).
+@param B_e OUTPUT: The regridded fields [nB x nvar].
+@param scale If BvA is unscaled, divide by BvA.wM to produce a scaled result.
+@param fill Value to use for B cells that receive no contribution (wM == 0). */
+extern void apply_multi(
+    ibmisc::linear::Weighted_Eigen const &BvA,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    EigenDenseMatrixT &B_e,
+    bool scale,
+    double fill);
+
+/** Optional NaN check, fused into apply_multi(): records the first
+NaN found in BvA, or in a row of A that BvA uses. */
+struct NanCheck {
+    /** Columns (fields) of A in which NaN is allowed */
+    std::vector<char> allow_nan;
+
+    // First NaN found: where = "matrix" or "fields"; nullptr if none
+    char const *where = nullptr;
+    long row = -1;
+    long col = -1;
+
+    void found(char const *_where, long _row, long _col)
+    {
+        if (where) return;
+        where = _where;
+        row = _row;
+        col = _col;
+    }
+
+    void check_row(Eigen::Map<EigenDenseMatrixT const> const &A_e, long i)
+    {
+        if (where) return;
+        for (long m=0; m<A_e.cols(); ++m) {
+            if (std::isnan(A_e(i,m)) && !(m < (long)allow_nan.size() && allow_nan[m])) {
+                found("fields", i, m);
+                return;
+            }
+        }
+    }
+};
+
+/** Regrids fields while recombining them with a linear transformation
+(eg from ibmisc::VarTransformer::apply_scalars(..., 'T')):
+    B{jn} = BvA{ji} * (A{im} * trans.M{mn} + trans.b{in})
+This is one pass over the sparse matrix: each row of A used by BvA is
+transformed (with b added to it) as its column of BvA is reached, and
+scattered straight into B.  Neither the [nA x n] intermediate nor the
+row sums of BvA are formed.
+@param BvA Column-major Eigen sparse matrix; values may be float
+@param trans Anything with Eigen members M [nvarA x nvarB] and b [1 x nvarB]
+@param B_e OUTPUT: The result [nB x nvarB]: an Eigen dense matrix
+    (resized if needed) or a Map of the right size, of either
+    storage order (eg onto VectorMultivec::append_zero())
+@param nan_check If set, look for NaNs in BvA and A along the way */
+template<class SparseMatrixT, class TransT, class DenseMatrixT>
+void apply_multi(
+    SparseMatrixT const &BvA,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    TransT const &trans,
+    DenseMatrixT &B_e,
+    NanCheck *nan_check = nullptr)
+{
+    static_assert(!SparseMatrixT::IsRowMajor,
+        "apply_multi() streams BvA by column");
+    if (A_e.rows() != BvA.cols()) (*icebin_error)(-1,
+        "apply_multi(): Matrix has %ld columns, but fields have %ld rows",
+        (long)BvA.cols(), (long)A_e.rows());
+
+    B_e.resize(BvA.rows(), trans.M.cols());
+    B_e.setZero();
+    EigenRowVectorT tA(trans.M.cols());    // One transformed row of A
+    for (int k=0; k<BvA.outerSize(); ++k) {
+        typename SparseMatrixT::InnerIterator ii(BvA, k);
+        if (!ii) continue;    // Row of A not used
+        if (nan_check) nan_check->check_row(A_e, k);
+        tA = A_e.row(k) * trans.M;
+        tA += trans.b;
+        for (; ii; ++ii) {
+            double const val = ii.value();
+            if (nan_check && std::isnan(val)) nan_check->found("matrix", ii.row(), k);
+            B_e.row(ii.row()) += val * tA;
+        }
+    }
+}
+
+template<class SparseMatrixT, class TransT>
+EigenDenseMatrixT apply_multi(
+    SparseMatrixT const &BvA,
+    Eigen::Map<EigenDenseMatrixT const> const &A_e,
+    TransT const &trans,
+    NanCheck *nan_check = nullptr)
+{
+    EigenDenseMatrixT B_e;
+    apply_multi(BvA, A_e, trans, B_e, nan_check);
+    return B_e;
+}
 
 }    // namespace
 #endif    // guard
@@ -1,3 +1,4 @@
+#include <boost/algorithm/string.hpp>
 #include <icebin/VarSet.hpp>
 #include <ibmisc/netcdf.hpp>
 
@@ -81,6 +82,37 @@ netCDF::NcVar VarSet::ncdefine(ibmisc::NcIO &ncio,
     }
 }
 
+void VarSet::ncio(ibmisc::NcIO &ncio, std::string const &vname)
+{
+    auto info_v = get_or_add_var(ncio, vname, "int", {});
+    std::string names;
+    if (ncio.rw == 'w') names = boost::algorithm::join(keys(), " ");
+    get_or_put_att(info_v, ncio.rw, "names", names);
+
+    std::vector<std::string> snames;
+    if (names.size() > 0) boost::algorithm::split(snames, names,
+        boost::algorithm::is_any_of(" "));
+    if (ncio.rw == 'r') *this = VarSet();
+
+    for (size_t i=0; i<snames.size(); ++i) {
+        VarMeta var;
+        if (ncio.rw == 'w') var = data[i];
+
+        auto var_v = get_or_add_var(ncio, vname + "." + snames[i], "int", {});
+        get_or_put_att(var_v, ncio.rw, "units", var.units);
+        get_or_put_att(var_v, ncio.rw, "ncunits", var.ncunits);
+        get_or_put_att(var_v, ncio.rw, "description", var.description);
+        int flags = var.flags;
+        get_or_put_att(var_v, ncio.rw, "flags", "int", &flags, 1);
+        get_or_put_att(var_v, ncio.rw, "mm", "double", &var.mm, 1);
+        get_or_put_att(var_v, ncio.rw, "bb", "double", &var.bb, 1);
+        get_or_put_att(var_v, ncio.rw, "default_value", "double", &var.default_value, 1);
+
+        if (ncio.rw == 'r') add(snames[i], var.default_value,
+            var.units, var.ncunits, var.mm, var.bb, flags, var.description);
+    }
+}
+
 
 
 }
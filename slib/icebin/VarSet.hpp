@@ -100,6 +100,11 @@ public:
         std::vector<netCDF::NcDim> const &dims,
         std::string vname_base) const;
 
+    /** Reads/writes the variables' metadata (not their values), as
+    attributes of <vname> and <vname>.<name> for each variable.
+    Reading replaces the contents of this VarSet. */
+    void ncio(ibmisc::NcIO &ncio, std::string const &vname);
+
 };
 
 
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <algorithm>
+#include <icebin/async_writer.hpp>
+
+namespace icebin {
+
+AsyncWriter::AsyncWriter(size_t _max_queue)
+    : max_queue(std::max(_max_queue, (size_t)1)),
+    thread(&AsyncWriter::run, this)
+{}
+
+AsyncWriter::~AsyncWriter()
+{
+    {std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv_pushed.notify_all();
+    thread.join();
+
+    if (error) fprintf(stderr,
+        "AsyncWriter: error in a write that was never reported\n");
+}
+
+void AsyncWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv_pushed.wait(lock, [this]{ return done || !queue.empty(); });
+        if (queue.empty()) return;    // done, and nothing left to write
+
+        std::function<void()> write(std::move(queue.front()));
+        queue.pop_front();
+        busy = true;
+        cv_popped.notify_all();
+        lock.unlock();
+
+        std::exception_ptr err;
+        try {
+            std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+            write();
+        } catch(...) {
+            err = std::current_exception();
+        }
+        write = nullptr;    // Free what the write owned, before reporting it done
+
+        lock.lock();
+        if (err && !error) error = err;
+        busy = false;
+        cv_popped.notify_all();
+    }
+}
+
+void AsyncWriter::rethrow_error()
+{
+    if (!error) return;
+    std::exception_ptr err(error);
+    error = nullptr;
+    std::rethrow_exception(err);
+}
+
+void AsyncWriter::push(std::function<void()> &&write)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv_popped.wait(lock, [this]{ return queue.size() < max_queue; });
+    rethrow_error();
+    queue.push_back(std::move(write));
+    cv_pushed.notify_one();
+}
+
+void AsyncWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv_popped.wait(lock, [this]{ return queue.empty() && !busy; });
+    rethrow_error();
+}
+
+}    // namespace icebin
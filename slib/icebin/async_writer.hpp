@@ -0,0 +1,48 @@
+#ifndef ICEBIN_ASYNC_WRITER_HPP
+#define ICEBIN_ASYNC_WRITER_HPP
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <icebin/netcdf_mutex.hpp>
+
+namespace icebin {
+
+/** Runs writes (eg of log files) one at a time, in the order they
+were pushed, on a background thread; so they overlap with coupling.
+Each write must own (copy or move in) everything it touches.  When
+max_queue writes are waiting, push() blocks until one has finished.
+An exception thrown by a write is rethrown by the next push() or
+flush(). */
+class AsyncWriter {
+    size_t const max_queue;
+
+    std::mutex mutex;                    // Protects everything below
+    std::deque<std::function<void()>> queue;
+    bool busy = false;      // A write is running
+    bool done = false;      // Set by the destructor
+    std::exception_ptr error;
+    std::condition_variable cv_pushed;   // A write was queued (or done was set)
+    std::condition_variable cv_popped;   // A write was started or finished
+
+    std::thread thread;     // Last: starts once the rest is constructed
+
+    void run();
+    void rethrow_error();    // Call with mutex held
+public:
+    AsyncWriter(size_t _max_queue);
+
+    /** Finishes the queued writes */
+    ~AsyncWriter();
+
+    void push(std::function<void()> &&write);
+
+    /** Waits until all writes pushed so far have finished */
+    void flush();
+};
+
+}    // namespace icebin
+#endif    // guard
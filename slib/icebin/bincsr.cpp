@@ -0,0 +1,394 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spsparse/SparseSet.hpp>
+#include <ibmisc/linear/eigen.hpp>
+#include <ibmisc/linear/compressed.hpp>
+#include <icebin/bincsr.hpp>
+#include <icebin/AbbrGrid.hpp>
+#include <icebin/error.hpp>
+
+using namespace spsparse;
+using namespace ibmisc;
+
+namespace icebin {
+
+char const BINCSR_MAGIC[8] = {'I','C','E','B','C','S','R','\0'};
+char const BINGRID_MAGIC[8] = {'I','C','E','B','G','R','D','\0'};
+
+/** Strips the .nc extension, if any */
+static std::string nc_stem(std::string const &nc_fname)
+{
+    std::string stem(nc_fname);
+    size_t const n = stem.size();
+    if (n > 3 && stem.compare(n-3, 3, ".nc") == 0) stem.resize(n-3);
+    return stem;
+}
+
+std::string bincsr_fname(std::string const &nc_fname, std::string const &vname)
+    { return nc_stem(nc_fname) + "." + vname + ".bcsr"; }
+
+std::string bingrid_fname(std::string const &nc_fname, std::string const &vname)
+    { return nc_stem(nc_fname) + "." + vname + ".bgrid"; }
+
+static int64_t align8(int64_t x)
+    { return (x + 7) & ~(int64_t)7; }
+
+static void fwrite_section(FILE *fout, std::string const &fname,
+    int64_t offset, void const *data, size_t nbytes)
+{
+    if (fseek(fout, offset, SEEK_SET) != 0
+        || (nbytes > 0 && fwrite(data, 1, nbytes, fout) != nbytes))
+    {
+        (*icebin_error)(-1, "Error writing %s: %s", fname.c_str(), strerror(errno));
+    }
+}
+
+/** Extends the file with zeros to the end of the last section (so the
+mapping covers it, even if that section is empty), then closes it.
+@param len One past the end of the last section */
+static void fclose_padded(FILE *fout, std::string const &fname, int64_t len)
+{
+    if (fflush(fout) != 0 || ftruncate(fileno(fout), len) != 0)
+        (*icebin_error)(-1, "Error writing %s: %s", fname.c_str(), strerror(errno));
+    if (fclose(fout) != 0) (*icebin_error)(-1,
+        "Error closing %s: %s", fname.c_str(), strerror(errno));
+}
+
+void write_bincsr(std::string const &fname,
+    std::array<SparseSetT const *,2> dims,
+    EigenSparseMatrixT const &M,
+    blitz::Array<double,1> const &wM,
+    blitz::Array<double,1> const &Mw,
+    bool conservative)
+{
+    printf("BEGIN write_bincsr(%s)\n", fname.c_str());
+
+    // Convert to CSR
+    MappedCSR::SparseMatrixT Mr(M);
+    Mr.makeCompressed();
+
+    long const nrow = Mr.rows();
+    long const ncol = Mr.cols();
+    if (dims[0]->dense_extent() != nrow || dims[1]->dense_extent() != ncol
+        || wM.extent(0) != nrow || Mw.extent(0) != ncol)
+    {
+        (*icebin_error)(-1, "write_bincsr(%s): Inconsistent extents", fname.c_str());
+    }
+
+    BinCSRHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINCSR_MAGIC, sizeof(header.magic));
+    header.version = BINCSR_VERSION;
+    header.byte_order = BINCSR_BYTE_ORDER;
+    header.conservative = conservative;
+    header.sparse_extent[0] = dims[0]->sparse_extent();
+    header.sparse_extent[1] = dims[1]->sparse_extent();
+    header.dense_extent[0] = nrow;
+    header.dense_extent[1] = ncol;
+    header.nnz = Mr.nonZeros();
+
+    std::array<int64_t, BinCSRHeader::NSECTION> const nbytes {
+        (int64_t)(nrow * sizeof(int)),
+        (int64_t)(ncol * sizeof(int)),
+        (int64_t)((nrow+1) * sizeof(int)),
+        (int64_t)(header.nnz * sizeof(int)),
+        (int64_t)(header.nnz * sizeof(double)),
+        (int64_t)(nrow * sizeof(double)),
+        (int64_t)(ncol * sizeof(double))};
+    int64_t offset = align8(sizeof(header));
+    for (int i=0; i<BinCSRHeader::NSECTION; ++i) {
+        header.offset[i] = offset;
+        offset = align8(offset + nbytes[i]);
+    }
+
+    // Gather sections into contiguous storage
+    std::array<std::vector<int>,2> dimv;
+    for (int k=0; k<2; ++k) {
+        dimv[k].resize(dims[k]->dense_extent());
+        for (size_t i=0; i<dimv[k].size(); ++i) dimv[k][i] = dims[k]->to_sparse(i);
+    }
+    std::vector<double> wMv(wM.begin(), wM.end());
+    std::vector<double> Mwv(Mw.begin(), Mw.end());
+
+    FILE *fout = fopen(fname.c_str(), "wb");
+    if (!fout) (*icebin_error)(-1,
+        "Cannot open %s for writing: %s", fname.c_str(), strerror(errno));
+    fwrite_section(fout, fname, 0, &header, sizeof(header));
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::DIM0], dimv[0].data(), nbytes[BinCSRHeader::DIM0]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::DIM1], dimv[1].data(), nbytes[BinCSRHeader::DIM1]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::ROWPTR], Mr.outerIndexPtr(), nbytes[BinCSRHeader::ROWPTR]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::COLIDX], Mr.innerIndexPtr(), nbytes[BinCSRHeader::COLIDX]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::VALUES], Mr.valuePtr(), nbytes[BinCSRHeader::VALUES]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::WM], wMv.data(), nbytes[BinCSRHeader::WM]);
+    fwrite_section(fout, fname, header.offset[BinCSRHeader::MW], Mwv.data(), nbytes[BinCSRHeader::MW]);
+
+    fclose_padded(fout, fname, offset);
+
+    printf("END write_bincsr(%s): nnz=%ld\n", fname.c_str(), (long)header.nnz);
+}
+
+void write_bincsr(std::string const &fname,
+    linear::Weighted_Eigen const &BvA)
+{
+    write_bincsr(fname, {BvA.dims[0], BvA.dims[1]},
+        *BvA.M, BvA.wM, BvA.Mw, BvA.conservative);
+}
+
+void write_bincsr(std::string const &fname,
+    linear::Weighted_Compressed const &BvA)
+{
+    SparseSetT dimB, dimA;
+    EigenSparseMatrixT M(to_eigen_M(BvA.M, {&dimB, &dimA}));
+
+    // Weights for rows/cols that do not appear in M are dropped.
+    blitz::Array<double,1> wM(dimB.dense_extent());
+    blitz::Array<double,1> Mw(dimA.dense_extent());
+    wM = 0;
+    Mw = 0;
+    for (auto ii(BvA.weights[0].generator()); ++ii; ) {
+        if (dimB.in_sparse(ii->index(0))) wM(dimB.to_dense(ii->index(0))) += ii->value();
+    }
+    for (auto ii(BvA.weights[1].generator()); ++ii; ) {
+        if (dimA.in_sparse(ii->index(0))) Mw(dimA.to_dense(ii->index(0))) += ii->value();
+    }
+
+    write_bincsr(fname, {&dimB, &dimA}, M, wM, Mw, true);
+}
+
+// ---------------------------------------------------------------
+/** Maps a whole file; shared by MappedCSR and MappedGrid.
+@param format Name of the file format, for error messages
+@param min_len Minimum length of a valid file (its header)
+@param cow Map copy-on-write (MAP_PRIVATE), so the mapping may be
+    written without touching the file; otherwise it is read-only. */
+static void map_file(std::string const &fname,
+    char const *format, size_t min_len, bool cow,
+    int &fd, void *&base, size_t &len)
+{
+    fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) (*icebin_error)(-1,
+        "Cannot open %s: %s", fname.c_str(), strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) (*icebin_error)(-1,
+        "Cannot stat %s: %s", fname.c_str(), strerror(errno));
+    len = st.st_size;
+    if (len < min_len) (*icebin_error)(-1,
+        "%s is too short to be a %s file", fname.c_str(), format);
+
+    base = (cow
+        ? mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+        : mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0));
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        (*icebin_error)(-1, "Cannot mmap %s: %s", fname.c_str(), strerror(errno));
+    }
+}
+
+MappedCSR::MappedCSR(std::string const &_fname) : fname(_fname)
+{
+    map_file(fname, "bincsr", sizeof(BinCSRHeader), false, fd, base, len);
+    header = (BinCSRHeader const *)base;
+
+    // Validate
+    if (memcmp(header->magic, BINCSR_MAGIC, sizeof(header->magic)) != 0)
+        (*icebin_error)(-1, "%s is not a bincsr file", fname.c_str());
+    if (header->byte_order != BINCSR_BYTE_ORDER)
+        (*icebin_error)(-1, "%s was written with a different byte order", fname.c_str());
+    if (header->version != BINCSR_VERSION)
+        (*icebin_error)(-1, "%s has bincsr version %d; expected %d",
+            fname.c_str(), header->version, BINCSR_VERSION);
+    if ((size_t)header->offset[BinCSRHeader::MW]
+        + header->dense_extent[1]*sizeof(double) > len)
+    {
+        (*icebin_error)(-1, "%s is truncated", fname.c_str());
+    }
+}
+
+MappedCSR::~MappedCSR()
+{
+    if (base) munmap(base, len);
+    if (fd >= 0) close(fd);
+}
+
+MappedCSR::MapT MappedCSR::M() const
+{
+    return MapT(
+        header->dense_extent[0], header->dense_extent[1], header->nnz,
+        section<int>(BinCSRHeader::ROWPTR),
+        section<int>(BinCSRHeader::COLIDX),
+        section<double>(BinCSRHeader::VALUES));
+}
+
+blitz::Array<int,1> MappedCSR::dim(int i) const
+{
+    return blitz::Array<int,1>(
+        const_cast<int *>(section<int>(i == 0 ? BinCSRHeader::DIM0 : BinCSRHeader::DIM1)),
+        blitz::shape(header->dense_extent[i]), blitz::neverDeleteData);
+}
+
+void MappedCSR::to_sparse_set(int i, SparseSetT &dim) const
+{
+    int const *data = section<int>(i == 0 ? BinCSRHeader::DIM0 : BinCSRHeader::DIM1);
+    dim.clear();
+    dim.set_sparse_extent(header->sparse_extent[i]);
+    for (long j=0; j<header->dense_extent[i]; ++j) dim.add_dense(data[j]);
+}
+
+blitz::Array<double,1> MappedCSR::wM() const
+{
+    return blitz::Array<double,1>(
+        const_cast<double *>(section<double>(BinCSRHeader::WM)),
+        blitz::shape(header->dense_extent[0]), blitz::neverDeleteData);
+}
+
+blitz::Array<double,1> MappedCSR::Mw() const
+{
+    return blitz::Array<double,1>(
+        const_cast<double *>(section<double>(BinCSRHeader::MW)),
+        blitz::shape(header->dense_extent[1]), blitz::neverDeleteData);
+}
+
+// ---------------------------------------------------------------
+void write_bingrid(std::string const &fname, AbbrGrid const &agrid)
+{
+    printf("BEGIN write_bingrid(%s)\n", fname.c_str());
+
+    long const nd = agrid.dim.dense_extent();
+    blitz::Array<int,2> const &ijk(agrid.ijk());
+    blitz::Array<double,1> const &native_area(agrid.native_area());
+    blitz::Array<double,2> const &centroid_xy(agrid.centroid_xy());
+    long const ncentroid = (centroid_xy.extent(0) > 0 ? nd : 0);
+    if (ijk.extent(0) != nd || ijk.extent(1) != 3
+        || native_area.extent(0) != nd
+        || (ncentroid > 0 && (centroid_xy.extent(0) != nd || centroid_xy.extent(1) != 2)))
+    {
+        (*icebin_error)(-1, "write_bingrid(%s): Inconsistent extents", fname.c_str());
+    }
+
+    BinGridHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINGRID_MAGIC, sizeof(header.magic));
+    header.version = BINGRID_VERSION;
+    header.byte_order = BINCSR_BYTE_ORDER;
+    header.sparse_extent = agrid.dim.sparse_extent();
+    header.dense_extent = nd;
+    header.ncentroid = ncentroid;
+
+    std::array<int64_t, BinGridHeader::NSECTION> const nbytes {
+        (int64_t)(nd * sizeof(int64_t)),
+        (int64_t)(nd * 3 * sizeof(int)),
+        (int64_t)(nd * sizeof(double)),
+        (int64_t)(ncentroid * 2 * sizeof(double))};
+    int64_t offset = align8(sizeof(header));
+    for (int i=0; i<BinGridHeader::NSECTION; ++i) {
+        header.offset[i] = offset;
+        offset = align8(offset + nbytes[i]);
+    }
+
+    // Gather sections into contiguous storage (the arrays might be strided)
+    std::vector<int64_t> dimv(nd);
+    std::vector<int> ijkv(nd*3);
+    std::vector<double> native_areav(nd);
+    std::vector<double> centroid_xyv(ncentroid*2);
+    for (long id=0; id<nd; ++id) {
+        dimv[id] = agrid.dim.to_sparse(id);
+        for (int k=0; k<3; ++k) ijkv[id*3+k] = ijk(id,k);
+        native_areav[id] = native_area(id);
+        if (ncentroid > 0) {
+            centroid_xyv[id*2] = centroid_xy(id,0);
+            centroid_xyv[id*2+1] = centroid_xy(id,1);
+        }
+    }
+
+    FILE *fout = fopen(fname.c_str(), "wb");
+    if (!fout) (*icebin_error)(-1,
+        "Cannot open %s for writing: %s", fname.c_str(), strerror(errno));
+    fwrite_section(fout, fname, 0, &header, sizeof(header));
+    fwrite_section(fout, fname, header.offset[BinGridHeader::DIM], dimv.data(), nbytes[BinGridHeader::DIM]);
+    fwrite_section(fout, fname, header.offset[BinGridHeader::IJK], ijkv.data(), nbytes[BinGridHeader::IJK]);
+    fwrite_section(fout, fname, header.offset[BinGridHeader::NATIVE_AREA], native_areav.data(), nbytes[BinGridHeader::NATIVE_AREA]);
+    fwrite_section(fout, fname, header.offset[BinGridHeader::CENTROID_XY], centroid_xyv.data(), nbytes[BinGridHeader::CENTROID_XY]);
+
+    fclose_padded(fout, fname, offset);
+
+    printf("END write_bingrid(%s): nd=%ld\n", fname.c_str(), nd);
+}
+
+MappedGrid::MappedGrid(std::string const &_fname) : fname(_fname)
+{
+    // Copy-on-write: the arrays end up in AbbrGrids, which may be written
+    map_file(fname, "bingrid", sizeof(BinGridHeader), true, fd, base, len);
+    header = (BinGridHeader const *)base;
+
+    // Validate
+    if (memcmp(header->magic, BINGRID_MAGIC, sizeof(header->magic)) != 0)
+        (*icebin_error)(-1, "%s is not a bingrid file", fname.c_str());
+    if (header->byte_order != BINCSR_BYTE_ORDER)
+        (*icebin_error)(-1, "%s was written with a different byte order", fname.c_str());
+    if (header->version != BINGRID_VERSION)
+        (*icebin_error)(-1, "%s has bingrid version %d; expected %d",
+            fname.c_str(), header->version, BINGRID_VERSION);
+    if ((size_t)header->offset[BinGridHeader::CENTROID_XY]
+        + header->ncentroid*2*sizeof(double) > len)
+    {
+        (*icebin_error)(-1, "%s is truncated", fname.c_str());
+    }
+}
+
+MappedGrid::~MappedGrid()
+{
+    if (base) munmap(base, len);
+    if (fd >= 0) close(fd);
+}
+
+bool MappedGrid::matches(SparseSet<long,int> const &dim) const
+{
+    if (header->sparse_extent != dim.sparse_extent()) return false;
+    if (header->dense_extent != dim.dense_extent()) return false;
+    if (header->ncentroid != 0 && header->ncentroid != header->dense_extent) return false;
+
+    int64_t const *data = section<int64_t>(BinGridHeader::DIM);
+    for (long j=0; j<header->dense_extent; ++j)
+        if (data[j] != dim.to_sparse(j)) return false;
+    return true;
+}
+
+void MappedGrid::to_sparse_set(SparseSet<long,int> &dim) const
+{
+    int64_t const *data = section<int64_t>(BinGridHeader::DIM);
+    dim.clear();
+    dim.set_sparse_extent(header->sparse_extent);
+    for (long j=0; j<header->dense_extent; ++j) dim.add_dense(data[j]);
+}
+
+blitz::Array<int,2> MappedGrid::ijk() const
+{
+    return blitz::Array<int,2>(
+        const_cast<int *>(section<int>(BinGridHeader::IJK)),
+        blitz::shape(header->dense_extent, 3), blitz::neverDeleteData);
+}
+
+blitz::Array<double,1> MappedGrid::native_area() const
+{
+    return blitz::Array<double,1>(
+        const_cast<double *>(section<double>(BinGridHeader::NATIVE_AREA)),
+        blitz::shape(header->dense_extent), blitz::neverDeleteData);
+}
+
+blitz::Array<double,2> MappedGrid::centroid_xy() const
+{
+    if (header->ncentroid == 0) return blitz::Array<double,2>();
+    return blitz::Array<double,2>(
+        const_cast<double *>(section<double>(BinGridHeader::CENTROID_XY)),
+        blitz::shape(header->ncentroid, 2), blitz::neverDeleteData);
+}
+
+}    // namespace icebin
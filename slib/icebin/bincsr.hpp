@@ -0,0 +1,206 @@
+#ifndef ICEBIN_BINCSR_HPP
+#define ICEBIN_BINCSR_HPP
+
+#include <cstdint>
+#include <string>
+#include <array>
+#include <blitz/array.h>
+#include <spsparse/SparseSet.hpp>
+#include <icebin/eigen_types.hpp>
+
+namespace ibmisc {
+namespace linear {
+    class Weighted_Eigen;
+}}
+
+namespace icebin {
+
+struct AbbrGrid;
+
+/** Binary CSR container for precomputed regrid matrices ("bincsr").
+
+NetCDF files written by global_ec / combine_global_ec must be parsed
+and copied every time a model starts; with many ranks, that is slow.
+This format stores the same information as a
+linear::Weighted_Eigen (M, wM, Mw, dims), laid out so it can be
+mmap()ed read-only and used in place.
+
+Layout (native byte order; every section 8-byte aligned):
+    BinCSRHeader
+    dims[0]   int32[nrow]     dense-to-sparse map for rows (B)
+    dims[1]   int32[ncol]     dense-to-sparse map for columns (A)
+    rowptr    int32[nrow+1]   CSR row pointers
+    colidx    int32[nnz]      CSR column indices (dense)
+    values    double[nnz]
+    wM        double[nrow]
+    Mw        double[ncol]
+*/
+struct BinCSRHeader {
+    char magic[8];          // BINCSR_MAGIC
+    uint32_t version;       // BINCSR_VERSION
+    uint32_t byte_order;    // BINCSR_BYTE_ORDER, as written
+    int32_t conservative;
+    int32_t _pad;
+    int64_t sparse_extent[2];
+    int64_t dense_extent[2];    // {nrow, ncol}
+    int64_t nnz;
+
+    enum {DIM0, DIM1, ROWPTR, COLIDX, VALUES, WM, MW, NSECTION};
+    int64_t offset[NSECTION];   // Byte offset of each section
+};
+
+extern char const BINCSR_MAGIC[8];
+uint32_t const BINCSR_VERSION = 1;
+uint32_t const BINCSR_BYTE_ORDER = 0x01020304;
+
+/** Name of the bincsr sidecar holding matrix vname of a NetCDF file.
+Eg: ("global_ecO.nc", "EvO") --> "global_ecO.EvO.bcsr" */
+std::string bincsr_fname(std::string const &nc_fname, std::string const &vname);
+
+/** Writes a matrix in bincsr format.
+@param dims Dense-to-sparse maps for rows and columns of M
+@param M The matrix (dense indexing)
+@param wM, Mw Weight vectors (dense indexing) */
+void write_bincsr(std::string const &fname,
+    std::array<SparseSetT const *,2> dims,
+    EigenSparseMatrixT const &M,
+    blitz::Array<double,1> const &wM,
+    blitz::Array<double,1> const &Mw,
+    bool conservative);
+
+void write_bincsr(std::string const &fname,
+    ibmisc::linear::Weighted_Eigen const &BvA);
+
+void write_bincsr(std::string const &fname,
+    ibmisc::linear::Weighted_Compressed const &BvA);
+
+/** A bincsr file, mmap()ed read-only.  Arrays returned by the
+accessors point directly into the mapping; they are valid only as
+long as this object lives, and must not be written. */
+class MappedCSR {
+    int fd = -1;
+    void *base = nullptr;
+    size_t len = 0;
+    BinCSRHeader const *header = nullptr;
+
+    template<class T>
+    T const *section(int i) const
+        { return (T const *)((char const *)base + header->offset[i]); }
+
+public:
+    typedef Eigen::SparseMatrix<double, Eigen::RowMajor, int> SparseMatrixT;
+    typedef Eigen::Map<SparseMatrixT const> MapT;
+
+    std::string const fname;
+
+    MappedCSR(std::string const &_fname);
+    ~MappedCSR();
+    MappedCSR(MappedCSR const &) = delete;
+    MappedCSR &operator=(MappedCSR const &) = delete;
+
+    bool conservative() const { return header->conservative; }
+    long nnz() const { return header->nnz; }
+
+    /** Sparse shape of the matrix */
+    std::array<long,2> shape() const
+        { return {header->sparse_extent[0], header->sparse_extent[1]}; }
+
+    /** The matrix, in dense indexing; no copy is made. */
+    MapT M() const;
+
+    /** Dense-to-sparse map for dimension i */
+    blitz::Array<int,1> dim(int i) const;
+
+    /** Fills a SparseSetT with dimension i */
+    void to_sparse_set(int i, SparseSetT &dim) const;
+
+    blitz::Array<double,1> wM() const;
+    blitz::Array<double,1> Mw() const;
+
+    /** Calls fn(iB, iA, value) for each element, in sparse indexing. */
+    template<class FnT>
+    void visit(FnT const &fn) const
+    {
+        int const *dim0 = section<int>(BinCSRHeader::DIM0);
+        int const *dim1 = section<int>(BinCSRHeader::DIM1);
+        int const *rowptr = section<int>(BinCSRHeader::ROWPTR);
+        int const *colidx = section<int>(BinCSRHeader::COLIDX);
+        double const *values = section<double>(BinCSRHeader::VALUES);
+
+        for (long i=0; i<header->dense_extent[0]; ++i) {
+            long const iB = dim0[i];
+            for (int k=rowptr[i]; k<rowptr[i+1]; ++k)
+                fn(iB, (long)dim1[colidx[k]], values[k]);
+        }
+    }
+};
+
+// ---------------------------------------------------------------
+/** Binary container for the per-cell arrays of an AbbrGrid
+("bingrid"); the mmap()able counterpart of AbbrGrid::ncio().  Grid
+metadata (spec, indexing, etc) stays in the NetCDF file.
+
+Layout (native byte order; every section 8-byte aligned):
+    BinGridHeader
+    dim           int64[nd]       dense-to-sparse map
+    ijk           int32[nd*3]     ijk(id, k)
+    native_area   double[nd]
+    centroid_xy   double[ncentroid*2]   (ncentroid is 0 or nd)
+*/
+struct BinGridHeader {
+    char magic[8];          // BINGRID_MAGIC
+    uint32_t version;       // BINGRID_VERSION
+    uint32_t byte_order;    // BINCSR_BYTE_ORDER, as written
+    int64_t sparse_extent;
+    int64_t dense_extent;   // nd
+    int64_t ncentroid;
+
+    enum {DIM, IJK, NATIVE_AREA, CENTROID_XY, NSECTION};
+    int64_t offset[NSECTION];   // Byte offset of each section
+};
+
+extern char const BINGRID_MAGIC[8];
+uint32_t const BINGRID_VERSION = 1;
+
+/** Name of the bingrid sidecar holding AbbrGrid vname of a NetCDF file.
+Eg: ("gcmO.nc", "m.agridA") --> "gcmO.m.agridA.bgrid" */
+std::string bingrid_fname(std::string const &nc_fname, std::string const &vname);
+
+/** Writes the per-cell arrays of an AbbrGrid in bingrid format. */
+void write_bingrid(std::string const &fname, AbbrGrid const &agrid);
+
+/** A bingrid file, mmap()ed copy-on-write.  As with MappedCSR, arrays
+returned by the accessors point directly into the mapping; but they
+may be written, without changing the file. */
+class MappedGrid {
+    int fd = -1;
+    void *base = nullptr;
+    size_t len = 0;
+    BinGridHeader const *header = nullptr;
+
+    template<class T>
+    T const *section(int i) const
+        { return (T const *)((char const *)base + header->offset[i]); }
+
+public:
+    std::string const fname;
+
+    MappedGrid(std::string const &_fname);
+    ~MappedGrid();
+    MappedGrid(MappedGrid const &) = delete;
+    MappedGrid &operator=(MappedGrid const &) = delete;
+
+    /** @return true if this file holds the cells of dim, in the same
+    order (eg, dim as read from the NetCDF file next to it). */
+    bool matches(spsparse::SparseSet<long,int> const &dim) const;
+
+    /** Fills a SparseSet with the grid's cells */
+    void to_sparse_set(spsparse::SparseSet<long,int> &dim) const;
+
+    blitz::Array<int,2> ijk() const;
+    blitz::Array<double,1> native_area() const;
+    blitz::Array<double,2> centroid_xy() const;
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -0,0 +1,72 @@
+#ifndef ICEBIN_COMPACT_E_HPP
+#define ICEBIN_COMPACT_E_HPP
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+/** A compact numbering of the elevation points (iA, ihc) that ice
+sheets have actually used in the run.  The sparse E space
+(GCMRegridder::nE() = nA * nhc) is much bigger: only a few elevation
+classes of a few GCM cells are ever populated near ice.
+
+Points are numbered in order of first use, and keep their number for
+the rest of the run; so matrices built at different coupling steps
+(XuE0 and XuE1, for E1vE0) share one numbering.  (A SparseSetT, in
+contrast, is rebuilt with each matrix.)  Used inside GCMCoupler; E
+indices are translated back to the GCM's sparse E indexing where
+GCMInput leaves GCMCoupler::couple(). */
+class CompactE {
+    long _nE = 0;                        // Extent of sparse E
+    std::vector<long> _iE_s;             // Sparse index of each compact index
+    std::unordered_map<long,int> _iEc;   // Inverse of _iE_s
+
+public:
+    CompactE() {}
+    explicit CompactE(long nE) : _nE(nE) {}
+
+    long sparse_extent() const { return _nE; }
+    int size() const { return _iE_s.size(); }
+
+    /** @return Compact index of iE_s, numbering it if it is new */
+    int add(long iE_s)
+    {
+        auto ii(_iEc.insert(std::make_pair(iE_s, (int)_iE_s.size())));
+        if (ii.second) {
+            if (iE_s < 0 || iE_s >= _nE) (*icebin_error)(-1,
+                "CompactE::add(): iE=%ld is out of range [0, %ld)", iE_s, _nE);
+            _iE_s.push_back(iE_s);
+        }
+        return ii.first->second;
+    }
+
+    /** @return Compact index of iE_s; or -1 if it has not been used */
+    int to_compact(long iE_s) const
+    {
+        auto ii(_iEc.find(iE_s));
+        return (ii == _iEc.end() ? -1 : ii->second);
+    }
+
+    long to_sparse(int iEc) const { return _iE_s[iEc]; }
+
+    /** Sparse index of each compact index (eg to store them) */
+    std::vector<long> const &sparse_indices() const { return _iE_s; }
+
+    /** Replaces the numbering; eg with one read from a restart file */
+    void reset(long nE, std::vector<long> const &iE_s)
+    {
+        _nE = nE;
+        _iE_s.clear();
+        _iEc.clear();
+        for (long i : iE_s) add(i);
+        if (_iE_s.size() != iE_s.size()) (*icebin_error)(-1,
+            "CompactE::reset(): %ld indices, but only %ld distinct",
+            (long)iE_s.size(), (long)_iE_s.size());
+    }
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <functional>
+#include <netcdf.h>
+#include <spsparse/eigen.hpp>
+#include <icebin/compact_matrix.hpp>
+#include <icebin/nc_layout.hpp>
+#include <icebin/error.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/netcdf_mutex.hpp>
+
+using namespace ibmisc;
+using namespace spsparse;
+using namespace netCDF;
+
+namespace icebin {
+
+CompactSparseMatrix::CompactSparseMatrix(EigenSparseMatrixT &&M, MatrixPrecision precision)
+{
+    switch(precision.index()) {
+        case MatrixPrecision::SINGLE :
+            M_f.reset(new FloatMatrixT(M.cast<float>()));
+            M_f->makeCompressed();
+            M.resize(0,0);
+            M.data().squeeze();
+        break;
+        default :
+            M_d.reset(new EigenSparseMatrixT(std::move(M)));
+            M_d->makeCompressed();
+        break;
+    }
+}
+
+template<class SparseMatrixT>
+static size_t _nbytes(SparseMatrixT const &M)
+{
+    return M.nonZeros() * (sizeof(typename SparseMatrixT::Scalar) + sizeof(dense_index_type))
+        + (M.outerSize()+1) * sizeof(dense_index_type);
+}
+
+size_t CompactSparseMatrix::nbytes() const
+{
+    load();
+    if (M_f) return _nbytes(*M_f);
+    if (M_d) return _nbytes(*M_d);
+    return 0;
+}
+
+EigenSparseMatrixT CompactSparseMatrix::to_double() const
+{
+    load();
+    if (M_f) return M_f->cast<double>();
+    if (M_d) return *M_d;
+    return EigenSparseMatrixT();
+}
+
+void CompactSparseMatrix::ncio(NcIO &ncio, std::string const &vname)
+{
+    if (ncio.rw == 'r') {
+        lazy_fname.clear();
+        M_f.reset();
+        M_d.reset(new EigenSparseMatrixT);
+        ncio_eigen(ncio, *M_d, vname);
+    } else if (load(), M_f) {
+        _ncio_d.reset(new EigenSparseMatrixT(to_double()));
+        ncio_eigen(ncio, *_ncio_d, vname);
+    } else if (M_d) {
+        ncio_eigen(ncio, *M_d, vname);
+    }
+}
+
+// -----------------------------------------------------------------
+// Compact (restart) form
+
+void nc_deflate(NcGroup const *nc, NcVar const &var)
+{
+    NcLayout().configure(var);
+}
+
+template<class SparseMatrixT>
+static void ncwrite_compact(NcGroup *nc, SparseMatrixT const *M, std::string const &vname)
+{
+    auto const *outer(M->outerIndexPtr());
+    auto const *inner(M->innerIndexPtr());
+    std::vector<int> counts(M->outerSize());
+    std::vector<int> dinner(M->nonZeros());
+    for (int k=0; k<M->outerSize(); ++k) {
+        counts[k] = outer[k+1] - outer[k];
+        int last = 0;
+        for (int p=outer[k]; p<outer[k+1]; ++p) {
+            dinner[p] = inner[p] - last;
+            last = inner[p];
+        }
+    }
+
+    nc->getVar(vname + ".counts").putVar({0}, {counts.size()}, counts.data());
+    nc->getVar(vname + ".dinner").putVar({0}, {dinner.size()}, dinner.data());
+    nc->getVar(vname + ".values").putVar({0}, {dinner.size()}, M->valuePtr());
+}
+
+/** Inverse of ncwrite_compact() */
+template<class SparseMatrixT, class ValT>
+static void fill_compact(SparseMatrixT &M, long rows, long cols, long nnz,
+    blitz::Array<int,1> const &counts,
+    blitz::Array<int,1> const &dinner,
+    blitz::Array<ValT,1> const &values)
+{
+    M.resize(rows, cols);
+    M.resizeNonZeros(nnz);
+    auto *outer(M.outerIndexPtr());
+    auto *inner(M.innerIndexPtr());
+    auto *val(M.valuePtr());
+
+    outer[0] = 0;
+    for (int k=0; k<M.outerSize(); ++k) {
+        outer[k+1] = outer[k] + counts(k);
+        int last = 0;
+        for (int p=outer[k]; p<outer[k+1]; ++p) {
+            last += dinner(p);
+            inner[p] = last;
+            val[p] = values(p);
+        }
+    }
+}
+
+bool CompactSparseMatrix::has_compact(NcGroup const *nc, std::string const &vname)
+    { return !nc->getVar(vname + ".compact").isNull(); }
+
+void CompactSparseMatrix::ncio_compact(NcIO &ncio, std::string const &vname)
+{
+    if (ncio.rw == 'r') {
+        if (!has_compact(ncio.nc, vname)) (*icebin_error)(-1,
+            "No compact matrix %s in %s", vname.c_str(), ncio.fname.c_str());
+        M_d.reset();
+        M_f.reset();
+        lazy_fname = ncio.fname;
+        lazy_vname = vname;
+        return;
+    }
+
+    load();
+    if (empty()) (*icebin_error)(-1,
+        "CompactSparseMatrix::ncio_compact(): %s is empty", vname.c_str());
+    if (M_d) M_d->makeCompressed();
+    long rows_ = rows();
+    long cols_ = cols();
+    long nouter = M_f ? M_f->outerSize() : M_d->outerSize();
+    long nnz = M_f ? M_f->nonZeros() : M_d->nonZeros();
+    int single = (M_f ? 1 : 0);
+
+    auto info_v = get_or_add_var(ncio, vname + ".compact", "int", {});
+    get_or_put_att(info_v, ncio.rw, "rows", "int64", &rows_, 1);
+    get_or_put_att(info_v, ncio.rw, "cols", "int64", &cols_, 1);
+    get_or_put_att(info_v, ncio.rw, "nnz", "int64", &nnz, 1);
+    get_or_put_att(info_v, ncio.rw, "single", "int", &single, 1);
+
+    // (NetCDF dimensions cannot be zero-length)
+    auto dims_outer(get_or_add_dims(ncio, {vname + ".nouter"}, {std::max(nouter, 1L)}));
+    auto dims_nnz(get_or_add_dims(ncio, {vname + ".nnz"}, {std::max(nnz, 1L)}));
+    nc_deflate(ncio.nc, get_or_add_var(ncio, vname + ".counts", "int", dims_outer));
+    nc_deflate(ncio.nc, get_or_add_var(ncio, vname + ".dinner", "int", dims_nnz));
+    nc_deflate(ncio.nc, get_or_add_var(ncio, vname + ".values",
+        (single ? "float" : "double"), dims_nnz));
+
+    if (M_f) ncio += std::bind(&ncwrite_compact<FloatMatrixT>, ncio.nc, &*M_f, vname);
+    else ncio += std::bind(&ncwrite_compact<EigenSparseMatrixT>, ncio.nc, &*M_d, vname);
+}
+
+void CompactSparseMatrix::load() const
+{
+    if (lazy_fname.empty()) return;
+    ICEBIN_PROFILE_SCOPE("CompactSparseMatrix::load");
+    std::lock_guard<std::mutex> nc_lock(netcdf_mutex);
+
+    NcIO ncio(lazy_fname, 'r');
+    NcVar info_v(ncio.nc->getVar(lazy_vname + ".compact"));
+    long rows_, cols_, nnz;
+    int single;
+    get_or_put_att(info_v, 'r', "rows", "int64", &rows_, 1);
+    get_or_put_att(info_v, 'r', "cols", "int64", &cols_, 1);
+    get_or_put_att(info_v, 'r', "nnz", "int64", &nnz, 1);
+    get_or_put_att(info_v, 'r', "single", "int", &single, 1);
+
+    auto counts(nc_read_blitz<int,1>(ncio.nc, lazy_vname + ".counts"));
+    auto dinner(nc_read_blitz<int,1>(ncio.nc, lazy_vname + ".dinner"));
+    if (single) {
+        auto values(nc_read_blitz<float,1>(ncio.nc, lazy_vname + ".values"));
+        M_f.reset(new FloatMatrixT);
+        fill_compact(*M_f, rows_, cols_, nnz, counts, dinner, values);
+    } else {
+        auto values(nc_read_blitz<double,1>(ncio.nc, lazy_vname + ".values"));
+        M_d.reset(new EigenSparseMatrixT);
+        fill_compact(*M_d, rows_, cols_, nnz, counts, dinner, values);
+    }
+    ICEBIN_PROFILE_NNZ(nnz);
+    lazy_fname.clear();
+}
+
+// -----------------------------------------------------------------
+CompactWeighted::CompactWeighted(linear::Weighted_Eigen &&BvA, MatrixPrecision precision)
+    : M(std::move(*BvA.M), precision),
+    wM(BvA.wM), Mw(BvA.Mw), conservative(BvA.conservative)
+{
+    BvA.M.reset();
+}
+
+std::unique_ptr<linear::Weighted_Eigen> CompactWeighted::to_weighted() const
+{
+    std::unique_ptr<linear::Weighted_Eigen> ret(
+        new linear::Weighted_Eigen({nullptr, nullptr}, conservative));
+    ret->M.reset(new EigenSparseMatrixT(M.to_double()));
+    ret->wM.reference(wM);
+    ret->Mw.reference(Mw);
+    return ret;
+}
+
+void CompactWeighted::ncwrite(NcIO &ncio, std::string const &vname,
+    std::array<std::string,2> const &dim_names)
+{
+    if (ncio.rw != 'w') (*icebin_error)(-1,
+        "CompactWeighted::ncwrite(%s) only writes, no read.", vname.c_str());
+
+    _ncio_tmp = to_weighted();
+    _ncio_tmp->ncio(ncio, vname, {dim_names[0], dim_names[1]});
+}
+
+void CompactWeighted::ncio_compact(NcIO &ncio, std::string const &vname)
+{
+    auto info_v = get_or_add_var(ncio, vname + ".info", "int", {});
+    get_or_put_att(info_v, ncio.rw, "conservative", &conservative, 1);
+
+    ncio_blitz_alloc(ncio, wM, vname + ".wM", "double",
+        get_or_add_dims(ncio, wM, {vname + ".wM.n"}));
+    ncio_blitz_alloc(ncio, Mw, vname + ".Mw", "double",
+        get_or_add_dims(ncio, Mw, {vname + ".Mw.n"}));
+    M.ncio_compact(ncio, vname + ".M");
+}
+
+}    // namespace icebin
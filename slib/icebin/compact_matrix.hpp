@@ -0,0 +1,131 @@
+#ifndef ICEBIN_COMPACT_MATRIX_HPP
+#define ICEBIN_COMPACT_MATRIX_HPP
+
+#include <memory>
+#include <ibmisc/enum.hpp>
+#include <ibmisc/netcdf.hpp>
+#include <ibmisc/linear/eigen.hpp>
+#include <icebin/eigen_types.hpp>
+#include <icebin/RegridMatrices_Dynamic.hpp>
+
+namespace icebin {
+
+/** Applies the default NcLayout (chunking, shuffle + deflate) to a
+variable being defined, if the file supports it (NetCDF-4) */
+void nc_deflate(netCDF::NcGroup const *nc, netCDF::NcVar const &var);
+
+/** Storage policy for regrid matrices kept around between coupling
+timesteps (IceCoupler::IvE0, GCMCoupler::XuE0s). */
+BOOST_ENUM_VALUES( MatrixPrecision, int,
+    (DOUBLE)    (0)     // Store as computed
+    (SINGLE)    (1)     // Store values as float; widen to double on use
+);
+
+/** A sparse matrix held at reduced precision between uses.  Indices
+are always 32-bit (dense_index_type).  Values are optionally stored
+as float; all arithmetic is still done in double. */
+class CompactSparseMatrix {
+public:
+    typedef Eigen::SparseMatrix<float, 0, dense_index_type> FloatMatrixT;
+private:
+    // Mutable so a matrix read by ncio_compact() can be loaded on first use
+    mutable std::unique_ptr<EigenSparseMatrixT> M_d;
+    mutable std::unique_ptr<FloatMatrixT> M_f;
+
+    // Set by ncio_compact() on read: where to load the matrix from
+    mutable std::string lazy_fname;
+    std::string lazy_vname;
+
+    // Widened copy of M_f, kept alive for NcIO's deferred write
+    std::unique_ptr<EigenSparseMatrixT> _ncio_d;
+
+public:
+    /** Loads the matrix now, if it was read lazily by ncio_compact() */
+    void load() const;
+
+    CompactSparseMatrix() {}
+    CompactSparseMatrix(EigenSparseMatrixT &&M, MatrixPrecision precision);
+
+    bool empty() const { return !M_d && !M_f && lazy_fname.empty(); }
+    /** Shape of the matrix; (0,0) if empty() */
+    long rows() const { load(); return M_f ? M_f->rows() : M_d ? M_d->rows() : 0; }
+    long cols() const { load(); return M_f ? M_f->cols() : M_d ? M_d->cols() : 0; }
+
+    /** Resident size of the stored matrix [bytes] */
+    size_t nbytes() const;
+
+    /** Returns a double-precision copy of the matrix */
+    EigenSparseMatrixT to_double() const;
+
+    /** Reads (as double) or writes the matrix; same NetCDF
+    representation as spsparse::ncio_eigen(). */
+    void ncio(ibmisc::NcIO &ncio, std::string const &vname);
+
+    /** Reads or writes the matrix in compact form, for restart
+    files: per-column counts and delta-encoded (sorted) row indices,
+    with values at the stored precision; deflated if the file is
+    NetCDF-4.  Reading is lazy: the matrix is loaded from the file
+    (which must still exist) on first use. */
+    void ncio_compact(ibmisc::NcIO &ncio, std::string const &vname);
+
+    /** @return True if vname was written by ncio_compact() */
+    static bool has_compact(netCDF::NcGroup const *nc, std::string const &vname);
+
+    /** Calls fn() on the stored matrix, at its stored precision */
+    template<class FnT>
+    void visit(FnT &&fn) const
+    {
+        load();
+        if (M_f) fn(*M_f);
+        else fn(*M_d);
+    }
+
+    /** Same as icebin::apply_multi(), using this matrix */
+    template<class TransT>
+    void apply_multi(
+        Eigen::Map<EigenDenseMatrixT const> const &A_e,
+        TransT const &trans,
+        EigenDenseMatrixT &B_e) const
+    {
+        load();
+        if (M_f) icebin::apply_multi(*M_f, A_e, trans, B_e);
+        else icebin::apply_multi(*M_d, A_e, trans, B_e);
+    }
+
+    template<class TransT>
+    EigenDenseMatrixT apply_multi(
+        Eigen::Map<EigenDenseMatrixT const> const &A_e,
+        TransT const &trans) const
+    {
+        EigenDenseMatrixT B_e;
+        apply_multi(A_e, trans, B_e);
+        return B_e;
+    }
+};
+
+/** A linear::Weighted_Eigen held at reduced precision; dims are not kept. */
+struct CompactWeighted {
+    CompactSparseMatrix M;
+    blitz::Array<double,1> wM, Mw;
+    bool conservative;
+
+    // Widened copy, kept alive for NcIO's deferred write
+    std::unique_ptr<ibmisc::linear::Weighted_Eigen> _ncio_tmp;
+
+    CompactWeighted() : conservative(true) {}
+    CompactWeighted(ibmisc::linear::Weighted_Eigen &&BvA, MatrixPrecision precision);
+
+    /** Returns a double-precision Weighted_Eigen (without dims) */
+    std::unique_ptr<ibmisc::linear::Weighted_Eigen> to_weighted() const;
+
+    /** Writes in the same form as linear::Weighted_Eigen::ncio() */
+    void ncwrite(ibmisc::NcIO &ncio, std::string const &vname,
+        std::array<std::string,2> const &dim_names);
+
+    /** Reads or writes with CompactSparseMatrix::ncio_compact();
+    wM and Mw are read right away. */
+    void ncio_compact(ibmisc::NcIO &ncio, std::string const &vname);
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -33,6 +33,8 @@ const unsigned INITIAL = 1;
 const unsigned PRIVATE = 2;
 // Allow NaN in ice_ovals?
 const unsigned ALLOW_NAN = 4;
+// Output needed in full on root, even with GCMCoupler::distributed_ice
+const unsigned ROOT = 8;
 
 extern std::string to_str(unsigned int flags);
 
@@ -253,14 +253,15 @@ void setup_modele_pism(GCMCoupler const *_gcm_coupler, IceCoupler *_ice_coupler)
     ice_output.add("mask", nan, "", "", contracts::INITIAL, "PISM land surface type");
 
     standard_names["elevmask_ice"] =
-    ice_output.add("elevmask_ice", nan, "", "", contracts::INITIAL | contracts::ALLOW_NAN,
+    ice_output.add("elevmask_ice", nan, "", "", contracts::INITIAL | contracts::ALLOW_NAN | contracts::ROOT,
         "Elevation of ice sheet; nan for grid cells off ice sheet.");
 
     standard_names["elevmask_land"] =
-    ice_output.add("elevmask_land", nan, "", "", contracts::INITIAL | contracts::ALLOW_NAN,
+    ice_output.add("elevmask_land", nan, "", "", contracts::INITIAL | contracts::ALLOW_NAN | contracts::ROOT,
         "Elevation of bare land+ice; nan for grid cells off land or ice (eg ocean).");
 
-    ice_output.add("ice_top_senth", nan, "J kg-1", "", contracts::INITIAL, "");
+    // (ROOT: used by _reconstruct_ice_ivalsI(), on root)
+    ice_output.add("ice_top_senth", nan, "J kg-1", "", contracts::INITIAL | contracts::ROOT, "");
 
     ice_output.add("basal_frictional_heating", nan, "W m-2", "", 0, "");
     ice_output.add("strain_heating", nan, "W m-2", "", 0, "");
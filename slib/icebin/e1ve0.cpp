@@ -2,6 +2,8 @@
 #include <algorithm>
 #include <set>
 #include <icebin/e1ve0.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/error.hpp>
 
 using namespace ibmisc;
 using namespace spsparse;
@@ -27,80 +29,240 @@ namespace e1ve0 {
 //
 // This will guarantee that E1vE0 is close to I; and E1vE0==I if E1==E0
 
-/** Sort a vector of Tuples by index, and sum entries with same index.
-TODO: Move to tuplelist.hpp */
-template<class IndexT, class ValT, int RANK>
-void consolidate(std::vector<spsparse::Tuple<IndexT,ValT,RANK>> &M)
+/** @return True if two (unscaled) XuE matrices have the same
+sparsity pattern, values and weights; the ice sheet's correction is
+then zero. */
+static bool same_XuE(
+    linear::Weighted_Eigen const &XuE0,
+    linear::Weighted_Eigen const &XuE1)
 {
-    // Must be at least 2 elements for this to make sense...
-    if (M.size() < 2) return;
-
-    // Sort by iX
-    std::sort(M.begin(), M.end());
-
-    // Eliminate duplicates
-    size_t j=0;
-    for (size_t i=1; i<M.size(); ++i) {
-        if (M[j].index() == M[i].index()) {
-            M[j].value() += M[i].value();
-        } else {
-            ++j;
-            M[j] = M[i];
+    EigenSparseMatrixT const &M0(*XuE0.M);
+    EigenSparseMatrixT const &M1(*XuE1.M);
+    if (M0.rows() != M1.rows() || M0.cols() != M1.cols()
+        || M0.nonZeros() != M1.nonZeros()) return false;
+
+    if (XuE0.wM.extent(0) != XuE1.wM.extent(0)) return false;
+    for (int i=0; i<XuE0.wM.extent(0); ++i)
+        if (XuE0.wM(i) != XuE1.wM(i)) return false;
+
+    for (int k=0; k<M0.outerSize(); ++k) {
+        EigenSparseMatrixT::InnerIterator i0(M0,k), i1(M1,k);
+        for (; i0 && i1; ++i0, ++i1) {
+            if (i0.index() != i1.index() || i0.value() != i1.value()) return false;
         }
+        if (i0 || i1) return false;
     }
-    M.resize(j+1);
+    return true;
 }
 
+/** Computes XvE0 - XvE1 by a merge-join over the (sorted) inner
+vectors of XuE0 and XuE1.  Entries that did not change are left
+out, so the product with E1uX only costs as much as what changed. */
+static EigenSparseMatrixT diff_XvE(
+    linear::Weighted_Eigen const &XuE0,
+    linear::Weighted_Eigen const &XuE1)
+{
+    EigenSparseMatrixT const &M0(*XuE0.M);
+    EigenSparseMatrixT const &M1(*XuE1.M);
+    if (M0.rows() != M1.rows() || M0.cols() != M1.cols()) (*icebin_error)(-1,
+        "XuE0 (%ld x %ld) and XuE1 (%ld x %ld) must have the same shape",
+        (long)M0.rows(), (long)M0.cols(), (long)M1.rows(), (long)M1.cols());
+
+    blitz::Array<double,1> sXuE0(1. / XuE0.wM);
+    blitz::Array<double,1> sXuE1(1. / XuE1.wM);
+
+    std::vector<Eigen::Triplet<double>> diffs;
+    for (int k=0; k<M0.outerSize(); ++k) {
+        EigenSparseMatrixT::InnerIterator i0(M0,k), i1(M1,k);
+        while (i0 || i1) {
+            int row, col;
+            double val;
+            if (i0 && (!i1 || i0.index() < i1.index())) {
+                row = i0.row(); col = i0.col();
+                val = sXuE0(row) * i0.value();
+                ++i0;
+            } else if (!i0 || i1.index() < i0.index()) {
+                row = i1.row(); col = i1.col();
+                val = - sXuE1(row) * i1.value();
+                ++i1;
+            } else {
+                row = i0.row(); col = i0.col();
+                val = sXuE0(row) * i0.value() - sXuE1(row) * i1.value();
+                ++i0; ++i1;
+            }
+            if (val != 0) diffs.push_back(Eigen::Triplet<double>(row, col, val));
+        }
+    }
+
+    EigenSparseMatrixT ret(M1.rows(), M1.cols());
+    ret.setFromTriplets(diffs.begin(), diffs.end());
+    return ret;
+}
 
 spsparse::TupleList<int,double,2> compute_E1vE0c(
 std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE1s,  // sparsified
 std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE0s,  // sparsified
-unsigned long nE,            // Size of (sparse) E vector space, never changes
+unsigned long nE,            // Size of E vector space of XuE1s and XuE0s
 std::vector<double> const &areaX)
 {
+    ICEBIN_PROFILE_SCOPE("compute_E1vE0c");
     spsparse::TupleList<int,double,2> E1vE0c;
     blitz::Array<double,1> sE1(nE);
     sE1 = 0;
 
     // 1. Compute UNSCALED correction matrix, per ice sheet
-    // 2. Concatenate per-ice-sheet correction matrix into overall correction matrix
+    // 2. Sum per-ice-sheet correction matrix into overall correction matrix
     // correct_unscaled = sum_{ice sheet}[ E1uX * (XvE0 - XvE1) ]
+    EigenSparseMatrixT E1vE0c_unscaled;
+    bool changed = false;
     for (size_t i=0; i<XuE1s.size(); ++i) {
-        // -------- 1. Compute UNSCALED correction matrix, per ice sheet
         linear::Weighted_Eigen const *XuE1 = &*XuE1s[i];
         linear::Weighted_Eigen const *XuE0 = &*XuE0s[i];
 
-        blitz::Array<double,1> sXuE0(1. / XuE0->wM);
-        blitz::Array<double,1> sXuE1(1. / XuE1->wM);
+        for (int i=0; i<XuE1->Mw.extent(0); ++i) sE1(i) += XuE1->Mw(i);
 
-        // blitz::Array<double,1> XuE1s(1. / XuE1->Mw);
-        // auto E1vX(map_eigen_diagonal(XuE1s) * XuE1->M->transpose())
-        auto E1uX(XuE1->M->transpose());
-        auto XvE1(map_eigen_diagonal(sXuE1) * *XuE1->M);
-        auto XvE0(map_eigen_diagonal(sXuE0) * *XuE0->M);
+        // Elevation classes did not change for this ice sheet
+        if (same_XuE(*XuE0, *XuE1)) continue;
 
-        // -------- 2. Concatenate per-ice-sheet correction matrices
-        // Assemble the correction matrix, and sparsify its indexing.
-        // EigenSparseMatrixT correct_unscaled(E1uX*XvE0 - E1uX*XvE1);
-        EigenSparseMatrixT E1vE0c_local(E1uX*(XvE0 - XvE1));
-        spcopy(
-            accum::ref(E1vE0c),
-            E1vE0c_local);
+        // -------- 1. Compute UNSCALED correction matrix, per ice sheet
+        // (Only the rows of X that changed)
+        EigenSparseMatrixT E1vE0c_local(
+            XuE1->M->transpose() * diff_XvE(*XuE0, *XuE1));
 
-        for (int i=0; i<XuE1->Mw.extent(0); ++i) sE1(i) += XuE1->Mw(i);
+        // -------- 2. Sum per-ice-sheet correction matrices
+        if (!changed) E1vE0c_unscaled = std::move(E1vE0c_local);
+        else E1vE0c_unscaled += E1vE0c_local;
+        changed = true;
     }
+    if (!changed) return E1vE0c;    // E1vE0 = I
 
     // Convert merged weights to scale factor
     for (int i=0; i<sE1.extent(0); ++i) sE1(i) = 1. / sE1(i);
 
     // E1vE0c = sE1 * E1vE0c_unscaled
-    for (auto ii(E1vE0c.begin()); ii != E1vE0c.end(); ++ii) {
-        long const iE1(ii->index(0));
-        ii->value() *= sE1(iE1);
+    // Row-major traversal yields tuples sorted by (iE1, iE0), already
+    // consolidated, without a separate sort.
+    Eigen::SparseMatrix<double, Eigen::RowMajor> E1vE0c_rows(E1vE0c_unscaled);
+    E1vE0c.tuples.reserve(E1vE0c_rows.nonZeros());
+    for (int iE1=0; iE1<E1vE0c_rows.outerSize(); ++iE1) {
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator ii(E1vE0c_rows, iE1); ii; ++ii) {
+            E1vE0c.add({iE1, (int)ii.col()}, ii.value() * sE1(iE1));
+        }
     }
+    ICEBIN_PROFILE_NNZ(E1vE0c.tuples.size());
+
+    return E1vE0c;
+}
+
+void compute_E1vE0c_factors(
+std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE1s,  // sparsified
+std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE0s,  // sparsified
+unsigned long nE,
+spsparse::TupleList<int,double,2> &E1vXc,
+spsparse::TupleList<int,double,2> &XvE0c)
+{
+    ICEBIN_PROFILE_SCOPE("compute_E1vE0c_factors");
+    blitz::Array<double,1> sE1(nE);
+    sE1 = 0;
 
-    // Tidy up by consolidating
-    consolidate(E1vE0c.tuples);
+    // Same as compute_E1vE0c(), but without multiplying out
+    // E1uX * (XvE0 - XvE1).  Only the rows of X that changed are
+    // kept, renumbered 0..nXc-1 across all ice sheets.
+    std::vector<Eigen::Triplet<double>> E1uXc_t, XvE0c_t;
+    int nXc = 0;
+    for (size_t i=0; i<XuE1s.size(); ++i) {
+        linear::Weighted_Eigen const *XuE1 = &*XuE1s[i];
+        linear::Weighted_Eigen const *XuE0 = &*XuE0s[i];
+
+        for (int i=0; i<XuE1->Mw.extent(0); ++i) sE1(i) += XuE1->Mw(i);
+
+        // Elevation classes did not change for this ice sheet
+        if (same_XuE(*XuE0, *XuE1)) continue;
+
+        EigenSparseMatrixT const diff(diff_XvE(*XuE0, *XuE1));
+        std::vector<int> jX(diff.rows(), -1);    // Row of X --> row of Xc
+        for (int k=0; k<diff.outerSize(); ++k) {
+            for (EigenSparseMatrixT::InnerIterator ii(diff,k); ii; ++ii) {
+                int &j(jX[ii.row()]);
+                if (j < 0) j = nXc++;
+                XvE0c_t.push_back(Eigen::Triplet<double>(j, ii.col(), ii.value()));
+            }
+        }
+
+        EigenSparseMatrixT const &M1(*XuE1->M);
+        for (int k=0; k<M1.outerSize(); ++k) {
+            for (EigenSparseMatrixT::InnerIterator ii(M1,k); ii; ++ii) {
+                int const j = jX[ii.row()];
+                if (j >= 0) E1uXc_t.push_back(Eigen::Triplet<double>(ii.col(), j, ii.value()));
+            }
+        }
+    }
+
+    E1vXc = spsparse::TupleList<int,double,2>();
+    XvE0c = spsparse::TupleList<int,double,2>();
+    if (nXc == 0) return;    // E1vE0 = I
+
+    // E1vXc = sE1 * E1uXc
+    E1vXc.set_shape({(int)nE, nXc});
+    E1vXc.tuples.reserve(E1uXc_t.size());
+    for (auto const &t : E1uXc_t)
+        E1vXc.add({t.row(), t.col()}, t.value() / sE1(t.row()));
+
+    XvE0c.set_shape({nXc, (int)nE});
+    XvE0c.tuples.reserve(XvE0c_t.size());
+    for (auto const &t : XvE0c_t)
+        XvE0c.add({t.row(), t.col()}, t.value());
+
+    ICEBIN_PROFILE_NNZ(E1vXc.tuples.size() + XvE0c.tuples.size());
+}
+
+spsparse::TupleList<int,double,2> multiply_E1vE0c(
+spsparse::TupleList<int,double,2> const &E1vXc,
+spsparse::TupleList<int,double,2> const &XvE0c)
+{
+    ICEBIN_PROFILE_SCOPE("multiply_E1vE0c");
+    spsparse::TupleList<int,double,2> E1vE0c;
+    if (E1vXc.shape()[0] == -1) return E1vE0c;    // E1vE0 = I
+
+    int const nE = E1vXc.shape()[0];
+    int const nXc = E1vXc.shape()[1];
+
+    // Multiply over just the E points these factors use (sorted, so
+    // the result stays sorted), not all of nE
+    std::vector<int> iEs;
+    iEs.reserve(E1vXc.tuples.size() + XvE0c.tuples.size());
+    for (auto ii(E1vXc.begin()); ii != E1vXc.end(); ++ii) iEs.push_back(ii->index(0));
+    for (auto ii(XvE0c.begin()); ii != XvE0c.end(); ++ii) iEs.push_back(ii->index(1));
+    std::sort(iEs.begin(), iEs.end());
+    iEs.erase(std::unique(iEs.begin(), iEs.end()), iEs.end());
+    int const nEl = iEs.size();
+    auto const local([&iEs](int iE) -> int
+        { return std::lower_bound(iEs.begin(), iEs.end(), iE) - iEs.begin(); });
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(E1vXc.tuples.size());
+    for (auto ii(E1vXc.begin()); ii != E1vXc.end(); ++ii)
+        triplets.push_back(Eigen::Triplet<double>(local(ii->index(0)), ii->index(1), ii->value()));
+    EigenSparseMatrixT E1vX(nEl, nXc);
+    E1vX.setFromTriplets(triplets.begin(), triplets.end());
+
+    triplets.clear();
+    triplets.reserve(XvE0c.tuples.size());
+    for (auto ii(XvE0c.begin()); ii != XvE0c.end(); ++ii)
+        triplets.push_back(Eigen::Triplet<double>(ii->index(0), local(ii->index(1)), ii->value()));
+    EigenSparseMatrixT XvE0(nXc, nEl);
+    XvE0.setFromTriplets(triplets.begin(), triplets.end());
+
+    // Row-major, as in compute_E1vE0c()
+    Eigen::SparseMatrix<double, Eigen::RowMajor> E1vE0c_rows(E1vX * XvE0);
+    E1vE0c.set_shape({nE, nE});
+    E1vE0c.tuples.reserve(E1vE0c_rows.nonZeros());
+    for (int iE1=0; iE1<E1vE0c_rows.outerSize(); ++iE1) {
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator ii(E1vE0c_rows, iE1); ii; ++ii) {
+            E1vE0c.add({iEs[iE1], iEs[ii.col()]}, ii.value());
+        }
+    }
+    ICEBIN_PROFILE_NNZ(E1vE0c.tuples.size());
 
     return E1vE0c;
 }
@@ -19,14 +19,38 @@ NOTE: Actual matrix applied is (E1vE0 - I), based on correction factor idea
       Phrasing it in this way makes it easier a matrix of the type (I + C)
 @param XuE1s Latest set of per-ice-sheet XuE matrices (unscaled) (X = exchange grid)
 @param XuE0s Previous coupling-timestep set of XuE matrices
-@param nE Number of theoretical elevation classes (in sparse E indexing)
+@param nE Extent of the E indexing of XuE1s and XuE0s (GCMCoupler
+      uses its compact E indexing; see CompactE)
 @param areaX Area of each exchange gridcell. */
 extern TupleListT<2> compute_E1vE0c(
 std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE1s,
 std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE0s,
-unsigned long nE,            // Size of (sparse) E vector space, never changes
+unsigned long nE,            // Size of E vector space of XuE1s and XuE0s
 std::vector<double> const &areaX);
 
+/** Computes the same correction as compute_E1vE0c(), in factored form:
+    E1vE0c = E1vXc * XvE0c
+where Xc are the exchange grid cells (of all ice sheets) whose
+elevation class weights changed, numbered 0..nXc-1.  Each Xc cell
+lies in one GCM grid cell, so both factors split by MPI domain the
+same way as E1vE0c.  With many elevation classes, the factors are
+much smaller than their product.
+@param E1vXc OUTPUT: [nE x nXc], scaled.  Shape (-1,-1) if E1vE0 = I.
+@param XvE0c OUTPUT: [nXc x nE] (XvE0 - XvE1, for the Xc cells) */
+extern void compute_E1vE0c_factors(
+std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE1s,
+std::vector<std::unique_ptr<ibmisc::linear::Weighted_Eigen>> const &XuE0s,
+unsigned long nE,
+spsparse::TupleList<int,double,2> &E1vXc,
+spsparse::TupleList<int,double,2> &XvE0c);
+
+/** Multiplies out factors from compute_E1vE0c_factors(), or the part
+of them belonging to one MPI domain.
+@return E1vE0c, rows sorted; or an empty (unshaped) matrix if E1vE0 = I */
+extern spsparse::TupleList<int,double,2> multiply_E1vE0c(
+spsparse::TupleList<int,double,2> const &E1vXc,
+spsparse::TupleList<int,double,2> const &XvE0c);
+
 
 }}    // namespace
 #endif    // guard
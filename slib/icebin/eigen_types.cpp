@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <numeric>
+#include <vector>
 #include <spsparse/SparseSet.hpp>
+#include <icebin/error.hpp>
 #include <icebin/eigen_types.hpp>
 #include <ibmisc/linear/compressed.hpp>
 
@@ -33,4 +37,114 @@ std::array<SparseSetT *,2> dims)
     return BvA_m.to_eigen();
 }
 
+// ------------------------------------------------------------
+/** Index map of one dimension for sparsify(): dense to sparse
+through dim, or the identity. */
+static std::vector<int> sparsify_map(
+    SparsifyTransform transform, SparseSetT const *dim, int n)
+{
+    if (transform != SparsifyTransform::ID && transform != SparsifyTransform::TO_SPARSE)
+        (*icebin_error)(-1, "sparsify(): Only ID and TO_SPARSE transforms are supported");
+
+    std::vector<int> map(n);
+    for (int i=0; i<n; ++i)
+        map[i] = (transform == SparsifyTransform::ID ? i : dim->to_sparse(i));
+    return map;
+}
+
+/** @return Is an index map strictly increasing (ignoring -1 entries)? */
+static bool is_monotone(std::vector<int> const &map)
+{
+    int last = -1;
+    for (int i : map) {
+        if (i < 0) continue;
+        if (i <= last) return false;
+        last = i;
+    }
+    return true;
+}
+
+EigenSparseMatrixT remap_M(
+    EigenSparseMatrixT const &M0,
+    std::vector<int> const &rowmap,
+    std::vector<int> const &colmap,
+    std::array<int,2> const &extent)
+{
+    EigenSparseMatrixT Mc;
+    EigenSparseMatrixT const *M = &M0;
+    if (!M0.isCompressed()) {
+        Mc = M0;
+        Mc.makeCompressed();
+        M = &Mc;
+    }
+
+    bool const rows_monotone = is_monotone(rowmap);
+    bool const cols_monotone = is_monotone(colmap);
+
+    int const nnz = M->nonZeros();
+    int const *outer0 = M->outerIndexPtr();
+    int const *inner0 = M->innerIndexPtr();
+    double const *val0 = M->valuePtr();
+
+    EigenSparseMatrixT S(extent[0], extent[1]);
+    S.resizeNonZeros(nnz);
+    int *outer = S.outerIndexPtr();
+    int *inner = S.innerIndexPtr();
+    double *val = S.valuePtr();
+
+    // Start of each new column: count its entries, then prefix sum
+    std::fill(outer, outer + extent[1] + 1, 0);
+    for (int j=0; j<M->cols(); ++j) {
+        int const n = outer0[j+1] - outer0[j];
+        if (colmap[j] >= 0) outer[colmap[j]+1] = n;
+        else if (n > 0) (*icebin_error)(-1,
+            "remap_M(): column %d has %d entries, but no new index", j, n);
+    }
+    std::partial_sum(outer, outer + extent[1] + 1, outer);
+
+    if (cols_monotone) {
+        // Columns stay in order: entries stay where they are
+        for (int k=0; k<nnz; ++k) inner[k] = rowmap[inner0[k]];
+        std::copy(val0, val0 + nnz, val);
+    } else {
+        for (int j=0; j<M->cols(); ++j) {
+            if (colmap[j] < 0) continue;
+            int const dst = outer[colmap[j]];
+            for (int k=outer0[j]; k<outer0[j+1]; ++k) {
+                inner[dst + k - outer0[j]] = rowmap[inner0[k]];
+                val[dst + k - outer0[j]] = val0[k];
+            }
+        }
+    }
+
+    if (!rows_monotone) {
+        std::vector<std::pair<int,double>> col;
+        for (int j=0; j<extent[1]; ++j) {
+            col.clear();
+            for (int k=outer[j]; k<outer[j+1]; ++k) col.push_back(std::make_pair(inner[k], val[k]));
+            std::sort(col.begin(), col.end(),
+                [](std::pair<int,double> const &a, std::pair<int,double> const &b)
+                { return a.first < b.first; });
+            for (size_t k=0; k<col.size(); ++k) {
+                inner[outer[j] + k] = col[k].first;
+                val[outer[j] + k] = col[k].second;
+            }
+        }
+    }
+
+    return S;
+}
+
+EigenSparseMatrixT sparsify_M(
+    EigenSparseMatrixT const &M0,
+    std::array<SparsifyTransform,2> const &transforms,
+    std::array<SparseSetT *,2> const &dims,
+    std::array<int,2> const &extent)
+{
+    return remap_M(M0,
+        sparsify_map(transforms[0], dims[0], M0.rows()),
+        sparsify_map(transforms[1], dims[1], M0.cols()),
+        extent);
+}
+
 }    // namespace
@@ -2,6 +2,7 @@
 #define ICEBIN_EIGEN_TYPES_HPP
 
 #include <array>
+#include <vector>
 #include <ibmisc/zarray.hpp>
 #include <spsparse/eigen.hpp>
 
@@ -40,6 +41,30 @@ EigenSparseMatrixT to_eigen_M(  // (generates in dense indexing)
 ibmisc::ZArray<int,double,2> const &BvA,
 std::array<SparseSetT *,2> dims);
 
+/** Remaps the indices of a (column-major) sparse matrix in its
+compressed arrays, rather than through triplets.  Columns are moved as
+whole blocks; if the row map is monotone, entries within each column
+stay sorted, and need no re-sort.
+@param rowmap New index of each row; must be one-to-one on the rows
+    that have entries (others may be -1)
+@param colmap New index of each column; or -1 to drop an (empty) column
+@param extent Shape of the result
+@return The same matrix as setFromTriplets() on the remapped triplets */
+EigenSparseMatrixT remap_M(
+    EigenSparseMatrixT const &M0,
+    std::vector<int> const &rowmap,
+    std::vector<int> const &colmap,
+    std::array<int,2> const &extent);
+
+/** Remaps the indices of a sparse matrix (see remap_M()) through the
+transforms of sparsify(): dense to sparse through dims, or the identity.
+@param transforms Only ID and TO_SPARSE are supported */
+EigenSparseMatrixT sparsify_M(
+    EigenSparseMatrixT const &M0,
+    std::array<spsparse::SparsifyTransform,2> const &transforms,
+    std::array<SparseSetT *,2> const &dims,
+    std::array<int,2> const &extent);
+
 }
 
 #endif
@@ -0,0 +1,73 @@
+#ifndef ICEBIN_FAST_INDEXING_HPP
+#define ICEBIN_FAST_INDEXING_HPP
+
+#include <array>
+#include <ibmisc/indexing.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+/** An ibmisc::Indexing of fixed rank, with the stride of each
+dimension precomputed.  Converts the same way as Indexing (tuples are
+in the Indexing's order of dimensions, not of strides), but without
+looping over dimensions at runtime: tuple_to_index() is RANK
+multiply-adds.  For use in inner loops; see
+GCMRegridder::fast_indexingHC. */
+template<int RANK>
+class FastIndexing {
+    std::array<long,RANK> _base;
+    std::array<long,RANK> _extent;
+    std::array<long,RANK> _stride;
+    std::array<int,RANK> _order;    // Dimensions by decreasing stride (Indexing::indices())
+    bool _valid = false;
+
+public:
+    /** An invalid FastIndexing; to be assigned later */
+    FastIndexing() {}
+
+    explicit FastIndexing(ibmisc::Indexing const &indexing)
+    {
+        if (indexing.rank() != RANK) (*icebin_error)(-1,
+            "FastIndexing<%d>: Indexing has rank %d", RANK, (int)indexing.rank());
+
+        for (int k=0; k<RANK; ++k) {
+            _base[k] = indexing[k].base;
+            _extent[k] = indexing[k].extent;
+            _order[k] = indexing.indices()[k];
+        }
+        long stride = 1;
+        for (int d=RANK-1; d>=0; --d) {
+            _stride[_order[d]] = stride;
+            stride *= _extent[_order[d]];
+        }
+        _valid = true;
+    }
+
+    /** Was this constructed from an Indexing? */
+    bool valid() const { return _valid; }
+
+    long extent(int k) const { return _extent[k]; }
+
+    long tuple_to_index(std::array<long,RANK> const &tuple) const
+    {
+        long ix = 0;
+        for (int k=0; k<RANK; ++k) ix += (tuple[k] - _base[k]) * _stride[k];
+        return ix;
+    }
+
+    template<class TupleT = long>
+    std::array<TupleT,RANK> index_to_tuple(long ix) const
+    {
+        std::array<TupleT,RANK> tuple;
+        for (int d=RANK-1; d>0; --d) {
+            int const k = _order[d];
+            tuple[k] = (TupleT)(ix % _extent[k] + _base[k]);
+            ix /= _extent[k];
+        }
+        tuple[_order[0]] = (TupleT)(ix + _base[_order[0]]);
+        return tuple;
+    }
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -0,0 +1,133 @@
+#include <mpi.h>        // Intel MPI wants to be first
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+#include <icebin/file_stage.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+/** Largest MPI_Bcast() done at once (counts are int) */
+static long const BCAST_MAX = INT_MAX / 2;
+
+FileStager::FileStager(MPI_Comm _comm, int root, std::string const &local_dir)
+    : comm(_comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Order ranks so the root comes first, on its node and among leaders
+    int const key = (rank == root ? 0 : rank+1);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, key, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_split(comm, (node_rank == 0 ? 0 : MPI_UNDEFINED), key, &leader_comm);
+
+    // Name the staging directory after the root's PID; mkdtemp() makes
+    // it unique, so concurrent jobs sharing a node (possibly with the
+    // same root PID, from another container) never share a directory.
+    long pid = (rank == root ? (long)getpid() : 0);
+    MPI_Bcast(&pid, 1, MPI_LONG, root, comm);
+
+    int ok = 1;
+    std::string const templ(local_dir + "/icebin-" + std::to_string(pid) + "-XXXXXX");
+    std::vector<char> dirbuf(templ.begin(), templ.end());
+    dirbuf.push_back('\0');
+    if (node_rank == 0 && !mkdtemp(dirbuf.data())) {
+        fprintf(stderr, "Cannot create staging directory %s: %s\n",
+            templ.c_str(), strerror(errno));
+        ok = 0;
+    }
+
+    // The rest of the node uses the directory its leader made
+    MPI_Bcast(dirbuf.data(), dirbuf.size(), MPI_CHAR, 0, node_comm);
+    dir = std::string(dirbuf.data());
+
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) (*icebin_error)(-1,
+        "Cannot create staging directory %s", dir.c_str());
+}
+
+FileStager::~FileStager()
+{
+    if (node_rank == 0) {
+        for (auto const &ii : staged) std::remove(ii.second.c_str());
+        rmdir(dir.c_str());
+    }
+
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (!finalized) {
+        if (leader_comm != MPI_COMM_NULL) MPI_Comm_free(&leader_comm);
+        MPI_Comm_free(&node_comm);
+    }
+}
+
+/** Reads a whole file; size -1 (and empty) if it cannot be read */
+static long read_file(std::string const &fname, std::vector<char> &buf)
+{
+    FILE *fin = fopen(fname.c_str(), "rb");
+    if (!fin) return -1;
+    fseek(fin, 0, SEEK_END);
+    long const size = ftell(fin);
+    fseek(fin, 0, SEEK_SET);
+    buf.resize(std::max(size, 0L));
+    bool const ok = (size >= 0 && fread(buf.data(), 1, size, fin) == (size_t)size);
+    fclose(fin);
+    if (!ok) buf.clear();
+    return (ok ? size : -1);
+}
+
+std::string const &FileStager::stage(std::string const &fname)
+{
+    auto ii(staged.find(fname));
+    if (ii != staged.end()) return ii->second;
+
+    std::string const local_fname(dir + "/" + std::to_string(staged.size())
+        + "-" + boost::filesystem::path(fname).filename().string());
+
+    // Leader rank 0 is the root: it reads the file and sends it to the
+    // other nodes.  Ranks that are not node leaders just wait.
+    int ok = 1;
+    if (leader_comm != MPI_COMM_NULL) {
+        int leader_rank;
+        MPI_Comm_rank(leader_comm, &leader_rank);
+
+        std::vector<char> buf;
+        long size = 0;
+        if (leader_rank == 0) size = read_file(fname, buf);
+        MPI_Bcast(&size, 1, MPI_LONG, 0, leader_comm);
+
+        if (size < 0) {
+            if (leader_rank == 0) fprintf(stderr,
+                "Cannot read %s for staging\n", fname.c_str());
+            ok = 0;
+        } else {
+            buf.resize(size);
+            for (long i0=0; i0 < size; i0 += BCAST_MAX) {
+                int const n = std::min(BCAST_MAX, size - i0);
+                MPI_Bcast(buf.data() + i0, n, MPI_BYTE, 0, leader_comm);
+            }
+
+            FILE *fout = fopen(local_fname.c_str(), "wb");
+            ok = (fout && fwrite(buf.data(), 1, size, fout) == (size_t)size);
+            if (fout && fclose(fout) != 0) ok = 0;
+            if (!ok) fprintf(stderr, "Cannot write staged copy %s: %s\n",
+                local_fname.c_str(), strerror(errno));
+        }
+    }
+
+    // Doubles as the barrier: no rank opens its copy before it is written
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) (*icebin_error)(-1,
+        "Failed to stage %s into %s", fname.c_str(), local_fname.c_str());
+
+    return staged.insert(std::make_pair(fname, local_fname)).first->second;
+}
+
+}    // namespace icebin
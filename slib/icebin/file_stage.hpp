@@ -0,0 +1,50 @@
+#ifndef ICEBIN_FILE_STAGE_HPP
+#define ICEBIN_FILE_STAGE_HPP
+
+#include <mpi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace icebin {
+
+/** Collective startup read of input files.
+
+Without it, every GCM rank opens the IceBin config and grid files on
+the shared filesystem at once.  With a FileStager, only the root rank
+reads a file; it broadcasts the bytes to one rank per node, which
+writes them into a node-local directory (eg /dev/shm, which is shared
+memory).  All ranks then open that copy.  The staged copies are
+removed when the FileStager is destroyed.
+
+NOTE: Files found next to the original (bincsr / bingrid sidecars)
+are not staged along with it. */
+class FileStager {
+    MPI_Comm const comm;     // Not owned
+    MPI_Comm node_comm;      // Ranks on this node; root of gcm_comm is node rank 0
+    MPI_Comm leader_comm;    // Node rank 0 of each node (MPI_COMM_NULL elsewhere)
+    int node_rank;
+
+    /** Per-job directory inside the node-local directory (from mkdtemp()) */
+    std::string dir;
+
+    /** Original filename --> staged copy */
+    std::map<std::string, std::string> staged;
+
+public:
+    /** Collective over comm, which must outlive the FileStager.
+    @param local_dir Node-local directory to stage into (eg: /dev/shm) */
+    FileStager(MPI_Comm comm, int root, std::string const &local_dir);
+    ~FileStager();
+
+    FileStager(FileStager const &) = delete;
+    FileStager &operator=(FileStager const &) = delete;
+
+    /** Collective over comm: all ranks must stage the same files in
+    the same order.  A file is only staged once.
+    @return Name of the node-local copy of fname */
+    std::string const &stage(std::string const &fname);
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cuda_runtime.h>
+#include <cusparse.h>
+#include <icebin/gpu_spmv.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+static void check_cuda(cudaError_t err, char const *what)
+{
+    if (err != cudaSuccess) (*icebin_error)(-1,
+        "GPUMatrix: %s failed: %s", what, cudaGetErrorString(err));
+}
+
+static void check_cusparse(cusparseStatus_t err, char const *what)
+{
+    if (err != CUSPARSE_STATUS_SUCCESS) (*icebin_error)(-1,
+        "GPUMatrix: %s failed: %s", what, cusparseGetErrorString(err));
+}
+
+/** Device memory, grown as needed */
+struct DeviceBuffer {
+    void *ptr = nullptr;
+    size_t nbytes = 0;
+
+    void reserve(size_t n)
+    {
+        if (n <= nbytes) return;
+        if (ptr) check_cuda(cudaFree(ptr), "cudaFree");
+        ptr = nullptr;
+        check_cuda(cudaMalloc(&ptr, n), "cudaMalloc");
+        nbytes = n;
+    }
+
+    ~DeviceBuffer() { if (ptr) cudaFree(ptr); }
+};
+
+struct GPUMatrix::Impl {
+    cusparseHandle_t handle = nullptr;
+    cusparseSpMatDescr_t M = nullptr;    // Describes rowptr, colind, vals
+    DeviceBuffer rowptr, colind, vals;
+    DeviceBuffer X, Y;                   // Dense operands of SpMM
+    DeviceBuffer work;                   // SpMM workspace
+
+    Impl() { check_cusparse(cusparseCreate(&handle), "cusparseCreate"); }
+
+    ~Impl()
+    {
+        if (M) cusparseDestroySpMat(M);
+        if (handle) cusparseDestroy(handle);
+    }
+};
+
+GPUMatrix::GPUMatrix() : impl(new Impl) {}
+GPUMatrix::~GPUMatrix() {}
+
+void GPUMatrix::upload(long nrow, long ncol, long nnz,
+    int const *rowptr, int const *colind, double const *vals)
+{
+    Impl &gpu(*impl);
+    if (gpu.M) {
+        check_cusparse(cusparseDestroySpMat(gpu.M), "cusparseDestroySpMat");
+        gpu.M = nullptr;
+    }
+
+    // Allocate at least one element, so pointers are never null
+    gpu.rowptr.reserve(sizeof(int) * (nrow+1));
+    gpu.colind.reserve(sizeof(int) * std::max(nnz,1L));
+    gpu.vals.reserve(sizeof(double) * std::max(nnz,1L));
+    check_cuda(cudaMemcpy(gpu.rowptr.ptr, rowptr, sizeof(int) * (nrow+1),
+        cudaMemcpyHostToDevice), "cudaMemcpy(rowptr)");
+    check_cuda(cudaMemcpy(gpu.colind.ptr, colind, sizeof(int) * nnz,
+        cudaMemcpyHostToDevice), "cudaMemcpy(colind)");
+    check_cuda(cudaMemcpy(gpu.vals.ptr, vals, sizeof(double) * nnz,
+        cudaMemcpyHostToDevice), "cudaMemcpy(vals)");
+
+    check_cusparse(cusparseCreateCsr(&gpu.M, nrow, ncol, nnz,
+        gpu.rowptr.ptr, gpu.colind.ptr, gpu.vals.ptr,
+        CUSPARSE_INDEX_32I, CUSPARSE_INDEX_32I,
+        CUSPARSE_INDEX_BASE_ZERO, CUDA_R_64F), "cusparseCreateCsr");
+
+    _rows = nrow;
+    _cols = ncol;
+    _nnz = nnz;
+}
+
+void GPUMatrix::spmm(double const *X, long nvar, double *Y)
+{
+    Impl &gpu(*impl);
+    if (!gpu.M) (*icebin_error)(-1,
+        "GPUMatrix::spmm(): No matrix has been uploaded");
+    if (nvar == 0 || _rows == 0) return;
+
+    size_t const nbX = sizeof(double) * _cols * nvar;
+    size_t const nbY = sizeof(double) * _rows * nvar;
+    gpu.X.reserve(std::max(nbX, sizeof(double)));
+    gpu.Y.reserve(nbY);
+    check_cuda(cudaMemcpy(gpu.X.ptr, X, nbX, cudaMemcpyHostToDevice),
+        "cudaMemcpy(X)");
+
+    cusparseDnMatDescr_t dX, dY;
+    check_cusparse(cusparseCreateDnMat(&dX, _cols, nvar, _cols,
+        gpu.X.ptr, CUDA_R_64F, CUSPARSE_ORDER_COL), "cusparseCreateDnMat(X)");
+    check_cusparse(cusparseCreateDnMat(&dY, _rows, nvar, _rows,
+        gpu.Y.ptr, CUDA_R_64F, CUSPARSE_ORDER_COL), "cusparseCreateDnMat(Y)");
+
+    double const alpha = 1.0;
+    double const beta = 0.0;
+    size_t nwork = 0;
+    check_cusparse(cusparseSpMM_bufferSize(gpu.handle,
+        CUSPARSE_OPERATION_NON_TRANSPOSE, CUSPARSE_OPERATION_NON_TRANSPOSE,
+        &alpha, gpu.M, dX, &beta, dY, CUDA_R_64F,
+        CUSPARSE_SPMM_ALG_DEFAULT, &nwork), "cusparseSpMM_bufferSize");
+    gpu.work.reserve(std::max(nwork, (size_t)1));
+    check_cusparse(cusparseSpMM(gpu.handle,
+        CUSPARSE_OPERATION_NON_TRANSPOSE, CUSPARSE_OPERATION_NON_TRANSPOSE,
+        &alpha, gpu.M, dX, &beta, dY, CUDA_R_64F,
+        CUSPARSE_SPMM_ALG_DEFAULT, gpu.work.ptr), "cusparseSpMM");
+
+    cusparseDestroyDnMat(dX);
+    cusparseDestroyDnMat(dY);
+
+    check_cuda(cudaMemcpy(Y, gpu.Y.ptr, nbY, cudaMemcpyDeviceToHost),
+        "cudaMemcpy(Y)");
+}
+
+}    // namespace icebin
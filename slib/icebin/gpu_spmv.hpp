@@ -0,0 +1,118 @@
+#ifndef ICEBIN_GPU_SPMV_HPP
+#define ICEBIN_GPU_SPMV_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <icebin/eigen_types.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+/** A regrid matrix kept resident in GPU memory (CSR) between
+coupling steps, and applied there to many fields at once.  The matrix
+is only uploaded again when its contents change.  Requires USE_CUDA;
+see gpu_spmv.cu. */
+class GPUMatrix {
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    // What is currently on the device
+    long _rows = -1, _cols = -1, _nnz = -1;
+    uint64_t fingerprint = 0;
+
+    /** Replaces the device copy of the matrix */
+    void upload(long nrow, long ncol, long nnz,
+        int const *rowptr, int const *colind, double const *vals);
+
+    /** Y = M * X on the device.
+    @param X [cols x nvar], column-major, on the host
+    @param Y OUTPUT: [rows x nvar], column-major, on the host */
+    void spmm(double const *X, long nvar, double *Y);
+
+    /** FNV-1a hash of a block of memory, continuing from h */
+    static uint64_t hash(void const *data, size_t nbytes, uint64_t h)
+    {
+        // Word-wise: these blocks are long, and always whole words
+        size_t const nwords = nbytes / sizeof(uint64_t);
+        char const *cdata = (char const *)data;
+        for (size_t i=0; i<nwords; ++i) {
+            uint64_t w;
+            std::memcpy(&w, cdata + i*sizeof(uint64_t), sizeof(w));
+            h = (h ^ w) * 1099511628211ull;
+        }
+        for (size_t i=nwords*sizeof(uint64_t); i<nbytes; ++i)
+            h = (h ^ (unsigned char)cdata[i]) * 1099511628211ull;
+        return h;
+    }
+
+public:
+    // Statistics
+    long nupload = 0;
+    long napply = 0;
+
+    GPUMatrix();
+    ~GPUMatrix();
+
+    long rows() const { return _rows; }
+    long cols() const { return _cols; }
+
+    /** Makes M the matrix on the device.  M is hashed (one pass over
+    its storage); it is converted and uploaded only if that differs
+    from what was uploaded last time.
+    @param M Column-major Eigen sparse matrix; values may be float */
+    template<class SparseMatrixT>
+    void set(SparseMatrixT const &M)
+    {
+        if (!M.isCompressed()) {
+            SparseMatrixT Mc(M);
+            Mc.makeCompressed();
+            set(Mc);
+            return;
+        }
+
+        uint64_t h = 14695981039346656037ull;
+        h = hash(M.outerIndexPtr(), sizeof(*M.outerIndexPtr()) * (M.outerSize()+1), h);
+        h = hash(M.innerIndexPtr(), sizeof(*M.innerIndexPtr()) * M.nonZeros(), h);
+        h = hash(M.valuePtr(), sizeof(*M.valuePtr()) * M.nonZeros(), h);
+        if (h == fingerprint && M.rows() == _rows && M.cols() == _cols
+            && M.nonZeros() == _nnz) return;
+
+        Eigen::SparseMatrix<double, Eigen::RowMajor, int> R(M.template cast<double>());
+        R.makeCompressed();
+        upload(R.rows(), R.cols(), R.nonZeros(),
+            R.outerIndexPtr(), R.innerIndexPtr(), R.valuePtr());
+        fingerprint = h;
+        ++nupload;
+    }
+
+    /** Same as icebin::apply_multi(), using the matrix on the device:
+        B{jn} = M{ji} * (A{im} * trans.M{mn} + trans.b{in})
+    The (small) variable transformation is done on the host; only
+    the regrid itself is done on the GPU.  There is no NaN check. */
+    template<class TransT, class DenseMatrixT>
+    void apply_multi(
+        Eigen::Map<EigenDenseMatrixT const> const &A_e,
+        TransT const &trans,
+        DenseMatrixT &B_e)
+    {
+        if (A_e.rows() != _cols) (*icebin_error)(-1,
+            "GPUMatrix::apply_multi(): Matrix has %ld columns, but fields have %ld rows",
+            _cols, (long)A_e.rows());
+
+        // Rows of A not used by M are transformed too, but never read
+        EigenDenseMatrixT T(A_e * trans.M);
+        EigenRowVectorT const b(trans.b);
+        T.rowwise() += b;
+
+        EigenDenseMatrixT Y(_rows, T.cols());
+        spmm(T.data(), T.cols(), Y.data());
+        ++napply;
+
+        B_e.resize(_rows, T.cols());
+        B_e = Y;
+    }
+};
+
+}    // namespace icebin
+#endif    // guard
@@ -16,21 +16,38 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
 #include <unordered_map>
+#include <unordered_set>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
 
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Boolean_set_operations_2.h>
 #include <CGAL/bounding_box.h>
 
+#include <boost/mpi.hpp>
+#include <boost/serialization/vector.hpp>
+
 #include <ibmisc/RTree.hpp>
 #include <ibmisc/Proj2.hpp>
 #include <ibmisc/netcdf.hpp>
 
 #include <icebin/error.hpp>
+#include <icebin/parallel.hpp>    // max_threads()
 
 #include <icebin/gridgen/cgal.hpp>
 #include <icebin/gridgen/GridGen_Exchange.hpp>
+#include <icebin/gridgen/convex_overlap.hpp>
 #include <icebin/gridgen/gridutil.hpp>
 
 using namespace ibmisc;
@@ -41,7 +58,7 @@ namespace icebin {
 // Some Supporting Classes
 // =======================================================================
 struct OCell {
-    Cell const *cell;
+    long index;    // Of the grid cell
 
     /** The polygon representing the grid cell (on the map).
     Vertices in this polygon are always counter-clockwise and have positive area. */
@@ -50,13 +67,26 @@ struct OCell {
     /** Bounding box of the polygon, used for search/overlap algorithms. */
     gc::Iso_rectangle_2 bounding_box;
 
-    OCell(Cell const *_cell, Proj2 const *proj);
+    /** The same polygon in double precision, for convex_overlap() */
+    Polygon2d dpoly;
+
+    /** Can dpoly be used with convex_overlap()? */
+    bool convex;
+
+    /** @param cell A Cell or FlatCell */
+    template<class CellT>
+    OCell(CellT const &cell, Proj2 const *proj);
+
+    /** Re-creates an (already projected) OCell; see OGrid::load() */
+    OCell(long _index, Polygon2d &&_dpoly, bool _convex,
+        std::array<double,4> const &bbox);
 };
 
-OCell::OCell(Cell const *_cell, Proj2 const *proj) : cell(_cell)
+template<class CellT>
+OCell::OCell(CellT const &cell, Proj2 const *proj) : index(cell.index)
 {
     // Copy the vertices
-    for (auto vertex = cell->begin(); vertex != cell->end(); ++vertex) {
+    for (auto vertex = cell.begin(); vertex != cell.end(); ++vertex) {
         double x, y;
         if (proj) {
             proj->transform(vertex->x, vertex->y, x, y);
@@ -65,17 +95,25 @@ OCell::OCell(Cell const *_cell, Proj2 const *proj) : cell(_cell)
             y = vertex->y;
         }
         poly.push_back(gc::Point_2(x, y));
+        dpoly.push_back({x, y});
     }
+    convex = is_robust_convex(dpoly);
 
     // Compute the bounding box
     bounding_box = CGAL::bounding_box(poly.vertices_begin(), poly.vertices_end());
 }
 
+OCell::OCell(long _index, Polygon2d &&_dpoly, bool _convex,
+    std::array<double,4> const &bbox)
+    : index(_index), bounding_box(bbox[0], bbox[1], bbox[2], bbox[3]),
+    dpoly(std::move(_dpoly)), convex(_convex)
+{
+    for (auto const &v : dpoly) poly.push_back(gc::Point_2(v[0], v[1]));
+}
+
 // =======================================================================
 
 struct OGrid {
-    Grid const *grid;
-
     /** CGAL polygon for each grid cell */
     std::unordered_map<int, OCell> ocells;
 
@@ -93,14 +131,81 @@ struct OGrid {
 
     // -------------------------------------------
 
-    OGrid(Grid const *_grid, Proj2 const *proj);
+    /** @param grid A Grid or FlatGrid
+    @param sproj The projection proj was made from ("" if none)
+    @param cache_fname If set: sidecar file caching the projected
+        polygons.  They are loaded from it if it was written (by this
+        constructor) for the same grid and projection; otherwise they
+        are computed and the file is (re)written. */
+    template<class GridT>
+    OGrid(GridT const *grid, Proj2 const *proj,
+        std::string const &sproj = "", std::string const &cache_fname = "");
+
+    /** Only keeps cells whose bounding box intersects a window
+    @param window (xmin, ymin, xmax, ymax) */
+    template<class GridT>
+    OGrid(GridT const *grid, Proj2 const *proj,
+        std::array<double,4> const &window);
 
     void realize_rtree();
+
+    /** Keeps one of nband horizontal bands of cells (with equal
+    numbers of cells), by bounding box center.
+    @return Bounding box (xmin, ymin, xmax, ymax) of the kept cells */
+    std::array<double,4> keep_band(int iband, int nband);
+
+    /** Saves the projected cells (in index order) to a sidecar file
+    @param checksum Identifies the grid and projection */
+    void save(std::string const &fname, uint64_t checksum) const;
+
+    /** @return false if the file does not exist or has the wrong checksum */
+    bool load(std::string const &fname, uint64_t checksum);
+
+protected:
+    template<class GridT>
+    void build(GridT const *grid, Proj2 const *proj,
+        std::array<double,4> const *window);
 };      // struct OGrid
 
-OGrid::OGrid(Grid const *_grid, Proj2 const *proj) : grid(_grid)
+template<class GridT>
+static uint64_t ogrid_checksum(GridT const *grid, std::string const &sproj);
+
+template<class GridT>
+OGrid::OGrid(GridT const *grid, Proj2 const *proj,
+    std::string const &sproj, std::string const &cache_fname)
+{
+    uint64_t checksum = 0;
+    if (cache_fname != "") {
+        checksum = ogrid_checksum(grid, sproj);
+        if (load(cache_fname, checksum)) return;
+    }
+
+    build(grid, proj, nullptr);
+
+    if (cache_fname != "") save(cache_fname, checksum);
+}
+
+template<class GridT>
+OGrid::OGrid(GridT const *grid, Proj2 const *proj,
+    std::array<double,4> const &window)
 {
+    build(grid, proj, &window);
+}
 
+/** Does the bounding box of an OCell intersect a window?
+@param window (xmin, ymin, xmax, ymax) */
+static bool bbox_intersects(OCell const &ocell, std::array<double,4> const &window)
+{
+    return CGAL::to_double(ocell.bounding_box.xmax()) >= window[0]
+        && CGAL::to_double(ocell.bounding_box.ymax()) >= window[1]
+        && CGAL::to_double(ocell.bounding_box.xmin()) <= window[2]
+        && CGAL::to_double(ocell.bounding_box.ymin()) <= window[3];
+}
+
+template<class GridT>
+void OGrid::build(GridT const *grid, Proj2 const *proj,
+    std::array<double,4> const *window)
+{
     // Compute bounding box too
     // Be lazy, base bounding box on minimum and maximum values in points
     // (instead of computing the convex hull)
@@ -113,7 +218,8 @@ OGrid::OGrid(Grid const *_grid, Proj2 const *proj) : grid(_grid)
     // Compute Simple Bounding Box for overall grid
     for (auto cell = grid->cells.begin(); cell != grid->cells.end(); ++cell) {
         // Convert and copy to the OGrid data structure
-        OCell ocell(&*cell, proj);
+        OCell ocell(*cell, proj);
+        if (window && !bbox_intersects(ocell, *window)) continue;
         ocells.insert(std::make_pair(cell->index, ocell));
 
         for (auto vertex = ocell.poly.vertices_begin(); vertex != ocell.poly.vertices_end(); ++vertex) {
@@ -129,6 +235,7 @@ OGrid::OGrid(Grid const *_grid, Proj2 const *proj) : grid(_grid)
     bounding_box.push_back(gc::Point_2(maxx, miny));
     bounding_box.push_back(gc::Point_2(maxx, maxy));
     bounding_box.push_back(gc::Point_2(minx, maxy));
+
 }
 
 void OGrid::realize_rtree() {
@@ -163,9 +270,262 @@ void OGrid::realize_rtree() {
 }
 
 
+std::array<double,4> OGrid::keep_band(int iband, int nband)
+{
+    // Order cells by the center of their bounding box: y, then x
+    typedef std::pair<std::array<double,2>, int> CenterT;
+    std::vector<CenterT> centers;
+    centers.reserve(ocells.size());
+    for (auto ii=ocells.begin(); ii != ocells.end(); ++ii) {
+        OCell const &ocell(ii->second);
+        centers.push_back(std::make_pair(std::array<double,2>{
+            .5 * (CGAL::to_double(ocell.bounding_box.ymin()) + CGAL::to_double(ocell.bounding_box.ymax())),
+            .5 * (CGAL::to_double(ocell.bounding_box.xmin()) + CGAL::to_double(ocell.bounding_box.xmax()))},
+            ii->first));
+    }
+    std::sort(centers.begin(), centers.end());
+
+    size_t const i0 = centers.size() * iband / nband;
+    size_t const i1 = centers.size() * (iband+1) / nband;
+
+    std::unordered_map<int, OCell> kept;
+    std::array<double,4> window {1e100, 1e100, -1e100, -1e100};
+    for (size_t i=i0; i<i1; ++i) {
+        auto ii(ocells.find(centers[i].second));
+        OCell const &ocell(ii->second);
+        window[0] = std::min(window[0], CGAL::to_double(ocell.bounding_box.xmin()));
+        window[1] = std::min(window[1], CGAL::to_double(ocell.bounding_box.ymin()));
+        window[2] = std::max(window[2], CGAL::to_double(ocell.bounding_box.xmax()));
+        window[3] = std::max(window[3], CGAL::to_double(ocell.bounding_box.ymax()));
+        kept.insert(std::make_pair(ii->first, std::move(ii->second)));
+    }
+    ocells = std::move(kept);
+    rtree.reset();
+
+    bounding_box.clear();
+    bounding_box.push_back(gc::Point_2(window[0], window[1]));
+    bounding_box.push_back(gc::Point_2(window[2], window[1]));
+    bounding_box.push_back(gc::Point_2(window[2], window[3]));
+    bounding_box.push_back(gc::Point_2(window[0], window[3]));
+
+    return window;
+}
+
+// =======================================================================
+// Sidecar cache of projected polygons.
+//
+// Layout (native byte order):
+//     OGridCacheHeader
+//     index     int64[ncell]        Cell indices, sorted
+//     convex    int8[ncell]         OCell::convex
+//     bbox      double[ncell*4]     (xmin, ymin, xmax, ymax)
+//     vstart    int64[ncell+1]      Start of each polygon in xy
+//     xy        double[nvertex*2]   Projected vertices
+//
+// The RTree is not stored: it is rebuilt from the bounding boxes,
+// which is cheap compared to projecting the vertices.
+
+struct OGridCacheHeader {
+    char magic[8];          // OGRID_CACHE_MAGIC
+    uint32_t version;       // OGRID_CACHE_VERSION
+    uint32_t byte_order;    // OGRID_CACHE_BYTE_ORDER, as written
+    uint64_t checksum;      // Of the grid and projection
+    int64_t ncell;
+    int64_t nvertex;
+};
+
+static char const OGRID_CACHE_MAGIC[8] = {'I','C','E','B','O','G','C','\0'};
+static uint32_t const OGRID_CACHE_VERSION = 1;
+static uint32_t const OGRID_CACHE_BYTE_ORDER = 0x01020304;
+
+/** FNV-1a hash */
+static uint64_t fnv1a(void const *data, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    unsigned char const *p = (unsigned char const *)data;
+    for (size_t i=0; i<n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/** Identifies a grid's (unprojected) cells and projection.  Hashes of
+each cell are summed, so this does not depend on iteration order. */
+template<class GridT>
+static uint64_t ogrid_checksum(GridT const *grid, std::string const &sproj)
+{
+    uint64_t sum = fnv1a(sproj.data(), sproj.size());
+    for (auto cell = grid->cells.begin(); cell != grid->cells.end(); ++cell) {
+        int64_t const index = cell->index;
+        uint64_t h = fnv1a(&index, sizeof(index));
+        for (auto vertex = cell->begin(); vertex != cell->end(); ++vertex) {
+            double const xy[2] = {vertex->x, vertex->y};
+            h = fnv1a(xy, sizeof(xy), h);
+        }
+        sum += h;
+    }
+    return sum;
+}
+
+static void cache_fwrite(FILE *fout, std::string const &fname,
+    void const *data, size_t nbytes)
+{
+    if (nbytes > 0 && fwrite(data, 1, nbytes, fout) != nbytes)
+        (*icebin_error)(-1, "Error writing %s: %s", fname.c_str(), strerror(errno));
+}
+
+static void cache_fread(FILE *fin, std::string const &fname,
+    void *data, size_t nbytes)
+{
+    if (nbytes > 0 && fread(data, 1, nbytes, fin) != nbytes)
+        (*icebin_error)(-1, "Error reading %s: truncated file?", fname.c_str());
+}
+
+void OGrid::save(std::string const &fname, uint64_t checksum) const
+{
+    // Write cells in index order
+    std::vector<OCell const *> socells;
+    socells.reserve(ocells.size());
+    for (auto ii=ocells.begin(); ii != ocells.end(); ++ii) socells.push_back(&ii->second);
+    std::sort(socells.begin(), socells.end(),
+        [](OCell const *a, OCell const *b) { return a->index < b->index; });
+
+    std::vector<int64_t> index, vstart;
+    std::vector<int8_t> convex;
+    std::vector<double> bbox, xy;
+    index.reserve(socells.size());
+    convex.reserve(socells.size());
+    bbox.reserve(socells.size()*4);
+    vstart.reserve(socells.size()+1);
+    vstart.push_back(0);
+    for (OCell const *ocell : socells) {
+        index.push_back(ocell->index);
+        convex.push_back(ocell->convex);
+        bbox.push_back(CGAL::to_double(ocell->bounding_box.xmin()));
+        bbox.push_back(CGAL::to_double(ocell->bounding_box.ymin()));
+        bbox.push_back(CGAL::to_double(ocell->bounding_box.xmax()));
+        bbox.push_back(CGAL::to_double(ocell->bounding_box.ymax()));
+        for (auto const &v : ocell->dpoly) {
+            xy.push_back(v[0]);
+            xy.push_back(v[1]);
+        }
+        vstart.push_back(xy.size() / 2);
+    }
+
+    OGridCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OGRID_CACHE_MAGIC, sizeof(header.magic));
+    header.version = OGRID_CACHE_VERSION;
+    header.byte_order = OGRID_CACHE_BYTE_ORDER;
+    header.checksum = checksum;
+    header.ncell = index.size();
+    header.nvertex = xy.size() / 2;
+
+    FILE *fout = fopen(fname.c_str(), "wb");
+    if (!fout) (*icebin_error)(-1,
+        "Cannot open %s for writing: %s", fname.c_str(), strerror(errno));
+    cache_fwrite(fout, fname, &header, sizeof(header));
+    cache_fwrite(fout, fname, index.data(), index.size() * sizeof(int64_t));
+    cache_fwrite(fout, fname, convex.data(), convex.size() * sizeof(int8_t));
+    cache_fwrite(fout, fname, bbox.data(), bbox.size() * sizeof(double));
+    cache_fwrite(fout, fname, vstart.data(), vstart.size() * sizeof(int64_t));
+    cache_fwrite(fout, fname, xy.data(), xy.size() * sizeof(double));
+    if (fclose(fout) != 0) (*icebin_error)(-1,
+        "Error closing %s: %s", fname.c_str(), strerror(errno));
+
+    printf("Wrote %ld projected cells to %s\n", (long)header.ncell, fname.c_str());
+}
+
+bool OGrid::load(std::string const &fname, uint64_t checksum)
+{
+    FILE *fin = fopen(fname.c_str(), "rb");
+    if (!fin) return false;
+
+    OGridCacheHeader header;
+    if (fread(&header, 1, sizeof(header), fin) != sizeof(header)
+        || memcmp(header.magic, OGRID_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != OGRID_CACHE_VERSION
+        || header.byte_order != OGRID_CACHE_BYTE_ORDER
+        || header.checksum != checksum)
+    {
+        printf("Projected cell cache %s is stale; recomputing\n", fname.c_str());
+        fclose(fin);
+        return false;
+    }
+
+    size_t const ncell = header.ncell;
+    std::vector<int64_t> index(ncell), vstart(ncell+1);
+    std::vector<int8_t> convex(ncell);
+    std::vector<double> bbox(ncell*4), xy(header.nvertex*2);
+    cache_fread(fin, fname, index.data(), index.size() * sizeof(int64_t));
+    cache_fread(fin, fname, convex.data(), convex.size() * sizeof(int8_t));
+    cache_fread(fin, fname, bbox.data(), bbox.size() * sizeof(double));
+    cache_fread(fin, fname, vstart.data(), vstart.size() * sizeof(int64_t));
+    cache_fread(fin, fname, xy.data(), xy.size() * sizeof(double));
+    fclose(fin);
+
+    // Re-create the cells, and the overall bounding box
+    double minx = 1e100, maxx = -1e100, miny = 1e100, maxy = -1e100;
+    ocells.clear();
+    for (size_t i=0; i<ncell; ++i) {
+        Polygon2d dpoly;
+        dpoly.reserve(vstart[i+1] - vstart[i]);
+        for (int64_t v=vstart[i]; v<vstart[i+1]; ++v)
+            dpoly.push_back({xy[v*2+0], xy[v*2+1]});
+
+        std::array<double,4> const box {bbox[i*4+0], bbox[i*4+1], bbox[i*4+2], bbox[i*4+3]};
+        ocells.insert(std::make_pair(index[i],
+            OCell(index[i], std::move(dpoly), convex[i], box)));
+
+        minx = std::min(minx, box[0]);
+        miny = std::min(miny, box[1]);
+        maxx = std::max(maxx, box[2]);
+        maxy = std::max(maxy, box[3]);
+    }
+
+    bounding_box.clear();
+    bounding_box.push_back(gc::Point_2(minx, miny));
+    bounding_box.push_back(gc::Point_2(maxx, miny));
+    bounding_box.push_back(gc::Point_2(maxx, maxy));
+    bounding_box.push_back(gc::Point_2(minx, maxy));
+
+    printf("Read %ld projected cells from %s\n", (long)ncell, fname.c_str());
+    return true;
+}
+
 // =======================================================================
 // The main exchange grid computation
 
+/** Number of overlaps computed by convex_overlap() vs. poly_overlap(),
+in one exchange grid computation */
+struct OverlapCounts {
+    std::atomic<long> fast{0};
+    std::atomic<long> exact{0};
+};
+
+/** Computes the overlap of two cells, in double precision.  Uses
+the floating-point convex clipper if both cells are convex and it can
+give a robust answer; otherwise falls back on exact CGAL arithmetic.
+@param exact Always use CGAL
+@param ret OUT: Vertices of the overlap polygon; empty if none */
+static void overlap_vertices(OCell const *ocell1, OCell const *ocell2,
+    bool exact, OverlapCounts *counts, Polygon2d &ret)
+{
+    if (!exact && ocell1->convex && ocell2->convex
+        && convex_overlap(ocell1->dpoly, ocell2->dpoly, ret))
+    {
+        ++counts->fast;
+        return;
+    }
+
+    ++counts->exact;
+    ret.clear();
+    auto expoly(poly_overlap(ocell1->poly, ocell2->poly));
+    for (auto vertex = expoly.vertices_begin(); vertex != expoly.vertices_end(); ++vertex) {
+        ret.push_back({CGAL::to_double(vertex->x()), CGAL::to_double(vertex->y())});
+    }
+}
+
 /**
 @param exgrid The Exchange Grid we're creating.  Even for L1 grids, we
     don't need to positively associate vertices in exgrid with
@@ -173,28 +533,25 @@ void OGrid::realize_rtree() {
     needed to eliminate duplicate vertices.
 @return Always returns true (tells RTree search algorithm to keep going) */
 static bool overlap_callback(VertexCache *exvcache, GridMap<Cell> *cells, long gridI_ndata,
-    OCell const **ocell1p, OCell const *ocell2)
+    bool exact, OverlapCounts *counts, OCell const **ocell1p, OCell const *ocell2)
 {
     // Enable using same std::function callback for many values of gridA
     OCell const *ocell1 = *ocell1p;
 
-    // Compute the overlap polygon (CGAL)
-    auto expoly(poly_overlap(ocell1->poly, ocell2->poly));
+    // Compute the overlap polygon
+    Polygon2d expoly;
+    overlap_vertices(ocell1, ocell2, exact, counts, expoly);
     if (expoly.size() == 0) return true;
 
     // Convert it to a Cell
     Cell excell;    // Exchange Cell
-    excell.i = ocell1->cell->index;
-    excell.j = ocell2->cell->index;
+    excell.i = ocell1->index;
+    excell.j = ocell2->index;
 //  excell.index = excell.i * gridI_ndata + excell.j;   // guarantee unique (but sparse)
     excell.index = -1;      // Get an index assigned (but dense)...
 
     // Add the vertices of the polygon outline
-    for (auto vertex = expoly.vertices_begin(); vertex != expoly.vertices_end(); ++vertex) {
-        double x = CGAL::to_double(vertex->x());
-        double y = CGAL::to_double(vertex->y());
-        exvcache->add_vertex(excell, x, y);
-    }
+    for (auto const &vertex : expoly) exvcache->add_vertex(excell, vertex[0], vertex[1]);
 
     // Compute its area (we will need this)
     excell.native_area = excell.proj_area(NULL);
@@ -205,14 +562,151 @@ static bool overlap_callback(VertexCache *exvcache, GridMap<Cell> *cells, long g
     return true;
 }
 // --------------------------------------------------------------------
+/** An exchange cell computed by a worker thread, before it is added
+to the (non-thread-safe) exchange grid. */
+struct TileExCell {
+    long i, j;    // Index of the gridA and gridI cells it came from
+    Polygon2d vertices;
+};
 
-/** @param gridI Put in an RTree */
-Grid make_exchange_grid(
-    Grid const *gridA, Grid const *gridI,
-    std::string sproj)
+/** Same as overlap_callback(), but stores results in a per-tile buffer */
+static bool tile_overlap_callback(std::vector<TileExCell> *excells,
+    bool exact, OverlapCounts *counts, OCell const **ocell1p, OCell const *ocell2)
+{
+    OCell const *ocell1 = *ocell1p;
+
+    Polygon2d expoly;
+    overlap_vertices(ocell1, ocell2, exact, counts, expoly);
+    if (expoly.size() == 0) return true;
+
+    excells->push_back(TileExCell());
+    TileExCell &excell(excells->back());
+    excell.i = ocell1->index;
+    excell.j = ocell2->index;
+    excell.vertices = std::move(expoly);
+    return true;
+}
+
+/** Searches ogridI for the overlaps of one gridA cell */
+template<class CallbackT>
+static int search_overlaps(OGrid const &ogridI, OCell const *ocell1, CallbackT &callback)
+{
+    return ogridI.rtree->Search(
+        {CGAL::to_double(ocell1->bounding_box.xmin()),
+         CGAL::to_double(ocell1->bounding_box.ymin())},
+        {CGAL::to_double(ocell1->bounding_box.xmax()),
+         CGAL::to_double(ocell1->bounding_box.ymax())},
+        callback);
+}
+
+/** Parallel version of the main loop in make_exchange_grid().  The
+bounding box of gridA is divided into ntile x ntile tiles; each gridA
+cell belongs to the tile containing the center of its bounding box.
+Tiles are overlapped (on separate threads) against the shared,
+read-only RTree of gridI.  As tiles complete, their exchange cells
+are passed to tile_done() in (tile, cell index) order, so the result
+does not depend on the number of threads.
+
+NOTE: CGAL's lazy exact kernel updates shared objects when it
+evaluates them exactly; CGAL must be built with thread support
+(CGAL_HAS_THREADS) for this to be safe. */
+static void overlap_tiles(OGrid const &ogridA, OGrid const &ogridI, int ntile,
+    bool exact, OverlapCounts *counts,
+    std::function<void(std::vector<TileExCell> &)> const &tile_done)
+{
+    // Bounding box of gridA
+    double const minx = CGAL::to_double(ogridA.bounding_box[0].x());
+    double const miny = CGAL::to_double(ogridA.bounding_box[0].y());
+    double const maxx = CGAL::to_double(ogridA.bounding_box[2].x());
+    double const maxy = CGAL::to_double(ogridA.bounding_box[2].y());
+
+    // Assign gridA cells to tiles
+    int const ntiles = ntile * ntile;
+    std::vector<std::vector<OCell const *>> tiles(ntiles);
+    for (auto ii1 = ogridA.ocells.begin(); ii1 != ogridA.ocells.end(); ++ii1) {
+        OCell const *ocell1 = &ii1->second;
+        double const cx = .5 * (CGAL::to_double(ocell1->bounding_box.xmin())
+            + CGAL::to_double(ocell1->bounding_box.xmax()));
+        double const cy = .5 * (CGAL::to_double(ocell1->bounding_box.ymin())
+            + CGAL::to_double(ocell1->bounding_box.ymax()));
+        int const tx = std::max(0, std::min(ntile-1,
+            (int)((cx - minx) / (maxx - minx) * ntile)));
+        int const ty = std::max(0, std::min(ntile-1,
+            (int)((cy - miny) / (maxy - miny) * ntile)));
+        tiles[ty*ntile + tx].push_back(ocell1);
+    }
+    for (auto &tile : tiles) {
+        std::sort(tile.begin(), tile.end(),
+            [](OCell const *a, OCell const *b) { return a->index < b->index; });
+    }
+
+    // Overlap each tile; hand them off in order
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic) ordered num_threads(max_threads())
+#endif
+    for (int it=0; it<ntiles; ++it) {
+        std::vector<TileExCell> excells;
+        OCell const *ocell1;
+        auto callback(std::bind(&tile_overlap_callback, &excells, exact, counts, &ocell1, _1));
+        for (OCell const *oc : tiles[it]) {
+            ocell1 = oc;
+            search_overlaps(ogridI, ocell1, callback);
+        }
+
+#ifdef USE_OPENMP
+        #pragma omp ordered
+#endif
+        {
+            printf("Processed tile %d of %d (%ld gridA cells, %ld overlaps)\n",
+                it+1, ntiles, (long)tiles[it].size(), (long)excells.size());
+            tile_done(excells);
+        }
+    }
+}
+
+/** Adds exchange cells from overlap_tiles() to a grid */
+static void add_tile_cells(VertexCache *exvcache, GridMap<Cell> *cells,
+    std::vector<TileExCell> &excells)
+{
+    for (auto &tc : excells) {
+        Cell excell;
+        excell.i = tc.i;
+        excell.j = tc.j;
+        excell.index = -1;
+        for (auto const &v : tc.vertices) exvcache->add_vertex(excell, v[0], v[1]);
+        excell.native_area = excell.proj_area(NULL);
+        cells->add(std::move(excell));
+    }
+}
+
+/** Planar area of a polygon (positive if counter-clockwise) */
+static double polygon_area(Polygon2d const &P)
+{
+    double area2 = 0;
+    for (size_t i=0; i<P.size(); ++i) {
+        auto const &p0(P[i]);
+        auto const &p1(P[(i+1) % P.size()]);
+        area2 += p0[0]*p1[1] - p1[0]*p0[1];
+    }
+    return .5 * area2;
+}
+
+/** Writes exchange cells from overlap_tiles() as overlap records */
+static void write_tile_cells(ExchangeGridWriter *writer,
+    std::vector<TileExCell> &excells)
+{
+    for (auto &tc : excells) writer->add(tc.i, tc.j, polygon_area(tc.vertices));
+}
+
+/** Determines the projections needed to overlap gridA and gridI in
+the plane.
+@param sproj IN/OUT: Projection of the exchange grid; set if "" */
+template<class GridT>
+static void exchange_projections(
+    GridT const *gridA, GridT const *gridI,
+    std::string &sproj,
+    std::unique_ptr<Proj2> &projA, std::unique_ptr<Proj2> &projI)
 {
-    // Determine compatibility and projections between the two grids
-    std::unique_ptr<Proj2> projA, projI;
     if (gridA->coordinates == GridCoordinates::XY) {
         if (gridI->coordinates == GridCoordinates::XY) {
             // No projections needed
@@ -237,41 +731,240 @@ Grid make_exchange_grid(
             (*icebin_error)(-1, "Program isn't currently equipped to overlap two grids on the sphere.\n");
         }
     }
+}
+// --------------------------------------------------------------------
+// Analytic overlap of rectilinear grids
+
+/** Overlap of two 1-D intervals (grid cells along one axis) */
+struct Overlap1D {
+    int ia, ib;       // Index of the interval in each set of boundaries
+    double lo, hi;    // Overlap is [lo, hi]
+};
+
+/** Overlaps between two sets of 1-D cells, given by their (sorted)
+boundaries; found with a single merge-like pass.
+@param shift Added to all of b */
+static void interval_overlaps(
+    std::vector<double> const &a, std::vector<double> const &b, double shift,
+    std::vector<Overlap1D> &ret)
+{
+    size_t ia=0, ib=0;
+    while (ia+1 < a.size() && ib+1 < b.size()) {
+        double const lo = std::max(a[ia], b[ib] + shift);
+        double const hi = std::min(a[ia+1], b[ib+1] + shift);
+        if (hi > lo) ret.push_back(Overlap1D{(int)ia, (int)ib, lo, hi});
+        if (a[ia+1] < b[ib+1] + shift) ++ia;
+        else ++ib;
+    }
+}
+
+/** Boundaries of a rectilinear grid: XY, or lon/lat without polar caps.
+@return false if the grid is not rectilinear */
+template<class GridT>
+static bool rectilinear_boundaries(GridT const *grid,
+    std::vector<double> const *&xb, std::vector<double> const *&yb,
+    double &eq_rad)
+{
+    if (grid->parameterization != GridParameterization::L0 || !grid->spec) return false;
+    switch(grid->spec->type.index()) {
+        case GridType::XY : {
+            auto const *spec(dynamic_cast<GridSpec_XY const *>(&*grid->spec));
+            if (!spec) return false;
+            xb = &spec->xb;
+            yb = &spec->yb;
+            eq_rad = 0;
+            return true;
+        }
+        case GridType::LONLAT : {
+            auto const *spec(dynamic_cast<GridSpec_LonLat const *>(&*grid->spec));
+            if (!spec || spec->south_pole || spec->north_pole) return false;
+            xb = &spec->lonb;
+            yb = &spec->latb;
+            eq_rad = spec->eq_rad;
+            return true;
+        }
+        default :
+            return false;
+    }
+}
+
+/** If gridA and gridI are both rectilinear, in the same coordinate
+system (and projection), their overlap is the tensor product of the
+1-D overlaps along each axis (as in Hntr).  Generates the exchange
+cells that way, without polygon clipping.
+@param fn Called for each exchange cell: fn(iA, iI, {x0,x1,y0,y1}, area)
+@return false if the grids are not suitable; fn is not called. */
+template<class GridT>
+static bool rectilinear_overlaps(GridT const *gridA, GridT const *gridI,
+    std::function<void(long, long, std::array<double,4> const &, double)> const &fn)
+{
+    std::vector<double> const *xbA, *ybA, *xbI, *ybI;
+    double eq_radA, eq_radI;
+    if (!rectilinear_boundaries(gridA, xbA, ybA, eq_radA)) return false;
+    if (!rectilinear_boundaries(gridI, xbI, ybI, eq_radI)) return false;
+    if (gridA->spec->type != gridI->spec->type) return false;
+    bool const lonlat = (gridA->spec->type == GridType::LONLAT);
+    if (!lonlat && gridA->sproj != gridI->sproj) return false;
+
+    printf("Overlapping rectilinear grids analytically\n");
+
+    // 1-D overlaps.  Longitude is periodic: also try gridI shifted by 360
+    std::vector<Overlap1D> xover, yover;
+    for (double shift : (lonlat ? std::vector<double>{-360., 0., 360.} : std::vector<double>{0.})) {
+        interval_overlaps(*xbA, *xbI, shift, xover);
+    }
+    interval_overlaps(*ybA, *ybI, 0., yover);
+
+    // Realized cells
+    std::unordered_set<long> realizedA, realizedI;
+    for (auto cell=gridA->cells.begin(); cell != gridA->cells.end(); ++cell)
+        realizedA.insert(cell->index);
+    for (auto cell=gridI->cells.begin(); cell != gridI->cells.end(); ++cell)
+        realizedI.insert(cell->index);
+
+    double const D2R = M_PI / 180.;
+    for (auto const &oy : yover) {
+    for (auto const &ox : xover) {
+        long const iA = gridA->indexing.tuple_to_index<int,2>({ox.ia, oy.ia});
+        if (realizedA.find(iA) == realizedA.end()) continue;
+        long const iI = gridI->indexing.tuple_to_index<int,2>({ox.ib, oy.ib});
+        if (realizedI.find(iI) == realizedI.end()) continue;
+
+        // Graticule area (see graticule_area_exact()) or planar area
+        double const area = (lonlat
+            ? eq_radA * eq_radA * (ox.hi - ox.lo) * D2R
+                * (std::sin(oy.hi * D2R) - std::sin(oy.lo * D2R))
+            : (ox.hi - ox.lo) * (oy.hi - oy.lo));
+        fn(iA, iI, {ox.lo, ox.hi, oy.lo, oy.hi}, area);
+    }}
+    return true;
+}
 
+/** Adds a rectangular exchange cell, from rectilinear_overlaps() */
+static void add_rectangle_cell(VertexCache *exvcache, GridMap<Cell> *cells,
+    long iA, long iI, std::array<double,4> const &box, double area)
+{
+    Cell excell;
+    excell.i = iA;
+    excell.j = iI;
+    excell.index = -1;
+    exvcache->add_vertex(excell, box[0], box[2]);
+    exvcache->add_vertex(excell, box[1], box[2]);
+    exvcache->add_vertex(excell, box[1], box[3]);
+    exvcache->add_vertex(excell, box[0], box[3]);
+    excell.native_area = area;
+    cells->add(std::move(excell));
+}
+
+static void write_rectangle_cell(ExchangeGridWriter *writer,
+    long iA, long iI, std::array<double,4> const &box, double area)
+{
+    writer->add(iA, iI, area);
+}
+// --------------------------------------------------------------------
+ExchangeGridWriter::ExchangeGridWriter(netCDF::NcGroup *_nc,
+    std::string const &_vname, size_t _chunk_size, NcLayout const &layout)
+    : nc(_nc), vname(_vname), chunk_size(_chunk_size)
+{
+    // Same variables as ExchangeGrid::ncio(), but with unlimited dimensions
+    indices_v = nc->addVar(vname + ".indices", netCDF::ncInt,
+        std::vector<netCDF::NcDim>{nc->addDim(vname + ".nindices")});
+    overlaps_v = nc->addVar(vname + ".overlaps", netCDF::ncDouble,
+        std::vector<netCDF::NcDim>{nc->addDim(vname + ".noverlaps")});
+    layout.configure(indices_v);
+    layout.configure(overlaps_v);
+
+    indices.reserve(chunk_size*2);
+    overlaps.reserve(chunk_size);
+}
+
+void ExchangeGridWriter::add(int iA, int iI, double area)
+{
+    indices.push_back(iA);
+    indices.push_back(iI);
+    overlaps.push_back(area);
+    if (overlaps.size() >= chunk_size) flush();
+}
+
+void ExchangeGridWriter::flush()
+{
+    if (overlaps.size() == 0) return;
+
+    indices_v.putVar({2*nwritten}, {indices.size()}, indices.data());
+    overlaps_v.putVar({nwritten}, {overlaps.size()}, overlaps.data());
+    nwritten += overlaps.size();
+    indices.clear();
+    overlaps.clear();
+}
+// --------------------------------------------------------------------
+
+/** @param gridI Put in an RTree */
+template<class GridT>
+static Grid _make_exchange_grid(
+    GridT const *gridA, GridT const *gridI,
+    std::string sproj,
+    int ntile,
+    bool exact,
+    std::string const &cacheI)
+{
     /** Initialize the new grid */
     GridMap<Vertex> vertices(-1);    // Not specified
     GridMap<Cell> cells(-1);         // Not specified
 
     VertexCache exvcache(&vertices);
 
+    // Rectilinear grids: no need for polygons
+    if (rectilinear_overlaps(gridA, gridI,
+        std::bind(&add_rectangle_cell, &exvcache, &cells, _1, _2, _3, _4)))
+    {
+        bool const lonlat = (gridA->coordinates == GridCoordinates::LONLAT);
+        return Grid(
+            gridA->name + '-' + gridI->name,
+            std::unique_ptr<GridSpec>(new GridSpec_Generic(cells.nfull())),
+            gridA->coordinates,
+            (lonlat ? "" : (sproj == "" ? std::string(gridA->sproj.c_str()) : sproj)),
+            GridParameterization::L0,
+            Indexing({"i0"}, {0}, {(long)cells.nfull()}, {0}),
+            std::move(vertices), std::move(cells));
+    }
+
+    // Determine compatibility and projections between the two grids
+    std::unique_ptr<Proj2> projA, projI;
+    exchange_projections(gridA, gridI, sproj, projA, projI);
+
     OGrid ogridA(gridA, &*projA);   // projA used to transform LL->XY when overlapping
-    OGrid ogridI(gridI, &*projI);   // projI used to transform LL->XY when overlapping
+    OGrid ogridI(gridI, &*projI,    // projI used to transform LL->XY when overlapping
+        (projI ? gridA->sproj : ""), cacheI);
     ogridI.realize_rtree();
 
-    OCell const *ocell1;
-    auto callback(std::bind(&overlap_callback, &exvcache, &cells,
-        gridI->ndata(), &ocell1, _1));
+    OverlapCounts counts;
+    if (ntile > 0) {
+        overlap_tiles(ogridA, ogridI, ntile, exact, &counts,
+            std::bind(&add_tile_cells, &exvcache, &cells, _1));
+    } else {
+        OCell const *ocell1;
+        auto callback(std::bind(&overlap_callback, &exvcache, &cells,
+            gridI->ndata(), exact, &counts, &ocell1, _1));
 
-    int nprocessed=0;
-    for (auto ii1 = ogridA.ocells.begin(); ii1 != ogridA.ocells.end(); ++ii1) {
-        ocell1 = &ii1->second;      // Set parameter for the callback
-
-//printf("gridA[%d]: x in (%f - %f), y in (%f - %f)\n", ocell1->cell->index, min[0], max[0], min[1], max[1]);
-        int nfound = ogridI.rtree->Search(
-            {CGAL::to_double(ocell1->bounding_box.xmin()),
-             CGAL::to_double(ocell1->bounding_box.ymin())},
-            {CGAL::to_double(ocell1->bounding_box.xmax()),
-             CGAL::to_double(ocell1->bounding_box.ymax())},
-            callback);
-
-        // Logging
-        ++nprocessed;
-        if (nprocessed % 100 == 0) {
-            printf("Processed %d of %d from gridA, total overlaps = %d\n",
-                nprocessed+1, ogridA.ocells.size(), cells.nrealized());
+        int nprocessed=0;
+        for (auto ii1 = ogridA.ocells.begin(); ii1 != ogridA.ocells.end(); ++ii1) {
+            ocell1 = &ii1->second;      // Set parameter for the callback
+
+//printf("gridA[%d]: x in (%f - %f), y in (%f - %f)\n", ocell1->index, min[0], max[0], min[1], max[1]);
+            int nfound = search_overlaps(ogridI, ocell1, callback);
+
+            // Logging
+            ++nprocessed;
+            if (nprocessed % 100 == 0) {
+                printf("Processed %d of %d from gridA, total overlaps = %d\n",
+                    nprocessed+1, ogridA.ocells.size(), cells.nrealized());
+            }
         }
     }
 
+    printf("Overlaps computed: %ld floating point, %ld exact\n",
+        (long)counts.fast, (long)counts.exact);
+
     return Grid(
         gridA->name + '-' + gridI->name,
         std::unique_ptr<GridSpec>(new GridSpec_Generic(cells.nfull())),
@@ -283,5 +976,265 @@ Grid make_exchange_grid(
 
 }
 
+template<class GridT>
+static void _write_exchange_grid(
+    GridT const *gridA, GridT const *gridI,
+    ExchangeGridWriter &writer,
+    int ntile,
+    bool exact,
+    std::string const &cacheI)
+{
+    if (rectilinear_overlaps(gridA, gridI,
+        std::bind(&write_rectangle_cell, &writer, _1, _2, _3, _4)))
+    {
+        writer.flush();
+        printf("Overlaps computed analytically; %ld written\n", (long)writer.size());
+        return;
+    }
+
+    std::string sproj;
+    std::unique_ptr<Proj2> projA, projI;
+    exchange_projections(gridA, gridI, sproj, projA, projI);
+
+    OGrid ogridA(gridA, &*projA);
+    OGrid ogridI(gridI, &*projI, (projI ? gridA->sproj : ""), cacheI);
+    ogridI.realize_rtree();
+
+    OverlapCounts counts;
+    overlap_tiles(ogridA, ogridI, std::max(1, ntile), exact, &counts,
+        std::bind(&write_tile_cells, &writer, _1));
+    writer.flush();
+
+    printf("Overlaps computed: %ld floating point, %ld exact; %ld written\n",
+        (long)counts.fast, (long)counts.exact, (long)writer.size());
+}
+
+
+/** Adds a rectangle from rectilinear_overlaps(), if it involves a
+changed cell */
+static void add_changed_rectangle(ExchangeGrid *exgrid,
+    std::unordered_set<long> const *changedA, std::unordered_set<long> const *changedI,
+    long iA, long iI, std::array<double,4> const &box, double area)
+{
+    if (changedA->find(iA) == changedA->end()
+        && changedI->find(iI) == changedI->end()) return;
+    exgrid->add({(int)iA, (int)iI}, area);
+}
+
+template<class GridT>
+static ExchangeGrid _update_exchange_grid(
+    GridT const *gridA, GridT const *gridI,
+    ExchangeGrid const &exgrid0,
+    std::vector<long> const &changedA,
+    std::vector<long> const &changedI,
+    bool exact,
+    std::string const &cacheI)
+{
+    std::unordered_set<long> const setA(changedA.begin(), changedA.end());
+    std::unordered_set<long> const setI(changedI.begin(), changedI.end());
+
+    // Keep overlaps that involve no changed cells
+    ExchangeGrid exgrid;
+    exgrid.reserve(exgrid0.dense_extent());
+    for (int id=0; id<exgrid0.dense_extent(); ++id) {
+        int const iA = exgrid0.ijk(id,0);
+        int const iI = exgrid0.ijk(id,1);
+        if (setA.find(iA) == setA.end() && setI.find(iI) == setI.end())
+            exgrid.add({iA, iI}, exgrid0.native_area(id));
+    }
+    long const nkept = exgrid.dense_extent();
+
+    // Rectilinear grids: everything is cheap to recompute
+    if (rectilinear_overlaps(gridA, gridI,
+        std::bind(&add_changed_rectangle, &exgrid, &setA, &setI, _1, _2, _3, _4)))
+    {
+        printf("Kept %ld overlaps, recomputed %ld analytically\n",
+            nkept, (long)exgrid.dense_extent() - nkept);
+        return exgrid;
+    }
+
+    std::string sproj;
+    std::unique_ptr<Proj2> projA, projI;
+    exchange_projections(gridA, gridI, sproj, projA, projI);
+
+    OGrid ogridA(gridA, &*projA);
+    OGrid ogridI(gridI, &*projI, (projI ? gridA->sproj : ""), cacheI);
+
+    std::vector<TileExCell> excells;
+    OCell const *ocell1;
+    OverlapCounts counts;
+    auto callback(std::bind(&tile_overlap_callback, &excells, exact, &counts, &ocell1, _1));
+
+    // Changed gridA cells: recompute all their overlaps
+    if (setA.size() > 0) {
+        ogridI.realize_rtree();
+        std::vector<long> sortedA(setA.begin(), setA.end());
+        std::sort(sortedA.begin(), sortedA.end());
+        for (long iA : sortedA) {
+            auto ii(ogridA.ocells.find(iA));
+            if (ii == ogridA.ocells.end()) continue;    // Cell was removed
+            ocell1 = &ii->second;
+            search_overlaps(ogridI, ocell1, callback);
+        }
+        for (auto &tc : excells)
+            exgrid.add({(int)tc.i, (int)tc.j}, polygon_area(tc.vertices));
+        excells.clear();
+    }
+
+    // Changed gridI cells: recompute overlaps with unchanged gridA cells
+    if (setI.size() > 0) {
+        ogridA.realize_rtree();
+        std::vector<long> sortedI(setI.begin(), setI.end());
+        std::sort(sortedI.begin(), sortedI.end());
+        for (long iI : sortedI) {
+            auto ii(ogridI.ocells.find(iI));
+            if (ii == ogridI.ocells.end()) continue;    // Cell was removed
+            ocell1 = &ii->second;
+            search_overlaps(ogridA, ocell1, callback);
+        }
+        // Here, tc.i is the gridI cell and tc.j the gridA cell
+        for (auto &tc : excells) {
+            if (setA.find(tc.j) != setA.end()) continue;    // Done above
+            exgrid.add({(int)tc.j, (int)tc.i}, polygon_area(tc.vertices));
+        }
+    }
+
+    printf("Kept %ld overlaps, recomputed %ld (%ld floating point, %ld exact)\n",
+        nkept, (long)exgrid.dense_extent() - nkept,
+        (long)counts.fast, (long)counts.exact);
+    return exgrid;
+}
+
+// --------------------------------------------------------------------
+// MPI-distributed overlap
+
+/** Overlap records (iA, iI, area) computed by one MPI rank */
+struct OverlapRecords {
+    std::vector<int> indices;    // (iA, iI) pairs
+    std::vector<double> overlaps;
+};
+
+static void add_tile_records(OverlapRecords *recs,
+    std::vector<TileExCell> &excells)
+{
+    for (auto &tc : excells) {
+        recs->indices.push_back(tc.i);
+        recs->indices.push_back(tc.j);
+        recs->overlaps.push_back(polygon_area(tc.vertices));
+    }
+}
+
+static void write_records(ExchangeGridWriter *writer, OverlapRecords const &recs)
+{
+    for (size_t i=0; i<recs.overlaps.size(); ++i)
+        writer->add(recs.indices[i*2], recs.indices[i*2+1], recs.overlaps[i]);
+}
+
+template<class GridT>
+static void _write_exchange_grid_mpi(
+    boost::mpi::communicator const &world,
+    GridT const *gridA, GridT const *gridI,
+    ExchangeGridWriter *writer,
+    int ntile,
+    bool exact)
+{
+    int const rank = world.rank();
+    int const nrank = world.size();
+
+    // Rectilinear grids are cheap: the root does them alone
+    bool rectilinear = false;
+    if (rank == 0) rectilinear = rectilinear_overlaps(gridA, gridI,
+        std::bind(&write_rectangle_cell, writer, _1, _2, _3, _4));
+    boost::mpi::broadcast(world, rectilinear, 0);
+    if (rectilinear) {
+        if (rank == 0) {
+            writer->flush();
+            printf("Overlaps computed analytically; %ld written\n", (long)writer->size());
+        }
+        return;
+    }
+
+    std::string sproj;
+    std::unique_ptr<Proj2> projA, projI;
+    exchange_projections(gridA, gridI, sproj, projA, projI);
+
+    // Each rank keeps one band of gridA, and the part of gridI that
+    // can overlap it (including cells straddling the band edges).
+    OGrid ogridA(gridA, &*projA);
+    std::array<double,4> const window(ogridA.keep_band(rank, nrank));
+    OGrid ogridI(gridI, &*projI, window);
+    ogridI.realize_rtree();
+    printf("[%d] Overlapping %ld gridA cells with %ld gridI cells\n",
+        rank, (long)ogridA.ocells.size(), (long)ogridI.ocells.size());
+
+    OverlapRecords recs;
+    OverlapCounts counts;
+    if (ogridA.ocells.size() > 0) {
+        overlap_tiles(ogridA, ogridI, std::max(1, ntile), exact, &counts,
+            std::bind(&add_tile_records, &recs, _1));
+    }
+
+    // Gather on the root, one rank at a time (in rank order)
+    if (rank == 0) {
+        write_records(writer, recs);
+        for (int r=1; r<nrank; ++r) {
+            world.recv(r, 0, recs.indices);
+            world.recv(r, 1, recs.overlaps);
+            write_records(writer, recs);
+        }
+        writer->flush();
+        printf("Overlaps computed on %d ranks; %ld written\n", nrank, (long)writer->size());
+    } else {
+        world.send(0, 0, recs.indices);
+        world.send(0, 1, recs.overlaps);
+    }
+}
+
+// --------------------------------------------------------------------
+Grid make_exchange_grid(
+    Grid const *gridA, Grid const *gridI,
+    std::string sproj, int ntile, bool exact, std::string const &cacheI)
+{ return _make_exchange_grid(gridA, gridI, sproj, ntile, exact, cacheI); }
+
+Grid make_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    std::string sproj, int ntile, bool exact, std::string const &cacheI)
+{ return _make_exchange_grid(gridA, gridI, sproj, ntile, exact, cacheI); }
+
+void write_exchange_grid(
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGridWriter &writer, int ntile, bool exact, std::string const &cacheI)
+{ _write_exchange_grid(gridA, gridI, writer, ntile, exact, cacheI); }
+
+void write_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGridWriter &writer, int ntile, bool exact, std::string const &cacheI)
+{ _write_exchange_grid(gridA, gridI, writer, ntile, exact, cacheI); }
+
+ExchangeGrid update_exchange_grid(
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGrid const &exgrid0,
+    std::vector<long> const &changedA, std::vector<long> const &changedI,
+    bool exact, std::string const &cacheI)
+{ return _update_exchange_grid(gridA, gridI, exgrid0, changedA, changedI, exact, cacheI); }
+
+ExchangeGrid update_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGrid const &exgrid0,
+    std::vector<long> const &changedA, std::vector<long> const &changedI,
+    bool exact, std::string const &cacheI)
+{ return _update_exchange_grid(gridA, gridI, exgrid0, changedA, changedI, exact, cacheI); }
+
+void write_exchange_grid_mpi(
+    boost::mpi::communicator const &world,
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGridWriter *writer, int ntile, bool exact)
+{ _write_exchange_grid_mpi(world, gridA, gridI, writer, ntile, exact); }
+
+void write_exchange_grid_mpi(
+    boost::mpi::communicator const &world,
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGridWriter *writer, int ntile, bool exact)
+{ _write_exchange_grid_mpi(world, gridA, gridI, writer, ntile, exact); }
 
 };  // namespace glint2
@@ -19,15 +19,145 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <netcdf>
+#include <boost/mpi.hpp>
 #include <icebin/Grid.hpp>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/AbbrGrid.hpp>
+#include <icebin/nc_layout.hpp>
 #include <ibmisc/Proj.hpp>
 
 namespace icebin {
 
+/** Overlaps two grids, producing the exchange grid.
+If both grids are rectilinear (XY grids with the same projection, or
+lon/lat grids without polar caps), the exchange grid is computed
+directly from 1-D overlaps of the cell boundaries; otherwise cells
+are overlapped as polygons.
+@param sproj Projection of the exchange grid (default: from gridA or gridI)
+@param ntile If >0, divide gridA into ntile x ntile tiles, which are
+    overlapped in parallel (if built with OpenMP).  Exchange cells are
+    then numbered by tile, so the result is deterministic but differs
+    in order from the serial (ntile=0) version.
+@param exact If set, always overlap with CGAL exact arithmetic.
+    Otherwise, convex cells are overlapped in floating point
+    (convex_overlap()) wherever that is robust.
+@param cacheI If set, name of a sidecar file caching gridI's projected
+    polygons and bounding boxes.  It is reused if it matches gridI and
+    the projection, and (re)written otherwise.  Useful when one ice
+    grid is overlapped with several GCM grids. */
 extern Grid make_exchange_grid(
     Grid const *gridA, Grid const *gridI,
-    std::string sproj = "");
+    std::string sproj = "",
+    int ntile = 0,
+    bool exact = false,
+    std::string const &cacheI = "");
 
+/** Same as above, reading cells from compact FlatGrids */
+extern Grid make_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    std::string sproj = "",
+    int ntile = 0,
+    bool exact = false,
+    std::string const &cacheI = "");
+
+/** Writes overlap records (iA, iI, area) to NetCDF in the layout read
+by ExchangeGrid::ncio(), a chunk at a time, so the exchange grid is
+never held in memory. */
+class ExchangeGridWriter {
+    netCDF::NcGroup *nc;
+    std::string const vname;
+    netCDF::NcVar indices_v, overlaps_v;
+
+    // Records not yet written
+    std::vector<int> indices;    // (iA, iI) pairs
+    std::vector<double> overlaps;
+    size_t nwritten = 0;
+
+public:
+    /** Number of records buffered before they are written */
+    size_t const chunk_size;
+
+    /** Defines the variables <vname>.indices and <vname>.overlaps,
+    chunked and compressed according to layout. */
+    ExchangeGridWriter(netCDF::NcGroup *_nc, std::string const &_vname,
+        size_t _chunk_size = 1024*1024,
+        NcLayout const &layout = NcLayout());
+
+    void add(int iA, int iI, double area);
+
+    /** Writes any buffered records */
+    void flush();
+
+    /** Total number of records added */
+    size_t size() const { return nwritten + overlaps.size(); }
+};
+
+/** Streaming version of make_exchange_grid(): overlap records are
+written (in the same order as make_exchange_grid(..., ntile, exact)
+would produce exchange cells) as each tile completes.  Polygon
+geometry is not kept.
+@param ntile Number of tiles per side (at least 1) */
+extern void write_exchange_grid(
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGridWriter &writer,
+    int ntile,
+    bool exact = false,
+    std::string const &cacheI = "");
+
+extern void write_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGridWriter &writer,
+    int ntile,
+    bool exact = false,
+    std::string const &cacheI = "");
+
+
+/** MPI version of write_exchange_grid(); collective over world.  Each
+rank overlaps one band of gridA cells (of roughly equal size, sorted
+by y in the overlap plane) with just the gridI cells that can overlap
+that band, so no rank holds all of gridI's polygons.  Records are
+gathered on rank 0 and written in (rank, tile, cell) order.  Every
+rank must pass the full gridA and gridI.
+@param writer Used only on rank 0 (may be nullptr elsewhere) */
+extern void write_exchange_grid_mpi(
+    boost::mpi::communicator const &world,
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGridWriter *writer,
+    int ntile,
+    bool exact = false);
+
+extern void write_exchange_grid_mpi(
+    boost::mpi::communicator const &world,
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGridWriter *writer,
+    int ntile,
+    bool exact = false);
+
+/** Patches an exchange grid after some cells of gridA and/or gridI
+have changed (eg, the ice domain was extended in one region), without
+redoing the whole overlap.  Overlaps involving changed cells are
+dropped, and recomputed from the current grids.
+@param exgrid0 Exchange grid of the (previous) grids
+@param changedA, changedI Indices of changed, added or removed cells
+@param exact, cacheI As in make_exchange_grid()
+@return The unchanged overlaps of exgrid0 (in their original order),
+    followed by the recomputed ones. */
+extern ExchangeGrid update_exchange_grid(
+    Grid const *gridA, Grid const *gridI,
+    ExchangeGrid const &exgrid0,
+    std::vector<long> const &changedA,
+    std::vector<long> const &changedI,
+    bool exact = false,
+    std::string const &cacheI = "");
 
+extern ExchangeGrid update_exchange_grid(
+    FlatGrid const *gridA, FlatGrid const *gridI,
+    ExchangeGrid const &exgrid0,
+    std::vector<long> const &changedA,
+    std::vector<long> const &changedI,
+    bool exact = false,
+    std::string const &cacheI = "");
 
 }   // namespace icebin
@@ -18,12 +18,21 @@
 
 #include <functional>
 #include <cmath>
+#include <algorithm>
+#include <numeric>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
 
 #include <ibmisc/geodesy.hpp>
 #include <ibmisc/netcdf.hpp>
 
 #include <icebin/Grid.hpp>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/fast_indexing.hpp>
 #include <icebin/error.hpp>
+#include <icebin/parallel.hpp>    // max_threads()
 
 #include <icebin/gridgen/GridGen_LonLat.hpp>
 #include <icebin/gridgen/gridutil.hpp>
@@ -116,7 +125,14 @@ Grid make_grid(
     GridMap<Vertex> vertices(-1);    // Unknown and don't care how many vertices in full grid
     GridMap<Cell> cells(spec.nlon() * spec.nlat());
 
-    VertexCache vcache(&vertices);
+    // Vertices lie on the edges of a lattice with points_in_side
+    // spaces along each side of each (non-polar) grid cell.
+    int const nside = spec.points_in_side;
+    long const nlonb = spec.lonb.size()-1;
+    long const nlatb = spec.latb.size()-1;
+    cells.reserve(nlonb * nlatb + 2);
+    vertices.reserve((nlonb+1) * (nlatb+1) * (2*nside-1));
+    LatticeVertexCache vcache(&vertices, nlonb*nside, nlatb*nside);
 
     // ------------------- Set up the GCM Grid
     const int south_pole_offset = (spec.south_pole ? 1 : 0);
@@ -155,18 +171,19 @@ Grid make_grid(
                 lats.push_back(lat0 + (lat1-lat0) * ((double)i/(double)n));
 
             // Build a square out of them (in lon/lat space)
+            long const ix0 = ilon*n;    // Lattice position of (lon0, lat0)
+            long const iy0 = ilat*n;
             for (int i=0; i<n; ++i)
-                vcache.add_vertex(cell, lons[i], lat0);
+                vcache.add_vertex(cell, ix0+i, iy0, lons[i], lat0);
 
             for (int i=0; i<n; ++i)
-                vcache.add_vertex(cell, lon1, lats[i]);
+                vcache.add_vertex(cell, ix0+n, iy0+i, lon1, lats[i]);
 
-            // Try to keep calculations EXACTLY the same for VertexCache
             for (int i=n; i>0; --i)
-                vcache.add_vertex(cell, lons[i], lat1);
+                vcache.add_vertex(cell, ix0+i, iy0+n, lons[i], lat1);
 
             for (int i=n; i>0; --i)
-                vcache.add_vertex(cell, lon0, lats[i]);
+                vcache.add_vertex(cell, ix0, iy0+i, lon0, lats[i]);
 
             cells.add(std::move(cell));
         }
@@ -188,7 +205,7 @@ Grid make_grid(
             int n = spec.points_in_side;
             for (int i=0; i<n; ++i) {
                 double lon = lon0 + (lon1-lon0) * ((double)i/(double)n);
-                pole.add_vertex(vcache.add_vertex(lon, lat));
+                pole.add_vertex(vcache.add_vertex(ilon*n+i, nlatb*n, lon, lat));
             }
         }
 
@@ -210,7 +227,7 @@ Grid make_grid(
             int n = spec.points_in_side;
             for (int i=0; i<n; ++i) {
                 double lon = lon0 + (lon1-lon0) * ((double)i/(double)n);
-                pole.add_vertex(vcache.add_vertex(lon, lat));
+                pole.add_vertex(vcache.add_vertex(ilon*n-i, 0, lon, lat));
             }
         }
         pole.i = 0;
@@ -231,6 +248,350 @@ Grid make_grid(
 
 }
 
+// ---------------------------------------------------------
+/** One latitude row of a lon/lat grid, as built by make_flat_grid():
+its cells, and the vertices they create.  Built independently of the
+other rows. */
+struct LonLatRow {
+    std::vector<char> keep;      // Result of clipping each cell of the row
+    std::vector<int> ilon;       // Realized cells
+    std::vector<long> vstart;    // Start of each realized cell in vref
+    // Vertices of each realized cell: position in x,y; or -1-ix
+    // for lattice point ix on the bottom of this row, created by the
+    // row below.
+    std::vector<long> vref;
+    std::vector<double> x, y;    // Vertices created by this row, in order
+    // Position in x,y of each lattice point on the top (and bottom,
+    // for the first row) of this row; or -1
+    std::vector<long> top, bottom;
+
+    long vertex0, cell0, vref0;  // Position of the row in the FlatGrid
+};
+
+/** Was lattice point ix on the top of a row used by one of its
+(realized) cells? */
+static bool lattice_used(char const *keep, long nlonb, int n, long ix)
+{
+    long const ilon = ix / n;
+    return (ilon < nlonb && keep[ilon]) || (ix % n == 0 && ilon > 0 && keep[ilon-1]);
+}
+
+/** Sorts cells by index, if they are not already */
+static void sort_cells(FlatCells &cells)
+{
+    if (std::is_sorted(cells.index.begin(), cells.index.end())) return;
+
+    std::vector<long> perm(cells.index.size());
+    std::iota(perm.begin(), perm.end(), 0);
+    std::sort(perm.begin(), perm.end(),
+        [&cells](long a, long b) { return cells.index[a] < cells.index[b]; });
+
+    FlatCells cells0(std::move(cells));
+    cells.clear();
+    cells.set_nfull(cells0.nfull());
+    cells.vstart.push_back(0);
+    for (long pos : perm) {
+        cells.index.push_back(cells0.index[pos]);
+        cells.native_area.push_back(cells0.native_area[pos]);
+        cells.i.push_back(cells0.i[pos]);
+        cells.j.push_back(cells0.j[pos]);
+        cells.k.push_back(cells0.k[pos]);
+        for (long v = cells0.vstart[pos]; v < cells0.vstart[pos+1]; ++v) {
+            cells.vref.push_back(cells0.vref[v]);
+            cells.x.push_back(cells0.x[v]);
+            cells.y.push_back(cells0.y[v]);
+        }
+        cells.vstart.push_back(cells.vref.size());
+    }
+}
+
+FlatGrid make_flat_grid(
+    std::string const &name,
+    GridSpec_LonLat const &spec,
+    SphericalRowClip const &row_clip)
+{
+    Indexing indexing({"lon", "lat"}, {0,0}, {spec.nlon(), spec.nlat()}, spec.indices);
+    FastIndexing<2> const fast_indexing(indexing);
+
+    // Same lattice as make_grid()
+    int const n = spec.points_in_side;
+    long const nlonb = spec.lonb.size()-1;
+    long const nlatb = spec.latb.size()-1;
+    long const nx1 = nlonb*n + 1;    // Lattice points along each lattice row
+    const int south_pole_offset = (spec.south_pole ? 1 : 0);
+
+    std::vector<LonLatRow> rows(nlatb);
+
+    // ------------ Clip each row
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(max_threads())
+#endif
+    for (long ilat=0; ilat<nlatb; ++ilat) {
+        std::vector<long> index(nlonb);
+        for (long ilon=0; ilon<nlonb; ++ilon)
+            index[ilon] = fast_indexing.tuple_to_index({ilon, ilat + south_pole_offset});
+
+        rows[ilat].keep.resize(nlonb);
+        row_clip(spec.lonb, spec.latb[ilat], spec.latb[ilat+1],
+            index.data(), rows[ilat].keep.data());
+    }
+
+    // ------------ Build each row's cells and vertices
+    // make_grid() numbers vertices in the order it creates them, going
+    // up row by row.  So a row creates every lattice point its cells
+    // use, except those on its bottom already used by the row below.
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(max_threads())
+#endif
+    for (long ilat=0; ilat<nlatb; ++ilat) {
+        LonLatRow &row(rows[ilat]);
+        char const *keep_below = (ilat > 0 ? rows[ilat-1].keep.data() : nullptr);
+        double const lat0 = spec.latb[ilat];
+        double const lat1 = spec.latb[ilat+1];
+
+        // Position in row.x,y of each lattice point of the row, or -1
+        std::vector<long> local((n+1)*nx1, -1);
+        auto add_vertex = [&](long ix, int iy, double x, double y) {
+            long &pos(local[iy*nx1 + ix]);
+            if (pos < 0) {
+                if (iy == 0 && keep_below && lattice_used(keep_below, nlonb, n, ix)) {
+                    row.vref.push_back(-1-ix);
+                    return;
+                }
+                pos = row.x.size();
+                row.x.push_back(x);
+                row.y.push_back(y);
+            }
+            row.vref.push_back(pos);
+        };
+
+        // Pre-compute our points so we use exact same ones each time.
+        std::vector<double> lats;
+        lats.reserve(n+1);
+        for (int i=0; i<=n; ++i)
+            lats.push_back(lat0 + (lat1-lat0) * ((double)i/(double)n));
+
+        std::vector<double> lons(n+1);
+        for (int ilon=0; ilon<nlonb; ++ilon) {
+            if (!row.keep[ilon]) continue;
+            row.ilon.push_back(ilon);
+            row.vstart.push_back(row.vref.size());
+
+            double lon0 = spec.lonb[ilon];
+            double lon1 = spec.lonb[ilon+1];
+            for (int i=0; i<=n; ++i)
+                lons[i] = lon0 + (lon1-lon0) * ((double)i/(double)n);
+
+            // Build a square out of them (in lon/lat space)
+            long const ix0 = ilon*n;    // Lattice position of (lon0, lat0)
+            for (int i=0; i<n; ++i)
+                add_vertex(ix0+i, 0, lons[i], lat0);
+
+            for (int i=0; i<n; ++i)
+                add_vertex(ix0+n, i, lon1, lats[i]);
+
+            for (int i=n; i>0; --i)
+                add_vertex(ix0+i, n, lons[i], lat1);
+
+            for (int i=n; i>0; --i)
+                add_vertex(ix0, i, lon0, lats[i]);
+        }
+        row.vstart.push_back(row.vref.size());
+
+        row.top.assign(local.begin() + n*nx1, local.end());
+        if (ilat == 0) row.bottom.assign(local.begin(), local.begin() + nx1);
+    }
+
+    // ------------ Number the rows' vertices and cells
+    long nvertices = 0;
+    long ncells = 0;
+    long nvref = 0;
+    for (auto &row : rows) {
+        row.vertex0 = nvertices;
+        row.cell0 = ncells;
+        row.vref0 = nvref;
+        nvertices += row.x.size();
+        ncells += row.ilon.size();
+        nvref += row.vref.size();
+    }
+
+    // ------------ Make the polar caps (if this grid specifies them)
+    struct PolarCap {
+        bool realized = false;
+        long index;
+        int i, j;
+        double native_area;
+        std::vector<long> vref;
+    } north, south;    // Created in this order, as in make_grid()
+
+    // Lattice points on the top and bottom of the grid: global index, or -1
+    std::vector<long> gtop(nx1, -1), gbottom(nx1, -1);
+    if (nlatb > 0) {
+        LonLatRow const &top(rows.back());
+        LonLatRow const &bottom(rows.front());
+        for (long ix=0; ix<nx1; ++ix) {
+            if (top.top[ix] >= 0) gtop[ix] = top.vertex0 + top.top[ix];
+            if (bottom.bottom[ix] >= 0) gbottom[ix] = bottom.vertex0 + bottom.bottom[ix];
+        }
+    }
+    std::vector<long> &gsouth(nlatb > 0 ? gbottom : gtop);
+
+    std::vector<double> capx, capy;    // Vertices created by the polar caps
+    auto add_cap_vertex = [&](std::vector<long> &line, long ix, double x, double y) {
+        long &vix(line[ix]);
+        if (vix < 0) {
+            vix = nvertices + capx.size();
+            capx.push_back(x);
+            capy.push_back(y);
+        }
+        return vix;
+    };
+    std::vector<double> const cap_lonb {0., 360.};
+    char keep_cap;
+
+    // North Pole cap
+    double lat = spec.latb.back();
+    {
+        PolarCap &pole(north);
+        pole.i = spec.nlon()-1;
+        pole.j = spec.nlat();
+        pole.index = (pole.j * spec.nlon() + pole.i);
+        if (spec.north_pole) row_clip(cap_lonb, lat, 90, &pole.index, &keep_cap);
+        if (spec.north_pole && keep_cap) {
+            for (int ilon=0; ilon<nlonb; ++ilon) {
+                double lon0 = spec.lonb[ilon];
+                double lon1 = spec.lonb[ilon+1];
+                for (int i=0; i<n; ++i) {
+                    double lon = lon0 + (lon1-lon0) * ((double)i/(double)n);
+                    pole.vref.push_back(add_cap_vertex(gtop, ilon*n+i, lon, lat));
+                }
+            }
+            pole.native_area = polar_graticule_area_exact(spec.eq_rad, 90.0 - lat);
+            pole.realized = true;
+        }
+    }
+
+    // South Pole cap
+    lat = spec.latb[0];
+    {
+        PolarCap &pole(south);
+        pole.i = 0;
+        pole.j = 0;
+        pole.index = 0;
+        if (spec.south_pole) row_clip(cap_lonb, -90, lat, &pole.index, &keep_cap);
+        if (spec.south_pole && keep_cap) {
+            for (int ilon=nlonb; ilon >= 1; --ilon) {
+                double lon0 = spec.lonb[ilon];     // Make the circle counter-clockwise
+                double lon1 = spec.lonb[ilon-1];
+                for (int i=0; i<n; ++i) {
+                    double lon = lon0 + (lon1-lon0) * ((double)i/(double)n);
+                    pole.vref.push_back(add_cap_vertex(gsouth, ilon*n-i, lon, lat));
+                }
+            }
+            pole.native_area = polar_graticule_area_exact(spec.eq_rad, 90.0 + lat);
+            pole.realized = true;
+        }
+    }
+
+    // ------------ Assemble the FlatGrid
+    FlatGrid grid;
+    grid.spec.reset(new GridSpec_LonLat(spec));
+    grid.coordinates = GridCoordinates::LONLAT;
+    grid.parameterization = GridParameterization::L0;
+    grid.indexing = std::move(indexing);
+    grid.name = name;
+    grid.sproj = "";
+
+    // Vertices: numbered in order of creation, so already sorted
+    FlatVertices &vertices(grid.vertices);
+    long const nvertices_all = nvertices + capx.size();
+    vertices.index.resize(nvertices_all);
+    std::iota(vertices.index.begin(), vertices.index.end(), 0);
+    vertices.x.resize(nvertices_all);
+    vertices.y.resize(nvertices_all);
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(max_threads())
+#endif
+    for (long ilat=0; ilat<nlatb; ++ilat) {
+        LonLatRow const &row(rows[ilat]);
+        std::copy(row.x.begin(), row.x.end(), vertices.x.begin() + row.vertex0);
+        std::copy(row.y.begin(), row.y.end(), vertices.y.begin() + row.vertex0);
+    }
+    std::copy(capx.begin(), capx.end(), vertices.x.begin() + nvertices);
+    std::copy(capy.begin(), capy.end(), vertices.y.begin() + nvertices);
+
+    // Cells: the rows, with the north cap after them; and the south cap
+    // (index 0) in front, so the usual (lon fastest) indexing needs no sort.
+    FlatCells &cells(grid.cells);
+    cells.set_nfull(spec.nlon() * spec.nlat());
+    long const cell_shift = (south.realized ? 1 : 0);
+    long const vref_shift = south.vref.size();
+    long const ncells_all = cell_shift + ncells + (north.realized ? 1 : 0);
+    long const nvref_all = vref_shift + nvref + north.vref.size();
+    cells.index.resize(ncells_all);
+    cells.native_area.resize(ncells_all);
+    cells.i.resize(ncells_all);
+    cells.j.resize(ncells_all);
+    cells.k.resize(ncells_all, -1);
+    cells.vstart.resize(ncells_all+1);
+    cells.vref.resize(nvref_all);
+    cells.x.resize(nvref_all);
+    cells.y.resize(nvref_all);
+
+    auto add_cap = [&](PolarCap const &pole, long pos, long vpos) {
+        cells.index[pos] = pole.index;
+        cells.native_area[pos] = pole.native_area;
+        cells.i[pos] = pole.i;
+        cells.j[pos] = pole.j;
+        cells.vstart[pos] = vpos;
+        std::copy(pole.vref.begin(), pole.vref.end(), cells.vref.begin() + vpos);
+    };
+    if (south.realized) add_cap(south, 0, 0);
+    if (north.realized) add_cap(north, cell_shift + ncells, vref_shift + nvref);
+    cells.vstart[ncells_all] = nvref_all;
+
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(max_threads())
+#endif
+    for (long ilat=0; ilat<nlatb; ++ilat) {
+        LonLatRow const &row(rows[ilat]);
+        LonLatRow const *below = (ilat > 0 ? &rows[ilat-1] : nullptr);
+        double const lat0 = spec.latb[ilat];
+        double const lat1 = spec.latb[ilat+1];
+        int const j = ilat + south_pole_offset;
+
+        for (size_t c=0; c<row.ilon.size(); ++c) {
+            long const pos = cell_shift + row.cell0 + c;
+            int const i = row.ilon[c];
+            cells.index[pos] = fast_indexing.tuple_to_index({(long)i, (long)j});
+            cells.native_area[pos] = graticule_area_exact(spec.eq_rad,
+                lat0, lat1, spec.lonb[i], spec.lonb[i+1]);
+            cells.i[pos] = i;
+            cells.j[pos] = j;
+            cells.vstart[pos] = vref_shift + row.vref0 + row.vstart[c];
+        }
+
+        long *vref = &cells.vref[vref_shift + row.vref0];
+        for (size_t v=0; v<row.vref.size(); ++v) {
+            long const lpos = row.vref[v];
+            vref[v] = (lpos >= 0 ? row.vertex0 + lpos
+                : below->vertex0 + below->top[-1-lpos]);
+        }
+    }
+
+    // Copy vertex coordinates into the cells
+#ifdef USE_OPENMP
+    #pragma omp parallel for num_threads(max_threads())
+#endif
+    for (long v=0; v<nvref_all; ++v) {
+        cells.x[v] = vertices.x[cells.vref[v]];
+        cells.y[v] = vertices.y[cells.vref[v]];
+    }
+
+    sort_cells(cells);
+    return grid;
+}
+
 AbbrGrid make_abbr_grid(
     std::string const &name,
     GridSpec_LonLat const &spec,
@@ -29,6 +29,7 @@ namespace icebin {
 
 class Grid;
 class Cell;
+class FlatGrid;
 
 /** Represents a Cartesian grid with non-equally-spaced grid cell boundaries. */
 extern Grid make_grid(
@@ -36,6 +37,18 @@ extern Grid make_grid(
     GridSpec_LonLat const &spec,
     std::function<bool(long, double,double,double,double)> spherical_clip = &SphericalClip::keep_all);
 
+/** Same as make_grid(), but generates directly into a FlatGrid, with
+latitude rows clipped and built in parallel (OpenMP).  The cells and
+vertices (including vertex numbering) are the same as those of
+FlatGrid(make_grid(...)).  Rather than a Grid of millions of separately
+allocated cells, this is the way to generate very fine grids.
+@param row_clip Only realize grid cells that pass this test; see
+    SphericalRowClip, SphericalClip::by_cell() */
+extern FlatGrid make_flat_grid(
+    std::string const &name,
+    GridSpec_LonLat const &spec,
+    SphericalRowClip const &row_clip = &SphericalClip::keep_all_row);
+
 extern AbbrGrid make_abbr_grid(
     std::string const &name,
     GridSpec_LonLat const &spec,
@@ -0,0 +1,162 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <ibmisc/stdio.hpp>
+#include <icebin/error.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+#include <icebin/gridgen/GridGen_XY.hpp>
+#include <icebin/gridgen/GridGen_LonLat.hpp>
+#include <icebin/gridgen/GridGen_Exchange.hpp>
+
+using namespace ibmisc;
+
+namespace icebin {
+
+/** Side of an ice sheet domain in the plane (m) */
+static double const SHEET_L = 1e6;
+
+/** Distance of the (lon/lat) ice sheets from the pole, on the map (m) */
+static double const SHEET_R0 = 2e6;
+
+/** Southern edge of the lon/lat GCM grid (degrees) */
+static double const LAT_MIN = 50.;
+
+blitz::Array<double,1> SyntheticSheet::elevmaskI(double height, double bump) const
+{
+    blitz::Array<double,1> elevmaskI(gridI->ndata());
+    elevmaskI = std::numeric_limits<double>::quiet_NaN();
+    for (auto cell=gridI->cells.begin(); cell != gridI->cells.end(); ++cell) {
+        Point const pt(cell->centroid());
+        double const r = std::sqrt(
+            (pt.x-xc)*(pt.x-xc) + (pt.y-yc)*(pt.y-yc)) / radius;
+        if (r < 1.) elevmaskI(cell->index) = height * std::sqrt(1. - r*r) + bump;
+    }
+    return elevmaskI;
+}
+
+std::vector<blitz::Array<double,1>> SyntheticGrids::elevmaskIs(double bump) const
+{
+    std::vector<blitz::Array<double,1>> ret;
+    for (auto const &sheet : sheets)
+        ret.push_back(sheet.elevmaskI(spec.dome_height, bump));
+    return ret;
+}
+
+std::unique_ptr<GCMRegridder_Standard> SyntheticGrids::gcm_regridder(
+    InterpStyle interp_style, bool correctA) const
+{
+    std::unique_ptr<GCMRegridder_Standard> gcm(new GCMRegridder_Standard);
+    std::vector<double> _hcdefs(hcdefs);
+    long const nhc = hcdefs.size();
+    gcm->init(AbbrGrid(*gridA), std::move(_hcdefs),
+        Indexing({"A", "HC"}, {0,0}, {(long)gridA->ndata(), nhc}, {1,0}),
+        correctA);
+
+    for (auto const &sheet : sheets) {
+        auto regridder(new_ice_regridder(sheet.gridI->parameterization));
+        regridder->init(sheet.name, *gcm->agridA, &*gridA,
+            AbbrGrid(*sheet.gridI), ExchangeGrid(*sheet.exgrid), interp_style);
+        gcm->add_sheet(std::move(regridder));
+    }
+    return gcm;
+}
+
+/** Global lon/lat grid, clipped to the north of LAT_MIN, with
+(approximately) nA cells per side of an ice sheet domain of side L. */
+static std::unique_ptr<Grid> make_synthetic_gridA_lonlat(SyntheticSpec const &spec, double L)
+{
+    double const dlat = (L / spec.nA) / (spec.eq_rad * M_PI / 180.);
+    int const jm = 2 * std::max(1, (int)std::round(90. / dlat));
+    HntrSpec const hntr(2*jm, jm, 0., 180.*60. / jm);
+
+    return std::unique_ptr<Grid>(new Grid(make_grid("A",
+        make_grid_spec(hntr, false, 2, spec.eq_rad),
+        [](long index, double lon0, double lat0, double lon1, double lat1)
+            { return std::max(lat0, lat1) > LAT_MIN; })));
+}
+
+SyntheticGrids make_synthetic_grids(SyntheticSpec const &spec)
+{
+    if (spec.nA < 1 || spec.refine < 1 || spec.nsheet < 1) (*icebin_error)(-1,
+        "nA, refine and nsheet must be positive: %d %d %d",
+        spec.nA, spec.refine, spec.nsheet);
+    if (spec.nhc < 2) (*icebin_error)(-1,
+        "At least two elevation classes are needed: %d", spec.nhc);
+
+    SyntheticGrids ret;
+    ret.spec = spec;
+
+    for (int ihc=0; ihc < spec.nhc; ++ihc)
+        ret.hcdefs.push_back(spec.dome_height * ihc / (spec.nhc - 1));
+
+    // Around the pole, keep the sheets from overlapping each other
+    double const L = (spec.lonlat
+        ? std::min(1.5 * SHEET_L, .7 * 2*M_PI*SHEET_R0 / spec.nsheet)
+        : SHEET_L);
+    double const dxA = L / spec.nA;
+    double const dxI = dxA / spec.refine;
+    double const off = spec.offset * dxI;
+
+    if (spec.lonlat) {
+        ret.gridA = make_synthetic_gridA_lonlat(spec, L);
+    } else {
+        ret.gridA.reset(new Grid(make_grid("A", GridSpec_XY::make_with_boundaries(
+            "", {0,1},
+            0., spec.nsheet * L, dxA,
+            0., L, dxA))));
+    }
+
+    ret.sheets.reserve(spec.nsheet);
+    for (int k=0; k < spec.nsheet; ++k) {
+        ret.sheets.push_back(SyntheticSheet());
+        SyntheticSheet &sheet(ret.sheets.back());
+        sheet.name = strprintf("sheet%d", k);
+        sheet.radius = .45 * L;
+
+        // Lower-left corner of the sheet domain, and its projection
+        double x0, y0;
+        std::string sproj;
+        if (spec.lonlat) {
+            // The lon_0 meridian points to -y
+            sproj = strprintf("+proj=stere +lon_0=%g +lat_0=90 +lat_ts=71.0 +ellps=WGS84",
+                -180. + 360. * (k + .5) / spec.nsheet);
+            x0 = -.5*L;
+            y0 = -SHEET_R0 - .5*L;
+        } else {
+            x0 = k * L;
+            y0 = 0.;
+        }
+        sheet.xc = x0 + .5*L;
+        sheet.yc = y0 + .5*L;
+
+        sheet.gridI.reset(new Grid(make_grid(sheet.name, GridSpec_XY::make_with_boundaries(
+            sproj, {0,1},
+            x0 + off, x0 + L + off, dxI,
+            y0 + off, y0 + L + off, dxI))));
+
+        sheet.exgrid.reset(new Grid(make_exchange_grid(
+            &*ret.gridA, &*sheet.gridI, "", spec.ntile)));
+    }
+
+    return ret;
+}
+
+}    // namespace icebin
@@ -0,0 +1,107 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <ibmisc/blitz.hpp>
+#include <icebin/Grid.hpp>
+#include <icebin/GCMRegridder.hpp>
+
+namespace icebin {
+
+/** Describes a synthetic GCM grid, ice sheets and elevation classes,
+for benchmarks and scaling studies that should not depend on
+downloaded SeaRISE / PISM / ModelE data.  The same spec always
+produces the same grids.
+
+Each ice sheet is a square XY domain of side L, gridded at
+(nA * refine) cells per side, holding a dome of ice (elevmaskI is
+NaN outside the dome).  The ice grid is offset from the GCM grid by
+a fraction of an ice cell, so exchange cells are not just ice cells.
+The number of exchange cells is about nsheet * (nA * refine)^2. */
+struct SyntheticSpec {
+    /** GCM grid cells per side of an ice sheet domain.  For lon/lat
+    GCM grids, this sets the latitude spacing, and is approximate. */
+    int nA = 100;
+
+    /** Ice grid cells per GCM grid cell, in each direction */
+    int refine = 4;
+
+    int nsheet = 1;
+
+    /** Number of elevation classes; they evenly span [0, dome_height] */
+    int nhc = 10;
+
+    /** If false, the GCM grid is in the same plane as the ice sheets,
+    which lie side by side in x; overlaps are then computed directly
+    from the cell boundaries.  If true, it is a global lon/lat grid
+    (clipped to the northern high latitudes), and each ice sheet uses
+    its own polar stereographic projection, spaced around the pole;
+    overlaps are then computed as polygons. */
+    bool lonlat = false;
+
+    /** Offset of the ice grids from the GCM grid, in ice cells */
+    double offset = .37;
+
+    /** Elevation at the top of each dome (m) */
+    double dome_height = 3000.;
+
+    /** Radius of the Earth (m) for lon/lat grids (same as ModelE) */
+    double eq_rad = 6.371e6;
+
+    /** Passed to make_exchange_grid() */
+    int ntile = 0;
+};
+
+struct SyntheticSheet {
+    std::string name;
+    std::unique_ptr<Grid> gridI;
+    std::unique_ptr<Grid> exgrid;
+
+    /** Center (in gridI's x/y) and radius of the ice dome */
+    double xc, yc, radius;
+
+    /** Elevation of a dome-shaped ice sheet on gridI, NaN outside the
+    dome.  Varying bump changes elevations, but not the ice mask.
+    @param bump Added to the elevation of every ice cell */
+    blitz::Array<double,1> elevmaskI(double height, double bump = 0.) const;
+};
+
+struct SyntheticGrids {
+    SyntheticSpec spec;
+    std::unique_ptr<Grid> gridA;
+    std::vector<double> hcdefs;
+    std::vector<SyntheticSheet> sheets;
+
+    /** elevmaskI of each sheet, with spec.dome_height */
+    std::vector<blitz::Array<double,1>> elevmaskIs(double bump = 0.) const;
+
+    /** Builds a GCMRegridder on these grids, with every ice sheet. */
+    std::unique_ptr<GCMRegridder_Standard> gcm_regridder(
+        InterpStyle interp_style = InterpStyle::Z_INTERP,
+        bool correctA = true) const;
+};
+
+/** Generates the GCM grid, ice grids, exchange grids and elevation
+classes described by spec. */
+extern SyntheticGrids make_synthetic_grids(SyntheticSpec const &spec);
+
+}    // namespace icebin
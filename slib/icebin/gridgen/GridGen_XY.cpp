@@ -70,8 +70,10 @@ Grid make_grid(
     // Set up the main grid
     GridMap<Vertex> vertices(xb.size() * yb.size());
     GridMap<Cell> cells(spec.nx() * spec.ny());
+    vertices.reserve(xb.size() * yb.size());
+    cells.reserve(spec.nx() * spec.ny());
 
-    VertexCache vcache(&vertices);
+    LatticeVertexCache vcache(&vertices, spec.nx(), spec.ny());
     for (int iy = 0; iy < yb.size()-1; ++iy) {      // j
         double y0 = yb[iy];
         double y1 = yb[iy+1];
@@ -83,10 +85,10 @@ Grid make_grid(
             double x1 = xb[ix+1];
 
             Cell cell;
-            vcache.add_vertex(cell, x0, y0);
-            vcache.add_vertex(cell, x1, y0);
-            vcache.add_vertex(cell, x1, y1);
-            vcache.add_vertex(cell, x0, y1);
+            vcache.add_vertex(cell, ix, iy, x0, y0);
+            vcache.add_vertex(cell, ix+1, iy, x1, y0);
+            vcache.add_vertex(cell, ix+1, iy+1, x1, y1);
+            vcache.add_vertex(cell, ix, iy+1, x0, y1);
 
             // Don't include things outside our clipping region
             if (!euclidian_clip(cell)) continue;
@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <icebin/gridgen/clippers.hpp>
 #include <ibmisc/geodesy.hpp>
 
@@ -73,6 +74,57 @@ bool SphericalClip::keep_all(long index,
 double lon0, double lat0, double lon1, double lat1)
     { return true; }
 
+// -------------------------------------------------------------
+void SphericalClip::azimuthal_row(
+double center_lon, double center_lat, double clip_distance_deg,
+std::vector<double> const &lonb, double lat0, double lat1,
+long const *index, char *keep)
+{
+    // Is each cell corner on the south / north edge of the row near enough?
+    size_t const nlonb = lonb.size();
+    std::vector<char> near0(nlonb), near1(nlonb);
+    for (size_t i=0; i<nlonb; ++i) {
+        near0[i] = (ibmisc::haversine_distance(center_lon, center_lat, lonb[i], lat0) <= clip_distance_deg);
+        near1[i] = (ibmisc::haversine_distance(center_lon, center_lat, lonb[i], lat1) <= clip_distance_deg);
+    }
+
+    for (size_t i=0; i+1<nlonb; ++i)
+        keep[i] = near0[i] || near0[i+1] || near1[i+1] || near1[i];
+}
+
+void SphericalClip::lonlat_row(
+double min_lon, double min_lat, double max_lon, double max_lat,
+std::vector<double> const &lonb, double lat0, double lat1,
+long const *index, char *keep)
+{
+    size_t const nlon = lonb.size() - 1;
+    if ((lat0 < min_lat && lat1 < min_lat) || (lat0 > max_lat && lat1 > max_lat)) {
+        std::fill(keep, keep + nlon, 0);
+        return;
+    }
+
+    for (size_t i=0; i<nlon; ++i)
+        keep[i] = lon_intersect(lonb[i], lonb[i+1], min_lon, max_lon);
+}
+
+void SphericalClip::keep_all_row(
+std::vector<double> const &lonb, double lat0, double lat1,
+long const *index, char *keep)
+{
+    std::fill(keep, keep + (lonb.size() - 1), 1);
+}
+
+SphericalRowClip SphericalClip::by_cell(
+std::function<bool(long, double,double,double,double)> const &spherical_clip)
+{
+    return [spherical_clip](std::vector<double> const &lonb,
+        double lat0, double lat1, long const *index, char *keep)
+    {
+        for (size_t i=0; i+1<lonb.size(); ++i)
+            keep[i] = spherical_clip(index[i], lonb[i], lat0, lonb[i+1], lat1);
+    };
+}
+
 
 // =============================================================
 /** @param clip_poly Only realize grid cells that intersect with this polygon (on the map) */
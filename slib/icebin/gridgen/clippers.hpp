@@ -18,10 +18,21 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
 #include <icebin/gridgen/cgal.hpp>
 
 namespace icebin {
 
+/** Clips a whole latitude row of a lon/lat grid at once: sets keep[i]
+for the cell [lonb[i], lonb[i+1]] x [lat0, lat1], which has index
+index[i] (i = 0..lonb.size()-2).  Work that depends only on latitude
+is done once per row, rather than once per cell.  Called from several
+threads at once by make_flat_grid(), so it must be thread-safe.
+@see SphericalClip::keep_all_row() */
+typedef std::function<void(std::vector<double> const &lonb,
+    double lat0, double lat1, long const *index, char *keep)> SphericalRowClip;
+
 /** A set of clipping functions to clip on the surface of a sphere.
 Clipping is used to decide which grid cells in a Grid should not be realized.
 Grep for "spherical_clip" to see where this might be used.
@@ -65,6 +76,28 @@ public:
     @param lat1 Free parameter, not to be bound by bost::bind(). */
     static bool keep_all(long index, double lon0, double lat0, double lon1, double lat1);
 
+    // ------- Row versions (SphericalRowClip); same result as the per-cell versions
+    /** Row version of azimuthal(): cell corners are shared by
+    neighboring cells, so each one is only tested once. */
+    static void azimuthal_row(
+        double center_lon, double center_lat, double clip_distance_deg,
+        std::vector<double> const &lonb, double lat0, double lat1,
+        long const *index, char *keep);
+
+    /** Row version of lonlat(): the latitude test is done once per row. */
+    static void lonlat_row(
+        double min_lon, double min_lat, double max_lon, double max_lat,
+        std::vector<double> const &lonb, double lat0, double lat1,
+        long const *index, char *keep);
+
+    static void keep_all_row(
+        std::vector<double> const &lonb, double lat0, double lat1,
+        long const *index, char *keep);
+
+    /** Wraps a per-cell spherical_clip (which must be thread-safe) as
+    a SphericalRowClip; it is called once per cell. */
+    static SphericalRowClip by_cell(
+        std::function<bool(long, double,double,double,double)> const &spherical_clip);
 };
 
 
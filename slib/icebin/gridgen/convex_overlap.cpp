@@ -0,0 +1,119 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <icebin/gridgen/convex_overlap.hpp>
+
+namespace icebin {
+
+/** Relative error bound for orient(); a little looser than the
+bound for exact inputs, because clipped vertices are themselves
+rounded. */
+static double const ORIENT_EPS = 1e-14;
+
+/** Orientation of c relative to the line a->b: >0 if to the left.
+@param uncertain OUT: Set if the sign might be wrong due to rounding */
+static double orient(
+    std::array<double,2> const &a,
+    std::array<double,2> const &b,
+    std::array<double,2> const &c,
+    bool &uncertain)
+{
+    double const t1 = (b[0]-a[0]) * (c[1]-a[1]);
+    double const t2 = (b[1]-a[1]) * (c[0]-a[0]);
+    double const det = t1 - t2;
+    // det == 0 is only certain if both products are (exactly) 0; if
+    // not, they may just have rounded to the same double
+    if ((det != 0 || t1 != 0) && std::abs(det) <= ORIENT_EPS * (std::abs(t1) + std::abs(t2)))
+        uncertain = true;
+    return det;
+}
+
+bool is_robust_convex(Polygon2d const &P)
+{
+    size_t const n = P.size();
+    if (n < 3) return false;
+
+    bool uncertain = false;
+    bool any_turn = false;
+    for (size_t i=0; i<n; ++i) {
+        double const det = orient(P[i], P[(i+1)%n], P[(i+2)%n], uncertain);
+        if (uncertain || det < 0) return false;
+        if (det > 0) any_turn = true;
+    }
+    return any_turn;
+}
+
+bool convex_overlap(Polygon2d const &P, Polygon2d const &Q, Polygon2d &ret)
+{
+    bool uncertain = false;
+    ret = P;
+    Polygon2d input;
+    std::vector<double> side;
+
+    size_t const nq = Q.size();
+    for (size_t iq=0; iq<nq && ret.size() > 0; ++iq) {
+        auto const &a(Q[iq]);
+        auto const &b(Q[(iq+1)%nq]);
+
+        std::swap(input, ret);
+        ret.clear();
+
+        // Which side of edge a->b each vertex is on (>=0 is inside)
+        size_t const n = input.size();
+        side.resize(n);
+        for (size_t i=0; i<n; ++i) side[i] = orient(a, b, input[i], uncertain);
+        if (uncertain) return false;
+
+        for (size_t i=0; i<n; ++i) {
+            size_t const i0 = (i+n-1) % n;    // Previous vertex
+            bool const in0 = (side[i0] >= 0);
+            bool const in1 = (side[i] >= 0);
+
+            if (in0 != in1 && side[i0] != 0 && side[i] != 0) {
+                // Edge crosses a->b (signs are certain, so t is in (0,1))
+                double const t = side[i0] / (side[i0] - side[i]);
+                auto const &p0(input[i0]);
+                auto const &p1(input[i]);
+                ret.push_back({p0[0] + t*(p1[0]-p0[0]), p0[1] + t*(p1[1]-p0[1])});
+            }
+            if (in1) ret.push_back(input[i]);
+        }
+    }
+
+    // Remove duplicate vertices (from vertices lying exactly on an edge)
+    Polygon2d out;
+    for (size_t i=0; i<ret.size(); ++i) {
+        if (out.size() == 0 || out.back() != ret[i]) out.push_back(ret[i]);
+    }
+    while (out.size() > 1 && out.back() == out.front()) out.pop_back();
+
+    // Degenerate (zero-area) overlaps count as no overlap
+    double area2 = 0;
+    for (size_t i=0; i<out.size(); ++i) {
+        auto const &p0(out[i]);
+        auto const &p1(out[(i+1) % out.size()]);
+        area2 += p0[0]*p1[1] - p1[0]*p0[1];
+    }
+    if (out.size() < 3 || area2 <= 0) out.clear();
+
+    ret = std::move(out);
+    return true;
+}
+
+}   // namespace icebin
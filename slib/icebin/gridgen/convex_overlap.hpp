@@ -0,0 +1,44 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+namespace icebin {
+
+/** Double-precision polygon, as a list of vertices (implicitly closed) */
+typedef std::vector<std::array<double,2>> Polygon2d;
+
+/** Tells if a polygon is convex and counter-clockwise, with every
+turn far enough from collinear that rounding error cannot change its
+sign.  (Exactly collinear vertices are allowed.) */
+extern bool is_robust_convex(Polygon2d const &P);
+
+/** Computes the overlap of two convex counter-clockwise polygons in
+double precision (Sutherland-Hodgman clipping of P by each edge of Q).
+This is a fast alternative to poly_overlap() for the common case of
+convex grid cells.
+@param ret OUT: The overlap polygon (empty if they do not overlap)
+@return false if a vertex was too close to a clipping edge to tell
+    (within rounding error) which side it lies on; ret is then not
+    usable, and the caller must fall back to the exact poly_overlap(). */
+extern bool convex_overlap(Polygon2d const &P, Polygon2d const &Q, Polygon2d &ret);
+
+}   // namespace icebin
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <vector>
 #include <unordered_map>
 #include <functional>
 #include <ibmisc/hash.hpp>
@@ -38,6 +39,35 @@ public:
     Vertex *add_vertex(Cell &cell, double x, double y);
 };
 
+/** Eliminates duplicate vertices in a structured grid, identifying
+each vertex by its (integer) position (ix,iy) on a lattice of
+(nx+1)*(ny+1) points.  No hashing is done, and vertices are
+deduplicated regardless of floating point rounding.  Vertices are
+added to the Grid in the order they are first seen, as with
+VertexCache. */
+class LatticeVertexCache {
+    long const nx1;    // Number of lattice points in the x direction
+    std::vector<Vertex *> vertex_index;    // [iy*nx1 + ix]
+public:
+    GridMap<Vertex> *vertices;    // Stores the vertices
+    LatticeVertexCache(GridMap<Vertex> *_vertices, long nx, long ny) :
+        nx1(nx+1), vertex_index((nx+1)*(ny+1), nullptr), vertices(_vertices) {}
+
+    Vertex *add_vertex(long ix, long iy, double x, double y)
+    {
+        Vertex *&vertex(vertex_index[iy*nx1 + ix]);
+        if (!vertex) vertex = vertices->add(Vertex(x,y));
+        return vertex;
+    }
+
+    Vertex *add_vertex(Cell &cell, long ix, long iy, double x, double y)
+    {
+        Vertex *v = add_vertex(ix, iy, x, y);    // Add to the Grid
+        cell.add_vertex(v);
+        return v;
+    }
+};
+
 
 
 
@@ -0,0 +1,79 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <icebin/hclookup.hpp>
+
+namespace icebin {
+
+/** Relative tolerance for spacings to count as equal */
+static double const UNIFORM_TOL = 1e-9;
+
+/** Buckets per elevation class, at most */
+static int const MAX_BUCKETS_PER_POINT = 16;
+
+HCLookup::HCLookup(std::vector<double> const &_xpoints) :
+    xpoints(&_xpoints), _method(Method::SEARCH), b0(0), by_bw(0)
+{
+    std::vector<double> const &xp(*xpoints);
+    int const n = xp.size();
+    if (n < 2) {
+        _method = Method::SEGMENTS;
+        if (n == 1) segments.push_back(Segment{xp[0], 1., 0, 1, xp[0]});
+        return;
+    }
+
+    double min_dx = xp[1] - xp[0];
+    for (int i=1; i<n; ++i) {
+        double const dx = xp[i] - xp[i-1];
+        if (!(dx > 0)) return;    // Not increasing: binary search
+        min_dx = std::min(min_dx, dx);
+    }
+
+    // Split into evenly spaced segments
+    for (int i0=0; i0<n; ) {
+        int i1 = i0+1;    // One past the end of this segment
+        double dx = 1.;
+        if (i1 < n) {
+            dx = xp[i1] - xp[i0];
+            while (i1+1 < n && std::abs((xp[i1+1] - xp[i1]) - dx) <= UNIFORM_TOL * dx) ++i1;
+            ++i1;
+        }
+        segments.push_back(Segment{xp[i0], 1./dx, i0, i1-i0, xp[i1-1]});
+        i0 = i1;
+    }
+    if (segments.size() <= (size_t)MAX_SEGMENTS) {
+        _method = Method::SEGMENTS;
+        return;
+    }
+    segments.clear();
+
+    // Buckets no wider than the closest two points, if there are not too many
+    double const range = xp[n-1] - xp[0];
+    long const nb = std::min((long)std::ceil(range / min_dx) + 1,
+        (long)MAX_BUCKETS_PER_POINT * n);
+    b0 = xp[0];
+    by_bw = (nb-1) / range;
+    buckets.resize(nb);
+    for (long b=0; b<nb; ++b) {
+        double const x = b0 + b / by_bw;
+        buckets[b] = std::lower_bound(xp.begin(), xp.end(), x) - xp.begin();
+    }
+    _method = Method::BUCKETS;
+}
+
+}    // namespace icebin
@@ -0,0 +1,110 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICEBIN_HCLOOKUP_HPP
+#define ICEBIN_HCLOOKUP_HPP
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace icebin {
+
+/** Locates elevations among the elevation classes (hcdefs), with the
+same result as std::lower_bound(), but in constant time.  Elevation
+classes are almost always evenly spaced (global_ec --elev-classes
+start,end,skip), or evenly spaced in a few segments (eg the local
+and global ECs of GCMRegridder_ModelE); those are located in closed
+form.  Others are located through a table of evenly spaced buckets.
+Either way, the guess is then corrected against xpoints, so the
+result is exact.  Non-increasing xpoints fall back to binary search.
+Cheap to construct: O(xpoints.size()). */
+class HCLookup {
+public:
+    enum class Method {SEGMENTS, BUCKETS, SEARCH};
+
+    /** Piecewise-uniform segments of xpoints; at most this many */
+    static int const MAX_SEGMENTS = 8;
+
+private:
+    std::vector<double> const *xpoints;
+    Method _method;
+
+    /** xpoints[i0+k] ~= x0 + k/by_dx, for 0 <= k < n */
+    struct Segment {
+        double x0, by_dx;
+        int i0, n;
+        double xlast;    // == xpoints[i0+n-1]
+    };
+    std::vector<Segment> segments;
+
+    /** buckets[b] = lower_bound(b0 + b/by_bw) */
+    double b0, by_bw;
+    std::vector<int> buckets;
+
+    /** Corrects a guess i so that xp[i-1] < xx <= xp[i] */
+    int refine(int i, double xx) const
+    {
+        std::vector<double> const &xp(*xpoints);
+        int const n = xp.size();
+        while (i > 0 && xp[i-1] >= xx) --i;
+        while (i < n && xp[i] < xx) ++i;
+        return i;
+    }
+
+public:
+    /** @param _xpoints Must outlive this HCLookup */
+    explicit HCLookup(std::vector<double> const &_xpoints);
+
+    Method method() const { return _method; }
+
+    /** @return lower_bound(xpoints.begin(), xpoints.end(), xx) - xpoints.begin() */
+    int lower_bound(double xx) const
+    {
+        std::vector<double> const &xp(*xpoints);
+        int const n = xp.size();
+
+        // (Also catches NaN, as std::lower_bound() does)
+        if (n == 0 || !(xx > xp[0])) return 0;
+
+        switch(_method) {
+            case Method::SEGMENTS : {
+                for (Segment const &seg : segments) {
+                    if (xx > seg.xlast) continue;
+                    double const k = std::ceil((xx - seg.x0) * seg.by_dx);
+                    int const ik = std::max(0, std::min(seg.n-1, (int)k));
+                    return refine(seg.i0 + ik, xx);
+                }
+                return n;
+            }
+            case Method::BUCKETS : {
+                // Clamp before the cast: (int) of a double out of range
+                // (eg, xx = 1e300 or inf) is undefined.  b > 0 here.
+                double const b = std::min((xx - b0) * by_bw,
+                    (double)(buckets.size()-1));
+                int const ib = (int)b;
+                return refine(buckets[ib], xx);
+            }
+            default :
+                return std::lower_bound(xp.begin(), xp.end(), xx) - xp.begin();
+        }
+    }
+};
+
+}    // namespace icebin
+#endif    // guard
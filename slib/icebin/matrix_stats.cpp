@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <boost/format.hpp>
+#include <icebin/matrix_stats.hpp>
+
+namespace icebin {
+
+/** Histogram bucket for a row of n elements (see MatrixStats::row_hist) */
+static int row_bucket(long n)
+{
+    int k = 0;
+    for (; n > 0; n >>= 1) ++k;
+    return k;
+}
+
+static std::vector<long> row_histogram(std::vector<long> const &row_nnz)
+{
+    std::vector<long> hist;
+    for (long n : row_nnz) {
+        int const k = row_bucket(n);
+        if (k >= (int)hist.size()) hist.resize(k+1, 0);
+        ++hist[k];
+    }
+    return hist;
+}
+
+void MatrixStats::set_shape(EigenSparseMatrixT const &M)
+{
+    nrow = M.rows();
+    ncol = M.cols();
+    nnz = M.nonZeros();
+    std::vector<long> row_nnz(nrow, 0);
+    for (int k=0; k<M.outerSize(); ++k) {
+        for (EigenSparseMatrixT::InnerIterator ii(M,k); ii; ++ii) ++row_nnz[ii.row()];
+    }
+    row_hist = row_histogram(row_nnz);
+}
+
+void MatrixStats::set_shape(TupleListT<2> const &M)
+{
+    nrow = M.shape()[0];
+    ncol = M.shape()[1];
+    nnz = M.size();
+
+    // Rows are sparse (eg over all of E): count only the ones present
+    std::vector<long> rows;
+    rows.reserve(M.size());
+    for (auto ii=M.begin(); ii != M.end(); ++ii) rows.push_back(ii->index(0));
+    std::sort(rows.begin(), rows.end());
+
+    std::vector<long> row_nnz;
+    for (size_t i=0; i<rows.size(); ) {
+        size_t j = i;
+        for (; j<rows.size() && rows[j] == rows[i]; ++j) ;
+        row_nnz.push_back(j - i);
+        i = j;
+    }
+    row_hist = row_histogram(row_nnz);
+}
+
+std::string MatrixStats::str() const
+{
+    std::string hist;
+    for (size_t k=0; k<row_hist.size(); ++k) {
+        if (k > 0) hist += ' ';
+        hist += std::to_string(row_hist[k]);
+    }
+    return (boost::format("%s: %ldx%ld nnz=%ld bytes=%ld build=%.3fs %s rows[0,1,2,4,..]=[%s]")
+        % name % nrow % ncol % nnz % nbytes % build_s
+        % (cache_hit ? "hit" : "miss") % hist).str();
+}
+
+// ------------------------------------------------------------
+void MatrixStatsLog::add(MatrixStats &&stats)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _stats.push_back(std::move(stats));
+}
+
+void MatrixStatsLog::add(std::string const &name, EigenSparseMatrixT const &M,
+    long nbytes, double build_s, bool cache_hit)
+{
+    MatrixStats stats;
+    stats.name = name;
+    stats.set_shape(M);
+    stats.nbytes = nbytes;
+    stats.build_s = build_s;
+    stats.cache_hit = cache_hit;
+    add(std::move(stats));
+}
+
+std::vector<MatrixStats> MatrixStatsLog::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return _stats;
+}
+
+void MatrixStatsLog::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _stats.clear();
+}
+
+void MatrixStatsLog::print(FILE *fout, std::string const &label) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto const &stats : _stats)
+        fprintf(fout, "%s: %s\n", label.c_str(), stats.str().c_str());
+    fflush(fout);
+}
+
+}    // namespace icebin
@@ -0,0 +1,63 @@
+#ifndef ICEBIN_MATRIX_STATS_HPP
+#define ICEBIN_MATRIX_STATS_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <icebin/eigen_types.hpp>
+
+namespace icebin {
+
+/** Wall time since t0 [s] */
+inline double seconds_since(std::chrono::steady_clock::time_point const &t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/** Size and cost of one matrix built for regridding; for sizing the
+nodes a coupler runs on. */
+struct MatrixStats {
+    std::string name;    // Spec name (eg "IvE"), or what the matrix is (eg "IvE:smoothI")
+    long nrow = 0, ncol = 0;
+    long nnz = 0;
+    long nbytes = 0;     // Storage held by the matrix (see memsize.hpp)
+    /** Row lengths: row_hist[0] = number of empty rows; row_hist[k] =
+    number of rows with 2^(k-1) <= nnz < 2^k */
+    std::vector<long> row_hist;
+    double build_s = 0;        // Wall time to build it (or fetch it from a cache) [s]
+    bool cache_hit = false;    // Fetched from RegridMatrixCache?
+
+    /** Sets nrow, ncol, nnz and row_hist (one pass over M) */
+    void set_shape(EigenSparseMatrixT const &M);
+    void set_shape(TupleListT<2> const &M);
+
+    /** One line, for logs */
+    std::string str() const;
+};
+
+/** Statistics of the matrices built by one or more
+RegridMatrices_Dynamic (see RegridMatrices_Dynamic::stats).
+Thread-safe. */
+class MatrixStatsLog {
+    mutable std::mutex mutex;
+    std::vector<MatrixStats> _stats;
+public:
+    void add(MatrixStats &&stats);
+
+    /** Records a matrix just built */
+    void add(std::string const &name, EigenSparseMatrixT const &M,
+        long nbytes, double build_s, bool cache_hit);
+
+    /** @return A copy of the statistics, in order recorded */
+    std::vector<MatrixStats> stats() const;
+
+    void clear();
+
+    /** Prints one line per matrix, each prefixed by label */
+    void print(FILE *fout, std::string const &label) const;
+};
+
+}    // namespace icebin
+#endif    // guard
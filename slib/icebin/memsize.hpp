@@ -0,0 +1,51 @@
+#ifndef ICEBIN_MEMSIZE_HPP
+#define ICEBIN_MEMSIZE_HPP
+
+#include <ibmisc/linear/eigen.hpp>
+#include <icebin/eigen_types.hpp>
+#include <icebin/multivec.hpp>
+#include <icebin/AbbrGrid.hpp>
+#include <icebin/compact_matrix.hpp>
+
+/** Approximate storage held by the major IceBin structures [bytes],
+for ICEBIN_PROFILE_HELD().  Counts the bulk arrays only, not
+bookkeeping. */
+
+namespace icebin {
+
+template<class T, int RANK>
+inline long nbytes(blitz::Array<T,RANK> const &arr)
+    { return arr.numElements() * sizeof(T); }
+
+inline long nbytes(EigenSparseMatrixT const &M)
+{
+    return M.nonZeros() * (sizeof(val_type) + sizeof(dense_index_type))
+        + (M.outerSize()+1) * sizeof(dense_index_type);
+}
+
+inline long nbytes(ibmisc::linear::Weighted_Eigen const &BvA)
+    { return (BvA.M ? nbytes(*BvA.M) : 0) + nbytes(BvA.wM) + nbytes(BvA.Mw); }
+
+inline long nbytes(CompactWeighted const &BvA)
+    { return BvA.M.nbytes() + nbytes(BvA.wM) + nbytes(BvA.Mw); }
+
+inline long nbytes(VectorMultivec const &vecs)
+{
+    return vecs.index.capacity() * sizeof(long)
+        + (vecs.weights.capacity() + vecs.vals.capacity()) * sizeof(double);
+}
+
+template<class IndexT, class ValT, int RANK>
+inline long nbytes(spsparse::TupleList<IndexT,ValT,RANK> const &tl)
+    { return tl.tuples.capacity() * sizeof(tl.tuples[0]); }
+
+/** Per-cell arrays (if loaded) plus dim, as a hash of sparse indices */
+inline long nbytes(AbbrGrid const &agrid)
+{
+    AbbrGridArrays const &arr(*agrid._arrays);
+    return nbytes(arr.ijk) + nbytes(arr.native_area) + nbytes(arr.centroid_xy)
+        + agrid.dim.dense_extent() * (2*sizeof(long) + sizeof(int) + sizeof(void *));
+}
+
+}    // namespace icebin
+#endif    // guard
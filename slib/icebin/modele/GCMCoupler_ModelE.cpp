@@ -17,6 +17,10 @@
  */
 
 #include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <future>
 #include <mpi.h>        // Intel MPI wants to be first
 #include <ibmisc/netcdf.hpp>
 #include <ibmisc/memory.hpp>
@@ -34,6 +38,9 @@
 #include <icebin/modele/hntr.hpp>
 #include <icebin/modele/topo.hpp>
 #include <icebin/modele/merge_topo.hpp>
+#include <icebin/profile.hpp>
+#include <icebin/memsize.hpp>
+#include <icebin/e1ve0.hpp>
 #include <spsparse/accum.hpp>
 #include <spsparse/eigen.hpp>
 #include <spsparse/SparseSet.hpp>
@@ -247,6 +254,10 @@ void GCMCoupler_ModelE::_ncread(
     // Retrieve name of TOPO file (without Greenland, and on Ocean grid)
     get_or_put_att(config_info, ncio_config.rw, "topo_ocean", topoO_fname);
     get_or_put_att(config_info, ncio_config.rw, "global_ec", global_ecO_fname);  // Must contain EvA at the very least
+    {auto atts(config_info.getAtts());
+    if (atts.find("lagged_coupling") != atts.end())
+        get_or_put_att(config_info, ncio_config.rw, "lagged_coupling", &lagged_coupling, 1);
+    }
 
     /** EOpvAOp matrix for global (base) ice */
     ibmisc::ZArray<int,double,2> EOpvAOp_base;
@@ -303,9 +314,26 @@ printf("BEGIN gcmce_new()\n");
 
     gcm_params.icebin_config_fname = boost::filesystem::absolute("config/icebin.nc").string();
 
+    // Read inputs once and share them through node-local copies,
+    // instead of having every rank open them on the shared filesystem.
+    {char const *stage_dir = getenv("ICEBIN_STAGE_DIR");
+    if (stage_dir && *stage_dir) gcm_params.stager.reset(
+        new FileStager(gcm_params.gcm_comm, gcm_params.gcm_root, stage_dir));
+    }
+
     // Read the coupler, along with ice model proxies
     self->ncread(gcm_params.icebin_config_fname, "m");
 
+    // The lagged coupling step runs in the background, while the GCM
+    // keeps using its communicator: give IceBin (and the ice models)
+    // their own.
+    if (self->lagged_coupling) {
+        MPI_Comm icebin_comm;
+        MPI_Comm_dup(gcm_params.gcm_comm, &icebin_comm);
+        gcm_params.gcm_comm = icebin_comm;
+        gcm_params.world = boost::mpi::communicator(icebin_comm, boost::mpi::comm_take_ownership);
+    }
+
     // Check bounds on the IceSheets, set up any state, etc.
     // This is done AFTER setup of self because self->read_from_netcdf()
     // might change the IceSheet, in certain cases.
@@ -347,8 +375,9 @@ int GCMCoupler_ModelE::_read_nhc_gcm()
     // Get the name of the grid file
     std::string grid_fname;
     std::string global_ec_fname;
+    // (Both files were already staged, if at all, by ncread())
     {
-        NcIO ncio_config(gcm_params.icebin_config_fname, NcFile::read);
+        NcIO ncio_config(stage_input(gcm_params.icebin_config_fname), NcFile::read);
         auto config_info(get_or_add_var(ncio_config, "m.info", "int", {}));
         get_or_put_att(config_info, ncio_config.rw, "grid", grid_fname);
         get_or_put_att(config_info, ncio_config.rw, "global_ec", global_ec_fname);
@@ -358,7 +387,7 @@ int GCMCoupler_ModelE::_read_nhc_gcm()
 
     // EC's for ice to be coupled to the ice sheet
     int nhc_grid;
-    {NcIO ncio(grid_fname, 'r');
+    {NcIO ncio(stage_input(grid_fname), 'r');
         nhc_grid = ncio.nc->getDim("m.nhc").getSize();
     }
 
@@ -552,6 +581,15 @@ void gcmce_io_rsf(GCMCoupler_ModelE *self,
         rw=='w' ? modele_fname
         : remove_extension(read_symlink_or_file(modele_fname + ".nc")));
 
+    // Finishes any coupling step in flight, before saving the state it changes
+    // (one file per MPI rank, since each holds its own share)
+    self->ncio_lagged(strprintf("%s-icebin-lagged-%d.bin",
+        modele_root.c_str(), self->gcm_params.gcm_rank), rw);
+
+    // Logs are complete, as of the restart; and the ice models' own
+    // restart I/O (eg PISM's dumpToFile()) is not under netcdf_mutex
+    if (self->log_writer) self->log_writer->flush();
+
     // Save the state of each ice model.
     for (size_t sheetix=0; sheetix < self->ice_couplers.size(); ++sheetix) {
         auto &ice_coupler(self->ice_couplers[sheetix]);
@@ -562,6 +600,9 @@ void gcmce_io_rsf(GCMCoupler_ModelE *self,
     }
 
     // Read/Write IceBin coupler state
+    if (rw == 'w') self->load_rsf();
+    // Written here, not behind on log_writer: ModelE writes its own
+    // (NetCDF) restart file as soon as this returns
     {NcIO ncio(sheet_rsf(modele_root, "icebin"), rw);
         self->ncio_rsf(ncio);
     }
@@ -602,67 +643,428 @@ void gcmce_model_start(GCMCoupler_ModelE *self, bool cold_start, int yeari, int
 }
 
 
-/** Helper function: splits a single GCMInput struct into per-domain GCMInput structs */
-std::vector<GCMInput> split_by_domain(
+// =======================================================
+// MPI transfer of coupler inputs / outputs.  VectorMultivec and
+// GCMInput are a handful of flat arrays, so they are moved with
+// MPI_Gatherv() / MPI_Scatterv() directly between those arrays
+// (counts first), rather than through Boost.Serialization archives.
+
+/** Displacements for MPI_Gatherv() / MPI_Scatterv()
+@return Sum of counts */
+static long mpi_displs(std::vector<int> const &counts, std::vector<int> &displs)
+{
+    displs.resize(counts.size());
+    long total = 0;
+    for (size_t i=0; i<counts.size(); ++i) {
+        displs[i] = total;
+        total += counts[i];
+    }
+    if (total > std::numeric_limits<int>::max()) (*icebin_error)(-1,
+        "MPI transfer too large for int displacements: %ld", total);
+    return total;
+}
+
+static std::vector<int> scaled_counts(std::vector<int> const &counts, int n)
+{
+    std::vector<int> ret(counts);
+    for (auto &c : ret) c *= n;
+    return ret;
+}
+
+/** A GCMInput split by MPI domain, packed the way MPI_Scatterv()
+sends it: the elements of domain d are at positions
+[displs[d], displs[d]+counts[d]) of each array. */
+struct SplitGCMInput {
+    struct Segment {
+        int nvar = 0;
+        std::vector<int> counts, displs;
+        std::vector<long> index;
+        std::vector<double> weights, vals;    // vals: nvar per element
+    };
+    std::vector<Segment> segments;    // Same as GCMInput::gcm_ivalss_s
+
+    /** A sparse matrix on E (or its factors), split by the domain
+    of one of its indices */
+    struct Matrix {
+        int shape[2] = {-1, -1};
+        std::vector<int> counts, displs;
+        std::vector<int> ixs;          // Two per element
+        std::vector<double> vals;
+    };
+    Matrix E1vE0c;
+    Matrix E1vXc, XvE0c;    // If GCMCoupler::factor_E1vE0c
+};
+
+/** Splits a sparse matrix by the domain of its index idim, which
+must be an E index.  Domains preserve the original order of their
+elements.  (The matrix is not set the first time around; in that
+case, shape = (-1,-1).) */
+static void split_matrix(
+    spsparse::TupleList<int,double,2> const &M,
+    int idim,
+    DomainDecomposer_ModelE const &domainsE,
+    SplitGCMInput::Matrix &split)
+{
+    int const ndomains = domainsE.size();    // Number of MPI domains
+    split.counts.assign(ndomains, 0);
+    if (M.shape()[0] == -1) {
+        split.displs.assign(ndomains, 0);
+        return;
+    }
+
+    auto shape(M.shape());
+    split.shape[0] = shape[0];
+    split.shape[1] = shape[1];
+
+    auto const &tuples(M.tuples);
+    std::vector<int> dest(tuples.size());    // Domain of each element
+    for (size_t i=0; i<tuples.size(); ++i) {
+        dest[i] = domainsE.get_domain(tuples[i].index(idim));
+        ++split.counts[dest[i]];
+    }
+    mpi_displs(split.counts, split.displs);
+
+    split.ixs.resize(tuples.size() * 2);
+    split.vals.resize(tuples.size());
+    std::vector<int> pos(split.displs);
+    for (size_t i=0; i<tuples.size(); ++i) {
+        int const k = pos[dest[i]]++;
+        split.ixs[k*2] = tuples[i].index(0);
+        split.ixs[k*2+1] = tuples[i].index(1);
+        split.vals[k] = tuples[i].value();
+    }
+}
+
+/** Helper function: splits a single GCMInput struct by domain.
+Counting sort: one pass finds each element's domain and the count
+per domain; a second scatters the elements into the packed arrays.
+Domains preserve the original order of their elements. */
+SplitGCMInput split_by_domain(
     GCMInput const &out,
     DomainDecomposer_ModelE const &domainsA,
     DomainDecomposer_ModelE const &domainsE)
 {
-    using namespace spsparse;
+    ICEBIN_PROFILE_SCOPE("split_by_domain");
 
     // Put domain decomposers in a nice array
     std::array<DomainDecomposer_ModelE const *, (int)IndexAE::COUNT> domainsAE
         {&domainsA, &domainsE, &domainsA, &domainsE};
-    int ndomains = domainsA.size();    // Number of MPI domains
+    int const ndomains = domainsA.size();    // Number of MPI domains
 
-    // Construct the output
-    std::vector<int> const &nvar(out.nvar());
-
-    std::vector<GCMInput> outs;
-    outs.reserve(ndomains);
-    for (size_t i=0; i<ndomains; ++i)
-        outs.push_back(GCMInput(nvar));
-
-    size_t strideb = sizeof(GCMInput);
+    SplitGCMInput split;
+    std::vector<int> dest;    // Domain of each element
 
     // Split each element of parallel sparse vectors
+    split.segments.resize(out.gcm_ivalss_s.size());
     for (int iAE=0; iAE != (int)IndexAE::COUNT; ++iAE) {
-        auto &gcm_ivalsX(out.gcm_ivalss_s[iAE]);
+        VectorMultivec const &gcm_ivalsX(out.gcm_ivalss_s[iAE]);
         DomainDecomposer_ModelE const &domainsX(*domainsAE[iAE]);
+        SplitGCMInput::Segment &seg(split.segments[iAE]);
+        size_t const n = gcm_ivalsX.size();
+        int const nvar = gcm_ivalsX.nvar;
+        seg.nvar = nvar;
+
+        seg.counts.assign(ndomains, 0);
+        dest.resize(n);
+        for (size_t i=0; i<n; ++i) {
+            dest[i] = domainsX.get_domain(gcm_ivalsX.index[i]);
+            ++seg.counts[dest[i]];
+        }
+        mpi_displs(seg.counts, seg.displs);
+
+        seg.index.resize(n);
+        seg.weights.resize(n);
+        seg.vals.resize(n * nvar);
+        std::vector<int> pos(seg.displs);
+        for (size_t i=0; i<n; ++i) {
+            int const k = pos[dest[i]]++;
+            seg.index[k] = gcm_ivalsX.index[i];
+            seg.weights[k] = gcm_ivalsX.weights[i];
+            std::copy(gcm_ivalsX.vals.data() + i*nvar,
+                gcm_ivalsX.vals.data() + (i+1)*nvar,
+                seg.vals.data() + k*nvar);
+        }
+    }
+
+    // Split E1vE0c by row (or its factors, by the E index of each)
+    // Each row of E1vXc/column of XvE0c lies in one GCM grid cell.
+    split_matrix(out.E1vE0c, 0, domainsE, split.E1vE0c);
+    split_matrix(out.E1vXc, 0, domainsE, split.E1vXc);
+    split_matrix(out.XvE0c, 1, domainsE, split.XvE0c);
+
+    // Packed copy, held alongside the original until scattered
+    long nb = 0;
+    for (auto const *mat : {&split.E1vE0c, &split.E1vXc, &split.XvE0c}) nb +=
+        mat->ixs.capacity() * sizeof(int)
+        + mat->vals.capacity() * sizeof(double);
+    for (auto const &seg : split.segments) nb +=
+        seg.index.capacity() * sizeof(long)
+        + (seg.weights.capacity() + seg.vals.capacity()) * sizeof(double);
+    ICEBIN_PROFILE_HELD("SplitGCMInput", nb);
+    return split;
+}
+
+/** Gathers each rank's VectorMultivec onto root, concatenated in
+rank order.  Same result as boost::mpi::gather() followed by
+concatenate().
+@return The concatenated vector on root; empty elsewhere. */
+static VectorMultivec gather_multivec(
+    MPI_Comm comm, int root, VectorMultivec const &local)
+{
+    int rank, nrank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nrank);
+    int const nvar = local.nvar;
+    int n = local.size();
+
+    std::vector<int> counts(rank == root ? nrank : 0);
+    MPI_Gather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, root, comm);
+
+    VectorMultivec ret(nvar);
+    std::vector<int> displs, vcounts, vdispls;
+    if (rank == root) {
+        long const total = mpi_displs(counts, displs);
+        vcounts = scaled_counts(counts, nvar);
+        mpi_displs(vcounts, vdispls);
+        ret.index.resize(total);
+        ret.weights.resize(total);
+        ret.vals.resize(total * nvar);
+    }
 
-        for (size_t i=0; i<out.gcm_ivalss_s[iAE].index.size(); ++i) {
-            // Convert from index to tuple
-            long const iA(gcm_ivalsX.index[i]);
+    MPI_Gatherv(const_cast<long *>(local.index.data()), n, MPI_LONG,
+        ret.index.data(), counts.data(), displs.data(), MPI_LONG, root, comm);
+    MPI_Gatherv(const_cast<double *>(local.weights.data()), n, MPI_DOUBLE,
+        ret.weights.data(), counts.data(), displs.data(), MPI_DOUBLE, root, comm);
+    MPI_Gatherv(const_cast<double *>(local.vals.data()), n*nvar, MPI_DOUBLE,
+        ret.vals.data(), vcounts.data(), vdispls.data(), MPI_DOUBLE, root, comm);
 
-            // Figure out MPI domain of the resulting tuple
-            int idomain = domainsX.get_domain(iA);
+    return ret;
+}
+
+/** Scatters one matrix split by split_matrix() from root: shape
+(the same for all ranks), then elements.
+@param split Used on root only.
+@param out Receives this rank's elements. */
+static void scatter_matrix(
+    MPI_Comm comm, int root,
+    SplitGCMInput::Matrix const &split,
+    spsparse::TupleList<int,double,2> &out)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
 
-            // Add our values to the appropriate MPI domain
-            outs[idomain].gcm_ivalss_s[iAE].add(
-                iA, &gcm_ivalsX.vals[i*nvar[iAE]], gcm_ivalsX.weights[i]);
+    int shape[2] = {split.shape[0], split.shape[1]};
+    MPI_Bcast(shape, 2, MPI_INT, root, comm);
+
+    out = spsparse::TupleList<int,double,2>();
+    if (shape[0] == -1) return;    // Nothing on any rank
+    out.set_shape({shape[0], shape[1]});
+
+    std::vector<int> icounts, idispls;
+    if (rank == root) {
+        icounts = scaled_counts(split.counts, 2);
+        mpi_displs(icounts, idispls);
+    }
+
+    int n;
+    MPI_Scatter(const_cast<int *>(split.counts.data()), 1, MPI_INT,
+        &n, 1, MPI_INT, root, comm);
+    std::vector<int> my_ixs(n*2);
+    std::vector<double> my_vals(n);
+    MPI_Scatterv(const_cast<int *>(split.ixs.data()),
+        icounts.data(), idispls.data(), MPI_INT,
+        my_ixs.data(), n*2, MPI_INT, root, comm);
+    MPI_Scatterv(const_cast<double *>(split.vals.data()),
+        const_cast<int *>(split.counts.data()), const_cast<int *>(split.displs.data()), MPI_DOUBLE,
+        my_vals.data(), n, MPI_DOUBLE, root, comm);
+
+    for (int i=0; i<n; ++i)
+        out.add({my_ixs[i*2], my_ixs[i*2+1]}, my_vals[i]);
+}
+
+/** Scatters the output of split_by_domain() from root: domain
+irank goes to rank irank.
+@param split Used on root only.
+@param out Receives this rank's output; constructed with the correct nvar. */
+static void scatter_gcminput(
+    MPI_Comm comm, int root,
+    SplitGCMInput const &split,
+    GCMInput &out)
+{
+    int rank, nrank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nrank);
+    if (rank == root && split.E1vE0c.counts.size() != nrank) (*icebin_error)(-1,
+        "split has %ld domains, should have one per MPI rank (%d)",
+        (long)split.E1vE0c.counts.size(), nrank);
+
+    // ----------- Sparse vectors, one segment at a time
+    for (size_t iAE=0; iAE < out.gcm_ivalss_s.size(); ++iAE) {
+        VectorMultivec &vv(out.gcm_ivalss_s[iAE]);
+        int const nvar = vv.nvar;
+
+        SplitGCMInput::Segment const empty;
+        SplitGCMInput::Segment const &seg(rank == root ? split.segments[iAE] : empty);
+        std::vector<int> vcounts, vdispls;
+        if (rank == root) {
+            vcounts = scaled_counts(seg.counts, nvar);
+            mpi_displs(vcounts, vdispls);
         }
+
+        int n;
+        MPI_Scatter(const_cast<int *>(seg.counts.data()), 1, MPI_INT,
+            &n, 1, MPI_INT, root, comm);
+
+        vv.index.resize(n);
+        vv.weights.resize(n);
+        vv.vals.resize(n * nvar);
+        MPI_Scatterv(const_cast<long *>(seg.index.data()),
+            const_cast<int *>(seg.counts.data()), const_cast<int *>(seg.displs.data()), MPI_LONG,
+            vv.index.data(), n, MPI_LONG, root, comm);
+        MPI_Scatterv(const_cast<double *>(seg.weights.data()),
+            const_cast<int *>(seg.counts.data()), const_cast<int *>(seg.displs.data()), MPI_DOUBLE,
+            vv.weights.data(), n, MPI_DOUBLE, root, comm);
+        MPI_Scatterv(const_cast<double *>(seg.vals.data()),
+            vcounts.data(), vdispls.data(), MPI_DOUBLE,
+            vv.vals.data(), n*nvar, MPI_DOUBLE, root, comm);
     }
 
-    // Split E1vE0
-    // (E1vE0 is not set the first time around; in that case, shape = (-1,-1)
-    if (out.E1vE0c.shape()[0] != -1) {
-        auto shape(out.E1vE0c.shape());
+    // ----------- E1vE0c (or its factors)
+    scatter_matrix(comm, root, split.E1vE0c, out.E1vE0c);
+    scatter_matrix(comm, root, split.E1vXc, out.E1vXc);
+    scatter_matrix(comm, root, split.XvE0c, out.XvE0c);
+}
 
-        // Initialize output matrices
-        for (size_t i=0; i<outs.size(); ++i) outs[i].E1vE0c.set_shape(shape);
 
-        // Copy the main matrix
-        // Works for matrix in A or E
-        for (auto &tp : out.E1vE0c.tuples) {
-            int const domain = domainsE.get_domain(tp.index(0));
-            outs[domain].E1vE0c.add(tp.index(), tp.value());
+// =======================================================
+/** Gathers the GCM outputs to root, couples there, and returns each
+rank its share of the GCM inputs.  Run from all MPI ranks. */
+static GCMInput couple_exchange(GCMCoupler_ModelE *self,
+    double time_s,
+    VectorMultivec const &gcm_ovalsE_s,
+    bool run_ice)
+{
+    // Gather it to root
+    // boost::mpi::communicator &gcm_world(world);
+    // Init our output struct based on number of A and E variables.
+    std::vector<int> sizes;
+    for (VarSet const &vs : self->gcm_inputs) sizes.push_back(vs.size());
+    GCMInput out(sizes);
+
+    if (self->am_i_root()) {
+        // =================== MPI ROOT =============================
+        // Gathered straight into the concatenated coupler inputs
+        VectorMultivec every_gcm_ovalsE_s(gather_multivec(
+            self->gcm_params.gcm_comm, self->gcm_params.gcm_root, gcm_ovalsE_s));
+
+        // Couple on root!
+        // out contains GLOBAL output for all MPI ranks
+        out = self->couple(time_s, every_gcm_ovalsE_s, run_ice);  // move semantics
+
+        // Split up the output, packed for MPI_Scatterv()
+        SplitGCMInput split(
+            split_by_domain(out, *self->domains, *self->domains));
+
+        // Scatter!
+        scatter_gcminput(self->gcm_params.gcm_comm, self->gcm_params.gcm_root,
+            split, out);
+
+
+    } else {
+        // =================== NOT MPI ROOT =============================
+        // Send our input to root
+        gather_multivec(self->gcm_params.gcm_comm, self->gcm_params.gcm_root, gcm_ovalsE_s);
+
+        // Let root do the work...
+        // update_topo() is built into this
+        // (local is empty, except with distributed_regrid)
+        GCMInput local(self->couple(time_s, gcm_ovalsE_s, run_ice));
+
+        // Receive our output back from root
+        scatter_gcminput(self->gcm_params.gcm_comm, self->gcm_params.gcm_root,
+            SplitGCMInput(), out);
+
+        // Add the A,E rows this rank computed itself
+        for (size_t iAE=0; iAE < local.gcm_ivalss_s.size(); ++iAE) {
+            VectorMultivec const &vv(local.gcm_ivalss_s[iAE]);
+            for (size_t i=0; i<vv.size(); ++i)
+                out.gcm_ivalss_s[iAE].add(vv.index[i], &vv.vals[i*vv.nvar], vv.weights[i]);
         }
     }
-    return outs;
+
+    // factor_E1vE0c: each rank multiplies out its own part of E1vE0c
+    if (out.E1vXc.shape()[0] != -1) {
+        out.E1vE0c = e1ve0::multiply_E1vE0c(out.E1vXc, out.XvE0c);
+        out.E1vXc.clear();
+        out.XvE0c.clear();
+    }
+    return out;
 }
 
+GCMInput GCMCoupler_ModelE::couple_lagged(
+    double time_s,
+    VectorMultivec &&gcm_ovalsE_s)
+{
+    // What the GCM gets now: the step in flight, or (first step) the
+    // initial conditions.
+    GCMInput out(finish_lagged());
+
+    // Start this step; gcm_ovalsE_s is moved into the task
+    int provided;
+    MPI_Query_thread(&provided);
+    pending_out = std::async(
+        provided == MPI_THREAD_MULTIPLE ? std::launch::async : std::launch::deferred,
+        std::bind(&couple_exchange, this, time_s, std::move(gcm_ovalsE_s), true));
+
+    return out;
+}
+
+GCMInput GCMCoupler_ModelE::finish_lagged()
+{
+    if (pending_out.valid()) lagged_out.reset(new GCMInput(pending_out.get()));
+    if (!lagged_out) (*icebin_error)(-1,
+        "lagged_coupling: no GCMInput from a previous step");
+    return *lagged_out;
+}
+
+void GCMCoupler_ModelE::ncio_lagged(std::string const &fname, char rw)
+{
+    if (rw == 'w') {
+        if (!lagged_coupling) return;
+        finish_lagged();    // Nothing may be in flight while writing
+        std::ofstream fout(fname, std::ios::binary);
+        boost::archive::binary_oarchive ar(fout);
+        ar << *lagged_out;
+    } else {
+        std::ifstream fin(fname, std::ios::binary);
+        if (!fin) return;    // Not written by a lagged run
+        lagged_out.reset(new GCMInput(std::vector<int>()));
+        boost::archive::binary_iarchive ar(fin);
+        ar >> *lagged_out;
+    }
+}
 
 // =======================================================
+/** Assigns each of vars a layout (one per distinct set of strides),
+and returns the strides of each layout.
+@param layout [vars.size()] (OUT) */
+template<int RANK>
+static std::vector<std::array<long,RANK>> plan_layouts(
+    std::vector<int> &layout,
+    std::vector<std::unique_ptr<blitz::Array<double,RANK>>> const &vars)
+{
+    std::vector<std::array<long,RANK>> strides;
+    layout.clear();
+    for (auto const &var : vars) {
+        std::array<long,RANK> st;
+        for (int d=0; d<RANK; ++d) st[d] = var->stride(d);
+        auto ii(std::find(strides.begin(), strides.end(), st));
+        layout.push_back(ii - strides.begin());
+        if (ii == strides.end()) strides.push_back(st);
+    }
+    return strides;
+}
+
 // Called from LISheetIceBin::couple()
 /**
 This will:
@@ -704,98 +1106,75 @@ int *E1vE0c_nele)
 {
     double time_s = itime * self->dtsrc;
 
-    // Fill it in...
-    VectorMultivec gcm_ovalsE_s(self->gcm_outputsE.size());
-    std::vector<double> val(self->gcm_outputsE.size());    // Temporary
-
-    auto const &indexingA(self->gcm_regridder->agridA->indexing);
-    auto const &indexingE(self->gcm_regridder->indexingE);
+    FastIndexing<2> const indexingA(self->gcm_regridder->agridA->indexing);
+    auto const &indexingE(self->gcm_regridder->fast_indexingE);
 
     // domain uses alphabetical order, 0-based indexing...
     const auto base_hc(self->gcm_params.icebin_base_hc);
     const auto nhc_ice(self->gcm_regridder->nhc());
 
-    // Lookup underice (C-style order and indexing base)
-    int const i_underice = self->gcm_inputs[(int)IndexAE::ETOPO].index.at("underice_d");
-    blitz::Array<double,3> &underice(*self->gcm_ivalssE[(int)IndexAE::ETOPO][i_underice]);
-    
+    // Points to send to IceBin; found again only if underice changed
+    GCMCoupler_ModelE::ActiveCells &active(self->active_cells);
+    if (!active.valid) {
+        // Lookup underice (C-style order and indexing base)
+        int const i_underice = self->gcm_inputs[(int)IndexAE::ETOPO].index.at("underice_d");
+        blitz::Array<double,3> &underice(*self->gcm_ivalssE[(int)IndexAE::ETOPO][i_underice]);
 
-    // Get values to send to IceBin
-    auto &domainA(self->domainA);
-printf("domainA size=%ld base_hc=%d  nhc_ice=%d\n", domainA.data.size(), base_hc, nhc_ice);
+        auto const strides(plan_layouts(active.layout, self->gcm_ovalsE));
+        active.iE_s.clear();
+        active.offsets.assign(strides.size(), std::vector<long>());
 
-    for (int ihc=base_hc; ihc < base_hc + nhc_ice; ++ihc) {
-        const int ihc_ice = ihc - base_hc;   // Use only IceBin HC's, zero-based indexing
-        if (ihc_ice < 0) (*icebin_error)(-1,
-            "ihc_ice cannot be <0: %d = %d - %d - 1\n", ihc_ice, ihc, base_hc);
+        auto &domainA(self->domainA);
+printf("domainA size=%ld base_hc=%d  nhc_ice=%d\n", domainA.data.size(), base_hc, nhc_ice);
 
-        // Iterate over just this MPI rank's chunk
-        for (int j=domainA[1].begin; j < domainA[1].end; ++j) {
-        for (int i=domainA[0].begin; i < domainA[0].end; ++i) {
-            // i,j are 0-based indexes.
-            if (underice(ihc,j,i) == UI_LOCALICE || underice(ihc,j,i) == UI_GLOBALICE) {
+        for (int ihc=base_hc; ihc < base_hc + nhc_ice; ++ihc) {
+            const int ihc_ice = ihc - base_hc;   // Use only IceBin HC's, zero-based indexing
+            if (ihc_ice < 0) (*icebin_error)(-1,
+                "ihc_ice cannot be <0: %d = %d - %d - 1\n", ihc_ice, ihc, base_hc);
 
-                long iE_s = indexingE.tuple_to_index(
-                    make_array(i, j, ihc_ice));
+            // Iterate over just this MPI rank's chunk
+            for (int j=domainA[1].begin; j < domainA[1].end; ++j) {
+            for (int i=domainA[0].begin; i < domainA[0].end; ++i) {
+                // i,j are 0-based indexes.
+                if (underice(ihc,j,i) == UI_LOCALICE || underice(ihc,j,i) == UI_GLOBALICE) {
 
-                if (iE_s < 0) (*ibmisc_error)(-1,
-                    "iE_s=%ld (from %d %d %d), it should not be negative\n", iE_s, i, j, ihc_ice);
+                    long iE_s = indexingE.tuple_to_index({i, j, ihc_ice});
 
-                for (unsigned int ivar=0; ivar<self->gcm_outputsE.size(); ++ivar) {
-                    val[ivar] = (*self->gcm_ovalsE[ivar])(ihc,j,i);
-                }
+                    if (iE_s < 0) (*ibmisc_error)(-1,
+                        "iE_s=%ld (from %d %d %d), it should not be negative\n", iE_s, i, j, ihc_ice);
 
-                gcm_ovalsE_s.add({iE_s}, &val[0], 1.0);
-            }    // if UI_LOCALICE or UI_GLOBALICE
-        }}
+                    active.iE_s.push_back(iE_s);
+                    for (size_t il=0; il<strides.size(); ++il) active.offsets[il].push_back(
+                        ihc*strides[il][0] + j*strides[il][1] + i*strides[il][2]);
+                }    // if UI_LOCALICE or UI_GLOBALICE
+            }}
+        }
+        active.weights.assign(active.iE_s.size(), 1.0);
+        active.valid = true;
     }
 
+    // Get values to send to IceBin
+    int const nvar = self->gcm_outputsE.size();
+    size_t const n = active.iE_s.size();
+    VectorMultivec gcm_ovalsE_s(nvar);
+    double *dest = gcm_ovalsE_s.append_zero(n, active.iE_s.data(), active.weights.data());
+    for (int ivar=0; ivar<nvar; ++ivar) {
+        double const *src = self->gcm_ovalsE[ivar]->dataZero();
+        long const *offsets = active.offsets[active.layout[ivar]].data();
+        for (size_t ix=0; ix<n; ++ix) dest[ix*nvar + ivar] = src[offsets[ix]];
+    }
 
-    // Gather it to root
-    // boost::mpi::communicator &gcm_world(world);
-    // Init our output struct based on number of A and E variables.
-    std::vector<int> sizes;
-    for (VarSet const &vs : self->gcm_inputs) sizes.push_back(vs.size());
-    GCMInput out(sizes);
-
-    if (self->am_i_root()) {
-        // =================== MPI ROOT =============================
-        std::vector<VectorMultivec> every_gcm_ovalsE_s;
-        boost::mpi::gather(self->gcm_params.world, gcm_ovalsE_s,
-            every_gcm_ovalsE_s, self->gcm_params.gcm_root);
-
-        // Concatenate coupler inputs
-        VectorMultivec gcm_ovalsE_s(concatenate(every_gcm_ovalsE_s));
-
-        // Couple on root!
-        // out contains GLOBAL output for all MPI ranks
-        out = self->couple(time_s, gcm_ovalsE_s, run_ice);  // move semantics
-
-        // Split up the output (and 
-        std::vector<GCMInput> every_outs(
-            split_by_domain(out, *self->domains, *self->domains));
-
-        // Scatter!
-        boost::mpi::scatter(self->gcm_params.world, every_outs, out, self->gcm_params.gcm_root);
-
-
-    } else {
-        // =================== NOT MPI ROOT =============================
-        // Send our input to root
-        boost::mpi::gather(self->gcm_params.world, gcm_ovalsE_s, self->gcm_params.gcm_root);
 
-        // Let root do the work...
-        // update_topo() is built into this
-        self->couple(time_s, gcm_ovalsE_s, run_ice);
-
-        // Receive our output back from root
-        boost::mpi::scatter(self->gcm_params.world, out, self->gcm_params.gcm_root);
-    }
+    GCMInput out(self->lagged_coupling && run_ice ?
+        self->couple_lagged(time_s, std::move(gcm_ovalsE_s)) :
+        couple_exchange(self, time_s, gcm_ovalsE_s, run_ice));
+    if (self->lagged_coupling && !run_ice)
+        self->lagged_out.reset(new GCMInput(out));    // Handed back at the first real step
 
     // 1. Copies values back into modele.gcm_ivals from scatterd MPI stuff
     self->apply_gcm_ivals(out);
 
-    auto const &indexingHC(self->gcm_regridder->indexingHC);
+    auto const &indexingHC(self->gcm_regridder->fast_indexingHC);
     // Copy E1vE0 matrix back to Fortran
     self->E1vE0c.clear();
     if (run_ice) {
@@ -803,12 +1182,12 @@ printf("domainA size=%ld base_hc=%d  nhc_ice=%d\n", domainA.data.size(), base_hc
             long const iE1(ii->index(0));
             long const iE0(ii->index(1));
             
-            auto ijk0(indexingHC.index_to_tuple<int,2>(iE0));
-            auto ijk1(indexingHC.index_to_tuple<int,2>(iE1));
+            auto ijk0(indexingHC.index_to_tuple<int>(iE0));
+            auto ijk1(indexingHC.index_to_tuple<int>(iE1));
             if (ijk0[0] != ijk1[0]) (*icebin_error)(-1,
                 "ijk0 (%d) and ijk1 (%d) must match (%g)",
                 ijk0[0], ijk1[0], ii->value());
-            auto ij(indexingA.index_to_tuple<int,2>(ijk0[0]));
+            auto ij(indexingA.index_to_tuple<int>(ijk0[0]));
 
             int const ihc0 = ijk0[1];
             int const ihc1 = ijk1[1];
@@ -833,6 +1212,42 @@ printf("domainA size=%ld base_hc=%d  nhc_ice=%d\n", domainA.data.size(), base_hc
 }
 // =======================================================
 
+/** Sets plan.index and plan.slot from the indices of vv */
+static void plan_slots(GCMCoupler_ModelE::ScatterPlan &plan, VectorMultivec const &vv)
+{
+    plan.index = vv.index;
+    plan.slot.resize(vv.index.size());
+    std::unordered_map<long,int> slots;
+    for (size_t ix=0; ix<vv.index.size(); ++ix) {
+        auto ii(slots.insert(std::make_pair(vv.index[ix], (int)slots.size())));
+        plan.slot[ix] = ii.first->second;
+    }
+    plan.nslot = slots.size();
+}
+
+/** Adds the elements of vv into the destination variables, using
+plan.  Each element is divided by the sum of weights of all elements
+with its index (see VectorMultivec::to_dense_scale()). */
+static void scatter_ivals(GCMCoupler_ModelE::ScatterPlan const &plan,
+    VectorMultivec const &vv, std::vector<double *> const &dataZero)
+{
+    std::vector<double> scale(plan.nslot, 0.);
+    for (size_t ix=0; ix<vv.size(); ++ix) scale[plan.slot[ix]] += vv.weights[ix];
+    for (auto &s : scale) s = 1. / s;
+
+    int const nvar = dataZero.size();
+    std::vector<long const *> offsets(nvar);
+    for (int ivar=0; ivar<nvar; ++ivar)
+        offsets[ivar] = plan.offsets[plan.layout[ivar]].data();
+
+    double const *vals = vv.vals.data();
+    for (size_t ix=0; ix<vv.size(); ++ix) {
+        double const sc = scale[plan.slot[ix]];
+        for (int ivar=0; ivar<nvar; ++ivar)
+            dataZero[ivar][offsets[ivar][ix]] += vals[ix*nvar + ivar] * sc;
+    }
+}
+
 /** Called from MPI rank.  Copies output of coupling back into
 appropriate dense-indexing ModelE variables. */
 void GCMCoupler_ModelE::apply_gcm_ivals(GCMInput const &out)
@@ -840,6 +1255,8 @@ void GCMCoupler_ModelE::apply_gcm_ivals(GCMInput const &out)
     printf("BEGIN GCMCoupler_ModelE::apply_gcm_ivals\n");
     auto nvar(out.nvar());    // A and E
     const auto nhc_ice(this->gcm_regridder->nhc());
+    FastIndexing<2> const indexingA(gcm_regridder->indexing(GridAE::A));
+    auto const &indexingE(gcm_regridder->fast_indexingE);
 
     // Write to here...
     for (int iAE=0; iAE<GridAE::count; ++iAE) {
@@ -847,7 +1264,9 @@ void GCMCoupler_ModelE::apply_gcm_ivals(GCMInput const &out)
             "nvar[%d]=%d < 0, it should not be\n", iAE, nvar[iAE]);
     }
 
+    scatter_plans.resize(gcm_inputs.size());
     for (size_t index_ae=0; index_ae < gcm_inputs.size(); ++index_ae) {
+    ScatterPlan &plan(scatter_plans[index_ae]);
     switch(gcm_inputs_grid[index_ae]) {
         case 'A' : {
             VectorMultivec const &gcm_ivalsA_s(out.gcm_ivalss_s[index_ae]);    // src
@@ -860,36 +1279,35 @@ void GCMCoupler_ModelE::apply_gcm_ivals(GCMInput const &out)
             // Read from here...
             if (gcm_ivalsA.size() != gcm_inputs[index_ae].size()) (*icebin_error)(-1,
                 "gcm_ivalsA is wrong size: %ld vs. %ld", gcm_ivalsA.size(), gcm_inputs[index_ae].size());
-
-            // Clear output; but only for gridcells we want to touch
             int const nvar = gcm_inputs[index_ae].size();
-            for (size_t ix=0; ix<gcm_ivalsA_s.size(); ++ix) {    // Iterate through elements of parallel arrays
-                long const iA = gcm_ivalsA_s.index[ix];
-                auto ij(gcm_regridder->indexing(GridAE::A).index_to_tuple<int,2>(iA));    // zero-based, alphabetical order
-                int const i = ij[0];
-                int const j = ij[1];
-                for (int ivar=0; ivar<nvar; ++ivar) {
-                    (*gcm_ivalsA[ivar])(j,i) = 0;
-                }
-            }
 
-            // Create (inverse of) summed weights
-            blitz::Array<double,1> sA_s(gcm_regridder->nA());
-            gcm_ivalsA_s.to_dense_scale(sA_s);
-
-            // Copy sparse arrays to output
-            for (size_t ix=0; ix<gcm_ivalsA_s.size(); ++ix) {    // Iterate through elements of parallel arrays
-                long const iA = gcm_ivalsA_s.index[ix];
-                auto ij(gcm_regridder->indexing(GridAE::A).index_to_tuple<int,2>(iA));    // zero-based, alphabetical order
-                int const i = ij[0];
-                int const j = ij[1];
-                for (int ivar=0; ivar<nvar; ++ivar) {
+            // Decompose the indices only when they change
+            if (plan.index != gcm_ivalsA_s.index || (int)plan.layout.size() != nvar) {
+                auto const strides(plan_layouts(plan.layout, gcm_ivalsA));
+                plan_slots(plan, gcm_ivalsA_s);
+                plan.offsets.assign(strides.size(), std::vector<long>(gcm_ivalsA_s.size()));
+                for (size_t ix=0; ix<gcm_ivalsA_s.size(); ++ix) {
+                    auto ij(indexingA.index_to_tuple<int>(gcm_ivalsA_s.index[ix]));    // zero-based, alphabetical order
+                    int const i = ij[0];
+                    int const j = ij[1];
                     // Original Fortran (partial) arrays have been converted to
                     // C++ order and 0-based indexing; see gcmce_add_gcm_inputa()
-                    (*gcm_ivalsA[ivar])(j,i) +=
-                        gcm_ivalsA_s.vals[ix*nvar + ivar] * sA_s(iA);
+                    for (size_t il=0; il<strides.size(); ++il)
+                        plan.offsets[il][ix] = j*strides[il][0] + i*strides[il][1];
                 }
+                plan.clear = plan.offsets;
             }
+
+            // Clear output; but only for gridcells we want to touch
+            std::vector<double *> dataZero;
+            for (int ivar=0; ivar<nvar; ++ivar) {
+                double *z = gcm_ivalsA[ivar]->dataZero();
+                for (long off : plan.clear[plan.layout[ivar]]) z[off] = 0;
+                dataZero.push_back(z);
+            }
+
+            // Copy sparse arrays to output
+            scatter_ivals(plan, gcm_ivalsA_s, dataZero);
         } break;
         case 'E' : {
             // ================================= E
@@ -901,43 +1319,73 @@ void GCMCoupler_ModelE::apply_gcm_ivals(GCMInput const &out)
             // Read from here...
             if (gcm_ivalsE.size() != gcm_inputs[index_ae].size()) (*icebin_error)(-1,
                 "gcm_ivalsE is wrong size: %ld vs. %ld (index_ae = %d)", gcm_ivalsE.size(), gcm_inputs[index_ae].size(), index_ae);
-
-            // Clear output: because non-present elements in sparse gcm_ivalsA are 0
             int const nvar = gcm_inputs[index_ae].size();
-            for (size_t ix=0; ix<gcm_ivalsE_s.size(); ++ix) {
-                long const iE = gcm_ivalsE_s.index[ix];
-                auto ijk(gcm_regridder->indexing(GridAE::E).index_to_tuple<int,3>(iE));
-                int const i = ijk[0];
-                int const j = ijk[1];
-                int const ihc_ice = ijk[2];    // zero-based, just EC's known by ice model
-                int const ihc_gcm = ihc_ice;
-
-                for (int ivar=0; ivar<nvar; ++ivar) {
+
+            // Decompose the indices only when they change
+            if (plan.index != gcm_ivalsE_s.index || (int)plan.layout.size() != nvar) {
+                auto const strides(plan_layouts(plan.layout, gcm_ivalsE));
+                plan_slots(plan, gcm_ivalsE_s);
+                plan.offsets.assign(strides.size(), std::vector<long>(gcm_ivalsE_s.size()));
+                plan.clear.assign(strides.size(), std::vector<long>());
+                plan.hc_stride.clear();
+                for (auto const &st : strides) plan.hc_stride.push_back(st[0]);
+
+                for (size_t ix=0; ix<gcm_ivalsE_s.size(); ++ix) {
+                    auto ijk(indexingE.index_to_tuple<int>(gcm_ivalsE_s.index[ix]));
+                    int const i = ijk[0];
+                    int const j = ijk[1];
+                    int const ihc_ice = ijk[2];    // zero-based, just EC's known by ice model
+                    int const ihc_gcm = ihc_ice;
                     // Original Fortran (partial) arrays have been converted to
                     // C++ order and 0-based indexing; see gcmce_add_gcm_inputa()
-                    (*gcm_ivalsE[ivar])(blitz::Range(0,nhc_ice-1),j,i) = 0;
+                    for (size_t il=0; il<strides.size(); ++il) {
+                        long const column = j*strides[il][1] + i*strides[il][2];
+                        plan.offsets[il][ix] = ihc_gcm*strides[il][0] + column;
+                        plan.clear[il].push_back(column);
+                    }
+                }
+
+                // Non-present elements in sparse gcm_ivalsE are 0: clear
+                // every elevation class of each column touched, once
+                for (auto &clear : plan.clear) {
+                    std::sort(clear.begin(), clear.end());
+                    clear.erase(std::unique(clear.begin(), clear.end()), clear.end());
                 }
             }
 
-            // Create (inverse of) summed weights
-            blitz::Array<double,1> sE_s(gcm_regridder->nE());
-            gcm_ivalsE_s.to_dense_scale(sE_s);
+            // gcmce_couple_native() gathers where underice_d shows ice
+            auto const &index(gcm_inputs[index_ae].index);
+            int const i_underice = (index_ae == (size_t)IndexAE::ETOPO && index.count("underice_d")) ?
+                index.at("underice_d") : -1;
+            std::vector<double> underice0;
+            if (i_underice >= 0 && active_cells.valid) {
+                int const il = plan.layout[i_underice];
+                double const *z = gcm_ivalsE[i_underice]->dataZero();
+                for (long off : plan.clear[il])
+                    for (int ihc=0; ihc<nhc_ice; ++ihc) underice0.push_back(z[off + ihc*plan.hc_stride[il]]);
+            }
+
+            // Clear output
+            std::vector<double *> dataZero;
+            for (int ivar=0; ivar<nvar; ++ivar) {
+                int const il = plan.layout[ivar];
+                double *z = gcm_ivalsE[ivar]->dataZero();
+                long const hc_stride = plan.hc_stride[il];
+                for (long off : plan.clear[il])
+                    for (int ihc=0; ihc<nhc_ice; ++ihc) z[off + ihc*hc_stride] = 0;
+                dataZero.push_back(z);
+            }
 
             // Copy sparse arrays to output
-            for (size_t ix=0; ix<gcm_ivalsE_s.size(); ++ix) {
-                long const iE = gcm_ivalsE_s.index[ix];
-                auto ijk(gcm_regridder->indexing(GridAE::E).index_to_tuple<int,3>(iE));
-                int const i = ijk[0];
-                int const j = ijk[1];
-                int const ihc_ice = ijk[2];    // zero-based, just EC's known by ice model
-                int const ihc_gcm = ihc_ice;
-
-                for (int ivar=0; ivar<nvar; ++ivar) {
-                    // Original Fortran (partial) arrays have been converted to
-                    // C++ order and 0-based indexing; see gcmce_add_gcm_inputa()
-                    (*gcm_ivalsE[ivar])(ihc_gcm,j,i) +=
-                        gcm_ivalsE_s.vals[ix*gcm_inputs[index_ae].size() + ivar] * sE_s(iE);
-                }
+            scatter_ivals(plan, gcm_ivalsE_s, dataZero);
+
+            if (underice0.size() > 0) {
+                int const il = plan.layout[i_underice];
+                double const *z = dataZero[i_underice];
+                size_t k = 0;
+                for (long off : plan.clear[il])
+                    for (int ihc=0; ihc<nhc_ice; ++ihc, ++k)
+                        if (z[off + ihc*plan.hc_stride[il]] != underice0[k]) active_cells.valid = false;
             }
         } break;
         default :
@@ -969,6 +1417,24 @@ std::unique_ptr<RegridMatrices_Dynamic> GCMCoupler_ModelE::regrid_matrices(    /
 #endif
 
 
+/** True if elevation masks are the same (NaN == NaN) */
+static bool same_elevmasks(
+    std::vector<blitz::Array<double,1>> const &emIs0,
+    std::vector<blitz::Array<double,1>> const &emIs1)
+{
+    if (emIs0.size() != emIs1.size()) return false;
+    for (size_t k=0; k<emIs0.size(); ++k) {
+        auto const &emI0(emIs0[k]);
+        auto const &emI1(emIs1[k]);
+        if (emI0.extent(0) != emI1.extent(0)) return false;
+        for (int i=0; i<emI0.extent(0); ++i) {
+            if (emI0(i) != emI1(i) && !(std::isnan(emI0(i)) && std::isnan(emI1(i))))
+                return false;
+        }
+    }
+    return true;
+}
+
 void GCMCoupler_ModelE::update_topo(
 double time_s,    // Simulation time
 bool run_ice,     // false for initialization
@@ -979,15 +1445,31 @@ std::vector<blitz::Array<double,1>> const &emI_ices,
 GCMInput &out,
 TupleListLT<1> &wEAm_base)   // Clear; then store wEAm in here
 {
-    auto const &indexingA(gcm_regridder->agridA->indexing);
-    auto const &indexingE(gcm_regridder->indexingE);
+    FastIndexing<2> const indexingA(gcm_regridder->agridA->indexing);
+    auto const &indexingE(gcm_regridder->fast_indexingE);
 
     GCMRegridder_WrapE *gcmW(
         dynamic_cast<GCMRegridder_WrapE *>(&*gcm_regridder));
     GCMRegridder_ModelE const *gcmA(gcmW->gcmA.get());
 
-    // Read from TOPOO file
-    ibmisc::ArrayBundle<double,2> topoo(topoo_bundle(BundleOType::MERGEO, topoO_fname));
+    // Nothing to recompute if no ice sheet changed its elevation mask
+    if (run_ice && topo_cache.valid
+        && same_elevmasks(topo_cache.emI_lands, emI_lands)
+        && same_elevmasks(topo_cache.emI_ices, emI_ices))
+    {
+        ICEBIN_PROFILE_SCOPE("GCMCoupler_ModelE::update_topo(cached)");
+        out.gcm_ivalss_s[(int)IndexAE::ATOPO] = topo_cache.gcm_ivalss_s[0];
+        out.gcm_ivalss_s[(int)IndexAE::ETOPO] = topo_cache.gcm_ivalss_s[1];
+        wEAm_base = topo_cache.wEAm_base;
+        return;
+    }
+
+    // Read from TOPOO file (once); copy, since merge_topoO() changes it
+    if (!topoo_base) topoo_base.reset(new ibmisc::ArrayBundle<double,2>(
+        topoo_bundle(BundleOType::MERGEO, topoO_fname)));
+    ibmisc::ArrayBundle<double,2> topoo(topoo_bundle(BundleOType::MERGEO));
+    for (size_t i=0; i<topoo_base->index.size(); ++i)
+        topoo.array(i).reference(topoo_base->array(i).copy());
         auto &foceanOp(topoo.array("FOCEANF"));
         auto &fgiceOp(topoo.array("FGICEF"));
         auto &zatmoOp(topoo.array("ZATMOF"));
@@ -1124,7 +1606,7 @@ TupleListLT<1> &wEAm_base)   // Clear; then store wEAm in here
             for (int k=0; k<gcm_ivalsA_s.nvar; ++k) {
                 val[k] = (*iarrays[k])(j,i);
             }
-            auto ij = indexingA.tuple_to_index(std::array<int,2>{i,j});
+            auto ij = indexingA.tuple_to_index({i,j});
             gcm_ivalsA_s.add(ij, val, 1.0);
         }}
     }
@@ -1158,26 +1640,72 @@ TupleListLT<1> &wEAm_base)   // Clear; then store wEAm in here
             for (int k=0; k<gcm_ivalsE_s.nvar; ++k) {
                 val[k] = (*iarrays[k])(ihc,j,i);
             }
-            auto ij = indexingE.tuple_to_index(std::array<int,3>{i,j,ihc});
+            auto ij = indexingE.tuple_to_index({i,j,ihc});
             gcm_ivalsE_s.add(ij, val, 1.0);
         }}}
     }
 
+    // Keep the result for next time.  (Only if the merge mask did not
+    // change: otherwise, next time will output fewer grid cells.)
+    topo_cache.valid = blitz::all(mergemaskA == mergemaskA0);
+    if (topo_cache.valid) {
+        topo_cache.emI_lands.clear();
+        for (auto const &emI : emI_lands) topo_cache.emI_lands.push_back(emI.copy());
+        topo_cache.emI_ices.clear();
+        for (auto const &emI : emI_ices) topo_cache.emI_ices.push_back(emI.copy());
+        topo_cache.gcm_ivalss_s = {
+            out.gcm_ivalss_s[(int)IndexAE::ATOPO],
+            out.gcm_ivalss_s[(int)IndexAE::ETOPO]};
+        topo_cache.wEAm_base = wEAm_base;
+        ICEBIN_PROFILE_HELD("TupleList", nbytes(topo_cache.wEAm_base));
+        ICEBIN_PROFILE_HELD("VectorMultivec",
+            nbytes(topo_cache.gcm_ivalss_s[0]) + nbytes(topo_cache.gcm_ivalss_s[1]));
+    }
+
     // Store this timestep's mergemask for next coupling time
     mergemaskA0.reference(mergemaskA);
 }
 
 // ----------------------------------------------------------------------
+/** Apply scaling to gcm_ivalsA_s, originally set in gcmce_add_xxx() */
+void GCMCoupler_ModelE::scale_gcm_ivals(GCMInput &out) const
+{
+    // This converts (for example) ZATMO [m] (as needs to go into TOPO
+    //     file) to ZATMO [m^2 s-2] (as ModelE wants to see internally)
+    // It is more trouble-free to do this here, rather than in
+    //     IceCoupler::couple() and update_topo()
+    for (size_t index_ae=0; index_ae < gcm_inputs.size(); ++index_ae) {
+        VarSet const &gcm_inputsA(gcm_inputs[index_ae]);
+        int const nvar = gcm_inputsA.size();
+        VectorMultivec &gcm_ivalsA_s(out.gcm_ivalss_s[index_ae]);
+
+        for (size_t ix=0; ix<gcm_ivalsA_s.size(); ++ix) {    // Iterate through elements of parallel arrays
+            for (int ivar=0; ivar<nvar; ++ivar) {
+                double &val(gcm_ivalsA_s.vals[ix*nvar + ivar]);
+                VarMeta const &gcm_input(gcm_inputsA.data[ivar]);
+                val = val * gcm_input.mm + gcm_input.bb;
+            }
+        }
+    }
+}
+
 GCMInput GCMCoupler_ModelE::couple(
 double time_s,        // Simulation time [s]
 VectorMultivec const &gcm_ovalsE,
 bool run_ice)    // if false, only initialize
 {
+    profile::Scope prof("GCMCoupler_ModelE::couple");
+
     // Call superclass coupling for starters
     GCMInput out(this->GCMCoupler::couple(time_s, gcm_ovalsE, run_ice));
 
     // Nothing more to do unless we're root
-    if (!gcm_params.am_i_root()) return out;
+    if (!gcm_params.am_i_root()) {
+        scale_gcm_ivals(out);    // This rank's rows, if distributed_regrid
+        prof.stop();
+        report_profile(time_s);
+        return out;
+    }
 
     // Run update_topo()
     TupleListLT<1> wEAm_base;  // set by update_topo()
@@ -1199,37 +1727,22 @@ bool run_ice)    // if false, only initialize
     // Log the results
     if (gcm_params.icebin_logging) {
         std::string fname = "gcm-in-" + sdate(time_s) + ".nc";
-        NcIO ncio(fname, 'w');
-        auto one_dims(get_or_add_dims(ncio, {"one"}, {1}));
-        NcVar info_var = get_or_add_var(ncio, "info", ibmisc::get_nc_type<double>(), one_dims);
-        info_var.putAtt("notes", "Elevation classes (HC) are just those known to IceBin.  No legacy or sea-land elevation classes included.");
-        ncio_gcm_input(ncio, out, timespan, time_unit, "");
-        ncio();
-    }
-
-    // ---------- Apply scaling to gcm_ivalsA_s, originally set in gcmce_add_xxx()
-
-    // This converts (for example) ZATMO [m] (as needs to go into TOPO
-    //     file) to ZATMO [m^2 s-2] (as ModelE wants to see internally)
-    // It is more trouble-free to do this here, rather than in
-    //     IceCoupler::couple() and update_topo()
-    for (size_t index_ae=0; index_ae < gcm_inputs.size(); ++index_ae) {
-        VarSet const &gcm_inputsA(gcm_inputs[index_ae]);
-        int const nvar = gcm_inputsA.size();
-        VectorMultivec &gcm_ivalsA_s(out.gcm_ivalss_s[index_ae]);
-
-        for (size_t ix=0; ix<gcm_ivalsA_s.size(); ++ix) {    // Iterate through elements of parallel arrays
-            for (int ivar=0; ivar<nvar; ++ivar) {
-                double &val(gcm_ivalsA_s.vals[ix*nvar + ivar]);
-                VarMeta const &gcm_input(gcm_inputsA.data[ivar]);
-                val = val * gcm_input.mm + gcm_input.bb;
-            }
-        }
+        auto out_log(std::make_shared<GCMInput>(out));    // out is scaled below
+        auto timespan_log(timespan);
+        log_write([this, fname, out_log, timespan_log]() mutable {
+            NcIO ncio(fname, 'w');
+            auto one_dims(get_or_add_dims(ncio, {"one"}, {1}));
+            NcVar info_var = get_or_add_var(ncio, "info", ibmisc::get_nc_type<double>(), one_dims);
+            info_var.putAtt("notes", "Elevation classes (HC) are just those known to IceBin.  No legacy or sea-land elevation classes included.");
+            ncio_gcm_input(ncio, *out_log, timespan_log, time_unit, "");
+            ncio();
+        });
     }
 
+    scale_gcm_ivals(out);
 
-
-printf("END GCMCoupler::couple()\n");
+    prof.stop();
+    report_profile(time_s);
     return out;
 }
 // ------------------------------------------------------------
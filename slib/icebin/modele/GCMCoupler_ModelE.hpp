@@ -18,8 +18,11 @@
 
 #pragma once
 
+#include <future>
+#include <memory>
 #include <boost/mpi.hpp>
 #include <ibmisc/f90blitz.hpp>
+#include <ibmisc/bundle.hpp>
 #include <icebin/GCMCoupler.hpp>
 #include <icebin/modele/GCMRegridder_ModelE.hpp>
 #include <icebin/vectorsparse.hpp>
@@ -109,6 +112,16 @@ public:
     double dtsrc;
     ModelEParams const *rdparams;    // Params straight from the rundeck (came during init; memory is from Fortran structure)
 
+    /** If set (config attribute m.info:lagged_coupling = 0|1), the GCM
+    gets the previous coupling interval's inputs back at once, while
+    the current interval is coupled in the background (requires
+    MPI_THREAD_MULTIPLE; otherwise it runs when next needed). */
+    bool lagged_coupling = false;
+    /** lagged_coupling: this rank's GCMInput from the last finished step */
+    std::unique_ptr<GCMInput> lagged_out;
+    /** lagged_coupling: the step in flight (this rank's GCMInput) */
+    std::future<GCMInput> pending_out;
+
     /** On root: separate global stuff back into individual domains.
     Works for A and E grids. */
     std::unique_ptr<DomainDecomposer_ModelE> domains;
@@ -127,6 +140,34 @@ public:
     std::vector<std::vector<std::unique_ptr<blitz::Array<double,2>>>> gcm_ivalssA;
     std::vector<std::vector<std::unique_ptr<blitz::Array<double,3>>>> gcm_ivalssE;
 
+    /** Where apply_gcm_ivals() puts each element of one segment of
+    GCMInput::gcm_ivalss_s.  A rank receives the same indices from
+    step to step, so this is built once and reused until they change.
+    Offsets are in doubles, from dataZero() of the destination array;
+    variables whose arrays have the same strides share them. */
+    struct ScatterPlan {
+        std::vector<long> index;     // Indices (iA or iE) the plan was built for
+        int nslot = 0;               // Number of distinct indices
+        std::vector<int> slot;       // [index.size()] Distinct index of each element
+        std::vector<int> layout;     // [nvar] Set of strides of each variable
+        std::vector<std::vector<long>> offsets;    // [nlayout][index.size()] Destination of each element
+        std::vector<std::vector<long>> clear;      // [nlayout] Destinations (E: columns) to zero first
+        std::vector<long> hc_stride;               // [nlayout] E: stride between elevation classes
+    };
+    std::vector<ScatterPlan> scatter_plans;    // [index_ae]
+
+    /** The points of this rank's domainA box that gcmce_couple_native()
+    sends to IceBin: those of an IceBin elevation class under local or
+    global ice.  Rebuilt only when underice_d changes (as noticed by
+    apply_gcm_ivals()); in between, each step just gathers them. */
+    struct ActiveCells {
+        bool valid = false;
+        std::vector<long> iE_s;      // [n] E index of each point
+        std::vector<double> weights; // [n] All 1
+        std::vector<int> layout;     // [nvar] Set of strides of each of gcm_ovalsE
+        std::vector<std::vector<long>> offsets;    // [nlayout][n] Offset of each point, from dataZero()
+    } active_cells;
+
     // Low and high indices for this MPI rank.
     // Indices are in Fortran order (im, jm) with zero-based indexing
     ibmisc::Domain domainA;
@@ -137,6 +178,11 @@ public:
     program, sans ice sheets) */
     std::string topoO_fname;
 
+    /** Contents of topoO_fname (BundleOType::MERGEO variables).  They
+    do not change during a run, so update_topo() reads them just once
+    and starts each step from a copy. */
+    std::unique_ptr<ibmisc::ArrayBundle<double,2>> topoo_base;
+
     /** Name of file on ocean grid containing the EvA matrix for global (non-IceBin) ice. */
     std::string global_ecO_fname;
 
@@ -162,6 +208,16 @@ public:
     VectorSparse<int,double,2> E1vE0c;
     // ========================
 
+    /** Result of the last update_topo(), reused while the elevation
+    masks stay the same (eg an ice sheet that has not changed extent
+    or elevation since the last coupling step). */
+    struct TopoCache {
+        bool valid = false;
+        std::vector<blitz::Array<double,1>> emI_lands, emI_ices;
+        std::vector<VectorMultivec> gcm_ivalss_s;    // ATOPO, ETOPO (unscaled)
+        TupleListLT<1> wEAm_base;
+    } topo_cache;
+
 public:
     virtual ~GCMCoupler_ModelE() {}
 
@@ -184,6 +240,25 @@ public:
         VectorMultivec const &gcm_ovalsE,
         bool run_ice);    // if false, only initialize
 
+    /** lagged_coupling version of the coupling step in gcmce_couple_native().
+    @return This rank's GCMInput from the previous step. */
+    GCMInput couple_lagged(
+        double time_s,
+        VectorMultivec &&gcm_ovalsE_s);
+
+    /** Waits for the step in flight, if any.
+    @return The last finished step's GCMInput */
+    GCMInput finish_lagged();
+
+    /** Reads / writes lagged_out with the restart files */
+    void ncio_lagged(std::string const &fname, char rw);
+
+    /** Converts gcm_ivalss_s to ModelE's internal units (see gcm_inputs) */
+    void scale_gcm_ivals(GCMInput &out) const;
+
+    int domain_of(long iAE_s) const    // virtual
+        { return domains->get_domain(iAE_s); }
+
     void _ncread(    // virtual
         ibmisc::NcIO &ncio_config,
         std::string const &vname);        // comes from this->gcm_params
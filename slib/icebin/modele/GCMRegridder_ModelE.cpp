@@ -1,3 +1,5 @@
+#include <mutex>
+#include <boost/filesystem.hpp>
 #include <icebin/modele/topo.hpp>
 #include <spsparse/eigen.hpp>
 #include <ibmisc/stdio.hpp>
@@ -66,10 +68,10 @@ static AbbrGrid make_agridA(
     // Use hntr to figure out which grid cells should be realized in A, based
     // on realized grid cells in O
     SparseSet<long,int> dimA;
-    Hntr hntrOvA(17.17, hspecO, hspecA, 0);
-    HntrGrid const &hgridA(hntrOvA.Bgrid);
+    auto const hntrOvA(cached_hntr(17.17, hspecO, hspecA, 0));
+    HntrGrid const &hgridA(hntrOvA->Bgrid);
     AbbrGrid agridA;
-    hntrOvA.overlap(
+    hntrOvA->overlap(
             accum::SparseSetAccum<SparseSetT,double,2>({nullptr, &dimA}),
         1.0, DimClip(&dimO));
 
@@ -99,16 +101,10 @@ static std::unique_ptr<linear::Weighted_Eigen> compute_AOmvAAm(
     auto &dimAAm(*dims[1]);
 
 
-    // Obtain hntrA and hntrO for process below.
-    GridSpec_LonLat const &specO(gcmA->specO());
-    GridSpec_LonLat const &specA(gcmA->specA());
-
-    Hntr hntr_XOmvXAm(17.17, specO.hntr, specA.hntr);
-
     std::unique_ptr<linear::Weighted_Eigen> ret(new linear::Weighted_Eigen(dims, true));    // conservative
     reset_ptr(ret->M, MakeDenseEigenT(
-        std::bind(&Hntr::overlap<MakeDenseEigenT::AccumT,DimClip>,
-            &hntr_XOmvXAm, _1, specA.eq_rad, DimClip(&dimAOm)),
+        std::bind(&replay_overlap<MakeDenseEigenT::AccumT,DimClip>,
+            _1, std::cref(gcmA->overlap_AOvAA()), DimClip(&dimAOm)),
         {SparsifyTransform::TO_DENSE_IGNORE_MISSING, SparsifyTransform::ADD_DENSE},
         {&dimAOm, &dimAAm}, transpose).to_eigen());
 
@@ -191,9 +187,6 @@ ComputeXAmvGp_Helper::ComputeXAmvGp_Helper(
 
     EigenColVectorT wAOm_e(compute_wAOm(foceanAOp, foceanAOm, wAOp, dimAOp, dimAOm));
 
-    HntrSpec const &hntrA(cast_GridSpec_LonLat(*gcmA->agridA->spec).hntr);
-    HntrSpec const &hntrO(cast_GridSpec_LonLat(*gcmA->gcmO->agridA->spec).hntr);
-
     dimXAm.set_sparse_extent(gcmA->nAE(gridX));
     dimIp.set_sparse_extent(rmO->ice_regridder->nG(gridG));
 
@@ -235,9 +228,8 @@ ComputeXAmvGp_Helper::ComputeXAmvGp_Helper(
 
         blitz::Array<double,1> wXOm(to_blitz(*wXOm_e));
         reset_ptr(XAmvXOm, MakeDenseEigenT(    // TODO: Call this XAvXO, since it's the same 'm' or 'p'
-            std::bind(&raw_EOvEA, _1,
-                hntrO, hntrA,
-                eq_rad, &dimAOm, wXOm,
+            std::bind(&raw_EOvEA_replay, _1,
+                std::cref(gcmA->overlap_AOvAA()), &dimAOm, wXOm,
                 gcmA->nhc(), gcmA->gcmO->indexingHC, gcmA->indexingHC),
             {SparsifyTransform::TO_DENSE_IGNORE_MISSING, SparsifyTransform::ADD_DENSE},
             {&dimEOm, &dimEAm}, 'T').to_eigen());
@@ -258,10 +250,9 @@ ComputeXAmvGp_Helper::ComputeXAmvGp_Helper(
         SparseSetT &dimAAm(dimXAm);
 
         // Actually AOmvAAm
-        Hntr hntr_XOmvXAm(17.17, hntrO, hntrA);
         reset_ptr(XAmvXOm, MakeDenseEigenT(
-            std::bind(&Hntr::overlap<MakeDenseEigenT::AccumT,DimClip>,
-                &hntr_XOmvXAm, _1, eq_rad, DimClip(&dimAOm)),
+            std::bind(&replay_overlap<MakeDenseEigenT::AccumT,DimClip>,
+                _1, std::cref(gcmA->overlap_AOvAA()), DimClip(&dimAOm)),
             {SparsifyTransform::TO_DENSE_IGNORE_MISSING, SparsifyTransform::ADD_DENSE},
             {&dimAOm, &dimAAm}, 'T').to_eigen());
     }
@@ -454,6 +445,7 @@ GCMRegridder_ModelE::GCMRegridder_ModelE(
         {agridA->dim.sparse_extent(), gcmO->indexingHC[1].extent},
         {gcmO->indexingHC.indices()[0], gcmO->indexingHC.indices()[1]});
     indexingE = derive_indexingE(agridA->indexing, indexingHC);
+    set_fast_indexing();
 
     // Read number of global EC's out of global EC matrix file.
     if (global_ecO == "") {
@@ -472,8 +464,14 @@ printf("Opening global_ecO = %s\n", global_ecO.c_str());
 
     // Read EOpvAOp_base from global_ec file
     // Read metadata and global EOpvAOp matrix (from output of global_ec.cpp)
+    // (or mmap it from a pre-converted bincsr file, which is much faster)
     if (global_ecO != "") {
-        {NcIO ncio(global_ecO, 'r');
+        std::string const bcsr_fname(bincsr_fname(global_ecO, "EvO"));
+        if (boost::filesystem::exists(bcsr_fname)) {
+            printf("Mapping global EOpvAOp from %s\n", bcsr_fname.c_str());
+            EOpvAOp_base_mapped.reset(new MappedCSR(bcsr_fname));
+        } else {
+            NcIO ncio(global_ecO, 'r');
             // metaO.ncio(ncio);   // no metaO in this class
             EOpvAOp_base.ncio(ncio, "EvO.M");
         }
@@ -484,6 +482,20 @@ printf("Opening global_ecO = %s\n", global_ecO.c_str());
 
 
 
+static std::mutex overlap_AOvAA_mutex;
+
+HntrBufferAccum::BufferT const &GCMRegridder_ModelE::overlap_AOvAA() const
+{
+    std::lock_guard<std::mutex> lock(overlap_AOvAA_mutex);
+    if (!_overlap_AOvAA) {
+        auto const hntr_AOvAA(cached_hntr(17.17, hspecO(), hspecA(), 0));    // dimB=O, dimA=A
+        std::shared_ptr<HntrBufferAccum::BufferT> buf(new HntrBufferAccum::BufferT);
+        hntr_AOvAA->overlap(HntrBufferAccum(buf.get()), specO().eq_rad);
+        _overlap_AOvAA = buf;
+    }
+    return *_overlap_AOvAA;
+}
+
 std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_ModelE::regrid_matrices(
     int sheet_index,
     blitz::Array<double,1> const &foceanAOp,
@@ -491,7 +503,7 @@ std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_ModelE::regrid_matrices(
     blitz::Array<double,1> const &elevmaskI,
     RegridParams const &params) const
 {
-    IceRegridder const *regridder = &*ice_regridders()[sheet_index];
+    IceRegridder const *regridder = ice_regridder(sheet_index);
     std::unique_ptr<RegridMatrices_Dynamic> rm(new RegridMatrices_Dynamic(regridder, params));
     GridSpec_LonLat const &specO(this->specO());
 
@@ -506,6 +518,10 @@ std::unique_ptr<RegridMatrices_Dynamic> GCMRegridder_ModelE::regrid_matrices(
     std::unique_ptr<RegridMatrices_Dynamic> _rmO(
         gcmO->regrid_matrices(sheet_index, elevmaskI, params));
     auto &rmO(rm->tmp.take(std::move(*_rmO)));
+    rm->inputs_hash = hash_array(foceanAOm, hash_array(foceanAOp, rmO.inputs_hash));
+    rm->inputs = rmO.inputs;
+    rm->inputs.insert(rm->inputs.end(), foceanAOp.begin(), foceanAOp.end());
+    rm->inputs.insert(rm->inputs.end(), foceanAOm.begin(), foceanAOm.end());
 
     rm->add_regrid("EAmvIp", std::bind(&compute_XAmvGp, _1, _2,
         this, foceanAOp, foceanAOm,
@@ -598,12 +614,22 @@ linear::Weighted_Tuple GCMRegridder_ModelE::global_AvE(
 
     std::vector<std::string> errors;
     SparseSetT dimAOp;
-    EOpvAOpResult eam(compute_EOpvAOp_merged(
-        dimAOp, EOpvAOp_base,
-        RegridParams(false, false, {0.,0.,0.}),  // (scale, correctA, sigma)
-        &*gcmO, specO.eq_rad, emI_ices,
-        true, true,    // use_global_ice=t, use_local_ice=t
-        hcdefs(), indexingHC, false, errors));
+    std::unique_lock<std::mutex> pattern_lock(_EOpvAOp_pattern_mutex);
+    if (!_EOpvAOp_pattern) _EOpvAOp_pattern.reset(new EOpvAOpPattern);
+    EOpvAOpResult eam(EOpvAOp_base_mapped
+        ? compute_EOpvAOp_merged(
+            dimAOp, *EOpvAOp_base_mapped,
+            RegridParams(false, false, {0.,0.,0.}),  // (scale, correctA, sigma)
+            &*gcmO, specO.eq_rad, emI_ices,
+            true, true,    // use_global_ice=t, use_local_ice=t
+            hcdefs(), indexingHC, false, errors, &*_EOpvAOp_pattern)
+        : compute_EOpvAOp_merged(
+            dimAOp, EOpvAOp_base,
+            RegridParams(false, false, {0.,0.,0.}),  // (scale, correctA, sigma)
+            &*gcmO, specO.eq_rad, emI_ices,
+            true, true,    // use_global_ice=t, use_local_ice=t
+            hcdefs(), indexingHC, false, errors, &*_EOpvAOp_pattern));
+    pattern_lock.unlock();
     offsetE = eam.offsetE;   // Return offsetE value
 
     // Print sanity check errors to STDERR
@@ -664,6 +690,7 @@ void GCMRegridder_WrapE::_init(std::unique_ptr<GCMRegridder_ModelE> &&_gcmA)
     correctA = gcmA->correctA;
     indexingHC = gcmA->indexingHC;
     indexingE = gcmA->indexingE;
+    set_fast_indexing();
     _hcdefs = gcmA->_hcdefs;
 }
 
@@ -1,9 +1,12 @@
 #ifndef ICEBIN_MODELE_GCMREGRIDDER_MODELE_HPP
 #define ICEBIN_MODELE_GCMREGRIDDER_MODELE_HPP
 
+#include <mutex>
 #include <ibmisc/linear/eigen.hpp>
 #include <icebin/GCMRegridder.hpp>
+#include <icebin/bincsr.hpp>
 #include <icebin/modele/grids.hpp>
+#include <icebin/modele/hntr.hpp>
 
 namespace icebin {
 namespace modele {
@@ -11,6 +14,8 @@ namespace modele {
 /** Casts to a Grid_Lonlat, which is what we know is used by ModelE */
 GridSpec_LonLat const &cast_GridSpec_LonLat(GridSpec const &_specO);
 
+struct EOpvAOpPattern;    // merge_topo.hpp
+
 /** This class produces regridding matrices between the grids (AAm,
 EAm, Ip).
 
@@ -130,6 +135,23 @@ public:
     /** Base EOpvAOp matrix, laoded from TOPO_OC file */
     ibmisc::ZArray<int,double,2> EOpvAOp_base;    // from linear::Weighted_Compressed; UNSCALED
 
+    /** Base EOpvAOp matrix, memory-mapped from the bincsr sidecar of
+    global_ecO (see bincsr_fname()), if there is one.  Used in place of
+    EOpvAOp_base, which is then left empty. */
+    std::unique_ptr<MappedCSR> EOpvAOp_base_mapped;
+
+protected:
+    /** Cache for overlap_AOvAA() */
+    mutable std::shared_ptr<HntrBufferAccum::BufferT const> _overlap_AOvAA;
+
+    /** Sparsity pattern of the merged EOpvAOp from the last global_AvE() */
+    mutable std::shared_ptr<EOpvAOpPattern> _EOpvAOp_pattern;
+    /** Guards _EOpvAOp_pattern, which compute_EOpvAOp_merged() both
+    reads and overwrites. */
+    mutable std::mutex _EOpvAOp_pattern_mutex;
+
+public:
+
     /** Constructor used in coupler: create the GCMRegridder first,
         then fill in foceanAOp and foceanAOm later.
     @param _gcmO Underlying regridder for the Ocean Grid Regime. */
@@ -150,6 +172,14 @@ public:
     GridSpec_LonLat const &specA() const
         { return cast_GridSpec_LonLat(*agridA->spec); }
 
+    /** Unclipped overlap matrix between the ocean (B) and atmosphere
+    (A) grids, as produced by Hntr::overlap().  It depends only on the
+    grids --- not on foceanAOm or the elevation mask --- so it is
+    computed on first use and then replayed (with clipping to dimAOm)
+    by every regrid_matrices() call that needs AOmvAAm or EOmvEAm.
+    Thread-safe. */
+    HntrBufferAccum::BufferT const &overlap_AOvAA() const;
+
 // TODO: get rid of eq_rad in metaO
 
     /** Determines whether an elevation class is handled by IceBin or
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <icebin/modele/clippers.hpp>
 #include <icebin/gridgen/clippers.hpp>
 
@@ -19,4 +20,24 @@ bool ice_sheet::clip(int zone, long index, double lon0, double lat0, double lon1
     return false;
 }
 
+void ice_sheet::clip_row(int zone,
+    std::vector<double> const &lonb, double lat0, double lat1,
+    long const *index, char *keep)
+{
+    size_t const nlon = lonb.size() - 1;
+
+    // Antarctica range depends only on latitude
+    if ((zone & ANTARCTICA) && (lat0 <= -60. || lat1 <= -60)) {
+        std::fill(keep, keep + nlon, 1);
+        return;
+    }
+
+    if (zone & GREENLAND) {
+        SphericalClip::lonlat_row(-74., 59., -10., 87.5,
+            lonb, lat0, lat1, index, keep);
+    } else {
+        std::fill(keep, keep + nlon, 0);
+    }
+}
+
 }}    // namespace icebin::modele
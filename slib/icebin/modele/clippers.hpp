@@ -1,6 +1,8 @@
 #ifndef ICEBIN_MODELE_CLIPPERS_HPP
 #define ICEBIN_MODELE_CLIPPERS_HPP
 
+#include <vector>
+
 namespace icebin {
 namespace modele {
 
@@ -10,6 +12,11 @@ struct ice_sheet {
 
     /** Clipping function clips around ice sheets */
     static bool clip(int zone, long index, double lon0, double lat0, double lon1, double lat1);
+
+    /** Row version of clip() (see SphericalRowClip) */
+    static void clip_row(int zone,
+        std::vector<double> const &lonb, double lat0, double lat1,
+        long const *index, char *keep);
 };
 
 
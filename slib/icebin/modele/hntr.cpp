@@ -1,4 +1,9 @@
 #include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
 #include <icebin/error.hpp>
 #include <icebin/modele/hntr.hpp>
 //#include <icebin/modele/hntr_templates.hpp>
@@ -167,6 +172,88 @@ void Hntr::partition_north_south()
 
 }
 
+int Hntr::nthread_rows() const
+{
+#ifdef USE_OPENMP
+    if (Bgrid.spec.size() < PARALLEL_ACCUM_MIN) return 1;
+    return std::max(1, std::min(max_threads(), Bgrid.spec.jm));
+#else
+    return 1;
+#endif
+}
+
+// ========================================================
+typedef std::array<uint64_t,10> HntrKey;
+
+/** Compares doubles bitwise in the key, so NaN DATMIS work. */
+static uint64_t key_bits(double x)
+{
+    uint64_t ret;
+    memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+static std::mutex hntr_cache_mutex;
+static std::map<HntrKey, std::shared_ptr<Hntr const>> hntr_cache;
+
+std::shared_ptr<Hntr const> cached_hntr(
+    double yp17, HntrSpec const &_B, HntrSpec const &_A, double _DATMIS)
+{
+    HntrKey const key {
+        key_bits(yp17),
+        (uint64_t)_B.im, (uint64_t)_B.jm, key_bits(_B.offi), key_bits(_B.dlat),
+        (uint64_t)_A.im, (uint64_t)_A.jm, key_bits(_A.offi), key_bits(_A.dlat),
+        key_bits(_DATMIS)};
+
+    // Construction is cheap (a few 1-D arrays), so hold the lock
+    std::lock_guard<std::mutex> lock(hntr_cache_mutex);
+    auto ii(hntr_cache.find(key));
+    if (ii != hntr_cache.end()) return ii->second;
+
+    std::shared_ptr<Hntr const> hntr(new Hntr(yp17, _B, _A, _DATMIS));
+    hntr_cache.insert(std::make_pair(key, hntr));
+    return hntr;
+}
+
+void clear_hntr_cache()
+{
+    std::lock_guard<std::mutex> lock(hntr_cache_mutex);
+    hntr_cache.clear();
+}
+
+// ========================================================
+/** Accumulator for Hntr::compile(): appends one CSR row per B gridcell */
+class CompileMatAccum {
+    HntrWeights &weights;
+public:
+    CompileMatAccum(HntrWeights &_weights) : weights(_weights) {}
+
+    void clear() {}
+
+    void addA(int const IJA, double const FG)
+    {
+        weights.colA.push_back(IJA-1);
+        weights.FG.push_back(FG);
+    }
+
+    void finishB(int const IJB, int const JB)
+        { weights.rowptr.push_back(weights.FG.size()); }
+};
+
+void Hntr::compile()
+{
+    if (compiled()) return;
+
+    HntrWeights w;
+    w.rowptr.reserve(Bgrid.spec.size()+1);
+    w.rowptr.push_back(0);
+    matrix(CompileMatAccum(w), IncludeConst<int,true>());
+
+    w.colA.shrink_to_fit();
+    w.FG.shrink_to_fit();
+    weights = std::move(w);
+}
+
 #if 0
 // ========================================================
 // Explicit template instantiation for some regrids
@@ -1,10 +1,15 @@
 #ifndef ICEBIN_HNTR_HPP
 #define ICEBIN_HNTR_HPP
 
+#include <algorithm>
+#include <vector>
+#include <memory>
 #include <ibmisc/blitz.hpp>
 #include <ibmisc/indexing.hpp>
+#include <ibmisc/bundle.hpp>
 #include <icebin/eigen_types.hpp>
 #include <icebin/GridSpec.hpp>
+#include <icebin/parallel.hpp>
 
 namespace icebin {
 namespace modele {
@@ -58,6 +63,19 @@ blitz::Array<TypeT,2> hntr_array(HntrSpec const &spec)
     { return blitz::Array<TypeT,2>(spec.im,spec.jm, blitz::fortranArray); }
 
 
+/** Interpolation weights of a Hntr, materialized by Hntr::compile().
+Stored in CSR form: B gridcell IJB (0-based) draws from the A gridcells
+colA[k] (0-based), with unnormalized weights FG[k], for k in
+[rowptr[IJB], rowptr[IJB+1]). */
+struct HntrWeights {
+    std::vector<long> rowptr;    // Length Bgrid.spec.size()+1
+    std::vector<int> colA;
+    std::vector<double> FG;
+
+    bool empty() const { return rowptr.size() == 0; }
+    size_t nnz() const { return FG.size(); }
+};
+
 /** Pre-computed overlap details needed to regrid from one lat/lon
     grid to another on the sphere. */
 class Hntr {
@@ -87,6 +105,10 @@ public:
     // cell (IB,JB) has integrated value 0 of WTA
     double DATMIS;
 
+    /** Set by compile(); if non-empty, regrid() uses it instead of
+    re-walking the tables above. */
+    HntrWeights weights;
+
 public:
 
 
@@ -99,6 +121,14 @@ public:
 
     Hntr(double yp17, HntrSpec const &_B, HntrSpec const &_A, double _DATMIS=0.0);
 
+    /** Materializes the interpolation weights (see HntrWeights), so
+    subsequent calls to regrid() are a single streaming pass over
+    them.  Worthwhile when many fields are regridded between the same
+    pair of grids; costs about 12 bytes per overlap. */
+    void compile();
+
+    bool compiled() const { return !weights.empty(); }
+
 
 
 
@@ -121,6 +151,10 @@ public:
              mean_polar: polar values are replaced by their
                  longitudinal mean.
     Output:  B = horizontally interpolated quantity on B grid
+
+    WTA and A may be narrow types (float, int16_t), so that huge inputs
+    (eg 1-minute topography) need not be promoted to double; weights
+    and values are always accumulated in double.
     */
     template<class WeightT, class SrcT, class DestT, int RANK>
     void regrid(
@@ -137,11 +171,75 @@ public:
         blitz::Array<double,RANK> const &A,
         bool mean_polar = false) const;
 
+    /** Regrids several fields that share the same weights WTA, in one
+    traversal of the overlap structure: Bs[i] is interpolated from
+    As[i].  Results are identical to calling regrid() on each field. */
+    template<class WeightT, class SrcT, class DestT, int RANK>
+    void regrid(
+        blitz::Array<WeightT,RANK> const &_WTA,
+        std::vector<blitz::Array<SrcT,RANK>> const &_As,
+        std::vector<blitz::Array<DestT,RANK>> const &_Bs,
+        bool mean_polar=false,
+        double wtm=1.0, double wtb=0.0) const;
+
+    /** Same as the multi-field regrid() above, but computes only rows
+    [JB0, JB1) of gridB, from a latitude band of the A arrays holding
+    only rows rowsA(JB0, JB1) of gridA.  Lets huge A grids be
+    regridded a band at a time.  All arrays are 1-D and 1-based, as
+    for the full grids: the A arrays start at index (JA0-1)*im+1, and
+    the B arrays cover all of gridB.  Uses the overlap tables even if
+    compile()d, since the compiled weights would span the whole grid. */
+    template<class WeightT, class SrcT, class DestT>
+    void regrid_rows(
+        blitz::Array<WeightT,1> const &_WTA,
+        std::vector<blitz::Array<SrcT,1>> const &_As,
+        std::vector<blitz::Array<DestT,1>> const &_Bs,
+        int JB0, int JB1,
+        bool mean_polar=false,
+        double wtm=1.0, double wtb=0.0) const;
+
+    /** Rows [JA0, JA1) of gridA that overlap rows [JB0, JB1) of gridB
+    (1-based) */
+    std::array<int,2> rowsA(int JB0, int JB1) const
+        { return std::array<int,2>{JMIN(JB0), JMAX(JB1-1)+1}; }
+
+    /** Regrids every variable in srcs into the variable of the same
+    name in dsts, in one traversal (see above). */
+    template<class WeightT, class SrcT, class DestT, int RANK>
+    void regrid(
+        blitz::Array<WeightT,RANK> const &WTA,
+        ibmisc::ArrayBundle<SrcT,RANK> const &srcs,
+        ibmisc::ArrayBundle<DestT,RANK> &dsts,
+        bool mean_polar=false,
+        double wtm=1.0, double wtb=0.0) const;
+
 
 private:
     void partition_east_west();
     void partition_north_south();
 
+    /** Kernel of regrid() when compiled().  Arrays are 0-based here. */
+    template<class WeightT, class SrcT, class DestT>
+    void apply_weights(
+        WeightT const *WTA, SrcT const *A, DestT *B,
+        double wtm, double wtb) const;
+
+    /** Multi-field kernel of regrid() when compiled() */
+    template<class WeightT, class SrcT, class DestT>
+    void apply_weights(
+        WeightT const *WTA,
+        std::vector<SrcT const *> const &As,
+        std::vector<DestT *> const &Bs,
+        double wtm, double wtb) const;
+
+    /** Replace individual values near the poles by longitudinal mean */
+    template<class DestT>
+    void mean_polar_fill(blitz::Array<DestT,1> &B) const;
+
+    /** mean_polar_fill() for one polar row JB of B */
+    template<class DestT>
+    void mean_polar_row(blitz::Array<DestT,1> &B, int JB) const;
+
     // Default function argument for overlap() template below
     template<typename Typ, bool Val>
     struct IncludeConst
@@ -156,7 +254,34 @@ private:
     template<class MatAccumT, class IncludeT>
     void matrix(
         MatAccumT &&mataccum,        // The output (sparse) matrix; 0-based indexing
-        IncludeT includeB) const;
+        IncludeT includeB) const
+    { matrix_rows(std::forward<MatAccumT>(mataccum), includeB, 1, Bgrid.spec.jm+1); }
+
+    /** Runs matrix() over rows JB in [JB0, JB1) of gridB only. */
+    template<class MatAccumT, class IncludeT>
+    void matrix_rows(
+        MatAccumT &&mataccum,
+        IncludeT &includeB,
+        int JB0, int JB1) const;
+
+    /** Row-parallel version of matrix(), for accumulators that emit
+    matrix elements.  Each thread gets a contiguous block of rows of
+    gridB, its own copy of includeB, and its own accumulator (built by
+    rows_fn) writing into a per-thread buffer.  Buffers are then
+    replayed into accum in row order, so accum receives the same
+    elements in the same order as from matrix().
+    @param rows_fn void(HntrBufferAccum &&, IncludeT &, int JB0, int JB1):
+        runs matrix_rows() with an accumulator writing to the buffer.
+    @return false (and does nothing) if not worth running in parallel,
+        or not built with OpenMP. */
+    template<class AccumT, class IncludeT, class RowsFnT>
+    bool matrix_ordered(
+        AccumT &accum,
+        IncludeT const &includeB,
+        RowsFnT const &rows_fn) const;
+
+    /** Number of threads to use for row-parallel operations (1 = serial) */
+    int nthread_rows() const;
 
 public:
     /** Generates the overlap matrix between two Hntr grids.
@@ -173,16 +298,26 @@ public:
     void overlap(
         AccumT &&accum,        // The output (sparse) matrix; 0-based indexing
         double const eq_rad,        // Radius of the Earth
-        IncludeT includeB = IncludeT());
+        IncludeT includeB = IncludeT()) const;
 
     /** Produces a scaled regrid matrix, without the extra baggage.
     Equivalent to running overlap() and then scaling. */
     template<class AccumT, class IncludeT = IncludeConst<int,true>>
     void scaled_regrid_matrix(
         AccumT &&accum,        // The output (sparse) matrix; 0-based indexing
-        IncludeT includeB = IncludeT());
+        IncludeT includeB = IncludeT()) const;
 };    // class Hntr
 
+/** Process-wide cache of Hntr instances.  Returns a shared, immutable
+Hntr for the given constructor arguments, constructing it on first use.
+Thread-safe. */
+extern std::shared_ptr<Hntr const> cached_hntr(
+    double yp17, HntrSpec const &_B, HntrSpec const &_A, double _DATMIS=0.0);
+
+/** Drops all Hntr instances held by cached_hntr().  Instances still
+in use elsewhere remain valid. */
+extern void clear_hntr_cache();
+
 
 
 // --------------------------------------------------------------
@@ -198,17 +333,47 @@ public:
 };
 
 
+/** Per-thread destination for matrix elements in Hntr::matrix_ordered() */
+class HntrBufferAccum {
+public:
+    typedef std::vector<std::pair<std::array<int,2>, double>> BufferT;
+private:
+    BufferT *buf;
+public:
+    HntrBufferAccum(BufferT *_buf) : buf(_buf) {}
+
+    void add(std::array<int,2> const &index, double val)
+        { buf->push_back(std::make_pair(index, val)); }
+};
+
+/** Replays an overlap matrix previously buffered from Hntr::overlap()
+(without clipping) into accum, keeping only elements whose gridB cell
+passes includeB.  Gives the same elements, in the same order, as
+calling Hntr::overlap() again with includeB. */
+template<class AccumT, class IncludeT>
+void replay_overlap(
+    AccumT &&accum,
+    HntrBufferAccum::BufferT const &buf,
+    IncludeT const &includeB)
+{
+    for (auto const &ii : buf) {
+        if (!includeB(ii.first[0])) continue;
+        accum.add({ii.first[0], ii.first[1]}, ii.second);
+    }
+}
+
 // ----------------------------------------------------------------
 
 // ==================================================================
 template<class MatAccumT, class IncludeT>
-void Hntr::matrix(
+void Hntr::matrix_rows(
     MatAccumT &&mataccum,        // The output (sparse) matrix; 0-based indexing
-    IncludeT includeB) const
+    IncludeT &includeB,
+    int JB0, int JB1) const
 {
     // ------------------
     // Interpolate the A grid onto the B grid
-    for (int JB=1; JB <= Bgrid.spec.jm; ++JB) {
+    for (int JB=JB0; JB < JB1; ++JB) {
         int JAMIN = JMIN(JB);
         int JAMAX = JMAX(JB);
 
@@ -243,6 +408,41 @@ void Hntr::matrix(
     }
 }
 
+template<class AccumT, class IncludeT, class RowsFnT>
+bool Hntr::matrix_ordered(
+    AccumT &accum,
+    IncludeT const &includeB,
+    RowsFnT const &rows_fn) const
+{
+#ifdef USE_OPENMP
+    int const nthread = nthread_rows();
+    if (nthread == 1) return false;
+
+    int const nJB = Bgrid.spec.jm;
+    std::vector<HntrBufferAccum::BufferT> bufs(nthread);
+    std::vector<IncludeT> includes(nthread, includeB);    // Copy outside threads
+
+    #pragma omp parallel num_threads(nthread)
+    {
+        int const ithread = omp_get_thread_num();
+        int const nt = omp_get_num_threads();
+        int const JB0 = 1 + (nJB * ithread) / nt;
+        int const JB1 = 1 + (nJB * (ithread+1)) / nt;
+        rows_fn(HntrBufferAccum(&bufs[ithread]), includes[ithread], JB0, JB1);
+    }
+
+    // Merge, in original row order
+    for (auto &buf : bufs) {
+        for (auto &ii : buf) accum.add({ii.first[0], ii.first[1]}, ii.second);
+        buf.clear();
+        buf.shrink_to_fit();
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 
 // ----------------------------------------------------------
 template<class AccumT>
@@ -287,9 +487,16 @@ template<class AccumT, class IncludeT>
 void Hntr::overlap(
     AccumT &&accum,        // The output (sparse) matrix; 0-based indexing
     double const eq_rad,        // Radius of the Earth
-    IncludeT includeB)
+    IncludeT includeB) const
 {
-    matrix(OverlapMatAccum<AccumT>(std::move(accum), Bgrid, eq_rad*eq_rad), includeB);
+    double const R2 = eq_rad*eq_rad;
+    if (matrix_ordered(accum, includeB,
+        [&](HntrBufferAccum &&buf, IncludeT &incl, int JB0, int JB1) {
+            matrix_rows(OverlapMatAccum<HntrBufferAccum>(std::move(buf), Bgrid, R2),
+                incl, JB0, JB1);
+        })) return;
+
+    matrix(OverlapMatAccum<AccumT>(std::move(accum), Bgrid, R2), includeB);
 }
 // ----------------------------------------------------------
 template<class AccumT>
@@ -331,8 +538,14 @@ public:
 template<class AccumT, class IncludeT>
 void Hntr::scaled_regrid_matrix(
     AccumT &&accum,        // The output (sparse) matrix; 0-based indexing
-    IncludeT includeB)
+    IncludeT includeB) const
 {
+    if (matrix_ordered(accum, includeB,
+        [&](HntrBufferAccum &&buf, IncludeT &incl, int JB0, int JB1) {
+            matrix_rows(ScaledRegridMatAccum<HntrBufferAccum>(std::move(buf), Agrid),
+                incl, JB0, JB1);
+        })) return;
+
     matrix(
         ScaledRegridMatAccum<AccumT>(std::move(accum), Agrid),
         std::move(includeB));
@@ -381,6 +594,51 @@ public:
 
 };
 
+/** Same as RegridAccum, for several fields sharing one WTA */
+template<class WeightT, class SrcT, class DestT>
+class MultiRegridAccum {
+    blitz::Array<WeightT,1> &WTA;
+    std::vector<blitz::Array<SrcT,1>> &As;
+    std::vector<blitz::Array<DestT,1>> &Bs;
+    double const DATMIS;
+    double const wtm;
+    double const wtb;
+
+    double WEIGHT;
+    std::vector<double> VALUE;    // One per field
+
+public:
+    MultiRegridAccum(
+        blitz::Array<WeightT,1> &_WTA,
+        std::vector<blitz::Array<SrcT,1>> &_As,
+        std::vector<blitz::Array<DestT,1>> &_Bs,
+        double _DATMIS,
+        double _wtm, double _wtb)
+    : WTA(_WTA), As(_As), Bs(_Bs), DATMIS(_DATMIS), wtm(_wtm), wtb(_wtb),
+        VALUE(_As.size()) {}
+
+    void clear()
+    {
+        WEIGHT = 0.;
+        std::fill(VALUE.begin(), VALUE.end(), 0.);
+    }
+
+    void addA(int const IJA, double const FG)
+    {
+        double const wta = wtm * WTA(IJA) + wtb;
+        double const wt = FG * wta;
+        WEIGHT += wt;
+        for (size_t i=0; i<As.size(); ++i) VALUE[i] += wt * As[i](IJA);
+    }
+
+    void finishB(int const IJB, int const JB)
+    {
+        for (size_t i=0; i<Bs.size(); ++i)
+            Bs[i](IJB) = (WEIGHT == 0 ? DATMIS : VALUE[i] / WEIGHT);
+    }
+
+};
+
 
 template<class WeightT, class SrcT, class DestT, int RANK>
 void Hntr::regrid(
@@ -406,34 +664,274 @@ void Hntr::regrid(
     }
 
 
-    matrix(
-        RegridAccum<WeightT,SrcT,DestT>(WTA, A, B, DATMIS, wtm, wtb),
-        IncludeConst<int,true>());
+    if (compiled() && WTA.stride(0) == 1 && A.stride(0) == 1 && B.stride(0) == 1)
+    {
+        apply_weights(WTA.data(), A.data(), B.data(), wtm, wtb);
+    } else {
+#ifdef USE_OPENMP
+        // Each B gridcell is written by exactly one row, so threads need
+        // only their own accumulator state.
+        int const nJB = Bgrid.spec.jm;
+        #pragma omp parallel num_threads(nthread_rows())
+        {
+            int const ithread = omp_get_thread_num();
+            int const nt = omp_get_num_threads();
+            IncludeConst<int,true> includeB;
+            matrix_rows(
+                RegridAccum<WeightT,SrcT,DestT>(WTA, A, B, DATMIS, wtm, wtb),
+                includeB,
+                1 + (nJB * ithread) / nt, 1 + (nJB * (ithread+1)) / nt);
+        }
+#else
+        matrix(
+            RegridAccum<WeightT,SrcT,DestT>(WTA, A, B, DATMIS, wtm, wtb),
+            IncludeConst<int,true>());
+#endif
+    }
 
-    if (mean_polar) {
-        // Replace individual values near the poles by longitudinal mean
-        for (int JB=1; JB <= Bgrid.spec.jm; JB += Bgrid.spec.jm-1) {
-            double BMEAN  = DATMIS;
+    if (mean_polar) mean_polar_fill(B);
+}
+
+template<class WeightT, class SrcT, class DestT>
+void Hntr::apply_weights(
+    WeightT const *WTA, SrcT const *A, DestT *B,
+    double wtm, double wtb) const
+{
+    long const nB = weights.rowptr.size() - 1;
+    long const *rowptr = &weights.rowptr[0];
+    int const *colA = &weights.colA[0];
+    double const *FG = &weights.FG[0];
+
+    // Same summation order as RegridAccum, so results are identical.
+    // Inner loop is branch-free over contiguous arrays.
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(nthread_rows())
+#endif
+    for (long IJB=0; IJB < nB; ++IJB) {
+        double WEIGHT = 0;
+        double VALUE = 0;
+        long const k1 = rowptr[IJB+1];
+        for (long k=rowptr[IJB]; k < k1; ++k) {
+            int const IJA = colA[k];
+            double const wt = FG[k] * (wtm * WTA[IJA] + wtb);
+            WEIGHT += wt;
+            VALUE += wt * A[IJA];
+        }
+        B[IJB] = (WEIGHT == 0 ? DATMIS : VALUE / WEIGHT);
+    }
+}
+
+template<class DestT>
+void Hntr::mean_polar_fill(blitz::Array<DestT,1> &B) const
+{
+    // Replace individual values near the poles by longitudinal mean
+    for (int JB=1; JB <= Bgrid.spec.jm; JB += Bgrid.spec.jm-1)
+        mean_polar_row(B, JB);
+}
+
+template<class DestT>
+void Hntr::mean_polar_row(blitz::Array<DestT,1> &B, int JB) const
+{
+    double BMEAN  = DATMIS;
+    double WEIGHT = 0;
+    double VALUE  = 0;
+    for (int IB=1; ; ++IB) {
+        if (IB > Bgrid.spec.im) {
+            if (WEIGHT != 0) BMEAN = VALUE / WEIGHT;
+            break;
+        }
+        int IJB = IB + Bgrid.spec.im * (JB-1);
+        if (B(IJB) == DATMIS) break;
+        WEIGHT += 1;
+        VALUE  += B(IJB);
+    }
+    for (int IB=1; IB <= Bgrid.spec.im; ++IB) {
+        int IJB = IB + Bgrid.spec.im * (JB-1);
+        B(IJB) = BMEAN;
+    }
+}
+
+template<class WeightT, class SrcT, class DestT>
+void Hntr::apply_weights(
+    WeightT const *WTA,
+    std::vector<SrcT const *> const &As,
+    std::vector<DestT *> const &Bs,
+    double wtm, double wtb) const
+{
+    long const nB = weights.rowptr.size() - 1;
+    long const *rowptr = &weights.rowptr[0];
+    int const *colA = &weights.colA[0];
+    double const *FG = &weights.FG[0];
+    size_t const nfield = As.size();
+
+#ifdef USE_OPENMP
+    #pragma omp parallel num_threads(nthread_rows())
+#endif
+    {
+        std::vector<double> VALUE(nfield);
+#ifdef USE_OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for (long IJB=0; IJB < nB; ++IJB) {
             double WEIGHT = 0;
-            double VALUE  = 0;
-            for (int IB=1; ; ++IB) {
-                if (IB > Bgrid.spec.im) {
-                    if (WEIGHT != 0) BMEAN = VALUE / WEIGHT;
-                    break;
-                }
-                int IJB = IB + Bgrid.spec.im * (JB-1);
-                if (B(IJB) == DATMIS) break;
-                WEIGHT += 1;
-                VALUE  += B(IJB);
-            }
-            for (int IB=1; IB <= Bgrid.spec.im; ++IB) {
-                int IJB = IB + Bgrid.spec.im * (JB-1);
-                B(IJB) = BMEAN;
+            std::fill(VALUE.begin(), VALUE.end(), 0.);
+            long const k1 = rowptr[IJB+1];
+            for (long k=rowptr[IJB]; k < k1; ++k) {
+                int const IJA = colA[k];
+                double const wt = FG[k] * (wtm * WTA[IJA] + wtb);
+                WEIGHT += wt;
+                for (size_t i=0; i<nfield; ++i) VALUE[i] += wt * As[i][IJA];
             }
+            for (size_t i=0; i<nfield; ++i)
+                Bs[i][IJB] = (WEIGHT == 0 ? DATMIS : VALUE[i] / WEIGHT);
         }
     }
 }
 
+template<class WeightT, class SrcT, class DestT, int RANK>
+void Hntr::regrid(
+    blitz::Array<WeightT,RANK> const &_WTA,
+    std::vector<blitz::Array<SrcT,RANK>> const &_As,
+    std::vector<blitz::Array<DestT,RANK>> const &_Bs,
+    bool mean_polar,
+    double wtm, double wtb) const
+{
+    if (_As.size() != _Bs.size()) (*icebin_error)(-1,
+        "Number of source and destination fields differ: %ld vs. %ld",
+        (long)_As.size(), (long)_Bs.size());
+
+    // Reshape to 1-D
+    auto WTA(ibmisc::reshape1(_WTA, 1));
+    std::vector<blitz::Array<SrcT,1>> As;
+    std::vector<blitz::Array<DestT,1>> Bs;
+    bool contiguous = (WTA.stride(0) == 1);
+    for (size_t i=0; i<_As.size(); ++i) {
+        As.push_back(ibmisc::reshape1(_As[i], 1));
+        Bs.push_back(ibmisc::reshape1(_Bs[i], 1));
+        contiguous = contiguous && (As[i].stride(0) == 1) && (Bs[i].stride(0) == 1);
+
+        // Check array dimensions
+        if ((WTA.extent(0) != Agrid.spec.size()) ||
+            (As[i].extent(0) != Agrid.spec.size()) ||
+            (Bs[i].extent(0) != Bgrid.spec.size()))
+        {
+            (*icebin_error)(-1, "Error in dimensions of field %ld: (%d, %d, %d) vs. (%d, %d)\n",
+                (long)i, WTA.extent(0), As[i].extent(0), Bs[i].extent(0),
+                Agrid.spec.size(), Bgrid.spec.size());
+        }
+    }
+
+    if (compiled() && contiguous) {
+        std::vector<SrcT const *> Aps;
+        std::vector<DestT *> Bps;
+        for (size_t i=0; i<As.size(); ++i) {
+            Aps.push_back(As[i].data());
+            Bps.push_back(Bs[i].data());
+        }
+        apply_weights(WTA.data(), Aps, Bps, wtm, wtb);
+    } else {
+#ifdef USE_OPENMP
+        int const nJB = Bgrid.spec.jm;
+        #pragma omp parallel num_threads(nthread_rows())
+        {
+            int const ithread = omp_get_thread_num();
+            int const nt = omp_get_num_threads();
+            IncludeConst<int,true> includeB;
+            matrix_rows(
+                MultiRegridAccum<WeightT,SrcT,DestT>(WTA, As, Bs, DATMIS, wtm, wtb),
+                includeB,
+                1 + (nJB * ithread) / nt, 1 + (nJB * (ithread+1)) / nt);
+        }
+#else
+        matrix(
+            MultiRegridAccum<WeightT,SrcT,DestT>(WTA, As, Bs, DATMIS, wtm, wtb),
+            IncludeConst<int,true>());
+#endif
+    }
+
+    if (mean_polar) {
+        for (size_t i=0; i<Bs.size(); ++i) mean_polar_fill(Bs[i]);
+    }
+}
+
+template<class WeightT, class SrcT, class DestT>
+void Hntr::regrid_rows(
+    blitz::Array<WeightT,1> const &_WTA,
+    std::vector<blitz::Array<SrcT,1>> const &_As,
+    std::vector<blitz::Array<DestT,1>> const &_Bs,
+    int JB0, int JB1,
+    bool mean_polar,
+    double wtm, double wtb) const
+{
+    if (_As.size() != _Bs.size()) (*icebin_error)(-1,
+        "Number of source and destination fields differ: %ld vs. %ld",
+        (long)_As.size(), (long)_Bs.size());
+    if (JB1 <= JB0) return;
+
+    // Check that the band covers the A rows we will read
+    auto const rows(rowsA(JB0, JB1));
+    int const IJA0 = (rows[0]-1) * Agrid.spec.im + 1;
+    int const IJA1 = (rows[1]-1) * Agrid.spec.im + 1;
+    blitz::Array<WeightT,1> WTA(_WTA);    // Shallow copies
+    std::vector<blitz::Array<SrcT,1>> As(_As);
+    std::vector<blitz::Array<DestT,1>> Bs(_Bs);
+    for (size_t i=0; i<=As.size(); ++i) {
+        int const lbound = (i == As.size() ? WTA.lbound(0) : As[i].lbound(0));
+        int const ubound = (i == As.size() ? WTA.ubound(0) : As[i].ubound(0));
+        if (lbound > IJA0 || ubound < IJA1-1) (*icebin_error)(-1,
+            "Band [%d, %d] does not cover A cells [%d, %d) needed for rows [%d, %d)",
+            lbound, ubound, IJA0, IJA1, JB0, JB1);
+    }
+    for (size_t i=0; i<Bs.size(); ++i) {
+        if (Bs[i].extent(0) != Bgrid.spec.size()) (*icebin_error)(-1,
+            "Error in dimensions of field %ld: %d vs. %d\n",
+            (long)i, Bs[i].extent(0), Bgrid.spec.size());
+    }
+
+#ifdef USE_OPENMP
+    int const nJB = JB1 - JB0;
+    #pragma omp parallel num_threads(std::min(nthread_rows(), nJB))
+    {
+        int const ithread = omp_get_thread_num();
+        int const nt = omp_get_num_threads();
+        IncludeConst<int,true> includeB;
+        matrix_rows(
+            MultiRegridAccum<WeightT,SrcT,DestT>(WTA, As, Bs, DATMIS, wtm, wtb),
+            includeB,
+            JB0 + (nJB * ithread) / nt, JB0 + (nJB * (ithread+1)) / nt);
+    }
+#else
+    IncludeConst<int,true> includeB;
+    matrix_rows(
+        MultiRegridAccum<WeightT,SrcT,DestT>(WTA, As, Bs, DATMIS, wtm, wtb),
+        includeB, JB0, JB1);
+#endif
+
+    if (mean_polar) {
+        for (size_t i=0; i<Bs.size(); ++i) {
+            if (JB0 == 1) mean_polar_row(Bs[i], 1);
+            if (JB1 > Bgrid.spec.jm) mean_polar_row(Bs[i], Bgrid.spec.jm);
+        }
+    }
+}
+
+template<class WeightT, class SrcT, class DestT, int RANK>
+void Hntr::regrid(
+    blitz::Array<WeightT,RANK> const &WTA,
+    ibmisc::ArrayBundle<SrcT,RANK> const &srcs,
+    ibmisc::ArrayBundle<DestT,RANK> &dsts,
+    bool mean_polar,
+    double wtm, double wtb) const
+{
+    std::vector<blitz::Array<SrcT,RANK>> As;
+    std::vector<blitz::Array<DestT,RANK>> Bs;
+    for (auto const &src : srcs.data) {
+        As.push_back(src.arr);
+        Bs.push_back(dsts.array(src.meta.name));
+    }
+    regrid(WTA, As, Bs, mean_polar, wtm, wtb);
+}
+
 /** Creates a HntrSpec for the Atmosphere grid by halving a HntrSpec
 for the Ocean grid.  Relies on this 2-to-1 relationship of ocean to
 atmosphere in ModelE. */
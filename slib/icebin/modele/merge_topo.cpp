@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <limits>
 #include <icebin/modele/merge_topo.hpp>
 #include <icebin/modele/topo.hpp>
 #include <icebin/modele/grids.hpp>
 #include <icebin/eigen_types.hpp>
+#include <icebin/parallel.hpp>
 #include <ibmisc/linear/compressed.hpp>
 #include <ibmisc/const.hpp>
 
@@ -19,51 +21,53 @@ namespace modele {
 class GetSheetElevO {
 public:
     TmpAlloc _tmp;
-    SparseSetT dimO;    // Dense indexing used for wO and elevO
+    // Raw (scaled, not correctA) OvI
+    SparseSetT dimO;    // Dense indexing used for elev_areaO
     std::unique_ptr<ibmisc::linear::Weighted_Eigen> OvI;
-//    blitz::Array<double,1> wO;        // Ice (or land) covered area of each gridcell [m^2]
     blitz::Array<double,1> elev_areaO;     // Elevation [m] * Ice-covered Cell Area [m^2] = [m^3]
+
+    // correctA OvI; only its weights are needed
+    SparseSetT dimO_correctA;    // Dense indexing used for wO_correctA
+    std::unique_ptr<ibmisc::linear::Weighted_Eigen> OvI_correctA;
 };
 
 // ------------------------------------------------------------------------
-/** Returns elevation on ocean grid (elevO) for a single local ice sheet.
+/** Returns elevation on ocean grid (elevO) for a single local ice sheet,
+along with the (correctA) area of each ocean gridcell it covers.  Both
+OvI matrices come from one regrid_matrices() call, so they share its
+intermediate matrices.
 @param gcmO GCMRegridder
-@param paramsA Regrid parameters.
+@param paramsO_rawA Regrid parameters for elevO (scale=true, correctA=false)
+@param paramsO_correctA Regrid parameters for the areas (correctA=true)
 @param sheet_index Index of the ice sheet within gcmO for which we seek an answer.
 @param elevmaskI Combined elevation/mask for the selected ice sheet.
     =elev or NaN; for either all land, or ice-covered land, depending
     on desired result. */
 static GetSheetElevO get_sheet_elevO(
 GCMRegridder_Standard *gcmO,
-RegridParams const &paramsO,
+RegridParams const &paramsO_rawA,
+RegridParams const &paramsO_correctA,
 int sheet_index,
 blitz::Array<double,1> const &elevmaskI)
 {
     GetSheetElevO ret;
 
     size_t const nI = gcmO->nI(sheet_index);
-    size_t const nO = gcmO->nA();
 
-    // Obtain the OvI matrix
+    // Obtain the OvI matrices
     SparseSetT dimI(id_sparse_set<SparseSetT>(nI));    // dimI is same dense and sparse
     std::unique_ptr<RegridMatrices_Dynamic> rmO(
-        gcmO->regrid_matrices(sheet_index, elevmaskI, paramsO));
-    ret.OvI = rmO->matrix_d("AvI", {&ret.dimO, &dimI}, paramsO);
-
+        gcmO->regrid_matrices(sheet_index, elevmaskI, paramsO_rawA));
+    ret.OvI = rmO->matrix_d("AvI", {&ret.dimO, &dimI}, paramsO_rawA);
 
-//    // Construct elevI in dense indexing space
-//    // TODO: This isn't needed because dimI is never densified
-//    blitz::Array<double,1> elevI(dimI.dense_extent());
-//    for (size_t iI_d=0; iI_d < dimI.dense_extent(); ++iI_d) {
-//        auto iI_s = dimI.to_sparse(iI_d);
-//        elevI(iI_d) = elevmaskI(iI_s); //emI.elev(iI_s);
-//    }
+    SparseSetT dimI_correctA(id_sparse_set<SparseSetT>(nI));
+    ret.OvI_correctA = rmO->matrix_d("AvI",
+        {&ret.dimO_correctA, &dimI_correctA}, paramsO_correctA);
 
     // Dense and sparse are the same for Ice Grid
 
     // Compute elevO (or elevO * areaO, depending on paramsO.scale)
     ret.elev_areaO.reference(ret.OvI->apply(elevmaskI, NaN, false, ret._tmp));    // dense indexing, force_conservation=false
-//    ret.wO.reference(OvI->wM);
 
     return ret;
 }
@@ -112,7 +116,7 @@ std::vector<std::string> &errors)
 #if 0
 // Log inputs for debugging
 {
-    auto &indexing(gcmO->ice_regridders()[0]->agridI.indexing);
+    auto &indexing(gcmO->ice_regridder(0)->agridI.indexing);
     blitz::TinyVector<int,2> shapeI(indexing[1].extent, indexing[0].extent);
     auto emI_land2(unconst(reshape<double,1,2>(emI_lands[0], shapeI)));
     auto emI_ice2(unconst(reshape<double,1,2>(emI_ices[0], shapeI)));
@@ -188,42 +192,40 @@ std::vector<std::string> &errors)
         paramsO_correctA.scale = false;
         paramsO_correctA.correctA = true;
 
+    // Native area of each O gridcell (sparse indexing)
+    blitz::Array<double,1> native_areaO(nO);
+    native_areaO = 0.;
+    for (int iO_d=0; iO_d < gcmO->agridA->dim.dense_extent(); ++iO_d)
+        native_areaO(gcmO->agridA->dim.to_sparse(iO_d)) = gcmO->agridA->native_area(iO_d);
+
     // -------------- Compute additional area of land and ice due to local ice sheets
     for (size_t sheet_index=0; sheet_index < gcmO->ice_regridders().index.size(); ++sheet_index) {
 
         // Update from ice-only coverage
         {GetSheetElevO sheet(get_sheet_elevO(
-            gcmO, paramsO_rawA, sheet_index, emI_ices[sheet_index]));
+            gcmO, paramsO_rawA, paramsO_correctA, sheet_index, emI_ices[sheet_index]));
 
             for (size_t iO_d=0; iO_d < sheet.dimO.dense_extent(); ++iO_d) {
                 auto const iO_s = sheet.dimO.to_sparse(iO_d);
-                double const native_area = gcmO->agridA->native_area(
-                    gcmO->agridA->dim.to_dense(iO_s));
-                double const elev = sheet.elev_areaO(iO_d);
-                da_zicetopO(iO_s) += elev * native_area;
+                da_zicetopO(iO_s) += sheet.elev_areaO(iO_d) * native_areaO(iO_s);
                 mergemaskOm(iO_s) = 1;
             }
-        }
-
-        {GetSheetElevO sheet(get_sheet_elevO(
-            gcmO, paramsO_correctA, sheet_index, emI_ices[sheet_index]));
 
-            for (size_t iO_d=0; iO_d < sheet.dimO.dense_extent(); ++iO_d) {
-                auto const iO_s = sheet.dimO.to_sparse(iO_d);
-                da_giceO(iO_s) += sheet.OvI->wM(iO_d);
+            for (size_t iO_d=0; iO_d < sheet.dimO_correctA.dense_extent(); ++iO_d) {
+                auto const iO_s = sheet.dimO_correctA.to_sparse(iO_d);
+                da_giceO(iO_s) += sheet.OvI_correctA->wM(iO_d);
             }
         }
 
         // Update from ice+land coverage
         {auto &elevI(emI_lands[sheet_index]);
         GetSheetElevO sheet(get_sheet_elevO(
-            gcmO, paramsO_rawA, sheet_index, elevI));
+            gcmO, paramsO_rawA, paramsO_correctA, sheet_index, elevI));
 
             // ...update ZATMO
             for (size_t iO_d=0; iO_d < sheet.dimO.dense_extent(); ++iO_d) {
-                double const elev = sheet.elev_areaO(iO_d);
                 auto iO_s = sheet.dimO.to_sparse(iO_d);
-                da_zatmoO(iO_s) += sheet.elev_areaO(iO_d) * gcmO->agridA->native_area(gcmO->agridA->dim.to_dense(iO_s)); //sheet.OvI->wM(iO_d);
+                da_zatmoO(iO_s) += sheet.elev_areaO(iO_d) * native_areaO(iO_s); //sheet.OvI->wM(iO_d);
             }
 
             // ...update ZLAND_MIN / ZLAND_MAX based on OvI
@@ -236,15 +238,11 @@ std::vector<std::string> &errors)
                 zland_minO(iO_s) = std::min(zland_minO(iO_s), elevI(iI));
                 zland_maxO(iO_s) = std::max(zland_maxO(iO_s), elevI(iI));
             }
-        }
 
-        // Area of continent
-        {GetSheetElevO sheet(get_sheet_elevO(
-            gcmO, paramsO_correctA, sheet_index, emI_lands[sheet_index]));
-
-            for (size_t iO_d=0; iO_d < sheet.dimO.dense_extent(); ++iO_d) {
-                auto iO_s = sheet.dimO.to_sparse(iO_d);
-                da_contO(iO_s) += sheet.OvI->wM(iO_d);
+            // Area of continent
+            for (size_t iO_d=0; iO_d < sheet.dimO_correctA.dense_extent(); ++iO_d) {
+                auto iO_s = sheet.dimO_correctA.to_sparse(iO_d);
+                da_contO(iO_s) += sheet.OvI_correctA->wM(iO_d);
             }
         }
     }
@@ -252,38 +250,58 @@ std::vector<std::string> &errors)
 
     // ---------------- Update stuff based on additional land and ice area
     // Update foceanOp, and create new land cells in foceanOm as appropriate.
+    // Each gridcell is independent here.
+    double * const _foceanOp = foceanOp.data();
+    double * const _fgiceOp = fgiceOp.data();
+    double * const _zatmoOp = zatmoOp.data();
+    double * const _foceanOm = foceanOm.data();
+    double * const _flakeOm = flakeOm.data();
+    double * const _fgrndOm = fgrndOm.data();
+    double * const _fgiceOm = fgiceOm.data();
+    double * const _zatmoOm = zatmoOm.data();
+    double * const _zicetopO = zicetopO.data();
+    int16_t * const _mergemaskOm = mergemaskOm.data();
+    double const * const _da_giceO = da_giceO.data();
+    double const * const _da_zicetopO = da_zicetopO.data();
+    double const * const _da_contO = da_contO.data();
+    double const * const _da_zatmoO = da_zatmoO.data();
+    double const * const _native_areaO = native_areaO.data();
+#ifdef USE_OPENMP
+    #pragma omp parallel for simd schedule(static) num_threads(max_threads())
+#endif
     for (int iO=0; iO<nO; ++iO) {    // sparse indexing
-        if (da_contO(iO) == 0.) continue;
+        if (_da_contO[iO] == 0.) continue;
 
         // Adjust foceanOp, etc. based on how much land we're adding
-        double const by_areaO = 1. / gcmO->agridA->native_area(gcmO->agridA->dim.to_dense(iO));
-
-        double  const fgiceOp0 = fgiceOp(iO);
-        double const diff_fgiceOp = da_giceO(iO) * by_areaO;
-        if (diff_fgiceOp != 0) mergemaskOm(iO) = 1;
-        fgiceOp(iO) = fgiceOp(iO) + diff_fgiceOp;
-        foceanOp(iO) = foceanOp(iO) - da_contO(iO)*by_areaO;
-        zatmoOp(iO) += da_zatmoO(iO) * by_areaO;
-
-        if (fgiceOp(iO) != 0) {
-            double const nzicetopO = (zicetopO(iO)*fgiceOp0 + da_zicetopO(iO)*by_areaO * diff_fgiceOp) / fgiceOp(iO);
-            zicetopO(iO) = nzicetopO;
+        double const by_areaO = 1. / _native_areaO[iO];
+
+        double  const fgiceOp0 = _fgiceOp[iO];
+        double const diff_fgiceOp = _da_giceO[iO] * by_areaO;
+        if (diff_fgiceOp != 0) _mergemaskOm[iO] = 1;
+        _fgiceOp[iO] = _fgiceOp[iO] + diff_fgiceOp;
+        _foceanOp[iO] = _foceanOp[iO] - _da_contO[iO]*by_areaO;
+        _zatmoOp[iO] += _da_zatmoO[iO] * by_areaO;
+
+        if (_fgiceOp[iO] != 0) {
+            double const nzicetopO = (_zicetopO[iO]*fgiceOp0 + _da_zicetopO[iO]*by_areaO * diff_fgiceOp) / _fgiceOp[iO];
+            _zicetopO[iO] = nzicetopO;
         }
 
         // When we add more land, some cells that used to be ocean
         // might now become land.
-        if ((foceanOp(iO) < 0.5) && (foceanOm(iO) == 1.0)) {
+        if ((_foceanOp[iO] < 0.5) && (_foceanOm[iO] == 1.0)) {
             // Block repeated below
-            double const fact = 1. / (1. - foceanOp(iO));
-            foceanOm(iO) = 0.0;
-            fgiceOm(iO) = fgiceOp(iO) * fact;
-            mergemaskOm(iO) = 1;
-            fgrndOm(iO) = 1.0 - fgiceOm(iO) - flakeOm(iO);
-            zatmoOm(iO) = zatmoOp(iO) * fact;
+            double const fact = 1. / (1. - _foceanOp[iO]);
+            _foceanOm[iO] = 0.0;
+            _fgiceOm[iO] = _fgiceOp[iO] * fact;
+            _mergemaskOm[iO] = 1;
+            _fgrndOm[iO] = 1.0 - _fgiceOm[iO] - _flakeOm[iO];
+            _zatmoOm[iO] = _zatmoOp[iO] * fact;
         }
     }
 
     // Remove single-cell oceans in foceanOm (turn more stuff to land)
+    // (Serial: each cell sees its already-updated west and south neighbors)
     long const IM = gcmO->agridA->indexing[0].extent;
     long const JM = gcmO->agridA->indexing[1].extent;
     blitz::TinyVector<int,2> shape2(JM, IM);   // C-style indexing
@@ -326,6 +344,9 @@ std::vector<std::string> &errors)
     sanity_check_land_fractions(foceanOm2, flakeOm2, fgrndOm2, fgiceOm2, errors);
 
     // Convert unset zland_min and zland_max to NaN
+#ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) num_threads(max_threads())
+#endif
     for (int iO=0; iO<nO; ++iO) {
         if (!mergemaskOm(iO)) {
             zland_minO(iO) = NaN;
@@ -372,9 +393,73 @@ Indexing indexingHC_change_nhc(Indexing const &indexingHC0, int nhc)
 }
 
 
-EOpvAOpResult compute_EOpvAOp_merged(  // (generates in dense indexing)
+/** Elements of a matrix being assembled, in sparse indexing and in
+the order they were generated. */
+struct SparseElements {
+    std::vector<std::array<int,2>> indices;
+    std::vector<double> values;
+
+    void reserve(size_t n)
+    {
+        indices.reserve(n);
+        values.reserve(n);
+    }
+
+    void add(long iE, long iA, double val)
+    {
+        indices.push_back(std::array<int,2>{(int)iE, (int)iA});
+        values.push_back(val);
+    }
+};
+
+/** Converts elements to dense indexing (adding to dimEOp and dimAOp
+in order of first appearance, as SparsifyTransform::ADD_DENSE would)
+and builds the matrix from them in one counting pass.
+@param slot If set, OUT: Position of each element in M.valuePtr() */
+static EigenSparseMatrixT build_EOpvAOp(
+SparseElements const &elements,
+SparseSetT &dimEOp,
+SparseSetT &dimAOp,
+std::vector<int> *slot)
+{
+    size_t const n = elements.values.size();
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(n);
+    for (size_t k=0; k<n; ++k) {
+        auto const &ix(elements.indices[k]);
+        triplets.push_back(Eigen::Triplet<double>(
+            dimEOp.add_dense(ix[0]), dimAOp.add_dense(ix[1]),
+            elements.values[k]));
+    }
+
+    EigenSparseMatrixT M(dimEOp.dense_extent(), dimAOp.dense_extent());
+    M.setFromTriplets(triplets.begin(), triplets.end());    // Sums duplicates
+
+    if (slot) {
+        // Find where each element landed in the (compressed) matrix
+        slot->resize(n);
+        int const *outer = M.outerIndexPtr();
+        int const *inner = M.innerIndexPtr();
+        for (size_t k=0; k<n; ++k) {
+            int const col = triplets[k].col();
+            (*slot)[k] = std::lower_bound(
+                inner + outer[col], inner + outer[col+1], triplets[k].row()) - inner;
+        }
+    }
+    return M;
+}
+
+/** Body of compute_EOpvAOp_merged(), independent of how the base
+matrix is stored.
+@param EOpvAOp_base_shape0 Sparse shape of the base matrix
+@param visit_base Calls its argument on each element of the base
+    matrix (sparse indexing)
+@param nnz_base Number of elements in the base matrix, if known (or 0) */
+static EOpvAOpResult _compute_EOpvAOp_merged(  // (generates in dense indexing)
 SparseSetT &dimAOp,    // dimAOp is appended; dimEOp is returned as part of return variable.
-ibmisc::ZArray<int,double,2> const &EOpvAOp_base,    // from linear::Weighted_Compressed; UNSCALED
+std::array<long,2> const &EOpvAOp_base_shape0,
+std::function<void(UrVisitor const &)> const &visit_base,
+size_t nnz_base,
 RegridParams paramsO,
 GCMRegridder_Standard const *gcmO,     // A bunch of local ice sheets
 double const eq_rad,    // Radius of the earth
@@ -384,18 +469,17 @@ bool use_local_ice,
 std::vector<double> const &hcdefs_base, // [nhc]  Elev class definitions for base ice
 Indexing const &indexingHC_base,
 bool squash_ecs,    // Should ECs be merged if they are the same elevation?
-std::vector<std::string> &errors)
+std::vector<std::string> &errors,
+EOpvAOpPattern *pattern)
 {
     EOpvAOpResult ret;    // return variable
 
     // ======================= Create a merged EOpvAOp of base ice and ice sheets
     // (and then call through to _compute_AAmvEAm)
 
-    // Accumulator for merged EOpvAOp (unscaled)
-    MakeDenseEigenT EOpvAOp_m(
-        {SparsifyTransform::ADD_DENSE},   // convert sparse to dense indexing
-        {&ret.dimEOp, &dimAOp}, '.');
-    auto EOpvAOp_accum(EOpvAOp_m.accum());
+    // Elements of merged EOpvAOp (unscaled, sparse indexing)
+    SparseElements elements;
+    elements.reserve(nnz_base);
 
     // Merge in local matrices
     paramsO.scale = false;
@@ -410,15 +494,16 @@ std::vector<std::string> &errors)
             std::unique_ptr<ibmisc::linear::Weighted_Eigen> EOpvAOp_sheet(
                 rmO->matrix_d("EvA", {&dimEO_sheet, &dimAO_sheet}, paramsO));
             EOpvAOp_sheet_shape = EOpvAOp_sheet->shape();
+            elements.reserve(elements.values.size() + EOpvAOp_sheet->M->nonZeros() + nnz_base);
 
             // Merge it in...
             // ECs are same for local ice in merged vs. unmerged case
             // NOTE: Assumes EC dimension in indexing has largest stride
             for (auto ii(begin(*EOpvAOp_sheet->M)); ii != end(*EOpvAOp_sheet->M); ++ii) {
                 // Separate ice sheet ECs from global ECs
-                EOpvAOp_accum.add({
+                elements.add(
                     dimEO_sheet.to_sparse(ii->index(0)),
-                    dimAO_sheet.to_sparse(ii->index(1))},
+                    dimAO_sheet.to_sparse(ii->index(1)),
                     ii->value());
             }
         }
@@ -432,30 +517,55 @@ std::vector<std::string> &errors)
     std::array<long,2> EOpvAOp_base_shape {0,0};
     if (use_global_ice) {
         ret.offsetE = gcmO->indexingE.extent();
-        // Merge in global matrix (compressed format; sparse indexing)
-        EOpvAOp_base_shape = EOpvAOp_base.shape();  // sparse shape of ZArray
+        // Merge in global matrix (sparse indexing)
+        EOpvAOp_base_shape = EOpvAOp_base_shape0;
 
         // printf("EOpvAOp_base_shape = [%d %d] (NHC=%g)\n", EOpvAOp_base_shape[0], EOpvAOp_base_shape[1], (double)EOpvAOp_base_shape[0] / (double)EOpvAOp_base_shape[1]);
 
         // Copy elements to accumulator matrix
-        for (auto ii(EOpvAOp_base.generator()); ++ii; ) {
-            auto iE(ii->index(0));   // In case iE occurs more than once in M
-
+        long const offsetE = ret.offsetE;
+        visit_base([&elements, offsetE](long iE, long iA, double val) {
             // Stack global EC's on top of local EC's.
-            EOpvAOp_accum.add({ii->index(0)+ret.offsetE, ii->index(1)}, ii->value());
-        }
+            elements.add(iE+offsetE, iA, val);
+        });
         ret.hcdefs.insert(ret.hcdefs.end(), hcdefs_base.begin(), hcdefs_base.end());
         for (size_t i=0; i<hcdefs_base.size(); ++i)
             ret.underice_hc.push_back(UI_GLOBALICE);
     }
 
 
-    // Set overall size
-    ret.dimEOp.set_sparse_extent(ret.offsetE + EOpvAOp_base_shape[0]);
-    dimAOp.set_sparse_extent(EOpvAOp_base_shape[1]);
-
     // Convert to Eigen
-    ret.EOpvAOp.reset(new EigenSparseMatrixT(EOpvAOp_m.to_eigen()));
+    long const nE_sparse = ret.offsetE + EOpvAOp_base_shape[0];
+    bool const use_pattern = (pattern && dimAOp.dense_extent() == 0);
+    if (use_pattern && pattern->indices == elements.indices) {
+        // Same active ECs as last time: refill the values only
+        ret.dimEOp = pattern->dimEOp;
+        dimAOp = pattern->dimAOp;
+        ret.EOpvAOp.reset(new EigenSparseMatrixT(pattern->EOpvAOp));
+        double * const val = ret.EOpvAOp->valuePtr();
+        std::fill(val, val + ret.EOpvAOp->nonZeros(), 0.);
+        for (size_t k=0; k<elements.values.size(); ++k)
+            val[pattern->slot[k]] += elements.values[k];
+
+        ret.dimEOp.set_sparse_extent(nE_sparse);
+        dimAOp.set_sparse_extent(EOpvAOp_base_shape[1]);
+    } else {
+        std::vector<int> slot;
+        ret.EOpvAOp.reset(new EigenSparseMatrixT(build_EOpvAOp(
+            elements, ret.dimEOp, dimAOp, use_pattern ? &slot : nullptr)));
+
+        // Set overall size
+        ret.dimEOp.set_sparse_extent(nE_sparse);
+        dimAOp.set_sparse_extent(EOpvAOp_base_shape[1]);
+
+        if (use_pattern) {
+            pattern->indices = std::move(elements.indices);
+            pattern->slot = std::move(slot);
+            pattern->dimEOp = ret.dimEOp;
+            pattern->dimAOp = dimAOp;
+            pattern->EOpvAOp = *ret.EOpvAOp;
+        }
+    }
     ret.indexingHC = indexingHC_change_nhc(indexingHC_base, ret.hcdefs.size());
 
     if (squash_ecs) {
@@ -466,6 +576,53 @@ std::vector<std::string> &errors)
 }
 
 
+EOpvAOpResult compute_EOpvAOp_merged(  // (generates in dense indexing)
+SparseSetT &dimAOp,    // dimAOp is appended; dimEOp is returned as part of return variable.
+ibmisc::ZArray<int,double,2> const &EOpvAOp_base,    // from linear::Weighted_Compressed; UNSCALED
+RegridParams paramsO,
+GCMRegridder_Standard const *gcmO,     // A bunch of local ice sheets
+double const eq_rad,    // Radius of the earth
+std::vector<blitz::Array<double,1>> const &emIs,
+bool use_global_ice,
+bool use_local_ice,
+std::vector<double> const &hcdefs_base, // [nhc]  Elev class definitions for base ice
+Indexing const &indexingHC_base,
+bool squash_ecs,    // Should ECs be merged if they are the same elevation?
+std::vector<std::string> &errors,
+EOpvAOpPattern *pattern)
+{
+    return _compute_EOpvAOp_merged(dimAOp, EOpvAOp_base.shape(),
+        [&EOpvAOp_base](UrVisitor const &fn) {
+            for (auto ii(EOpvAOp_base.generator()); ++ii; )
+                fn(ii->index(0), ii->index(1), ii->value());
+        }, 0,
+        paramsO, gcmO, eq_rad, emIs, use_global_ice, use_local_ice,
+        hcdefs_base, indexingHC_base, squash_ecs, errors, pattern);
+}
+
+EOpvAOpResult compute_EOpvAOp_merged(  // (generates in dense indexing)
+SparseSetT &dimAOp,    // dimAOp is appended; dimEOp is returned as part of return variable.
+MappedCSR const &EOpvAOp_base,    // UNSCALED
+RegridParams paramsO,
+GCMRegridder_Standard const *gcmO,     // A bunch of local ice sheets
+double const eq_rad,    // Radius of the earth
+std::vector<blitz::Array<double,1>> const &emIs,
+bool use_global_ice,
+bool use_local_ice,
+std::vector<double> const &hcdefs_base, // [nhc]  Elev class definitions for base ice
+Indexing const &indexingHC_base,
+bool squash_ecs,    // Should ECs be merged if they are the same elevation?
+std::vector<std::string> &errors,
+EOpvAOpPattern *pattern)
+{
+    return _compute_EOpvAOp_merged(dimAOp, EOpvAOp_base.shape(),
+        [&EOpvAOp_base](UrVisitor const &fn) { EOpvAOp_base.visit(fn); },
+        EOpvAOp_base.nnz(),
+        paramsO, gcmO, eq_rad, emIs, use_global_ice, use_local_ice,
+        hcdefs_base, indexingHC_base, squash_ecs, errors, pattern);
+}
+
+
 /** Merges repeated ECs */
 EOpvAOpResult squash_ECs(
 std::array<SparseSetT *,2> dims0,    // const
@@ -478,49 +635,54 @@ Indexing const &indexingHC0)
     ConstUniverseT const_dims0({"dimEOp0", "dimAOp0"}, {dims0[0], dims0[1]});
 
     // Determine new set of ECs
-    std::set<double> hcdefs_set(hcdefs0.begin(), hcdefs0.end());
-    ret.hcdefs = std::vector<double>(hcdefs_set.begin(), hcdefs_set.end());  // sorted...
+    ret.hcdefs = hcdefs0;
+    std::sort(ret.hcdefs.begin(), ret.hcdefs.end());
+    ret.hcdefs.erase(std::unique(ret.hcdefs.begin(), ret.hcdefs.end()), ret.hcdefs.end());
     int const nhc = ret.hcdefs.size();
-
-    // Create a map from new HC value to new HC index
-    std::map<double,int> hcdefs_map;
-    for (int i=0; i<nhc; ++i) {
-        hcdefs_map.insert(std::make_pair(ret.hcdefs[i], i));
-        ret.underice_hc.push_back(UI_GLOBALICE);
-    }
+    ret.underice_hc.assign(nhc, UI_GLOBALICE);
 
     // Define to_new[] such that: ihc_new == to_new[ihc_old]
     std::vector<int> to_new;
+    to_new.reserve(hcdefs0.size());
     for (size_t i=0; i<hcdefs0.size(); ++i)
-        to_new.push_back(hcdefs_map[hcdefs0[i]]);
+        to_new.push_back(std::lower_bound(ret.hcdefs.begin(), ret.hcdefs.end(), hcdefs0[i])
+            - ret.hcdefs.begin());
 
     // Create indexing for for new matrix
     ret.indexingHC = indexingHC_change_nhc(indexingHC0, nhc);
 
 
-    // Re-do the sparsematrix with new ECs
-    MakeDenseEigenT EOpvAOp_m(
-        {SparsifyTransform::ADD_DENSE, SparsifyTransform::KEEP_DENSE},   // convert sparse to dense indexing
-        std::array<SparseSetT *,2>{&ret.dimEOp, dims0[1]}, '.');
-    auto EOpvAOp_accum(EOpvAOp_m.accum());
+    // Re-do the sparsematrix with new ECs.  Rows are remapped through
+    // a table indexed by old dense row, filled on first use so that
+    // ret.dimEOp gets the same dense order as SparsifyTransform::ADD_DENSE.
+    // Columns are unchanged (KEEP_DENSE).
+    std::vector<int> row1(dims0[0]->dense_extent(), -1);
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(EOpvAOp0.nonZeros());
 
     std::array<int,2> iTuple;
         int &iAO0(iTuple[0]);
         int &ihc0(iTuple[1]);
-    for (auto ii(begin(EOpvAOp0)); ii != end(EOpvAOp0); ++ii) {
-        // Convert iEO0 (in old elevation class space) to iE1 (in new)
-        int const iEO0 = dims0[0]->to_sparse(ii->index(0));
-        indexingHC0.index_to_tuple(&iTuple[0], iEO0);
-        int const ihc1 = to_new[ihc0];
-        int const iE1 = ret.indexingHC.tuple_to_index(std::array<long,2>{iAO0,ihc1});
-
-        // Separate ice sheet ECs from global ECs
-        EOpvAOp_accum.add({iE1, ii->index(1)}, ii->value());
-    }
+    for (int col=0; col < EOpvAOp0.outerSize(); ++col) {
+    for (EigenSparseMatrixT::InnerIterator ii(EOpvAOp0, col); ii; ++ii) {
+        int &iE1_d(row1[ii.row()]);
+        if (iE1_d < 0) {
+            // Convert iEO0 (in old elevation class space) to iE1 (in new)
+            int const iEO0 = dims0[0]->to_sparse(ii.row());
+            indexingHC0.index_to_tuple(&iTuple[0], iEO0);
+            int const ihc1 = to_new[ihc0];
+            int const iE1 = ret.indexingHC.tuple_to_index(std::array<long,2>{iAO0,ihc1});
+            iE1_d = ret.dimEOp.add_dense(iE1);
+        }
+        triplets.push_back(Eigen::Triplet<double>(iE1_d, col, ii.value()));
+    }}
     auto const nA = dims0[1]->sparse_extent();
     ret.dimEOp.set_sparse_extent(nA * nhc);
 
-    ret.EOpvAOp.reset(new EigenSparseMatrixT(EOpvAOp_m.to_eigen()));
+    // Merged ECs give duplicate elements; setFromTriplets() sums them
+    ret.EOpvAOp.reset(new EigenSparseMatrixT(
+        ret.dimEOp.dense_extent(), dims0[1]->dense_extent()));
+    ret.EOpvAOp->setFromTriplets(triplets.begin(), triplets.end());
 
 
     return ret;
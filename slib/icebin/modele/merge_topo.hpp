@@ -6,6 +6,8 @@
 #include <ibmisc/indexing.hpp>
 #include <icebin/RegridMatrices.hpp>
 #include <icebin/GCMRegridder.hpp>
+#include <icebin/bincsr.hpp>
+#include <icebin/parallel.hpp>
 
 /** Subroutines for merging local ice sheets into base set up based on
 global ice (eg from ETOPO1). */
@@ -69,6 +71,21 @@ struct EOpvAOpResult {
     std::vector<int16_t> underice_hc;
 };
 
+/** Sparsity pattern of the last merged EOpvAOp built by
+compute_EOpvAOp_merged().  If the next call produces the same (iE,iA)
+elements in the same order --- ie, the set of active ECs in each grid
+cell is unchanged --- the matrix structure and dimension maps are
+reused, and only the values are refilled. */
+struct EOpvAOpPattern {
+    /** Sparse (iE,iA) indices of each element, in accumulation order */
+    std::vector<std::array<int,2>> indices;
+    /** Position of each element in EOpvAOp.valuePtr() */
+    std::vector<int> slot;
+    SparseSetT dimEOp, dimAOp;
+    /** Structure to copy; values are overwritten on reuse */
+    EigenSparseMatrixT EOpvAOp;
+};
+
 
 /** Merge per-ice sheet data into a global base EOpvAOp matrix (from
 which ice sheet(s) have be removed; output of global_ec.cpp).  The
@@ -90,6 +107,8 @@ matrix is all based on un-rounded ("raw") verions of TOPO fields.
     UI_GLOBALICE for base ice
     UI_LOCALICE for local ice
 @param paramsA Regrid parmaeters that are used by command line programs (known to work)
+@param pattern If set, sparsity pattern of the previous call; reused
+    when unchanged and dimAOp is empty on entry, otherwise replaced.
 @return Merged EOpvAOp matrix.  Dense indexing, using dimension maps from dims.
 */
 EOpvAOpResult compute_EOpvAOp_merged(  // (generates in dense indexing)
@@ -104,7 +123,25 @@ bool use_local_ice,
 std::vector<double> const &hcdefs_base, // [nhc]  Elev class definitions for base ice
 ibmisc::Indexing const &indexingHC_base,
 bool squash_ecs,    // Should ECs be merged if they are the same elevation?
-std::vector<std::string> &errors);
+std::vector<std::string> &errors,
+EOpvAOpPattern *pattern = nullptr);    // Reuse / store sparsity pattern if set
+
+/** Same as above, with the base EOpvAOp matrix memory-mapped from a
+bincsr file (see bincsr.hpp) instead of read from NetCDF. */
+EOpvAOpResult compute_EOpvAOp_merged(  // (generates in dense indexing)
+SparseSetT &dimAOp,    // dimAOp is appended
+MappedCSR const &EOpvAOp_base,
+RegridParams paramsO,
+GCMRegridder_Standard const *gcmO,     // A bunch of local ice sheets
+double const eq_rad,    // Radius of the earth
+std::vector<blitz::Array<double,1>> const &emI_ices,
+bool use_global_ice,
+bool use_local_ice,
+std::vector<double> const &hcdefs_base, // [nhc]  Elev class definitions for base ice
+ibmisc::Indexing const &indexingHC_base,
+bool squash_ecs,    // Should ECs be merged if they are the same elevation?
+std::vector<std::string> &errors,
+EOpvAOpPattern *pattern = nullptr);    // Reuse / store sparsity pattern if set
 
 
 /** Merges repeated ECs */
@@ -3,6 +3,7 @@
 #include <icebin/modele/topo.hpp>
 #include <icebin/modele/hntr.hpp>
 #include <icebin/modele/grids.hpp>
+#include <icebin/fast_indexing.hpp>
 
 using namespace blitz;
 using namespace ibmisc;
@@ -117,8 +118,8 @@ public:
     blitz::Array<double,1> const &wEO_d;
     // Things obtained from gcmA
     unsigned int const nhc;    // gcmA->nhc()
-    ibmisc::Indexing const indexingHCO;    // gcmA->gcmO->indexingHC
-    ibmisc::Indexing const indexingHCA;    // gcmA->indexingHC
+    FastIndexing<2> const indexingHCO;    // gcmA->gcmO->indexingHC
+    FastIndexing<2> const indexingHCA;    // gcmA->indexingHC
 
 int n=0;
 
@@ -196,13 +197,28 @@ ibmisc::Indexing const indexingHCO,    // gcmA->gcmO->indexingHC
 ibmisc::Indexing const indexingHCA)    // gcmA->indexingHC
 {
     // Call Hntr to generate AOvAA; and use that (above) to produce EOvEA
-    Hntr hntr_AOvAA(17.17, hntrO, hntrA, 0);    // dimB=A,  dimA=O
+    auto const hntr_AOvAA(cached_hntr(17.17, hntrO, hntrA, 0));    // dimB=A,  dimA=O
 
-    hntr_AOvAA.overlap<RawEOvEA, DimClip>(
+    hntr_AOvAA->overlap<RawEOvEA, DimClip>(
         RawEOvEA(std::move(ret), wEO_d, nhc, indexingHCO, indexingHCA),
         eq_rad, DimClip(dimAO));
 }
 
+void raw_EOvEA_replay(
+MakeDenseEigenT::AccumT &&ret,        // {dimEA, dimEO}; dimEO should not change here.
+HntrBufferAccum::BufferT const &overlap_AOvAA,    // Unclipped
+SparseSetT const *dimAO,            // Used to clip overlap_AOvAA
+blitz::Array<double,1> &wEO_d,            // == EOvI.wM.  Dense indexing.
+// Things obtained from gcmA
+unsigned int const nhc,    // gcmA->nhc()
+ibmisc::Indexing const indexingHCO,    // gcmA->gcmO->indexingHC
+ibmisc::Indexing const indexingHCA)    // gcmA->indexingHC
+{
+    replay_overlap(
+        RawEOvEA(std::move(ret), wEO_d, nhc, indexingHCO, indexingHCA),
+        overlap_AOvAA, DimClip(dimAO));
+}
+
 
 // ------------------------------------------------------------------------
 /** Computes EOmvAOm, based on EOpvAOp.  EOpvAOp is converted to EOmvAOm by
@@ -283,10 +299,10 @@ std::unique_ptr<linear::Weighted_Eigen> _compute_AAmvEAm_EIGEN(
     if (!hntrA.is_set()) (*icebin_error)(-1, "hntrA must be set");
     if (!hntrO.is_set()) (*icebin_error)(-1, "hntrO must be set");
 
-    Hntr hntr_AOmvAAm(17.17, hntrO, hntrA);
+    auto const hntr_AOmvAAm(cached_hntr(17.17, hntrO, hntrA));
     EigenSparseMatrixT AAmvAOm(MakeDenseEigenT(
         std::bind(&Hntr::overlap<MakeDenseEigenT::AccumT,DimClip>,
-            &hntr_AOmvAAm, _1, eq_rad, DimClip(&dimAOm)),
+            hntr_AOmvAAm.get(), _1, eq_rad, DimClip(&dimAOm)),
         {SparsifyTransform::TO_DENSE_IGNORE_MISSING, SparsifyTransform::ADD_DENSE},
         {&dimAOm, &dimAAm}, 'T').to_eigen());
 
@@ -619,6 +635,7 @@ blitz::Array<int16_t,3> &underice3)
 {
 
     Hntr hntr_AvO(17.17, hspecA, hspecO);
+    hntr_AvO.compile();    // Used for many fields below
 
     blitz::Array<double, 2> WTO(const_array(blitz::shape(hspecO.jm,hspecO.im), 1.0));
     hntr_AvO.regrid(WTO, foceanOm2, foceanA2);
@@ -73,6 +73,18 @@ unsigned int const nhc,    // gcmA->nhc()
 ibmisc::Indexing const indexingHCO,    // gcmA->gcmO->indexingHC
 ibmisc::Indexing const indexingHCA);    // gcmA->indexingHC
 
+/** Same as raw_EOvEA(), but replays a pre-computed AOvAA overlap
+matrix (@see GCMRegridder_ModelE::overlap_AOvAA()) instead of
+running Hntr again. */
+extern void raw_EOvEA_replay(
+MakeDenseEigenT::AccumT &&ret,        // {dimEA, dimEO}; dimEO should not change here.
+HntrBufferAccum::BufferT const &overlap_AOvAA,    // Unclipped
+SparseSetT const *dimAO,            // Used to clip overlap_AOvAA
+blitz::Array<double,1> &wEO_d,            // == EOvI.wM.  Dense indexing.
+// Things obtained from gcmA
+unsigned int const nhc,    // gcmA->nhc()
+ibmisc::Indexing const indexingHCO,    // gcmA->gcmO->indexingHC
+ibmisc::Indexing const indexingHCA);    // gcmA->indexingHC
 
 
 /** Computes EOmvAOm, based on EOpvAOp.  EOpvAOp is converted to EOmvAOm by
@@ -1,5 +1,7 @@
 #include <cmath>
+#include <functional>
 #include <ibmisc/fortranio.hpp>
+#include <ibmisc/netcdf.hpp>
 #include <ibmisc/ncbulk.hpp>
 #include <icebin/error.hpp>
 #include <icebin/modele/topo_base.hpp>
@@ -14,11 +16,50 @@ namespace modele {
 
 static double const NaN = std::numeric_limits<double>::quiet_NaN();
 
+/** Latitude band of the 1-minute input fields.  Arrays are (IM1m, JM1m)
+Fortran-style, holding only 1-minute rows [J0, J1) (1-based). */
+struct Topo1mBand {
+    blitz::Array<int16_t,2> FGICE1m;
+    blitz::Array<int16_t,2> ZICETOP1m;
+    blitz::Array<int16_t,2> ZSOLG1m;
+    blitz::Array<int16_t,2> FOCEAN1m;
+};
+
+/** Returns rows [J0, J1) of the 1-minute input fields */
+typedef std::function<Topo1mBand(int J0, int J1)> ReadTopo1mFn;
+
+/** Regrids a latitude band of A fields into rows [JB0, JB1) of the
+full-size B fields, replacing polar values by their longitudinal mean.
+Uses the (possibly compiled) whole-grid regrid() if the band is the
+whole globe. */
+template<class WeightT, class SrcT>
+static void regrid_band(
+    Hntr const &hntr,
+    blitz::Array<WeightT,2> const &WTA,
+    std::vector<blitz::Array<SrcT,2>> const &As,
+    std::vector<blitz::Array<double,2>> const &Bs,
+    int JB0, int JB1)
+{
+    if (JB0 == 1 && JB1 > hntr.Bgrid.spec.jm && WTA.extent(1) == hntr.Agrid.spec.jm) {
+        hntr.regrid<WeightT,SrcT,double,2>(WTA, As, Bs, true);
+        return;
+    }
+
+    int const lbound = (WTA.lbound(1)-1) * hntr.Agrid.spec.im + 1;
+    std::vector<blitz::Array<SrcT,1>> As1;
+    std::vector<blitz::Array<double,1>> Bs1;
+    for (size_t i=0; i<As.size(); ++i) {
+        As1.push_back(reshape1(As[i], lbound));
+        Bs1.push_back(reshape1(Bs[i], 1));
+    }
+    hntr.regrid_rows(reshape1(WTA, lbound), As1, Bs1, JB0, JB1, true);
+}
+
 /** Within each 1-minute gridcell, it has a hi-res topography and a
 lake fraction.  It determines the elevation of the lake, being at the
 bottom of the gridcell. */
 static void callZ(
-    // (IM1m, JM1m)
+    // (IM1m, JM1m); only the rows inside [JB0, JB1) are used
     blitz::Array<int16_t,2> const &FGICE1m,
     blitz::Array<int16_t,2> const &FOCEAN1m,
     blitz::Array<int16_t,2> const &ZICETOP1m,
@@ -38,7 +79,10 @@ static void callZ(
     blitz::Array<double,2> &ZSGLO,
     blitz::Array<double,2> &ZLAKE,
     blitz::Array<double,2> &ZGRND,
-    blitz::Array<double,2> &ZSGHI)
+    blitz::Array<double,2> &ZSGHI,
+
+    // Rows of (IM, JM) to compute
+    int JB0, int JB1)
 {
 
     //
@@ -58,7 +102,7 @@ static void callZ(
 
     HntrGrid grid_g1mx1m(g1mx1m);
 
-    for (int J=1; J <= JM; ++J) {
+    for (int J=JB0; J < JB1; ++J) {
         int J11 = (J-1)*JM1m/JM + 1;    // 1-minute cells inside (I,J)
         int J1M = J*JM1m/JM;
         int const IMAX= (J==1 || J==JM ? 1 : IM);
@@ -260,15 +304,16 @@ std::vector<std::string> &errors)
     }}
 }
 
+/**
+@param read_1m Source of the 1-minute resolution inputs
+@param FLAKES 10-minute resolution lake fraction
+@param band_rows Number of (IM, JM) rows to compute per latitude
+    band; only the 1-minute rows under one band are held at a time.
+    0 to compute the whole globe at once. */
 static ibmisc::ArrayBundle<double,2> _make_topoO(
-    // -------- 1-minute resolution
-    blitz::Array<int16_t,2> const &FGICE1m,
-    blitz::Array<int16_t,2> const &ZICETOP1m,
-    blitz::Array<int16_t,2> const &ZSOLG1m,
-    blitz::Array<int16_t,2> const &FOCEAN1m,
-    // -------- 10-minute resolution
-    blitz::Array<double,2> const &FLAKES)
-
+    ReadTopo1mFn const &read_1m,
+    blitz::Array<double,2> const &FLAKES,
+    int band_rows)
 {
     // ----------------------- Set up output variables
     ibmisc::ArrayBundle<double,2> out;
@@ -383,23 +428,6 @@ static ibmisc::ArrayBundle<double,2> _make_topoO(
     double const TWOPI = 2. * M_PI;
     double const AREAG = 4. * M_PI;
 
-    //
-    // FOCEAN: Ocean Surface Fraction (0:1)
-    //
-    // Fractional ocean cover FOCEANF is interpolated from FOAAH2
-    blitz::Array<double, 2> WT1m(const_array(shape(IM1m, JM1m), 1.0, FortranArray<2>()));
-    Hntr hntr1q1m(17.17, g1qx1, g1mx1m);
-    hntr1q1m.regrid<double,int16_t,double>(WT1m, FOCEAN1m, FOCEANF, true);    // Fractional ocean cover
-
-    // --------- FGICE is interpolated from FGICE1m
-
-    //hntr1q1m.regrid(FOCEAN1m, FGICE1m, FGICE, true, -1.0, 1.0);    // Use FCONT1m = 1-FOCEAN1m for weight
-    // (use WT1m here for weight instead of 1-FOCEAN1m so that FOCEAN+FLAKE+FGICE = 1
-    // (instead of FOCEAN+FLAKE+FGRND=1 and FGICE is a portion of FGRND).
-    hntr1q1m.regrid(WT1m, FGICE1m, FGICEF, true);
-
-    // Here, FGRND=1-FOCEAN is implied.
-
     int8_t const TO_NONE = 0;
     int8_t const TO_OCEAN = 1;
     int8_t const TO_LAND = 2;
@@ -494,41 +522,202 @@ static ibmisc::ArrayBundle<double,2> _make_topoO(
     SET_TO(225,169) = TO_OCEAN;
 
 
-    // South pole should be all ice; avoid singularities in regridding algo.
-    for (int i=1; i<=IM; ++i) {
-        FOCEAN(i,1) = 0;
-        FGICE(i,1) = 1;
-        FGICEF(i,1) = 1;
-    }
 
+    //
+    // FLAKE: Lake Surface Fraction (0:1)
+    //
+    // FLAKE is interpolated from FLAKES
+    blitz::Array<double, 2> WTS(const_array(shape(IMS, JMS), 1.0, FortranArray<2>()));
+    Hntr hntr1q10m(17.17, g1qx1, g10mx10m);
+    hntr1q10m.regrid(WTS, FLAKES, FLAKE, true);
+
+    // Antarctica and Arctic area have no lakes
+    FLAKE(Range::all(), Range(1,JM/6)) = 0;             //  90:60 S
+    FLAKE(Range::all(), Range(JM*14/15+1,JM)) = 0;      //  78:90 N
+    FLAKE(Range(1,IM/2), Range(JM*41/45+1,JM)) = 0;  //  74:90 N, 0:180 W
+
+    // TODO: Consider a more mask-based way to identify southern Greenland
+    for (int J=(JM*5)/6; J <= (JM*11)/12; ++J) {    //  southern
+    for (int I=IM/3+1; I <= (int)(.5 + .75*IM*(J-JM*.3)/JM); ++I) {  //  Greenland
+       FLAKE(I,J) = 0;
+    }}
 
-    // FOCEAN (0 or 1) is rounded from FOCEANF
-    for (int j=2; j<=JM; ++j) {
-    for (int i=1; i<=IM; ++i) {
-        auto const foceanf(FOCEANF(i,j));
-        bool to_ocean;
-        switch(SET_TO(i,j)) {
-            case TO_OCEAN :
-                to_ocean = true;
-                break;
-            case TO_LAND :
-                to_ocean = false;
-                break;
-            default:
-                to_ocean = (foceanf >= .5);
+    // ------------------------------------------------------
+    // Everything below that needs the 1-minute inputs is local to a
+    // latitude band of rows [JB0, JB1) on the (IM, JM) grid.
+    Hntr hntr1q1m(17.17, g1qx1, g1mx1m);
+    if (band_rows <= 0 || band_rows >= JM) {
+        band_rows = JM;
+        hntr1q1m.compile();    // Used for many fields below
+    }
+    blitz::Array<double, 2> zictop(IM,JM, blitz::fortranArray);
+    blitz::Array<double, 2> zsolg(IM,JM, blitz::fortranArray);
+
+    for (int JB0=1; JB0 <= JM; JB0 += band_rows) {
+        int const JB1 = std::min(JB0 + band_rows, JM+1);
+
+        // 1-minute rows needed: by Hntr, and by callZ() (the cells inside)
+        auto const rows1m(hntr1q1m.rowsA(JB0, JB1));
+        int const J0 = std::min(rows1m[0], (JB0-1)*JM1m/JM + 1);
+        int const J1 = std::max(rows1m[1], (JB1-1)*JM1m/JM + 1);
+        if (band_rows < JM) printf("Band rows %d-%d (1-minute rows %d-%d)\n",
+            JB0, JB1-1, J0, J1-1);
+        Topo1mBand const band(read_1m(J0, J1));
+        auto const &FGICE1m(band.FGICE1m);
+        auto const &ZICETOP1m(band.ZICETOP1m);
+        auto const &ZSOLG1m(band.ZSOLG1m);
+        auto const &FOCEAN1m(band.FOCEAN1m);
+
+        //
+        // FOCEAN: Ocean Surface Fraction (0:1)
+        //
+        // Fractional ocean cover FOCEANF is interpolated from FOAAH2
+        // (Real*4 weights, as in HNTR4: a double array this size would be 1.9Gb)
+        blitz::Array<float, 2> WT1m(Range(1,IM1m), Range(J0,J1-1), fortranArray);
+        WT1m = 1.0f;
+        // Fractional ocean cover, together with...
+        // --------- FGICE is interpolated from FGICE1m
+
+        //hntr1q1m.regrid(FOCEAN1m, FGICE1m, FGICE, true, -1.0, 1.0);    // Use FCONT1m = 1-FOCEAN1m for weight
+        // (use WT1m here for weight instead of 1-FOCEAN1m so that FOCEAN+FLAKE+FGICE = 1
+        // (instead of FOCEAN+FLAKE+FGRND=1 and FGICE is a portion of FGRND).
+        regrid_band<float,int16_t>(hntr1q1m, WT1m,
+            {FOCEAN1m, FGICE1m}, {FOCEANF, FGICEF}, JB0, JB1);
+        WT1m.free();
+
+        // Here, FGRND=1-FOCEAN is implied.
+
+        // South pole should be all ice; avoid singularities in regridding algo.
+        if (JB0 == 1) {
+            for (int i=1; i<=IM; ++i) {
+                FOCEAN(i,1) = 0;
+                FGICE(i,1) = 1;
+                FGICEF(i,1) = 1;
+            }
         }
 
-        if (to_ocean) {
-            FOCEAN(i,j) = 1.;
-            FGICE(i,j) = 0;
-        } else {
-            double const fact = 1. / (1. - foceanf);
+
+        // FOCEAN (0 or 1) is rounded from FOCEANF
+        for (int j=std::max(JB0,2); j<JB1; ++j) {
+        for (int i=1; i<=IM; ++i) {
+            auto const foceanf(FOCEANF(i,j));
+            bool to_ocean;
+            switch(SET_TO(i,j)) {
+                case TO_OCEAN :
+                    to_ocean = true;
+                    break;
+                case TO_LAND :
+                    to_ocean = false;
+                    break;
+                default:
+                    to_ocean = (foceanf >= .5);
+            }
+
+            if (to_ocean) {
+                FOCEAN(i,j) = 1.;
+                FGICE(i,j) = 0;
+            } else {
+                double const fact = 1. / (1. - foceanf);
 // if (std::isnan(fact)) printf("***NaN Error: (%d %d)\n", i+1,j+1);
 //if (fact != 1) fprintf(stderr, "FACT (%d, %d): %g %g sum=%g, fact=%g\n", i,j, FGICE(i,j),  FOCEANF(i,j), FGICE(i,j)+FOCEANF(i,j), fact);
-            FOCEAN(i,j) = 0.;
-            FGICE(i,j) = FGICEF(i,j) * fact;
-        }
-    }}
+                FOCEAN(i,j) = 0.;
+                FGICE(i,j) = FGICEF(i,j) * fact;
+            }
+        }}
+
+        // Apportion FLAKE to the nonocean fraction and round to 1/256
+        for (int j=JB0; j<JB1; ++j) {
+        for (int i=1; i<=IM; ++i) {
+            double const fcont = 1. - FOCEAN(i,j);
+            double const fcontf = 1. - FOCEANF(i,j);
+
+            if (fcontf != 0.) {    // Avoid divide by 0; adding 1e-20 doesn't do much
+                // This code is from Gary Russell's original Fortran
+                FLAKE(i,j) = FLAKE(i,j)*fcont / (fcontf+1e-20);
+                // FLAKE(i,j) = round_mantissa_to(FLAKE(i,j), 8);
+                FLAKE(i,j) = std::round(FLAKE(i,j)*256.) / 256.;
+            }
+        }}
+
+        //
+        // FGICE: Glacial Ice Surface Fraction (0:1)
+        //
+
+        // Check that FGICE is between 0 and 1
+        // If FGICE+FLAKE exceeds 1, reduce FLAKE
+        for (int J=std::max(JB0,JM/6+1); J < JB1; ++J) {
+        for (int I=1; I<=IM; ++I) {
+            if (FGICE(I,J) < 0) {
+                fprintf(stderr, "210: FGICE(%d,%d) < 0: %g\n" ,I,J,FGICE(I,J));
+                FGICE(I,J) = 0;
+            }
+            if (FGICE(I,J) > 1) {
+                fprintf(stderr, "210: FGICE(%d,%d) > 1: %g\n" ,I,J,FGICE(I,J));
+                FGICE(I,J) = 1;
+            }
+            if (FLAKE(I,J)+FGICE(I,J)+FOCEAN(I,J) > 1) {
+                fprintf(stderr, "210: FGICE+FLAKE+FOCEAN (%d,%d) > 1: %g + %g + %g\n",
+                    I,J,FGICE(I,J), FLAKE(I,J),FOCEAN(I,J));
+                FLAKE(I,J) = 1. - FGICE(I,J) - FOCEAN(I,J);
+            }
+        }}
+
+        // Replace land cells without vegetation with glacial ice in Z1QX1N
+        // FGICE(35,52) = 1 - FLAKE(35,52)     4x3 Model
+
+        //
+        // FGRND: Surface Fraction of Ground (0:1)
+        //
+
+        // Check that FGRND is between 0 and 1
+        for (int j=JB0; j<JB1; ++j) {
+        for (int i=1; i<=IM; ++i) {
+            FGRND(i,j) = 1.0 - FOCEAN(i,j) - FLAKE(i,j) - FGICE(i,j);
+            if (std::abs(FGRND(i,j)) < 1.e-14) FGRND(i,j) = 0;
+            if (FGRND(i,j) < 0 || FGRND(i,j) > 1) {
+                fprintf(stderr, "Error: FGRND(%d,%d) = %g %g %g %g\n", i,j,
+                    FGRND(i,j), FOCEAN(i,j),  FLAKE(i,j), FGICE(i,j));
+            }
+        }}
+
+        //
+        // dZOCEN: Ocean Thickness (m)
+        //
+        regrid_band<int16_t,int16_t>(hntr1q1m, FOCEAN1m,
+            {ZSOLG1m}, {dZOCEN}, JB0, JB1);
+        for (int j=JB0; j<JB1; ++j) {
+        for (int i=1; i<=IM; ++i) {
+            dZOCEN(i,j) = -dZOCEN(i,j) * FOCEAN(i,j);
+
+            // Check that dZOCEN is positive
+            if (FOCEAN(i,j) == 1 && dZOCEN(i,j) <= 0) {
+                printf("Error: dZOCEN(%d,%d) <= 0 %g\n",i,j,dZOCEN(i,j));
+            }
+        }}
+
+        // Ice top and bedrock under the ice, for dZGICE below
+        regrid_band<int16_t,int16_t>(hntr1q1m, FGICE1m,
+            {ZICETOP1m, ZSOLG1m}, {zictop, zsolg}, JB0, JB1);
+
+        //
+        // ZATMO  = Atmospheric topography (m)
+        // dZLAKE = Mean lake thickness (m)
+        // ZSOLDG = Solid ground topography (m)
+        // ZICETOP = Atmospheric topography, Ice covered regions (m)
+        // ZSGLO  = Lowest value of ZICETOP1m in model cell (m)
+        // ZLAKE  = Surface lake topography (m)
+        // ZGRND  = Altitude break between ground and land ice (m)
+        // ZSGHI  = Highest value of ZICETOP1m in model cell (m)
+        //
+        Range const rowsB(JB0, JB1-1);
+        ZSOLDG(Range::all(), rowsB) = - dZOCEN(Range::all(), rowsB);  //  solid ground topography of ocean
+        ZICETOP(Range::all(), rowsB) = 0;
+        callZ(
+            FGICE1m, FOCEAN1m, ZICETOP1m, ZSOLG1m,
+            FOCEAN, FLAKE, FGRND, ZATMO, ZATMOF,
+            dZLAKE,ZSOLDG,ZICETOP,ZSGLO,ZLAKE,ZGRND,ZSGHI,
+            JB0, JB1);
+    }
 
 #if 0
     // Average non-fractional and fractional ocean covers over latitude
@@ -566,103 +755,9 @@ static ibmisc::ArrayBundle<double,2> _make_topoO(
     printf("SH: %f %f %f\n", FOFSH, FONSH, FOFSH-FONSH);
 #endif
 
-    //
-    // FLAKE: Lake Surface Fraction (0:1)
-    //
-    // FLAKE is interpolated from FLAKES
-    blitz::Array<double, 2> WTS(const_array(shape(IMS, JMS), 1.0, FortranArray<2>()));
-    Hntr hntr1q10m(17.17, g1qx1, g10mx10m);
-    hntr1q10m.regrid(WTS, FLAKES, FLAKE, true);
-
-    // Antarctica and Arctic area have no lakes
-    FLAKE(Range::all(), Range(1,JM/6)) = 0;             //  90:60 S
-    FLAKE(Range::all(), Range(JM*14/15+1,JM)) = 0;      //  78:90 N
-    FLAKE(Range(1,IM/2), Range(JM*41/45+1,JM)) = 0;  //  74:90 N, 0:180 W
-
-    // TODO: Consider a more mask-based way to identify southern Greenland
-    for (int J=(JM*5)/6; J <= (JM*11)/12; ++J) {    //  southern
-    for (int I=IM/3+1; I <= (int)(.5 + .75*IM*(J-JM*.3)/JM); ++I) {  //  Greenland
-       FLAKE(I,J) = 0;
-    }}
-
-    // Apportion FLAKE to the nonocean fraction and round to 1/256
-    for (int j=1; j<=JM; ++j) {
-    for (int i=1; i<=IM; ++i) {
-        double const fcont = 1. - FOCEAN(i,j);
-        double const fcontf = 1. - FOCEANF(i,j);
-
-        if (fcontf != 0.) {    // Avoid divide by 0; adding 1e-20 doesn't do much
-            // This code is from Gary Russell's original Fortran
-            FLAKE(i,j) = FLAKE(i,j)*fcont / (fcontf+1e-20);
-            // FLAKE(i,j) = round_mantissa_to(FLAKE(i,j), 8);
-            FLAKE(i,j) = std::round(FLAKE(i,j)*256.) / 256.;
-        }
-    }}
-
-    //
-    // FGICE: Glacial Ice Surface Fraction (0:1)
-    //
-
-    // Check that FGICE is between 0 and 1
-    // If FGICE+FLAKE exceeds 1, reduce FLAKE
-    for (int J=JM/6+1; J <= JM; ++J) {
-    for (int I=1; I<=IM; ++I) {
-        if (FGICE(I,J) < 0) {
-            fprintf(stderr, "210: FGICE(%d,%d) < 0: %g\n" ,I,J,FGICE(I,J));
-            FGICE(I,J) = 0;
-        }
-        if (FGICE(I,J) > 1) {
-            fprintf(stderr, "210: FGICE(%d,%d) > 1: %g\n" ,I,J,FGICE(I,J));
-            FGICE(I,J) = 1;
-        }
-        if (FLAKE(I,J)+FGICE(I,J)+FOCEAN(I,J) > 1) {
-            fprintf(stderr, "210: FGICE+FLAKE+FOCEAN (%d,%d) > 1: %g + %g + %g\n",
-                I,J,FGICE(I,J), FLAKE(I,J),FOCEAN(I,J));
-            FLAKE(I,J) = 1. - FGICE(I,J) - FOCEAN(I,J);
-        }
-    }}
-
-    // Replace land cells without vegetation with glacial ice in Z1QX1N
-    // FGICE(35,52) = 1 - FLAKE(35,52)     4x3 Model
-
-    //
-    // FGRND: Surface Fraction of Ground (0:1)
-    //
-
-    // Check that FGRND is between 0 and 1
-    for (int j=1; j<=JM; ++j) {
-    for (int i=1; i<=IM; ++i) {
-        FGRND(i,j) = 1.0 - FOCEAN(i,j) - FLAKE(i,j) - FGICE(i,j);
-        if (std::abs(FGRND(i,j)) < 1.e-14) FGRND(i,j) = 0;
-        if (FGRND(i,j) < 0 || FGRND(i,j) > 1) {
-            fprintf(stderr, "Error: FGRND(%d,%d) = %g %g %g %g\n", i,j,
-                FGRND(i,j), FOCEAN(i,j),  FLAKE(i,j), FGICE(i,j));
-        }
-    }}
-
-    //
-    // dZOCEN: Ocean Thickness (m)
-    //
-    hntr1q1m.regrid(FOCEAN1m, ZSOLG1m, dZOCEN, true);
-    for (int j=1; j<=JM; ++j) {
-    for (int i=1; i<=IM; ++i) {
-        dZOCEN(i,j) = -dZOCEN(i,j) * FOCEAN(i,j);
-
-        // Check that dZOCEN is positive
-        if (FOCEAN(i,j) == 1 && dZOCEN(i,j) <= 0) {
-            printf("Error: dZOCEN(%d,%d) <= 0 %g\n",i,j,dZOCEN(i,j));
-        }
-    }}
-
     //
     // dZGICE: Glacial Ice Thickness (m)
     //
-    blitz::Array<double, 2> zictop(IM,JM, blitz::fortranArray);
-    hntr1q1m.regrid(FGICE1m, ZICETOP1m, zictop, true);
-    blitz::Array<double, 2> zsolg(IM,JM, blitz::fortranArray);
-    hntr1q1m.regrid(FGICE1m, ZSOLG1m, zsolg, true);
-
-
     // RGICE = areal ratio of glacial ice to continent
     // For smaller ice caps and glaciers, dZGICH = CONSTK * RGICE^.3
     // Constant is chosen so that average value of dZGICH is 264.7 m
@@ -710,23 +805,6 @@ static ibmisc::ArrayBundle<double,2> _make_topoO(
         }}
     }
 
-    //
-    // ZATMO  = Atmospheric topography (m)
-    // dZLAKE = Mean lake thickness (m)
-    // ZSOLDG = Solid ground topography (m)
-    // ZICETOP = Atmospheric topography, Ice covered regions (m)
-    // ZSGLO  = Lowest value of ZICETOP1m in model cell (m)
-    // ZLAKE  = Surface lake topography (m)
-    // ZGRND  = Altitude break between ground and land ice (m)
-    // ZSGHI  = Highest value of ZICETOP1m in model cell (m)
-    //
-    ZSOLDG = - dZOCEN;  //  solid ground topography of ocean
-    ZICETOP = 0;
-    callZ(
-        FGICE1m, FOCEAN1m, ZICETOP1m, ZSOLG1m,
-        FOCEAN, FLAKE, FGRND, ZATMO, ZATMOF,
-        dZLAKE,ZSOLDG,ZICETOP,ZSGLO,ZLAKE,ZGRND,ZSGHI);
-
 #if 0
 This is ineffective: FOCEAN will be 0 or 1 already.
 
@@ -809,34 +887,81 @@ This is ineffective: FOCEAN will be 0 or 1 already.
 }
 // ---------------------------------------------------------------
 // ======================================================================
+/** Looks up the (fname, vname) given for a variable in a list of
+(name, fname, vname) triplets, as taken by NcBulkReader. */
+static std::array<std::string,2> find_varinput(
+    std::vector<std::string> const &varinputs,
+    std::string const &name)
+{
+    for (size_t i=0; i+2 < varinputs.size(); i += 3) {
+        if (varinputs[i] == name)
+            return std::array<std::string,2>{varinputs[i+1], varinputs[i+2]};
+    }
+    (*icebin_error)(-1, "No input file given for variable %s", name.c_str());
+}
+
+/** Reads rows [J0, J1) of a 1-minute variable, stored in NetCDF as
+(jm1m, im1m), into an (IM1m, JM1m) Fortran-style array. */
+static blitz::Array<int16_t,2> read_rows_1m(
+    NcIO &ncio, std::string const &vname, int J0, int J1)
+{
+    blitz::Array<int16_t,2> ret(Range(1,IM1m), Range(J0,J1-1), fortranArray);
+    ncio.nc->getVar(vname).getVar(
+        {(size_t)(J0-1), 0}, {(size_t)(J1-J0), (size_t)IM1m}, ret.data());
+    return ret;
+}
+
 MakeTopoO::MakeTopoO(
     FileLocator const &files,
-    std::vector<std::string> const &_varinputs)
+    std::vector<std::string> const &_varinputs,
+    int band_rows)
 : hspec(*modele::grids.at("g1qx1"))
 {
-    // -------- 1-minute resolution
-    blitz::Array<int16_t,2> FGICE1m(IM1m, JM1m, fortranArray);
-    blitz::Array<int16_t,2> ZICETOP1m(IM1m, JM1m, fortranArray);
-    blitz::Array<int16_t,2> ZSOLG1m(IM1m, JM1m, fortranArray);
-    blitz::Array<int16_t,2> FOCEAN1m(IM1m, JM1m, fortranArray);
     // -------- 10-minute resolution (Z10MX10M.nc)
     blitz::Array<double,2> FLAKES(IMS, JMS, fortranArray);
 
-
-    // Read into our variables, from user-specified locations
-    NcBulkReader(&files, _varinputs)
-        ("FGICE1m", FGICE1m)
-        ("ZICETOP1m", ZICETOP1m)
-        ("ZSOLG1m", ZSOLG1m)
-        ("FOCEAN1m", FOCEAN1m)
-        ("FLAKES", FLAKES);
+    ReadTopo1mFn read_1m;
+    if (band_rows <= 0 || band_rows >= JM) {
+        // -------- 1-minute resolution
+        Topo1mBand globe;
+        globe.FGICE1m.reference(blitz::Array<int16_t,2>(IM1m, JM1m, fortranArray));
+        globe.ZICETOP1m.reference(blitz::Array<int16_t,2>(IM1m, JM1m, fortranArray));
+        globe.ZSOLG1m.reference(blitz::Array<int16_t,2>(IM1m, JM1m, fortranArray));
+        globe.FOCEAN1m.reference(blitz::Array<int16_t,2>(IM1m, JM1m, fortranArray));
+
+        // Read into our variables, from user-specified locations
+        NcBulkReader(&files, _varinputs)
+            ("FGICE1m", globe.FGICE1m)
+            ("ZICETOP1m", globe.ZICETOP1m)
+            ("ZSOLG1m", globe.ZSOLG1m)
+            ("FOCEAN1m", globe.FOCEAN1m)
+            ("FLAKES", FLAKES);
+
+        read_1m = [globe](int J0, int J1) { return globe; };
+    } else {
+        auto const flakes(find_varinput(_varinputs, "FLAKES"));
+        NcBulkReader(&files, {"FLAKES", flakes[0], flakes[1]})
+            ("FLAKES", FLAKES);
+
+        // Read the 1-minute variables a band at a time
+        read_1m = [&files, &_varinputs](int J0, int J1) {
+            Topo1mBand band;
+            std::array<blitz::Array<int16_t,2> *,4> const vars
+                {&band.FGICE1m, &band.ZICETOP1m, &band.ZSOLG1m, &band.FOCEAN1m};
+            std::array<std::string,4> const names
+                {"FGICE1m", "ZICETOP1m", "ZSOLG1m", "FOCEAN1m"};
+            for (size_t i=0; i<vars.size(); ++i) {
+                auto const input(find_varinput(_varinputs, names[i]));
+                NcIO ncio(files.locate(input[0]), 'r');
+                vars[i]->reference(read_rows_1m(ncio, input[1], J0, J1));
+            }
+            return band;
+        };
+    }
 
 printf("FINISHED READING INPUTS\n");
 
-    bundle = _make_topoO(
-        FGICE1m, ZICETOP1m, ZSOLG1m, FOCEAN1m,
-        FLAKES);
+    bundle = _make_topoO(read_1m, FLAKES, band_rows);
 }
 
-
 }}
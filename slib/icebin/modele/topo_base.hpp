@@ -18,9 +18,13 @@ struct MakeTopoO {
     ibmisc::ArrayBundle<double,2> bundle;
     std::vector<std::string> errors;
 
+    /** @param band_rows If non-zero, read the 1-minute inputs and
+        compute the outputs this many (g1qx1) rows at a time, holding
+        only one latitude band of 1-minute data in memory. */
     MakeTopoO(
         ibmisc::FileLocator const &files,
-        std::vector<std::string> const &_varinputs);
+        std::vector<std::string> const &_varinputs,
+        int band_rows = 0);
 };
 
 
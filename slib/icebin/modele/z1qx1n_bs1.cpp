@@ -1,4 +1,7 @@
 #include <cmath>
+#include <functional>
+#include <future>
+#include <memory>
 #include <boost/filesystem.hpp>
 #include <ibmisc/fortranio.hpp>
 #include <icebin/error.hpp>
@@ -680,82 +683,15 @@ static const std::vector<ElevPoints> resets
 
 
 
-void z1qx1n_bs1(TopoInputs &in, std::string const &etopo1_fname, TopoOutputs<2> &out)
+/** Adds small ice cap and glacier data to FGICEH and dZGICH north of
+Antarctic area. */
+static void small_ice_h(TopoInputs &in)
 {
-    double const TWOPI = 2. * M_PI;
-    double const AREAG = 4. * M_PI;
-
-    // ----------- Get hi-res ice mask and elevations
-    ibmisc::ArrayBundle<int16_t,2> etopo1(read_etopo1(etopo1_fname));
-    Etopo1Ice e1ice(etopo1_ice(
-        ghxh,
-            in.FGICEH,
-        g1mx1m,
-            etopo1.array("focean"),
-            etopo1.array("zictop"),
-            etopo1.array("zsolid")));
-    etopo1.free();
-
-
-#if 1
-// ------- Test: convert what we have so far to 1-degree so we can see it.
-{
-    // ------------ Convert to 1-degree
-    Hntr hntr(17.17, g1x1, g1mx1m);
-
-    auto bundleA(elev_ice_bundle<double,2>());
-    bundleA.allocate({g1x1.im, g1x1.jm}, {"im1", "jm1"}, true, blitz::fortranArray);
-
-    struct MyAccum {
-        SparseSet<int,int> &dimI;
-        blitz::Array<double,2> &fgiceAs;
-        blitz::Array<double,2> &elevAs;
-        blitz::Array<double,1> &fgiceId;
-        blitz::Array<double,1> &elevId;	// Mas is implied; masked-out cells aren't in dimI
-        MyAccum(
-            SparseSet<int,int> &_dimI,
-            ArrayBundle<double,1> &bundleId,
-            ArrayBundle<double,2> &bundleAs)
-        :
-            dimI(_dimI),
-            fgiceId(bundleId.array("fgice")),
-            elevId(bundleId.array("elev")),
-            fgiceAs(bundleAs.array("fgice")),
-            elevAs(bundleAs.array("elev"))
-        {
-            fgiceAs = 0;
-            elevAs = 0;
-        }
-        void add(std::array<int,2> index, double val) {
-            auto const iAs = index[0];
-            auto const iIs = index[1];
-            if (!dimI.in_sparse(iIs)) return;
-
-            int const iId = dimI.to_dense(iIs);
-            fgiceAs(iAs) += val * fgiceId(iId);
-            elevAs(iAs) += val * elevId(iId);
-        }
-    };
-
-    hntr.scaled_regrid_matrix(MyAccum(e1ice.dimI, e1ice.bundle, bundleA));
-
-
-    // ------------ Store for manual checking
-    NcIO ncio("allice.nc", 'w');
-    bundleA.ncio(ncio, {}, "", "double");
-}
-return;
-#endif
-
-
-    //
-    // Add small ice cap and glacier data to FGICEH and dZGICH
-    // north of Antarctic area.
-
     blitz::Array<double, 2> WT1(const_array(blitz::shape(IM1, JM1), 1.0, FortranArray<2>()));
     Hntr hntr1h(17.17, ghxh, g1x1);
-    auto FCON1H(hntr1h.regrid(WT1, in.FCONT1));
-    auto FGIC1H(hntr1h.regrid(WT1, in.FGICE1));
+    blitz::Array<double,2> FCON1H(IMH, JMH, fortranArray);
+    blitz::Array<double,2> FGIC1H(IMH, JMH, fortranArray);
+    hntr1h.regrid<double,double,double,2>(WT1, {in.FCONT1, in.FGICE1}, {FCON1H, FGIC1H});
 
     // RGIC1H = areal ratio of glacial ice to continent
     // For smaller ice caps and glaciers, dZGICH = CONSTK * RGIC1H^.3
@@ -790,8 +726,22 @@ return;
             }
         }
     }
+}
 
+/** 2-minute fields derived from the inputs, by ice_2m() */
+struct Ice2m {
+    blitz::Array<double,2> FGICE2;
+    blitz::Array<double,2> dZGIC2;
+    blitz::Array<double,2> ZSOLD2;
+    blitz::Array<double,2> FCONT2;
+    blitz::Array<double,2> ZSOLG2;
+};
 
+/** Corrects 2-minute ETOPO2 data for Antarctic ice shelves, and
+interpolates ice data to 2 minutes.  Also updates in.FOCEN2.
+@param hntrhm2 Regrids ghxh --> g2mx2m */
+static Ice2m ice_2m(TopoInputs &in, Hntr const &hntrhm2)
+{
     // ETOPO2 treats Antarctic ice shelves as ocean.
     // When this happens ETOPO2 data are replaced with interpolated data
     // from in.FGICEH and dZGICH.  Resulting files are:
@@ -802,15 +752,22 @@ return;
     // ZSOLD2 = Solid topography (m)        (above ice)
     // ZSOLG2 = Solid ground topography (m) (beneath ice)
     //
+    Ice2m ret;
+    auto &FGICE2(ret.FGICE2);
+    auto &dZGIC2(ret.dZGIC2);
+    auto &ZSOLD2(ret.ZSOLD2);
+    auto &FCONT2(ret.FCONT2);
+    auto &ZSOLG2(ret.ZSOLG2);
+
     blitz::Array<double, 2> WTH(const_array(blitz::shape(IMH, JMH), 1.0, FortranArray<2>()));
-    Hntr hntrhm2(17.17, g2mx2m, ghxh);
-    auto FGICE2(hntrhm2.regrid(WTH, in.FGICEH));
-    auto dZGIC2(hntrhm2.regrid(in.FGICEH, in.dZGICH));
-    auto ZSOLD2(hntrhm2.regrid(in.FGICEH, in.ZSOLDH));
+    FGICE2.reference(hntrhm2.regrid(WTH, in.FGICEH));
+    dZGIC2.reference(blitz::Array<double,2>(IM2m, JM2m, fortranArray));
+    ZSOLD2.reference(blitz::Array<double,2>(IM2m, JM2m, fortranArray));
+    hntrhm2.regrid<double,double,double,2>(in.FGICEH, {in.dZGICH, in.ZSOLDH}, {dZGIC2, ZSOLD2});
 
     // North of Antarctic area: 60S to 90N
-    blitz::Array<double,2> FCONT2(IM2m, JM2m, fortranArray);
-    blitz::Array<double,2> ZSOLG2(IM2m, JM2m, fortranArray);
+    FCONT2.reference(blitz::Array<double,2>(IM2m, JM2m, fortranArray));
+    ZSOLG2.reference(blitz::Array<double,2>(IM2m, JM2m, fortranArray));
     for (int J2=JM2m/6+1; J2 <= JM2m; ++J2) {
         FCONT2(Range::all(), J2) = 1. - in.FOCEN2(Range::all(), J2);
         FGICE2(Range::all(), J2) = FGICE2(Range::all(), J2) * FCONT2(Range::all(), J2);
@@ -847,14 +804,160 @@ return;
         }
     }}
 
+    return ret;
+}
+
+/** FLAKE: Lake Surface Fraction (0:1), before it is apportioned to
+the nonocean fraction */
+static void flake_1q1(TopoInputs const &in, blitz::Array<double,2> &FLAKE)
+{
+    // FLAKE is interpolated from FLAKES
+    blitz::Array<double, 2> WTS(const_array(shape(IMS, JMS), 1.0, FortranArray<2>()));
+    Hntr hntr10m1q(17.17, g1qx1, g10mx10m);
+    hntr10m1q.regrid(WTS, in.FLAKES, FLAKE, true);
+
+    // Antarctica and Arctic area have no lakes
+    FLAKE(Range::all(), Range(1,JM/6)) = 0;             //  90:60 S
+    FLAKE(Range::all(), Range(JM*14/15+1,JM)) = 0;      //  78:90 N
+    FLAKE(Range(1,IM/2), Range(JM*41/45+1,JM)) = 0;  //  74:90 N, 0:180 W
 
+    for (int J=(JM*5)/6; J <= (JM*11)/12; ++J) {    //  southern
+    for (int I=IM/3+1; I <= (int)(.5 + .75*IM*(J-JM*.3)/JM); ++I) {  //  Greenland
+       FLAKE(I,J) = 0;
+    }}
+}
+
+void z1qx1n_bs1(TopoInputs &in, std::string const &etopo1_fname, TopoOutputs<2> &out,
+    bool concurrent)
+{
+    double const TWOPI = 2. * M_PI;
+    double const AREAG = 4. * M_PI;
+
+#ifdef ICEBIN_Z1QX1N_ALLICE
+    // ------- Test: convert the hi-res ice mask and elevations to
+    // 1-degree, and write them to allice.nc so we can see them.
+    // (Nothing below uses them yet.)
+
+    // ----------- Get hi-res ice mask and elevations
+    ibmisc::ArrayBundle<int16_t,2> etopo1(read_etopo1(etopo1_fname));
+    Etopo1Ice e1ice(etopo1_ice(
+        ghxh,
+            in.FGICEH,
+        g1mx1m,
+            etopo1.array("focean"),
+            etopo1.array("zictop"),
+            etopo1.array("zsolid")));
+    etopo1.free();
+
+{
+    // ------------ Convert to 1-degree
+    Hntr hntr(17.17, g1x1, g1mx1m);
+
+    auto bundleA(elev_ice_bundle<double,2>());
+    bundleA.allocate({g1x1.im, g1x1.jm}, {"im1", "jm1"}, true, blitz::fortranArray);
+
+    struct MyAccum {
+        SparseSet<int,int> &dimI;
+        blitz::Array<double,2> &fgiceAs;
+        blitz::Array<double,2> &elevAs;
+        blitz::Array<double,1> &fgiceId;
+        blitz::Array<double,1> &elevId;	// Mas is implied; masked-out cells aren't in dimI
+        MyAccum(
+            SparseSet<int,int> &_dimI,
+            ArrayBundle<double,1> &bundleId,
+            ArrayBundle<double,2> &bundleAs)
+        :
+            dimI(_dimI),
+            fgiceId(bundleId.array("fgice")),
+            elevId(bundleId.array("elev")),
+            fgiceAs(bundleAs.array("fgice")),
+            elevAs(bundleAs.array("elev"))
+        {
+            fgiceAs = 0;
+            elevAs = 0;
+        }
+        void add(std::array<int,2> index, double val) {
+            auto const iAs = index[0];
+            auto const iIs = index[1];
+            if (!dimI.in_sparse(iIs)) return;
+
+            int const iId = dimI.to_dense(iIs);
+            fgiceAs(iAs) += val * fgiceId(iId);
+            elevAs(iAs) += val * elevId(iId);
+        }
+    };
+
+    hntr.scaled_regrid_matrix(MyAccum(e1ice.dimI, e1ice.bundle, bundleA));
+
+
+    // ------------ Store for manual checking
+    NcIO ncio("allice.nc", 'w');
+    bundleA.ncio(ncio, {}, "", "double");
+}
+return;
+#endif
+
+
+    // The phases below form a dependency graph.  Independent phases
+    // run concurrently, sharing the read-only inputs and Hntr objects;
+    // future::get() waits for a phase and rethrows anything it threw.
+    // If !concurrent, each phase is deferred: it runs on this thread,
+    // when get() is first called on it.
     //
-    // FOCEAN: Ocean Surface Fraction (0:1)
+    //     hntrhm2 --+
+    //               +--> ice_2m() --+--> FOCENF, FGICE, dZOCEN, dZGICE --> (serial)
+    //     hntr2mq1 -----------------+                                        |
+    //     flake_1q1() -------------------------------------------------------+
     //
-    // Fractional ocean cover FOCENF is interpolated from FOAAH2
-    blitz::Array<double, 2> WT2(const_array(shape(IM2m, JM2m), 1.0, FortranArray<2>()));
-    Hntr hntr2mq1(17.17, g1qx1, g2mx2m);
-    hntr2mq1.regrid(WT2, in.FOCEN2, out.FOCENF, true);    // Fractional ocean cover
+    std::launch const launch(concurrent ? std::launch::async : std::launch::deferred);
+    auto hntr_f([launch](HntrSpec const specB, HntrSpec const specA) {
+        return std::async(launch, [specB, specA]() {
+            std::unique_ptr<Hntr> hntr(new Hntr(17.17, specB, specA));
+            hntr->compile();
+            return std::shared_ptr<Hntr const>(std::move(hntr));
+        });
+    });
+    auto hntrhm2_f(hntr_f(g2mx2m, ghxh));
+    auto hntr2mq1_f(hntr_f(g1qx1, g2mx2m));    // Used for many fields below
+    auto flake_f(std::async(launch,
+        std::bind(&flake_1q1, std::cref(in), std::ref(out.FLAKE))));
+
+    auto ice2m_f(std::async(launch, [&in, &hntrhm2_f]() {
+        small_ice_h(in);
+        return ice_2m(in, *hntrhm2_f.get());
+    }));
+
+    // Regrid 2-minute fields to 1Qx1, all at once
+    Ice2m ice2m(ice2m_f.get());
+    auto const hntr2mq1(hntr2mq1_f.get());
+    {
+        std::vector<std::future<void>> regrids;
+
+        //
+        // FOCEAN: Ocean Surface Fraction (0:1)
+        //
+        // Fractional ocean cover FOCENF is interpolated from FOAAH2
+        regrids.push_back(std::async(launch, [&]() {
+            blitz::Array<double, 2> WT2(const_array(shape(IM2m, JM2m), 1.0, FortranArray<2>()));
+            hntr2mq1->regrid(WT2, in.FOCEN2, out.FOCENF, true);    // Fractional ocean cover
+        }));
+
+        // FGICE is interpolated from FGICE2
+        regrids.push_back(std::async(launch, [&]() {
+            hntr2mq1->regrid(ice2m.FCONT2, ice2m.FGICE2, out.FGICE, true);
+        }));
+
+        // dZOCEN, dZGICE: Ocean and Glacial Ice Thickness (m)
+        regrids.push_back(std::async(launch, [&]() {
+            hntr2mq1->regrid(in.FOCEN2, ice2m.ZSOLG2, out.dZOCEN, true);
+        }));
+        regrids.push_back(std::async(launch, [&]() {
+            hntr2mq1->regrid(ice2m.FGICE2, ice2m.dZGIC2, out.dZGICE, true);
+        }));
+
+        for (auto &regrid : regrids) regrid.get();
+    }
+    flake_f.get();
 
     // FOCEAN (0 or 1) is rounded from FOCEAN
     for (int j=1; j<=JM; ++j) {
@@ -955,21 +1058,6 @@ return;
     //
     // FLAKE: Lake Surface Fraction (0:1)
     //
-    // FLAKE is interpolated from FLAKES
-    blitz::Array<double, 2> WTS(const_array(shape(IMS, JMS), 1.0, FortranArray<2>()));
-    Hntr hntr10m1q(17.17, g1qx1, g10mx10m);
-    hntr10m1q.regrid(WTS, in.FLAKES, out.FLAKE, true);
-
-    // Antarctica and Arctic area have no lakes
-    out.FLAKE(Range::all(), Range(1,JM/6)) = 0;             //  90:60 S
-    out.FLAKE(Range::all(), Range(JM*14/15+1,JM)) = 0;      //  78:90 N
-    out.FLAKE(Range(1,IM/2), Range(JM*41/45+1,JM)) = 0;  //  74:90 N, 0:180 W
-
-    for (int J=(JM*5)/6; J <= (JM*11)/12; ++J) {    //  southern
-    for (int I=IM/3+1; I <= (int)(.5 + .75*IM*(J-JM*.3)/JM); ++I) {  //  Greenland
-       out.FLAKE(I,J) = 0;
-    }}
-
     // Apportion out.FLAKE to the nonocean fraction and round to 1/256
     for (int j=1; j<=JM; ++j) {
     for (int i=1; i<=IM; ++i) {
@@ -980,8 +1068,6 @@ return;
     //
     // FGICE: Glacial Ice Surface Fraction (0:1)
     //
-    // FGICE is interpolated from FGICE2
-    hntr2mq1.regrid(FCONT2, FGICE2, out.FGICE, true);
 
     // Antarctica is entirely glacial ice, no lakes nor ground
     for (int j=1; j<=JM/6; ++j) {
@@ -1045,7 +1131,6 @@ return;
     //
     // dZOCEN: Ocean Thickness (m)
     //
-    hntr2mq1.regrid(in.FOCEN2, ZSOLG2, out.dZOCEN, true);
     for (int j=1; j<=JM; ++j) {
     for (int i=1; i<=IM; ++i) {
         out.dZOCEN(i,j) = -out.dZOCEN(i,j) * out.FOCEAN(i,j);
@@ -1059,7 +1144,6 @@ return;
     //
     // dZGICE: Glacial Ice Thickness (m)
     //
-    hntr2mq1.regrid(FGICE2, dZGIC2, out.dZGICE, true);
     for (int J=1; J<=JM; ++J) {
     for (int I=1; I<=IM; ++I) {
         if (out.FGICE(I,J) > 0) {
@@ -1080,7 +1164,7 @@ return;
     //
     out.ZSOLDG = - out.dZOCEN;  //  solid ground topography of ocean
     callZ(
-        in.FOCEN2,ZSOLD2,ZSOLG2,
+        in.FOCEN2,ice2m.ZSOLD2,ice2m.ZSOLG2,
         out.FOCEAN, out.FLAKE, out.FGRND, out.ZATMO,
         out.dZLAKE,out.ZSOLDG,out.ZSGLO,out.ZLAKE,out.ZGRND,out.ZSGHI);
 
@@ -325,7 +325,13 @@ extern void callZ(
     blitz::Array<double,2> &ZGRND,
     blitz::Array<double,2> &ZSGHI);
 
-extern void z1qx1n_bs1(TopoInputs &in, TopoOutputs<2> &out);
+/** Generates the 1Qx1 TOPO outputs from the raw inputs, which it
+modifies (so read them again before another call).
+@param etopo1_fname Only used with -DICEBIN_Z1QX1N_ALLICE
+@param concurrent Run independent phases on their own threads; the
+    outputs are the same either way. */
+extern void z1qx1n_bs1(TopoInputs &in, std::string const &etopo1_fname,
+    TopoOutputs<2> &out, bool concurrent = true);
 
 
 }}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <icebin/multivec.hpp>
 #include <icebin/error.hpp>
 
@@ -12,6 +13,21 @@ void VectorMultivec::add(long ix, double const *val, double weight)
     for (int i=0; i<nvar; ++i) vals.push_back(val[i]);
 }
 
+void VectorMultivec::append(size_t n, long const *ix, double const *val, double const *weight)
+{
+    double *dest = append_zero(n, ix, weight);
+    std::copy(val, val + n*nvar, dest);
+}
+
+double *VectorMultivec::append_zero(size_t n, long const *ix, double const *weight)
+{
+    index.insert(index.end(), ix, ix + n);
+    weights.insert(weights.end(), weight, weight + n);
+    size_t const base = vals.size();
+    vals.resize(base + n*nvar, 0.);
+    return vals.data() + base;
+}
+
 VectorMultivec concatenate(std::vector<VectorMultivec> const &vecs)
 {
     VectorMultivec ret(vecs[0].size());
@@ -52,6 +52,17 @@ public:
     void add(long ix, std::vector<double> &val, double weight)
         { add(ix, &val[0], weight); }
 
+    /** Adds n elements at once.
+    @param ix Index of each element [n]
+    @param val Values of the elements [n x nvar], row-major
+    @param weight Weight of each element [n] */
+    void append(size_t n, long const *ix, double const *val, double const *weight);
+
+    /** Adds n elements whose values are filled in by the caller.
+    @return Values of the new elements [n x nvar], row-major; zeroed.
+        Valid until the next change to this VectorMultivec. */
+    double *append_zero(size_t n, long const *ix, double const *weight);
+
     double val(int varix, long ix) const
         { return vals[ix*nvar + varix]; }
 
@@ -0,0 +1,82 @@
+#include <vector>
+#include <algorithm>
+#include <netcdf.h>
+#include <icebin/nc_layout.hpp>
+#include <icebin/error.hpp>
+
+using namespace netCDF;
+
+namespace icebin {
+
+static bool is_integer_type(nc_type type)
+{
+    switch(type) {
+        case NC_BYTE: case NC_UBYTE:
+        case NC_SHORT: case NC_USHORT:
+        case NC_INT: case NC_UINT:
+        case NC_INT64: case NC_UINT64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void NcLayout::configure(NcVar ncvar) const
+{
+    int const ncid = ncvar.getParentGroup().getId();
+    int const varid = ncvar.getId();
+
+    int format;
+    nc_inq_format(ncid, &format);
+    if (format != NC_FORMAT_NETCDF4 && format != NC_FORMAT_NETCDF4_CLASSIC) return;
+
+    std::vector<NcDim> const dims(ncvar.getDims());
+    nc_type const type = ncvar.getType().getId();
+    if (dims.size() == 0 || type == NC_CHAR || type == NC_STRING) return;
+
+    // Extents (unlimited dimensions count as 1 row each) and total size
+    bool unlimited = false;
+    std::vector<size_t> extent(dims.size());
+    size_t nbytes = ncvar.getType().getSize();
+    for (size_t k=0; k<dims.size(); ++k) {
+        unlimited = unlimited || dims[k].isUnlimited();
+        extent[k] = std::max<size_t>(1, dims[k].getSize());
+        nbytes *= extent[k];
+    }
+
+    int err;
+    if (!unlimited && nbytes < min_chunked_bytes) {
+        err = nc_def_var_chunking(ncid, varid, NC_CONTIGUOUS, nullptr);
+        if (err != NC_NOERR) (*icebin_error)(-1,
+            "Cannot set contiguous layout for %s: %s",
+            ncvar.getName().c_str(), nc_strerror(err));
+        return;
+    }
+
+    // Leading dimensions get whole rows until one chunk is about
+    // chunk_bytes; trailing dimensions are kept whole.
+    std::vector<size_t> chunk(extent);
+    size_t row_bytes = ncvar.getType().getSize();
+    for (size_t k=1; k<dims.size(); ++k) row_bytes *= extent[k];
+    for (size_t k=0; k<dims.size(); ++k) {
+        if (k > 0) row_bytes /= extent[k];
+        size_t const nrow = std::max<size_t>(1, chunk_bytes / row_bytes);
+        chunk[k] = (dims[k].isUnlimited() ? nrow : std::min(nrow, extent[k]));
+        if (nrow > 1) break;    // Later dimensions stay whole
+    }
+
+    err = nc_def_var_chunking(ncid, varid, NC_CHUNKED, &chunk[0]);
+    if (err != NC_NOERR) (*icebin_error)(-1,
+        "Cannot set chunking for %s: %s",
+        ncvar.getName().c_str(), nc_strerror(err));
+
+    int const level = (is_integer_type(type) ? deflate_index : deflate_value);
+    if (level > 0) {
+        err = nc_def_var_deflate(ncid, varid, 1, 1, std::min(level, 9));
+        if (err != NC_NOERR) (*icebin_error)(-1,
+            "Cannot set compression for %s: %s",
+            ncvar.getName().c_str(), nc_strerror(err));
+    }
+}
+
+}    // namespace icebin
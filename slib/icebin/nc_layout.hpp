@@ -0,0 +1,57 @@
+#ifndef ICEBIN_NC_LAYOUT_HPP
+#define ICEBIN_NC_LAYOUT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <netcdf>
+
+namespace icebin {
+
+/** Chunking and compression policy for the NetCDF files IceBin writes
+(grids, exchange grids, regrid matrices).  Pass configure_var() to
+NcIO, so it is applied to every variable defined through
+get_or_add_var(); or call configure() on variables defined directly.
+
+Variables are split into classes:
+  * Scalars and character data: left alone.
+  * Small fixed-size variables (under min_chunked_bytes): contiguous,
+    not compressed; chunking overhead would dominate.
+  * Everything else: chunked along the leading (cell / record)
+    dimension, in ranges of whole rows about chunk_bytes long, so a
+    contiguous range of cells can be read without decompressing the
+    whole variable.  Integer variables (indices, counts) are deflated
+    at deflate_index, floating point ones at deflate_value; both with
+    the shuffle filter.  A deflate level of 0 disables compression.
+
+Has no effect on files that are not NetCDF-4. */
+struct NcLayout {
+    /** Target uncompressed size of one chunk */
+    size_t chunk_bytes = 1024*1024;
+
+    /** Fixed-size variables smaller than this are stored contiguously */
+    size_t min_chunked_bytes = 64*1024;
+
+    /** Deflate levels (0-9; 0 = none) for integer / floating point data */
+    int deflate_index = 4;
+    int deflate_value = 4;
+
+    NcLayout() {}
+
+    /** Sets both deflate levels */
+    explicit NcLayout(int deflate)
+        : deflate_index(deflate), deflate_value(deflate) {}
+
+    /** Applies the policy to a freshly defined variable (before any
+    data are written to it). */
+    void configure(netCDF::NcVar ncvar) const;
+
+    /** Suitable for the configure_var argument of NcIO */
+    std::function<void(netCDF::NcVar)> configure_var() const
+    {
+        NcLayout const self(*this);
+        return [self](netCDF::NcVar ncvar) { self.configure(ncvar); };
+    }
+};
+
+}    // namespace icebin
+#endif    // guard
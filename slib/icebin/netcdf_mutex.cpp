@@ -0,0 +1,7 @@
+#include <icebin/netcdf_mutex.hpp>
+
+namespace icebin {
+
+std::mutex netcdf_mutex;
+
+}    // namespace icebin
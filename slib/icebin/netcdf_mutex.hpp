@@ -0,0 +1,14 @@
+#ifndef ICEBIN_NETCDF_MUTEX_HPP
+#define ICEBIN_NETCDF_MUTEX_HPP
+
+#include <mutex>
+
+namespace icebin {
+
+/** Held around NetCDF calls that may run while another thread (eg an
+AsyncWriter) is in the NetCDF library: it is not thread-safe.  Not
+recursive; and only covers IceBin's own NetCDF calls. */
+extern std::mutex netcdf_mutex;
+
+}    // namespace icebin
+#endif    // guard
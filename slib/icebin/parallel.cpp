@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <icebin/parallel.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+bool compensated_sums = false;
+
+ThreadConfig thread_config;
+
+/** CPUs this process may run on (all of them if unknown) */
+static std::vector<int> available_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t avail;
+    if (sched_getaffinity(0, sizeof(avail), &avail) == 0) {
+        for (int c=0; c<CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &avail)) cpus.push_back(c);
+    }
+#endif
+    if (cpus.size() == 0) {
+        int const ncpu = std::max(1u, std::thread::hardware_concurrency());
+        for (int c=0; c<ncpu; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+/** Reads a positive thread count from the environment (0 if not set) */
+static int getenv_nthread(char const *name)
+{
+    char const *val = getenv(name);
+    if (!val || !*val) return 0;
+    int const n = atoi(val);
+    if (n < 1) (*icebin_error)(-1,
+        "%s=%s must be a positive number of threads", name, val);
+    return n;
+}
+
+void init_threads(int node_rank, int ranks_per_node,
+    int nthread, bool pin, bool first_touch)
+{
+    std::vector<int> const cpus(available_cpus());
+    int const ncpu_node = std::max(1u, std::thread::hardware_concurrency());
+
+    // The launcher has bound this rank to a subset of the node
+    bool const bound = ((int)cpus.size() < ncpu_node);
+
+    int n = getenv_nthread("ICEBIN_NUM_THREADS");
+    if (n == 0) n = nthread;
+    if (n == 0) n = getenv_nthread("OMP_NUM_THREADS");
+    if (n == 0) n = bound ?
+        (int)cpus.size() : std::max(1, ncpu_node / std::max(1, ranks_per_node));
+
+    thread_config.nthread = n;
+    thread_config.ranks_per_node = ranks_per_node;
+    thread_config.node_rank = node_rank;
+    thread_config.pin = false;
+    thread_config.first_touch = first_touch;
+
+#if defined(USE_OPENMP) && defined(__linux__)
+    // Pin the threads of the OpenMP team, which the runtime keeps
+    // around and reuses for later regions of (at most) this size.
+    if (pin) {
+        // A bound rank starts at the beginning of its own CPUs;
+        // otherwise, ranks on a node take consecutive slices.
+        size_t const offset = bound ? 0 : (size_t)node_rank * n;
+        int npinned = 0;
+        #pragma omp parallel num_threads(n) reduction(+:npinned)
+        {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpus[(offset + omp_get_thread_num()) % cpus.size()], &one);
+            if (sched_setaffinity(0, sizeof(one), &one) == 0) ++npinned;
+        }
+        thread_config.pin = (npinned == n);
+    }
+#endif
+
+    if (node_rank == 0) {
+        printf("IceBin threads: %d per rank, %d rank(s) on node, %d CPU(s)%s%s%s\n",
+            n, ranks_per_node, ncpu_node,
+            (bound ? ", bound by launcher" : ""),
+            (thread_config.pin ? ", pinned" : ""),
+            (first_touch ? ", first-touch" : ""));
+        if ((long)n * ranks_per_node > ncpu_node) printf(
+            "WARNING: IceBin threads oversubscribe the node (%d x %d > %d)\n",
+            n, ranks_per_node, ncpu_node);
+        fflush(stdout);
+    }
+}
+
+}    // namespace icebin
@@ -0,0 +1,216 @@
+#ifndef ICEBIN_PARALLEL_HPP
+#define ICEBIN_PARALLEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <utility>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+#include <icebin/eigen_types.hpp>
+
+namespace icebin {
+
+/** Callback receiving matrix elements (row, col, value), sparse indexing */
+typedef std::function<void(long, long, double)> UrVisitor;
+
+/** Destination for matrix elements produced inside parallel_accum().
+When running serially, passes elements straight through to the
+underlying accumulator.  When running in parallel, buffers them
+(per thread) to be replayed into the accumulator later.  Can also
+pass elements to a UrVisitor, if they are not to be stored at all. */
+class UrSink {
+    MakeDenseEigenT::AccumT *accum;    // Non-null: pass through
+    UrVisitor const *visitor;          // Non-null: pass through
+
+public:
+    std::vector<std::pair<std::array<long,2>, double>> buf;
+    long nadd = 0;    // Number of elements passed through add()
+
+    UrSink(MakeDenseEigenT::AccumT *_accum) : accum(_accum), visitor(nullptr) {}
+    UrSink(UrVisitor const *_visitor) : accum(nullptr), visitor(_visitor) {}
+
+    void add(std::array<long,2> const &index, double val)
+    {
+        ++nadd;
+        if (accum) accum->add(index, val);
+        else if (visitor) (*visitor)(index[0], index[1], val);
+        else buf.push_back(std::make_pair(index, val));
+    }
+};
+
+// -----------------------------------------------------------
+/** The threads IceBin runs its parallel kernels on, per MPI rank.
+Every OpenMP region in IceBin (matrix assembly, Hntr, the vertex sort,
+concurrent ice sheets) sizes itself with max_threads(), so that
+together they never use more than the cores IceBin was given.  Set by
+init_threads(); see there for how it is configured. */
+struct ThreadConfig {
+    int nthread = 0;            // 0: not configured, run as OpenMP would
+    int ranks_per_node = 1;     // MPI ranks (in the GCM communicator) on this node
+    int node_rank = 0;          // Rank within the node
+    bool pin = false;           // Threads are pinned to cores
+    bool first_touch = false;   // Large arrays are initialized on the threads using them
+};
+extern ThreadConfig thread_config;
+
+/** Configures thread_config.  The number of threads per rank is the
+first of:
+  1. Environment variable ICEBIN_NUM_THREADS
+  2. nthread (config attribute <gcm>.info:num_threads), if > 0
+  3. Environment variable OMP_NUM_THREADS
+  4. The CPUs this rank may run on, if the MPI launcher has bound it;
+     otherwise the CPUs of the node, divided among the ranks_per_node
+     ranks on it.
+@param pin Pin each thread to its own CPU (Linux only); the CPUs of a
+    node are handed out to its ranks in order of node_rank.
+@param first_touch See first_touch_fill() */
+void init_threads(int node_rank, int ranks_per_node,
+    int nthread, bool pin, bool first_touch);
+
+/** Number of threads any IceBin parallel region may use */
+inline int max_threads()
+{
+#ifdef USE_OPENMP
+    return thread_config.nthread > 0 ? thread_config.nthread : omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/** Below this many iterations, don't bother with threads. */
+int const PARALLEL_ACCUM_MIN = 10000;
+
+/** Iterations per block in parallel_blocks().  Fixed, so that how the
+work is partitioned does not depend on the number of threads. */
+int const PARALLEL_BLOCK = 4096;
+
+/** Number of blocks parallel_blocks() divides [0,n) into */
+inline int nparallel_blocks(int n)
+    { return (n + PARALLEL_BLOCK - 1) / PARALLEL_BLOCK; }
+
+/** Runs block_fn(ib, i0, i1) for consecutive blocks [i0,i1) of
+PARALLEL_BLOCK iterations, covering [0,n); on OpenMP threads if
+parallel is set.  Callers keep one result per block ib, and combine
+them in order of ib: then any floating point reduction is done in the
+same order for any number of threads (including one), and results are
+bitwise reproducible.
+@param block_fn void(int ib, int i0, int i1); must only modify state
+    belonging to block ib. */
+template<class BlockFnT>
+void parallel_blocks(int n, bool parallel, BlockFnT const &block_fn)
+{
+    int const nblock = nparallel_blocks(n);
+#ifdef USE_OPENMP
+    if (parallel) {
+        #pragma omp parallel for schedule(dynamic,1) num_threads(max_threads())
+        for (int ib=0; ib<nblock; ++ib)
+            block_fn(ib, ib*PARALLEL_BLOCK, std::min(n, (ib+1)*PARALLEL_BLOCK));
+        return;
+    }
+#endif
+    for (int ib=0; ib<nblock; ++ib)
+        block_fn(ib, ib*PARALLEL_BLOCK, std::min(n, (ib+1)*PARALLEL_BLOCK));
+}
+
+/** Is it worth running a loop of n iterations on threads? */
+inline bool use_threads(int n)
+{
+#ifdef USE_OPENMP
+    return max_threads() > 1 && n >= PARALLEL_ACCUM_MIN;
+#else
+    return false;
+#endif
+}
+
+/** Runs cell_fn(i, sink) for i in [0,n), adding the resulting matrix
+elements to ret.  If built with OpenMP, the range is partitioned in
+fixed blocks (parallel_blocks()); each block writes into its own
+buffer; and the buffers are then replayed into ret in order of i.
+This preserves the order in which elements arrive at ret --- and
+therefore the dense indexing MakeDenseEigenT assigns, and the order
+in which it sums duplicates --- so the result is identical to a
+serial loop.
+@param cell_fn void(int i, UrSink &sink); must only modify state
+    belonging to iteration i.
+@return Number of elements added to ret */
+template<class CellFnT>
+long parallel_accum(int n, MakeDenseEigenT::AccumT &ret, CellFnT const &cell_fn)
+{
+    if (use_threads(n)) {
+        std::vector<UrSink> sinks(nparallel_blocks(n),
+            UrSink((MakeDenseEigenT::AccumT *)nullptr));
+        parallel_blocks(n, true, [&](int ib, int i0, int i1) {
+            UrSink &sink(sinks[ib]);
+            for (int i=i0; i<i1; ++i) cell_fn(i, sink);
+        });
+
+        // Merge, in original order
+        long nadd = 0;
+        for (auto &sink : sinks) {
+            nadd += sink.nadd;
+            for (auto &ii : sink.buf) ret.add(ii.first, ii.second);
+            sink.buf.clear();
+            sink.buf.shrink_to_fit();
+        }
+        return nadd;
+    }
+
+    UrSink sink(&ret);
+    for (int i=0; i<n; ++i) cell_fn(i, sink);
+    return sink.nadd;
+}
+
+/** Sets p[0..n) to val.  A new array is not yet placed in memory;
+each page goes to the NUMA node of the thread that first writes it.
+So if thread_config.first_touch, the fill is done with a static
+schedule over max_threads() threads: the same partition that later
+static loops over the array use. */
+template<class T>
+void first_touch_fill(T *p, long n, T const &val)
+{
+#ifdef USE_OPENMP
+    if (thread_config.first_touch && max_threads() > 1 && n >= PARALLEL_ACCUM_MIN) {
+        #pragma omp parallel for schedule(static) num_threads(max_threads())
+        for (long i=0; i<n; ++i) p[i] = val;
+        return;
+    }
+#endif
+    std::fill(p, p+n, val);
+}
+
+// -----------------------------------------------------------
+/** If set, long floating point sums that IceBin forms itself (eg the
+weight vectors of regrid matrices; see CompensatedSum) use compensated
+summation.  They are then nearly independent of the order of their
+terms, as well as reproducible.  Off by default, since it changes
+results in the last bits.  Set with the optional config attribute
+<gcm>.info:compensated_sums = 0|1. */
+extern bool compensated_sums;
+
+/** A sum with Neumaier's compensation: the rounding error of each
+addition is carried along and added back at the end, so the result
+is about as accurate as one rounding of the exact sum.  Must not be
+compiled with -ffast-math (or -fassociative-math). */
+struct CompensatedSum {
+    double sum = 0;
+    double c = 0;    // Accumulated rounding error
+
+    void add(double x)
+    {
+        double const t = sum + x;
+        if (std::abs(sum) >= std::abs(x)) c += (sum - t) + x;
+        else c += (x - t) + sum;
+        sum = t;
+    }
+
+    double value() const { return sum + c; }
+};
+
+}    // namespace icebin
+#endif    // guard
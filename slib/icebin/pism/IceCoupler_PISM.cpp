@@ -69,6 +69,12 @@ void IceCoupler_PISM::ncread(ibmisc::NcIO &ncio_config, std::string const &vname
     NcVar info_var(ncio_config.nc->getVar(vname_sheet + ".info"));
     get_or_put_att(info_var, 'r', "update_elevation", &update_elevation, 1);
     get_or_put_att(info_var, 'r', "output_dir", output_dir);
+    {auto info_atts(info_var.getAtts());
+    if (info_atts.find("pism_nc_stride") != info_atts.end())
+        get_or_put_att(info_var, 'r', "pism_nc_stride", &pism_nc_stride, 1);
+    if (info_atts.find("pism_nc_average") != info_atts.end())
+        get_or_put_att(info_var, 'r', "pism_nc_average", &pism_nc_average, 1);
+    }
 
     // PISM parameters, passed to PISM via command line
     NcVar pism_var(ncio_config.nc->getVar(vname_sheet + ".pism"));
@@ -419,15 +425,26 @@ printf("[%d] pism_size = %d\n", pism_rank(), pism_size());
     }
 
     // -------------- Initialize pism-out.nc
-    {
+    if (pism_nc_stride > 0) {
         boost::filesystem::path output_dir(params.output_dir);
         std::string ofname = (output_dir / "pism-out.nc").string();
 
         // Convert array from pism::IceModelVec2S* to pism::IceModelVec*
         std::vector<pism::IceModelVec const *> vecs;
         for (unsigned i=0; i<pism_ovars.size(); ++i) {
-            if (!(contract[OUTPUT][i].flags & contracts::PRIVATE))
+            if (contract[OUTPUT][i].flags & contracts::PRIVATE) continue;
+            if (!pism_nc_average) {
                 vecs.push_back(pism_ovars[i]);
+                continue;
+            }
+
+            // Write running sums (same metadata) instead of the variables
+            std::unique_ptr<pism::IceModelVec2S> sum(new pism::IceModelVec2S);
+            sum->create(pism_grid, pism_ovars[i]->get_name(), pism::WITHOUT_GHOSTS);
+            sum->metadata() = pism_ovars[i]->metadata();
+            sum->set(0.0);
+            vecs.push_back(&*sum);
+            pism_out_sums.push_back(std::move(sum));
         }
 
         pism_out_nc.reset(new pism::icebin::VecBundleWriter(
@@ -436,7 +453,7 @@ printf("[%d] pism_size = %d\n", pism_rank(), pism_size());
     }
 
     // ------------- Initialize pism-in.nc
-    {
+    if (pism_nc_stride > 0) {
         boost::filesystem::path output_dir(params.output_dir);
         std::string ofname = (output_dir / "pism-in.nc").string();
         std::vector<pism::IceModelVec const *> vecs;
@@ -450,6 +467,39 @@ printf("[%d] pism_size = %d\n", pism_rank(), pism_size());
     }
 
 
+    // ============== Decomposition
+    // I index of each grid cell this rank owns in PISM's DMDA
+    // (same ordering as iceModelVec2S_to_blitz_xy())
+    local_iI.clear();
+    for (pism::Points p(*pism_grid); p; p.next())
+        local_iI.push_back((long)p.j() * nx() + p.i());
+    local_ovalsI.reference(blitz::Array<double,2>(
+        contract[OUTPUT].size(), local_iI.size()));
+
+    // Root learns everyone's local_iI, for the bundled transfers
+    {
+        int my_nI = local_iI.size();
+        bundle_nIs.resize(pism_size());
+        MPI_Gather(&my_nI, 1, MPI_INT, bundle_nIs.data(), 1, MPI_INT, pism_root, pism_comm);
+        if (am_i_root()) {
+            bundle_displs.assign(pism_size(), 0);
+            for (int r=1; r<pism_size(); ++r)
+                bundle_displs[r] = bundle_displs[r-1] + bundle_nIs[r-1];
+            bundle_iIs.resize(bundle_displs.back() + bundle_nIs.back());
+        }
+        MPI_Gatherv(local_iI.data(), my_nI, MPI_LONG,
+            bundle_iIs.data(), bundle_nIs.data(), bundle_displs.data(), MPI_LONG,
+            pism_root, pism_comm);
+    }
+
+    if (gcm_coupler->distributed_ice) {
+        int gcm_size;
+        MPI_Comm_size(gcm_coupler->gcm_params.gcm_comm, &gcm_size);
+        if (pism_size() != gcm_size) (*icebin_error)(-1,
+            "distributed_ice requires PISM to run on all GCM ranks (%d vs. %d)",
+            pism_size(), gcm_size);
+    }
+
     // ============== Miscellaneous
     // Check that grid dimensions match
     if (icebin_specI) {
@@ -492,37 +542,32 @@ void IceCoupler_PISM::run_timestep(double time_s,
         extents0[2], extents1[2],
         extents0[3], extents1[3],
         extents0[4], extents1[4]);
-    size_t const nI = ice_ivalsI.extent(1);
 
     // Check Petsc types
     if (sizeof(double) != sizeof(PetscScalar)) {
         (*icebin_error)(-1, "PetscScalar must be same as double\n");
     }
 
+    // ---------- Will pism-in.nc and pism-out.nc get a record this step?
+    bool nc_write = false;
+    if (pism_nc_stride > 0 && ++pism_nc_step >= pism_nc_stride) {
+        nc_write = true;
+        pism_nc_step = 0;
+    }
+
     if (run_ice) {
         // ---------- Load input into PISM's PETSc arrays
         // Fill pism_ivars[i] <-- iceIvals[:,i]
         // pism_ivars are distributed (global) vectors.
+        std::vector<int> ivars;
         for (int ivar=0; ivar<contract[IceCoupler::INPUT].size(); ++ivar) {
             VarMeta const &cf(contract[IceCoupler::INPUT][ivar]);
-
-            // -------- Use
-            // NOTE: vtmp_p0_va and *vtmp_p0 have different types
-            pism::petsc::VecArray vtmp_p0_va(*vtmp_p0);
-            if (am_i_root()) {
-                blitz::Array<double,1> vtmp_b(vtmp_p0_va.get(), blitz::shape(nI), blitz::neverDeleteData);
-                for (int iI=0; iI<nI; ++iI) {
-                    vtmp_b(iI) = ice_ivalsI(ivar, iI);
-                }
-            }
-            if (!(cf.flags & contracts::PRIVATE)) {
-                IceModelVec2S *pism_var = pism_ivars[ivar];
-                pism_var->get_from_proc0(*vtmp_p0);
-            }
+            if (!(cf.flags & contracts::PRIVATE)) ivars.push_back(ivar);
         }
+        scatter_bundle(ice_ivalsI, ivars);
 
         // -------- Figure out the timestep
-        pism_in_nc->write(time_s);
+        if (nc_write) pism_in_nc->write(time_s);
 
 
         // =========== Run PISM for one coupling timestep
@@ -547,7 +592,23 @@ void IceCoupler_PISM::run_timestep(double time_s,
 
     pism_ice_model->prepare_outputs(time_s);
 
-    pism_out_nc->write(time_s);    // Writes from PISM-format variables on I grid
+    // Writes from PISM-format variables on I grid
+    if (pism_nc_average && pism_nc_stride > 0) {
+        size_t j = 0;
+        for (unsigned i=0; i<pism_ovars.size(); ++i) {
+            if (contract[OUTPUT][i].flags & contracts::PRIVATE) continue;
+            pism_out_sums[j++]->add(1.0, *pism_ovars[i]);
+        }
+    }
+    if (nc_write) {
+        if (pism_nc_average) {
+            for (auto &sum : pism_out_sums) sum->scale(1.0 / pism_nc_stride);
+            pism_out_nc->write(time_s);
+            for (auto &sum : pism_out_sums) sum->set(0.0);
+        } else {
+            pism_out_nc->write(time_s);
+        }
+    }
 
     get_state(ice_ovalsI, run_ice ? 0 : contracts::INITIAL);
 
@@ -560,6 +621,8 @@ void IceCoupler_PISM::icemodel_rsf(std::string const &fname, char rw)
 {
     // Only write restart (rsf) files here.  Restart files are read by
     // putting the right -i option on the PISM command line.
+    // PISM does its own (collective) I/O: for parallel NetCDF-4 (MPI-IO)
+    // restarts, set o_format = "netcdf4_parallel" in <sheet>.pism
     if (rw == 'w') {
         pism_ice_model->dumpToFile(fname);
     }
@@ -575,11 +638,11 @@ void IceCoupler_PISM::get_state(
 {
     printf("BEGIN IceCoupler_PISM::get_state: %ld (mask = %d)\n", pism_ovars.size(), mask);
     VarSet const &ocontract(contract[IceCoupler::OUTPUT]);
+    bool const full = full_ovalsI();
 
-    // Copy the outputs to the blitz arrays
-    int nI = ice_ovalsI.extent(1);
+    // Copy each rank's part of the outputs (no communication)
+    std::vector<int> ivars;    // Fields to gather onto root
     for (unsigned int ivar=0; ivar<pism_ovars.size(); ++ivar) {
-        blitz::Array<double,1> ice_ovalsI_ivar(nI);
         VarMeta const &cf(ocontract.data[ivar]);
         bool const priv = (cf.flags & contracts::PRIVATE);
 
@@ -590,25 +653,114 @@ void IceCoupler_PISM::get_state(
 
         printf("IceCoupler_PISM::get_state(mask=%d) copying field %s\n", mask, cf.name.c_str());
 
-        if (am_i_root()) {      // ROOT in PISM communicator
-            // Get matching input (val) and output (pism_var) variables
-            iceModelVec2S_to_blitz_xy(*pism_ovars[ivar], ice_ovalsI_ivar);    // Allocates oval2_xy if needed
-
-            // Copy to the output array
-            ice_ovalsI(ivar, blitz::Range::all()) = ice_ovalsI_ivar;
+        if (pism_ovars[ivar]) {
+            pism::IceModelVec2S const &pism_var(*pism_ovars[ivar]);
+            pism::IceModelVec::AccessList access(pism_var);
+            long k = 0;
+            for (pism::Points p(*pism_grid); p; p.next())
+                local_ovalsI(ivar, k++) = pism_var(p.i(), p.j());
         } else {
-            blitz::Array<double,2> oval2_xy;    // dummy
-            iceModelVec2S_to_blitz_xy(*pism_ovars[ivar], ice_ovalsI_ivar);
+            local_ovalsI(ivar, blitz::Range::all()) = nan;
         }
 
-        // Now send those data from the PISM root to the GCM root (MPI nodes)
-        // (DUMMY for now, just make sure PISM and GCM have the same root)
-        if (pism_root != gcm_coupler->gcm_params.gcm_root) (*icebin_error)(-1,
-            "PISM and the GCM must share the same root!");
+        // With distributed_ice, gather to root only what is needed there
+        if (full || (cf.flags & contracts::ROOT)) ivars.push_back(ivar);
     }
+
+    // Now send those data from the PISM root to the GCM root (MPI nodes)
+    // (DUMMY for now, just make sure PISM and GCM have the same root)
+    if (pism_root != gcm_coupler->gcm_params.gcm_root) (*icebin_error)(-1,
+        "PISM and the GCM must share the same root!");
+    gather_bundle(ivars, ice_ovalsI);
+
     printf("END IceCoupler_PISM::get_state\n");
 }
 
+void IceCoupler_PISM::gather_bundle(
+    std::vector<int> const &ivars,
+    blitz::Array<double,2> &valsI)    // valsI(nvar, nI)
+{
+    int const nv = ivars.size();
+    long const nlocal = local_iI.size();
+
+    // Send buffer: fields one after the other
+    bundle_local.resize(nv * nlocal);
+    for (int v=0; v<nv; ++v) {
+        for (long k=0; k<nlocal; ++k)
+            bundle_local[v*nlocal + k] = local_ovalsI(ivars[v], k);
+    }
+
+    std::vector<int> counts, displs;
+    if (am_i_root()) {
+        counts.resize(pism_size());
+        displs.resize(pism_size());
+        for (int r=0; r<pism_size(); ++r) {
+            counts[r] = nv * bundle_nIs[r];
+            displs[r] = nv * bundle_displs[r];
+        }
+        bundle_root.resize(nv * bundle_iIs.size());
+    }
+    MPI_Gatherv(bundle_local.data(), nv*nlocal, MPI_DOUBLE,
+        bundle_root.data(), counts.data(), displs.data(), MPI_DOUBLE,
+        pism_root, pism_comm);
+
+    // Root: unpack from PISM's decomposition into natural I order
+    if (am_i_root()) {
+        for (int r=0; r<pism_size(); ++r) {
+            double const *vals = &bundle_root[displs[r]];
+            long const *iIs = &bundle_iIs[bundle_displs[r]];
+            int const nr = bundle_nIs[r];
+            for (int v=0; v<nv; ++v) {
+            for (int k=0; k<nr; ++k) {
+                valsI(ivars[v], iIs[k]) = vals[v*nr + k];
+            }}
+        }
+    }
+}
+
+void IceCoupler_PISM::scatter_bundle(
+    blitz::Array<double,2> const &valsI,    // valsI(nvar, nI)
+    std::vector<int> const &ivars)
+{
+    int const nv = ivars.size();
+    long const nlocal = local_iI.size();
+
+    // Root: pack into PISM's decomposition
+    std::vector<int> counts, displs;
+    if (am_i_root()) {
+        counts.resize(pism_size());
+        displs.resize(pism_size());
+        bundle_root.resize(nv * bundle_iIs.size());
+        for (int r=0; r<pism_size(); ++r) {
+            counts[r] = nv * bundle_nIs[r];
+            displs[r] = nv * bundle_displs[r];
+
+            double *vals = &bundle_root[displs[r]];
+            long const *iIs = &bundle_iIs[bundle_displs[r]];
+            int const nr = bundle_nIs[r];
+            for (int v=0; v<nv; ++v) {
+            for (int k=0; k<nr; ++k) {
+                vals[v*nr + k] = valsI(ivars[v], iIs[k]);
+            }}
+        }
+    }
+
+    bundle_local.resize(nv * nlocal);
+    MPI_Scatterv(bundle_root.data(), counts.data(), displs.data(), MPI_DOUBLE,
+        bundle_local.data(), nv*nlocal, MPI_DOUBLE, pism_root, pism_comm);
+
+    for (int v=0; v<nv; ++v) {
+        pism::IceModelVec2S &pism_var(*pism_ivars[ivars[v]]);
+        {
+            pism::IceModelVec::AccessList access(pism_var);
+            long k = 0;
+            for (pism::Points p(*pism_grid); p; p.next())
+                pism_var(p.i(), p.j()) = bundle_local[v*nlocal + k++];
+        }
+        pism_var.update_ghosts();
+    }
+}
+
 
 // ============================================================================
 // Utility Functions...
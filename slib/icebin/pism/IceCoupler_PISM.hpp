@@ -113,6 +113,13 @@ private:
     VecScatter scatter; //!< VecScatter used to transfer data to/from processor 0.
     pism::petsc::Vec::Ptr Hp0;            //!< Resulting vector on process 0
 
+    // Bundled Scatter/Gather (all fields in one collective): number
+    // of grid cells owned by each rank, and their I indices in the
+    // order of each rank's local_iI (on root).  See gather_bundle().
+    std::vector<int> bundle_nIs, bundle_displs;
+    std::vector<long> bundle_iIs;
+    std::vector<double> bundle_local, bundle_root;    // Send/receive buffers
+
     // Corresponding PISM variable for each input field
     std::vector<pism::IceModelVec2S *> pism_ivars;
 
@@ -135,6 +142,20 @@ private:
     // NetCDF output files
     std::unique_ptr<pism::icebin::VecBundleWriter> pism_in_nc, pism_out_nc;
 
+    /** pism-in.nc and pism-out.nc get a record every pism_nc_stride
+    coupling steps (0 = not written at all).  Set with the optional
+    config attribute <sheet>.info:pism_nc_stride = <n> */
+    int pism_nc_stride = 1;
+
+    /** If set, each pism-out.nc record is the mean over the
+    pism_nc_stride coupling steps since the last one, rather than a
+    snapshot.  Set with <sheet>.info:pism_nc_average = 0|1 */
+    bool pism_nc_average = false;
+
+    int pism_nc_step = 0;    // Coupling steps since the last record
+    // Running sums for pism_nc_average; these are what pism_out_nc writes
+    std::vector<std::unique_ptr<pism::IceModelVec2S>> pism_out_sums;
+
     // ------------------------
 public:
     /* Called by:
@@ -202,6 +223,18 @@ protected:
         blitz::Array<double,2> &ice_ovalsI,    // ice_ovalsI(nI, nvar)
         unsigned int mask);
 
+    /** Gathers fields ivars of local_ovalsI onto valsI on root, in
+    one collective.
+    @param valsI valsI(nvar, nI); only rows ivars are set */
+    void gather_bundle(
+        std::vector<int> const &ivars,
+        blitz::Array<double,2> &valsI);
+
+    /** Sets pism_ivars[ivars] from valsI on root, in one collective */
+    void scatter_bundle(
+        blitz::Array<double,2> const &valsI,
+        std::vector<int> const &ivars);
+
     // ===================================================================
     // Utility functions...
 
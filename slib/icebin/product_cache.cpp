@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <icebin/product_cache.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+
+bool ProductCache::Pattern::matches(EigenSparseMatrixT const &M) const
+{
+    if (M.rows() != rows || M.cols() != cols) return false;
+    if ((size_t)M.nonZeros() != inner.size()) return false;
+    return std::equal(outer.begin(), outer.end(), M.outerIndexPtr())
+        && std::equal(inner.begin(), inner.end(), M.innerIndexPtr());
+}
+
+void ProductCache::Pattern::assign(EigenSparseMatrixT const &M)
+{
+    rows = M.rows();
+    cols = M.cols();
+    outer.assign(M.outerIndexPtr(), M.outerIndexPtr() + M.outerSize() + 1);
+    inner.assign(M.innerIndexPtr(), M.innerIndexPtr() + M.nonZeros());
+}
+
+/** Finds the pattern of C=A*B, and where each scalar product goes in it */
+static void symbolic_product(
+    EigenSparseMatrixT const &A, EigenSparseMatrixT const &B,
+    ProductCache::Pattern &C, std::vector<int> &iC)
+{
+    auto const *Aouter(A.outerIndexPtr());
+    auto const *Ainner(A.innerIndexPtr());
+    auto const *Bouter(B.outerIndexPtr());
+    auto const *Binner(B.innerIndexPtr());
+
+    C.rows = A.rows();
+    C.cols = B.cols();
+    C.outer.clear();
+    C.inner.clear();
+    iC.clear();
+
+    // where[i] = Position of C(i,j) in C.inner; -1 if not (yet) in column j
+    std::vector<int> where(A.rows(), -1);
+    std::vector<int> rows;
+    C.outer.push_back(0);
+    for (int j=0; j<B.cols(); ++j) {
+        // Rows of column j, in order
+        rows.clear();
+        for (int p=Bouter[j]; p<Bouter[j+1]; ++p) {
+            int const k = Binner[p];
+            for (int q=Aouter[k]; q<Aouter[k+1]; ++q) {
+                int const i = Ainner[q];
+                if (where[i] == -1) {
+                    where[i] = 0;
+                    rows.push_back(i);
+                }
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+        for (int i : rows) {
+            where[i] = C.inner.size();
+            C.inner.push_back(i);
+        }
+
+        for (int p=Bouter[j]; p<Bouter[j+1]; ++p) {
+            int const k = Binner[p];
+            for (int q=Aouter[k]; q<Aouter[k+1]; ++q) iC.push_back(where[Ainner[q]]);
+        }
+
+        for (int i : rows) where[i] = -1;
+        C.outer.push_back(C.inner.size());
+    }
+}
+
+EigenSparseMatrixT cached_product(
+    ProductCache *cache, std::string const &key,
+    EigenSparseMatrixT const &A, EigenSparseMatrixT const &B)
+{
+    if (!cache) return A * B;
+
+    if (A.cols() != B.rows()) (*icebin_error)(-1,
+        "cached_product(%s): Cannot multiply [%ld x %ld] by [%ld x %ld]",
+        key.c_str(), (long)A.rows(), (long)A.cols(), (long)B.rows(), (long)B.cols());
+
+    // Patterns are only defined for compressed matrices
+    if (!A.isCompressed()) {
+        EigenSparseMatrixT Ac(A);
+        Ac.makeCompressed();
+        return cached_product(cache, key, Ac, B);
+    }
+    if (!B.isCompressed()) {
+        EigenSparseMatrixT Bc(B);
+        Bc.makeCompressed();
+        return cached_product(cache, key, A, Bc);
+    }
+
+    ProductCache::Entry &entry(cache->entry(key));
+    std::lock_guard<std::mutex> lock(entry.mutex);
+
+    bool const reuse = entry.A.matches(A) && entry.B.matches(B);
+    if (!reuse) {
+        entry.A.assign(A);
+        entry.B.assign(B);
+        symbolic_product(A, B, entry.C, entry.iC);
+    }
+    {
+        std::lock_guard<std::mutex> stats_lock(cache->mutex);
+        ++(reuse ? cache->nreused : cache->nrebuilt);
+    }
+
+    // Allocate the result with the known pattern
+    ProductCache::Pattern const &C(entry.C);
+    EigenSparseMatrixT ret(C.rows, C.cols);
+    ret.resizeNonZeros(C.inner.size());
+    std::copy(C.outer.begin(), C.outer.end(), ret.outerIndexPtr());
+    std::copy(C.inner.begin(), C.inner.end(), ret.innerIndexPtr());
+
+    // Numeric product
+    auto const *Aouter(A.outerIndexPtr());
+    auto const *Aval(A.valuePtr());
+    auto const *Bouter(B.outerIndexPtr());
+    auto const *Binner(B.innerIndexPtr());
+    auto const *Bval(B.valuePtr());
+    auto *Cval(ret.valuePtr());
+    std::fill(Cval, Cval + C.inner.size(), 0.);
+
+    int const *iC = entry.iC.data();
+    for (int j=0; j<B.cols(); ++j) {
+        for (int p=Bouter[j]; p<Bouter[j+1]; ++p) {
+            double const Bkj = Bval[p];
+            int const k = Binner[p];
+            for (int q=Aouter[k]; q<Aouter[k+1]; ++q) Cval[*iC++] += Aval[q] * Bkj;
+        }
+    }
+
+    return ret;
+}
+
+}    // namespace icebin
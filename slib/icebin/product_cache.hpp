@@ -0,0 +1,74 @@
+#ifndef ICEBIN_PRODUCT_CACHE_HPP
+#define ICEBIN_PRODUCT_CACHE_HPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <icebin/eigen_types.hpp>
+
+namespace icebin {
+
+/** Symbolic structure of sparse x sparse products from previous
+coupling steps.  Between steps, the sparsity pattern of the factors
+(eg IvAp and sApvA in compute_IvAE()) is usually unchanged, and only
+their values differ.  In that case the product is recomputed
+numerically only, without discovering and allocating its pattern
+again.  Patterns are compared exactly, so the result is always the
+same as if computed from scratch. */
+class ProductCache {
+public:
+    /** Pattern of a compressed column-major sparse matrix */
+    struct Pattern {
+        long rows = -1, cols = -1;
+        std::vector<int> outer;    // [cols+1]
+        std::vector<int> inner;    // [nnz]
+
+        bool matches(EigenSparseMatrixT const &M) const;
+        void assign(EigenSparseMatrixT const &M);
+    };
+
+    struct Entry {
+        /** Held while this entry is being used or updated */
+        std::mutex mutex;
+        Pattern A, B;    // Factors, as last seen
+        Pattern C;       // Their product
+        /** Position in C.values of each scalar product
+        A(i,k)*B(k,j), in order of traversal (j, then k, then i) */
+        std::vector<int> iC;
+    };
+
+    /** Entries keyed on a name for each product (eg "EvA:EpvG*GvAp") */
+    std::map<std::string, Entry> entries;
+
+    /** Protects entries (but not their contents) and the statistics */
+    std::mutex mutex;
+
+    // Statistics
+    long nreused = 0;
+    long nrebuilt = 0;
+
+    /** Looks up (or creates) an entry.  Lock Entry::mutex before using it. */
+    Entry &entry(std::string const &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries[key];
+    }
+
+    /** Removes all entries.  Not to be called while they are in use. */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+};
+
+/** Computes A*B, re-using the symbolic structure stored under key in
+cache, if A and B have the same patterns as last time.
+@param cache If null, just returns A*B */
+extern EigenSparseMatrixT cached_product(
+    ProductCache *cache, std::string const &key,
+    EigenSparseMatrixT const &A, EigenSparseMatrixT const &B);
+
+}    // namespace icebin
+#endif    // guard
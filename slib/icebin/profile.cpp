@@ -0,0 +1,243 @@
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <icebin/profile.hpp>
+#include <icebin/error.hpp>
+
+namespace icebin {
+namespace profile {
+
+bool enabled = true;
+bool verbose = false;
+std::map<std::string, PhaseStats> phases;
+StepMemory step_memory;
+
+static std::mutex phases_mutex;
+
+/** Innermost open scope on this thread */
+static thread_local Scope *current = nullptr;
+
+Scope::Scope(char const *_name)
+    : name(_name), parent(current), running(enabled)
+{
+    if (!running) return;
+    current = this;
+    rss0 = current_rss();
+    t0 = std::chrono::steady_clock::now();
+}
+
+void Scope::stop()
+{
+    if (!running) return;
+    running = false;
+
+    auto const t1(std::chrono::steady_clock::now());
+    double const dt = std::chrono::duration<double>(t1 - t0).count();
+    long const rss1 = current_rss();
+    current = parent;
+    rss_max = std::max(rss_max, rss1);
+    if (parent) parent->rss_max = std::max(parent->rss_max, rss_max);    // Inclusive
+
+    std::lock_guard<std::mutex> lock(phases_mutex);
+    PhaseStats &stats(phases[name]);
+    ++stats.ncall;
+    stats.wall_s += dt;
+    stats.nnz += nnz;
+    stats.nbytes += nbytes;
+    stats.rss_max = std::max(stats.rss_max, rss_max);
+    stats.rss_growth = std::max(stats.rss_growth, rss_max - rss0);
+    for (auto const &ii : held) {
+        long &h(stats.held[ii.first]);
+        h = std::max(h, ii.second);
+    }
+    note_peak(rss1);
+}
+
+void Scope::note_peak(long rss)
+{
+    // New high for the step: blame it on this phase, and on what
+    // this and the enclosing scopes hold.
+    if (rss <= step_memory.rss_peak) return;
+    step_memory.rss_peak = rss;
+    step_memory.peak_phase = name;
+    step_memory.held.clear();
+    for (Scope *sc = this; sc; sc = sc->parent) {
+        for (auto const &ii : sc->held) step_memory.held[ii.first] += ii.second;
+    }
+}
+
+void add_nnz(long n)
+    { if (current) current->nnz += n; }
+
+void add_bytes(long n)
+    { if (current) current->nbytes += n; }
+
+void add_held(char const *what, long n)
+{
+    if (!current) return;
+    current->held[what] += n;
+
+    // The structure is live now: a good time to sample
+    long const rss = current_rss();
+    current->rss_max = std::max(current->rss_max, rss);
+    std::lock_guard<std::mutex> lock(phases_mutex);
+    current->note_peak(rss);
+}
+
+/** Reads one "<key>: <n> kB" line of /proc/self/status [bytes]; -1 if absent */
+static long proc_status_kb(char const *key)
+{
+    FILE *fin = fopen("/proc/self/status", "r");
+    if (!fin) return -1;
+    size_t const len = strlen(key);
+    char line[256];
+    long ret = -1;
+    while (fgets(line, sizeof(line), fin)) {
+        if (strncmp(line, key, len) == 0 && line[len] == ':') {
+            ret = atol(line + len + 1) * 1024;
+            break;
+        }
+    }
+    fclose(fin);
+    return ret;
+}
+
+/** ru_maxrss, in bytes */
+static long rusage_maxrss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;    // Already bytes
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+}
+
+long current_rss()
+{
+    FILE *fin = fopen("/proc/self/statm", "r");
+    if (!fin) return rusage_maxrss();    // Best we can do without /proc
+    long size, resident = 0;
+    if (fscanf(fin, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(fin);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+long peak_rss()
+{
+    long const hwm = proc_status_kb("VmHWM");
+    return (hwm >= 0 ? hwm : rusage_maxrss());
+}
+
+/** Phases, sorted by decreasing wall time */
+static std::vector<std::pair<std::string, PhaseStats>> sorted_phases()
+{
+    std::lock_guard<std::mutex> lock(phases_mutex);
+    std::vector<std::pair<std::string, PhaseStats>> ret(phases.begin(), phases.end());
+    std::sort(ret.begin(), ret.end(),
+        [](std::pair<std::string, PhaseStats> const &a,
+            std::pair<std::string, PhaseStats> const &b)
+        { return a.second.wall_s > b.second.wall_s; });
+    return ret;
+}
+
+static double const MiB = 1024.*1024.;
+
+/** Held bytes, largest first */
+static std::vector<std::pair<std::string, long>> sorted_held(
+    std::map<std::string, long> const &held)
+{
+    std::vector<std::pair<std::string, long>> ret(held.begin(), held.end());
+    std::sort(ret.begin(), ret.end(),
+        [](std::pair<std::string, long> const &a, std::pair<std::string, long> const &b)
+        { return a.second > b.second; });
+    return ret;
+}
+
+void report(FILE *fout, int rank, std::string const &label)
+{
+    auto const sorted(sorted_phases());
+    if (sorted.size() == 0) return;
+
+    fprintf(fout, "======== IceBin profile (rank %d): %s\n", rank, label.c_str());
+    fprintf(fout, "%-40s %8s %12s %12s %12s %10s %10s\n",
+        "phase", "calls", "wall[s]", "nnz", "bytes", "rss[MiB]", "+rss[MiB]");
+    for (auto const &ii : sorted) {
+        PhaseStats const &stats(ii.second);
+        fprintf(fout, "%-40s %8ld %12.4f %12ld %12ld %10.1f %10.1f\n",
+            ii.first.c_str(), stats.ncall, stats.wall_s, stats.nnz, stats.nbytes,
+            stats.rss_max / MiB, stats.rss_growth / MiB);
+    }
+
+    StepMemory mem;
+    {std::lock_guard<std::mutex> lock(phases_mutex);
+        mem = step_memory;
+    }
+    fprintf(fout, "Peak RSS %.1f MiB sampled in %s (high-water mark %.1f MiB)\n",
+        mem.rss_peak / MiB, mem.peak_phase.c_str(), peak_rss() / MiB);
+    for (auto const &ii : sorted_held(mem.held))
+        fprintf(fout, "    %-36s %10.1f MiB\n", ii.first.c_str(), ii.second / MiB);
+    fflush(fout);
+}
+
+/** Writes a {"what": bytes, ...} object */
+static void write_held_json(FILE *fout, std::map<std::string, long> const &held)
+{
+    fprintf(fout, "{");
+    int i = 0;
+    for (auto const &ii : held)
+        fprintf(fout, "%s\"%s\": %ld", (i++ == 0 ? "" : ", "), ii.first.c_str(), ii.second);
+    fprintf(fout, "}");
+}
+
+void report_json(std::string const &fname, int rank, std::string const &label)
+{
+    auto const sorted(sorted_phases());
+    StepMemory mem;
+    {std::lock_guard<std::mutex> lock(phases_mutex);
+        mem = step_memory;
+    }
+
+    FILE *fout = fopen(fname.c_str(), "a");
+    if (!fout) (*icebin_error)(-1,
+        "Cannot open profile file %s", fname.c_str());
+
+    fprintf(fout, "{\"rank\": %d, \"label\": \"%s\", \"phases\": {", rank, label.c_str());
+    for (size_t i=0; i<sorted.size(); ++i) {
+        PhaseStats const &stats(sorted[i].second);
+        fprintf(fout, "%s\"%s\": {\"calls\": %ld, \"wall_s\": %g, \"nnz\": %ld, \"bytes\": %ld, "
+            "\"rss_max\": %ld, \"rss_growth\": %ld, \"held\": ",
+            (i == 0 ? "" : ", "), sorted[i].first.c_str(),
+            stats.ncall, stats.wall_s, stats.nnz, stats.nbytes,
+            stats.rss_max, stats.rss_growth);
+        write_held_json(fout, stats.held);
+        fprintf(fout, "}");
+    }
+    fprintf(fout, "}, \"memory\": {\"rss_peak\": %ld, \"peak_phase\": \"%s\", \"hwm\": %ld, \"held\": ",
+        mem.rss_peak, mem.peak_phase.c_str(), peak_rss());
+    write_held_json(fout, mem.held);
+    fprintf(fout, "}}\n");
+    fclose(fout);
+}
+
+void reset()
+{
+    {std::lock_guard<std::mutex> lock(phases_mutex);
+        phases.clear();
+        step_memory = StepMemory();
+    }
+
+    // Reset the kernel's high-water mark, so the next step's is its own
+    FILE *fout = fopen("/proc/self/clear_refs", "w");
+    if (fout) {
+        fputs("5", fout);
+        fclose(fout);
+    }
+}
+
+}}    // namespace icebin::profile
@@ -0,0 +1,118 @@
+#ifndef ICEBIN_PROFILE_HPP
+#define ICEBIN_PROFILE_HPP
+
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <map>
+
+/** Lightweight per-phase profiler.  Put ICEBIN_PROFILE_SCOPE("name")
+at the top of a block; wall time and call count are accumulated
+under that name when the block exits.  Inside the block,
+ICEBIN_PROFILE_NNZ() and ICEBIN_PROFILE_BYTES() attribute matrix
+elements produced / storage allocated to the innermost open scope.
+
+Timings are inclusive: a scope's time includes that of scopes nested
+inside it.  Statistics are kept per process (= per MPI rank), and
+are printed (report()) and cleared (reset()) once per coupling step.
+
+Memory: each scope samples the resident set size (RSS) when it opens
+and closes.  ICEBIN_PROFILE_HELD("what", nbytes) notes that nbytes
+are held in an IceBin structure of kind "what" (eg Weighted_Eigen,
+VectorMultivec) at that point.  The report shows, for the step, the
+highest RSS sampled, the phase it was sampled in, and what the open
+scopes held at the time; plus the kernel's high-water mark (which
+also sees peaks between samples).  That tells which phase to blame
+when a rank runs out of memory. */
+
+#define ICEBIN_PROFILE_CAT2(a,b) a##b
+#define ICEBIN_PROFILE_CAT(a,b) ICEBIN_PROFILE_CAT2(a,b)
+#define ICEBIN_PROFILE_SCOPE(name) \
+    icebin::profile::Scope ICEBIN_PROFILE_CAT(_icebin_profile_scope_, __LINE__)(name)
+#define ICEBIN_PROFILE_NNZ(n) icebin::profile::add_nnz(n)
+#define ICEBIN_PROFILE_BYTES(n) icebin::profile::add_bytes(n)
+#define ICEBIN_PROFILE_HELD(what, n) icebin::profile::add_held(what, n)
+
+namespace icebin {
+namespace profile {
+
+struct PhaseStats {
+    long ncall = 0;
+    double wall_s = 0;    // Inclusive wall time [s]
+    long nnz = 0;         // Matrix elements produced
+    long nbytes = 0;      // Bytes allocated for results
+    long rss_max = 0;     // Highest RSS sampled at the end of a call [bytes]
+    long rss_growth = 0;  // Largest RSS growth over one call [bytes]
+
+    /** Bytes held by each kind of structure (most in any one call) */
+    std::map<std::string, long> held;
+};
+
+/** Memory high-water of the current step */
+struct StepMemory {
+    long rss_peak = 0;          // Highest RSS sampled [bytes]
+    std::string peak_phase;     // Phase in which rss_peak was sampled
+    std::map<std::string, long> held;    // Held by open scopes at rss_peak
+};
+
+/** Set to false to turn the profiler off (scopes become no-ops) */
+extern bool enabled;
+
+/** Set to also print per-call counters (cells recomputed, cache hits,
+etc) where they are produced.  Set with the optional config attribute
+<gcm>.info:verbose = 0|1. */
+extern bool verbose;
+
+/** Accumulated statistics, by phase name */
+extern std::map<std::string, PhaseStats> phases;
+
+extern StepMemory step_memory;
+
+class Scope {
+    char const *name;
+    Scope *parent;
+    std::chrono::steady_clock::time_point t0;
+    bool running;
+    long nnz = 0;
+    long nbytes = 0;
+    long rss0 = 0;
+    long rss_max = 0;
+    std::map<std::string, long> held;
+
+    /** Updates step_memory; call with the profiler's lock held */
+    void note_peak(long rss);
+
+    friend void add_nnz(long n);
+    friend void add_bytes(long n);
+    friend void add_held(char const *what, long n);
+public:
+    Scope(char const *_name);
+    ~Scope() { stop(); }
+
+    /** Ends the scope early (eg, before calling report()) */
+    void stop();
+};
+
+void add_nnz(long n);
+void add_bytes(long n);
+void add_held(char const *what, long n);
+
+/** Current resident set size of this process [bytes] */
+long current_rss();
+
+/** Highest RSS of this process since the last reset() (or since it
+started, where the high-water mark cannot be reset) [bytes] */
+long peak_rss();
+
+/** Prints a table of the phases recorded since the last reset().
+@param label Identifies what the table covers (eg the coupling time) */
+void report(FILE *fout, int rank, std::string const &label);
+
+/** Same as report(), but appends one line of JSON to a file. */
+void report_json(std::string const &fname, int rank, std::string const &label);
+
+/** Clears all statistics, and the RSS high-water mark (Linux) */
+void reset();
+
+}}    // namespace icebin::profile
+#endif    // guard
@@ -1,4 +1,11 @@
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <unordered_set>
 #include <icebin/smoother.hpp>
+#include <icebin/parallel.hpp>
+#include <icebin/profile.hpp>
 
 namespace icebin {
 
@@ -17,64 +24,333 @@ Smoother::Smoother(std::vector<Smoother::Tuple> &&_tuples,
         rtree.Insert(&t->centroid[0], &t->centroid[0], &*t);
     }
 }
+Smoother::Smoother(std::vector<Smoother::Tuple> &&_tuples,
+    std::array<double,3> const &_sigma,
+    std::vector<std::array<int,2>> &&ij,
+    std::array<int,2> const &shape,
+    std::array<double,2> const &min_spacing) :
+    nsigma(2.),
+    nsigma_squared(nsigma*nsigma),
+    sigma(_sigma),
+    tuples(std::move(_tuples)),
+    lattice(new Lattice)
+{
+    lattice->ij = std::move(ij);
+    lattice->cells.reference(blitz::Array<int,2>(shape[0], shape[1]));
+    lattice->cells = -1;
+    for (size_t i=0; i<lattice->ij.size(); ++i)
+        lattice->cells(lattice->ij[i][0], lattice->ij[i][1]) = i;
+
+    // Any cell within nsigma*sigma of a centroid is at most this many
+    // cells away.  (Also handles sigma=inf)
+    for (int k=0; k<2; ++k) {
+        double const r = std::floor(nsigma*sigma[k] / min_spacing[k]) + 1;
+        lattice->radius[k] = (r < shape[k] ? (int)r : shape[k]);
+    }
+}
 // -----------------------------------------------------------
-/** Inner loop for Smoother::matrix() */
-bool Smoother::matrix_callback(Smoother::Tuple const *t)
+/** Inner loop for Smoother::matrix(): just collects the candidate;
+the Gaussian is evaluated later, in weigh_candidates(). */
+bool Smoother::matrix_callback(Query &q, Smoother::Tuple const *t) const
 {
-    // t0 = point from outer loop
-    // t = point from innter loop
+    q.candidates.push_back(t);
+    return true;
+}
 
-    // Compute a scaled distance metric, based on the radius in each direction
-    double norm_distance_squared = 0;
-    for (int i=0; i<3; ++i) {
-        double const d = (t->centroid[i] - t0->centroid[i]) / sigma[i];
-        norm_distance_squared += d*d;
+void Smoother::weigh_candidates(Query &q) const
+{
+    int const n = q.candidates.size();
+    for (auto *v : {&q.dx, &q.dy, &q.dz, &q.area, &q.d2, &q.w}) v->resize(n);
+
+    // Gather into SoA form: offsets scaled by the radius in each direction
+    auto const &c0(q.t0->centroid);
+    for (int i=0; i<n; ++i) {
+        Tuple const *t = q.candidates[i];
+        q.dx[i] = (t->centroid[0] - c0[0]) / sigma[0];
+        q.dy[i] = (t->centroid[1] - c0[1]) / sigma[1];
+        q.dz[i] = (t->centroid[2] - c0[2]) / sigma[2];
+        q.area[i] = t->area;
     }
 
-    if (norm_distance_squared < nsigma_squared) {
-        double const gaussian_ij = std::exp(-.5 * norm_distance_squared);
-        double w = gaussian_ij * t->area;
-        M_raw.push_back(std::make_pair(t->iX_d, w));
-        denom_sum += w;
+    // Batch (vectorized) evaluation of the Gaussian
+    typedef Eigen::Map<Eigen::ArrayXd> MapT;
+    MapT d2(q.d2.data(), n);
+    MapT w(q.w.data(), n);
+    d2 = MapT(q.dx.data(), n).square() + MapT(q.dy.data(), n).square()
+        + MapT(q.dz.data(), n).square();
+    w = (-.5 * d2).exp() * MapT(q.area.data(), n);
+
+    // Keep the ones inside nsigma*sigma, in the order they were found
+    for (int i=0; i<n; ++i) {
+        if (q.d2[i] < nsigma_squared) {
+            q.M_raw.push_back(std::make_pair(q.candidates[i]->iX_d, q.w[i]));
+            q.denom_sum += q.w[i];
+        }
     }
-    return true;
 }
 
-void Smoother::matrix(TupleListT<2> &ret)
+void Smoother::gather_row(Query &q, int i0)
 {
     using namespace std::placeholders;  // for _1, _2, _3...
 
-    RTree::Callback callback(std::bind(&Smoother::matrix_callback, this, _1));
-    for (auto _t0(tuples.begin()); _t0 != tuples.end(); ++_t0) {
-        t0 = &*_t0;
-        M_raw.clear();
-        denom_sum = 0;
+    Tuple const *t0 = &tuples[i0];
+    q.t0 = t0;
+    q.candidates.clear();
+    q.M_raw.clear();
+    q.denom_sum = 0;
 
-        // Pair t0 with nearby points
+    // Pair t0 with nearby points
+    if (lattice) {
+        // Enumerate the stencil around t0; weigh_candidates() does the
+        // distance test, exactly as for the RTree.
+        auto const &ij0(lattice->ij[i0]);
+        int const ix0 = std::max(0, ij0[0] - lattice->radius[0]);
+        int const ix1 = std::min(lattice->cells.extent(0)-1, ij0[0] + lattice->radius[0]);
+        int const iy0 = std::max(0, ij0[1] - lattice->radius[1]);
+        int const iy1 = std::min(lattice->cells.extent(1)-1, ij0[1] + lattice->radius[1]);
+        for (int ix=ix0; ix<=ix1; ++ix) {
+        for (int iy=iy0; iy<=iy1; ++iy) {
+            int const i = lattice->cells(ix,iy);
+            if (i >= 0) matrix_callback(q, &tuples[i]);
+        }}
+    } else {
+        // (RTree::Search() does not modify the tree, so threads may share it)
+        RTree::Callback callback(std::bind(&Smoother::matrix_callback, this, std::ref(q), _1));
         std::array<double,3> min, max;
         for (int i=0; i<3; ++i) {
             min[i] = t0->centroid[i] - nsigma*sigma[i];
             max[i] = t0->centroid[i] + nsigma*sigma[i];
         }
         rtree.Search(min, max, callback);
+    }
+
+    weigh_candidates(q);
+}
+
+void Smoother::truncate_row(Query &q) const
+{
+    if (tol == 0 || q.M_raw.empty()) return;
+
+    double max_w = 0;
+    for (auto const &ii : q.M_raw) max_w = std::max(max_w, ii.second);
+    double const threshold = tol * max_w;
+
+    // Compact in place, keeping the order of the remaining entries
+    double kept_sum = 0;
+    size_t j = 0;
+    for (size_t i=0; i<q.M_raw.size(); ++i) {
+        if (q.M_raw[i].second < threshold) continue;
+        kept_sum += q.M_raw[i].second;
+        q.M_raw[j++] = q.M_raw[i];
+    }
+    q.ndropped += q.M_raw.size() - j;
+    q.M_raw.resize(j);
+
+    // Renormalizing by kept_sum keeps the row summing to 1
+    q.max_dropped = std::max(q.max_dropped, 1. - kept_sum / q.denom_sum);
+    q.denom_sum = kept_sum;
+}
+
+void Smoother::matrix_row(Query &q, int i0, TupleListT<2> &ret)
+{
+    gather_row(q, i0);
+    truncate_row(q);
+    Tuple const *t0 = q.t0;
 
-        // Add to the final matrix
-        double factor = 1. / denom_sum;
-        for (auto ii=M_raw.begin(); ii != M_raw.end(); ++ii) {
-            ret.add({t0->iX_d, ii->first}, factor * ii->second);
+    // Add to the final matrix
+    double factor = 1. / q.denom_sum;
+    for (auto ii=q.M_raw.begin(); ii != q.M_raw.end(); ++ii) {
+        ret.add({t0->iX_d, ii->first}, factor * ii->second);
+    }
+}
+
+void Smoother::matrix(TupleListT<2> &ret)
+{
+    ICEBIN_PROFILE_SCOPE("Smoother::matrix");
+    int const n = tuples.size();
+    ndropped = 0;
+    max_dropped = 0;
+
+    if (use_threads(n)) {
+        // Fixed blocks of rows (parallel_blocks()); concatenated in order below
+        int const nblock = nparallel_blocks(n);
+        std::vector<TupleListT<2>> parts(nblock,
+            TupleListT<2>({ret.shape(0), ret.shape(1)}));
+        std::vector<long> ndroppeds(nblock);
+        std::vector<double> max_droppeds(nblock);
+        parallel_blocks(n, true, [&](int ib, int i0, int i1) {
+            Query q;
+            for (int i=i0; i<i1; ++i) matrix_row(q, i, parts[ib]);
+            ndroppeds[ib] = q.ndropped;
+            max_droppeds[ib] = q.max_dropped;
+        });
+
+        for (int ib=0; ib<nblock; ++ib) {
+            ndropped += ndroppeds[ib];
+            max_dropped = std::max(max_dropped, max_droppeds[ib]);
+            TupleListT<2> &part(parts[ib]);
+            for (auto ii=part.begin(); ii != part.end(); ++ii)
+                ret.add({ii->index(0), ii->index(1)}, ii->value());
+            ICEBIN_PROFILE_NNZ(part.tuples.size());
+            part = TupleListT<2>();
         }
+        return;
     }
+
+    Query q;
+    for (int i=0; i<n; ++i) matrix_row(q, i, ret);
+    ndropped = q.ndropped;
+    max_dropped = q.max_dropped;
+    ICEBIN_PROFILE_NNZ(ret.tuples.size());
+}
+
+void Smoother::matrix(TupleListT<2> &ret,
+    SmoothingCache &cache, SmoothingCache::Entry &entry,
+    SparseSetT const &dimX)
+{
+    ICEBIN_PROFILE_SCOPE("Smoother::matrix(cached)");
+    int const n = tuples.size();
+
+    // Elevation does not matter if smoothing is only horizontal
+    bool const use_z = !std::isinf(sigma[2]);
+
+    // Different matrices may be smoothed concurrently; but one
+    // entry is only used by one at a time
+    std::lock_guard<std::mutex> entry_lock(entry.mutex);
+
+    // Current state of the cells
+    std::unordered_map<long, SmoothingCache::CellState> cells;
+    std::unordered_map<long, int> index;    // Sparse index --> index in tuples
+    for (int i=0; i<n; ++i) {
+        long const iX_s = dimX.to_sparse(tuples[i].iX_d);
+        SmoothingCache::CellState state{tuples[i].centroid, tuples[i].area};
+        if (!use_z) state.centroid[2] = 0;
+        cells.insert(std::make_pair(iX_s, state));
+        index.insert(std::make_pair(iX_s, i));
+    }
+
+    // Cells that were added, removed or changed since last time
+    std::vector<long> changed;
+    for (auto const &ii : cells) {
+        auto jj(entry.cells.find(ii.first));
+        if (jj == entry.cells.end()
+            || jj->second.centroid != ii.second.centroid
+            || jj->second.area != ii.second.area)
+        {
+            changed.push_back(ii.first);
+        }
+    }
+    for (auto const &jj : entry.cells) {
+        if (cells.find(jj.first) == cells.end()) changed.push_back(jj.first);
+    }
+
+    // Rows to rebuild: the changed cells, plus every row that contains
+    // a changed cell, before or after.  Neighborhoods (before
+    // truncation) are symmetric, so those rows are the neighbors of
+    // the changed cells.  (A truncated row may have dropped a cell
+    // whose own row still holds it: use the untruncated neighbors.)
+    bool const rebuild_all = entry.cells.empty();
+    std::unordered_set<long> rebuild;
+    Query q;
+    if (!rebuild_all) for (long const iX_s : changed) {
+        if (tol != 0) {
+            auto nn(entry.neighbors.find(iX_s));
+            if (nn != entry.neighbors.end()) {
+                for (long const jX_s : nn->second) rebuild.insert(jX_s);
+            }
+        } else {
+            auto rr(entry.rows.find(iX_s));
+            if (rr != entry.rows.end()) {
+                for (auto const &ii : rr->second) rebuild.insert(ii.first);
+            }
+        }
+
+        auto kk(index.find(iX_s));
+        if (kk != index.end()) {
+            rebuild.insert(iX_s);
+            gather_row(q, kk->second);
+            for (auto const &ii : q.M_raw) rebuild.insert(dimX.to_sparse(ii.first));
+        }
+    }
+
+    // Update the cache
+    for (auto const &jj : entry.cells) {
+        if (cells.find(jj.first) == cells.end()) {
+            entry.rows.erase(jj.first);
+            entry.neighbors.erase(jj.first);
+        }
+    }
+    entry.cells = std::move(cells);
+    long nrow_reused = 0;
+    long nrow_rebuilt = 0;
+    for (int i=0; i<n; ++i) {
+        long const iX_s = dimX.to_sparse(tuples[i].iX_d);
+        if (!rebuild_all && rebuild.find(iX_s) == rebuild.end()) {
+            ++nrow_reused;
+            continue;
+        }
+        ++nrow_rebuilt;
+
+        gather_row(q, i);
+        if (tol != 0) {
+            auto &neighbors(entry.neighbors[iX_s]);
+            neighbors.clear();
+            for (auto const &ii : q.M_raw) neighbors.push_back(dimX.to_sparse(ii.first));
+        }
+        truncate_row(q);
+        double const factor = 1. / q.denom_sum;
+        auto &row(entry.rows[iX_s]);
+        row.clear();
+        for (auto const &ii : q.M_raw)
+            row.push_back(std::make_pair(dimX.to_sparse(ii.first), factor * ii.second));
+    }
+    {std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.nrow_reused += nrow_reused;
+        cache.nrow_rebuilt += nrow_rebuilt;
+    }
+
+    // (Statistics cover only the rebuilt rows)
+    ndropped = q.ndropped;
+    max_dropped = q.max_dropped;
+
+    // Produce the matrix in dense indexing, in the same order as matrix()
+    for (int i=0; i<n; ++i) {
+        auto const &row(entry.rows.at(dimX.to_sparse(tuples[i].iX_d)));
+        for (auto const &ii : row)
+            ret.add({tuples[i].iX_d, dimX.to_dense(ii.first)}, ii.second);
+    }
+    ICEBIN_PROFILE_NNZ(ret.tuples.size());
 }
 // -----------------------------------------------------------
+/** @return The grid's spec, if its cells lie on a structured (ix,iy)
+    lattice; or nullptr if not. */
+static GridSpec_XY const *lattice_spec(AbbrGrid const &agridX)
+{
+    if (agridX.spec && agridX.spec->type == GridType::XY
+        && agridX.coordinates == GridCoordinates::XY
+        && agridX.parameterization == GridParameterization::L0)
+    {
+        return dynamic_cast<GridSpec_XY const *>(&*agridX.spec);
+    }
+    return nullptr;
+}
+
 void smoothing_matrix(TupleListT<2> &ret_d,
     AbbrGrid const &agridX,
     SparseSetT const &dimX,
     DenseArrayT<1> const &elev_s,
     DenseArrayT<1> const &area_d,
-    std::array<double,3> const &sigma)
+    std::array<double,3> const &sigma,
+    double tol,
+    SmoothingCache *cache,
+    std::string const &cache_key)
 {
     std::vector<Smoother::Tuple> tuples;
 
+    // Cells of L0 XY grids lie on a lattice; use it to find neighbors
+    GridSpec_XY const *specXY = lattice_spec(agridX);
+    std::vector<std::array<int,2>> ij;
+
     for (int id=0; id<agridX.dim.dense_extent(); ++id) {
         auto iX_s(agridX.dim.to_sparse(id));
         if (!dimX.in_sparse(iX_s)) continue;    // TODO: dimX and agridX.dim are probably the same
@@ -93,9 +369,142 @@ void smoothing_matrix(TupleListT<2> &ret_d,
             Smoother::Tuple(iX_d,
                 {agridX.centroid_xy(id,0), agridX.centroid_xy(id,1)},
                 elev, area));
+        if (specXY) ij.push_back(agridX.indexing.index_to_tuple<int,2>(iX_s));
+    }
+
+    std::unique_ptr<Smoother> smoother;
+    if (specXY) {
+        std::array<double,2> min_spacing {
+            std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::infinity()};
+        for (size_t i=1; i<specXY->xb.size(); ++i)
+            min_spacing[0] = std::min(min_spacing[0], specXY->xb[i] - specXY->xb[i-1]);
+        for (size_t i=1; i<specXY->yb.size(); ++i)
+            min_spacing[1] = std::min(min_spacing[1], specXY->yb[i] - specXY->yb[i-1]);
+
+        smoother.reset(new Smoother(std::move(tuples), sigma, std::move(ij),
+            {specXY->nx(), specXY->ny()}, min_spacing));
+    } else {
+        smoother.reset(new Smoother(std::move(tuples), sigma));
+    }
+
+    smoother->tol = tol;
+    if (cache) {
+        smoother->matrix(ret_d, *cache,
+            cache->entry(SmoothingCache::KeyT(cache_key, sigma, tol)), dimX);
+    } else {
+        smoother->matrix(ret_d);
+    }
+
+    if (tol != 0 && profile::verbose) printf("smoothing_matrix(tol=%g): nnz=%ld dropped=%ld max_conservation_error=%g\n",
+        tol, (long)ret_d.tuples.size(), smoother->ndropped, smoother->max_dropped);
+}
+// -----------------------------------------------------------
+/** Values of a 1-D Gaussian centered on cell i0, for all cells within
+nsigma*sigma of it.
+@param centers Center of each cell along the axis (increasing)
+@param ret OUT: (cell index, Gaussian) pairs */
+static void gaussian_1d(std::vector<double> const &centers,
+    int i0, double sigma, double nsigma,
+    std::vector<std::pair<int,double>> &ret)
+{
+    ret.clear();
+    double const c0 = centers[i0];
+    for (int i=i0; i >= 0; --i) {
+        double const d = (centers[i] - c0) / sigma;
+        if (d*d >= nsigma*nsigma) break;
+        ret.push_back(std::make_pair(i, std::exp(-.5 * d*d)));
+    }
+    for (int i=i0+1; i < (int)centers.size(); ++i) {
+        double const d = (centers[i] - c0) / sigma;
+        if (d*d >= nsigma*nsigma) break;
+        ret.push_back(std::make_pair(i, std::exp(-.5 * d*d)));
+    }
+}
+
+bool separable_smoothing_matrices(
+    EigenSparseMatrixT &smoothY,
+    EigenSparseMatrixT &smoothX,
+    AbbrGrid const &agridX,
+    SparseSetT const &dimX,
+    DenseArrayT<1> const &elev_s,
+    DenseArrayT<1> const &area_d,
+    std::array<double,3> const &sigma)
+{
+    GridSpec_XY const *specXY = lattice_spec(agridX);
+    if (!specXY || !std::isinf(sigma[2])) return false;
+
+    ICEBIN_PROFILE_SCOPE("separable_smoothing_matrices");
+    double const nsigma = 2.;    // Same truncation as Smoother
+    int const nx = specXY->nx();
+    int const ny = specXY->ny();
+    int const nX = dimX.dense_extent();
+    int const nL = nx*ny;    // Intermediate space: lattice cell (ix,iy) --> ix*ny + iy
+
+    std::array<std::vector<double>,2> centers;
+    for (int i=0; i<nx; ++i) centers[0].push_back(.5 * (specXY->xb[i] + specXY->xb[i+1]));
+    for (int i=0; i<ny; ++i) centers[1].push_back(.5 * (specXY->yb[i] + specXY->yb[i+1]));
+
+    // Same selection of cells as smoothing_matrix()
+    struct Cell {
+        int iX_d;
+        std::array<int,2> ij;
+        double area;
+    };
+    std::vector<Cell> cells;
+    for (int id=0; id<agridX.dim.dense_extent(); ++id) {
+        auto iX_s(agridX.dim.to_sparse(id));
+        if (!dimX.in_sparse(iX_s)) continue;
+        if (std::isnan(elev_s(iX_s))) continue;
+
+        auto iX_d(dimX.to_dense(iX_s));
+        double area(area_d(iX_d));
+        if (area == 0.) (*icebin_error)(-1,
+            "Area of cell %ld must be non-zero\n", iX_s);
+
+        cells.push_back(Cell{(int)iX_d,
+            agridX.indexing.index_to_tuple<int,2>(iX_s), area});
     }
-    Smoother smoother(std::move(tuples), sigma);
-    smoother.matrix(ret_d);
+
+    std::vector<std::pair<int,double>> g;
+
+    // x pass: I cell j --> lattice cells in its row, weighted by area
+    TupleListT<2> X_t({nL, nX});
+    std::vector<double> Xsum(nL, 0.);    // X * 1
+    for (auto const &c : cells) {
+        gaussian_1d(centers[0], c.ij[0], sigma[0], nsigma, g);
+        for (auto const &ii : g) {
+            int const k = ii.first*ny + c.ij[1];
+            double const w = ii.second * c.area;
+            X_t.add({k, c.iX_d}, w);
+            Xsum[k] += w;
+        }
+    }
+
+    // y pass: lattice cells in the column of I cell i --> i.
+    // Rows are normalized so that (Y * X) * 1 = 1.
+    TupleListT<2> Y_t({nX, nL});
+    std::vector<std::pair<int,double>> row;
+    for (auto const &c : cells) {
+        gaussian_1d(centers[1], c.ij[1], sigma[1], nsigma, g);
+        row.clear();
+        double denom_sum = 0;
+        for (auto const &ii : g) {
+            int const k = c.ij[0]*ny + ii.first;
+            if (Xsum[k] == 0) continue;
+            row.push_back(std::make_pair(k, ii.second));
+            denom_sum += ii.second * Xsum[k];
+        }
+        double const factor = 1. / denom_sum;
+        for (auto const &ii : row) Y_t.add({c.iX_d, ii.first}, factor * ii.second);
+    }
+
+    smoothX.resize(nL, nX);
+    smoothX.setFromTriplets(X_t.begin(), X_t.end());
+    smoothY.resize(nX, nL);
+    smoothY.setFromTriplets(Y_t.begin(), Y_t.end());
+    ICEBIN_PROFILE_NNZ(smoothX.nonZeros() + smoothY.nonZeros());
+    return true;
 }
 
 }    // namespace
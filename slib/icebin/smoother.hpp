@@ -1,11 +1,68 @@
 #ifndef ICEBIN_SMOOTHER_HPP
 #define ICEBIN_SMOOTHER_HPP
 
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <Eigen/Dense>
 #include <ibmisc/RTree.hpp>
 #include <icebin/IceRegridder.hpp>
 
 namespace icebin {
 
+/** Smoothing matrices from previous coupling steps, kept so that
+only the rows affected by a change in the ice mask (or overlap areas)
+need to be recomputed.  Rows are stored in sparse (grid-native)
+indexing, since dense indexing can change from step to step.  The
+result is identical to building the smoothing matrix from scratch. */
+class SmoothingCache {
+public:
+    /** What a row of the smoothing matrix depends on, per grid cell */
+    struct CellState {
+        std::array<double,3> centroid;
+        double area;
+    };
+
+    struct Entry {
+        /** Held while this entry is being used or updated */
+        std::mutex mutex;
+        /** Cells that were smoothed last time (sparse indexing) */
+        std::unordered_map<long, CellState> cells;
+        /** Rows of the smoothing matrix (sparse indexing) */
+        std::unordered_map<long, std::vector<std::pair<long,double>>> rows;
+        /** Cells within reach of each cell (sparse indexing), before
+        truncation; kept only if Smoother::tol > 0 (otherwise they
+        are the entries in rows). */
+        std::unordered_map<long, std::vector<long>> neighbors;
+    };
+
+    /** Entries keyed on (name of the matrix being smoothed, sigma, tol) */
+    typedef std::tuple<std::string, std::array<double,3>, double> KeyT;
+    std::map<KeyT, Entry> entries;
+
+    /** Protects entries (but not their contents) and the statistics */
+    std::mutex mutex;
+
+    // Statistics
+    long nrow_reused = 0;
+    long nrow_rebuilt = 0;
+
+    /** Looks up (or creates) an entry.  Lock Entry::mutex before using it. */
+    Entry &entry(KeyT const &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries[key];
+    }
+
+    /** Removes all entries.  Not to be called while they are in use. */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+};
+
 /** Producer of smoothing matrices that is (somewhat) independent of
     particular grid implementations.  Smoother::Tuple encapsulates all
     we need to know about each grid cell to make the smoothing
@@ -41,31 +98,95 @@ public:
     double const nsigma;
     double const nsigma_squared;
 
+    /** Within each row, drop entries smaller than tol times the
+    largest one, then renormalize.  0 keeps everything. */
+    double tol = 0;
+
+    /** Truncation statistics from the last call to matrix() */
+    long ndropped = 0;        // Entries dropped, over all rows
+    double max_dropped = 0;   // Largest fraction of a row's weight dropped
+
 protected:
-    // ------ Variables used in loop; see Smoother::matrix()
-    Tuple *t0;
-    std::vector<std::pair<int,double>> M_raw;
-    double denom_sum;
-    // --------------------------
+    /** Scratch state for one row of the smoothing matrix; one per
+    thread in Smoother::matrix(). */
+    struct Query {
+        Tuple const *t0;    // Point from outer loop
+
+        // Candidate neighbors of t0 (from the RTree or lattice), and
+        // scratch arrays (SoA) for evaluating their weights in a batch.
+        // (std::vector, so capacity is kept from row to row)
+        std::vector<Tuple const *> candidates;
+        std::vector<double> dx, dy, dz, area, d2, w;
+
+        std::vector<std::pair<int,double>> M_raw;
+        double denom_sum;
+
+        // Truncation statistics, accumulated over rows
+        long ndropped = 0;
+        double max_dropped = 0;
+    };
 
     RTree rtree;
 
     // Outer loop: set once
     std::vector<Tuple> tuples;
 
+    /** Neighbor finder for tuples lying on a structured (ix,iy)
+    lattice, used instead of the RTree if set. */
+    struct Lattice {
+        std::vector<std::array<int,2>> ij;    // ij[i] = lattice position of tuples[i]
+        blitz::Array<int,2> cells;    // (ix,iy) --> index in tuples; -1 if none
+        std::array<int,2> radius;    // Half-width of search stencil, in cells
+    };
+    std::unique_ptr<Lattice> lattice;
+
 public:
     /** Set up the RTree needed for the smoothing matrix */
     Smoother(std::vector<Tuple> &&_tuples, std::array<double,3> const &sigma);
 
+    /** Set up for tuples on a structured lattice: neighbors are found
+    by enumerating a stencil of cells around each one.
+    @param ij Lattice position of each tuple
+    @param shape Size of the lattice {nx, ny}
+    @param min_spacing Smallest distance between adjacent cell
+        centroids {dx, dy} */
+    Smoother(std::vector<Tuple> &&_tuples, std::array<double,3> const &sigma,
+        std::vector<std::array<int,2>> &&ij,
+        std::array<int,2> const &shape,
+        std::array<double,2> const &min_spacing);
+
     ~Smoother();    // Not inline because of forward-declared type of rtree
 
 protected:
     /** Inner loop for Smoother::matrix() */
-    bool matrix_callback(Tuple const *t);
+    bool matrix_callback(Query &q, Tuple const *t) const;
+
+    /** Computes the Gaussian weights of q.candidates in one batch,
+    and adds those within nsigma*sigma to q.M_raw. */
+    void weigh_candidates(Query &q) const;
+
+    /** Finds the (unnormalized) row of the smoothing matrix for
+    tuples[i0], into q.M_raw and q.denom_sum. */
+    void gather_row(Query &q, int i0);
+
+    /** Applies the tolerance to the row in q; updates q.denom_sum. */
+    void truncate_row(Query &q) const;
+
+    /** Computes the row of the smoothing matrix for t0, into ret. */
+    void matrix_row(Query &q, int i0, TupleListT<2> &ret);
 
 public:
-    /** Generate the smoothing matrix. */
+    /** Generate the smoothing matrix.  If built with OpenMP, rows are
+    computed in parallel; the result is the same as a serial run. */
     void matrix(TupleListT<2> &ret);
+
+    /** Generate the smoothing matrix, recomputing only rows that
+    differ from those in cache (and updating cache).
+    Locks entry while it is in use.
+    @param dimX Translates Tuple::iX_d to the sparse indexing used in cache. */
+    void matrix(TupleListT<2> &ret,
+        SmoothingCache &cache, SmoothingCache::Entry &entry,
+        SparseSetT const &dimX);
 };
 
 /** Produces a smoothing matrix that "smears" one grid cell into
@@ -99,8 +220,41 @@ public:
         size of an A grid cell and sigma[2] infinity.  If smoothing IvE,
         then sigma[2] should be about the elevation difference between
         different elevation classes.
+    @param tol
+        Relative tolerance for dropping small entries from each row
+        (see Smoother::tol).
+    @param cache
+        If non-null, reuse rows of the smoothing matrix from the last
+        call with the same cache_key (see SmoothingCache).
+    @param cache_key
+        Identifies the matrix being smoothed (eg "IvA") in cache.
 */
 extern void smoothing_matrix(TupleListT<2> &ret,
+    AbbrGrid const &agridX,
+    SparseSetT const &dimX,
+    DenseArrayT<1> const &elev_s,
+    DenseArrayT<1> const &area_d,
+    std::array<double,3> const &sigma,
+    double tol = 0,
+    SmoothingCache *cache = nullptr,
+    std::string const &cache_key = "");
+
+/** Separable form of smoothing_matrix(), for grids whose cells lie on
+    a structured (ix,iy) lattice (L0 XY grids), when sigma[2] is
+    infinite.  The Gaussian is applied as two 1-D passes, so the 2-D
+    smoothing matrix need never be formed:
+        smoothing matrix = smoothY * smoothX
+    smoothX spreads each cell along x into an intermediate space of
+    lattice cells (ix*ny + iy), weighted by area_d; smoothY gathers
+    along y and normalizes each row.  Unlike smoothing_matrix(), the
+    kernel is truncated to a box (|dx| < nsigma*sigma[0], |dy| <
+    nsigma*sigma[1]) rather than an ellipse.
+    Arguments are as for smoothing_matrix().
+@return false (and smoothY, smoothX untouched) if the grid or sigma
+    are not suitable; use smoothing_matrix() instead. */
+extern bool separable_smoothing_matrices(
+    EigenSparseMatrixT &smoothY,
+    EigenSparseMatrixT &smoothX,
     AbbrGrid const &agridX,
     SparseSetT const &dimX,
     DenseArrayT<1> const &elev_s,
@@ -0,0 +1,228 @@
+/*
+ * IBMisc: Misc. Routines for IceBin (and other code)
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** Times the C++ Hntr against the Fortran HNTR4 over a ladder of
+ModelE grid pairs.  Not run by ctest.  Writes one JSON record per
+(grid pair, implementation, phase) per line, to stdout or to a file:
+
+    bench_hntr [-o out.jsonl] [-n nrep] [gridA:gridB ...]
+
+Grid names are those in icebin::modele::grids (eg g1x1:g2hx2). */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <functional>
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+#include <icebin/error.hpp>
+#include <icebin/modele/hntr.hpp>
+#include <icebin/modele/grids.hpp>
+
+using namespace icebin;
+using namespace icebin::modele;
+
+extern "C" void call_hntr40(
+    int const &ima, int const &jma, float const &offia, float const &dlata,
+    int const &imb, int const &jmb, float const &offib, float const &dlatb,
+    float const &datmis);
+
+extern "C" void call_hntr4(
+    float const *WTA, int const &lwta,
+    float const *A, int const &la,
+    float  *B, int const &lb);
+
+/** Largest grids the Fortran HNTR4 common block can hold */
+static bool fortran_fits(HntrSpec const &spec)
+    { return spec.im <= 10800 && spec.jm <= 5401; }
+
+/** Counts matrix elements; keeps the optimizer from dropping them */
+struct CountAccum {
+    long *nnz;
+    double *sum;
+
+    CountAccum(long *_nnz, double *_sum) : nnz(_nnz), sum(_sum) {}
+
+    void add(std::array<int,2> const &index, double val)
+    {
+        ++*nnz;
+        *sum += val;
+    }
+};
+
+struct Timing {
+    int nrep = 0;
+    double min_s = 0;
+    double mean_s = 0;
+};
+
+static Timing time_it(int nrep, std::function<void()> const &fn)
+{
+    Timing ret;
+    ret.nrep = nrep;
+    for (int i=0; i<nrep; ++i) {
+        auto const t0(std::chrono::steady_clock::now());
+        fn();
+        double const dt = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        ret.min_s = (i == 0 ? dt : std::min(ret.min_s, dt));
+        ret.mean_s += dt;
+    }
+    ret.mean_s /= nrep;
+    return ret;
+}
+
+class Reporter {
+    FILE *fout;
+    int nthread;
+public:
+    Reporter(FILE *_fout) : fout(_fout)
+    {
+#ifdef USE_OPENMP
+        nthread = omp_get_max_threads();
+#else
+        nthread = 1;
+#endif
+    }
+
+    void operator()(std::string const &nameA, std::string const &nameB,
+        char const *impl, char const *phase, Timing const &t, long nnz = -1)
+    {
+        fprintf(fout, "{\"gridA\": \"%s\", \"gridB\": \"%s\", \"impl\": \"%s\", "
+            "\"phase\": \"%s\", \"nthread\": %d, \"nrep\": %d, "
+            "\"min_s\": %g, \"mean_s\": %g, \"nnz\": %ld}\n",
+            nameA.c_str(), nameB.c_str(), impl, phase, nthread, t.nrep,
+            t.min_s, t.mean_s, nnz);
+        fflush(fout);
+    }
+};
+
+static void bench_pair(Reporter &report, int nrep,
+    std::string const &nameA, std::string const &nameB)
+{
+    HntrSpec const &specA(*grids.at(nameA));
+    HntrSpec const &specB(*grids.at(nameB));
+
+    // Real*4 inputs, as for HNTR4
+    auto WTA(hntr_array<float>(specA));
+    auto A(hntr_array<float>(specA));
+    auto B(hntr_array<double>(specB));
+    WTA = 1.f;
+    for (int j=1; j<=specA.jm; ++j) {
+    for (int i=1; i<=specA.im; ++i) {
+        A(i,j) = (float)rand() / RAND_MAX;
+    }}
+
+    // ------------------- C++
+    report(nameA, nameB, "cpp", "construct", time_it(nrep, [&]() {
+        Hntr hntr(17.17, specB, specA, 0);
+    }));
+
+    Hntr hntr(17.17, specB, specA, 0);
+    report(nameA, nameB, "cpp", "regrid", time_it(nrep, [&]() {
+        hntr.regrid(WTA, A, B);
+    }));
+
+    long nnz = 0;
+    double sum = 0;
+    report(nameA, nameB, "cpp", "overlap", time_it(nrep, [&]() {
+        nnz = 0;
+        hntr.overlap(CountAccum(&nnz, &sum), 1.0);
+    }), nnz);
+
+    report(nameA, nameB, "cpp", "scaled_regrid_matrix", time_it(nrep, [&]() {
+        nnz = 0;
+        hntr.scaled_regrid_matrix(CountAccum(&nnz, &sum));
+    }), nnz);
+
+    Hntr hntrc(17.17, specB, specA, 0);
+    report(nameA, nameB, "cpp", "compile", time_it(1, [&]() {
+        hntrc.compile();
+    }), hntrc.weights.nnz());
+
+    report(nameA, nameB, "cpp", "regrid_compiled", time_it(nrep, [&]() {
+        hntrc.regrid(WTA, A, B);
+    }));
+
+    // ------------------- Fortran
+    if (!fortran_fits(specA) || !fortran_fits(specB)) {
+        fprintf(stderr, "%s:%s too large for HNTR4, skipping Fortran\n",
+            nameA.c_str(), nameB.c_str());
+        return;
+    }
+
+    report(nameA, nameB, "fortran", "construct", time_it(nrep, [&]() {
+        call_hntr40(
+            specA.im, specA.jm, specA.offi, specA.dlat,
+            specB.im, specB.jm, specB.offi, specB.dlat,
+            0.);
+    }));
+
+    auto Bf(hntr_array<float>(specB));
+    report(nameA, nameB, "fortran", "regrid", time_it(nrep, [&]() {
+        call_hntr4(
+            WTA.data(), WTA.extent(0),
+            A.data(), A.extent(0),
+            Bf.data(), Bf.extent(0));
+    }));
+}
+
+int main(int argc, char **argv)
+{
+    std::string ofname;
+    int nrep = 5;
+    std::vector<std::pair<std::string, std::string>> pairs;
+
+    for (int i=1; i<argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            ofname = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            nrep = atoi(argv[++i]);
+        } else {
+            char const *colon = strchr(argv[i], ':');
+            if (!colon) (*icebin_error)(-1,
+                "Grid pair must be gridA:gridB: %s", argv[i]);
+            pairs.push_back(std::make_pair(
+                std::string(argv[i], colon), std::string(colon+1)));
+        }
+    }
+
+    // Default ladder: 1x1 -> 2x2.5, 1-minute -> 1/4 degree, 1Qx1 -> 4x5
+    if (pairs.size() == 0) pairs = {
+        {"g1x1", "g2hx2"},
+        {"g1mx1m", "g1qx1"},
+        {"g1qx1", "g5x4"}};
+
+    FILE *fout = stdout;
+    if (ofname != "") {
+        fout = fopen(ofname.c_str(), "w");
+        if (!fout) (*icebin_error)(-1,
+            "Cannot open %s", ofname.c_str());
+    }
+
+    Reporter report(fout);
+    for (auto const &pair : pairs)
+        bench_pair(report, nrep, pair.first, pair.second);
+
+    if (fout != stdout) fclose(fout);
+    return 0;
+}
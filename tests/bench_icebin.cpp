@@ -0,0 +1,290 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** Microbenchmarks of the core regridding kernels, on synthetic grids
+of increasing size.  Not run by ctest.  Writes one JSON record per
+(size, kernel) per line, to stdout or to a file:
+
+    icebin_bench [-o out.jsonl] [-n nrep] [-r refine] [nA ...]
+
+nA is the number of GCM (A) cells along each side of a square domain;
+the ice grid has refine (default 4) times as many cells per side.
+Grids come from make_synthetic_grids(). */
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <functional>
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+#include <icebin/error.hpp>
+#include <icebin/GCMRegridder.hpp>
+#include <icebin/smoother.hpp>
+#include <icebin/e1ve0.hpp>
+#include <icebin/gridgen/GridGen_Exchange.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+#ifdef BUILD_MODELE
+#include <icebin/modele/hntr.hpp>
+#endif
+
+using namespace std::placeholders;
+using namespace ibmisc;
+using namespace spsparse;
+using namespace icebin;
+
+struct Timing {
+    int nrep = 0;
+    double min_s = 0;
+    double mean_s = 0;
+};
+
+static Timing time_it(int nrep, std::function<void()> const &fn)
+{
+    if (nrep < 1) (*icebin_error)(-1, "time_it(): nrep=%d must be >= 1", nrep);
+    Timing ret;
+    ret.nrep = nrep;
+    for (int i=0; i<nrep; ++i) {
+        auto const t0(std::chrono::steady_clock::now());
+        fn();
+        double const dt = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        ret.min_s = (i == 0 ? dt : std::min(ret.min_s, dt));
+        ret.mean_s += dt;
+    }
+    ret.mean_s /= nrep;
+    return ret;
+}
+
+class Reporter {
+    FILE *fout;
+    int nthread;
+public:
+    Reporter(FILE *_fout) : fout(_fout)
+    {
+#ifdef USE_OPENMP
+        nthread = omp_get_max_threads();
+#else
+        nthread = 1;
+#endif
+    }
+
+    void operator()(int nA, long nX, char const *kernel,
+        Timing const &t, long nnz = -1)
+    {
+        fprintf(fout, "{\"nA\": %d, \"nX\": %ld, \"kernel\": \"%s\", "
+            "\"nthread\": %d, \"nrep\": %d, "
+            "\"min_s\": %g, \"mean_s\": %g, \"nnz\": %ld}\n",
+            nA, nX, kernel, nthread, t.nrep, t.min_s, t.mean_s, nnz);
+        fflush(fout);
+    }
+};
+
+// ------------------------------------------------------------
+/** Makes an Ur matrix in dense indexing, as RegridMatrices_Dynamic does */
+static long ur_nnz(IceRegridder const *regridder,
+    void (IceRegridder::*Gv)(MakeDenseEigenT::AccumT &&, char,
+        blitz::Array<double,1> const *) const,
+    blitz::Array<double,1> const *elevmaskI)
+{
+    SparseSetT dimG, dimB;
+    EigenSparseMatrixT M(MakeDenseEigenT(
+        std::bind(Gv, regridder, _1, 'X', elevmaskI),
+        {SparsifyTransform::ADD_DENSE},
+        {&dimG, &dimB}, '.').to_eigen());
+    return M.nonZeros();
+}
+
+/** XvE in dense indexing --> XuE with E in sparse indexing, as
+GCMCoupler does before compute_E1vE0c().  X must be ID-indexed. */
+static std::unique_ptr<linear::Weighted_Eigen> sparsify_E(
+    linear::Weighted_Eigen const &XvE, long nE)
+{
+    std::unique_ptr<linear::Weighted_Eigen> XuE(
+        new linear::Weighted_Eigen({nullptr, nullptr}, XvE.conservative));
+    TupleListT<2> M_t;
+    spcopy(
+        accum::sparsify(
+            std::array<SparsifyTransform,2>{
+                SparsifyTransform::ID, SparsifyTransform::TO_SPARSE},
+            accum::in_index_type<int>(), XvE.dims,
+            accum::ref(M_t)),
+        *XvE.M);
+    XuE->M.reset(new EigenSparseMatrixT(XvE.M->rows(), nE));
+    XuE->M->setFromTriplets(M_t.begin(), M_t.end());
+    XuE->wM.reference(XvE.wM);
+    return XuE;
+}
+
+static void bench_size(Reporter &report, int nrep, int nA, int refine)
+{
+    // ----------------- Grids
+    SyntheticSpec spec;
+    spec.nA = nA;
+    spec.refine = refine;
+    double const dxI = 1e6 / (nA * refine);
+
+    std::unique_ptr<SyntheticGrids> sgrids;
+    Timing const t_grids(time_it(1, [&]() {
+        sgrids.reset(new SyntheticGrids(make_synthetic_grids(spec)));
+    }));
+    long const nX = sgrids->sheets[0].exgrid->nrealized();
+    report(nA, nX, "make_synthetic_grids", t_grids, nX);
+    report(nA, nX, "make_exchange_grid", time_it(1, [&]() {
+        make_exchange_grid(&*sgrids->gridA, &*sgrids->sheets[0].gridI);
+    }), nX);
+
+    auto gcm_p(sgrids->gcm_regridder());
+    GCMRegridder_Standard &gcm(*gcm_p);
+    IceRegridder const *regridder = gcm.ice_regridder(0);
+
+    blitz::Array<double,1> elevmaskI0(sgrids->elevmaskIs(0.)[0]);
+    blitz::Array<double,1> elevmaskI1(sgrids->elevmaskIs(150.)[0]);
+
+    // ----------------- Ur matrices
+    long nnz = 0;
+    report(nA, nX, "GvEp", time_it(nrep, [&]() {
+        nnz = ur_nnz(regridder, &IceRegridder::GvEp, &elevmaskI0);
+    }), nnz);
+    report(nA, nX, "GvI", time_it(nrep, [&]() {
+        nnz = ur_nnz(regridder, &IceRegridder::GvI, &elevmaskI0);
+    }), nnz);
+    report(nA, nX, "GvAp", time_it(nrep, [&]() {
+        nnz = ur_nnz(regridder, &IceRegridder::GvAp, &elevmaskI0);
+    }), nnz);
+
+    // ----------------- Regrid matrices
+    // AvI, EvI: compute_AEvI; IvA, IvE: compute_IvAE; EvA: compute_EvA.
+    // A fresh RegridMatrices_Dynamic each time, so nothing is memoized.
+    RegridParams const params(true, true, {0,0,0});
+    for (char const *spec : {"AvI", "EvI", "IvA", "IvE", "EvA"}) {
+        report(nA, nX, spec, time_it(nrep, [&]() {
+            std::array<SparseSetT,2> dims;
+            auto rm(gcm.regrid_matrices(0, elevmaskI0, params));
+            nnz = rm->matrix_d(spec, {&dims[0], &dims[1]}, params)->M->nonZeros();
+        }), nnz);
+    }
+
+    // ----------------- Smoothing
+    {
+        SparseSetT dimI, dimE;
+        auto rm(gcm.regrid_matrices(0, elevmaskI0, params));
+        auto IvE(rm->matrix_d("IvE", {&dimI, &dimE}, params));
+        std::array<double,3> const sigma {2*dxI, 2*dxI, 200.};
+        report(nA, nX, "smoothing_matrix", time_it(nrep, [&]() {
+            TupleListT<2> smoothI({dimI.dense_extent(), dimI.dense_extent()});
+            smoothing_matrix(smoothI, regridder->agridI,
+                dimI, elevmaskI0, IvE->wM, sigma);
+            nnz = smoothI.tuples.size();
+        }), nnz);
+    }
+
+    // ----------------- E1vE0c, between two elevmasks
+    {
+        std::vector<double> areaX;
+        for (int id=0; id<regridder->aexgrid.dense_extent(); ++id)
+            areaX.push_back(regridder->aexgrid.native_area(id));
+
+        RegridParams const paramsX(false, true, {0,0,0});
+        std::array<SparseSetT,2> dims0, dims1;
+        std::vector<std::unique_ptr<linear::Weighted_Eigen>> XuE0s, XuE1s;
+        for (auto *em : {&elevmaskI0, &elevmaskI1}) {
+            auto &dims(em == &elevmaskI0 ? dims0 : dims1);
+            dims[0] = id_sparse_set<SparseSetT>(regridder->nX());
+            auto rm(gcm.regrid_matrices(0, *em, paramsX));
+            auto XuE(rm->matrix_d("XvE", {&dims[0], &dims[1]}, paramsX));
+            (em == &elevmaskI0 ? XuE0s : XuE1s).push_back(
+                sparsify_E(*XuE, gcm.nE()));
+        }
+        report(nA, nX, "compute_E1vE0c", time_it(nrep, [&]() {
+            nnz = e1ve0::compute_E1vE0c(XuE1s, XuE0s, gcm.nE(), areaX).tuples.size();
+        }), nnz);
+    }
+
+#ifdef BUILD_MODELE
+    // ----------------- Hntr, between lon/lat grids of similar size
+    {
+        using namespace icebin::modele;
+        HntrSpec const specA(2*nA*refine, nA*refine, 0., 180.*60. / (nA*refine));
+        HntrSpec const specB(2*nA, nA, 0., 180.*60. / nA);
+        auto WTA(hntr_array<double>(specA));
+        auto A(hntr_array<double>(specA));
+        auto B(hntr_array<double>(specB));
+        WTA = 1.;
+        A = 1.;
+
+        Hntr hntr(17.17, specB, specA, 0);
+        report(nA, nX, "Hntr::regrid", time_it(nrep, [&]() {
+            hntr.regrid(WTA, A, B);
+        }));
+
+        TupleListT<2> overlap;
+        report(nA, nX, "Hntr::overlap", time_it(nrep, [&]() {
+            overlap.clear();
+            hntr.overlap(overlap, 1.0);
+        }), overlap.tuples.size());
+    }
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    std::string ofname;
+    int nrep = 5;
+    int refine = 4;
+    std::vector<int> sizes;
+
+    for (int i=1; i<argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            ofname = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            nrep = atoi(argv[++i]);
+            if (nrep < 1) (*icebin_error)(-1,
+                "Repetition count must be a positive integer: %s", argv[i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+            refine = atoi(argv[++i]);
+            if (refine < 1) (*icebin_error)(-1,
+                "Refinement must be a positive integer: %s", argv[i]);
+        } else {
+            sizes.push_back(atoi(argv[i]));
+            if (sizes.back() <= 0) (*icebin_error)(-1,
+                "Grid size must be a positive integer: %s", argv[i]);
+        }
+    }
+
+    // Default ladder: about 1e4, 1e5 and 1e6 exchange cells
+    if (sizes.size() == 0) sizes = {25, 80, 250};
+
+    FILE *fout = stdout;
+    if (ofname != "") {
+        fout = fopen(ofname.c_str(), "w");
+        if (!fout) (*icebin_error)(-1,
+            "Cannot open %s", ofname.c_str());
+    }
+
+    Reporter report(fout);
+    for (int nA : sizes) bench_size(report, nrep, nA, refine);
+
+    if (fout != stdout) fclose(fout);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICEBIN_TESTS_REGRID_TEST_UTIL_HPP
+#define ICEBIN_TESTS_REGRID_TEST_UTIL_HPP
+
+// Helpers shared by the gtests that compare regrid matrices
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <gtest/gtest.h>
+#include <icebin/RegridMatrices_Dynamic.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+
+namespace icebin {
+namespace test_util {
+
+/** A small synthetic setup: 6x6 GCM cells, 18x18 ice cells, 4 ECs */
+inline SyntheticSpec small_spec()
+{
+    SyntheticSpec spec;
+    spec.nA = 6;
+    spec.refine = 3;
+    spec.nhc = 4;
+    return spec;
+}
+
+/** A regrid matrix in sparse indexing, so builds can be compared even
+if their dims were numbered in a different order. */
+struct SparseMatrix {
+    std::map<std::array<long,2>, double> M;
+    std::map<long, double> wM, Mw;
+};
+
+/** Converts BvA to sparse indexing, with the sparse A index
+optionally mapped through to_A (eg to aggregate fine cells into
+coarse cells); elements that map to the same place are summed. */
+template<class ToA>
+SparseMatrix to_sparse(linear::Weighted_Eigen const &BvA,
+    std::array<SparseSetT,2> const &dims, ToA const &to_A)
+{
+    SparseMatrix ret;
+    EigenSparseMatrixT const &M(*BvA.M);
+    for (int k=0; k<M.outerSize(); ++k) {
+    for (EigenSparseMatrixT::InnerIterator it(M, k); it; ++it) {
+        ret.M[std::array<long,2>{dims[0].to_sparse(it.row()),
+            to_A(dims[1].to_sparse(it.col()))}] += it.value();
+    }}
+    for (int i=0; i<BvA.wM.extent(0); ++i) ret.wM[dims[0].to_sparse(i)] += BvA.wM(i);
+    for (int j=0; j<BvA.Mw.extent(0); ++j) ret.Mw[to_A(dims[1].to_sparse(j))] += BvA.Mw(j);
+    return ret;
+}
+
+inline SparseMatrix to_sparse(linear::Weighted_Eigen const &BvA,
+    std::array<SparseSetT,2> const &dims)
+{
+    return to_sparse(BvA, dims, [](long iA) { return iA; });
+}
+
+/** Expects a and b to have the same keys, and values equal to within
+a relative tolerance rtol (absolute for values smaller than 1). */
+template<class KeyT>
+void expect_near(std::map<KeyT,double> const &a, std::map<KeyT,double> const &b,
+    double rtol)
+{
+    ASSERT_EQ(a.size(), b.size());
+    for (auto ia(a.begin()), ib(b.begin()); ia != a.end(); ++ia, ++ib) {
+        ASSERT_TRUE(ia->first == ib->first);
+        EXPECT_NEAR(ia->second, ib->second, rtol * std::max(1., std::abs(ia->second)));
+    }
+}
+
+inline void expect_near(SparseMatrix const &a, SparseMatrix const &b, double rtol)
+{
+    expect_near(a.M, b.M, rtol);
+    expect_near(a.wM, b.wM, rtol);
+    expect_near(a.Mw, b.Mw, rtol);
+}
+
+}}    // namespace icebin::test_util
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// https://github.com/google/googletest/blob/master/googletest/docs/Primer.md
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <netcdf>
+#include <gtest/gtest.h>
+#include <icebin/bincsr.hpp>
+#include <icebin/AbbrGrid.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+
+using namespace ibmisc;
+using namespace icebin;
+using namespace netCDF;
+
+/** Bitwise comparison, so NaNs and signed zeros count */
+template<class T>
+static void expect_bits(T const *a, T const *b, long n)
+{
+    for (long i=0; i<n; ++i)
+        EXPECT_EQ(0, memcmp(a+i, b+i, sizeof(T))) << "at index " << i;
+}
+
+class BinCSRTest : public ::testing::Test {
+protected:
+    std::vector<std::string> tmpfiles;
+
+    virtual ~BinCSRTest()
+    {
+        for (auto const &fname : tmpfiles) ::remove(fname.c_str());
+    }
+
+    /** Writes an nrow x ncol matrix with bincsr, maps it back and
+    checks every section against what was written. */
+    void round_trip(std::string const &fname, long nrow, long ncol)
+    {
+        tmpfiles.push_back(fname);
+
+        // Dims: every third sparse index
+        std::array<SparseSetT,2> dims;
+        dims[0].set_sparse_extent(3*nrow);
+        dims[1].set_sparse_extent(3*ncol);
+        for (long i=0; i<nrow; ++i) dims[0].add_dense(3*i+1);
+        for (long j=0; j<ncol; ++j) dims[1].add_dense(3*j+2);
+
+        std::vector<Eigen::Triplet<double>> triplets;
+        for (long i=0; i<nrow; ++i)
+        for (long j=0; j<ncol; ++j) {
+            if ((i + 2*j) % 3 == 0) triplets.push_back(
+                Eigen::Triplet<double>(i, j, 1. + i + .5*j));
+        }
+        EigenSparseMatrixT M(nrow, ncol);
+        M.setFromTriplets(triplets.begin(), triplets.end());
+
+        // The last weight of each vector is the one most likely clobbered
+        blitz::Array<double,1> wM(nrow), Mw(ncol);
+        for (long i=0; i<nrow; ++i) wM(i) = .25 + i;
+        for (long j=0; j<ncol; ++j) Mw(j) = -.75 - j;
+        if (nrow > 0) wM(nrow-1) = 4321.;
+        if (ncol > 0) Mw(ncol-1) = 1234.;
+
+        write_bincsr(fname, {&dims[0], &dims[1]}, M, wM, Mw, true);
+        MappedCSR bcsr(fname);
+
+        EXPECT_TRUE(bcsr.conservative());
+        EXPECT_EQ(3*nrow, bcsr.shape()[0]);
+        EXPECT_EQ(3*ncol, bcsr.shape()[1]);
+        ASSERT_EQ((long)M.nonZeros(), bcsr.nnz());
+
+        for (int k=0; k<2; ++k) {
+            blitz::Array<int,1> dim(bcsr.dim(k));
+            ASSERT_EQ(dims[k].dense_extent(), dim.extent(0));
+            for (int i=0; i<dim.extent(0); ++i)
+                EXPECT_EQ(dims[k].to_sparse(i), dim(i));
+        }
+
+        MappedCSR::SparseMatrixT Mr(M);
+        Mr.makeCompressed();
+        MappedCSR::MapT Mm(bcsr.M());
+        ASSERT_EQ(nrow, Mm.rows());
+        ASSERT_EQ(ncol, Mm.cols());
+        expect_bits(Mr.outerIndexPtr(), Mm.outerIndexPtr(), nrow+1);
+        expect_bits(Mr.innerIndexPtr(), Mm.innerIndexPtr(), Mr.nonZeros());
+        expect_bits(Mr.valuePtr(), Mm.valuePtr(), Mr.nonZeros());
+
+        blitz::Array<double,1> wM1(bcsr.wM()), Mw1(bcsr.Mw());
+        ASSERT_EQ(nrow, wM1.extent(0));
+        ASSERT_EQ(ncol, Mw1.extent(0));
+        expect_bits(wM.data(), wM1.data(), nrow);
+        expect_bits(Mw.data(), Mw1.data(), ncol);
+    }
+
+    /** Writes gridA of a synthetic grid set to NetCDF, then reads it
+    back through AbbrGrid::ncio(), from the NetCDF file and from a
+    bingrid sidecar; both must match what was written. */
+    void round_trip_grid(std::string const &fname, bool lonlat)
+    {
+        SyntheticSpec spec;
+        spec.nA = 4;
+        spec.refine = 2;
+        spec.nhc = 2;
+        spec.lonlat = lonlat;
+        SyntheticGrids sgrids(make_synthetic_grids(spec));
+        AbbrGrid agrid(*sgrids.gridA);
+        long const nd = agrid.dim.dense_extent();
+        bool const has_centroid = (agrid.centroid_xy().extent(0) > 0);
+        EXPECT_EQ(!lonlat, has_centroid);
+
+        std::string const bgrid_fname(bingrid_fname(fname, "agridA"));
+        tmpfiles.push_back(fname);
+        tmpfiles.push_back(bgrid_fname);
+        ::remove(bgrid_fname.c_str());
+        {
+            NcIO ncio(fname, NcFile::replace);
+            agrid.ncio(ncio, "agridA");
+        }
+
+        // No sidecar yet: read from NetCDF
+        AbbrGrid nc_grid;
+        {
+            NcIO ncio(fname, NcFile::read);
+            nc_grid.ncio(ncio, "agridA");
+        }
+        EXPECT_FALSE(nc_grid._arrays->mapped);
+
+        write_bingrid(bgrid_fname, agrid);
+        AbbrGrid mapped_grid;
+        {
+            NcIO ncio(fname, NcFile::read);
+            mapped_grid.ncio(ncio, "agridA");
+        }
+        ASSERT_TRUE((bool)mapped_grid._arrays->mapped);
+
+        for (AbbrGrid const *g : {&nc_grid, &mapped_grid}) {
+            ASSERT_EQ(nd, g->dim.dense_extent());
+            for (long id=0; id<nd; ++id) {
+                EXPECT_EQ(agrid.dim.to_sparse(id), g->dim.to_sparse(id));
+                for (int k=0; k<3; ++k)
+                    EXPECT_EQ(agrid.ijk(id,k), g->ijk(id,k));
+                expect_bits(&agrid.native_area()(id), &g->native_area()(id), 1);
+            }
+        }
+
+        // NetCDF and bingrid alike hold no centroids if there were none
+        blitz::Array<double,2> const &centroid_xy(mapped_grid.centroid_xy());
+        ASSERT_EQ(has_centroid ? nd : 0, centroid_xy.extent(0));
+        for (long id=0; id<centroid_xy.extent(0); ++id)
+        for (int k=0; k<2; ++k) {
+            expect_bits(&agrid.centroid_xy()(id,k), &centroid_xy(id,k), 1);
+            expect_bits(&nc_grid.centroid_xy()(id,k), &centroid_xy(id,k), 1);
+        }
+    }
+};
+
+TEST_F(BinCSRTest, round_trip)
+{
+    round_trip("__bincsr_test.bcsr", 7, 5);
+    round_trip("__bincsr_square_test.bcsr", 4, 4);
+    round_trip("__bincsr_1x1_test.bcsr", 1, 1);
+}
+
+/** Last section is centroid_xy */
+TEST_F(BinCSRTest, bingrid_round_trip)
+{
+    round_trip_grid("__bingrid_test.nc", false);
+}
+
+/** No centroids: last section is native_area */
+TEST_F(BinCSRTest, bingrid_round_trip_no_centroid)
+{
+    round_trip_grid("__bingrid_lonlat_test.nc", true);
+}
+
+// ------------------------------------------------------------
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <icebin/GCMRegridder.hpp>
+#include <icebin/CoarseIceRegridder.hpp>
+#include <icebin/RegridMatrices_Dynamic.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+#include "regrid_test_util.hpp"
+
+using namespace ibmisc;
+using namespace icebin;
+using icebin::test_util::SparseMatrix;
+using icebin::test_util::to_sparse;
+using icebin::test_util::expect_near;
+
+/** Tolerance of the aggregated sums, which add up in a different order */
+double const rtol = 1e-9;
+
+// The fixture for testing CoarseIceRegridder
+class CoarseRegridderTest : public ::testing::Test {
+protected:
+    SyntheticGrids sgrids;
+    std::unique_ptr<GCMRegridder_Standard> gcm;
+
+    CoarseRegridderTest() :
+        sgrids(make_synthetic_grids(icebin::test_util::small_spec())),
+        gcm(sgrids.gcm_regridder()) {}
+};
+
+/** With ice of uniform elevation everywhere, the coarse sheet sees the
+GCM grid exactly as the fine one does: each unscaled coarse AvI / EvI
+element must be the sum of the fine elements of its block. */
+TEST_F(CoarseRegridderTest, matrices_aggregate)
+{
+    IceRegridder const *fine = gcm->ice_regridder(0);
+    blitz::Array<double,1> elevmaskI(fine->nI());
+    elevmaskI = 1000.;
+    RegridParams const params(false, false, {0.,0.,0.});    // Unscaled
+
+    for (int k : {1, 3, 4}) {    // k=4: the last block in each direction is partial
+        CoarseIceRegridder coarse(fine, k);
+        blitz::Array<double,1> elevmaskIc(coarse.elevmask(elevmaskI));
+        EXPECT_EQ(coarse.nIc(), elevmaskIc.extent(0));
+
+        for (char const *spec : {"AvI", "EvI"}) {
+            SCOPED_TRACE(std::string(spec) + " k=" + std::to_string(k));
+
+            std::array<SparseSetT,2> dims;
+            auto rm(gcm->regrid_matrices(0, elevmaskI, params));
+            auto BvI(rm->matrix_d(spec, {&dims[0], &dims[1]}, params));
+            SparseMatrix const expected(to_sparse(*BvI, dims,
+                [&coarse](long iI) { return coarse.to_coarse(iI); }));
+
+            std::array<SparseSetT,2> dimsc;
+            auto rmc(gcm->regrid_matrices(&*coarse.regridder, elevmaskIc, params));
+            auto BvIc(rmc->matrix_d(spec, {&dimsc[0], &dimsc[1]}, params));
+            SparseMatrix const got(to_sparse(*BvIc, dimsc));
+
+            EXPECT_LT(0, got.M.size());
+            expect_near(got, expected, rtol);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/compact_e.hpp>
+
+using namespace icebin;
+
+TEST(CompactETest, numbering)
+{
+    // Points are numbered in order of first use
+    CompactE dimEc(1000);
+    EXPECT_EQ(0, dimEc.add(517));
+    EXPECT_EQ(1, dimEc.add(3));
+    EXPECT_EQ(0, dimEc.add(517));
+    EXPECT_EQ(2, dimEc.add(999));
+    EXPECT_EQ(3, dimEc.size());
+    EXPECT_EQ(1000, dimEc.sparse_extent());
+
+    EXPECT_EQ(1, dimEc.to_compact(3));
+    EXPECT_EQ(-1, dimEc.to_compact(4));
+    for (int iEc=0; iEc<dimEc.size(); ++iEc)
+        EXPECT_EQ(iEc, dimEc.to_compact(dimEc.to_sparse(iEc)));
+
+    // Restored numbering is the same, and keeps growing from there
+    CompactE dimEc2;
+    dimEc2.reset(1000, dimEc.sparse_indices());
+    EXPECT_EQ(std::vector<long>({517, 3, 999}), dimEc2.sparse_indices());
+    EXPECT_EQ(3, dimEc2.add(0));
+}
@@ -0,0 +1,196 @@
+# IceBin: A Coupling Library for Ice Models and GCMs
+# Copyright (c) 2013-2016 by Elizabeth Fischer
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Performance-and-conservation regression harness.
+
+For each regrid matrix spec and smoothing setting, records (as one
+JSON object per line) the time to build the matrix, its nnz, peak RSS
+and the relative conservation error of regridding a test field.  Each
+case runs in its own process, so peak RSS belongs to that case alone.
+
+Compared against a baseline (written with --write-baseline), it fails
+(exit status 1) if build time or peak RSS grew by more than a
+tolerance, or if any conservative matrix (conserve=True) no longer
+conserves to within --cons-tol.  That catches optimizations
+(truncation, float32, fused kernels) that trade away conservation.
+
+    python3 perf_conserv.py synthetic.nc --sigma 0,0,0 --sigma 5000,5000,100 \\
+        --baseline perf_baseline.json
+
+The regridder file must hold elevmaskI for the sheet, as
+elevmaskI.<sheet> (as written by synthetic_grids), or see --elevmask."""
+
+import argparse
+import json
+import os
+import resource
+import subprocess
+import sys
+import time
+
+specs = ('AvI', 'IvA', 'EvI', 'IvE', 'EvA', 'AvE')
+
+def peak_rss_mb():
+    """Peak resident set size of this process so far (MiB)"""
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # Linux reports KiB, macOS bytes
+    return rss / (1024.*1024. if sys.platform == 'darwin' else 1024.)
+
+def read_elevmaskI(regridder_fname, elevmask, sheet):
+    import numpy as np
+    import netCDF4
+    if elevmask is None:
+        fname, vname = regridder_fname, 'elevmaskI.{}'.format(sheet)
+    else:
+        fname, vname = elevmask.split(':')
+    with netCDF4.Dataset(fname) as nc:
+        return np.ma.filled(nc.variables[vname][:], np.nan).reshape(-1)
+
+def run_case(args, spec, sigma, conserve):
+    """Builds one matrix and measures it; run in a child process."""
+    import numpy as np
+    import icebin
+
+    mm = icebin.GCMRegridder(args.regridder)
+    elevmaskI = read_elevmaskI(args.regridder, args.elevmask, args.sheet)
+    rss0 = peak_rss_mb()
+
+    build_s = None
+    for i in range(args.nrep):
+        t0 = time.perf_counter()
+        rm = mm.regrid_matrices(args.sheet, elevmaskI,
+            scale=True, correctA=True, sigma=sigma, conserve=conserve)
+        M, wM, Mw, dims = rm.matrix_scipy(spec)
+        dt = time.perf_counter() - t0
+        build_s = dt if build_s is None else min(build_s, dt)
+        if i < args.nrep-1:
+            del rm, M, wM, Mw, dims
+
+    # Scaled M: sum_i wM[i]*M[i,j] == Mw[j] iff M conserves
+    valA = np.random.RandomState(17).uniform(.5, 1.5, M.shape[1])
+    massA = np.nansum(Mw * valA)
+    massB = np.nansum(wM * M.dot(valA))
+
+    return {
+        'spec': spec, 'sigma': list(sigma), 'conserve': conserve,
+        'build_s': build_s, 'nnz': int(M.nnz),
+        'peak_rss_mb': peak_rss_mb(), 'rss_delta_mb': peak_rss_mb() - rss0,
+        'conserv_err': float(abs(massB - massA) / abs(massA))}
+
+def case_key(rec):
+    return (rec['spec'], tuple(rec['sigma']), rec['conserve'])
+
+def check(recs, baseline, args):
+    """@return List of failure messages"""
+    base = {case_key(r) : r for r in baseline}
+    failures = list()
+    for rec in recs:
+        name = '{} sigma={} conserve={}'.format(rec['spec'], rec['sigma'], rec['conserve'])
+        if rec['conserve'] and not (rec['conserv_err'] <= args.cons_tol):
+            failures.append('{}: conservation error {:g} > {:g}'.format(
+                name, rec['conserv_err'], args.cons_tol))
+
+        b = base.get(case_key(rec))
+        if b is None:
+            continue
+        if rec['build_s'] > b['build_s'] * (1. + args.time_tol):
+            failures.append('{}: build time {:g}s > {:g}s baseline'.format(
+                name, rec['build_s'], b['build_s']))
+        if rec['peak_rss_mb'] > b['peak_rss_mb'] * (1. + args.rss_tol):
+            failures.append('{}: peak RSS {:g}MiB > {:g}MiB baseline'.format(
+                name, rec['peak_rss_mb'], b['peak_rss_mb']))
+    return failures
+
+def parse_sigma(s):
+    sigma = tuple(float(x) for x in s.split(','))
+    if len(sigma) != 3:
+        raise argparse.ArgumentTypeError('sigma must be sigma_x,sigma_y,sigma_z')
+    return sigma
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('regridder', nargs='?', default='icebin_in.nc',
+        help='GCMRegridder file')
+    parser.add_argument('--sheet', default='sheet0')
+    parser.add_argument('--elevmask', default=None,
+        help='file:variable holding elevmaskI (default: elevmaskI.<sheet> in the regridder file)')
+    parser.add_argument('--spec', action='append', choices=specs,
+        help='Matrices to build (default: all)')
+    parser.add_argument('--sigma', action='append', type=parse_sigma,
+        help='Smoothing setting sigma_x,sigma_y,sigma_z (repeatable; default: 0,0,0)')
+    parser.add_argument('--no-conserve', action='store_true',
+        help='Also run each case with conserve=False (recorded, not checked)')
+    parser.add_argument('--nrep', type=int, default=3,
+        help='Build each matrix this many times; keep the fastest')
+    parser.add_argument('-o', '--out', default=None,
+        help='Write results here (JSON lines), as well as to stdout')
+    parser.add_argument('--baseline', default=None,
+        help='Compare with results from an earlier run')
+    parser.add_argument('--write-baseline', action='store_true',
+        help='Write results to --baseline instead of comparing')
+    parser.add_argument('--time-tol', type=float, default=.25,
+        help='Allowed relative increase in build time')
+    parser.add_argument('--rss-tol', type=float, default=.25,
+        help='Allowed relative increase in peak RSS')
+    parser.add_argument('--cons-tol', type=float, default=1e-10,
+        help='Allowed relative conservation error')
+    parser.add_argument('--case', default=None, help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    # Child process: run one case, report on stdout
+    if args.case is not None:
+        spec, sigma, conserve = json.loads(args.case)
+        print(json.dumps(run_case(args, spec, tuple(sigma), conserve)))
+        return 0
+
+    cases = [(spec, sigma, conserve)
+        for spec in (args.spec or specs)
+        for sigma in (args.sigma or [(0.,0.,0.)])
+        for conserve in ((True, False) if args.no_conserve else (True,))]
+
+    child_args = list(sys.argv[1:])
+    recs = list()
+    for spec, sigma, conserve in cases:
+        out = subprocess.check_output([sys.executable, os.path.abspath(__file__)]
+            + child_args + ['--case', json.dumps([spec, sigma, conserve])])
+        rec = json.loads(out.decode().strip().split('\n')[-1])
+        print(json.dumps(rec))
+        sys.stdout.flush()
+        recs.append(rec)
+
+    if args.out is not None:
+        with open(args.out, 'w') as fout:
+            for rec in recs:
+                fout.write(json.dumps(rec) + '\n')
+
+    if args.baseline is not None and args.write_baseline:
+        with open(args.baseline, 'w') as fout:
+            for rec in recs:
+                fout.write(json.dumps(rec) + '\n')
+        return 0
+
+    baseline = list()
+    if args.baseline is not None:
+        with open(args.baseline) as fin:
+            baseline = [json.loads(line) for line in fin if line.strip()]
+
+    failures = check(recs, baseline, args)
+    for msg in failures:
+        print('FAIL', msg)
+    return 1 if failures else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
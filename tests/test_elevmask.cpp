@@ -0,0 +1,146 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// https://github.com/google/googletest/blob/master/googletest/docs/Primer.md
+
+#include <cmath>
+#include <cstdio>
+#include <netcdf>
+#include <gtest/gtest.h>
+#include <icebin/ElevMask.hpp>
+
+using namespace icebin;
+using namespace netCDF;
+
+class ElevMaskTest : public ::testing::Test {
+protected:
+    std::vector<std::string> tmpfiles;
+
+    virtual ~ElevMaskTest()
+    {
+        for (auto const &fname : tmpfiles) ::remove(fname.c_str());
+    }
+
+    /** Writes a PISM-like state file with ntime records of a (ny, nx)
+    grid.  Cell k of record t has topg=100*t+k, thk=10 and mask
+    cycling through bedrock, grounded, floating and ocean.
+    @param nx_mask Size of the x dimension of mask */
+    void write_pism(std::string const &fname,
+        size_t ntime, size_t ny, size_t nx, size_t nx_mask)
+    {
+        tmpfiles.push_back(fname);
+        NcFile nc(fname, NcFile::replace);
+        NcDim time_d = nc.addDim("time", ntime);
+        NcDim y_d = nc.addDim("y", ny);
+        NcDim x_d = nc.addDim("x", nx);
+        NcDim xm_d = (nx_mask == nx ? x_d : nc.addDim("x_mask", nx_mask));
+        NcVar topg_v = nc.addVar("topg", ncDouble, {time_d, y_d, x_d});
+        NcVar thk_v = nc.addVar("thk", ncDouble, {time_d, y_d, x_d});
+        NcVar mask_v = nc.addVar("mask", ncByte, {time_d, y_d, xm_d});
+
+        std::vector<double> topg, thk;
+        for (size_t t=0; t<ntime; ++t)
+        for (size_t k=0; k<ny*nx; ++k) {
+            topg.push_back(100.*t + k);
+            thk.push_back(10.);
+        }
+        std::vector<signed char> mask;
+        for (size_t k=0; k<ntime*ny*nx_mask; ++k) mask.push_back(mask_of(k));
+        topg_v.putVar(topg.data());
+        thk_v.putVar(thk.data());
+        mask_v.putVar(mask.data());
+    }
+
+    // ICE_FREE_BEDROCK, GROUNDED_ICE, FLOATING_ICE, ICE_FREE_OCEAN
+    static signed char mask_of(size_t k)
+    {
+        static signed char const masks[] = {0, 2, 3, 4};
+        return masks[k % 4];
+    }
+
+    /** Checks one cell of elevmask against what write_pism() wrote */
+    static void expect_cell(size_t itime, size_t k, double em_land, double em_ice)
+    {
+        double const topg = 100.*itime + k;
+        switch(mask_of(k)) {
+            case 0 :
+                EXPECT_EQ(topg, em_land);
+                EXPECT_TRUE(std::isnan(em_ice));
+            break;
+            case 2 :
+            case 3 :
+                EXPECT_EQ(topg + 10., em_land);
+                EXPECT_EQ(topg + 10., em_ice);
+            break;
+            default :
+                EXPECT_TRUE(std::isnan(em_land));
+                EXPECT_TRUE(std::isnan(em_ice));
+            break;
+        }
+    }
+};
+
+TEST_F(ElevMaskTest, read_records)
+{
+    size_t const ntime=3, ny=4, nx=5;
+    std::string const fname("__elevmask_test.nc");
+    write_pism(fname, ntime, ny, nx, nx);
+
+    ElevMaskReader_PISM reader(fname);
+    EXPECT_EQ(ntime, reader.ntime());
+    EXPECT_EQ(ny*nx, reader.nI());
+
+    // Whole records, reusing the output arrays
+    blitz::Array<double,1> emI_land, emI_ice;
+    for (size_t itime=0; itime<ntime; ++itime) {
+        reader.read(itime, emI_land, emI_ice);
+        ASSERT_EQ((int)(ny*nx), emI_land.extent(0));
+        ASSERT_EQ((int)(ny*nx), emI_ice.extent(0));
+        for (size_t k=0; k<ny*nx; ++k)
+            expect_cell(itime, k, emI_land(k), emI_ice(k));
+    }
+
+    // A window: rows [1,3), columns [2,5) of record 1
+    std::vector<double> win_land(2*3), win_ice(2*3);
+    reader.read(1, 1, 2, 2, 3, win_land.data(), win_ice.data());
+    for (size_t j=0; j<2; ++j)
+    for (size_t i=0; i<3; ++i) {
+        size_t const k = (1+j)*nx + (2+i);
+        expect_cell(1, k, win_land[j*3+i], win_ice[j*3+i]);
+    }
+
+    // read_elevmask_pism() allocates and reads one record
+    blitz::Array<double,1> em_land1, em_ice1;
+    read_elevmask_pism(fname, 2, em_land1, em_ice1);
+    for (size_t k=0; k<ny*nx; ++k)
+        expect_cell(2, k, em_land1(k), em_ice1(k));
+}
+
+TEST_F(ElevMaskTest, mismatched_dims)
+{
+    std::string const fname("__elevmask_mismatched_test.nc");
+    write_pism(fname, 2, 3, 4, 5);    // mask has a different x dimension
+
+    EXPECT_DEATH(ElevMaskReader_PISM reader(fname), "");
+}
+
+// ------------------------------------------------------------
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
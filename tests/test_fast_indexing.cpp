@@ -0,0 +1,71 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <icebin/fast_indexing.hpp>
+
+using namespace icebin;
+using namespace ibmisc;
+
+// The fixture for testing class FastIndexing
+class FastIndexingTest : public ::testing::Test {};
+
+TEST_F(FastIndexingTest, rank2)
+{
+    // As for indexingHC: row-major and column-major
+    for (int order=0; order<2; ++order) {
+        Indexing const indexing({"A", "HC"}, {0,0}, {7,3},
+            order == 0 ? std::vector<int>{0,1} : std::vector<int>{1,0});
+        FastIndexing<2> const fast(indexing);
+        EXPECT_TRUE(fast.valid());
+
+        for (long i=0; i<7; ++i) {
+        for (long j=0; j<3; ++j) {
+            long const ix = indexing.tuple_to_index<long,2>({i,j});
+            EXPECT_EQ(ix, fast.tuple_to_index({i,j}));
+            auto const tuple(fast.index_to_tuple<int>(ix));
+            EXPECT_EQ(i, tuple[0]);
+            EXPECT_EQ(j, tuple[1]);
+        }}
+    }
+}
+
+TEST_F(FastIndexingTest, rank3)
+{
+    // As for indexingE on a lon/lat grid; with a non-zero base
+    Indexing const indexing({"i", "j", "ihc"}, {1,1,0}, {5,4,3}, {2,1,0});
+    FastIndexing<3> const fast(indexing);
+
+    for (long i=1; i<=5; ++i) {
+    for (long j=1; j<=4; ++j) {
+    for (long k=0; k<3; ++k) {
+        long const ix = indexing.tuple_to_index<long,3>({i,j,k});
+        EXPECT_EQ(ix, fast.tuple_to_index({i,j,k}));
+        auto const tuple(fast.index_to_tuple(ix));
+        EXPECT_EQ(i, tuple[0]);
+        EXPECT_EQ(j, tuple[1]);
+        EXPECT_EQ(k, tuple[2]);
+    }}}
+
+    EXPECT_FALSE(FastIndexing<3>().valid());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -23,6 +23,8 @@
 #include <netcdf>
 #include <gtest/gtest.h>
 #include <icebin/Grid.hpp>
+#include <icebin/FlatGrid.hpp>
+#include <icebin/AbbrGrid.hpp>
 #include <icebin/GridSpec.hpp>
 #include <icebin/gridgen/GridGen_LonLat.hpp>
 #ifdef BUILD_MODELE
@@ -226,6 +228,63 @@ TEST_F(GridTest, create_grid)
 
 }
 
+TEST_F(GridTest, nc_read_filtered)
+{
+    // 4x2 cells on a 5x3 lattice of vertices
+    Grid grid;
+    grid.spec.reset(new GridSpec_XY("", {1,0}, {}, {}));
+    grid.name = "Test Grid";
+    grid.coordinates = GridCoordinates::XY;
+    grid.parameterization = GridParameterization::L0;
+
+    auto &vertices(grid.vertices);
+    for (int j=0; j<3; ++j)
+    for (int i=0; i<5; ++i) vertices.add(Vertex(i,j));
+
+    for (int j=0; j<2; ++j)
+    for (int i=0; i<4; ++i) {
+        long const v0 = j*5 + i;
+        Cell *cell = grid.cells.add(Cell({vertices.at(v0), vertices.at(v0+1),
+            vertices.at(v0+6), vertices.at(v0+5)}));
+        cell->i = i;
+        cell->j = j;
+        cell->native_area = 1. + cell->index;
+    }
+
+    std::string fname("__netcdf_filtered_test.nc");
+    tmpfiles.push_back(fname);
+    ::remove(fname.c_str());
+    {
+        ibmisc::NcIO ncio(fname, NcFile::replace);
+        grid.ncio(ncio, "grid");
+        ncio.close();
+    }
+
+    auto keep_fn = [](long index) { return index % 3 != 1; };
+
+    // Expected: read everything, then filter
+    Grid expected;
+    {
+        ibmisc::NcIO ncio(fname, NcFile::read);
+        expected.ncio(ncio, "grid");
+        ncio.close();
+    }
+    expected.filter_cells(keep_fn);
+
+    Grid grid2;
+    {
+        ibmisc::NcIO ncio(fname, NcFile::read);
+        grid2.nc_read_filtered(ncio, "grid", keep_fn);
+        ncio.close();
+    }
+
+    EXPECT_EQ(5, grid2.cells.nrealized());    // Cells 1, 4 and 7 dropped
+    EXPECT_EQ(expected.cells.nfull(), grid2.cells.nfull());
+    EXPECT_EQ(expected.vertices.nfull(), grid2.vertices.nfull());
+    EXPECT_EQ(expected.vertices.nrealized(), grid2.vertices.nrealized());
+    expect_eq(grid2, expected);
+}
+
 TEST_F(GridTest, centroid)
 {
     std::vector<Vertex> vertices;
@@ -260,6 +319,76 @@ TEST_F(GridTest, centroid)
 
 }
 // ------------------------------------------------------------
+TEST_F(GridTest, make_flat_grid)
+{
+    // Keep a patch of cells, including some on the bottom row
+    for (int points_in_side=1; points_in_side<=2; ++points_in_side) {
+    for (std::vector<int> const &indices : {std::vector<int>{0,1}, std::vector<int>{1,0}}) {
+        GridSpec_LonLat spec(
+            std::vector<double>{-180., -90., 0., 90., 180.},
+            std::vector<double>{-80., -40., 0., 40., 80.},
+            indices, true, true, points_in_side, 1.0);
+        auto clip(std::bind(&SphericalClip::lonlat,
+            -100., -90., 10., 10., _2, _3, _4, _5));
+        auto row_clip(std::bind(&SphericalClip::lonlat_row,
+            -100., -90., 10., 10., _1, _2, _3, _4, _5));
+
+        FlatGrid expected(make_grid("ll", spec, clip));
+        FlatGrid grid(make_flat_grid("ll", spec, row_clip));
+
+        EXPECT_EQ(expected.vertices.index, grid.vertices.index);
+        EXPECT_EQ(expected.vertices.x, grid.vertices.x);
+        EXPECT_EQ(expected.vertices.y, grid.vertices.y);
+
+        EXPECT_EQ(expected.cells.nfull(), grid.cells.nfull());
+        EXPECT_EQ(expected.cells.index, grid.cells.index);
+        EXPECT_EQ(expected.cells.native_area, grid.cells.native_area);
+        EXPECT_EQ(expected.cells.i, grid.cells.i);
+        EXPECT_EQ(expected.cells.j, grid.cells.j);
+        EXPECT_EQ(expected.cells.vstart, grid.cells.vstart);
+        EXPECT_EQ(expected.cells.vref, grid.cells.vref);
+        EXPECT_EQ(expected.cells.x, grid.cells.x);
+        EXPECT_EQ(expected.cells.y, grid.cells.y);
+    }}
+}
+// ------------------------------------------------------------
+TEST_F(GridTest, exgrid_filter)
+{
+    ExchangeGrid exgrid;
+    for (int iA=0; iA<7; ++iA) {
+    for (int iI=0; iI<5; ++iI) {
+        exgrid.add({iA, 4-iI}, 10.*iA + iI);
+    }}
+    auto keepA = [](long iA) { return iA % 3 != 1; };
+
+    std::string fname("__exgrid_test.nc");
+    tmpfiles.push_back(fname);
+    ::remove(fname.c_str());
+    {
+        ibmisc::NcIO ncio(fname, NcFile::replace);
+        exgrid.ncio(ncio, "exgrid");
+        ncio.close();
+    }
+
+    exgrid.filter_cellsB(keepA);
+    EXPECT_EQ(25, exgrid.dense_extent());
+
+    // Read in blocks that do not line up with gridA cells
+    for (size_t block_size : {1, 3, 100}) {
+        ExchangeGrid exgrid2;
+        ibmisc::NcIO ncio(fname, NcFile::read);
+        exgrid2.ncio_read(ncio, "exgrid", keepA, block_size);
+        ncio.close();
+
+        ASSERT_EQ(exgrid.dense_extent(), exgrid2.dense_extent());
+        for (int id=0; id<exgrid.dense_extent(); ++id) {
+            EXPECT_EQ(exgrid.ijk(id,0), exgrid2.ijk(id,0));
+            EXPECT_EQ(exgrid.ijk(id,1), exgrid2.ijk(id,1));
+            EXPECT_EQ(exgrid.native_area(id), exgrid2.native_area(id));
+        }
+    }
+}
+// ------------------------------------------------------------
 #ifdef BUILD_MODELE
 
 TEST_F(GridTest, hntr)
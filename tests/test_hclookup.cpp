@@ -0,0 +1,98 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/hclookup.hpp>
+
+using namespace icebin;
+
+// The fixture for testing class HCLookup
+class HCLookupTest : public ::testing::Test {
+protected:
+    /** Checks HCLookup against std::lower_bound() on elevations
+    in and around the range of hcdefs, and on the hcdefs themselves. */
+    static void check(std::vector<double> const &hcdefs, HCLookup::Method method)
+    {
+        HCLookup const hcl(hcdefs);
+        EXPECT_EQ(method, hcl.method());
+
+        std::vector<double> xx(hcdefs);
+        double const x0 = hcdefs.front() - 100.;
+        double const x1 = hcdefs.back() + 100.;
+        std::mt19937 gen(17);
+        std::uniform_real_distribution<double> dist(x0, x1);
+        for (int i=0; i<10000; ++i) xx.push_back(dist(gen));
+        xx.push_back(std::numeric_limits<double>::quiet_NaN());
+        xx.push_back(-std::numeric_limits<double>::infinity());
+        xx.push_back(std::numeric_limits<double>::infinity());
+        xx.push_back(std::numeric_limits<double>::max());
+        xx.push_back(1e300);
+        xx.push_back(-1e300);
+        for (double x : hcdefs) {
+            xx.push_back(std::nextafter(x, x0));
+            xx.push_back(std::nextafter(x, x1));
+        }
+
+        for (double x : xx) {
+            int const i1 = std::lower_bound(hcdefs.begin(), hcdefs.end(), x) - hcdefs.begin();
+            EXPECT_EQ(i1, hcl.lower_bound(x)) << "x=" << x;
+        }
+    }
+};
+
+TEST_F(HCLookupTest, uniform)
+{
+    // As from global_ec --elev-classes -100,5000,200
+    std::vector<double> hcdefs;
+    for (double z=-100; z<5000; z += 200) hcdefs.push_back(z);
+    check(hcdefs, HCLookup::Method::SEGMENTS);
+
+    check({0., 1000.}, HCLookup::Method::SEGMENTS);
+    check({5.}, HCLookup::Method::SEGMENTS);
+}
+
+TEST_F(HCLookupTest, piecewise_uniform)
+{
+    // Local ECs followed by global ECs, as in GCMRegridder_ModelE
+    std::vector<double> hcdefs;
+    for (double z=0; z<4000; z += 100) hcdefs.push_back(z);
+    for (double z=4000; z<=4100; z += 10) hcdefs.push_back(z);
+    hcdefs.push_back(6000.);
+    check(hcdefs, HCLookup::Method::SEGMENTS);
+}
+
+TEST_F(HCLookupTest, nonuniform)
+{
+    std::vector<double> hcdefs;
+    for (int i=0; i<40; ++i) hcdefs.push_back(i*i*3. + i*.5);
+    check(hcdefs, HCLookup::Method::BUCKETS);
+}
+
+TEST_F(HCLookupTest, not_increasing)
+{
+    check({0., 100., 100., 300.}, HCLookup::Method::SEARCH);
+    check({0., 200., 100., 300.}, HCLookup::Method::SEARCH);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
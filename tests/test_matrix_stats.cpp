@@ -0,0 +1,50 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <icebin/matrix_stats.hpp>
+
+using namespace icebin;
+
+TEST(MatrixStatsTest, row_hist)
+{
+    // Row lengths 0, 1, 2, 3, 5
+    std::vector<Eigen::Triplet<double>> triplets;
+    int const lens[] = {0, 1, 2, 3, 5};
+    for (int i=0; i<5; ++i)
+        for (int j=0; j<lens[i]; ++j) triplets.push_back(Eigen::Triplet<double>(i, j, 1.));
+    EigenSparseMatrixT M(5, 6);
+    M.setFromTriplets(triplets.begin(), triplets.end());
+
+    MatrixStatsLog log;
+    log.add("AvI", M, 123, 0.5, true);
+    auto const stats(log.stats());
+    ASSERT_EQ(1, stats.size());
+    EXPECT_EQ("AvI", stats[0].name);
+    EXPECT_EQ(5, stats[0].nrow);
+    EXPECT_EQ(6, stats[0].ncol);
+    EXPECT_EQ(11, stats[0].nnz);
+    EXPECT_EQ(123, stats[0].nbytes);
+    EXPECT_TRUE(stats[0].cache_hit);
+
+    // Buckets: 0 | 1 | 2-3 | 4-7
+    EXPECT_EQ((std::vector<long>{1, 1, 2, 1}), stats[0].row_hist);
+
+    log.clear();
+    EXPECT_EQ(0, log.stats().size());
+}
@@ -0,0 +1,85 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/parallel.hpp>
+
+using namespace icebin;
+
+TEST(ParallelTest, parallel_blocks)
+{
+    // Blocks cover [0,n) exactly once, in order of ib
+    int const n = 3*PARALLEL_BLOCK + 17;
+    EXPECT_EQ(4, nparallel_blocks(n));
+    EXPECT_EQ(0, nparallel_blocks(0));
+
+    for (bool parallel : {false, true}) {
+        std::vector<int> count(n, 0);
+        std::vector<int> first(nparallel_blocks(n), -1);
+        parallel_blocks(n, parallel, [&](int ib, int i0, int i1) {
+            first[ib] = i0;
+            for (int i=i0; i<i1; ++i) ++count[i];
+        });
+        for (int i=0; i<n; ++i) EXPECT_EQ(1, count[i]);
+        for (int ib=0; ib<(int)first.size(); ++ib) EXPECT_EQ(ib*PARALLEL_BLOCK, first[ib]);
+    }
+}
+
+TEST(ParallelTest, CompensatedSum)
+{
+    // Naive summation loses the small terms entirely
+    CompensatedSum sum;
+    double naive = 0;
+    double const terms[] = {1e16, 1., 1., -1e16, 1.};
+    for (double x : terms) {
+        sum.add(x);
+        naive += x;
+    }
+    EXPECT_EQ(3., sum.value());
+    EXPECT_NE(3., naive);
+
+    // Result does not depend on the order of terms
+    CompensatedSum rsum;
+    for (int i=4; i>=0; --i) rsum.add(terms[i]);
+    EXPECT_EQ(sum.value(), rsum.value());
+}
+
+TEST(ParallelTest, init_threads)
+{
+    unsetenv("OMP_NUM_THREADS");
+
+    // Config file, then ICEBIN_NUM_THREADS over it
+    unsetenv("ICEBIN_NUM_THREADS");
+    init_threads(0, 2, 3, false, false);
+    EXPECT_EQ(3, thread_config.nthread);
+    EXPECT_EQ(2, thread_config.ranks_per_node);
+
+    setenv("ICEBIN_NUM_THREADS", "5", 1);
+    init_threads(0, 2, 3, false, false);
+    EXPECT_EQ(5, thread_config.nthread);
+#ifdef USE_OPENMP
+    EXPECT_EQ(5, max_threads());
+#endif
+
+    // Default: a share of the node
+    unsetenv("ICEBIN_NUM_THREADS");
+    init_threads(0, 1, 0, false, false);
+    EXPECT_GE(thread_config.nthread, 1);
+}
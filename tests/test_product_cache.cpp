@@ -0,0 +1,96 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/product_cache.hpp>
+
+using namespace icebin;
+
+// The fixture for testing cached_product()
+class ProductCacheTest : public ::testing::Test {
+protected:
+    /** A random sparse [nrow x ncol] matrix */
+    static EigenSparseMatrixT random_matrix(int nrow, int ncol, double density, int seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> dist(0., 1.);
+        std::vector<Eigen::Triplet<double>> triplets;
+        for (int i=0; i<nrow; ++i)
+        for (int j=0; j<ncol; ++j) {
+            if (dist(gen) < density) triplets.push_back(Eigen::Triplet<double>(i, j, dist(gen)));
+        }
+        EigenSparseMatrixT M(nrow, ncol);
+        M.setFromTriplets(triplets.begin(), triplets.end());
+        return M;
+    }
+
+    static void expect_same(EigenSparseMatrixT const &C, EigenSparseMatrixT const &C0)
+    {
+        EXPECT_EQ(C0.rows(), C.rows());
+        EXPECT_EQ(C0.cols(), C.cols());
+        EXPECT_EQ(C0.nonZeros(), C.nonZeros());
+        EXPECT_NEAR(0., EigenSparseMatrixT(C - C0).norm(), 1e-12 * C0.norm());
+    }
+};
+
+TEST_F(ProductCacheTest, same_as_eigen)
+{
+    ProductCache cache;
+    EigenSparseMatrixT A(random_matrix(300, 200, .02, 1));
+    EigenSparseMatrixT B(random_matrix(200, 250, .03, 2));
+
+    // First time: symbolic + numeric
+    expect_same(cached_product(&cache, "AB", A, B), A*B);
+    EXPECT_EQ(0, cache.nreused);
+    EXPECT_EQ(1, cache.nrebuilt);
+
+    // Same pattern, new values: numeric only
+    for (int k=0; k<A.nonZeros(); ++k) A.valuePtr()[k] *= 1.7;
+    expect_same(cached_product(&cache, "AB", A, B), A*B);
+    EXPECT_EQ(1, cache.nreused);
+    EXPECT_EQ(1, cache.nrebuilt);
+
+    // New pattern: rebuilt
+    EigenSparseMatrixT B2(random_matrix(200, 250, .03, 3));
+    expect_same(cached_product(&cache, "AB", A, B2), A*B2);
+    EXPECT_EQ(1, cache.nreused);
+    EXPECT_EQ(2, cache.nrebuilt);
+
+    // No cache
+    expect_same(cached_product(nullptr, "AB", A, B), A*B);
+}
+
+TEST_F(ProductCacheTest, uncompressed)
+{
+    ProductCache cache;
+    EigenSparseMatrixT A(random_matrix(50, 40, .1, 4));
+    EigenSparseMatrixT B(40, 30);
+    B.insert(3, 2) = 2.;
+    B.insert(7, 29) = -1.;
+    ASSERT_FALSE(B.isCompressed());
+    expect_same(cached_product(&cache, "AB", A, B), A*B);
+    expect_same(cached_product(&cache, "AB", A, B), A*B);
+    EXPECT_EQ(1, cache.nreused);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/RegridMatrices_Dynamic.hpp>
+
+using namespace ibmisc;
+using namespace icebin;
+
+int const nthread = 8;
+int const nkey = 4;
+
+// The fixture for testing class RegridMatrixCache
+class RegridCacheTest : public ::testing::Test {
+protected:
+    static RegridMatrixCache::KeyT key(int k)
+    {
+        return RegridMatrixCache::KeyT("IvA" + std::to_string(k),
+            true, true, false, std::array<double,3>{0,0,0}, 0.,
+            std::array<size_t,2>{0,0});
+    }
+
+    /** Stands in for the elevmaskI a set of matrices was built from */
+    static std::vector<double> inputs(int k)
+        { return std::vector<double>{(double)k, std::nan(""), 1000.}; }
+
+    /** A diagonal [n x n] matrix with value k */
+    static std::unique_ptr<linear::Weighted_Eigen> make_matrix(
+        int k, std::array<SparseSetT,2> &dims)
+    {
+        int const n = 10 + k;
+        for (int i=0; i<2; ++i) {
+            dims[i].set_sparse_extent(2*n);
+            for (int j=0; j<n; ++j) dims[i].add_dense(2*j);
+        }
+        std::unique_ptr<linear::Weighted_Eigen> BvA(
+            new linear::Weighted_Eigen({&dims[0], &dims[1]}, true));
+        BvA->M.reset(new EigenSparseMatrixT(n, n));
+        for (int j=0; j<n; ++j) BvA->M->insert(j, j) = k;
+        BvA->wM.reference(blitz::Array<double,1>(n));
+        BvA->wM = k;
+        BvA->Mw.reference(blitz::Array<double,1>(n));
+        BvA->Mw = k;
+        return BvA;
+    }
+};
+
+/** Concurrent lookups and inserts on one cache: every hit must be a
+complete copy of what was inserted under that key. */
+TEST_F(RegridCacheTest, concurrent_find_insert)
+{
+    RegridMatrixCache cache;
+
+    std::vector<int> nbad(nthread, 0);
+    std::vector<std::thread> threads;
+    for (int t=0; t<nthread; ++t) {
+        threads.push_back(std::thread([&cache,&nbad,t]() {
+            for (int iter=0; iter<50; ++iter) {
+                int const k = (t + iter) % nkey;
+                std::array<SparseSetT,2> dims;
+                std::unique_ptr<linear::Weighted_Eigen> BvA(
+                    cache.find(17, inputs(17), key(k), {&dims[0], &dims[1]}));
+                if (!BvA) {
+                    std::array<SparseSetT,2> dims1;
+                    cache.insert(17, inputs(17), key(k), *make_matrix(k, dims1));
+                    continue;
+                }
+
+                int const n = 10 + k;
+                if (BvA->M->rows() != n || BvA->M->nonZeros() != n
+                    || dims[0].dense_extent() != n || BvA->dims[0] != &dims[0]
+                    || BvA->wM.extent(0) != n || BvA->wM(n-1) != k)
+                {
+                    ++nbad[t];
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads) thread.join();
+
+    for (int t=0; t<nthread; ++t) EXPECT_EQ(0, nbad[t]);
+    EXPECT_EQ((size_t)nkey, cache.size());
+    EXPECT_EQ(nthread*50, cache.nhit + cache.nmiss);
+    EXPECT_LE(nkey, cache.nmiss);
+}
+
+/** A lookup with new inputs flushes the cache */
+TEST_F(RegridCacheTest, flush)
+{
+    RegridMatrixCache cache;
+    std::array<SparseSetT,2> dims;
+    cache.insert(1, inputs(1), key(0), *make_matrix(0, dims));
+    EXPECT_EQ((size_t)1, cache.size());
+
+    std::array<SparseSetT,2> dims2;
+    EXPECT_TRUE(nullptr != cache.find(1, inputs(1), key(0), {&dims2[0], &dims2[1]}));
+    EXPECT_TRUE(nullptr == cache.find(2, inputs(2), key(0), {&dims2[0], &dims2[1]}));
+    EXPECT_EQ((size_t)0, cache.size());
+}
+
+/** Equal hashes are not enough: the inputs themselves must match */
+TEST_F(RegridCacheTest, hash_collision)
+{
+    RegridMatrixCache cache;
+    std::array<SparseSetT,2> dims;
+    cache.insert(1, inputs(1), key(0), *make_matrix(0, dims));
+
+    std::array<SparseSetT,2> dims2;
+    EXPECT_TRUE(nullptr != cache.find(1, inputs(1), key(0), {&dims2[0], &dims2[1]}));
+    EXPECT_TRUE(nullptr == cache.find(1, inputs(2), key(0), {&dims2[0], &dims2[1]}));
+    EXPECT_EQ((size_t)0, cache.size());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,149 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <gtest/gtest.h>
+#include <icebin/Grid.hpp>
+#include <icebin/IceRegridder_L1.hpp>
+
+using namespace ibmisc;
+using namespace icebin;
+
+// The same meshes as tests/test_issm/test_regrid_l1.py
+class RegridL1Test : public ::testing::Test {
+protected:
+    Grid gridI;    // Square [-1,1]^2, as four triangles around (0,0)
+    Grid gridX;    // gridI split by two GCM cells: x<0 and x>0
+
+    static void add_cell(Grid &grid, std::vector<long> const &ivs, int i, int j)
+    {
+        std::vector<Vertex *> vertices;
+        for (long iv : ivs) vertices.push_back(grid.vertices.at(iv));
+        Cell *cell = grid.cells.add(Cell(std::move(vertices)));
+        cell->i = i;
+        cell->j = j;
+
+        double A2 = 0;
+        Vertex const *v0 = &*cell->begin((int)cell->size()-1);
+        for (auto v1=cell->begin(); v1 != cell->end(); ++v1) {
+            A2 += v0->x*v1->y - v1->x*v0->y;
+            v0 = &*v1;
+        }
+        cell->native_area = .5 * A2;
+    }
+
+    RegridL1Test()
+    {
+        gridI.coordinates = GridCoordinates::XY;
+        gridI.parameterization = GridParameterization::L1;
+        gridI.vertices.add(Vertex(-1., -1., 0));
+        gridI.vertices.add(Vertex( 1., -1., 1));
+        gridI.vertices.add(Vertex( 1.,  1., 2));
+        gridI.vertices.add(Vertex(-1.,  1., 3));
+        gridI.vertices.add(Vertex( 0.,  0., 4));
+        add_cell(gridI, {0,1,4}, 0, 0);
+        add_cell(gridI, {1,2,4}, 0, 0);
+        add_cell(gridI, {2,3,4}, 0, 0);
+        add_cell(gridI, {3,0,4}, 0, 0);
+
+        gridX.coordinates = GridCoordinates::XY;
+        gridX.parameterization = GridParameterization::L0;
+        gridX.vertices.add(Vertex(-1., -1., 0));
+        gridX.vertices.add(Vertex( 1., -1., 1));
+        gridX.vertices.add(Vertex( 1.,  1., 2));
+        gridX.vertices.add(Vertex(-1.,  1., 3));
+        gridX.vertices.add(Vertex( 0.,  0., 4));
+        gridX.vertices.add(Vertex( 0., -1., 5));
+        gridX.vertices.add(Vertex( 0.,  1., 6));
+        add_cell(gridX, {0,5,4}, 0, 0);    // (iA, iElement)
+        add_cell(gridX, {5,1,4}, 1, 0);
+        add_cell(gridX, {1,2,4}, 1, 1);
+        add_cell(gridX, {2,6,4}, 1, 2);
+        add_cell(gridX, {6,3,4}, 0, 2);
+        add_cell(gridX, {3,0,4}, 0, 3);
+    }
+
+    /** @return Sums of the unscaled GvAp matrix, by row */
+    static std::map<long,double> sum_GvAp(IceRegridder const &ice, char gridG,
+        blitz::Array<double,1> const &elevmaskI)
+    {
+        std::map<long,double> sums;
+        ice.visit_GvAE([&sums](long iG, long iA, double val) { sums[iG] += val; },
+            'A', gridG, &elevmaskI);
+        return sums;
+    }
+};
+
+TEST_F(RegridL1Test, GvAp)
+{
+    AbbrGrid agridA;
+    IceRegridder_L1 ice;
+    ice.init("mesh", agridA, nullptr,
+        AbbrGrid(gridI), ExchangeGrid(gridX), InterpStyle::Z_INTERP);
+    ice.init_mesh(gridI, gridX);
+    EXPECT_EQ(5, ice.nI());
+    EXPECT_EQ(6, ice.nX());
+
+    blitz::Array<double,1> elevmaskI(ice.nI());
+    elevmaskI = 0;
+
+    // Integral of each vertex's basis function
+    auto sumsI(sum_GvAp(ice, 'I', elevmaskI));
+    for (long iI=0; iI<4; ++iI) EXPECT_DOUBLE_EQ(2./3., sumsI[iI]);
+    EXPECT_DOUBLE_EQ(4./3., sumsI[4]);
+    for (int id=0; id<5; ++id)
+        EXPECT_DOUBLE_EQ(sumsI[id], ice.agridI.native_area(id));
+
+    // Area of each exchange grid cell
+    auto sumsX(sum_GvAp(ice, 'X', elevmaskI));
+    for (long iX=0; iX<6; ++iX)
+        EXPECT_DOUBLE_EQ(ice.aexgrid.native_area(iX), sumsX[iX]);
+
+    // Masked vertices drop out of the basis functions
+    elevmaskI(4) = std::numeric_limits<double>::quiet_NaN();
+    sumsI = sum_GvAp(ice, 'I', elevmaskI);
+    EXPECT_EQ(0, sumsI.count(4));
+    EXPECT_DOUBLE_EQ(2./3., sumsI[0]);
+}
+
+TEST_F(RegridL1Test, filter_cellsA)
+{
+    AbbrGrid agridA;
+    IceRegridder_L1 ice;
+    ice.init("mesh", agridA, nullptr,
+        AbbrGrid(gridI), ExchangeGrid(gridX), InterpStyle::Z_INTERP);
+    ice.init_mesh(gridI, gridX);
+
+    blitz::Array<double,1> elevmaskI(ice.nI());
+    elevmaskI = 0;
+    auto const sums0(sum_GvAp(ice, 'X', elevmaskI));
+
+    // Keep just the GCM cell x>0
+    ice.filter_cellsA(std::vector<bool>{false, true});
+    EXPECT_EQ(3, ice.aexgrid.dense_extent());
+    EXPECT_EQ(5, ice.agridI.dim.dense_extent());    // Elements 0-2 use every vertex
+    for (int id=0; id<ice.aexgrid.dense_extent(); ++id)
+        EXPECT_EQ(1, ice.aexgrid.ijk(id,0));
+
+    // Quadrature stays with its exchange grid cell
+    auto const sums1(sum_GvAp(ice, 'X', elevmaskI));
+    EXPECT_DOUBLE_EQ(sums0.at(1) + sums0.at(2) + sums0.at(3),
+        sums1.at(0) + sums1.at(1) + sums1.at(2));
+    for (int id=0; id<ice.aexgrid.dense_extent(); ++id)
+        EXPECT_DOUBLE_EQ(ice.aexgrid.native_area(id), sums1.at(id));
+}
@@ -0,0 +1,101 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/GCMRegridder.hpp>
+#include <icebin/RegridMatrices_Dynamic.hpp>
+#include <icebin/gridgen/GridGen_Synthetic.hpp>
+#include "regrid_test_util.hpp"
+
+using namespace ibmisc;
+using namespace icebin;
+using icebin::test_util::SparseMatrix;
+using icebin::test_util::to_sparse;
+using icebin::test_util::expect_near;
+
+int const nthread = 8;
+
+/** Concurrent and serial builds do the same arithmetic in the same order */
+double const rtol = 1e-12;
+
+// The fixture for testing concurrent use of RegridMatrices_Dynamic
+class RegridMatricesTest : public ::testing::Test {
+protected:
+    SyntheticGrids sgrids;
+    std::unique_ptr<GCMRegridder_Standard> gcm;
+    blitz::Array<double,1> elevmaskI;
+
+    RegridMatricesTest() :
+        sgrids(make_synthetic_grids(icebin::test_util::small_spec())),
+        gcm(sgrids.gcm_regridder()),
+        elevmaskI(sgrids.elevmaskIs()[0]) {}
+};
+
+/** Builds AvI, EvI and IvA from several threads at once on ONE
+RegridMatrices_Dynamic, each thread with its own dims.  The threads
+share its dense Ur matrices (built once, under std::call_once), and
+optionally a RegridMatrixCache; every result must match a serial
+build on a RegridMatrices_Dynamic of its own. */
+TEST_F(RegridMatricesTest, concurrent_matrix_d)
+{
+    RegridParams const params(true, true, {0.,0.,0.});
+    std::vector<std::string> const specs {"AvI", "EvI", "IvA"};
+
+    std::vector<SparseMatrix> expected;
+    for (auto const &spec : specs) {
+        std::array<SparseSetT,2> dims;
+        auto rm(gcm->regrid_matrices(0, elevmaskI, params));
+        auto BvA(rm->matrix_d(spec, {&dims[0], &dims[1]}, params));
+        expected.push_back(to_sparse(*BvA, dims));
+        EXPECT_LT(0, expected.back().M.size());
+    }
+
+    for (bool use_cache : {false, true}) {
+        RegridMatrixCache cache;
+        auto rm(gcm->regrid_matrices(0, elevmaskI, params));
+        if (use_cache) rm->cache = &cache;
+
+        // got[t][k] = thread t's build of specs[k]
+        std::vector<std::vector<SparseMatrix>> got(nthread,
+            std::vector<SparseMatrix>(specs.size()));
+        std::vector<std::thread> threads;
+        for (int t=0; t<nthread; ++t) {
+            threads.push_back(std::thread([&rm, &specs, &params, &got, t]() {
+                for (int iter=0; iter<2; ++iter) {
+                for (size_t j=0; j<specs.size(); ++j) {
+                    // Threads start on different matrices
+                    size_t const k = (t + j) % specs.size();
+                    std::array<SparseSetT,2> dims;
+                    auto BvA(rm->matrix_d(specs[k], {&dims[0], &dims[1]}, params));
+                    got[t][k] = to_sparse(*BvA, dims);
+                }}
+            }));
+        }
+        for (auto &thread : threads) thread.join();
+
+        for (int t=0; t<nthread; ++t) {
+        for (size_t k=0; k<specs.size(); ++k) {
+            SCOPED_TRACE("use_cache=" + std::to_string(use_cache)
+                + " thread=" + std::to_string(t) + " " + specs[k]);
+            expect_near(got[t][k], expected[k], rtol);
+        }}
+        if (use_cache) EXPECT_EQ(specs.size(), cache.size());
+    }
+}
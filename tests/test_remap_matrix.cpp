@@ -0,0 +1,195 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <icebin/eigen_types.hpp>
+
+using namespace spsparse;
+using namespace icebin;
+
+// The fixture for testing remap_M() and sparsify_M() against setFromTriplets()
+class RemapMatrixTest : public ::testing::Test {
+protected:
+    std::mt19937 gen;
+
+    RemapMatrixTest() : gen(17) {}
+
+    /** A random sparse [nrow x ncol] matrix; every third row and column
+    is left empty, so maps may drop them. */
+    EigenSparseMatrixT random_matrix(int nrow, int ncol, double density, bool compressed)
+    {
+        std::uniform_real_distribution<double> dist(0., 1.);
+        std::vector<Eigen::Triplet<double>> triplets;
+        for (int i=0; i<nrow; ++i)
+        for (int j=0; j<ncol; ++j) {
+            if (i%3 == 2 || j%3 == 2) continue;
+            if (dist(gen) < density) triplets.push_back(Eigen::Triplet<double>(i, j, dist(gen)));
+        }
+
+        EigenSparseMatrixT M(nrow, ncol);
+        if (compressed) {
+            M.setFromTriplets(triplets.begin(), triplets.end());
+        } else {
+            // insert() leaves M uncompressed, with free space in each column
+            M.reserve(Eigen::VectorXi::Constant(ncol, 4));
+            for (auto const &t : triplets) M.insert(t.row(), t.col()) = t.value();
+        }
+        return M;
+    }
+
+    /** A random one-to-one map of n indices.
+    @param expand Map to [0, 2n); else drop the empty (every third)
+        indices and map the rest to [0, n_kept).
+    @param monotone Keep the order of the indices
+    @param extent OUT: Number of indices mapped to */
+    std::vector<int> random_map(int n, bool expand, bool monotone, int &extent)
+    {
+        std::vector<int> keep;
+        for (int i=0; i<n; ++i) if (expand || i%3 != 2) keep.push_back(i);
+
+        std::vector<int> to;
+        if (expand) {
+            extent = 2*n;
+            for (int i=0; i<extent; ++i) to.push_back(i);
+            std::shuffle(to.begin(), to.end(), gen);
+            to.resize(keep.size());
+        } else {
+            extent = keep.size();
+            for (int i=0; i<extent; ++i) to.push_back(i);
+        }
+        if (monotone) std::sort(to.begin(), to.end());
+        else std::shuffle(to.begin(), to.end(), gen);
+
+        std::vector<int> map(n, -1);
+        for (size_t k=0; k<keep.size(); ++k) map[keep[k]] = to[k];
+        return map;
+    }
+
+    /** The remapped matrix, built through triplets */
+    static EigenSparseMatrixT remap_triplets(EigenSparseMatrixT const &M,
+        std::vector<int> const &rowmap, std::vector<int> const &colmap,
+        std::array<int,2> const &extent)
+    {
+        std::vector<Eigen::Triplet<double>> triplets;
+        for (int k=0; k<M.outerSize(); ++k) {
+        for (EigenSparseMatrixT::InnerIterator it(M, k); it; ++it) {
+            triplets.push_back(Eigen::Triplet<double>(
+                rowmap[it.row()], colmap[it.col()], it.value()));
+        }}
+        EigenSparseMatrixT S(extent[0], extent[1]);
+        S.setFromTriplets(triplets.begin(), triplets.end());
+        return S;
+    }
+
+    /** S and S0 must have the same compressed arrays, bit for bit */
+    static void expect_same(EigenSparseMatrixT const &S, EigenSparseMatrixT const &S0)
+    {
+        ASSERT_TRUE(S.isCompressed());
+        ASSERT_EQ(S0.rows(), S.rows());
+        ASSERT_EQ(S0.cols(), S.cols());
+        ASSERT_EQ(S0.nonZeros(), S.nonZeros());
+        int const nnz = S0.nonZeros();
+        EXPECT_TRUE(std::equal(S0.outerIndexPtr(), S0.outerIndexPtr() + S0.cols() + 1,
+            S.outerIndexPtr()));
+        EXPECT_TRUE(std::equal(S0.innerIndexPtr(), S0.innerIndexPtr() + nnz,
+            S.innerIndexPtr()));
+        EXPECT_EQ(0, memcmp(S0.valuePtr(), S.valuePtr(), nnz * sizeof(double)));
+    }
+};
+
+/** Monotone and non-monotone row and column maps, each either
+expanding (eg dense to sparse) or compacting (dropping the empty
+indices, eg sparse to dense). */
+TEST_F(RemapMatrixTest, remap_M)
+{
+    for (int iter=0; iter<5; ++iter) {
+    for (bool compressed : {true, false}) {
+    for (bool rows_expand : {true, false}) {
+    for (bool rows_monotone : {true, false}) {
+    for (bool cols_expand : {true, false}) {
+    for (bool cols_monotone : {true, false}) {
+        SCOPED_TRACE("iter=" + std::to_string(iter)
+            + " compressed=" + std::to_string(compressed)
+            + " rows_expand=" + std::to_string(rows_expand)
+            + " rows_monotone=" + std::to_string(rows_monotone)
+            + " cols_expand=" + std::to_string(cols_expand)
+            + " cols_monotone=" + std::to_string(cols_monotone));
+
+        int const nrow = 20 + 13*iter;
+        int const ncol = 30 + 7*iter;
+        EigenSparseMatrixT const M(random_matrix(nrow, ncol, .15, compressed));
+        EXPECT_EQ(compressed, M.isCompressed());
+
+        std::array<int,2> extent;
+        std::vector<int> const rowmap(random_map(nrow, rows_expand, rows_monotone, extent[0]));
+        std::vector<int> const colmap(random_map(ncol, cols_expand, cols_monotone, extent[1]));
+
+        expect_same(remap_M(M, rowmap, colmap, extent),
+            remap_triplets(M, rowmap, colmap, extent));
+    }}}}}}
+}
+
+/** Dense to sparse through SparseSets numbered in sorted
+(monotone) or random order; and the ID transform. */
+TEST_F(RemapMatrixTest, sparsify_M)
+{
+    int const nrow = 40, ncol = 50;
+    int const nsparse = 200;
+
+    for (bool monotone : {true, false}) {
+    for (auto const &transforms : std::vector<std::array<SparsifyTransform,2>>{
+        {SparsifyTransform::TO_SPARSE, SparsifyTransform::TO_SPARSE},
+        {SparsifyTransform::ID, SparsifyTransform::TO_SPARSE},
+        {SparsifyTransform::TO_SPARSE, SparsifyTransform::ID}})
+    {
+        SCOPED_TRACE("monotone=" + std::to_string(monotone)
+            + " transforms=" + std::to_string((int)transforms[0])
+            + "," + std::to_string((int)transforms[1]));
+
+        std::array<SparseSetT,2> dims;
+        std::array<int,2> const n {nrow, ncol};
+        std::array<std::vector<int>,2> maps;
+        std::array<int,2> extent;
+        for (int k=0; k<2; ++k) {
+            int ignore;
+            std::vector<int> const to_sparse(random_map(nsparse, true, true, ignore));
+            std::vector<int> sparse(to_sparse.begin(), to_sparse.begin() + n[k]);
+            if (!monotone) std::shuffle(sparse.begin(), sparse.end(), gen);
+
+            dims[k].set_sparse_extent(2*nsparse);
+            for (int i : sparse) dims[k].add_dense(i);
+
+            if (transforms[k] == SparsifyTransform::ID) {
+                extent[k] = n[k];
+                for (int i=0; i<n[k]; ++i) maps[k].push_back(i);
+            } else {
+                extent[k] = dims[k].sparse_extent();
+                for (int i=0; i<n[k]; ++i) maps[k].push_back(dims[k].to_sparse(i));
+            }
+        }
+
+        EigenSparseMatrixT const M(random_matrix(nrow, ncol, .15, true));
+        expect_same(sparsify_M(M, transforms, {&dims[0], &dims[1]}, extent),
+            remap_triplets(M, maps[0], maps[1], extent));
+    }}
+}
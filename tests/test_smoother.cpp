@@ -0,0 +1,117 @@
+/*
+ * IceBin: A Coupling Library for Ice Models and GCMs
+ * Copyright (c) 2013-2016 by Elizabeth Fischer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <map>
+#include <limits>
+#include <gtest/gtest.h>
+#include <icebin/smoother.hpp>
+
+using namespace icebin;
+
+class SmootherTest : public ::testing::Test {
+protected:
+    std::array<double,3> const sigma {1., 1., std::numeric_limits<double>::infinity()};
+    SparseSetT dimX;
+
+    /** Cells at (x,0), by sparse index; {x, area} */
+    std::map<long, std::array<double,2>> cells;
+
+    SmootherTest()
+    {
+        for (int i=0; i<4; ++i) dimX.add_dense(i);
+    }
+
+    std::unique_ptr<Smoother> smoother(double tol) const
+    {
+        std::vector<Smoother::Tuple> tuples;
+        for (auto const &ii : cells) tuples.push_back(Smoother::Tuple(
+            dimX.to_dense(ii.first), {ii.second[0], 0.}, 0., ii.second[1]));
+        std::unique_ptr<Smoother> ret(new Smoother(std::move(tuples), sigma));
+        ret->tol = tol;
+        return ret;
+    }
+
+    static std::map<std::pair<int,int>, double> to_map(TupleListT<2> const &M)
+    {
+        std::map<std::pair<int,int>, double> ret;
+        for (auto ii(M.begin()); ii != M.end(); ++ii)
+            ret[std::make_pair(ii->index(0), ii->index(1))] += ii->value();
+        return ret;
+    }
+
+    /** Checks the cached matrix against one built from scratch */
+    void expect_same(SmoothingCache &cache, double tol)
+    {
+        TupleListT<2> M0({4,4}), M1({4,4});
+        smoother(tol)->matrix(M0);
+        smoother(tol)->matrix(M1, cache,
+            cache.entry(SmoothingCache::KeyT("test", sigma, tol)), dimX);
+
+        auto const m0(to_map(M0));
+        auto const m1(to_map(M1));
+        ASSERT_EQ(m0.size(), m1.size());
+        for (auto ii0(m0.begin()), ii1(m1.begin()); ii0 != m0.end(); ++ii0, ++ii1) {
+            EXPECT_EQ(ii0->first, ii1->first);
+            EXPECT_DOUBLE_EQ(ii0->second, ii1->second);
+        }
+    }
+};
+
+TEST_F(SmootherTest, cache_truncated)
+{
+    // Cell 2 is so small that truncation drops it from the row of
+    // cell 1, but cell 1 stays in the row of cell 2.
+    double const tol = .1;
+    cells[0] = {0., 1.};
+    cells[1] = {1., 1.};
+    cells[2] = {2., .01};
+    cells[3] = {3., 1.};
+
+    SmoothingCache cache;
+    expect_same(cache, tol);
+
+    // Remove cell 1: the row of cell 2 must not keep it
+    cells.erase(1);
+    expect_same(cache, tol);
+
+    // Move it back, somewhere else
+    cells[1] = {1.2, 1.};
+    expect_same(cache, tol);
+
+    // Change its area
+    cells[1][1] = 2.;
+    expect_same(cache, tol);
+    EXPECT_LT(0, cache.nrow_reused);
+}
+
+TEST_F(SmootherTest, cache_untruncated)
+{
+    cells[0] = {0., 1.};
+    cells[1] = {1., 1.};
+    cells[2] = {2., .01};
+    cells[3] = {3., 1.};
+
+    SmoothingCache cache;
+    expect_same(cache, 0.);
+    cells.erase(1);
+    expect_same(cache, 0.);
+    cells[1] = {1.2, 1.};
+    expect_same(cache, 0.);
+}
@@ -26,6 +26,7 @@
 #include <cstdio>
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
 
 using namespace std;
 using namespace ibmisc;
@@ -57,11 +58,31 @@ protected:
 
 //    // The mock bar library shaed by all tests
 //    MockBar m_bar;
-};
+
+    /** The raw input files are found along $MODELE_FILE_PATH; tests
+    that need them do nothing without it. */
+    static bool have_inputs()
+    {
+        if (getenv("MODELE_FILE_PATH")) return true;
+        printf("MODELE_FILE_PATH not set; skipping\n");
+        return false;
+    }
+
+    /** Reads the raw inputs and runs z1qx1n_bs1() on them
+    (TopoOutputs refers into its own bundle, so it is not returned) */
+    static void make_topo(bool concurrent, TopoOutputs<2> &topo_outputs)
+    {
+        TopoInputs topo_inputs(topo_inputs_bundle(true));
+        EnvSearchPath locator("MODELE_FILE_PATH");
+        read_raw(topo_inputs, true, nullptr, locator);
+
+        z1qx1n_bs1(topo_inputs, "", topo_outputs, concurrent);
+    }
 
 
 TEST_F(Z1qx1n_Bs1Test, read_inputs)
 {
+    if (!have_inputs()) return;
     TopoInputs topo_inputs(topo_inputs_bundle(true));
     GreenlandInputs greenland_inputs(greenland_inputs_bundle(true));
 
@@ -76,6 +97,43 @@ TEST_F(Z1qx1n_Bs1Test, read_inputs)
     ncio.close();
 }
 
+/** Running the phases of z1qx1n_bs1() concurrently must not change
+any output, bit for bit. */
+TEST_F(Z1qx1n_Bs1Test, serial_vs_concurrent)
+{
+    if (!have_inputs()) return;
+
+    TopoOutputs<2> serial(topo_outputs_bundle2(true));
+    TopoOutputs<2> concurrent(topo_outputs_bundle2(true));
+    make_topo(false, serial);
+    make_topo(true, concurrent);
+
+    std::vector<std::pair<char const *, std::array<blitz::Array<double,2> *,2>>> const fields {
+        {"FOCEAN", {&serial.FOCEAN, &concurrent.FOCEAN}},
+        {"FLAKE", {&serial.FLAKE, &concurrent.FLAKE}},
+        {"FGRND", {&serial.FGRND, &concurrent.FGRND}},
+        {"FGICE", {&serial.FGICE, &concurrent.FGICE}},
+        {"ZATMO", {&serial.ZATMO, &concurrent.ZATMO}},
+        {"dZOCEN", {&serial.dZOCEN, &concurrent.dZOCEN}},
+        {"dZLAKE", {&serial.dZLAKE, &concurrent.dZLAKE}},
+        {"dZGICE", {&serial.dZGICE, &concurrent.dZGICE}},
+        {"ZSOLDG", {&serial.ZSOLDG, &concurrent.ZSOLDG}},
+        {"ZSGLO", {&serial.ZSGLO, &concurrent.ZSGLO}},
+        {"ZLAKE", {&serial.ZLAKE, &concurrent.ZLAKE}},
+        {"ZGRND", {&serial.ZGRND, &concurrent.ZGRND}},
+        {"ZSGHI", {&serial.ZSGHI, &concurrent.ZSGHI}},
+        {"FOCENF", {&serial.FOCENF, &concurrent.FOCENF}}};
+
+    for (auto const &field : fields) {
+        blitz::Array<double,2> const &a(*field.second[0]);
+        blitz::Array<double,2> const &b(*field.second[1]);
+        ASSERT_EQ(a.size(), b.size()) << field.first;
+        ASSERT_TRUE(a.isStorageContiguous() && b.isStorageContiguous()) << field.first;
+        // Bitwise, so NaNs compare equal
+        EXPECT_EQ(0, memcmp(a.data(), b.data(), a.size() * sizeof(double))) << field.first;
+    }
+}
+
 
 
 